@@ -1,10 +1,17 @@
 #include "acl.hpp"
 
+#include <mutex>
 #include <ostream>
 #include <sstream>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 
+#include <zookeeper/zookeeper.h>
+
+#include "detail/native.hpp"
+#include "jute.hpp"
+
 namespace zk
 {
 
@@ -148,6 +155,73 @@ std::string to_string(const acl& self)
     return os.str();
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// acl_handle                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct acl_handle::state final
+{
+    acl               rules;
+    std::vector<ACL>  native_parts;
+    ACL_vector        native;
+    std::vector<char> wire_message; //!< The rules as a jute message, length prefix and all
+
+    explicit state(acl rules_in) :
+            rules(std::move(rules_in))
+    {
+        native_parts.reserve(rules.size());
+        for (const auto& rule : rules)
+            native_parts.push_back(encode_acl_part(rule));
+        native.count = int(native_parts.size());
+        native.data  = native_parts.data();
+
+        jute_writer writer(4U + 32U * rules.size());
+        writer.write_acl(rules);
+        wire_message = std::move(writer).finish();
+    }
+};
+
+acl_handle::acl_handle(acl rules) :
+        _state(std::make_shared<const state>(std::move(rules)))
+{ }
+
+acl_handle acl_handle::intern(const acl& rules)
+{
+    static std::mutex                                      protect;
+    static std::unordered_multimap<std::size_t, acl_handle> interned;
+
+    std::size_t key = rules.size();
+    for (const auto& rule : rules)
+        key = key * 31U + hash(rule);
+
+    std::unique_lock<std::mutex> ax(protect);
+    auto range = interned.equal_range(key);
+    for (auto iter = range.first; iter != range.second; ++iter)
+        if (iter->second.rules() == rules)
+            return iter->second;
+    return interned.emplace(key, acl_handle(rules))->second;
+}
+
+const acl& acl_handle::rules() const noexcept
+{
+    return _state->rules;
+}
+
+string_view acl_handle::wire() const noexcept
+{
+    return string_view(_state->wire_message.data() + jute_length_size, _state->wire_message.size() - jute_length_size);
+}
+
+ptr<const ::ACL_vector> acl_handle::native() const noexcept
+{
+    return &_state->native;
+}
+
+std::ostream& operator<<(std::ostream& os, const acl_handle& self)
+{
+    return os << self.rules();
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // acls                                                                                                               //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -4,11 +4,16 @@
 
 #include <initializer_list>
 #include <iosfwd>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "forwards.hpp"
+#include "string_view.hpp"
+
+/// The ACL list of the ZooKeeper C client, which \ref zk::acl_handle::native encodes into.
+struct ACL_vector;
 
 namespace zk
 {
@@ -217,6 +222,57 @@ std::ostream& operator<<(std::ostream&, const acl&);
 
 std::string to_string(const acl& self);
 
+/// An \ref acl which has been encoded into what both connection types send, once, and is shared by every copy of the
+/// handle. Creating entries with a handle costs a pointer copy for the ACL, where an \ref acl is copied into each
+/// \ref op and encoded again by each request.
+///
+/// \code
+/// static const auto service_acl = acl_handle::intern({ { "digest", "svc:Hz0y...=", permission::all } });
+/// client.create("/service/worker-", data, service_acl, create_mode::sequential);
+/// \endcode
+class acl_handle final
+{
+public:
+    using const_iterator = acl::const_iterator;
+    using size_type      = acl::size_type;
+
+public:
+    /// Encode \a rules for this handle and its copies. This is how a plain \ref acl is accepted where a handle is.
+    acl_handle(acl rules);
+
+    /// Get the handle shared by everything which interns an ACL equal to \a rules. It is encoded the first time it is
+    /// asked for and kept until the process exits, so this is meant for the handful of ACLs an application uses over
+    /// and over. Looking one up costs hashing \a rules and taking a lock, so keep the result instead of interning for
+    /// each request.
+    static acl_handle intern(const acl& rules);
+
+    /// The rules of the handle.
+    const acl& rules() const noexcept;
+
+    operator const acl&() const noexcept { return rules(); }
+
+    size_type size() const noexcept { return rules().size(); }
+
+    const acl_rule& operator[](size_type idx) const { return rules()[idx]; }
+
+    const_iterator begin() const { return rules().begin(); }
+    const_iterator end()   const { return rules().end(); }
+
+    /// The rules in the jute encoding the ZooKeeper protocol sends them in: the count, then each rule.
+    string_view wire() const noexcept;
+
+    /// The rules as the ZooKeeper C client takes them. This is valid for as long as any copy of the handle is.
+    ptr<const ::ACL_vector> native() const noexcept;
+
+private:
+    struct state;
+
+private:
+    std::shared_ptr<const state> _state;
+};
+
+std::ostream& operator<<(std::ostream&, const acl_handle&);
+
 /// Commonly-used ACLs.
 class acls
 {
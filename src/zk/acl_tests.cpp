@@ -1,6 +1,12 @@
 #include <zk/tests/test.hpp>
 
+#include <sstream>
+#include <string>
+
+#include <zookeeper/zookeeper.h>
+
 #include "acl.hpp"
+#include "jute.hpp"
 
 namespace zk
 {
@@ -76,4 +82,50 @@ GTEST_TEST(acl_tests, stringification)
             );
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// acl_handle                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GTEST_TEST(acl_handle_tests, interning)
+{
+    acl service = { { "digest", "svc:abc=", permission::all }, { "world", "anyone", permission::read } };
+
+    auto first  = acl_handle::intern(service);
+    auto second = acl_handle::intern(acl(service));
+    CHECK_EQ(first.native(), second.native());
+    CHECK_EQ(service, first.rules());
+
+    auto other = acl_handle::intern(acls::read_unsafe());
+    CHECK_NE(first.native(), other.native());
+
+    // A handle made without interning has an encoding of its own, which its copies share
+    acl_handle owned(service);
+    acl_handle copied = owned;
+    CHECK_NE(first.native(), owned.native());
+    CHECK_EQ(owned.native(), copied.native());
+    CHECK_TRUE(owned == service);
+}
+
+GTEST_TEST(acl_handle_tests, encodings)
+{
+    acl_handle rules({ { "auth", "", permission::read }, { "ip", "50.40.30.0/24", permission::all } });
+    CHECK_EQ(2U, rules.size());
+    CHECK_EQ("ip", rules[1].scheme());
+
+    auto native = rules.native();
+    CHECK_EQ(2, native->count);
+    CHECK_EQ(std::string("50.40.30.0/24"), native->data[1].id.id);
+    CHECK_EQ(static_cast<int>(permission::read), native->data[0].perms);
+
+    jute_writer plain;
+    plain.write_acl(rules.rules());
+    jute_writer from_handle;
+    from_handle.write_acl(rules);
+    CHECK_TRUE(std::move(plain).finish() == std::move(from_handle).finish());
+
+    std::ostringstream os;
+    os << rules;
+    CHECK_EQ(to_string(rules.rules()), os.str());
+}
+
 }
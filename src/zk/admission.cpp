@@ -0,0 +1,117 @@
+#include "admission.hpp"
+
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// admission_policy                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const admission_policy& policy)
+{
+    switch (policy)
+    {
+    case admission_policy::reject: return os << "reject";
+    case admission_policy::wait:   return os << "wait";
+    default:                       return os << "admission_policy(" << static_cast<int>(policy) << ')';
+    }
+}
+
+std::string to_string(const admission_policy& policy)
+{
+    std::ostringstream os;
+    os << policy;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// in_flight_budget                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+in_flight_budget::in_flight_budget(std::size_t limit, admission_policy when_full) :
+        _limit(limit),
+        _when_full(when_full),
+        _in_flight(0U),
+        _waiters(0U)
+{
+    if (limit == 0U)
+        throw std::invalid_argument("The limit of an in_flight_budget must be greater than 0");
+}
+
+in_flight_budget::~in_flight_budget() noexcept = default;
+
+bool in_flight_budget::try_acquire(std::size_t count)
+{
+    auto current = _in_flight.load(std::memory_order_relaxed);
+    while (true)
+    {
+        if (current != 0U && current + count > _limit)
+            return false;
+        else if (_in_flight.compare_exchange_weak(current, current + count, std::memory_order_acquire))
+            return true;
+    }
+}
+
+bool in_flight_budget::acquire(std::size_t count)
+{
+    if (try_acquire(count))
+        return true;
+    else if (_when_full == admission_policy::reject)
+        return false;
+
+    if (completion_thread_scope::active())
+    {
+        _in_flight.fetch_add(count, std::memory_order_acquire);
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(_wait_protect);
+    _waiters.fetch_add(1U);
+    _wait_cv.wait(lock, [&] { return try_acquire(count); });
+    _waiters.fetch_sub(1U);
+    return true;
+}
+
+void in_flight_budget::release(std::size_t count) noexcept
+{
+    _in_flight.fetch_sub(count, std::memory_order_release);
+
+    if (_when_full == admission_policy::wait && _waiters.load() != 0U)
+    {
+        // Taking the lock orders this with a waiter which checked the budget but has not started waiting yet
+        std::lock_guard<std::mutex> lock(_wait_protect);
+        _wait_cv.notify_all();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// completion_thread_scope                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static thread_local bool delivers_completions = false;
+
+completion_thread_scope::completion_thread_scope() noexcept :
+        _outer(std::exchange(delivers_completions, true))
+{ }
+
+completion_thread_scope::~completion_thread_scope() noexcept
+{
+    delivers_completions = _outer;
+}
+
+bool completion_thread_scope::active() noexcept
+{
+    return delivers_completions;
+}
+
+void completion_thread_scope::mark_forever() noexcept
+{
+    delivers_completions = true;
+}
+
+}
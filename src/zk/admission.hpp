@@ -0,0 +1,110 @@
+/// \file
+/// Defines \ref zk::in_flight_budget, the cap on the number of requests a connection has outstanding at once.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// What happens to a request made while its \ref in_flight_budget is used up.
+enum class admission_policy : int
+{
+    /// The request is not sent; it fails with \ref error_code::throttled right away.
+    reject,
+    /// The calling thread blocks until enough of the outstanding requests complete. Requests made from a thread which
+    /// delivers completions (from inside a \ref callback, for example) are never blocked, as the completions they would
+    /// wait for might not be delivered until they return; they are admitted over the cap instead. Which threads those
+    /// are is told with \ref completion_thread_scope.
+    wait,
+};
+
+std::ostream& operator<<(std::ostream&, const admission_policy&);
+
+std::string to_string(const admission_policy&);
+
+/// A count of outstanding requests with an upper bound. Every request takes its share of the budget when it is made and
+/// gives it back when it completes, so a burst of requests can not pile up without bound inside the ZooKeeper client
+/// (where it would cost memory and hold up every other request on the session).
+///
+/// \see connection_params::max_reads_in_flight
+/// \see connection_params::max_writes_in_flight
+class in_flight_budget final
+{
+public:
+    /// Create a budget allowing up to \a limit outstanding requests, handling requests over that by \a when_full.
+    ///
+    /// \param limit The maximum in flight. It must be greater than \c 0.
+    explicit in_flight_budget(std::size_t limit, admission_policy when_full = admission_policy::reject);
+
+    in_flight_budget(const in_flight_budget&) = delete;
+    in_flight_budget& operator=(const in_flight_budget&) = delete;
+
+    ~in_flight_budget() noexcept;
+
+    std::size_t limit() const { return _limit; }
+
+    admission_policy when_full() const { return _when_full; }
+
+    /// The share of the budget in use right now.
+    std::size_t in_flight() const { return _in_flight.load(std::memory_order_relaxed); }
+
+    /// Take \a count from the budget. A request larger than the whole budget (a big batch) is admitted when nothing
+    /// else is in flight, so it never waits forever.
+    ///
+    /// \returns \c true if the request was admitted; \c false if it was rejected. With \ref admission_policy::wait,
+    ///  this only returns \c true.
+    bool acquire(std::size_t count = 1U);
+
+    /// Give back \a count taken by a successful \ref acquire.
+    void release(std::size_t count = 1U) noexcept;
+
+private:
+    bool try_acquire(std::size_t count);
+
+private:
+    const std::size_t            _limit;
+    const admission_policy       _when_full;
+    std::atomic<std::size_t>     _in_flight;
+    std::atomic<std::size_t>     _waiters;
+    std::mutex                   _wait_protect;
+    std::condition_variable      _wait_cv;
+};
+
+/// Marks the calling thread as one which delivers completions while it is in scope, so \ref admission_policy::wait
+/// admits the requests it makes instead of blocking it. Scopes nest. The threads the ZooKeeper client calls back on are
+/// marked for good with \ref mark_forever, as they never do anything else; the lanes of an \ref ordered_executor and
+/// the loops of a \ref reactor are marked while they run.
+class completion_thread_scope final
+{
+public:
+    completion_thread_scope() noexcept;
+
+    completion_thread_scope(const completion_thread_scope&) = delete;
+    completion_thread_scope& operator=(const completion_thread_scope&) = delete;
+
+    ~completion_thread_scope() noexcept;
+
+    /// Is the calling thread marked?
+    static bool active() noexcept;
+
+    /// Mark the calling thread for the rest of its life.
+    static void mark_forever() noexcept;
+
+private:
+    bool _outer;
+};
+
+/// \}
+
+}
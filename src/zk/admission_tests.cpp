@@ -0,0 +1,110 @@
+#include <zk/tests/test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "admission.hpp"
+
+namespace zk
+{
+
+GTEST_TEST(in_flight_budget_tests, reject_when_full)
+{
+    in_flight_budget budget(2U);
+    CHECK_TRUE(budget.acquire());
+    CHECK_TRUE(budget.acquire());
+    CHECK_FALSE(budget.acquire());
+    CHECK_EQ(2U, budget.in_flight());
+
+    budget.release();
+    CHECK_TRUE(budget.acquire());
+    CHECK_EQ(2U, budget.in_flight());
+}
+
+GTEST_TEST(in_flight_budget_tests, oversized_admitted_when_idle)
+{
+    in_flight_budget budget(4U);
+    CHECK_TRUE(budget.acquire(10U));
+    CHECK_FALSE(budget.acquire(1U));
+
+    budget.release(10U);
+    CHECK_EQ(0U, budget.in_flight());
+    CHECK_TRUE(budget.acquire(3U));
+    CHECK_FALSE(budget.acquire(2U));
+}
+
+GTEST_TEST(in_flight_budget_tests, wait_until_released)
+{
+    in_flight_budget budget(1U, admission_policy::wait);
+    CHECK_TRUE(budget.acquire());
+
+    std::atomic<bool> admitted(false);
+    std::thread waiter([&]
+                       {
+                           budget.acquire();
+                           admitted = true;
+                       }
+                      );
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK_FALSE(admitted.load());
+
+    budget.release();
+    waiter.join();
+    CHECK_TRUE(admitted.load());
+    CHECK_EQ(1U, budget.in_flight());
+}
+
+GTEST_TEST(in_flight_budget_tests, wait_never_blocks_the_completion_thread)
+{
+    in_flight_budget budget(1U, admission_policy::wait);
+    CHECK_TRUE(budget.acquire());
+    {
+        completion_thread_scope delivering;
+        CHECK_TRUE(completion_thread_scope::active());
+
+        // Nothing could release the budget while this thread is stuck, so it is admitted over the limit
+        CHECK_TRUE(budget.acquire());
+        CHECK_EQ(2U, budget.in_flight());
+    }
+    CHECK_FALSE(completion_thread_scope::active());
+}
+
+GTEST_TEST(in_flight_budget_tests, failed_submission_keeps_the_cap)
+{
+    in_flight_budget budget(1U, admission_policy::wait);
+
+    // A submission which fails right away gives its share back on the thread which made it, which does not make that
+    // thread a completion thread
+    CHECK_TRUE(budget.acquire());
+    budget.release();
+    CHECK_TRUE(budget.acquire());
+
+    std::atomic<bool> released(false);
+    std::thread completion([&]
+                           {
+                               std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                               released = true;
+                               budget.release();
+                           }
+                          );
+    CHECK_TRUE(budget.acquire());
+    CHECK_TRUE(released.load());
+    completion.join();
+    CHECK_EQ(1U, budget.in_flight());
+}
+
+GTEST_TEST(in_flight_budget_tests, zero_limit)
+{
+    CHECK_THROWS(std::invalid_argument) { in_flight_budget(0U); };
+}
+
+GTEST_TEST(in_flight_budget_tests, policy_to_string)
+{
+    CHECK_EQ("reject", to_string(admission_policy::reject));
+    CHECK_EQ("wait",   to_string(admission_policy::wait));
+}
+
+}
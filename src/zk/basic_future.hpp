@@ -0,0 +1,655 @@
+/// \file
+/// Defines \ref zk::basic_future and \ref zk::basic_promise, the future and promise types of this library, which can be
+/// chained with continuations instead of waited on.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "completion_pool.hpp"
+#include "executor.hpp"
+#include "optional.hpp"
+
+namespace zk
+{
+
+template <typename T>
+class basic_future;
+
+template <typename T>
+class basic_promise;
+
+namespace detail
+{
+
+/// What to run once a \ref future_state is ready. This is type-erased so a continuation can own move-only things
+/// (such as the promise of the future \ref basic_future::then returns), which \c std::function can not.
+class future_continuation
+{
+public:
+    virtual ~future_continuation() noexcept = default;
+
+    virtual void run() = 0;
+};
+
+template <typename FRun>
+class future_continuation_of final :
+        public future_continuation,
+        public pooled_completion
+{
+public:
+    explicit future_continuation_of(FRun run) :
+            _run(std::move(run))
+    { }
+
+    virtual void run() override
+    {
+        _run();
+    }
+
+private:
+    FRun _run;
+};
+
+/// The state shared by a \ref basic_promise and its \ref basic_future. Everything about it is in \c _flags: the result
+/// is published with a single \c fetch_or, and whoever comes second -- the promise setting the result or the future
+/// attaching a continuation -- runs the continuation. The mutex and condition variable are only touched by a thread
+/// which actually has to block in \ref wait, and by the promise if it sees one did.
+template <typename T>
+class future_state final :
+        public pooled_completion
+{
+public:
+    using stored_type = std::conditional_t<std::is_void<T>::value, bool, T>;
+
+    static constexpr unsigned has_result       = 1U;
+    static constexpr unsigned has_continuation = 2U;
+    static constexpr unsigned has_waiter       = 4U;
+
+public:
+    future_state() noexcept :
+            _flags(0U),
+            _refs(1U)
+    { }
+
+    future_state(const future_state&) = delete;
+    future_state& operator=(const future_state&) = delete;
+
+    void add_ref() noexcept
+    {
+        _refs.fetch_add(1U, std::memory_order_relaxed);
+    }
+
+    void release() noexcept
+    {
+        if (_refs.fetch_sub(1U, std::memory_order_acq_rel) == 1U)
+            delete this;
+    }
+
+    bool is_ready() const noexcept
+    {
+        return (_flags.load(std::memory_order_acquire) & has_result) != 0U;
+    }
+
+    template <typename... TArgs>
+    void set_value(TArgs&&... args)
+    {
+        if constexpr (std::is_void<T>::value)
+            _value.emplace(true);
+        else
+            _value.emplace(std::forward<TArgs>(args)...);
+        publish();
+    }
+
+    void set_exception(std::exception_ptr error)
+    {
+        _error = std::move(error);
+        publish();
+    }
+
+    /// Run \a run once the result is in, which might be right now. Only one continuation can be attached.
+    template <typename FRun>
+    void attach(FRun&& run)
+    {
+        _continuation = std::make_unique<future_continuation_of<std::decay_t<FRun>>>(std::forward<FRun>(run));
+        if ((_flags.fetch_or(has_continuation, std::memory_order_acq_rel) & has_result) != 0U)
+            run_continuation();
+    }
+
+    void wait() const
+    {
+        if (is_ready())
+            return;
+
+        _flags.fetch_or(has_waiter, std::memory_order_acq_rel);
+        std::unique_lock<std::mutex> ax(_wait_protect);
+        _wake.wait(ax, [this] { return is_ready(); });
+    }
+
+    template <typename TClock, typename TDuration>
+    bool wait_until(const std::chrono::time_point<TClock, TDuration>& deadline) const
+    {
+        if (is_ready())
+            return true;
+
+        _flags.fetch_or(has_waiter, std::memory_order_acq_rel);
+        std::unique_lock<std::mutex> ax(_wait_protect);
+        return _wake.wait_until(ax, deadline, [this] { return is_ready(); });
+    }
+
+    /// Get the value out, or throw what the promise failed with.
+    ///
+    /// \pre \ref is_ready
+    T take()
+    {
+        if (_error)
+            std::rethrow_exception(_error);
+
+        if constexpr (!std::is_void<T>::value)
+            return std::move(*_value);
+    }
+
+    /// Has \ref basic_promise::get_future been called? Only the promise looks at this.
+    bool retrieved = false;
+
+private:
+    void publish()
+    {
+        auto prev = _flags.fetch_or(has_result, std::memory_order_acq_rel);
+        if ((prev & has_waiter) != 0U)
+        {
+            // Taking the lock orders this against a waiter which has checked the flags but not started waiting yet
+            { std::unique_lock<std::mutex> ax(_wait_protect); }
+            _wake.notify_all();
+        }
+        if ((prev & has_continuation) != 0U)
+            run_continuation();
+    }
+
+    void run_continuation()
+    {
+        // The continuation can hold the last reference to this, so nothing here may be touched once it has run
+        auto continuation = std::move(_continuation);
+        continuation->run();
+    }
+
+private:
+    mutable std::atomic<unsigned>        _flags;
+    std::atomic<unsigned>                _refs;
+    optional<stored_type>                _value;
+    std::exception_ptr                   _error;
+    std::unique_ptr<future_continuation> _continuation;
+    mutable std::mutex                   _wait_protect;
+    mutable std::condition_variable      _wake;
+};
+
+struct future_state_release final
+{
+    template <typename T>
+    void operator()(ptr<future_state<T>> state) const noexcept
+    {
+        state->release();
+    }
+};
+
+/// A reference to a \ref future_state, which is let go of when this is destroyed.
+template <typename T>
+using future_state_ptr = std::unique_ptr<future_state<T>, future_state_release>;
+
+template <typename T>
+struct unwrap_future
+{
+    using type = T;
+};
+
+template <typename T>
+struct unwrap_future<basic_future<T>>
+{
+    using type = T;
+};
+
+/// What the future returned by \ref basic_future::then holds when the continuation is \a FContinue.
+template <typename FContinue, typename T>
+using continuation_value_t =
+        typename unwrap_future<std::invoke_result_t<std::decay_t<FContinue>&, basic_future<T>>>::type;
+
+}
+
+/// \addtogroup Client
+/// \{
+
+/// A future which can be chained. It works as \c std::future does (so it can stand in for it as \ref zk::future, see
+/// \ref future.hpp) and adds \ref then, for running something once the result is in without a thread waiting for it,
+/// as well as \ref when_all and \ref when_any for combining several.
+///
+/// \par Cost
+/// The state shared with the \ref basic_promise is one allocation, drawn from a \ref completion_pool when it is small
+/// enough. Completing it is a single atomic operation unless a thread is blocked in \ref wait or \ref get, and getting
+/// a result which is already in takes no lock. A continuation is a second (also pooled) allocation.
+template <typename T>
+class basic_future final
+{
+public:
+    using value_type = T;
+
+public:
+    /// Create a future without a state, which is not \ref valid.
+    basic_future() noexcept = default;
+
+    /// Adopt the reference to \a state. This is how \ref basic_promise makes its future.
+    explicit basic_future(detail::future_state_ptr<T> state) noexcept :
+            _state(std::move(state))
+    { }
+
+    basic_future(basic_future&&) noexcept = default;
+    basic_future& operator=(basic_future&&) noexcept = default;
+
+    /// Does this refer to a state? A future stops being valid once \ref get, \ref then or \ref on_ready is called.
+    bool valid() const noexcept
+    {
+        return _state != nullptr;
+    }
+
+    /// Is the result in, so \ref get will not block? This is \c false for a future which is not \ref valid.
+    bool is_ready() const noexcept
+    {
+        return _state && _state->is_ready();
+    }
+
+    /// Wait for the result and get it, or have the exception the promise was failed with thrown.
+    ///
+    /// \throws std::future_error with \c std::future_errc::no_state if this is not \ref valid.
+    T get()
+    {
+        auto state = take_state();
+        state->wait();
+        return state->take();
+    }
+
+    /// Wait for the result to be in.
+    ///
+    /// \note Do not call this from the thread which is to complete the promise (a completion thread or the thread of a
+    ///  \ref reactor::external), which would wait forever; use \ref then instead.
+    void wait() const
+    {
+        require_state().wait();
+    }
+
+    template <typename TRep, typename TPeriod>
+    std::future_status wait_for(const std::chrono::duration<TRep, TPeriod>& timeout) const
+    {
+        return wait_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    template <typename TClock, typename TDuration>
+    std::future_status wait_until(const std::chrono::time_point<TClock, TDuration>& deadline) const
+    {
+        return require_state().wait_until(deadline) ? std::future_status::ready : std::future_status::timeout;
+    }
+
+    /// Call \a on_result with this future once its result is in, and do not make another future for what it returns.
+    /// This is the cheapest way to react to a result. It runs on the thread which completes the promise, or right away
+    /// on this thread if the result is already in.
+    ///
+    /// \throws std::future_error with \c std::future_errc::no_state if this is not \ref valid.
+    template <typename FOnResult>
+    void on_ready(FOnResult&& on_result)
+    {
+        auto  state = take_state();
+        auto& raw   = *state;
+        raw.attach([state = std::move(state), on_result = std::forward<FOnResult>(on_result)] () mutable
+                   {
+                       on_result(basic_future(std::move(state)));
+                   }
+                  );
+    }
+
+    /// Get a future for what \a on_result returns once it is called with this future (which is ready by then). If it
+    /// returns a \c basic_future, the future returned by this one is for the result of that instead, so operations can
+    /// be chained. An exception thrown by \a on_result goes into the returned future.
+    ///
+    /// \a on_result runs on the thread which completes the promise, with the same restrictions as a \ref callback, or
+    /// right away on this thread if the result is already in.
+    ///
+    /// \throws std::future_error with \c std::future_errc::no_state if this is not \ref valid.
+    template <typename FContinue>
+    basic_future<detail::continuation_value_t<FContinue, T>> then(FContinue&& on_result)
+    {
+        return then(nullptr, std::forward<FContinue>(on_result));
+    }
+
+    /// Like \ref then, but \a on_result is run by \a where (when it is set).
+    template <typename FContinue>
+    basic_future<detail::continuation_value_t<FContinue, T>> then(std::shared_ptr<executor> where,
+                                                                   FContinue&&               on_result
+                                                                  );
+
+private:
+    detail::future_state_ptr<T> take_state()
+    {
+        require_state();
+        return std::move(_state);
+    }
+
+    detail::future_state<T>& require_state() const
+    {
+        if (!_state)
+            throw std::future_error(std::future_errc::no_state);
+        return *_state;
+    }
+
+private:
+    detail::future_state_ptr<T> _state;
+};
+
+/// The sending end of a \ref basic_future. It is used as \c std::promise is: set the result once with \ref set_value
+/// or \ref set_exception. Dropping a promise with no result fails its future with \c std::future_errc::broken_promise.
+template <typename T>
+class basic_promise final
+{
+public:
+    /// \throws std::bad_alloc if the shared state can not be allocated.
+    basic_promise() :
+            _state(new detail::future_state<T>())
+    { }
+
+    basic_promise(basic_promise&&) noexcept = default;
+
+    basic_promise& operator=(basic_promise&& src) noexcept
+    {
+        if (this != &src)
+        {
+            abandon();
+            _state = std::move(src._state);
+        }
+        return *this;
+    }
+
+    ~basic_promise() noexcept
+    {
+        abandon();
+    }
+
+    /// Does this have a state, i.e. has it not been moved from?
+    bool valid() const noexcept
+    {
+        return _state != nullptr;
+    }
+
+    /// Get the future for the result. This can only be called once.
+    ///
+    /// \throws std::future_error with \c std::future_errc::future_already_retrieved if it was called before.
+    basic_future<T> get_future()
+    {
+        auto& state = require_state();
+        if (std::exchange(state.retrieved, true))
+            throw std::future_error(std::future_errc::future_already_retrieved);
+
+        state.add_ref();
+        return basic_future<T>(detail::future_state_ptr<T>(&state));
+    }
+
+    /// Complete the future with a value made from \a args (nothing, for \c basic_promise<void>).
+    ///
+    /// \throws std::future_error with \c std::future_errc::promise_already_satisfied if the result was already set.
+    template <typename... TArgs>
+    void set_value(TArgs&&... args)
+    {
+        require_unsatisfied().set_value(std::forward<TArgs>(args)...);
+    }
+
+    /// Fail the future with \a error.
+    ///
+    /// \throws std::future_error with \c std::future_errc::promise_already_satisfied if the result was already set.
+    void set_exception(std::exception_ptr error)
+    {
+        require_unsatisfied().set_exception(std::move(error));
+    }
+
+private:
+    detail::future_state<T>& require_state() const
+    {
+        if (!_state)
+            throw std::future_error(std::future_errc::no_state);
+        return *_state;
+    }
+
+    detail::future_state<T>& require_unsatisfied() const
+    {
+        auto& state = require_state();
+        if (state.is_ready())
+            throw std::future_error(std::future_errc::promise_already_satisfied);
+        return state;
+    }
+
+    void abandon() noexcept
+    {
+        if (_state && !_state->is_ready())
+            _state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        _state.reset();
+    }
+
+private:
+    detail::future_state_ptr<T> _state;
+};
+
+/// Get a future which already holds \a value.
+template <typename T>
+basic_future<std::decay_t<T>> make_ready_future(T&& value)
+{
+    basic_promise<std::decay_t<T>> prom;
+    prom.set_value(std::forward<T>(value));
+    return prom.get_future();
+}
+
+/// Get a \c basic_future<void> which is already complete.
+inline basic_future<void> make_ready_future()
+{
+    basic_promise<void> prom;
+    prom.set_value();
+    return prom.get_future();
+}
+
+/// Get a future which has already failed with \a error.
+template <typename T>
+basic_future<T> make_exceptional_future(std::exception_ptr error)
+{
+    basic_promise<T> prom;
+    prom.set_exception(std::move(error));
+    return prom.get_future();
+}
+
+/// Get a future which is ready once every one of \a futures is. It holds them in the same order, each ready, so the
+/// results and failures of each can be looked at separately. No thread waits in the meantime.
+///
+/// \pre Every one of \a futures is \ref basic_future::valid.
+template <typename T>
+basic_future<std::vector<basic_future<T>>> when_all(std::vector<basic_future<T>> futures)
+{
+    struct context final
+    {
+        std::vector<basic_future<T>>                futures;
+        std::atomic<std::size_t>                    remaining;
+        basic_promise<std::vector<basic_future<T>>> prom;
+    };
+
+    basic_promise<std::vector<basic_future<T>>> prom;
+    auto out = prom.get_future();
+    if (futures.empty())
+    {
+        prom.set_value(std::move(futures));
+        return out;
+    }
+
+    auto ctx = make_pooled_shared<context>();
+    ctx->futures.resize(futures.size());
+    ctx->remaining.store(futures.size(), std::memory_order_relaxed);
+    ctx->prom = std::move(prom);
+    for (std::size_t idx = 0U; idx < futures.size(); ++idx)
+    {
+        // Each one only writes its own slot; the last to finish sees all of them through the decrement
+        futures[idx].on_ready([ctx, idx] (basic_future<T> ready)
+                              {
+                                  ctx->futures[idx] = std::move(ready);
+                                  if (ctx->remaining.fetch_sub(1U, std::memory_order_acq_rel) == 1U)
+                                      ctx->prom.set_value(std::move(ctx->futures));
+                              }
+                             );
+    }
+    return out;
+}
+
+/// What \ref when_any delivers: which of the futures was ready first, and that future.
+template <typename T>
+struct when_any_result final
+{
+    /// The position of \ref future in what was given to \ref when_any, or \c std::size_t(-1) if that was empty.
+    std::size_t     index;
+    basic_future<T> future;
+};
+
+/// Get a future which is ready as soon as any one of \a futures is, whether it succeeded or failed. The rest still
+/// complete, but their results are dropped; this suits asking several servers the same thing and taking the first
+/// answer. If \a futures is empty, the result is ready right away with an \c index of \c std::size_t(-1).
+///
+/// \pre Every one of \a futures is \ref basic_future::valid.
+template <typename T>
+basic_future<when_any_result<T>> when_any(std::vector<basic_future<T>> futures)
+{
+    struct context final
+    {
+        std::atomic<bool>                 done { false };
+        basic_promise<when_any_result<T>> prom;
+    };
+
+    basic_promise<when_any_result<T>> prom;
+    auto out = prom.get_future();
+    if (futures.empty())
+    {
+        prom.set_value(when_any_result<T>{ std::size_t(-1), basic_future<T>() });
+        return out;
+    }
+
+    auto ctx  = make_pooled_shared<context>();
+    ctx->prom = std::move(prom);
+    for (std::size_t idx = 0U; idx < futures.size(); ++idx)
+    {
+        futures[idx].on_ready([ctx, idx] (basic_future<T> ready)
+                              {
+                                  if (!ctx->done.exchange(true, std::memory_order_acq_rel))
+                                      ctx->prom.set_value(when_any_result<T>{ idx, std::move(ready) });
+                              }
+                             );
+    }
+    return out;
+}
+
+/// \}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                                                                     //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+
+/// Run \a on_result with \a ready and complete \a prom with what comes of it.
+template <typename TValue, typename FContinue, typename T>
+void run_continuation(FContinue& on_result, basic_future<T> ready, basic_promise<TValue>& prom)
+{
+    using result_type = std::invoke_result_t<FContinue&, basic_future<T>>;
+
+    try
+    {
+        if constexpr (std::is_same<result_type, basic_future<TValue>>::value)
+        {
+            auto inner = on_result(std::move(ready));
+            if (!inner.valid())
+                throw std::future_error(std::future_errc::no_state);
+
+            inner.on_ready([prom = std::move(prom)] (basic_future<TValue> done) mutable
+                           {
+                               try
+                               {
+                                   if constexpr (std::is_void<TValue>::value)
+                                   {
+                                       done.get();
+                                       prom.set_value();
+                                   }
+                                   else
+                                   {
+                                       prom.set_value(done.get());
+                                   }
+                               }
+                               catch (...)
+                               {
+                                   prom.set_exception(std::current_exception());
+                               }
+                           }
+                          );
+        }
+        else if constexpr (std::is_void<result_type>::value)
+        {
+            on_result(std::move(ready));
+            prom.set_value();
+        }
+        else
+        {
+            prom.set_value(on_result(std::move(ready)));
+        }
+    }
+    catch (...)
+    {
+        // An exception from attaching to the inner future comes after prom was handed to it
+        if (prom.valid())
+            prom.set_exception(std::current_exception());
+    }
+}
+
+}
+
+template <typename T>
+template <typename FContinue>
+basic_future<detail::continuation_value_t<FContinue, T>> basic_future<T>::then(std::shared_ptr<executor> where,
+                                                                                FContinue&&               on_result
+                                                                               )
+{
+    using value_type = detail::continuation_value_t<FContinue, T>;
+    using task_type  = std::tuple<basic_future, basic_promise<value_type>, std::decay_t<FContinue>>;
+
+    basic_promise<value_type> prom;
+    auto out = prom.get_future();
+    on_ready([where = std::move(where), prom = std::move(prom), on_result = std::forward<FContinue>(on_result)]
+             (basic_future ready) mutable
+             {
+                 if (!where)
+                     return detail::run_continuation(on_result, std::move(ready), prom);
+
+                 // An executor takes a std::function, which has to be copyable
+                 auto task = make_pooled_shared<task_type>(std::move(ready), std::move(prom), std::move(on_result));
+                 where->execute([task]
+                                {
+                                    detail::run_continuation(std::get<2>(*task),
+                                                             std::move(std::get<0>(*task)),
+                                                             std::get<1>(*task)
+                                                            );
+                                }
+                               );
+             }
+            );
+    return out;
+}
+
+}
@@ -0,0 +1,190 @@
+#include <zk/tests/test.hpp>
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "basic_future.hpp"
+#include "executor.hpp"
+
+namespace zk
+{
+
+GTEST_TEST(basic_future_tests, get_and_wait)
+{
+    basic_promise<std::string> prom;
+    auto fut = prom.get_future();
+    CHECK_TRUE(fut.valid());
+    CHECK_FALSE(fut.is_ready());
+    CHECK_TRUE(fut.wait_for(std::chrono::milliseconds(1)) == std::future_status::timeout);
+    CHECK_THROWS(std::future_error) { prom.get_future(); };
+
+    std::thread setter([&] { prom.set_value("done"); });
+    CHECK_EQ("done", fut.get());
+    CHECK_FALSE(fut.valid());
+    setter.join();
+    CHECK_THROWS(std::future_error) { prom.set_value("again"); };
+    CHECK_THROWS(std::future_error) { fut.get(); };
+}
+
+GTEST_TEST(basic_future_tests, failures)
+{
+    auto failed = make_exceptional_future<int>(std::make_exception_ptr(std::runtime_error("no")));
+    CHECK_TRUE(failed.is_ready());
+    CHECK_THROWS(std::runtime_error) { failed.get(); };
+
+    basic_future<void> broken;
+    {
+        basic_promise<void> prom;
+        broken = prom.get_future();
+    }
+    try
+    {
+        broken.get();
+        CHECK_FAIL() << "A promise which was let go of must break its future";
+    }
+    catch (const std::future_error& ex)
+    {
+        CHECK_TRUE(ex.code() == std::future_errc::broken_promise);
+    }
+}
+
+GTEST_TEST(basic_future_tests, then_chains)
+{
+    basic_promise<int> prom;
+    auto doubled = prom.get_future().then([] (basic_future<int> ready) { return ready.get() * 2; });
+
+    // A continuation returning a future is for the result of that future
+    basic_promise<std::string> inner;
+    auto inner_future = inner.get_future();
+    auto described    = doubled.then([&] (basic_future<int> ready)
+                                     {
+                                         auto value = ready.get();
+                                         return inner_future.then([value] (basic_future<std::string> text)
+                                                                  {
+                                                                      return text.get() + std::to_string(value);
+                                                                  }
+                                                                 );
+                                     }
+                                    );
+    CHECK_FALSE(doubled.valid());
+
+    prom.set_value(21);
+    CHECK_FALSE(described.is_ready());
+    inner.set_value("answer=");
+    CHECK_TRUE(described.is_ready());
+    CHECK_EQ("answer=42", described.get());
+
+    // Exceptions go down the chain, from a failed promise or from a continuation
+    auto rethrown = make_exceptional_future<int>(std::make_exception_ptr(std::runtime_error("first")))
+                   .then([] (basic_future<int> ready) { return ready.get() + 1; });
+    CHECK_THROWS(std::runtime_error) { rethrown.get(); };
+    auto thrown = make_ready_future(1).then([] (basic_future<int>) -> int { throw std::logic_error("then"); });
+    CHECK_THROWS(std::logic_error) { thrown.get(); };
+
+    auto finished = make_ready_future().then([] (basic_future<void> ready) { ready.get(); });
+    CHECK_TRUE(finished.is_ready());
+    finished.get();
+}
+
+GTEST_TEST(basic_future_tests, then_through_executor)
+{
+    auto pool   = thread_pool_executor(1U);
+    auto caller = std::this_thread::get_id();
+
+    basic_promise<int> prom;
+    auto seen_on = prom.get_future().then(pool, [] (basic_future<int> ready)
+                                                {
+                                                    ready.get();
+                                                    return std::this_thread::get_id();
+                                                }
+                                         );
+    prom.set_value(1);
+    CHECK_TRUE(seen_on.get() != caller);
+}
+
+GTEST_TEST(basic_future_tests, when_all)
+{
+    std::vector<basic_promise<int>> proms(3U);
+    std::vector<basic_future<int>>  futs;
+    for (auto& prom : proms)
+        futs.push_back(prom.get_future());
+
+    auto all = when_all(std::move(futs));
+    proms[2].set_value(3);
+    proms[0].set_value(1);
+    CHECK_FALSE(all.is_ready());
+    proms[1].set_exception(std::make_exception_ptr(std::runtime_error("middle")));
+
+    auto results = all.get();
+    CHECK_EQ(3U, results.size());
+    CHECK_EQ(1, results[0].get());
+    CHECK_THROWS(std::runtime_error) { results[1].get(); };
+    CHECK_EQ(3, results[2].get());
+
+    CHECK_TRUE(when_all(std::vector<basic_future<int>>()).get().empty());
+}
+
+GTEST_TEST(basic_future_tests, when_any)
+{
+    std::vector<basic_promise<std::string>> proms(3U);
+    std::vector<basic_future<std::string>>  futs;
+    for (auto& prom : proms)
+        futs.push_back(prom.get_future());
+
+    auto any = when_any(std::move(futs));
+    CHECK_FALSE(any.is_ready());
+    proms[1].set_value("second");
+    proms[0].set_value("first");
+
+    auto result = any.get();
+    CHECK_EQ(1U, result.index);
+    CHECK_EQ("second", result.future.get());
+
+    CHECK_EQ(std::size_t(-1), when_any(std::vector<basic_future<int>>()).get().index);
+}
+
+/// Completed on another thread while this one attaches and waits: each continuation runs once and every waiter wakes.
+GTEST_TEST(basic_future_tests, concurrent_completion)
+{
+    static constexpr int count = 200;
+
+    std::vector<basic_promise<int>> proms(count);
+    std::vector<basic_future<int>>  futs;
+    for (auto& prom : proms)
+        futs.push_back(prom.get_future());
+
+    std::thread setter([&]
+                       {
+                           for (int idx = 0; idx < count; ++idx)
+                               proms[std::size_t(idx)].set_value(idx);
+                       }
+                      );
+
+    // Racing the setter, so some continuations are attached before the result and some after
+    std::vector<basic_future<int>> chained;
+    std::vector<basic_future<int>> waited;
+    for (std::size_t idx = 0U; idx < futs.size(); ++idx)
+    {
+        if (idx % 2U == 0U)
+            chained.push_back(futs[idx].then([] (basic_future<int> ready) { return ready.get() + 1; }));
+        else
+            waited.push_back(std::move(futs[idx]));
+    }
+
+    int sum = 0;
+    for (auto& fut : waited)
+        sum += fut.get();
+    auto all = when_all(std::move(chained)).get();
+    for (auto& fut : all)
+        sum += fut.get();
+    setter.join();
+
+    // Everything from 0 to count - 1, plus one for each of the chained half
+    CHECK_EQ(count * (count - 1) / 2 + count / 2, sum);
+}
+
+}
@@ -0,0 +1,93 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <zk/results.hpp>
+#include <zk/small_buffer.hpp>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Buffer Types                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// What the choice of buffer type costs in the places the library makes one: copying the data of a reply into a new
+// buffer, copying one a caller holds on to and moving results around. The sizes straddle the inline capacity of
+// small_buffer, which only pays off below it.
+
+template <typename TBuffer>
+static void buffer_construct(benchmark::State& state)
+{
+    const std::string source(std::size_t(state.range(0)), 's');
+    for (auto _ : state)
+    {
+        TBuffer buf(source.data(), source.data() + source.size());
+        benchmark::DoNotOptimize(buf.data());
+    }
+    state.SetItemsProcessed(std::int64_t(state.iterations()));
+}
+BENCHMARK_TEMPLATE(buffer_construct, std::vector<char>)->Arg(8)->Arg(64)->Arg(256)->Arg(4096);
+BENCHMARK_TEMPLATE(buffer_construct, small_buffer)->Arg(8)->Arg(64)->Arg(256)->Arg(4096);
+
+template <typename TBuffer>
+static void buffer_copy(benchmark::State& state)
+{
+    const std::string source(std::size_t(state.range(0)), 's');
+    const TBuffer     original(source.data(), source.data() + source.size());
+    for (auto _ : state)
+    {
+        TBuffer copy(original);
+        benchmark::DoNotOptimize(copy.data());
+    }
+    state.SetItemsProcessed(std::int64_t(state.iterations()));
+}
+BENCHMARK_TEMPLATE(buffer_copy, std::vector<char>)->Arg(8)->Arg(64)->Arg(256);
+BENCHMARK_TEMPLATE(buffer_copy, small_buffer)->Arg(8)->Arg(64)->Arg(256);
+
+/// Collect 1000 buffers of \c range(0) bytes into a vector, the way a batch of read results piles up. Growing the
+/// vector moves every buffer already in it.
+template <typename TBuffer>
+static void buffer_collect(benchmark::State& state)
+{
+    const std::string source(std::size_t(state.range(0)), 's');
+    for (auto _ : state)
+    {
+        std::vector<TBuffer> results;
+        for (std::size_t idx = 0U; idx < 1000U; ++idx)
+            results.emplace_back(source.data(), source.data() + source.size());
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(std::int64_t(state.iterations()) * 1000);
+}
+BENCHMARK_TEMPLATE(buffer_collect, std::vector<char>)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(buffer_collect, small_buffer)->Arg(16)->Arg(256);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Fan-out                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Hand one result of \c range(1) bytes to 200 readers, owned (\c range(0) of \c 0) or shared (\c 1) the way a
+/// node_cache hands out what it holds.
+static void get_result_fan_out(benchmark::State& state)
+{
+    get_result source(buffer(std::size_t(state.range(1)), 'f'), stat());
+    if (state.range(0) != 0)
+        source.share();
+
+    std::vector<get_result> readers;
+    readers.reserve(200U);
+    for (auto _ : state)
+    {
+        for (std::size_t idx = 0U; idx < 200U; ++idx)
+            readers.push_back(source);
+        benchmark::DoNotOptimize(readers.data());
+        readers.clear();
+    }
+    state.SetItemsProcessed(std::int64_t(state.iterations()) * 200);
+}
+BENCHMARK(get_result_fan_out)->ArgsProduct({ { 0, 1 }, { 64, 4096 } });
+
+}
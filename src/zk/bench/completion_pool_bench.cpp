@@ -0,0 +1,177 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <zk/callback.hpp>
+#include <zk/completion_pool.hpp>
+#include <zk/future.hpp>
+#include <zk/results.hpp>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Allocation Counting                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Every allocation of the benchmark program goes through these, so the benchmarks below can report how many times an
+// operation reached the general allocator. Counting costs one relaxed increment, which the other benchmarks of the
+// program can afford. They are kept out of line, since GCC takes free after an inlined operator new for a mismatch.
+
+static std::atomic<std::uint64_t> heap_allocations { 0U };
+
+[[gnu::noinline]]
+void* operator new(std::size_t size)
+{
+    heap_allocations.fetch_add(1U, std::memory_order_relaxed);
+    if (auto p = std::malloc(size == 0U ? 1U : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]]
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+[[gnu::noinline]]
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Completion Records                                                                                                 //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// What the ZooKeeper C client connection allocates to carry one result back: a completer holding a promise (whose
+// shared state is an allocation of its own) or a callback, and a watcher behind a shared_ptr for watches. The plain
+// versions go to the general allocator, as the connection used to; the pooled ones draw from completion_pool. The
+// allocations counter is the number of trips to the general allocator per operation, which the pooled versions bring
+// down to zero once the pools are warm.
+
+struct plain_records
+{
+    struct completer
+    {
+        promise<get_result> prom;
+        char                probe[64];
+    };
+
+    static promise<get_result> make_promise() { return promise<get_result>(); }
+
+    template <typename T>
+    static std::shared_ptr<T> make_shared() { return std::make_shared<T>(); }
+};
+
+struct pooled_records
+{
+    struct completer :
+            pooled_completion
+    {
+        promise<get_result> prom = make_promise();
+        char                probe[64];
+    };
+
+    static promise<get_result> make_promise()
+    {
+        return promise<get_result>(std::allocator_arg, completion_allocator<get_result>());
+    }
+
+    template <typename T>
+    static std::shared_ptr<T> make_shared() { return make_pooled_shared<T>(); }
+};
+
+struct fake_watcher
+{
+    char state[160];
+};
+
+static void report_allocations(benchmark::State& state, std::uint64_t before)
+{
+    auto count = heap_allocations.load(std::memory_order_relaxed) - before;
+    state.counters["allocations"] = benchmark::Counter(double(count), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(std::int64_t(state.iterations()));
+}
+
+/// Submit and complete one read on the same thread.
+template <typename TRecords>
+static void completion_round_trip(benchmark::State& state)
+{
+    auto before = heap_allocations.load(std::memory_order_relaxed);
+    for (auto _ : state)
+    {
+        auto completer = std::make_unique<typename TRecords::completer>();
+        auto fut       = completer->prom.get_future();
+        completer->prom.set_value(get_result(buffer(), stat()));
+        completer.reset();
+        benchmark::DoNotOptimize(fut.get());
+    }
+    report_allocations(state, before);
+}
+BENCHMARK_TEMPLATE(completion_round_trip, plain_records);
+BENCHMARK_TEMPLATE(completion_round_trip, pooled_records);
+
+/// Set a watch: its watcher, the record for the initial read and the promise of its event.
+template <typename TRecords>
+static void completion_watch(benchmark::State& state)
+{
+    auto before = heap_allocations.load(std::memory_order_relaxed);
+    for (auto _ : state)
+    {
+        auto watcher   = TRecords::template make_shared<fake_watcher>();
+        auto completer = std::make_unique<typename TRecords::completer>();
+        auto event     = TRecords::make_promise();
+        benchmark::DoNotOptimize(watcher.get());
+        benchmark::DoNotOptimize(completer.get());
+        benchmark::DoNotOptimize(&event);
+    }
+    report_allocations(state, before);
+}
+BENCHMARK_TEMPLATE(completion_watch, plain_records);
+BENCHMARK_TEMPLATE(completion_watch, pooled_records);
+
+/// Records made on the benchmark thread and freed by another, in batches as a completion thread would see them.
+template <typename TRecords>
+static void completion_cross_thread(benchmark::State& state)
+{
+    using completer = typename TRecords::completer;
+    static constexpr std::size_t batch_size = 256U;
+
+    auto before = heap_allocations.load(std::memory_order_relaxed);
+    std::vector<std::unique_ptr<completer>> batch;
+    batch.reserve(batch_size);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        batch.clear();
+        state.ResumeTiming();
+
+        for (std::size_t idx = 0U; idx < batch_size; ++idx)
+            batch.emplace_back(std::make_unique<completer>());
+
+        std::thread([&batch]
+                    {
+                        for (auto& record : batch)
+                            record.reset();
+                    }
+                   ).join();
+    }
+    // The thread itself allocates, which is the same for both
+    report_allocations(state, before);
+    state.SetItemsProcessed(std::int64_t(state.iterations() * batch_size));
+}
+BENCHMARK_TEMPLATE(completion_cross_thread, plain_records);
+BENCHMARK_TEMPLATE(completion_cross_thread, pooled_records);
+
+}
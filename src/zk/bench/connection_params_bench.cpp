@@ -0,0 +1,27 @@
+#include <benchmark/benchmark.h>
+
+#include <zk/connection.hpp>
+
+namespace zk
+{
+
+static void connection_params_parse(benchmark::State& state)
+{
+    for (auto _ : state)
+        benchmark::DoNotOptimize(connection_params::parse("zk://localhost:2181/"));
+}
+BENCHMARK(connection_params_parse);
+
+static void connection_params_parse_full(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        auto params = connection_params::parse("zk://zk1.example.com:2181,zk2.example.com:2181,zk3.example.com:2181"
+                                               "/service/chroot?randomize_hosts=false&read_only=true&timeout=3.5"
+                                              );
+        benchmark::DoNotOptimize(params);
+    }
+}
+BENCHMARK(connection_params_parse_full);
+
+}
@@ -0,0 +1,61 @@
+#include <benchmark/benchmark.h>
+
+#include <zk/callback.hpp>
+#include <zk/future.hpp>
+#include <zk/results.hpp>
+
+namespace zk
+{
+
+// What a single operation pays to deliver its result, without the network: creating the shared state, completing it
+// from the "completion thread" and getting the value back on the caller's side.
+
+static void future_round_trip(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        promise<int> prom;
+        auto fut = prom.get_future();
+        prom.set_value(42);
+        benchmark::DoNotOptimize(fut.get());
+    }
+}
+BENCHMARK(future_round_trip);
+
+static void future_round_trip_result(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        promise<exists_result> prom;
+        auto fut = prom.get_future();
+        prom.set_value(exists_result(stat()));
+        benchmark::DoNotOptimize(fut.get());
+    }
+}
+BENCHMARK(future_round_trip_result);
+
+/// The cost of the callback form of an operation, which skips the shared state entirely.
+static void callback_invoke(benchmark::State& state)
+{
+    int           total = 0;
+    callback<int> on_complete = [&total] (outcome<int> result) { total += result.value(); };
+    for (auto _ : state)
+    {
+        on_complete(outcome<int>(1));
+        benchmark::DoNotOptimize(total);
+    }
+}
+BENCHMARK(callback_invoke);
+
+/// A callback adapted back into a future, which is what the default implementations of \c connection do.
+static void future_from_callback_round_trip(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        auto fut = future_from_callback<int>([] (callback<int> cb) { cb(outcome<int>(42)); });
+        benchmark::DoNotOptimize(fut.get());
+    }
+}
+BENCHMARK(future_from_callback_round_trip);
+
+}
@@ -0,0 +1,106 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <zk/jute.hpp>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Encoding                                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Framing a set_data request of range(0) bytes, either copied into a message of its own or gathered from where the path
+// and data already are. The copy is what a sender with no use for writev pays; the gather writer only has to produce a
+// handful of pieces whatever the size of the data.
+
+static const std::string bench_path = "/service/configuration/entries/large-entry-with-a-long-name";
+
+template <typename TWriter>
+static void write_set_data(TWriter& out, const buffer& data)
+{
+    out.write_int(1);
+    out.write_int(static_cast<std::int32_t>(jute_op::set_data));
+    out.write_string(bench_path);
+    out.write_buffer(data);
+    out.write_int(-1);
+}
+
+static void jute_encode_set_data_copied(benchmark::State& state)
+{
+    const buffer data(std::size_t(state.range(0)), 'd');
+    for (auto _ : state)
+    {
+        jute_writer out(bench_path.size() + data.size() + 16U);
+        write_set_data(out, data);
+        benchmark::DoNotOptimize(std::move(out).finish());
+    }
+    state.SetBytesProcessed(std::int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(jute_encode_set_data_copied)->Range(16, 1 << 20);
+
+static void jute_encode_set_data_gathered(benchmark::State& state)
+{
+    const buffer       data(std::size_t(state.range(0)), 'd');
+    jute_gather_writer out;
+    for (auto _ : state)
+    {
+        out.clear();
+        write_set_data(out, data);
+        benchmark::DoNotOptimize(out.finish().data());
+    }
+    state.SetBytesProcessed(std::int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(jute_encode_set_data_gathered)->Range(16, 1 << 20);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Decoding                                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// A stream of \c range(0) get_data replies with 100 bytes of data each, split into messages and read in place.
+static void jute_decode_get_replies(benchmark::State& state)
+{
+    std::vector<char> stream;
+    const std::string data(100U, 'v');
+    for (std::int64_t idx = 0; idx < state.range(0); ++idx)
+    {
+        jute_writer reply;
+        reply.write_int(std::int32_t(idx));
+        reply.write_long(idx);
+        reply.write_int(0);
+        reply.write_string(data);
+        for (int field = 0; field < 4; ++field)
+            reply.write_long(1514764800000);
+        for (int field = 0; field < 3; ++field)
+            reply.write_int(field);
+        reply.write_long(0);
+        reply.write_int(std::int32_t(data.size()));
+        reply.write_int(0);
+        reply.write_long(idx);
+
+        auto message = std::move(reply).finish();
+        stream.insert(stream.end(), message.begin(), message.end());
+    }
+
+    for (auto _ : state)
+    {
+        const char* iter = stream.data();
+        jute_reader body;
+        while (next_jute_message(iter, stream.data() + stream.size(), body))
+        {
+            benchmark::DoNotOptimize(body.read_int());
+            benchmark::DoNotOptimize(body.read_long());
+            benchmark::DoNotOptimize(body.read_int());
+            benchmark::DoNotOptimize(body.read_buffer());
+            benchmark::DoNotOptimize(body.read_stat());
+        }
+    }
+    state.SetItemsProcessed(std::int64_t(state.iterations()) * state.range(0));
+    state.SetBytesProcessed(std::int64_t(state.iterations()) * std::int64_t(stream.size()));
+}
+BENCHMARK(jute_decode_get_replies)->Arg(1)->Arg(64);
+
+}
@@ -0,0 +1,251 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <zk/detail/native.hpp>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Decoding                                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void native_stat_from_raw(benchmark::State& state)
+{
+    struct Stat raw{};
+    raw.czxid       = 0x100000002;
+    raw.mzxid       = 0x100000009;
+    raw.ctime       = 1514764800000;
+    raw.mtime       = 1514764801234;
+    raw.version     = 3;
+    raw.dataLength  = 120;
+    raw.numChildren = 4;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(raw);
+        benchmark::DoNotOptimize(stat_from_raw(raw));
+    }
+}
+BENCHMARK(native_stat_from_raw);
+
+/// Names shaped like the children of a lock or queue directory, held in the \c String_vector layout of the C client.
+class raw_children final
+{
+public:
+    explicit raw_children(std::size_t count)
+    {
+        _names.reserve(count);
+        for (std::size_t idx = 0U; idx < count; ++idx)
+        {
+            auto digits = std::to_string(idx);
+            _names.emplace_back("lock-" + std::string(10U - digits.size(), '0') + digits);
+        }
+        for (auto& name : _names)
+            _pointers.emplace_back(&name[0]);
+
+        _raw.count = std::int32_t(_pointers.size());
+        _raw.data  = _pointers.data();
+    }
+
+    const struct String_vector& raw() const { return _raw; }
+
+private:
+    std::vector<std::string> _names;
+    std::vector<ptr<char>>   _pointers;
+    struct String_vector     _raw;
+};
+
+static void native_string_vector_from_raw(benchmark::State& state)
+{
+    raw_children children(std::size_t(state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(string_vector_from_raw(children.raw()));
+    state.SetItemsProcessed(std::int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(native_string_vector_from_raw)->Range(8, 1 << 16);
+
+static void native_children_list_from_raw(benchmark::State& state)
+{
+    raw_children children(std::size_t(state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(children_list_from_raw(children.raw()));
+    state.SetItemsProcessed(std::int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(native_children_list_from_raw)->Range(8, 1 << 16);
+
+static void native_acl_from_raw(benchmark::State& state)
+{
+    char world[]  = "world";
+    char anyone[] = "anyone";
+    char digest[] = "digest";
+    char user[]   = "user:Hz0yV3x0LcQ1bLrMWx9n2cj4Hus=";
+    ACL  parts[]  = { ACL{ static_cast<std::int32_t>(permission::read), Id{ world, anyone } },
+                      ACL{ static_cast<std::int32_t>(permission::all),  Id{ digest, user } },
+                    };
+
+    ACL_vector raw;
+    raw.count = 2;
+    raw.data  = parts;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(acl_from_raw(raw));
+}
+BENCHMARK(native_acl_from_raw);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Encoding                                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void native_with_str_view(benchmark::State& state)
+{
+    std::string storage = "/service/config/shards/0000000042/leader";
+    string_view path    = string_view(storage).substr(0, storage.size() - 7U);
+    for (auto _ : state)
+        with_str(path, [] (ptr<const char> p) noexcept { benchmark::DoNotOptimize(p); });
+}
+BENCHMARK(native_with_str_view);
+
+static void native_with_str_terminated(benchmark::State& state)
+{
+    zk::path path("/service/config/shards/0000000042/leader");
+    for (auto _ : state)
+        with_str(path_view(path), [] (ptr<const char> p) noexcept { benchmark::DoNotOptimize(p); });
+}
+BENCHMARK(native_with_str_terminated);
+
+static void native_with_acl(benchmark::State& state)
+{
+    acl rules = { acl_rule("world", "anyone", permission::read),
+                  acl_rule("digest", "user:Hz0yV3x0LcQ1bLrMWx9n2cj4Hus=", permission::all),
+                };
+    for (auto _ : state)
+        with_acl(rules, [] (ptr<ACL_vector> vec) noexcept { benchmark::DoNotOptimize(vec); });
+}
+BENCHMARK(native_with_acl);
+
+/// A transaction of \c count operations, half creations (with their ACLs) and half sets.
+static multi_op bench_transaction(std::int64_t count)
+{
+    std::vector<op> ops;
+    for (std::int64_t idx = 0; idx < count; ++idx)
+    {
+        auto path = "/txn/entry-" + std::to_string(idx);
+        if (idx % 2 == 0)
+            ops.emplace_back(op::create(path, buffer(64U, 'x'), acls::open_unsafe(), create_mode::sequential));
+        else
+            ops.emplace_back(op::set(path, buffer(64U, 'y'), version(3)));
+    }
+    return multi_op(std::move(ops));
+}
+
+/// The encoding \c commit does before \c zoo_amulti for a plain \ref multi_op: every part of every operation, along
+/// with the buffers for the results.
+static void native_encode_multi(benchmark::State& state)
+{
+    auto txn = bench_transaction(state.range(0));
+    for (auto _ : state)
+    {
+        multi_op_encoding encoding(txn);
+        auto buffers = encoding.make_buffers();
+        benchmark::DoNotOptimize(encoding.bind(txn, buffers));
+    }
+    state.SetItemsProcessed(std::int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(native_encode_multi)->Range(1, 4096);
+
+/// The same transaction as a \ref prepared_multi in a compare-and-swap loop: the version of each set is rebound, then
+/// only the data and versions are encoded.
+static void native_encode_prepared(benchmark::State& state)
+{
+    prepared_multi txn(bench_transaction(state.range(0)),
+                       [] (const multi_op& src) { return std::make_shared<const multi_op_encoding>(src); }
+                      );
+    const auto& encoding = static_cast<const multi_op_encoding&>(*txn.encoded());
+
+    std::int32_t attempt = 0;
+    for (auto _ : state)
+    {
+        ++attempt;
+        for (std::size_t idx = 1U; idx < txn.size(); idx += 2U)
+            txn.bind_version(idx, version(attempt));
+        auto buffers = encoding.make_buffers();
+        benchmark::DoNotOptimize(encoding.bind(txn.ops(), buffers));
+    }
+    state.SetItemsProcessed(std::int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(native_encode_prepared)->Range(1, 4096);
+
+/// What a caller which keeps its own paths and data pays to commit them: copying everything into a \ref multi_op (with
+/// \c range(1) of \c 0) or viewing it (\c 1), then the encoding.
+static void native_encode_from_caller(benchmark::State& state)
+{
+    std::vector<std::string> paths;
+    for (std::int64_t idx = 0; idx < state.range(0); ++idx)
+        paths.push_back("/txn/entry-" + std::to_string(idx));
+    const std::string data(256U, 'd');
+
+    multi_op_view view;
+    for (auto _ : state)
+    {
+        if (state.range(1) == 0)
+        {
+            multi_op txn;
+            txn.reserve(paths.size());
+            for (const auto& path : paths)
+                txn.push_back(op::set(path, buffer(data.data(), data.data() + data.size()), version(3)));
+            multi_op_encoding encoding(txn);
+            auto buffers = encoding.make_buffers();
+            benchmark::DoNotOptimize(encoding.bind(txn, buffers));
+        }
+        else
+        {
+            view.clear();
+            for (const auto& path : paths)
+                view.push_back(op_view::set(path, data, version(3)));
+            multi_op_encoding encoding(view);
+            auto buffers = encoding.make_buffers();
+            benchmark::DoNotOptimize(encoding.bind(view, buffers));
+        }
+    }
+    state.SetItemsProcessed(std::int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(native_encode_from_caller)->ArgsProduct({ { 8, 512 }, { 0, 1 } });
+
+/// Building and encoding \c range(0) creations with a two-rule ACL given as an \ref acl (with \c range(1) of \c 0),
+/// which each operation copies and encodes, or as an interned \ref acl_handle (\c 1).
+static void native_encode_creations(benchmark::State& state)
+{
+    const acl rules = { acl_rule("world", "anyone", permission::read),
+                        acl_rule("digest", "user:Hz0yV3x0LcQ1bLrMWx9n2cj4Hus=", permission::all),
+                      };
+    const auto handle = acl_handle::intern(rules);
+
+    std::vector<std::string> paths;
+    for (std::int64_t idx = 0; idx < state.range(0); ++idx)
+        paths.push_back("/locks/worker-" + std::to_string(idx));
+
+    for (auto _ : state)
+    {
+        multi_op txn;
+        txn.reserve(paths.size());
+        for (const auto& path : paths)
+        {
+            if (state.range(1) == 0)
+                txn.push_back(op::create(path, buffer(), rules, create_mode::ephemeral));
+            else
+                txn.push_back(op::create(path, buffer(), handle, create_mode::ephemeral));
+        }
+        multi_op_encoding encoding(txn);
+        auto buffers = encoding.make_buffers();
+        benchmark::DoNotOptimize(encoding.bind(txn, buffers));
+    }
+    state.SetItemsProcessed(std::int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(native_encode_creations)->ArgsProduct({ { 8, 512 }, { 0, 1 } });
+
+}
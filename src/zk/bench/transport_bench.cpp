@@ -0,0 +1,174 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <zk/client.hpp>
+#include <zk/jute.hpp>
+#include <zk/reactor.hpp>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pipelined Reads                                                                                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The round trips of a zkn:// session against a server on the loopback interface which answers every request with
+// the same small entry. The server is as cheap as it can be made (it answers everything it read with one send), so
+// what changes between the transports is the cost on the client side: the system calls made per request and how
+// many of them a batch of pipelined requests shares.
+
+/// Serves one session at a time, answering each request with \c "value" and the stat of a freshly created entry.
+class pipelined_server final
+{
+public:
+    pipelined_server() :
+            _listener(::socket(AF_INET, SOCK_STREAM, 0))
+    {
+        ::sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(_listener, reinterpret_cast<ptr<::sockaddr>>(&addr), sizeof addr);
+        ::listen(_listener, 4);
+
+        socklen_t len = sizeof addr;
+        ::getsockname(_listener, reinterpret_cast<ptr<::sockaddr>>(&addr), &len);
+        _port = ntohs(addr.sin_port);
+
+        _worker = std::thread([this] { run(); });
+    }
+
+    ~pipelined_server() noexcept
+    {
+        ::shutdown(_listener, SHUT_RDWR);
+        _worker.join();
+        ::close(_listener);
+    }
+
+    std::string connection_string(io_transport transport) const
+    {
+        return "zkn://127.0.0.1:" + std::to_string(_port) + "/?transport=" + to_string(transport);
+    }
+
+private:
+    void run()
+    {
+        int fd;
+        while ((fd = ::accept(_listener, nullptr, nullptr)) != -1)
+        {
+            serve(fd);
+            ::close(fd);
+        }
+    }
+
+    void serve(int fd)
+    {
+        std::vector<char> in(1U << 20);
+        std::size_t       used = 0U;
+        bool              handshaken = false;
+        while (true)
+        {
+            auto got = ::recv(fd, in.data() + used, in.size() - used, 0);
+            if (got <= 0)
+                return;
+            used += std::size_t(got);
+
+            std::vector<char> out;
+            const char*       iter = in.data();
+            jute_reader       body;
+            while (next_jute_message(iter, in.data() + used, body))
+            {
+                jute_writer reply;
+                if (!handshaken)
+                {
+                    body.read_int();
+                    body.read_long();
+                    auto timeout = body.read_int();
+                    reply.write_int(0);
+                    reply.write_int(timeout);
+                    reply.write_long(1);
+                    reply.write_string(std::string(jute_password_size, 'p'));
+                    reply.write_bool(false);
+                    handshaken = true;
+                }
+                else
+                {
+                    auto xid = body.read_int();
+                    auto op  = static_cast<jute_op>(body.read_int());
+                    reply.write_int(xid);
+                    reply.write_long(1);
+                    reply.write_int(0);
+                    if (op == jute_op::get_data)
+                    {
+                        reply.write_string("value");
+                        for (int idx = 0; idx < 4; ++idx)
+                            reply.write_long(1);
+                        for (int idx = 0; idx < 3; ++idx)
+                            reply.write_int(0);
+                        reply.write_long(0);
+                        reply.write_int(5);
+                        reply.write_int(0);
+                        reply.write_long(1);
+                    }
+                }
+
+                auto message = std::move(reply).finish();
+                out.insert(out.end(), message.begin(), message.end());
+            }
+
+            auto offset = std::size_t(iter - in.data());
+            std::copy(in.begin() + std::ptrdiff_t(offset), in.begin() + std::ptrdiff_t(used), in.begin());
+            used -= offset;
+            if (!out.empty() && ::send(fd, out.data(), out.size(), MSG_NOSIGNAL) != ssize_t(out.size()))
+                return;
+        }
+    }
+
+private:
+    int           _listener;
+    std::uint16_t _port;
+    std::thread   _worker;
+};
+
+/// Reads \c range(1) entries at a time over the transport \c range(0) (\c 0 for \ref io_transport::epoll and \c 1 for
+/// \ref io_transport::io_uring); each batch is sent before any of it is waited on.
+static void transport_pipelined_get(benchmark::State& state)
+{
+    auto transport = static_cast<io_transport>(state.range(0));
+    auto depth     = std::size_t(state.range(1));
+    if (reactor::shared(transport)->transport() != transport)
+    {
+        state.SkipWithError("io_uring is not available on this kernel");
+        return;
+    }
+
+    pipelined_server server;
+    client           c = client::connect(server.connection_string(transport)).get();
+
+    std::vector<future<get_result>> pending;
+    pending.reserve(depth);
+    for (auto _ : state)
+    {
+        for (std::size_t idx = 0U; idx < depth; ++idx)
+            pending.emplace_back(c.get("/entry"));
+        for (auto& result : pending)
+            benchmark::DoNotOptimize(result.get());
+        pending.clear();
+    }
+    state.SetItemsProcessed(std::int64_t(state.iterations()) * state.range(1));
+    state.SetLabel(to_string(transport));
+
+    c.close();
+}
+BENCHMARK(transport_pipelined_get)->ArgsProduct({ { 0, 1 }, { 1, 16, 256 } })->UseRealTime();
+
+}
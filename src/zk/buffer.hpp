@@ -24,10 +24,18 @@
 #   define ZKPP_BUFFER_USE_CUSTOM 0
 #endif
 
+/// \def ZKPP_BUFFER_USE_SMALL
+/// Set this to 1 to use \ref zk::small_buffer for the implementation of \ref zk::buffer. It keeps contents of up to
+/// \ref zk::small_buffer::inline_capacity bytes without allocating, which suits programs whose entries mostly hold a few
+/// bytes.
+#ifndef ZKPP_BUFFER_USE_SMALL
+#   define ZKPP_BUFFER_USE_SMALL 0
+#endif
+
 /// \def ZKPP_BUFFER_USE_STD_VECTOR
 /// Set this to 1 to use \c std::vector<char> for the implementation of \ref zk::buffer. This is the default behavior.
 #ifndef ZKPP_BUFFER_USE_STD_VECTOR
-#   if ZKPP_BUFFER_USE_CUSTOM
+#   if ZKPP_BUFFER_USE_CUSTOM || ZKPP_BUFFER_USE_SMALL
 #       define ZKPP_BUFFER_USE_STD_VECTOR 0
 #   else
 #       define ZKPP_BUFFER_USE_STD_VECTOR 1
@@ -37,6 +45,9 @@
 #if ZKPP_BUFFER_USE_STD_VECTOR
 #   define ZKPP_BUFFER_INCLUDE <vector>
 #   define ZKPP_BUFFER_TYPE std::vector<char>
+#elif ZKPP_BUFFER_USE_SMALL
+#   define ZKPP_BUFFER_INCLUDE <zk/small_buffer.hpp>
+#   define ZKPP_BUFFER_TYPE zk::small_buffer
 #elif ZKPP_BUFFER_USE_CUSTOM
 #   if !defined ZKPP_BUFFER_INCLUDE || !defined ZKPP_BUFFER_TYPE
 #       error "When ZKPP_BUFFER_USE_CUSTOM is set, you must also define ZKPP_BUFFER_INCLUDE and ZKPP_BUFFER_TYPE"
@@ -56,7 +67,8 @@ namespace zk
 /// \{
 
 /// The \c buffer type. By default, this is an \c std::vector<char>, but this can be altered by compile-time flags such
-/// as \ref ZKPP_BUFFER_USE_CUSTOM. The requirements for a custom buffer are minimal -- the type must fit this criteria:
+/// as \ref ZKPP_BUFFER_USE_SMALL or \ref ZKPP_BUFFER_USE_CUSTOM. The requirements for a custom buffer are minimal --
+/// the type must fit this criteria:
 ///
 /// | expression            | type                      | description                                                  |
 /// |:----------------------|:--------------------------|:-------------------------------------------------------------|
@@ -0,0 +1,161 @@
+#include "buffer_pool.hpp"
+
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Buffer Traits                                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The buffer concept (see buffer.hpp) is very small, so storage reuse is only done when the buffer happens to support
+// it. These overloads pick the best available option; the int/long parameter is only there to rank them.
+
+// Contents held inside the buffer object (as small_buffer does for short ones) have no storage to hand on, so they
+// count as no capacity at all.
+template <typename TBuffer>
+static auto buffer_capacity(const TBuffer& buf, int) -> decltype(bool(buf.is_inline()), std::size_t(buf.capacity()))
+{
+    return buf.is_inline() ? 0U : std::size_t(buf.capacity());
+}
+
+template <typename TBuffer>
+static auto buffer_capacity(const TBuffer& buf, long) -> decltype(std::size_t(buf.capacity()))
+{
+    return std::size_t(buf.capacity());
+}
+
+template <typename TBuffer>
+static std::size_t buffer_capacity(const TBuffer&, ...)
+{
+    return 0U;
+}
+
+template <typename TBuffer>
+static auto buffer_assign_impl(TBuffer& target, ptr<const char> first, ptr<const char> last, int)
+        -> decltype(target.assign(first, last), void())
+{
+    target.assign(first, last);
+}
+
+template <typename TBuffer>
+static auto buffer_assign_impl(TBuffer& target, ptr<const char> first, ptr<const char> last, long)
+        -> decltype(target = TBuffer(first, last), void())
+{
+    target = TBuffer(first, last);
+}
+
+template <typename TBuffer>
+static void buffer_assign_impl(TBuffer& target, ptr<const char> first, ptr<const char> last, ...)
+{
+    // Neither assignable nor assign-able -- all we are promised is move construction.
+    TBuffer replacement(first, last);
+    target.~TBuffer();
+    new (&target) TBuffer(std::move(replacement));
+}
+
+template <typename TBuffer>
+static constexpr auto buffer_is_recyclable(int)
+        -> decltype(std::declval<TBuffer&>().assign(ptr<const char>(), ptr<const char>()),
+                    std::declval<const TBuffer&>().capacity(),
+                    bool()
+                   )
+{
+    return true;
+}
+
+template <typename TBuffer>
+static constexpr bool buffer_is_recyclable(long)
+{
+    return false;
+}
+
+void buffer_assign(buffer& target, ptr<const char> first, ptr<const char> last)
+{
+    buffer_assign_impl(target, first, last, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// buffer_pool                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr std::size_t buffer_pool::default_max_idle;
+constexpr std::size_t buffer_pool::default_max_retained_size;
+
+buffer_pool::buffer_pool(std::size_t max_idle, std::size_t max_retained_size) :
+        _max_idle(max_idle),
+        _max_retained_size(max_retained_size)
+{
+    _idle.reserve(_max_idle);
+}
+
+buffer_pool::~buffer_pool() noexcept
+{ }
+
+buffer buffer_pool::acquire(ptr<const char> first, ptr<const char> last)
+{
+    if (!buffer_is_recyclable<buffer>(0))
+        return buffer(first, last);
+
+    auto needed = std::size_t(last - first);
+
+    std::unique_lock<std::mutex> ax(_protect);
+    if (_idle.empty())
+    {
+        ax.unlock();
+        return buffer(first, last);
+    }
+
+    auto best = _idle.end();
+    for (auto iter = _idle.begin(); iter != _idle.end(); ++iter)
+    {
+        auto cap = buffer_capacity(*iter, 0);
+        if (best == _idle.end())
+        {
+            best = iter;
+        }
+        else
+        {
+            auto best_cap = buffer_capacity(*best, 0);
+            bool fits      = cap >= needed;
+            bool best_fits = best_cap >= needed;
+            if (fits ? (!best_fits || cap < best_cap) : (!best_fits && cap > best_cap))
+                best = iter;
+        }
+    }
+
+    buffer out(std::move(*best));
+    if (best != _idle.end() - 1)
+        std::iter_swap(best, _idle.end() - 1);
+    _idle.pop_back();
+    ax.unlock();
+
+    buffer_assign(out, first, last);
+    return out;
+}
+
+void buffer_pool::release(buffer&& buf) noexcept
+{
+    if (!buffer_is_recyclable<buffer>(0))
+        return;
+
+    auto cap = buffer_capacity(buf, 0);
+    if (cap == 0U || cap > _max_retained_size)
+        return;
+
+    std::unique_lock<std::mutex> ax(_protect);
+    if (_idle.size() < _max_idle)
+        _idle.emplace_back(std::move(buf));
+}
+
+std::size_t buffer_pool::idle_count() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return _idle.size();
+}
+
+}
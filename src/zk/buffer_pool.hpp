@@ -0,0 +1,72 @@
+/// \file
+/// Defines \ref zk::buffer_pool for recycling the storage of read payloads.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "buffer.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// A thread-safe cache of idle \ref buffer storage. When a connection is given a pool (see
+/// \ref connection_params::read_buffer_pool), the data of every \ref get_result is copied into a buffer drawn from the
+/// pool and the storage is handed back when the \c get_result is destroyed. Once the pool has warmed up, reading
+/// payloads of similar sizes does not allocate.
+///
+/// Storage can only be recycled if the \ref buffer type supports it (it has \c capacity() and \c assign(ib, ie)
+/// members, as \c std::vector does). With other buffer types, the pool still works but never retains anything. A
+/// \ref small_buffer is only retained when its contents have grown onto the heap; short ones have nothing to recycle.
+class buffer_pool final
+{
+public:
+    static constexpr std::size_t default_max_idle          = 64;
+    static constexpr std::size_t default_max_retained_size = 4U * 1024U * 1024U;
+
+public:
+    /// Create a pool.
+    ///
+    /// \param max_idle The maximum number of idle buffers kept by the pool. Buffers released when the pool is full are
+    ///  freed.
+    /// \param max_retained_size Buffers with a capacity larger than this are freed instead of retained, so a single
+    ///  unusually large read does not pin memory forever.
+    explicit buffer_pool(std::size_t max_idle          = default_max_idle,
+                         std::size_t max_retained_size = default_max_retained_size
+                        );
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    ~buffer_pool() noexcept;
+
+    /// Get a buffer holding a copy of the range [\a first, \a last). The idle buffer with the smallest capacity which
+    /// fits the range is used; if none fit, the largest idle buffer is grown.
+    buffer acquire(ptr<const char> first, ptr<const char> last);
+
+    /// Give the storage of \a buf back to the pool. The contents are discarded.
+    void release(buffer&& buf) noexcept;
+
+    /// The number of buffers currently sitting idle in the pool.
+    std::size_t idle_count() const;
+
+private:
+    std::size_t         _max_idle;
+    std::size_t         _max_retained_size;
+    mutable std::mutex  _protect;
+    std::vector<buffer> _idle;
+};
+
+/// Replace the contents of \a target with a copy of the range [\a first, \a last). If the \ref buffer type supports
+/// \c assign, the existing storage of \a target is reused.
+void buffer_assign(buffer& target, ptr<const char> first, ptr<const char> last);
+
+/// \}
+
+}
@@ -0,0 +1,121 @@
+#include <zk/tests/test.hpp>
+
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "buffer_pool.hpp"
+#include "results.hpp"
+
+namespace zk
+{
+
+// Every buffer taken from it is larger than what a small_buffer holds inline (ZKPP_BUFFER_USE_SMALL), so it is kept on
+// the heap and the pool has storage to reuse, whichever buffer type is used
+static const char sample[] = "0123456789abcdefghijklmnopqrstuvwxyz"
+                             "0123456789abcdefghijklmnopqrstuvwxyz"
+                             "0123456789abcdefghijklmnopqrstuvwxyz"
+                             "0123456789abcdefghijklmnopqrstuvwxyz"
+                             "0123456789abcdefghijklmnopqrstuvwxyz"
+                             "0123456789abcdefghijklmnopqrstuvwxyz"
+                             "0123456789abcdefghijklmnopqrstuvwxyz";
+
+GTEST_TEST(buffer_pool_tests, acquire_copies)
+{
+    buffer_pool pool;
+    auto buf = pool.acquire(sample, sample + 10);
+    CHECK_EQ(10U, buf.size());
+    CHECK_EQ(0, std::memcmp(sample, buf.data(), 10));
+}
+
+GTEST_TEST(buffer_pool_tests, storage_is_reused)
+{
+    buffer_pool pool;
+    auto buf = pool.acquire(sample, sample + 200);
+    auto storage = buf.data();
+    pool.release(std::move(buf));
+    CHECK_EQ(1U, pool.idle_count());
+
+    auto again = pool.acquire(sample + 5, sample + 105);
+    CHECK_EQ(storage, again.data());
+    CHECK_EQ(0U, pool.idle_count());
+    CHECK_EQ(0, std::memcmp(sample + 5, again.data(), 100));
+}
+
+GTEST_TEST(buffer_pool_tests, best_fit)
+{
+    buffer_pool pool;
+    auto small = pool.acquire(sample, sample + 80);
+    auto large = pool.acquire(sample, sample + 240);
+    auto large_storage = large.data();
+    pool.release(std::move(small));
+    pool.release(std::move(large));
+
+    auto got = pool.acquire(sample, sample + 200);
+    CHECK_EQ(large_storage, got.data());
+}
+
+GTEST_TEST(buffer_pool_tests, limits)
+{
+    buffer_pool pool(2U, 160U);
+    pool.release(buffer(sample, sample + 240));
+    CHECK_EQ(0U, pool.idle_count());
+
+    pool.release(buffer(sample, sample + 80));
+    pool.release(buffer(sample, sample + 80));
+    pool.release(buffer(sample, sample + 80));
+    CHECK_EQ(2U, pool.idle_count());
+
+    pool.release(buffer());
+    CHECK_EQ(2U, pool.idle_count());
+}
+
+GTEST_TEST(buffer_pool_tests, get_result_returns_on_destruction)
+{
+    auto pool = std::make_shared<buffer_pool>();
+    {
+        get_result res(pool->acquire(sample, sample + 120), stat(), pool);
+        get_result moved(std::move(res));
+        CHECK_EQ(0U, pool->idle_count());
+    }
+    CHECK_EQ(1U, pool->idle_count());
+
+    {
+        get_result res(pool->acquire(sample, sample + 120), stat(), pool);
+        buffer taken = std::move(res).data();
+        CHECK_EQ(120U, taken.size());
+    }
+    // The data was moved out, so there is nothing to give back
+    CHECK_EQ(0U, pool->idle_count());
+}
+
+GTEST_TEST(buffer_pool_tests, concurrent)
+{
+    buffer_pool pool;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&pool]
+                             {
+                                 for (int i = 0; i < 1000; ++i)
+                                     pool.release(pool.acquire(sample, sample + (i % 30)));
+                             }
+                            );
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    CHECK_LE(pool.idle_count(), 4U);
+}
+
+GTEST_TEST(buffer_pool_tests, buffer_assign)
+{
+    buffer target(sample, sample + 240);
+    auto storage = target.data();
+    buffer_assign(target, sample + 1, sample + 3);
+    CHECK_EQ(2U, target.size());
+    CHECK_EQ(storage, target.data());
+}
+
+}
@@ -0,0 +1,105 @@
+/// \file
+/// Defines \ref zk::callback, the completion-callable alternative to receiving a \c future from \ref zk::client.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "executor.hpp"
+#include "forwards.hpp"
+#include "future.hpp"
+#include "outcome.hpp"
+#include "string_view.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// A callable invoked exactly once with the \ref outcome of an operation. No \c promise or \c future is involved, so
+/// there is no shared state to allocate and nothing has to block to get the result.
+///
+/// Unless wrapped with \ref via, the callback runs on the ZooKeeper completion thread (or the calling thread, if the
+/// operation fails before it could be submitted). It should be quick to complete and must not block waiting on the
+/// result of another operation made on the same connection -- that result can not be delivered until the callback
+/// returns. Exceptions thrown from a callback are not caught; if one escapes, \c std::terminate is called.
+template <typename TResult>
+using callback = std::function<void (outcome<TResult>)>;
+
+/// A callable invoked when a watch triggers, as an alternative to waiting on the \c next future of a watch result. The
+/// \c next future is filled either way. This runs on the ZooKeeper event thread (unless wrapped with \ref via), with the
+/// same restrictions as a \ref callback.
+using event_callback = std::function<void (event)>;
+
+/// A callable invoked with the name of each child of an entry by \ref client::for_each_child. The name is only valid for
+/// the duration of the call. It runs on the ZooKeeper completion thread, with the same restrictions as a \ref callback.
+using child_visitor = std::function<void (string_view)>;
+
+/// A callable invoked with each state the session of a connection enters (see \ref client::subscribe_state). It runs on
+/// the ZooKeeper event thread, with the same restrictions as a \ref callback.
+using state_callback = std::function<void (state)>;
+
+/// Wrap \a on_complete so that it is run through \a target instead of the thread which delivers the outcome. The
+/// returned callable can be passed anywhere a \ref callback is accepted.
+///
+/// \code
+/// client.get("/config", zk::via(worker_pool, [] (zk::outcome<zk::get_result> res) { apply(res.value()); }));
+/// \endcode
+template <typename FCallback>
+auto via(std::shared_ptr<executor> target, FCallback&& on_complete)
+{
+    return [target = std::move(target), on_complete = std::forward<FCallback>(on_complete)] (auto result)
+           {
+               // std::function requires copyable targets and some outcomes (watches) are move-only
+               auto presult = std::make_shared<decltype(result)>(std::move(result));
+               target->execute([on_complete, presult] () mutable { on_complete(std::move(*presult)); });
+           };
+}
+
+/// Adapt an operation which delivers its result to a \ref callback into one which returns a \c future. The \a submit
+/// function is called immediately with the callback to pass along; failed outcomes become exceptional futures.
+///
+/// \code
+/// future<get_result> f = zk::future_from_callback<get_result>([&] (auto cb) { client.get("/path", std::move(cb)); });
+/// \endcode
+template <typename TResult, typename FSubmit>
+future<TResult> future_from_callback(FSubmit&& submit)
+{
+    auto prom = std::make_shared<promise<TResult>>();
+    auto fut  = prom->get_future();
+    std::forward<FSubmit>(submit)([prom] (outcome<TResult> result)
+                                  {
+                                      if (!result)
+                                          prom->set_exception(result.error());
+                                      else if constexpr (std::is_void<TResult>::value)
+                                          prom->set_value();
+                                      else
+                                          prom->set_value(std::move(result).value());
+                                  }
+                                 );
+    return fut;
+}
+
+/// Like \ref future_from_callback, but the future holds the \ref outcome itself: a failed operation produces a future
+/// with a value (a failed outcome), so no exception is made, stored or rethrown for it.
+///
+/// \code
+/// auto fut = zk::future_outcome_from_callback<get_result>([&] (auto cb) { client.get("/path", std::move(cb)); });
+/// \endcode
+template <typename TResult, typename FSubmit>
+future<outcome<TResult>> future_outcome_from_callback(FSubmit&& submit)
+{
+    auto prom = std::make_shared<promise<outcome<TResult>>>();
+    auto fut  = prom->get_future();
+    std::forward<FSubmit>(submit)([prom] (outcome<TResult> result) { prom->set_value(std::move(result)); });
+    return fut;
+}
+
+/// \}
+
+}
@@ -0,0 +1,237 @@
+#include "cancellation.hpp"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// cancellation_token::state                                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class cancellation_token::state final
+{
+public:
+    bool cancelled() const
+    {
+        return _cancelled.load(std::memory_order_acquire);
+    }
+
+    registration on_cancel(std::function<void ()> handler)
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        if (_cancelled.load(std::memory_order_relaxed))
+        {
+            ax.unlock();
+            handler();
+            return 0U;
+        }
+
+        auto id = ++_last_id;
+        _handlers.emplace_back(id, std::move(handler));
+        return id;
+    }
+
+    void forget(registration id)
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        for (auto iter = _handlers.begin(); iter != _handlers.end(); ++iter)
+        {
+            if (iter->first == id)
+            {
+                _handlers.erase(iter);
+                return;
+            }
+        }
+
+        // A handler may forget itself, which must not wait on its own return
+        _running_cv.wait(ax,
+                         [&]
+                         {
+                             return _running != id || _running_thread == std::this_thread::get_id();
+                         }
+                        );
+    }
+
+    void cancel()
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        if (_cancelled.exchange(true, std::memory_order_acq_rel))
+            return;
+
+        _running_thread = std::this_thread::get_id();
+        while (!_handlers.empty())
+        {
+            auto entry = std::move(_handlers.back());
+            _handlers.pop_back();
+            _running = entry.first;
+
+            ax.unlock();
+            entry.second();
+            ax.lock();
+
+            _running = 0U;
+            _running_cv.notify_all();
+        }
+    }
+
+private:
+    using handler_list = std::vector<std::pair<registration, std::function<void ()>>>;
+
+    std::atomic<bool>       _cancelled { false };
+    std::mutex              _protect;
+    std::condition_variable _running_cv;
+    registration            _last_id = 0U;
+    registration            _running = 0U;
+    std::thread::id         _running_thread;
+    handler_list            _handlers;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// deadline_thread                                                                                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/// The one thread which cancels the tokens made by \ref cancellation_token::at. It is started the first time a deadline
+/// is set. A token which is dropped before its deadline keeps only a small entry here until that time comes.
+class deadline_thread final
+{
+public:
+    using clock = cancellation_token::clock;
+
+    static deadline_thread& instance()
+    {
+        static deadline_thread out;
+        return out;
+    }
+
+    /// Run \a expire (on the deadline thread) once \a deadline has passed.
+    void schedule(clock::time_point deadline, std::function<void ()> expire)
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        bool new_first = _deadlines.empty() || deadline < _deadlines.begin()->first;
+        _deadlines.emplace(deadline, std::move(expire));
+        if (new_first)
+            _wake_cv.notify_one();
+    }
+
+    ~deadline_thread() noexcept
+    {
+        {
+            std::unique_lock<std::mutex> ax(_protect);
+            _stopping = true;
+            _wake_cv.notify_one();
+        }
+        _worker.join();
+    }
+
+private:
+    deadline_thread() :
+            _worker([this] { run(); })
+    { }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        while (!_stopping)
+        {
+            if (_deadlines.empty())
+            {
+                _wake_cv.wait(ax);
+            }
+            else if (_deadlines.begin()->first > clock::now())
+            {
+                _wake_cv.wait_until(ax, _deadlines.begin()->first);
+            }
+            else
+            {
+                auto expire = std::move(_deadlines.begin()->second);
+                _deadlines.erase(_deadlines.begin());
+
+                ax.unlock();
+                expire();
+                ax.lock();
+            }
+        }
+    }
+
+private:
+    std::mutex                                               _protect;
+    std::condition_variable                                  _wake_cv;
+    bool                                                     _stopping = false;
+    std::multimap<clock::time_point, std::function<void ()>> _deadlines;
+    std::thread                                              _worker;
+};
+
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// cancellation_token                                                                                                 //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cancellation_token::cancellation_token() noexcept = default;
+
+cancellation_token::cancellation_token(std::shared_ptr<state> state) noexcept :
+        _state(std::move(state))
+{ }
+
+cancellation_token cancellation_token::after(clock::duration timeout)
+{
+    return at(clock::now() + timeout);
+}
+
+cancellation_token cancellation_token::at(clock::time_point deadline)
+{
+    auto out = std::make_shared<state>();
+    if (deadline <= clock::now())
+        out->cancel();
+    else
+        deadline_thread::instance().schedule(deadline,
+                                             [target = std::weak_ptr<state>(out)]
+                                             {
+                                                 if (auto state = target.lock())
+                                                     state->cancel();
+                                             }
+                                            );
+    return cancellation_token(std::move(out));
+}
+
+bool cancellation_token::cancelled() const
+{
+    return _state && _state->cancelled();
+}
+
+cancellation_token::registration cancellation_token::on_cancel(std::function<void ()> handler) const
+{
+    if (_state)
+        return _state->on_cancel(std::move(handler));
+    else
+        return 0U;
+}
+
+void cancellation_token::forget(registration id) const
+{
+    if (_state && id != 0U)
+        _state->forget(id);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// cancellation_source                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cancellation_source::cancellation_source() :
+        _token(std::make_shared<cancellation_token::state>())
+{ }
+
+void cancellation_source::cancel()
+{
+    _token._state->cancel();
+}
+
+}
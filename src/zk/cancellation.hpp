@@ -0,0 +1,136 @@
+/// \file
+/// Defines \ref zk::cancellation_token, the way to bound how long an operation is waited on.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "callback.hpp"
+#include "error.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// A handle on a deadline or an explicit \ref cancellation_source which an operation can be given to stop waiting on
+/// its result. When the token is cancelled, the operation completes with \ref error_code::operation_timeout right away;
+/// the reply which arrives from the server later is dropped. Cancelling does not take the request back from the server,
+/// so a modification may still be applied.
+///
+/// Tokens are cheap to copy and all copies share the same state. A default-constructed token never expires.
+///
+/// \code
+/// auto res = client.get("/config", zk::cancellation_token::after(std::chrono::milliseconds(250))).get();
+/// \endcode
+class cancellation_token final
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /// Identifies a handler registered with \ref on_cancel (\c 0 means nothing was registered).
+    using registration = std::size_t;
+
+public:
+    /// Create a token which is never cancelled.
+    cancellation_token() noexcept;
+
+    /// Create a token which is cancelled once \a timeout has passed.
+    static cancellation_token after(clock::duration timeout);
+
+    /// Create a token which is cancelled at \a deadline.
+    static cancellation_token at(clock::time_point deadline);
+
+    /// Could this token ever be cancelled? This is \c false for a default-constructed token.
+    bool can_cancel() const noexcept { return bool(_state); }
+
+    bool cancelled() const;
+
+    /// Run \a handler when this token is cancelled, on the thread which cancels it (the deadline thread, for tokens
+    /// from \ref after and \ref at). If the token is already cancelled, \a handler runs before this returns.
+    ///
+    /// \returns A registration for \ref forget, or \c 0 if \a handler was run immediately or will never be run.
+    registration on_cancel(std::function<void ()> handler) const;
+
+    /// Drop the handler registered as \a id. If it is running on another thread, this waits for it to return, so
+    /// nothing it refers to is in use once this returns.
+    void forget(registration id) const;
+
+private:
+    class state;
+
+    explicit cancellation_token(std::shared_ptr<state> state) noexcept;
+
+    friend class cancellation_source;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// The owner of a \ref cancellation_token which is cancelled by calling \ref cancel.
+class cancellation_source final
+{
+public:
+    cancellation_source();
+
+    cancellation_token token() const { return _token; }
+
+    /// Cancel the token, running all the handlers registered with it on the calling thread. Only the first call does
+    /// anything.
+    void cancel();
+
+private:
+    cancellation_token _token;
+};
+
+/// Wrap \a on_complete so it is called with \ref error_code::operation_timeout as soon as \a token is cancelled, if the
+/// operation has not completed by then. Whichever of the two happens first is delivered; the other is dropped. The
+/// returned callable can be passed anywhere a \ref callback is accepted.
+///
+/// \code
+/// client.set("/state", data, version::any(), zk::with_cancellation(token, std::move(on_set)));
+/// \endcode
+template <typename TResult>
+callback<TResult> with_cancellation(const cancellation_token& token, callback<TResult> on_complete)
+{
+    if (!token.can_cancel())
+        return on_complete;
+
+    struct pending_state
+    {
+        std::atomic<bool>                delivered { false };
+        callback<TResult>                on_complete;
+        cancellation_token               token;
+        cancellation_token::registration registration = 0U;
+    };
+
+    auto pending = std::make_shared<pending_state>();
+    pending->on_complete  = std::move(on_complete);
+    pending->token        = token;
+    pending->registration = token.on_cancel([pending]
+                                            {
+                                                if (!pending->delivered.exchange(true))
+                                                    pending->on_complete(error_code::operation_timeout);
+                                            }
+                                           );
+
+    return [pending] (outcome<TResult> result)
+           {
+               if (!pending->delivered.exchange(true))
+               {
+                   pending->token.forget(pending->registration);
+                   pending->on_complete(std::move(result));
+               }
+           };
+}
+
+/// \}
+
+}
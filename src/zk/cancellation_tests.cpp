@@ -0,0 +1,84 @@
+#include <zk/tests/test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "cancellation.hpp"
+#include "optional.hpp"
+
+namespace zk
+{
+
+GTEST_TEST(cancellation_tests, default_never_cancels)
+{
+    cancellation_token token;
+    CHECK_FALSE(token.can_cancel());
+    CHECK_FALSE(token.cancelled());
+    CHECK_EQ(0U, token.on_cancel([] { }));
+}
+
+GTEST_TEST(cancellation_tests, cancel_runs_handlers)
+{
+    cancellation_source source;
+    auto token = source.token();
+    int  calls = 0;
+    token.on_cancel([&] { ++calls; });
+    auto forgotten = token.on_cancel([&] { calls += 100; });
+    token.forget(forgotten);
+    CHECK_EQ(0, calls);
+
+    source.cancel();
+    source.cancel();
+    CHECK_TRUE(token.cancelled());
+    CHECK_EQ(1, calls);
+
+    // Handlers registered after the fact run right away
+    CHECK_EQ(0U, token.on_cancel([&] { ++calls; }));
+    CHECK_EQ(2, calls);
+}
+
+GTEST_TEST(cancellation_tests, deadline_expires)
+{
+    auto token = cancellation_token::after(std::chrono::milliseconds(10));
+    std::atomic<bool> fired(false);
+    token.on_cancel([&] { fired = true; });
+
+    for (int attempt = 0; attempt < 500 && !fired; ++attempt)
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    CHECK_TRUE(fired.load());
+    CHECK_TRUE(token.cancelled());
+
+    CHECK_TRUE(cancellation_token::at(cancellation_token::clock::now()).cancelled());
+}
+
+GTEST_TEST(cancellation_tests, with_cancellation_timeout_first)
+{
+    cancellation_source      source;
+    optional<outcome<int>>   seen;
+    int                      calls = 0;
+    auto cb = with_cancellation<int>(source.token(), [&] (outcome<int> res) { seen.emplace(std::move(res)); ++calls; });
+
+    source.cancel();
+    CHECK_EQ(error_code::operation_timeout, seen->code());
+
+    // The late completion is dropped
+    cb(outcome<int>(5));
+    CHECK_EQ(1, calls);
+    CHECK_EQ(error_code::operation_timeout, seen->code());
+}
+
+GTEST_TEST(cancellation_tests, with_cancellation_completion_first)
+{
+    cancellation_source    source;
+    optional<outcome<int>> seen;
+    int                    calls = 0;
+    auto cb = with_cancellation<int>(source.token(), [&] (outcome<int> res) { seen.emplace(std::move(res)); ++calls; });
+
+    cb(outcome<int>(5));
+    source.cancel();
+    CHECK_EQ(1, calls);
+    CHECK_EQ(5, seen->value());
+}
+
+}
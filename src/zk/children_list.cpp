@@ -0,0 +1,97 @@
+#include "children_list.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// children_list                                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+children_list::children_list(const std::vector<std::string>& names)
+{
+    size_type total_length = 0U;
+    for (const auto& name : names)
+        total_length += name.size();
+
+    reserve(names.size(), total_length);
+    for (const auto& name : names)
+        push_back(name);
+}
+
+children_list::~children_list() noexcept = default;
+
+void children_list::reserve(size_type count, size_type total_length)
+{
+    _entries.reserve(count);
+    _storage.reserve(total_length);
+}
+
+void children_list::push_back(string_view name)
+{
+    // The offsets are 32 bits to keep the table small; a single response from the server is nowhere near that large
+    if (_storage.size() + name.size() > std::numeric_limits<std::uint32_t>::max())
+        throw std::length_error("children_list storage would exceed 4 GiB");
+
+    _entries.push_back(entry{ static_cast<std::uint32_t>(_storage.size()), static_cast<std::uint32_t>(name.size()) });
+    _storage.append(name.data(), name.size());
+}
+
+void children_list::sort()
+{
+    std::sort(_entries.begin(), _entries.end(),
+              [this] (const entry& a, const entry& b)
+              {
+                  return string_view(_storage.data() + a.offset, a.length)
+                       < string_view(_storage.data() + b.offset, b.length);
+              }
+             );
+}
+
+std::vector<std::string> children_list::to_vector() const
+{
+    std::vector<std::string> out;
+    out.reserve(size());
+    for (auto name : *this)
+        out.emplace_back(name);
+    return out;
+}
+
+bool operator==(const children_list& a, const children_list& b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+bool operator!=(const children_list& a, const children_list& b)
+{
+    return !(a == b);
+}
+
+std::ostream& operator<<(std::ostream& os, const children_list& self)
+{
+    os << '[';
+    bool first = true;
+    for (auto name : self)
+    {
+        if (first)
+            first = false;
+        else
+            os << ", ";
+        os << name;
+    }
+    return os << ']';
+}
+
+std::string to_string(const children_list& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+}
@@ -0,0 +1,144 @@
+/// \file
+/// Defines \ref zk::children_list, a compact list of entry names.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "string_view.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// A list of names stored in a single block of characters with a table of where each name starts. Filling a list
+/// takes two allocations no matter how many names it holds, where a \c std::vector<std::string> takes one per name
+/// that does not fit in the small-string buffer. This is what makes listing entries with hundreds of thousands of
+/// children (the queues and locks of the recipes, for example) affordable.
+///
+/// The names are accessed as \ref string_view instances, which are valid as long as the list is alive and has not been
+/// modified.
+class children_list final
+{
+public:
+    using value_type = string_view;
+    using size_type  = std::size_t;
+
+    class const_iterator final
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = string_view;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const string_view*;
+        using reference         = string_view;
+
+    public:
+        const_iterator() = default;
+
+        string_view operator*() const { return (*_owner)[_idx]; }
+
+        const_iterator& operator++()
+        {
+            ++_idx;
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            auto copy = *this;
+            ++_idx;
+            return copy;
+        }
+
+        friend bool operator==(const const_iterator& a, const const_iterator& b) { return a._idx == b._idx; }
+        friend bool operator!=(const const_iterator& a, const const_iterator& b) { return a._idx != b._idx; }
+
+    private:
+        friend class children_list;
+
+        explicit const_iterator(const children_list* owner, size_type idx) :
+                _owner(owner),
+                _idx(idx)
+        { }
+
+    private:
+        const children_list* _owner = nullptr;
+        size_type            _idx   = 0U;
+    };
+
+    using iterator = const_iterator;
+
+public:
+    /// Create an empty list.
+    children_list() = default;
+
+    /// Create a list holding a copy of \a names.
+    explicit children_list(const std::vector<std::string>& names);
+
+    children_list(const children_list&) = default;
+    children_list(children_list&&) noexcept = default;
+
+    children_list& operator=(const children_list&) = default;
+    children_list& operator=(children_list&&) noexcept = default;
+
+    ~children_list() noexcept;
+
+    /// Make room for \a count names with a combined length of \a total_length, so that filling the list with
+    /// \ref push_back does not need to allocate again.
+    void reserve(size_type count, size_type total_length);
+
+    /// Add \a name to the end of the list.
+    void push_back(string_view name);
+
+    size_type size() const { return _entries.size(); }
+
+    bool empty() const { return _entries.empty(); }
+
+    /// Get the name at \a idx. There is no bounds check.
+    string_view operator[](size_type idx) const
+    {
+        const auto& found = _entries[idx];
+        return string_view(_storage.data() + found.offset, found.length);
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0U); }
+    const_iterator end() const   { return const_iterator(this, size()); }
+
+    /// Reorder the list so that the names are in lexicographical order. Only the table of offsets is sorted; the names
+    /// themselves are not moved.
+    void sort();
+
+    /// Copy the names into the representation used by \ref get_children_result.
+    std::vector<std::string> to_vector() const;
+
+private:
+    struct entry final
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+private:
+    std::string        _storage;
+    std::vector<entry> _entries;
+};
+
+bool operator==(const children_list& a, const children_list& b);
+bool operator!=(const children_list& a, const children_list& b);
+
+std::ostream& operator<<(std::ostream&, const children_list&);
+
+std::string to_string(const children_list&);
+
+/// \}
+
+}
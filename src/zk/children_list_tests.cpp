@@ -0,0 +1,57 @@
+#include <zk/tests/test.hpp>
+
+#include <string>
+#include <vector>
+
+#include "children_list.hpp"
+
+namespace zk
+{
+
+GTEST_TEST(children_list_tests, push_and_index)
+{
+    children_list list;
+    CHECK_TRUE(list.empty());
+
+    list.reserve(3U, 6U);
+    list.push_back("c");
+    list.push_back("");
+    list.push_back("bbbaa");
+    CHECK_EQ(3U, list.size());
+    CHECK_EQ("c",     list[0]);
+    CHECK_EQ("",      list[1]);
+    CHECK_EQ("bbbaa", list[2]);
+}
+
+GTEST_TEST(children_list_tests, from_vector_round_trip)
+{
+    std::vector<std::string> names = { "lock-0000000002", "lock-0000000000", "lock-0000000001" };
+    children_list list(names);
+    CHECK_TRUE(names == list.to_vector());
+
+    std::vector<std::string> iterated;
+    for (auto name : list)
+        iterated.emplace_back(name);
+    CHECK_TRUE(names == iterated);
+}
+
+GTEST_TEST(children_list_tests, sort)
+{
+    children_list list(std::vector<std::string>{ "b", "a", "ab", "" });
+    list.sort();
+    CHECK_EQ(children_list(std::vector<std::string>{ "", "a", "ab", "b" }), list);
+    CHECK_EQ("[, a, ab, b]", to_string(list));
+}
+
+GTEST_TEST(children_list_tests, growth_keeps_names)
+{
+    children_list list;
+    for (int idx = 0; idx < 1000; ++idx)
+        list.push_back(std::to_string(idx));
+
+    CHECK_EQ(1000U, list.size());
+    CHECK_EQ("0",   list[0]);
+    CHECK_EQ("999", list[999]);
+}
+
+}
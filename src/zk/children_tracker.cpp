@@ -0,0 +1,346 @@
+#include "children_tracker.hpp"
+#include "cancellation.hpp"
+#include "error.hpp"
+#include "results.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// children_delta                                                                                                     //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+children_delta children_delta::between(const children_list& before, const children_list& after)
+{
+    children_delta out;
+    auto old_iter = before.begin();
+    auto new_iter = after.begin();
+    while (old_iter != before.end() && new_iter != after.end())
+    {
+        auto cmp = (*old_iter).compare(*new_iter);
+        if (cmp < 0)
+        {
+            out.removed.push_back(*old_iter++);
+        }
+        else if (cmp > 0)
+        {
+            out.added.push_back(*new_iter++);
+        }
+        else
+        {
+            ++old_iter;
+            ++new_iter;
+        }
+    }
+    for (; old_iter != before.end(); ++old_iter)
+        out.removed.push_back(*old_iter);
+    for (; new_iter != after.end(); ++new_iter)
+        out.added.push_back(*new_iter);
+    return out;
+}
+
+std::ostream& operator<<(std::ostream& os, const children_delta& self)
+{
+    return os << "{added=" << self.added << " removed=" << self.removed << '}';
+}
+
+std::string to_string(const children_delta& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// children_tracker::state                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Completions hold the state strongly, since they are always delivered; watch events, state changes and retry timers
+/// hold it weakly, as they might never fire. Once \c stopped is set, nothing is set again and no listener is called.
+struct children_tracker::state final :
+        std::enable_shared_from_this<children_tracker::state>
+{
+    static constexpr std::chrono::milliseconds first_retry_delay = std::chrono::milliseconds(50);
+    static constexpr std::chrono::milliseconds max_retry_delay   = std::chrono::seconds(5);
+
+    explicit state(client conn, zk::path path) :
+            conn(std::move(conn)),
+            path(std::move(path).str()),
+            current(std::make_shared<const children_list>())
+    { }
+
+    void refresh()
+    {
+        auto self = shared_from_this();
+        conn.watch_children_list(path,
+                                 [self] (outcome<watch_children_list_result> result)
+                                 {
+                                     self->on_listing(std::move(result));
+                                 },
+                                 on_event()
+                                );
+    }
+
+    void on_listing(outcome<watch_children_list_result> result)
+    {
+        if (result)
+        {
+            auto listing = std::move(*result).initial();
+            std::unique_lock<std::mutex> ax(protect);
+            if (stopped)
+                return;
+
+            // The child version only goes up while the entry lives, so an equal one is the same listing and a lower
+            // one is an older listing which lost the race with a newer one
+            const auto& st = listing.parent_stat();
+            if (last_stat && last_stat->create_transaction == st.create_transaction
+                && st.child_version.value <= last_stat->child_version.value
+               )
+            {
+                ax.unlock();
+                return mark_ready(error_code::ok);
+            }
+
+            auto next = std::make_shared<children_list>(std::move(listing).children());
+            next->sort();
+            auto delta = children_delta::between(*current, *next);
+            current    = std::move(next);
+            last_stat  = st;
+            ax.unlock();
+
+            notify(delta, st);
+            mark_ready(error_code::ok);
+        }
+        else if (result.code() == error_code::no_entry)
+        {
+            auto self = shared_from_this();
+            conn.watch_exists(path,
+                              [self] (outcome<watch_exists_result> exists)
+                              {
+                                  self->on_exists(std::move(exists));
+                              },
+                              on_event()
+                             );
+        }
+        else
+        {
+            failed(result.code());
+        }
+    }
+
+    void on_exists(outcome<watch_exists_result> result)
+    {
+        if (!result)
+            return failed(result.code());
+
+        if (result->initial())
+        {
+            // Created between the two reads; the exists watch will fire on the next change as well, which is harmless
+            return refresh();
+        }
+
+        std::unique_lock<std::mutex> ax(protect);
+        if (stopped)
+            return;
+
+        auto gone = children_delta::between(*current, children_list());
+        auto st   = last_stat.value_or(zk::stat());
+        current   = std::make_shared<const children_list>();
+        last_stat = nullopt;
+        ax.unlock();
+
+        notify(gone, st);
+        mark_ready(error_code::ok);
+    }
+
+    event_callback on_event()
+    {
+        std::weak_ptr<state> weak_self = shared_from_this();
+        return [weak_self] (const event&)
+               {
+                   auto self = weak_self.lock();
+                   if (!self)
+                       return;
+
+                   std::unique_lock<std::mutex> ax(self->protect);
+                   if (self->stopped)
+                       return;
+                   ax.unlock();
+                   self->refresh();
+               };
+    }
+
+    /// A read which should have left a watch failed with \a rc, so nothing follows the entry any more. The first
+    /// listing reports its failure through \ref start; after that, a failure the session can recover from is retried
+    /// once the session is connected again or after a delay (whichever comes first), as no watch is left to do it.
+    void failed(error_code rc)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (!ready || stopped)
+        {
+            ax.unlock();
+            return mark_ready(rc);
+        }
+        else if (!(is_transport_error(rc) || rc == error_code::throttled) || retry_pending)
+        {
+            return;
+        }
+
+        retry_pending = true;
+        auto delay    = retry_delay;
+        retry_delay   = std::min<std::chrono::milliseconds>(retry_delay * 2, max_retry_delay);
+        ax.unlock();
+
+        std::weak_ptr<state> weak_self = shared_from_this();
+        auto timer = cancellation_token::after(delay);
+        // The timer keeps itself alive through its own handler until it fires
+        timer.on_cancel([weak_self, timer]
+                        {
+                            if (auto self = weak_self.lock())
+                                self->retry();
+                        }
+                       );
+    }
+
+    /// Set the watch again if a retry is pending.
+    void retry()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (stopped || !std::exchange(retry_pending, false))
+            return;
+        ax.unlock();
+        refresh();
+    }
+
+    /// Follow the session, so a retry does not wait for its timer once the session is back.
+    void follow()
+    {
+        std::weak_ptr<state> weak_self = shared_from_this();
+        auto sub = conn.subscribe_state([weak_self] (zk::state changed)
+                                        {
+                                            if (changed != zk::state::connected)
+                                                return;
+                                            if (auto self = weak_self.lock())
+                                                self->retry();
+                                        }
+                                       );
+
+        std::unique_lock<std::mutex> ax(protect);
+        subscription = std::move(sub);
+    }
+
+    void notify(const children_delta& delta, const zk::stat& st)
+    {
+        if (delta.empty())
+            return;
+
+        std::vector<listener> targets;
+        {
+            std::unique_lock<std::mutex> lx(listeners_protect);
+            targets.reserve(listeners.size());
+            for (const auto& pair : listeners)
+                targets.push_back(pair.second);
+        }
+        for (const auto& target : targets)
+            target(delta, st);
+    }
+
+    void mark_ready(error_code rc)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (rc == error_code::ok)
+            retry_delay = first_retry_delay;
+        if (ready)
+            return;
+        ready = true;
+        ax.unlock();
+
+        if (rc == error_code::ok)
+            ready_promise.set_value();
+        else
+            ready_promise.set_exception(get_exception_ptr_of(rc));
+    }
+
+    client      conn;
+    std::string path;
+
+    mutable std::mutex                   protect;
+    std::shared_ptr<const children_list> current;
+    optional<zk::stat>                   last_stat;
+    bool                                 started       = false;
+    bool                                 stopped       = false;
+    bool                                 ready         = false;
+    bool                                 retry_pending = false;
+    std::chrono::milliseconds            retry_delay   = first_retry_delay;
+    state_subscription                   subscription;
+    promise<void>                        ready_promise;
+
+    std::mutex                      listeners_protect;
+    std::map<std::size_t, listener> listeners;
+    std::size_t                     next_listener_id = 0U;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// children_tracker                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+children_tracker::children_tracker(client conn, zk::path path) :
+        _state(std::make_shared<state>(std::move(conn), std::move(path)))
+{ }
+
+children_tracker::~children_tracker() noexcept
+{
+    state_subscription followed;
+    {
+        std::unique_lock<std::mutex> ax(_state->protect);
+        _state->stopped = true;
+        followed        = std::move(_state->subscription);
+    }
+    followed.cancel();
+}
+
+future<void> children_tracker::start()
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    if (_state->started)
+        throw std::logic_error("children_tracker::start called more than once");
+    _state->started = true;
+    auto fut = _state->ready_promise.get_future();
+    ax.unlock();
+
+    _state->follow();
+    _state->refresh();
+    return fut;
+}
+
+std::shared_ptr<const children_list> children_tracker::snapshot() const
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    return _state->current;
+}
+
+std::size_t children_tracker::add_listener(listener on_change)
+{
+    std::unique_lock<std::mutex> ax(_state->listeners_protect);
+    auto id = _state->next_listener_id++;
+    _state->listeners.emplace(id, std::move(on_change));
+    return id;
+}
+
+void children_tracker::remove_listener(std::size_t id)
+{
+    std::unique_lock<std::mutex> ax(_state->listeners_protect);
+    _state->listeners.erase(id);
+}
+
+}
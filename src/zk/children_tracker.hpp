@@ -0,0 +1,121 @@
+/// \file
+/// Defines \ref zk::children_tracker, which follows the children of an entry and tells listeners what changed.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+#include "children_list.hpp"
+#include "client.hpp"
+#include "forwards.hpp"
+#include "future.hpp"
+#include "path.hpp"
+#include "types.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// The difference between two listings of the children of an entry. Both lists are sorted.
+struct children_delta final
+{
+    children_list added;   //!< The names in the new listing which were not in the old one.
+    children_list removed; //!< The names in the old listing which are not in the new one.
+
+    /// Compute what changed from \a before to \a after in a single pass over both.
+    ///
+    /// \pre Both \a before and \a after are sorted (see \ref children_list::sort).
+    static children_delta between(const children_list& before, const children_list& after);
+
+    bool empty() const { return added.empty() && removed.empty(); }
+};
+
+std::ostream& operator<<(std::ostream&, const children_delta&);
+
+std::string to_string(const children_delta&);
+
+/// Follows the children of the entry at a path with a \ref client::watch_children_list that it sets again every time it
+/// triggers, and tells its listeners only which children came and went.
+///
+/// \code
+/// zk::children_tracker members(client, zk::path("/service/members"));
+/// members.add_listener([] (const zk::children_delta& delta, const zk::stat&)
+///                      {
+///                          for (auto name : delta.added)
+///                              connect_to(name);
+///                          for (auto name : delta.removed)
+///                              disconnect_from(name);
+///                      }
+///                     );
+/// members.start().get();
+/// \endcode
+///
+/// \par Cost
+/// The server always sends the whole listing, so each change still costs one sort of it and one merge against the
+/// previous one. That is done once per change, however many listeners there are. Both listings are
+/// \ref children_list instances, so the names take two allocations rather than one each. A listing whose
+/// \ref stat::child_version is the one already seen (the watch fired for a reconnect, say) is dropped without being
+/// sorted or compared.
+///
+/// \par Listeners
+/// Listeners are called on the ZooKeeper completion thread, with the same restrictions as a \ref callback, and only
+/// with deltas which are not empty. The first listing reports every child as added. A listener registered later is
+/// not told of the children which are already there; \ref snapshot has those.
+///
+/// If the entry is erased, every child is reported as removed and an exists watch is left to pick the listing up again
+/// once the entry is created. A watch which fails to be set again because of the connection (\ref connection_loss,
+/// \ref operation_timeout or \ref throttled) is set again as soon as the session is connected, or after a delay which
+/// grows up to 5 seconds while it keeps failing. Any other failure (the session expired, for example) leaves the last
+/// listing in place for good.
+class children_tracker final
+{
+public:
+    /// Called with what changed and the \ref stat of the entry as of the new listing.
+    using listener = std::function<void (const children_delta&, const zk::stat&)>;
+
+public:
+    /// Create a tracker of the children of \a path. Nothing is fetched until \ref start is called.
+    explicit children_tracker(client conn, zk::path path);
+
+    children_tracker(const children_tracker&) = delete;
+    children_tracker& operator=(const children_tracker&) = delete;
+
+    /// Stop following changes. A listing in flight is still completed, but nothing is told of it.
+    ~children_tracker() noexcept;
+
+    /// Fetch the first listing and start following changes.
+    ///
+    /// \returns A future which is filled once the first listing is in (or the entry is known not to exist). It is
+    ///  delivered with the error of that first read if it fails with something other than \ref no_entry.
+    /// \throws std::logic_error If the tracker has already been started.
+    future<void> start();
+
+    /// The children as of the last listing, sorted. This is shared with the tracker, so taking it copies nothing.
+    std::shared_ptr<const children_list> snapshot() const;
+
+    /// Register \a on_change to be told of changes.
+    ///
+    /// \returns An identifier to pass to \ref remove_listener.
+    std::size_t add_listener(listener on_change);
+
+    /// Unregister the listener with the \a id returned by \ref add_listener. It might still be called if a change is
+    /// being delivered concurrently.
+    void remove_listener(std::size_t id);
+
+private:
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// \}
+
+}
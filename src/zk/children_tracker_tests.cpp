@@ -0,0 +1,156 @@
+#include <zk/fake/server.hpp>
+#include <zk/server/server_tests.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "children_tracker.hpp"
+#include "client.hpp"
+#include "error.hpp"
+
+namespace zk
+{
+
+static children_list sorted(std::vector<std::string> names)
+{
+    children_list out(names);
+    out.sort();
+    return out;
+}
+
+GTEST_TEST(children_delta_tests, between)
+{
+    auto delta = children_delta::between(sorted({ "a", "c", "d", "f" }), sorted({ "b", "c", "f", "g", "h" }));
+    CHECK_EQ(sorted({ "b", "g", "h" }), delta.added);
+    CHECK_EQ(sorted({ "a", "d" }), delta.removed);
+    CHECK_EQ("{added=[b, g, h] removed=[a, d]}", to_string(delta));
+
+    CHECK_TRUE(children_delta::between(sorted({ "x", "y" }), sorted({ "x", "y" })).empty());
+    CHECK_EQ(sorted({ "x", "y" }), children_delta::between(children_list(), sorted({ "x", "y" })).added);
+    CHECK_EQ(sorted({ "x", "y" }), children_delta::between(sorted({ "x", "y" }), children_list()).removed);
+}
+
+/// Watch events are delivered asynchronously, so wait for the tracker to notice.
+template <typename FPredicate>
+static bool eventually(FPredicate&& pred)
+{
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        if (pred())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return pred();
+}
+
+/// Everything a listener was told, in order.
+struct recorded_deltas final
+{
+    std::size_t count() const
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return deltas.size();
+    }
+
+    children_delta at(std::size_t idx) const
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return deltas.at(idx);
+    }
+
+    children_tracker::listener listener()
+    {
+        return [this] (const children_delta& delta, const zk::stat&)
+               {
+                   std::unique_lock<std::mutex> ax(protect);
+                   deltas.push_back(delta);
+               };
+    }
+
+    mutable std::mutex          protect;
+    std::vector<children_delta> deltas;
+};
+
+GTEST_TEST(children_tracker_retry_tests, watch_set_again_after_connection_loss)
+{
+    auto srv = fake::server::create("children-tracker-retry");
+    srv->latency(std::chrono::milliseconds(10));
+    client c(srv->connection_string());
+    c.create("/tracked-retry", buffer()).get();
+
+    recorded_deltas  seen;
+    children_tracker tracker(c, zk::path("/tracked-retry"));
+    tracker.add_listener(seen.listener());
+    tracker.start().get();
+
+    // The change is made right away, so the listing its watch asks for is the next request, and it fails
+    auto created = c.create("/tracked-retry/child", buffer());
+    srv->fail_next(error_code::connection_loss);
+    created.get();
+
+    // Nothing is left watching the entry, so only a retry can pick the change (or any later one) up
+    CHECK_TRUE(eventually([&] { return seen.count() == 1U; }));
+    CHECK_EQ(sorted({ "child" }), seen.at(0U).added);
+    c.create("/tracked-retry/later", buffer()).get();
+    CHECK_TRUE(eventually([&] { return seen.count() == 2U; }));
+    CHECK_EQ(sorted({ "later" }), seen.at(1U).added);
+}
+
+class children_tracker_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(children_tracker_tests, added_and_removed)
+{
+    client c = get_connected_client();
+    c.create("/tracked", buffer()).get();
+    c.create("/tracked/one", buffer()).get();
+
+    recorded_deltas  seen;
+    children_tracker tracker(c, zk::path("/tracked"));
+    tracker.add_listener(seen.listener());
+    tracker.start().get();
+    CHECK_EQ(1U, seen.count());
+    CHECK_EQ(sorted({ "one" }), seen.at(0U).added);
+
+    c.create("/tracked/two", buffer()).get();
+    CHECK_TRUE(eventually([&] { return seen.count() == 2U; }));
+    CHECK_EQ(sorted({ "two" }), seen.at(1U).added);
+    CHECK_TRUE(seen.at(1U).removed.empty());
+
+    c.erase("/tracked/one").get();
+    CHECK_TRUE(eventually([&] { return seen.count() == 3U; }));
+    CHECK_EQ(sorted({ "one" }), seen.at(2U).removed);
+    CHECK_EQ(sorted({ "two" }), *tracker.snapshot());
+
+    // Data changes do not trigger a children watch, so nothing is told of them
+    c.set("/tracked", buffer()).get();
+    c.create("/tracked/three", buffer()).get();
+    CHECK_TRUE(eventually([&] { return seen.count() == 4U; }));
+    CHECK_EQ(sorted({ "three" }), seen.at(3U).added);
+}
+
+GTEST_TEST_F(children_tracker_tests, entry_comes_and_goes)
+{
+    client           c = get_connected_client();
+    recorded_deltas  seen;
+    children_tracker tracker(c, zk::path("/tracked-later"));
+    tracker.add_listener(seen.listener());
+    tracker.start().get();
+    CHECK_TRUE(tracker.snapshot()->empty());
+
+    c.create("/tracked-later", buffer()).get();
+    c.create("/tracked-later/child", buffer()).get();
+    CHECK_TRUE(eventually([&] { return tracker.snapshot()->size() == 1U; }));
+
+    c.erase("/tracked-later/child").get();
+    c.erase("/tracked-later").get();
+    CHECK_TRUE(eventually([&] { return tracker.snapshot()->empty(); }));
+    CHECK_EQ(sorted({ "child" }), seen.at(seen.count() - 1U).removed);
+    CHECK_THROWS(std::logic_error) { tracker.start(); };
+}
+
+}
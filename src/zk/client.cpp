@@ -1,10 +1,17 @@
 #include "client.hpp"
 #include "acl.hpp"
+#include "cancellation.hpp"
 #include "connection.hpp"
 #include "multi.hpp"
+#include "error.hpp"
+#include "results.hpp"
+#include "watch_stream.hpp"
 
+#include <deque>
+#include <mutex>
 #include <sstream>
 #include <ostream>
+#include <utility>
 
 namespace zk
 {
@@ -13,6 +20,18 @@ namespace zk
 // client                                                                                                             //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/// Adapt the callback form of an operation made by \a submit into a \c future which is given up on once \a cancel is
+/// cancelled.
+template <typename TResult, typename FSubmit>
+static future<TResult> future_with_cancellation(const cancellation_token& cancel, FSubmit&& submit)
+{
+    return future_from_callback<TResult>([&] (callback<TResult> cb)
+                                         {
+                                             std::forward<FSubmit>(submit)(with_cancellation(cancel, std::move(cb)));
+                                         }
+                                        );
+}
+
 client::client(const connection_params& params) :
         client(connection::connect(params))
 { }
@@ -30,13 +49,20 @@ future<client> client::connect(string_view conn_string)
     return connect(connection_params::parse(conn_string));
 }
 
+/// Can operations be made in state \a s? A session on a read-only server (only possible when
+/// \ref connection_params::read_only allows it) is as connected as it gets.
+static bool is_usable(state s)
+{
+    return s == state::connected || s == state::read_only;
+}
+
 future<client> client::connect(connection_params conn_params)
 {
     try
     {
         auto conn = connection::connect(conn_params);
         auto state_change_fut = conn->watch_state();
-        if (conn->state() == state::connected)
+        if (is_usable(conn->state()))
         {
             promise<client> p;
             p.set_value(client(std::move(conn)));
@@ -44,19 +70,31 @@ future<client> client::connect(connection_params conn_params)
         }
         else
         {
+            auto on_state = [] (state s, std::shared_ptr<connection> conn) -> client
+                            {
+                                if (is_usable(s))
+                                    return client(std::move(conn));
+                                else
+                                    throw std::runtime_error(std::string("Unexpected state: ") + to_string(s));
+                            };
+#if ZKPP_FUTURE_USE_ZK
+            // basic_future has a continuation to rely on, so no thread is needed to wait for the state change
+            return state_change_fut.then([on_state, conn = std::move(conn)] (future<state> changed) mutable
+                                         {
+                                             return on_state(changed.get(), std::move(conn));
+                                         }
+                                        );
+#else
             // TODO: Test if future::then can be relied on and use that instead of std::async
             return std::async
                    (
                        std::launch::async,
-                       [state_change_fut = std::move(state_change_fut), conn = std::move(conn)] () mutable -> client
+                       [on_state, state_change_fut = std::move(state_change_fut), conn = std::move(conn)] () mutable
                        {
-                         state s(state_change_fut.get());
-                         if (s == state::connected)
-                            return client(conn);
-                         else
-                             throw std::runtime_error(std::string("Unexpected state: ") + to_string(s));
+                           return on_state(state_change_fut.get(), std::move(conn));
                        }
                    );
+#endif
         }
     }
     catch (...)
@@ -74,37 +112,287 @@ void client::close()
     _conn->close();
 }
 
-future<get_result> client::get(string_view path) const
+future<void> client::close_async()
+{
+    return _conn->close_async();
+}
+
+void client::close_async(callback<void> on_closed)
+{
+    _conn->close_async(std::move(on_closed));
+}
+
+metrics_snapshot client::metrics() const
+{
+    return _conn->metrics();
+}
+
+state_subscription client::subscribe_state(state_callback on_change) const
+{
+    return state_subscription(_conn, _conn->subscribe_state(std::move(on_change)));
+}
+
+future<get_result> client::get(path_view path) const
 {
     return _conn->get(path);
 }
 
-future<watch_result> client::watch(string_view path) const
+future<get_result> client::get(path_view path, const cancellation_token& cancel) const
+{
+    return future_with_cancellation<get_result>(cancel, [&] (auto cb) { this->get(path, std::move(cb)); });
+}
+
+void client::get(path_view path, callback<get_result> on_complete) const
+{
+    _conn->get(path, std::move(on_complete));
+}
+
+future<outcome<get_result>> client::try_get(path_view path) const
+{
+    return future_outcome_from_callback<get_result>([&] (auto cb) { this->get(path, std::move(cb)); });
+}
+
+future<zk::stat> client::get_into(path_view path, buffer& target) const
+{
+    return _conn->get_into(path, target);
+}
+
+void client::get_into(path_view path, buffer& target, callback<zk::stat> on_complete) const
+{
+    _conn->get_into(path, target, std::move(on_complete));
+}
+
+future<std::vector<outcome<get_result>>> client::get_many(const std::vector<path_view>& paths) const
+{
+    return _conn->get_many(paths);
+}
+
+void client::get_many(const std::vector<path_view>& paths, callback<std::vector<outcome<get_result>>> on_complete) const
+{
+    _conn->get_many(paths, std::move(on_complete));
+}
+
+future<std::vector<outcome<get_children_result>>> client::get_children_many(const std::vector<path_view>& paths) const
+{
+    return _conn->get_children_many(paths);
+}
+
+void client::get_children_many(const std::vector<path_view>&                       paths,
+                               callback<std::vector<outcome<get_children_result>>> on_complete
+                              ) const
+{
+    _conn->get_children_many(paths, std::move(on_complete));
+}
+
+future<std::vector<outcome<exists_result>>> client::exists_many(const std::vector<path_view>& paths) const
+{
+    return _conn->exists_many(paths);
+}
+
+void client::exists_many(const std::vector<path_view>&                 paths,
+                         callback<std::vector<outcome<exists_result>>> on_complete
+                        ) const
+{
+    _conn->exists_many(paths, std::move(on_complete));
+}
+
+future<watch_result> client::watch(path_view path) const
 {
     return _conn->watch(path);
 }
 
-future<get_children_result> client::get_children(string_view path) const
+future<watch_result> client::watch(path_view path, const cancellation_token& cancel) const
+{
+    return future_from_callback<watch_result>([&] (auto cb) { _conn->watch(path, std::move(cb), nullptr, cancel); });
+}
+
+void client::watch(path_view path, callback<watch_result> on_complete) const
+{
+    _conn->watch(path, std::move(on_complete));
+}
+
+void client::watch(path_view path, callback<watch_result> on_complete, event_callback on_event) const
+{
+    _conn->watch(path, std::move(on_complete), std::move(on_event));
+}
+
+future<get_children_result> client::get_children(path_view path) const
 {
     return _conn->get_children(path);
 }
 
-future<watch_children_result> client::watch_children(string_view path) const
+future<get_children_result> client::get_children(path_view path, const cancellation_token& cancel) const
+{
+    return future_with_cancellation<get_children_result>(cancel,
+                                                         [&] (auto cb) { this->get_children(path, std::move(cb)); }
+                                                        );
+}
+
+void client::get_children(path_view path, callback<get_children_result> on_complete) const
+{
+    _conn->get_children(path, std::move(on_complete));
+}
+
+future<outcome<get_children_result>> client::try_get_children(path_view path) const
+{
+    return future_outcome_from_callback<get_children_result>([&] (auto cb)
+                                                             {
+                                                                 this->get_children(path, std::move(cb));
+                                                             }
+                                                            );
+}
+
+future<watch_children_result> client::watch_children(path_view path) const
 {
     return _conn->watch_children(path);
 }
 
-future<exists_result> client::exists(string_view path) const
+future<watch_children_result> client::watch_children(path_view path, const cancellation_token& cancel) const
+{
+    return future_from_callback<watch_children_result>([&] (auto cb)
+                                                       {
+                                                           _conn->watch_children(path, std::move(cb), nullptr, cancel);
+                                                       }
+                                                      );
+}
+
+void client::watch_children(path_view path, callback<watch_children_result> on_complete) const
+{
+    _conn->watch_children(path, std::move(on_complete));
+}
+
+void client::watch_children(path_view path, callback<watch_children_result> on_complete, event_callback on_event) const
+{
+    _conn->watch_children(path, std::move(on_complete), std::move(on_event));
+}
+
+future<get_children_list_result> client::get_children_list(path_view path) const
+{
+    return _conn->get_children_list(path);
+}
+
+void client::get_children_list(path_view path, callback<get_children_list_result> on_complete) const
+{
+    _conn->get_children_list(path, std::move(on_complete));
+}
+
+future<watch_children_list_result> client::watch_children_list(path_view path) const
+{
+    return _conn->watch_children_list(path);
+}
+
+void client::watch_children_list(path_view path, callback<watch_children_list_result> on_complete) const
+{
+    _conn->watch_children_list(path, std::move(on_complete));
+}
+
+void client::watch_children_list(path_view                            path,
+                                 callback<watch_children_list_result> on_complete,
+                                 event_callback                       on_event
+                                ) const
+{
+    _conn->watch_children_list(path, std::move(on_complete), std::move(on_event));
+}
+
+future<zk::stat> client::for_each_child(path_view path, child_visitor visitor) const
+{
+    return _conn->for_each_child(path, std::move(visitor));
+}
+
+void client::for_each_child(path_view path, child_visitor visitor, callback<zk::stat> on_complete) const
+{
+    _conn->for_each_child(path, std::move(visitor), std::move(on_complete));
+}
+
+future<exists_result> client::exists(path_view path) const
 {
     return _conn->exists(path);
 }
 
-future<watch_exists_result> client::watch_exists(string_view path) const
+future<exists_result> client::exists(path_view path, const cancellation_token& cancel) const
+{
+    return future_with_cancellation<exists_result>(cancel, [&] (auto cb) { this->exists(path, std::move(cb)); });
+}
+
+void client::exists(path_view path, callback<exists_result> on_complete) const
+{
+    _conn->exists(path, std::move(on_complete));
+}
+
+future<watch_exists_result> client::watch_exists(path_view path) const
 {
     return _conn->watch_exists(path);
 }
 
-future<create_result> client::create(string_view   path,
+future<watch_exists_result> client::watch_exists(path_view path, const cancellation_token& cancel) const
+{
+    return future_from_callback<watch_exists_result>([&] (auto cb)
+                                                     {
+                                                         _conn->watch_exists(path, std::move(cb), nullptr, cancel);
+                                                     }
+                                                    );
+}
+
+void client::watch_exists(path_view path, callback<watch_exists_result> on_complete) const
+{
+    _conn->watch_exists(path, std::move(on_complete));
+}
+
+void client::watch_exists(path_view path, callback<watch_exists_result> on_complete, event_callback on_event) const
+{
+    _conn->watch_exists(path, std::move(on_complete), std::move(on_event));
+}
+
+future<get_result> client::watch_routed(path_view path) const
+{
+    return future_from_callback<get_result>([&] (auto cb) { _conn->watch_routed(path, std::move(cb)); });
+}
+
+void client::watch_routed(path_view path, callback<get_result> on_complete) const
+{
+    _conn->watch_routed(path, std::move(on_complete));
+}
+
+future<get_children_result> client::watch_children_routed(path_view path) const
+{
+    return future_from_callback<get_children_result>([&] (auto cb)
+                                                     {
+                                                         _conn->watch_children_routed(path, std::move(cb));
+                                                     }
+                                                    );
+}
+
+void client::watch_children_routed(path_view path, callback<get_children_result> on_complete) const
+{
+    _conn->watch_children_routed(path, std::move(on_complete));
+}
+
+future<exists_result> client::watch_exists_routed(path_view path) const
+{
+    return future_from_callback<exists_result>([&] (auto cb) { _conn->watch_exists_routed(path, std::move(cb)); });
+}
+
+void client::watch_exists_routed(path_view path, callback<exists_result> on_complete) const
+{
+    _conn->watch_exists_routed(path, std::move(on_complete));
+}
+
+watch_dispatcher& client::dispatcher() const
+{
+    return _conn->dispatcher();
+}
+
+watch_stream client::watch_stream(zk::path path) const
+{
+    return zk::watch_stream(*this, std::move(path));
+}
+
+watch_stream client::watch_stream(zk::path path, callback<watch_update> on_update) const
+{
+    return zk::watch_stream(*this, std::move(path), std::move(on_update));
+}
+
+future<create_result> client::create(path_view     path,
                                      const buffer& data,
                                      const acl&    rules,
                                      create_mode   mode
@@ -113,42 +401,788 @@ future<create_result> client::create(string_view   path,
     return _conn->create(path, data, rules, mode);
 }
 
-future<create_result> client::create(string_view   path,
+future<create_result> client::create(path_view         path,
+                                     const buffer&     data,
+                                     const acl_handle& rules,
+                                     create_mode       mode
+                                    )
+{
+    return _conn->create(path, data, rules, mode);
+}
+
+void client::create(path_view               path,
+                    const buffer&           data,
+                    const acl&              rules,
+                    create_mode             mode,
+                    callback<create_result> on_complete
+                   )
+{
+    _conn->create(path, data, rules, mode, std::move(on_complete));
+}
+
+void client::create(path_view               path,
+                    const buffer&           data,
+                    const acl_handle&       rules,
+                    create_mode             mode,
+                    callback<create_result> on_complete
+                   )
+{
+    _conn->create(path, data, rules, mode, std::move(on_complete));
+}
+
+/// The rules of a creation which does not give any, encoded once for all of them.
+static const acl_handle& default_create_rules()
+{
+    static const auto instance = acl_handle::intern(acls::open_unsafe());
+    return instance;
+}
+
+void client::create(path_view path, const buffer& data, create_mode mode, callback<create_result> on_complete)
+{
+    create(path, data, default_create_rules(), mode, std::move(on_complete));
+}
+
+future<create_result> client::create(path_view     path,
                                      const buffer& data,
                                      create_mode   mode
                                     )
 {
-    return create(path, data, acls::open_unsafe(), mode);
+    return create(path, data, default_create_rules(), mode);
+}
+
+template <typename TRules>
+static future<create_result> create_with_cancellation(client&                   self,
+                                                       path_view                 path,
+                                                       const buffer&             data,
+                                                       const TRules&             rules,
+                                                       create_mode               mode,
+                                                       const cancellation_token& cancel
+                                                      )
+{
+    return future_with_cancellation<create_result>(cancel,
+                                                   [&] (auto cb)
+                                                   {
+                                                       self.create(path, data, rules, mode, std::move(cb));
+                                                   }
+                                                  );
+}
+
+future<create_result> client::create(path_view                 path,
+                                     const buffer&             data,
+                                     const acl&                rules,
+                                     create_mode               mode,
+                                     const cancellation_token& cancel
+                                    )
+{
+    return create_with_cancellation(*this, path, data, rules, mode, cancel);
+}
+
+future<create_result> client::create(path_view                 path,
+                                     const buffer&             data,
+                                     const acl_handle&         rules,
+                                     create_mode               mode,
+                                     const cancellation_token& cancel
+                                    )
+{
+    return create_with_cancellation(*this, path, data, rules, mode, cancel);
+}
+
+future<create_result> client::create(path_view                 path,
+                                     const buffer&             data,
+                                     create_mode               mode,
+                                     const cancellation_token& cancel
+                                    )
+{
+    return create(path, data, default_create_rules(), mode, cancel);
+}
+
+future<outcome<create_result>> client::try_create(path_view     path,
+                                                  const buffer& data,
+                                                  const acl&    rules,
+                                                  create_mode   mode
+                                                 )
+{
+    return future_outcome_from_callback<create_result>([&] (auto cb)
+                                                       {
+                                                           this->create(path, data, rules, mode, std::move(cb));
+                                                       }
+                                                      );
+}
+
+future<outcome<create_result>> client::try_create(path_view         path,
+                                                  const buffer&     data,
+                                                  const acl_handle& rules,
+                                                  create_mode       mode
+                                                 )
+{
+    return future_outcome_from_callback<create_result>([&] (auto cb)
+                                                       {
+                                                           this->create(path, data, rules, mode, std::move(cb));
+                                                       }
+                                                      );
+}
+
+future<outcome<create_result>> client::try_create(path_view path, const buffer& data, create_mode mode)
+{
+    return try_create(path, data, default_create_rules(), mode);
+}
+
+namespace
+{
+
+/// The state of a \ref client::create_recursive. The completions of the ancestors arrive before the one of the entry,
+/// as the server answers the requests of a session in order.
+struct recursive_create final :
+        std::enable_shared_from_this<recursive_create>
+{
+    /// How many times the chain of ancestors is sent before giving up on an entry whose ancestors keep disappearing.
+    static constexpr int max_attempts = 4;
+
+    explicit recursive_create(std::shared_ptr<connection> conn,
+                              path_view                   path,
+                              const buffer&               data,
+                              const acl_handle&           rules,
+                              create_mode                 mode,
+                              callback<create_result>     on_complete
+                             ) :
+            conn(std::move(conn)),
+            path(path.data(), path.size()),
+            data(data),
+            rules(rules),
+            mode(mode),
+            on_complete(std::move(on_complete))
+    { }
+
+    void create_entry()
+    {
+        auto self = shared_from_this();
+        conn->create(path,
+                     data,
+                     rules,
+                     mode,
+                     [self] (outcome<create_result> result) { self->on_entry(std::move(result)); }
+                    );
+    }
+
+    void create_chain()
+    {
+        ++attempts;
+        auto self = shared_from_this();
+        for (auto slash = path.find('/', 1U); slash != std::string::npos; slash = path.find('/', slash + 1U))
+        {
+            conn->create(string_view(path).substr(0U, slash),
+                         buffer(),
+                         default_create_rules(),
+                         create_mode::normal,
+                         [self] (outcome<create_result> result)
+                         {
+                             std::unique_lock<std::mutex> ax(self->protect);
+                             if (!result && result.code() != error_code::entry_exists && self->ancestors)
+                                 self->ancestors = outcome<void>(result.code(), result.error());
+                         }
+                        );
+        }
+        create_entry();
+    }
+
+    void on_entry(outcome<create_result> result)
+    {
+        if (result.code() != error_code::no_entry)
+        {
+            on_complete(std::move(result));
+            return;
+        }
+
+        std::unique_lock<std::mutex> ax(protect);
+        auto cause = std::exchange(ancestors, outcome<void>());
+        ax.unlock();
+
+        if (!cause)
+            on_complete(outcome<create_result>(cause.code(), cause.error()));
+        else if (attempts < max_attempts)
+            create_chain();
+        else
+            on_complete(std::move(result));
+    }
+
+    std::shared_ptr<connection> conn;
+    std::string                 path;
+    buffer                      data;
+    acl_handle                  rules;
+    create_mode                 mode;
+    callback<create_result>     on_complete;
+    int                         attempts = 0;
+
+    std::mutex                  protect;
+    outcome<void>               ancestors; //!< Fails with the first error creating an ancestor, other than it existing
+};
+
+}
+
+future<create_result> client::create_recursive(path_view path, const buffer& data, const acl& rules, create_mode mode)
+{
+    return create_recursive(path, data, acl_handle(rules), mode);
 }
 
-future<set_result> client::set(string_view path, const buffer& data, version check)
+future<create_result> client::create_recursive(path_view         path,
+                                               const buffer&     data,
+                                               const acl_handle& rules,
+                                               create_mode       mode
+                                              )
+{
+    return future_from_callback<create_result>([&] (auto cb)
+                                               {
+                                                   this->create_recursive(path, data, rules, mode, std::move(cb));
+                                               }
+                                              );
+}
+
+future<create_result> client::create_recursive(path_view path, const buffer& data, create_mode mode)
+{
+    return create_recursive(path, data, default_create_rules(), mode);
+}
+
+void client::create_recursive(path_view               path,
+                              const buffer&           data,
+                              const acl_handle&       rules,
+                              create_mode             mode,
+                              callback<create_result> on_complete
+                             )
+{
+    std::make_shared<recursive_create>(_conn, path, data, rules, mode, std::move(on_complete))->create_entry();
+}
+
+void client::create_recursive(path_view path, const buffer& data, create_mode mode, callback<create_result> on_complete)
+{
+    create_recursive(path, data, default_create_rules(), mode, std::move(on_complete));
+}
+
+future<set_result> client::set(path_view path, const buffer& data, version check)
 {
     return _conn->set(path, data, check);
 }
 
-future<get_acl_result> client::get_acl(string_view path) const
+future<set_result> client::set(path_view path, const buffer& data, version check, const cancellation_token& cancel)
+{
+    return future_with_cancellation<set_result>(cancel, [&] (auto cb) { this->set(path, data, check, std::move(cb)); });
+}
+
+void client::set(path_view path, const buffer& data, version check, callback<set_result> on_complete)
+{
+    _conn->set(path, data, check, std::move(on_complete));
+}
+
+future<outcome<set_result>> client::try_set(path_view path, const buffer& data, version check)
+{
+    return future_outcome_from_callback<set_result>([&] (auto cb) { this->set(path, data, check, std::move(cb)); });
+}
+
+future<set_result> client::update(path_view path, update_function fn, const update_policy& policy)
+{
+    return future_from_callback<set_result>([&] (auto cb)
+                                            {
+                                                this->update(path, std::move(fn), policy, std::move(cb));
+                                            }
+                                           );
+}
+
+void client::update(path_view path, update_function fn, const update_policy& policy, callback<set_result> on_complete)
+{
+    _conn->updates().submit(_conn, path, std::move(fn), policy, std::move(on_complete));
+}
+
+future<get_acl_result> client::get_acl(path_view path) const
 {
     return _conn->get_acl(path);
 }
 
-future<void> client::set_acl(string_view path, const acl& rules, acl_version check)
+future<get_acl_result> client::get_acl(path_view path, const cancellation_token& cancel) const
+{
+    return future_with_cancellation<get_acl_result>(cancel, [&] (auto cb) { this->get_acl(path, std::move(cb)); });
+}
+
+void client::get_acl(path_view path, callback<get_acl_result> on_complete) const
+{
+    _conn->get_acl(path, std::move(on_complete));
+}
+
+future<outcome<get_acl_result>> client::try_get_acl(path_view path) const
+{
+    return future_outcome_from_callback<get_acl_result>([&] (auto cb) { this->get_acl(path, std::move(cb)); });
+}
+
+future<void> client::set_acl(path_view path, const acl& rules, acl_version check)
 {
     return _conn->set_acl(path, rules, check);
 }
 
-future<void> client::erase(string_view path, version check)
+future<void> client::set_acl(path_view path, const acl& rules, acl_version check, const cancellation_token& cancel)
+{
+    return future_with_cancellation<void>(cancel, [&] (auto cb) { this->set_acl(path, rules, check, std::move(cb)); });
+}
+
+void client::set_acl(path_view path, const acl& rules, acl_version check, callback<void> on_complete)
+{
+    _conn->set_acl(path, rules, check, std::move(on_complete));
+}
+
+future<outcome<void>> client::try_set_acl(path_view path, const acl& rules, acl_version check)
+{
+    return future_outcome_from_callback<void>([&] (auto cb) { this->set_acl(path, rules, check, std::move(cb)); });
+}
+
+future<void> client::erase(path_view path, version check)
 {
     return _conn->erase(path, check);
 }
 
+future<void> client::erase(path_view path, version check, const cancellation_token& cancel)
+{
+    return future_with_cancellation<void>(cancel, [&] (auto cb) { this->erase(path, check, std::move(cb)); });
+}
+
+void client::erase(path_view path, version check, callback<void> on_complete)
+{
+    _conn->erase(path, check, std::move(on_complete));
+}
+
+future<outcome<void>> client::try_erase(path_view path, version check)
+{
+    return future_outcome_from_callback<void>([&] (auto cb) { this->erase(path, check, std::move(cb)); });
+}
+
+namespace
+{
+
+/// The state of a \ref client::erase_recursive. Every entry of the subtree is a \c node, which is listed and then, once
+/// \c remaining (the number of its children which are not erased yet) drops to \c 0, erased. Listings and erasures are
+/// queued as tasks and sent by whichever thread gets to \c pump first, so no more than \c window are in flight at once.
+/// The nodes are kept in a \c std::deque so the path of one stays put while it is being sent.
+struct recursive_erase final :
+        std::enable_shared_from_this<recursive_erase>
+{
+    static constexpr std::size_t window = 1024U;
+
+    /// How many times an entry which keeps gaining children is listed again before giving up on it.
+    static constexpr unsigned max_relists = 16U;
+
+    static constexpr std::size_t no_parent = ~std::size_t(0);
+
+    struct node
+    {
+        std::string path;
+        std::size_t parent;
+        std::size_t remaining = 0U;
+        unsigned    relists   = 0U;
+    };
+
+    struct task
+    {
+        bool        erase; //!< Erase the node if set, list it if not
+        std::size_t node;
+    };
+
+    explicit recursive_erase(std::shared_ptr<connection> conn, path_view path, callback<void> on_complete) :
+            conn(std::move(conn)),
+            on_complete(std::move(on_complete))
+    {
+        nodes.push_back(node{ std::string(path.data(), path.size()), no_parent });
+        tasks.push_back(task{ false, 0U });
+    }
+
+    void pump()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (pumping)
+            return;
+
+        pumping = true;
+        while (status && in_flight < window && !tasks.empty())
+        {
+            auto next = tasks.front();
+            tasks.pop_front();
+            ++in_flight;
+            const auto& path = nodes[next.node].path;
+            ax.unlock();
+
+            send(next, path);
+            ax.lock();
+        }
+        pumping = false;
+
+        if (reported || in_flight > 0U || (status && !finished))
+            return;
+        reported = true;
+        auto result = std::exchange(status, outcome<void>());
+        ax.unlock();
+
+        on_complete(std::move(result));
+    }
+
+    void send(const task& next, const std::string& path)
+    {
+        auto self = shared_from_this();
+        auto idx  = next.node;
+        if (next.erase)
+            conn->erase(path,
+                        version::any(),
+                        [self, idx] (outcome<void> result) { self->on_erased(idx, std::move(result)); }
+                       );
+        else
+            conn->get_children(path,
+                               [self, idx] (outcome<get_children_result> result)
+                               {
+                                   self->on_listed(idx, std::move(result));
+                               }
+                              );
+    }
+
+    void on_listed(std::size_t idx, outcome<get_children_result> result)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        --in_flight;
+        if (result)
+        {
+            const auto& children = result->children();
+            nodes[idx].remaining = children.size();
+            if (children.empty())
+                tasks.push_back(task{ true, idx });
+
+            for (const auto& name : children)
+            {
+                nodes.push_back(node{ nodes[idx].path + '/' + name, idx });
+                tasks.push_back(task{ false, nodes.size() - 1U });
+            }
+        }
+        else if (result.code() == error_code::no_entry && idx != 0U)
+        {
+            gone(idx);
+        }
+        else
+        {
+            fail(outcome<void>(result.code(), result.error()));
+        }
+        ax.unlock();
+
+        pump();
+    }
+
+    void on_erased(std::size_t idx, outcome<void> result)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        --in_flight;
+        if (result || result.code() == error_code::no_entry)
+        {
+            gone(idx);
+        }
+        else if (result.code() == error_code::not_empty && ++nodes[idx].relists <= max_relists)
+        {
+            // Someone added a child since the listing, so find out what it is and erase that first
+            tasks.push_back(task{ false, idx });
+        }
+        else
+        {
+            fail(std::move(result));
+        }
+        ax.unlock();
+
+        pump();
+    }
+
+    /// The node \a idx has been erased. Called with the lock held.
+    void gone(std::size_t idx)
+    {
+        auto parent = nodes[idx].parent;
+        if (parent == no_parent)
+            finished = true;
+        else if (--nodes[parent].remaining == 0U)
+            tasks.push_back(task{ true, parent });
+    }
+
+    /// Stop sending tasks and complete with \a reason once those in flight are done. Called with the lock held.
+    void fail(outcome<void> reason)
+    {
+        if (status)
+            status = std::move(reason);
+        tasks.clear();
+    }
+
+    std::shared_ptr<connection> conn;
+    callback<void>              on_complete;
+
+    std::mutex                  protect;
+    std::deque<node>            nodes;
+    std::deque<task>            tasks;
+    std::size_t                 in_flight = 0U;
+    bool                        pumping   = false;
+    bool                        finished  = false; //!< The entry at the top of the subtree has been erased
+    bool                        reported  = false;
+    outcome<void>               status;            //!< Fails with the first error, which stops the erasure
+};
+
+}
+
+future<void> client::erase_recursive(path_view path)
+{
+    return future_from_callback<void>([&] (auto cb) { this->erase_recursive(path, std::move(cb)); });
+}
+
+void client::erase_recursive(path_view path, callback<void> on_complete)
+{
+    if (path.view() == "/")
+    {
+        on_complete(outcome<void>(error_code::invalid_arguments,
+                                  std::make_exception_ptr(invalid_arguments(error_code::invalid_arguments,
+                                                                            "The root entry can not be erased"
+                                                                           )
+                                                         )
+                                 ));
+        return;
+    }
+
+    std::make_shared<recursive_erase>(_conn, path, std::move(on_complete))->pump();
+}
+
 future<void> client::load_fence() const
 {
     return _conn->load_fence();
 }
 
+future<void> client::load_fence(const cancellation_token& cancel) const
+{
+    return future_with_cancellation<void>(cancel, [&] (auto cb) { this->load_fence(std::move(cb)); });
+}
+
+void client::load_fence(callback<void> on_complete) const
+{
+    _conn->load_fence(std::move(on_complete));
+}
+
+future<get_result> client::get_linearizable(path_view path) const
+{
+    return _conn->get_linearizable(path);
+}
+
+void client::get_linearizable(path_view path, callback<get_result> on_complete) const
+{
+    _conn->get_linearizable(path, std::move(on_complete));
+}
+
+future<get_children_result> client::get_children_linearizable(path_view path) const
+{
+    return _conn->get_children_linearizable(path);
+}
+
+void client::get_children_linearizable(path_view path, callback<get_children_result> on_complete) const
+{
+    _conn->get_children_linearizable(path, std::move(on_complete));
+}
+
+future<exists_result> client::exists_linearizable(path_view path) const
+{
+    return _conn->exists_linearizable(path);
+}
+
+void client::exists_linearizable(path_view path, callback<exists_result> on_complete) const
+{
+    _conn->exists_linearizable(path, std::move(on_complete));
+}
+
+future<get_result> client::get_config() const
+{
+    return _conn->get_config();
+}
+
+void client::get_config(callback<get_result> on_complete) const
+{
+    _conn->get_config(std::move(on_complete));
+}
+
+future<get_result> client::reconfigure(const std::vector<std::string>& joining,
+                                       const std::vector<std::string>& leaving,
+                                       version                         from_config
+                                      )
+{
+    return _conn->reconfigure(joining, leaving, {}, from_config);
+}
+
+void client::reconfigure(const std::vector<std::string>& joining,
+                         const std::vector<std::string>& leaving,
+                         version                         from_config,
+                         callback<get_result>            on_complete
+                        )
+{
+    _conn->reconfigure(joining, leaving, {}, from_config, std::move(on_complete));
+}
+
+future<get_result> client::reconfigure_members(const std::vector<std::string>& members, version from_config)
+{
+    return _conn->reconfigure({}, {}, members, from_config);
+}
+
+void client::reconfigure_members(const std::vector<std::string>& members,
+                                 version                         from_config,
+                                 callback<get_result>            on_complete
+                                )
+{
+    _conn->reconfigure({}, {}, members, from_config, std::move(on_complete));
+}
+
+void client::update_hosts(const std::vector<std::string>& hosts)
+{
+    _conn->update_hosts(hosts);
+}
+
+optional<session_credentials> client::current_session() const
+{
+    return _conn->current_session();
+}
+
 future<multi_result> client::commit(multi_op txn)
 {
     return _conn->commit(std::move(txn));
 }
 
+future<multi_result> client::commit(multi_op txn, const cancellation_token& cancel)
+{
+    return future_with_cancellation<multi_result>(cancel,
+                                                  [&] (auto cb) { this->commit(std::move(txn), std::move(cb)); }
+                                                 );
+}
+
+void client::commit(multi_op txn, callback<multi_result> on_complete)
+{
+    _conn->commit(std::move(txn), std::move(on_complete));
+}
+
+future<outcome<multi_result>> client::try_commit(multi_op txn)
+{
+    return future_outcome_from_callback<multi_result>([&] (auto cb) { this->commit(std::move(txn), std::move(cb)); });
+}
+
+prepared_multi client::prepare(multi_op txn) const
+{
+    return _conn->prepare(std::move(txn));
+}
+
+future<multi_result> client::commit(const prepared_multi& txn)
+{
+    return _conn->commit(txn);
+}
+
+void client::commit(const prepared_multi& txn, callback<multi_result> on_complete)
+{
+    _conn->commit(txn, std::move(on_complete));
+}
+
+future<outcome<multi_result>> client::try_commit(const prepared_multi& txn)
+{
+    return future_outcome_from_callback<multi_result>([&] (auto cb) { this->commit(txn, std::move(cb)); });
+}
+
+future<multi_result> client::commit(const multi_op_view& txn)
+{
+    return _conn->commit(txn);
+}
+
+void client::commit(const multi_op_view& txn, callback<multi_result> on_complete)
+{
+    _conn->commit(txn, std::move(on_complete));
+}
+
+future<outcome<multi_result>> client::try_commit(const multi_op_view& txn)
+{
+    return future_outcome_from_callback<multi_result>([&] (auto cb) { this->commit(txn, std::move(cb)); });
+}
+
+future<multi_read_result> client::read_many(const multi_op& txn) const
+{
+    return _conn->read_many(txn);
+}
+
+void client::read_many(const multi_op& txn, callback<multi_read_result> on_complete) const
+{
+    _conn->read_many(txn, std::move(on_complete));
+}
+
+future<void> close_all(const std::vector<client>& clients)
+{
+    struct progress
+    {
+        std::mutex    protect;
+        std::size_t   remaining;
+        outcome<void> result;
+        promise<void> done;
+    };
+
+    auto state       = std::make_shared<progress>();
+    state->remaining = clients.size();
+    auto out         = state->done.get_future();
+    if (clients.empty())
+    {
+        state->done.set_value();
+        return out;
+    }
+
+    for (client c : clients)
+    {
+        c.close_async([state] (outcome<void> closed)
+                      {
+                          std::unique_lock<std::mutex> ax(state->protect);
+                          if (!closed && state->result)
+                              state->result = std::move(closed);
+                          if (--state->remaining > 0U)
+                              return;
+                          ax.unlock();
+
+                          if (state->result)
+                              state->done.set_value();
+                          else
+                              state->done.set_exception(state->result.error());
+                      }
+                     );
+    }
+    return out;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// state_subscription                                                                                                 //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+state_subscription::state_subscription(std::weak_ptr<connection> conn, std::size_t id) noexcept :
+        _conn(std::move(conn)),
+        _id(id)
+{ }
+
+state_subscription::state_subscription(state_subscription&& src) noexcept :
+        _conn(std::move(src._conn)),
+        _id(std::exchange(src._id, 0U))
+{ }
+
+state_subscription& state_subscription::operator=(state_subscription&& src) noexcept
+{
+    if (this != &src)
+    {
+        cancel();
+        _conn = std::move(src._conn);
+        _id   = std::exchange(src._id, 0U);
+    }
+    return *this;
+}
+
+state_subscription::~state_subscription() noexcept
+{
+    cancel();
+}
+
+void state_subscription::cancel() noexcept
+{
+    if (auto id = std::exchange(_id, 0U))
+    {
+        if (auto conn = _conn.lock())
+            conn->unsubscribe_state(id);
+    }
+    _conn.reset();
+}
+
 }
@@ -4,14 +4,20 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "buffer.hpp"
+#include "callback.hpp"
 #include "forwards.hpp"
 #include "future.hpp"
+#include "metrics.hpp"
 #include "optional.hpp"
+#include "path.hpp"
 #include "string_view.hpp"
 #include "results.hpp"
 #include "types.hpp"
+#include "update.hpp"
+#include "watch_dispatcher.hpp"
 
 namespace zk
 {
@@ -20,8 +26,67 @@ namespace zk
 /// Interacting with ZooKeeper as a \ref client.
 /// \{
 
+/// Keeps a callback registered with \ref client::subscribe_state. The callback is unregistered when this is destroyed
+/// or \ref cancel is called; a default-constructed subscription holds nothing.
+class state_subscription final
+{
+public:
+    state_subscription() noexcept = default;
+
+    state_subscription(state_subscription&& src) noexcept;
+    state_subscription& operator=(state_subscription&& src) noexcept;
+
+    ~state_subscription() noexcept;
+
+    /// Is a callback still registered through this subscription?
+    explicit operator bool() const noexcept { return _id != 0U; }
+
+    /// Unregister the callback. It is not called again, unless it is being called with a change right now.
+    void cancel() noexcept;
+
+private:
+    friend class client;
+
+    explicit state_subscription(std::weak_ptr<connection> conn, std::size_t id) noexcept;
+
+private:
+    std::weak_ptr<connection> _conn;
+    std::size_t               _id = 0U;
+};
+
 /// A ZooKeeper client connection. This is the primary class for interacting with the ZooKeeper cluster. The best way to
 /// create a client is with the static \ref connect function.
+///
+/// \par Futures and Callbacks
+/// Every operation comes in two forms. The first returns a \c future which is filled when the operation completes. The
+/// second takes a \ref callback as its final parameter and returns nothing -- the callback is invoked exactly once with
+/// the \ref outcome of the operation. The callback form skips the \c promise and \c future shared state entirely and
+/// reports failures as an \ref error_code instead of an exception, which makes it the better choice for high-rate
+/// pipelines. Errors documented below with \c \\throws are delivered as failed outcomes. Unlike the \c future forms,
+/// the callback forms do not have defaulted parameters. See \ref callback for which thread the callback runs on.
+///
+/// \par Expected Failures
+/// The operations which commonly fail as part of normal use -- reading an optional entry, an idempotent \ref create
+/// of something which may already exist, a conditional \ref set -- also have a \c try_ form. It returns a \c future of
+/// an \ref outcome, so checking for \ref error_code::no_entry or \ref error_code::entry_exists is a comparison instead
+/// of catching an exception out of \c future::get.
+///
+/// \code
+/// auto res = client.try_create("/app/config", default_config).get();
+/// if (!res && res.code() != zk::error_code::entry_exists)
+///     res.value(); // throws the unexpected error
+/// \endcode
+///
+/// \par Deadlines and Cancellation
+/// Nothing bounds how long an operation takes short of the session timeout, which can be a long time to wait during a
+/// leader election. The \c future forms of the plain operations can also take a \ref cancellation_token: when it
+/// expires (or its \ref cancellation_source is cancelled) before the operation completes, the future is delivered
+/// with \ref operation_timeout and the late reply is dropped. A watch which is abandoned this way is forgotten right
+/// away. A callback can be bounded the same way by wrapping it with \ref with_cancellation.
+///
+/// \code
+/// auto res = client.get("/config", zk::cancellation_token::after(std::chrono::milliseconds(250)));
+/// \endcode
 class client final
 {
 public:
@@ -62,39 +127,209 @@ public:
     /// automatically.
     void close();
 
+    /// \{
+    /// Start closing the underlying \ref connection without waiting for the server to end the session. Operations and
+    /// watches are cancelled just as with \ref close, but that happens on the connection's own thread; the result is
+    /// delivered once the session is over.
+    future<void> close_async();
+    void close_async(callback<void> on_closed);
+    /// \}
+
+    /// Get the request latencies, error counts and traffic totals of the underlying \ref connection so far. This is
+    /// cheap enough to call from a scrape handler; see \ref write_prometheus to expose it.
+    metrics_snapshot metrics() const;
+
+    /// Call \a on_change with every state the session enters from now on -- connecting, connected, expired and the
+    /// rest -- for as long as the returned subscription is kept. Every change reaches every subscriber, in the order
+    /// they happened, and nothing is allocated to deliver one. The current state is not delivered.
+    ///
+    /// \code
+    /// auto sub = client.subscribe_state([&] (zk::state st) { if (st == zk::state::expired_session) cache.reset(); });
+    /// \endcode
+    state_subscription subscribe_state(state_callback on_change) const;
+
+    /// \{
     /// Return the data and the \ref stat of the entry of the given \a path.
     ///
     /// \throws no_entry If no entry exists at the given \a path, the future will be delievered with \ref no_entry.
-    future<get_result> get(string_view path) const;
+    future<get_result> get(path_view path) const;
+    future<get_result> get(path_view path, const cancellation_token& cancel) const;
+    void get(path_view path, callback<get_result> on_complete) const;
+    future<outcome<get_result>> try_get(path_view path) const;
+    /// \}
+
+    /// \{
+    /// Read the data of the entry at the given \a path into \a target, reusing the storage \a target already has. This
+    /// is the allocation-free way to repeatedly read an entry. The contents of \a target are replaced when the
+    /// operation succeeds and \a target must remain alive and untouched until the operation completes.
+    ///
+    /// \returns The \ref stat of the entry at the time it was read.
+    /// \throws no_entry If no entry exists at the given \a path, the future will be delievered with \ref no_entry.
+    ///
+    /// \see connection_params::read_buffer_pool for recycling the buffers used by \ref get instead.
+    future<zk::stat> get_into(path_view path, buffer& target) const;
+    void get_into(path_view path, buffer& target, callback<zk::stat> on_complete) const;
+    /// \}
+
+    /// \{
+    /// Read every entry named in \a paths. All of the reads are sent at once, so they are pipelined on the session: a
+    /// batch costs roughly one round trip plus the transfer time, rather than one round trip per entry. Result \c i is
+    /// the \ref outcome of reading \c paths[i]; an entry which fails to be read (for example with \ref no_entry) does
+    /// not affect the others.
+    ///
+    /// \code
+    /// auto results = client.get_many({ "/shards/0", "/shards/1", "/shards/2" }).get();
+    /// for (const auto& res : results)
+    ///     if (res)
+    ///         load_shard(res->data());
+    /// \endcode
+    ///
+    /// A \c std::vector of \c std::string or \ref path can be passed as \c {names.begin(), names.end()}.
+    future<std::vector<outcome<get_result>>> get_many(const std::vector<path_view>& paths) const;
+    void get_many(const std::vector<path_view>& paths, callback<std::vector<outcome<get_result>>> on_complete) const;
+    /// \}
 
+    /// \{
+    /// The batched form of \ref get_children (see \ref get_many).
+    future<std::vector<outcome<get_children_result>>> get_children_many(const std::vector<path_view>& paths) const;
+    void get_children_many(const std::vector<path_view>&                       paths,
+                           callback<std::vector<outcome<get_children_result>>> on_complete
+                          ) const;
+    /// \}
+
+    /// \{
+    /// The batched form of \ref exists (see \ref get_many). A missing entry is a successful outcome holding an
+    /// \ref exists_result which is \c false.
+    future<std::vector<outcome<exists_result>>> exists_many(const std::vector<path_view>& paths) const;
+    void exists_many(const std::vector<path_view>&                 paths,
+                     callback<std::vector<outcome<exists_result>>> on_complete
+                    ) const;
+    /// \}
+
+    /// \{
     /// Similar to \ref get, but if the call is successful (no error is returned), a watch will be left on the entry
     /// with the given \a path. The watch will be triggered by a successful operation that sets data or erases the
     /// entry.
     ///
     /// \throws no_entry If no entry exists at the given \a path, the future will be delievered with \ref no_entry. To
     ///  watch for the creation of an entry, use \ref watch_exists.
-    future<watch_result> watch(string_view path) const;
+    ///
+    /// The form taking \a on_event also calls it when the watch triggers, so nothing has to wait on
+    /// \ref watch_result::next to react to the change. It is not called if the watch could not be set.
+    future<watch_result> watch(path_view path) const;
+    future<watch_result> watch(path_view path, const cancellation_token& cancel) const;
+    void watch(path_view path, callback<watch_result> on_complete) const;
+    void watch(path_view path, callback<watch_result> on_complete, event_callback on_event) const;
+    /// \}
 
+    /// \{
     /// Return the list of the children of the entry of the given \a path. The returned values are not prefixed with the
     /// provided \a path; i.e. if the database contains \c "/path/a" and \c "/path/b", the result of \c get_children for
     /// \c "/path" will be `["a", "b"]`. The list of children returned is not sorted and no guarantee is provided as to
     /// its natural or lexical order.
     ///
     /// \throws no_entry If no entry exists at the given \a path, the future will be delievered with \ref no_entry.
-    future<get_children_result> get_children(string_view path) const;
+    future<get_children_result> get_children(path_view path) const;
+    future<get_children_result> get_children(path_view path, const cancellation_token& cancel) const;
+    void get_children(path_view path, callback<get_children_result> on_complete) const;
+    future<outcome<get_children_result>> try_get_children(path_view path) const;
+    /// \}
 
+    /// \{
     /// Similar to \ref get_children, but if the call is successful (no error is returned), a watch will be left on the
     /// entry with the given \a path. The watch will be triggered by a successful operation that erases the entry at the
     /// given \a path or creates or erases a child immediately under the path (it is not recursive).
-    future<watch_children_result> watch_children(string_view path) const;
+    future<watch_children_result> watch_children(path_view path) const;
+    future<watch_children_result> watch_children(path_view path, const cancellation_token& cancel) const;
+    void watch_children(path_view path, callback<watch_children_result> on_complete) const;
+    void watch_children(path_view path, callback<watch_children_result> on_complete, event_callback on_event) const;
+    /// \}
+
+    /// \{
+    /// The same as \ref get_children and \ref watch_children, but the names are delivered in a \ref children_list,
+    /// which costs two allocations instead of one per child. Prefer these for entries with very many children.
+    future<get_children_list_result> get_children_list(path_view path) const;
+    void get_children_list(path_view path, callback<get_children_list_result> on_complete) const;
+
+    future<watch_children_list_result> watch_children_list(path_view path) const;
+    void watch_children_list(path_view path, callback<watch_children_list_result> on_complete) const;
+    void watch_children_list(path_view                            path,
+                             callback<watch_children_list_result> on_complete,
+                             event_callback                       on_event
+                            ) const;
+    /// \}
 
+    /// \{
+    /// Call \a visitor with the name of every child of the entry at \a path, straight from the response of the server.
+    /// No list of the children is ever made, so answering questions like "how many children are there?" or "which is
+    /// the lowest sequence number?" does not allocate per child. Once every child has been visited, the operation
+    /// completes with the \ref stat of the entry at \a path.
+    ///
+    /// \code
+    /// auto lowest = std::make_shared<std::string>();
+    /// client.for_each_child("/locks",
+    ///                       [lowest] (zk::string_view name)
+    ///                       {
+    ///                           if (lowest->empty() || name < *lowest)
+    ///                               lowest->assign(name.data(), name.size());
+    ///                       }
+    ///                      ).get();
+    /// \endcode
+    ///
+    /// \throws no_entry If no entry exists at the given \a path, the future will be delievered with \ref no_entry and
+    ///  \a visitor is never called.
+    future<zk::stat> for_each_child(path_view path, child_visitor visitor) const;
+    void for_each_child(path_view path, child_visitor visitor, callback<zk::stat> on_complete) const;
+    /// \}
+
+    /// \{
     /// Return the \ref stat of the entry of the given \a path or \c nullopt if it does not exist.
-    future<exists_result> exists(string_view path) const;
+    future<exists_result> exists(path_view path) const;
+    future<exists_result> exists(path_view path, const cancellation_token& cancel) const;
+    void exists(path_view path, callback<exists_result> on_complete) const;
+    /// \}
 
+    /// \{
     /// Similar to \ref watch, but if the call is successful (no error is returned), a watch will be left on the entry
     /// with the given \a path. The watch will be triggered by a successful operation that creates the entry, erases the
-    /// entry, or sets the data on the entry.
-    future<watch_exists_result> watch_exists(string_view path) const;
+    /// entry, or sets the data on the entry. Unlike \ref watch, the watch is left even if the entry does not exist.
+    future<watch_exists_result> watch_exists(path_view path) const;
+    future<watch_exists_result> watch_exists(path_view path, const cancellation_token& cancel) const;
+    void watch_exists(path_view path, callback<watch_exists_result> on_complete) const;
+    void watch_exists(path_view path, callback<watch_exists_result> on_complete, event_callback on_event) const;
+    /// \}
+
+    /// \{
+    /// The same as \ref watch, \ref watch_children and \ref watch_exists, but the event of the watch is delivered to
+    /// the handlers \ref dispatcher routes its path to, instead of to a callback of this watch. The result is just the
+    /// initial data, as there is no \c next future to wait on.
+    ///
+    /// Setting the same kind of routed watch on a path more than once before it triggers is cheap: with the \c "zk"
+    /// schema, the ZooKeeper client only keeps one registration for it and only one event is delivered.
+    future<get_result> watch_routed(path_view path) const;
+    void watch_routed(path_view path, callback<get_result> on_complete) const;
+
+    future<get_children_result> watch_children_routed(path_view path) const;
+    void watch_children_routed(path_view path, callback<get_children_result> on_complete) const;
+
+    future<exists_result> watch_exists_routed(path_view path) const;
+    void watch_exists_routed(path_view path, callback<exists_result> on_complete) const;
+    /// \}
+
+    /// The \ref watch_dispatcher of this connection, which the events of the routed watches go to. Every copy of this
+    /// client shares it.
+    watch_dispatcher& dispatcher() const;
+
+    /// \{
+    /// Keep following the data of the entry at \a path until the returned stream is cancelled. Unlike \ref watch,
+    /// which triggers once, the stream sets its watch again every time it triggers and delivers each new version of
+    /// the entry (including its creation and erasure). See \ref zk::watch_stream for the details.
+    ///
+    /// The form taking \a on_update pushes the updates to it; otherwise, they are pulled with
+    /// \ref watch_stream::next.
+    zk::watch_stream watch_stream(zk::path path) const;
+    zk::watch_stream watch_stream(zk::path path, callback<watch_update> on_update) const;
+    /// \}
 
     /// \{
     /// Create an entry at the given \a path.
@@ -106,7 +341,7 @@ public:
     /// \param data The data to create for the entry.
     /// \param mode Specifies the behavior of the created entry (see \ref create_mode for more information).
     /// \param rules The ACL for the created entry. If unspecified, it is equivalent to providing
-    ///  \ref acls::open_unsafe.
+    ///  \ref acls::open_unsafe. Giving an \ref acl_handle sends the encoding it already has.
     /// \returns A future which will be filled with the name of the created entry and its \ref stat.
     ///
     /// \throws entry_exists If an entry with the same actual \a path already exists in the ZooKeeper, the future will
@@ -119,17 +354,107 @@ public:
     /// \throws invalid_acl If the \a acl is invalid or empty, the future will be delivered with \ref invalid_acl.
     /// \throws invalid_arguments The maximum allowable size of the data array is 1 MiB (1,048,576 bytes). If \a data
     ///  is larger than this the future will be delivered with \ref invalid_arguments.
-    future<create_result> create(string_view   path,
+    future<create_result> create(path_view     path,
                                  const buffer& data,
                                  const acl&    rules,
                                  create_mode   mode = create_mode::normal
                                 );
-    future<create_result> create(string_view   path,
+    future<create_result> create(path_view         path,
+                                 const buffer&     data,
+                                 const acl_handle& rules,
+                                 create_mode       mode = create_mode::normal
+                                );
+    future<create_result> create(path_view     path,
                                  const buffer& data,
                                  create_mode   mode = create_mode::normal
                                 );
+    future<create_result> create(path_view                 path,
+                                 const buffer&             data,
+                                 const acl&                rules,
+                                 create_mode               mode,
+                                 const cancellation_token& cancel
+                                );
+    future<create_result> create(path_view                 path,
+                                 const buffer&             data,
+                                 const acl_handle&         rules,
+                                 create_mode               mode,
+                                 const cancellation_token& cancel
+                                );
+    future<create_result> create(path_view                 path,
+                                 const buffer&             data,
+                                 create_mode               mode,
+                                 const cancellation_token& cancel
+                                );
+    void create(path_view               path,
+                const buffer&           data,
+                const acl&              rules,
+                create_mode             mode,
+                callback<create_result> on_complete
+               );
+    void create(path_view               path,
+                const buffer&           data,
+                const acl_handle&       rules,
+                create_mode             mode,
+                callback<create_result> on_complete
+               );
+    void create(path_view path, const buffer& data, create_mode mode, callback<create_result> on_complete);
+    future<outcome<create_result>> try_create(path_view     path,
+                                              const buffer& data,
+                                              const acl&    rules,
+                                              create_mode   mode = create_mode::normal
+                                             );
+    future<outcome<create_result>> try_create(path_view         path,
+                                              const buffer&     data,
+                                              const acl_handle& rules,
+                                              create_mode       mode = create_mode::normal
+                                             );
+    future<outcome<create_result>> try_create(path_view     path,
+                                              const buffer& data,
+                                              create_mode   mode = create_mode::normal
+                                             );
     /// \}
 
+    /// \{
+    /// Create an entry at the given \a path like \ref create, creating whichever of its ancestors are missing. The
+    /// ancestors are made empty and persistent with \ref acls::open_unsafe, like a \ref create without rules, whatever
+    /// the \a rules of the entry are: those are meant for the entry, and rules like \ref acls::read_unsafe would keep
+    /// the rest of the chain from being created under the first ancestor. Create the ancestors yourself if they need
+    /// rules of their own.
+    ///
+    /// The entry is created first, so when its parent exists this costs the same as \ref create. If that fails with
+    /// \ref no_entry, a create for every ancestor is sent back to back with the entry right behind them, without
+    /// waiting for any replies; the server applies the requests of a session in order, so the whole chain costs one
+    /// more round trip however deep it is. An ancestor which already exists (or which someone else creates in the
+    /// meantime) is fine. If an ancestor is erased again before the entry makes it, the chain is sent again a few times
+    /// before the \ref no_entry is delivered.
+    ///
+    /// \throws entry_exists If the entry itself already exists, the future will be delivered with \ref entry_exists.
+    /// \throws not_authorized If a missing ancestor can not be created, the future is delivered with the reason it
+    ///  could not be (like \ref not_authorized) instead of the \ref no_entry of the entry itself.
+    future<create_result> create_recursive(path_view     path,
+                                           const buffer& data,
+                                           const acl&    rules,
+                                           create_mode   mode = create_mode::normal
+                                          );
+    future<create_result> create_recursive(path_view         path,
+                                           const buffer&     data,
+                                           const acl_handle& rules,
+                                           create_mode       mode = create_mode::normal
+                                          );
+    future<create_result> create_recursive(path_view     path,
+                                           const buffer& data,
+                                           create_mode   mode = create_mode::normal
+                                          );
+    void create_recursive(path_view               path,
+                          const buffer&           data,
+                          const acl_handle&       rules,
+                          create_mode             mode,
+                          callback<create_result> on_complete
+                         );
+    void create_recursive(path_view path, const buffer& data, create_mode mode, callback<create_result> on_complete);
+    /// \}
+
+    /// \{
     /// Set the data for the entry of the given \a path if such an entry exists and the given version matches the
     /// version of the entry (if the given version is \ref version::any, there is no version check). This operation, if
     /// successful, will trigger all the watches on the entry of the given \c path left by \ref watch calls.
@@ -139,13 +464,45 @@ public:
     ///  delivered with \ref version_mismatch.
     /// \throws invalid_arguments The maximum allowable size of the data array is 1 MiB (1,048,576 bytes). If \a data
     ///  is larger than this the future will be delivered with \ref invalid_arguments.
-    future<set_result> set(string_view path, const buffer& data, version check = version::any());
+    future<set_result> set(path_view path, const buffer& data, version check = version::any());
+    future<set_result> set(path_view path, const buffer& data, version check, const cancellation_token& cancel);
+    void set(path_view path, const buffer& data, version check, callback<set_result> on_complete);
+    future<outcome<set_result>> try_set(path_view path, const buffer& data, version check = version::any());
+    /// \}
 
+    /// \{
+    /// Replace the data of the entry at \a path with what \a fn makes of its current data, with a \ref set which only
+    /// succeeds if nobody changed the entry since. When someone did, the entry is read again and \a fn is applied to
+    /// the new data, after a jittered wait (see \ref update_policy). This is a read-modify-write which never loses a
+    /// concurrent change, for counters, configuration edits and the like.
+    ///
+    /// The first read can be skipped by taking the data and version from a cache (\ref update_policy::node_cache and
+    /// \ref update_policy::tree_cache). Updates of the same entry through the same connection which overlap are
+    /// merged (see \ref update_policy::merge): the ones which arrive while a write of the entry is in flight are all
+    /// applied, in order, to the data it wrote and go out in the next write, which needs no read since its version is
+    /// known. Each of them is delivered the \ref set_result of the write which included it. \a fn is called on
+    /// whichever thread reads the data (the calling thread, when the data is cached), so it should be quick.
+    ///
+    /// \throws no_entry If no entry exists at the given \a path, the future will be delivered with \ref no_entry.
+    /// \throws version_mismatch If \ref update_policy::max_attempts writes in a row are beaten by other writers, the
+    ///  future will be delivered with \ref version_mismatch.
+    /// \throws invalid_arguments If \a fn throws, the future is delivered with what it threw; a \ref error keeps its
+    ///  code and anything else is reported as \ref invalid_arguments. The other updates merged with it still go ahead.
+    future<set_result> update(path_view path, update_function fn, const update_policy& policy = update_policy());
+    void update(path_view path, update_function fn, const update_policy& policy, callback<set_result> on_complete);
+    /// \}
+
+    /// \{
     /// Return the ACL and \ref stat of the entry of the given path.
     ///
     /// \throws no_entry If no entry exists at the given \a path, the future will be delievered with \ref no_entry.
-    future<get_acl_result> get_acl(string_view path) const;
+    future<get_acl_result> get_acl(path_view path) const;
+    future<get_acl_result> get_acl(path_view path, const cancellation_token& cancel) const;
+    void get_acl(path_view path, callback<get_acl_result> on_complete) const;
+    future<outcome<get_acl_result>> try_get_acl(path_view path) const;
+    /// \}
 
+    /// \{
     /// Set the ACL for the entry of the given \a path if such an entry exists and the given version \a check matches
     /// the version of the entry.
     ///
@@ -156,8 +513,13 @@ public:
     /// \throws no_entry If no entry exists at the given \a path, the future will be delievered with \ref no_entry.
     /// \throws version_mismatch If the given version \a check does not match the entry's version, the future will be
     ///  delivered with \ref version_mismatch.
-    future<void> set_acl(string_view path, const acl& rules, acl_version check = acl_version::any());
+    future<void> set_acl(path_view path, const acl& rules, acl_version check = acl_version::any());
+    future<void> set_acl(path_view path, const acl& rules, acl_version check, const cancellation_token& cancel);
+    void set_acl(path_view path, const acl& rules, acl_version check, callback<void> on_complete);
+    future<outcome<void>> try_set_acl(path_view path, const acl& rules, acl_version check = acl_version::any());
+    /// \}
 
+    /// \{
     /// Erase the entry at the given \a path. The call will succeed if such an entry exists, and the given version
     /// \a check matches the entry's version (if the given version is \ref version::any, it matches any entry's
     /// versions). This operation, if successful, will trigger all the watches on the entry of the given \a path left by
@@ -169,8 +531,33 @@ public:
     ///  delivered with \ref version_mismatch.
     /// \throws not_empty You are only allowed to erase entries with no children. If the entry has children, the future
     ///  will be delievered with \ref not_empty.
-    future<void> erase(string_view path, version check = version::any());
+    future<void> erase(path_view path, version check = version::any());
+    future<void> erase(path_view path, version check, const cancellation_token& cancel);
+    void erase(path_view path, version check, callback<void> on_complete);
+    future<outcome<void>> try_erase(path_view path, version check = version::any());
+    /// \}
 
+    /// \{
+    /// Erase the entry at the given \a path and everything under it. The subtree is listed breadth-first and every
+    /// entry is erased once the listing shows it has no children left, so erasures start at the leaves while the rest
+    /// of the tree is still being listed. Listings and erasures are pipelined, up to 1024 of them in flight at a time,
+    /// which makes erasing a large subtree a matter of a few round trips per level instead of one per entry.
+    ///
+    /// Entries which someone else erases in the meantime are skipped. An entry which gains a child after it was listed
+    /// fails to be erased with \ref not_empty and is listed again, so the new children are erased (in parallel with the
+    /// rest of the tree) before it is retried. The erasure is not atomic: if it fails part of the way through, whatever
+    /// was erased stays erased.
+    ///
+    /// \throws no_entry If no entry exists at the given \a path, the future will be delivered with \ref no_entry.
+    /// \throws invalid_arguments The root entry can not be erased, so asking for it (which would erase everything
+    ///  else before failing) is refused right away.
+    /// \throws not_empty If an entry keeps gaining children as fast as they are erased, the future is eventually
+    ///  delivered with \ref not_empty.
+    future<void> erase_recursive(path_view path);
+    void erase_recursive(path_view path, callback<void> on_complete);
+    /// \}
+
+    /// \{
     /// Ensure that all subsequent reads observe the data at the transaction on the server at or past real-time \e now.
     /// If your application communicates only through reads and writes of ZooKeeper, this operation is never needed.
     /// However, if your application communicates a change in ZooKeeper state through means outside of ZooKeeper (called
@@ -204,7 +591,90 @@ public:
     /// auto guaranteed_future = std::when_all(std::move(fence_future), std::move(data_future));
     /// \endcode
     future<void> load_fence() const;
+    future<void> load_fence(const cancellation_token& cancel) const;
+    void load_fence(callback<void> on_complete) const;
+    /// \}
 
+    /// \{
+    /// Read the entry (or its children, or whether it exists) at \a path as of no earlier than the moment of the call,
+    /// like waiting out a \ref load_fence before reading but in one round trip instead of two. The fence and the read
+    /// go out back to back on the session, which the server answers in order.
+    ///
+    /// \throws no_entry As with \ref get and \ref get_children, the future of those is delivered with \ref no_entry
+    ///  when there is no entry at \a path.
+    future<get_result> get_linearizable(path_view path) const;
+    void get_linearizable(path_view path, callback<get_result> on_complete) const;
+    future<get_children_result> get_children_linearizable(path_view path) const;
+    void get_children_linearizable(path_view path, callback<get_children_result> on_complete) const;
+    future<exists_result> exists_linearizable(path_view path) const;
+    void exists_linearizable(path_view path, callback<exists_result> on_complete) const;
+    /// \}
+
+    /// \{
+    /// Read the configuration of the ensemble (ZooKeeper 3.5+): the \c "server.N=..." lines of its members and its
+    /// \c "version", one to a line, as the data of the result. This is the data of \c "/zookeeper/config" whatever the
+    /// chroot of the session, and the \c data_version of its stat is what \ref reconfigure takes as \c from_config.
+    ///
+    /// \see server::configuration::from_string to turn the data into a \ref server::configuration.
+    future<get_result> get_config() const;
+    void get_config(callback<get_result> on_complete) const;
+    /// \}
+
+    /// \{
+    /// Change the members of the ensemble while it runs (ZooKeeper 3.5+ with \c reconfigEnabled). Servers in
+    /// \a joining look like the lines of \ref get_config without the version (`"server.4=10.0.0.4:2888:3888;2181"`);
+    /// \a leaving lists the IDs of the servers to remove (`"2"`). Clients are not told of the change: once it is done,
+    /// call \ref update_hosts on them, which moves their sessions over without a reconnection storm.
+    ///
+    /// \param from_config The version of the configuration this change is based on (the \c data_version of the
+    ///  \ref get_config result). If the configuration has changed since, the future is delivered with
+    ///  \ref bad_version. With \c version::any(), the change is made to whichever configuration is current.
+    /// \returns The new configuration, in the same form as \ref get_config.
+    ///
+    /// \throws new_configuration_no_quorum If the new ensemble would not be able to form a quorum.
+    /// \throws reconfiguration_in_progress If another change has not finished yet.
+    /// \throws reconfiguration_disabled If the servers are not run with \c reconfigEnabled.
+    /// \throws not_authorized If the session is not allowed to write \c "/zookeeper/config".
+    future<get_result> reconfigure(const std::vector<std::string>& joining,
+                                   const std::vector<std::string>& leaving,
+                                   version                         from_config = version::any()
+                                  );
+    void reconfigure(const std::vector<std::string>& joining,
+                     const std::vector<std::string>& leaving,
+                     version                         from_config,
+                     callback<get_result>            on_complete
+                    );
+    /// \}
+
+    /// \{
+    /// The same as \ref reconfigure, but replace the whole ensemble with \a members instead of adding and removing
+    /// servers.
+    future<get_result> reconfigure_members(const std::vector<std::string>& members,
+                                           version                         from_config = version::any()
+                                          );
+    void reconfigure_members(const std::vector<std::string>& members,
+                             version                         from_config,
+                             callback<get_result>            on_complete
+                            );
+    /// \}
+
+    /// Replace the servers the session may connect to with \a hosts (in the form of \ref connection_params::hosts),
+    /// without closing the session. A session on a server which is not in \a hosts moves to one that is; when servers
+    /// were added, sessions move to them with a probability chosen so every server ends up with an equal share. Calling
+    /// this on every client after a \ref reconfigure spreads them over the new members without a restart.
+    ///
+    /// \throws std::invalid_argument if \a hosts is empty.
+    void update_hosts(const std::vector<std::string>& hosts);
+
+    /// Get the ID and password of the session, to resume it from another process (with
+    /// \ref connection_params::resume_session) if this one is restarted. Keep them somewhere only the process can read,
+    /// as they are all it takes to act as the session.
+    ///
+    /// \returns The credentials or \c nullopt if there is no session yet (before the first connection to a server) or
+    ///  any more (once it has expired or been closed).
+    optional<session_credentials> current_session() const;
+
+    /// \{
     /// Commit the transaction specified by \a txn. The operations are performed atomically: They will either all
     /// succeed or all fail.
     ///
@@ -214,11 +684,57 @@ public:
     /// \throws system_error For the same reasons any other operation might fail, the future will be delivered with a
     ///  specific \ref system_error.
     future<multi_result> commit(multi_op txn);
+    future<multi_result> commit(multi_op txn, const cancellation_token& cancel);
+    void commit(multi_op txn, callback<multi_result> on_complete);
+    future<outcome<multi_result>> try_commit(multi_op txn);
+    /// \}
+
+    /// Prepare \a txn to be committed many times, with \ref prepared_multi::bind_data and
+    /// \ref prepared_multi::bind_version changing what each attempt writes and expects. The connection encodes the
+    /// fixed parts of the transaction here, which is what later commits of it save; it can be committed through any
+    /// client, but another kind of connection commits a copy of its operations instead.
+    ///
+    /// \throws std::invalid_argument if an operation of \a txn has an unknown \ref op_type.
+    prepared_multi prepare(multi_op txn) const;
+
+    /// \{
+    /// Commit the prepared transaction \a txn with the data and versions bound to it right now. It can be rebound as
+    /// soon as this returns, without changing what this commit sends. Otherwise the same as committing a
+    /// \ref multi_op.
+    future<multi_result> commit(const prepared_multi& txn);
+    void commit(const prepared_multi& txn, callback<multi_result> on_complete);
+    future<outcome<multi_result>> try_commit(const prepared_multi& txn);
+    /// \}
+
+    /// \{
+    /// Commit the operations \a txn refers to without copying them into a \ref multi_op first. The paths, data and
+    /// ACLs it views only have to stay valid until this returns; the request has been encoded by then. Otherwise the
+    /// same as committing a \ref multi_op.
+    future<multi_result> commit(const multi_op_view& txn);
+    void commit(const multi_op_view& txn, callback<multi_result> on_complete);
+    future<outcome<multi_result>> try_commit(const multi_op_view& txn);
+    /// \}
+
+    /// \{
+    /// Perform the \ref op::get and \ref op::get_children reads of \a txn. A ZooKeeper 3.6+ server answers them all
+    /// with one response (its \c multiRead); connecting to an older one, or through a connection which can not send
+    /// that, issues them one by one without waiting between them. Unlike a \ref commit, the reads are not atomic: each
+    /// has an outcome of its own, in the order of \a txn.
+    ///
+    /// \throws std::invalid_argument if \a txn has an operation which is not a read.
+    future<multi_read_result> read_many(const multi_op& txn) const;
+    void read_many(const multi_op& txn, callback<multi_read_result> on_complete) const;
+    /// \}
 
 private:
     std::shared_ptr<connection> _conn;
 };
 
+/// Close all of \a clients at once. Every close is started before any of them is waited on, so shutting down a pool
+/// takes about as long as its slowest session rather than the sum of them. The future is delivered once the last one
+/// is closed, with the first failure if there was one.
+future<void> close_all(const std::vector<client>& clients);
+
 /// \}
 
 }
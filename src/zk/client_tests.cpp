@@ -2,13 +2,27 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <cstring>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "cancellation.hpp"
 #include "client.hpp"
+#include "connection.hpp"
 #include "error.hpp"
+#include "executor.hpp"
+#include "jute.hpp"
 #include "multi.hpp"
+#include "observer.hpp"
 #include "string_view.hpp"
 
 namespace zk
@@ -197,6 +211,693 @@ GTEST_TEST_F(client_tests, watch_close)
     CHECK_EQ(ev.state(), state::closed);
 }
 
+GTEST_TEST_F(client_tests, close_all)
+{
+    // The handles share one closing thread, which gets through every one of them
+    std::vector<client> clients;
+    for (int idx = 0; idx < 8; ++idx)
+        clients.push_back(get_connected_client());
+    auto watch = clients.back().watch("/").get();
+
+    close_all(clients).get();
+    CHECK_EQ(state::closed, watch.next().get().state());
+}
+
+GTEST_TEST_F(client_tests, subscribe_state)
+{
+    auto conn = connection::connect(get_connection_string());
+
+    std::mutex         seen_protect;
+    std::vector<state> seen;
+    promise<void>      connected;
+    auto               connected_fut = connected.get_future();
+    client             c(conn);
+    auto               sub = c.subscribe_state([&] (state st)
+                                               {
+                                                   std::unique_lock<std::mutex> ax(seen_protect);
+                                                   seen.push_back(st);
+                                                   if (st == state::connected && seen.size() == 1U)
+                                                       connected.set_value();
+                                               }
+                                              );
+    CHECK_TRUE(bool(sub));
+    if (conn->state() != state::connected)
+        connected_fut.get();
+
+    // A cancelled subscription hears nothing more
+    sub.cancel();
+    CHECK_FALSE(bool(sub));
+    c.close();
+}
+
+GTEST_TEST_F(client_tests, get_into)
+{
+    client c = get_connected_client();
+    c.create("/get-into", buffer_from("some data")).get();
+
+    buffer target(64, 'x');
+    auto stat = c.get_into("/get-into", target).get();
+    CHECK_TRUE(target == buffer_from("some data"));
+    CHECK_EQ(9, stat.data_size);
+
+    CHECK_THROWS(no_entry)
+    {
+        c.get_into("/get-into/missing", target).get();
+    };
+}
+
+template <typename TResult>
+static future<outcome<TResult>> callback_future(std::shared_ptr<promise<outcome<TResult>>>& prom)
+{
+    prom = std::make_shared<promise<outcome<TResult>>>();
+    return prom->get_future();
+}
+
+GTEST_TEST_F(client_tests, get_many)
+{
+    client c = get_connected_client();
+    c.create("/many", buffer_from("root")).get();
+    c.create("/many/a", buffer_from("a")).get();
+    c.create("/many/b", buffer_from("b")).get();
+
+    auto gets = c.get_many({ "/many/a", "/many/missing", "/many/b" }).get();
+    CHECK_EQ(3U, gets.size());
+    CHECK_TRUE(gets[0].value().data() == buffer_from("a"));
+    CHECK_EQ(error_code::no_entry, gets[1].code());
+    CHECK_TRUE(gets[2].value().data() == buffer_from("b"));
+
+    auto exists = c.exists_many({ "/many/a", "/many/missing" }).get();
+    CHECK_TRUE(exists[0].value());
+    CHECK_FALSE(exists[1].value());
+
+    std::vector<std::string> names = { "/many", "/many/missing" };
+    auto children = c.get_children_many({ names.begin(), names.end() }).get();
+    CHECK_EQ(2U, children[0].value().children().size());
+    CHECK_EQ(error_code::no_entry, children[1].code());
+
+    CHECK_TRUE(c.get_many({}).get().empty());
+}
+
+GTEST_TEST_F(client_tests, get_children_list)
+{
+    client c = get_connected_client();
+    c.create("/listed", buffer_from("root")).get();
+    c.create("/listed/b", buffer()).get();
+    c.create("/listed/a", buffer()).get();
+
+    auto listed = c.get_children_list("/listed").get();
+    CHECK_EQ(2U, listed.parent_stat().children_count);
+    listed.children().sort();
+    CHECK_EQ(children_list(std::vector<std::string>{ "a", "b" }), listed.children());
+
+    auto watched = c.watch_children_list("/listed").get();
+    CHECK_EQ(2U, watched.initial().children().size());
+    c.create("/listed/c", buffer()).get();
+    CHECK_EQ(event_type::child, watched.next().get().type());
+    CHECK_EQ(3U, c.get_children_list("/listed").get().children().size());
+}
+
+GTEST_TEST_F(client_tests, for_each_child)
+{
+    client c = get_connected_client();
+    c.create("/visited", buffer()).get();
+    for (int idx = 0; idx < 5; ++idx)
+        c.create("/visited/seq-", buffer(), create_mode::sequential).get();
+
+    std::size_t count = 0U;
+    std::string lowest;
+    auto parent = c.for_each_child("/visited",
+                                   [&] (string_view name)
+                                   {
+                                       ++count;
+                                       if (lowest.empty() || name < lowest)
+                                           lowest.assign(name.data(), name.size());
+                                   }
+                                  ).get();
+    CHECK_EQ(5U, count);
+    CHECK_EQ(5U, parent.children_count);
+    CHECK_EQ("seq-0000000000", lowest);
+
+    CHECK_THROWS(no_entry)
+    {
+        c.for_each_child("/visited-missing", [] (string_view) { }).get();
+    };
+}
+
+GTEST_TEST_F(client_tests, callback_create_get_erase)
+{
+    client c = get_connected_client();
+
+    std::shared_ptr<promise<outcome<create_result>>> create_prom;
+    auto create_fut = callback_future(create_prom);
+    c.create("/callback-node", buffer_from("Hi"), create_mode::normal,
+             [create_prom] (outcome<create_result> res) { create_prom->set_value(std::move(res)); }
+            );
+    CHECK_EQ("/callback-node", create_fut.get().value().name());
+
+    std::shared_ptr<promise<outcome<get_result>>> get_prom;
+    auto get_fut = callback_future(get_prom);
+    c.get("/callback-node", [get_prom] (outcome<get_result> res) { get_prom->set_value(std::move(res)); });
+    CHECK_TRUE(get_fut.get().value().data() == buffer_from("Hi"));
+
+    std::shared_ptr<promise<outcome<void>>> erase_prom;
+    auto erase_fut = callback_future(erase_prom);
+    c.erase("/callback-node", version::any(), [erase_prom] (outcome<void> res) { erase_prom->set_value(res); });
+    CHECK_TRUE(erase_fut.get());
+}
+
+GTEST_TEST_F(client_tests, callback_error_is_a_code)
+{
+    client c = get_connected_client();
+
+    std::shared_ptr<promise<outcome<get_result>>> get_prom;
+    auto get_fut = callback_future(get_prom);
+    c.get("/no/such/node", [get_prom] (outcome<get_result> res) { get_prom->set_value(std::move(res)); });
+    auto res = get_fut.get();
+    CHECK_FALSE(res);
+    CHECK_EQ(error_code::no_entry, res.code());
+}
+
+GTEST_TEST_F(client_tests, try_create_get_erase)
+{
+    client c = get_connected_client();
+
+    CHECK_EQ(error_code::no_entry, c.try_get("/try-node").get().code());
+
+    auto created = c.try_create("/try-node", buffer_from("tried")).get();
+    CHECK_EQ("/try-node", created.value().name());
+    CHECK_EQ(error_code::entry_exists, c.try_create("/try-node", buffer_from("again")).get().code());
+
+    auto contents = c.try_get("/try-node").get();
+    CHECK_TRUE(contents->data() == buffer_from("tried"));
+    CHECK_EQ(error_code::version_mismatch, c.try_set("/try-node", buffer_from("x"), version(10)).get().code());
+
+    CHECK_TRUE(c.try_erase("/try-node").get());
+    CHECK_EQ(error_code::no_entry, c.try_erase("/try-node").get().code());
+}
+
+GTEST_TEST_F(client_tests, create_recursive)
+{
+    client c = get_connected_client();
+
+    auto created = c.create_recursive("/deep/a/b/c", buffer_from("leaf")).get();
+    CHECK_EQ("/deep/a/b/c", created.name());
+    CHECK_TRUE(c.get("/deep/a/b/c").get().data() == buffer_from("leaf"));
+    CHECK_TRUE(c.get("/deep/a").get().data().empty());
+
+    // Existing ancestors are fine, an existing entry is not
+    CHECK_EQ("/deep/a/x", c.create_recursive("/deep/a/x", buffer()).get().name());
+    CHECK_THROWS(entry_exists) { c.create_recursive("/deep/a/b/c", buffer()).get(); };
+
+    auto seq = c.create_recursive("/deep/seq/item-", buffer(), create_mode::sequential).get();
+    CHECK_EQ("/deep/seq/item-", seq.name().substr(0U, 15U));
+}
+
+GTEST_TEST_F(client_tests, create_recursive_ancestor_rules)
+{
+    client c = get_connected_client();
+
+    // Ancestors made with a read-only leaf's rules would not let the rest of the chain be created under them
+    auto created = c.create_recursive("/read-only/a/leaf", buffer_from("leaf"), acls::read_unsafe()).get();
+    CHECK_EQ("/read-only/a/leaf", created.name());
+    CHECK_TRUE(c.get_acl("/read-only/a/leaf").get().acl() == acls::read_unsafe());
+    CHECK_TRUE(c.get_acl("/read-only/a").get().acl() == acls::open_unsafe());
+    CHECK_TRUE(c.get_acl("/read-only").get().acl() == acls::open_unsafe());
+}
+
+GTEST_TEST_F(client_tests, erase_recursive)
+{
+    client c = get_connected_client();
+    c.create("/wide", buffer()).get();
+    std::vector<future<create_result>> creates;
+    for (int outer = 0; outer < 20; ++outer)
+    {
+        auto branch = "/wide/" + std::to_string(outer);
+        creates.emplace_back(c.create(branch, buffer()));
+        for (int inner = 0; inner < 50; ++inner)
+            creates.emplace_back(c.create(branch + "/" + std::to_string(inner), buffer()));
+    }
+    for (auto& created : creates)
+        created.get();
+    c.create_recursive("/wide/7/3/deeper/still", buffer()).get();
+
+    c.erase_recursive("/wide").get();
+    CHECK_FALSE(c.exists("/wide").get());
+
+    CHECK_THROWS(no_entry) { c.erase_recursive("/wide").get(); };
+    CHECK_THROWS(invalid_arguments) { c.erase_recursive("/").get(); };
+
+    c.create("/single", buffer()).get();
+    c.erase_recursive("/single").get();
+    CHECK_FALSE(c.exists("/single").get());
+}
+
+GTEST_TEST_F(client_tests, max_reads_in_flight)
+{
+    auto params = connection_params::parse(get_connection_string());
+    params.max_reads_in_flight() = 1U;
+    client c = client::connect(params).get();
+
+    // Hold up the completion thread in the callback of the first read, so the second read stays in flight
+    std::promise<void> first_running;
+    std::promise<void> release_first;
+    auto               release_fut = release_first.get_future().share();
+    c.get("/", [&, release_fut] (outcome<get_result>) { first_running.set_value(); release_fut.wait(); });
+    first_running.get_future().get();
+
+    auto second = c.try_get("/");
+    CHECK_EQ(error_code::throttled, c.try_get("/").get().code());
+
+    release_first.set_value();
+    CHECK_TRUE(second.get());
+    CHECK_TRUE(c.try_get("/").get());
+}
+
+GTEST_TEST_F(client_tests, throttled_routed_watches_are_not_counted)
+{
+    auto params = connection_params::parse(get_connection_string());
+    params.max_reads_in_flight() = 1U;
+    client c = client::connect(params).get();
+
+    std::promise<void> first_running;
+    std::promise<void> release_first;
+    auto               release_fut = release_first.get_future().share();
+    c.get("/", [&, release_fut] (outcome<get_result>) { first_running.set_value(); release_fut.wait(); });
+    first_running.get_future().get();
+
+    // Like the second read of max_reads_in_flight, this one holds the budget until the completion thread is released
+    auto second = c.try_get("/");
+
+    // The budget is spent, so none of these reach the server and no watch is set
+    auto before = c.metrics();
+    CHECK_THROWS(throttled) { c.watch_routed("/").get(); };
+    CHECK_THROWS(throttled) { c.watch_children_routed("/").get(); };
+    CHECK_THROWS(throttled) { c.watch_exists_routed("/").get(); };
+    CHECK_EQ(before.watches_set, c.metrics().watches_set);
+
+    release_first.set_value();
+    CHECK_TRUE(second.get());
+    c.watch_exists_routed("/").get();
+    CHECK_EQ(before.watches_set + 1U, c.metrics().watches_set);
+}
+
+GTEST_TEST_F(client_tests, deadline_expires_while_completions_wait)
+{
+    client c = get_connected_client();
+    c.create("/deadline", buffer_from("a")).get();
+
+    // With the completion thread held up, nothing else can complete except through the deadline
+    std::promise<void> first_running;
+    std::promise<void> release_first;
+    auto               release_fut = release_first.get_future().share();
+    c.get("/", [&, release_fut] (outcome<get_result>) { first_running.set_value(); release_fut.wait(); });
+    first_running.get_future().get();
+
+    auto deadline = cancellation_token::after(std::chrono::milliseconds(20));
+    auto read     = c.get("/deadline", deadline);
+    auto watch    = c.watch_exists("/deadline", deadline);
+    CHECK_THROWS(operation_timeout) { read.get(); };
+    CHECK_THROWS(operation_timeout) { watch.get(); };
+
+    // The late replies are dropped and the abandoned watch is never delivered
+    release_first.set_value();
+    c.erase("/deadline").get();
+    CHECK_THROWS(operation_timeout) { c.get("/", cancellation_token::after(std::chrono::seconds(0))).get(); };
+    c.get("/", cancellation_token::after(std::chrono::seconds(10))).get();
+}
+
+GTEST_TEST_F(client_tests, completion_executor)
+{
+    auto params = connection_params::parse(get_connection_string());
+    params.completion_executor() = thread_pool_executor(2U);
+    client c = client::connect(params).get();
+    c.create("/offload", buffer_from("a")).get();
+
+    // A callback holding up its executor thread no longer stops the completions of other requests
+    std::promise<void> first_running;
+    std::promise<void> release_first;
+    auto               release_fut = release_first.get_future().share();
+    c.get("/", [&, release_fut] (outcome<get_result>) { first_running.set_value(); release_fut.wait(); });
+    first_running.get_future().get();
+    CHECK_TRUE(c.get("/offload").get().data() == buffer_from("a"));
+
+    release_first.set_value();
+
+    // The data of a watch still comes before its event
+    std::mutex               order_protect;
+    std::vector<std::string> order;
+    std::promise<void>       got_event;
+    c.watch("/offload",
+            [&] (outcome<watch_result>)
+            {
+                std::unique_lock<std::mutex> ax(order_protect);
+                order.emplace_back("data");
+            },
+            [&] (event)
+            {
+                {
+                    std::unique_lock<std::mutex> ax(order_protect);
+                    order.emplace_back("event");
+                }
+                got_event.set_value();
+            }
+           );
+    c.set("/offload", buffer_from("b")).get();
+    got_event.get_future().get();
+
+    std::unique_lock<std::mutex> ax(order_protect);
+    CHECK_EQ(2U, order.size());
+    CHECK_EQ("data", order[0]);
+}
+
+GTEST_TEST_F(client_tests, callback_watch)
+{
+    client c = get_connected_client();
+    c.create("/callback-watch", buffer_from("a")).get();
+
+    std::shared_ptr<promise<outcome<watch_result>>> watch_prom;
+    auto watch_fut = callback_future(watch_prom);
+    c.watch("/callback-watch", [watch_prom] (outcome<watch_result> res) { watch_prom->set_value(std::move(res)); });
+    auto watch = watch_fut.get().value();
+    CHECK_TRUE(watch.initial().data() == buffer_from("a"));
+
+    c.set("/callback-watch", buffer_from("b")).get();
+    auto ev = watch.next().get();
+    CHECK_EQ(ev.type(), event_type::changed);
+}
+
+GTEST_TEST_F(client_tests, callback_watch_event)
+{
+    client c = get_connected_client();
+    c.create("/callback-watch-event", buffer_from("a")).get();
+
+    auto ev_prom = std::make_shared<promise<event>>();
+    auto ev_fut  = ev_prom->get_future();
+    std::shared_ptr<promise<outcome<watch_exists_result>>> watch_prom;
+    auto watch_fut = callback_future(watch_prom);
+    c.watch_exists("/callback-watch-event",
+                   [watch_prom] (outcome<watch_exists_result> res) { watch_prom->set_value(std::move(res)); },
+                   [ev_prom] (event ev) { ev_prom->set_value(ev); }
+                  );
+    CHECK_TRUE(watch_fut.get().value().initial());
+
+    c.erase("/callback-watch-event").get();
+    CHECK_EQ(ev_fut.get().type(), event_type::erased);
+}
+
+GTEST_TEST_F(client_tests, watch_coalescing)
+{
+    client c = get_connected_client();
+    c.create("/coalesced", buffer_from("a")).get();
+    auto before = c.metrics();
+
+    // Only the first watch goes to the server; the others share it, whether it is still being set or already set
+    std::vector<future<watch_result>> pending;
+    for (int idx = 0; idx < 20; ++idx)
+        pending.emplace_back(c.watch("/coalesced"));
+    std::vector<watch_result> watches;
+    for (auto& watch : pending)
+        watches.emplace_back(watch.get());
+    watches.emplace_back(c.watch("/coalesced").get());
+
+    auto after = c.metrics();
+    CHECK_EQ(1U, after.watches_set - before.watches_set);
+    CHECK_EQ(20U, after.watches_coalesced - before.watches_coalesced);
+
+    c.set("/coalesced", buffer_from("b")).get();
+    for (auto& watch : watches)
+    {
+        CHECK_EQ(1U, watch.initial().data().size());
+        CHECK_EQ(event_type::changed, watch.next().get().type());
+    }
+
+    // Once it triggered, the next watch is a new one
+    c.watch("/coalesced").get();
+    CHECK_EQ(2U, c.metrics().watches_set - before.watches_set);
+}
+
+GTEST_TEST_F(client_tests, routed_watches)
+{
+    client c = get_connected_client();
+    c.create("/routed", buffer()).get();
+    c.create("/routed/a", buffer_from("a")).get();
+
+    std::mutex         seen_protect;
+    std::vector<event> seen;
+    promise<void>      all_seen;
+    auto               all_seen_fut = all_seen.get_future();
+    c.dispatcher().on_prefix("/routed",
+                             [&] (const event& ev)
+                             {
+                                 std::unique_lock<std::mutex> ax(seen_protect);
+                                 seen.push_back(ev);
+                                 if (seen.size() == 3U)
+                                     all_seen.set_value();
+                             }
+                            );
+
+    // Setting the same watch again does not add a second event
+    CHECK_EQ("a", std::string(c.watch_routed("/routed/a").get().data().data(), 1U));
+    c.watch_routed("/routed/a").get();
+    CHECK_TRUE(c.watch_children_routed("/routed").get().children().size() == 1U);
+    CHECK_FALSE(c.watch_exists_routed("/routed/b").get());
+
+    c.set("/routed/a", buffer_from("A")).get();
+    c.create("/routed/b", buffer()).get();
+    all_seen_fut.get();
+
+    std::unique_lock<std::mutex> ax(seen_protect);
+    CHECK_EQ(3U, seen.size());
+    for (const auto& ev : seen)
+    {
+        if (ev.path() == "/routed/a")
+            CHECK_EQ(event_type::changed, ev.type());
+        else if (ev.path() == "/routed")
+            CHECK_EQ(event_type::child, ev.type());
+        else
+            CHECK_EQ(event_type::created, ev.type());
+    }
+}
+
+GTEST_TEST_F(client_tests, callback_commit_failure)
+{
+    client c = get_connected_client();
+
+    multi_op txn =
+    {
+        op::create("/callback-txn", buffer()),
+        op::check("/callback-txn", version(5)),
+    };
+
+    std::shared_ptr<promise<outcome<multi_result>>> commit_prom;
+    auto commit_fut = callback_future(commit_prom);
+    c.commit(std::move(txn), [commit_prom] (outcome<multi_result> res) { commit_prom->set_value(std::move(res)); });
+    auto res = commit_fut.get();
+    CHECK_EQ(error_code::transaction_failed, res.code());
+    CHECK_THROWS(transaction_failed)
+    {
+        res.value();
+    };
+}
+
+class recording_observer final :
+        public connection_observer
+{
+public:
+    struct record
+    {
+        request_type   type;
+        std::string    path;
+        error_code     rc;
+        std::uintptr_t context;
+    };
+
+public:
+    virtual ptr<void> on_submit(request_type, string_view, std::size_t) noexcept override
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return reinterpret_cast<ptr<void>>(++submitted);
+    }
+
+    virtual void on_complete(request_type type, string_view path, error_code rc, duration, ptr<void> context)
+        noexcept override
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        completed.push_back(record{ type, std::string(path), rc, reinterpret_cast<std::uintptr_t>(context) });
+    }
+
+public:
+    std::mutex          protect;
+    std::uintptr_t      submitted = 0U;
+    std::vector<record> completed;
+};
+
+GTEST_TEST_F(client_tests, observer)
+{
+    auto observer = std::make_shared<recording_observer>();
+    auto params   = connection_params::parse(get_connection_string());
+    params.observer() = observer;
+    client c = client::connect(params).get();
+
+    c.create("/observed", buffer_from("x")).get();
+    CHECK_THROWS(no_entry)
+    {
+        c.get("/observed-missing").get();
+    };
+    c.close();
+
+    std::unique_lock<std::mutex> ax(observer->protect);
+    CHECK_EQ(2U, observer->submitted);
+    CHECK_EQ(2U, observer->completed.size());
+    CHECK_TRUE(observer->completed[0].type == request_type::create);
+    CHECK_EQ("/observed", observer->completed[0].path);
+    CHECK_TRUE(observer->completed[0].rc == error_code::ok);
+    CHECK_EQ(1U, observer->completed[0].context);
+    CHECK_TRUE(observer->completed[1].type == request_type::get);
+    CHECK_EQ("/observed-missing", observer->completed[1].path);
+    CHECK_TRUE(observer->completed[1].rc == error_code::no_entry);
+    CHECK_EQ(2U, observer->completed[1].context);
+}
+
+/// Accepts sessions over the loopback interface and answers their pings, but never confirms a close, so every
+/// \c zookeeper_close of one of its sessions waits for as long as the C client lets it.
+class unconfirmed_close_server final
+{
+public:
+    unconfirmed_close_server() :
+            _listener(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0))
+    {
+        ::sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(_listener, reinterpret_cast<ptr<::sockaddr>>(&addr), sizeof addr);
+        ::listen(_listener, 16);
+
+        socklen_t len = sizeof addr;
+        ::getsockname(_listener, reinterpret_cast<ptr<::sockaddr>>(&addr), &len);
+        _port     = ntohs(addr.sin_port);
+        _acceptor = std::thread([this] { accept_all(); });
+    }
+
+    ~unconfirmed_close_server() noexcept
+    {
+        ::shutdown(_listener, SHUT_RDWR);
+        _acceptor.join();
+        for (int fd : _connections)
+            ::shutdown(fd, SHUT_RDWR);
+        for (auto& worker : _workers)
+            worker.join();
+        for (int fd : _connections)
+            ::close(fd);
+        ::close(_listener);
+    }
+
+    std::string connection_string() const
+    {
+        return "zk://127.0.0.1:" + std::to_string(_port) + "/?randomize_hosts=false";
+    }
+
+private:
+    static bool read_message(int fd, std::vector<char>& out)
+    {
+        auto read_exactly = [fd] (ptr<char> dest, std::size_t count)
+                            {
+                                while (count > 0U)
+                                {
+                                    auto got = ::recv(fd, dest, count, 0);
+                                    if (got <= 0)
+                                        return false;
+                                    dest  += got;
+                                    count -= std::size_t(got);
+                                }
+                                return true;
+                            };
+
+        out.resize(jute_length_size);
+        if (!read_exactly(out.data(), jute_length_size))
+            return false;
+        auto length = std::size_t(std::uint32_t(jute_reader(out.data(), out.data() + out.size()).read_int()));
+        out.resize(jute_length_size + length);
+        return read_exactly(out.data() + jute_length_size, length);
+    }
+
+    static void write_message(int fd, jute_writer out)
+    {
+        auto message = std::move(out).finish();
+        ::send(fd, message.data(), message.size(), MSG_NOSIGNAL);
+    }
+
+    void accept_all()
+    {
+        // Only the acceptor touches the lists until the destructor has joined it
+        while (true)
+        {
+            int fd = ::accept(_listener, nullptr, nullptr);
+            if (fd == -1)
+                return;
+
+            _connections.push_back(fd);
+            _workers.emplace_back([this, fd] { serve(fd); });
+        }
+    }
+
+    void serve(int fd)
+    {
+        std::vector<char> message;
+        if (!read_message(fd, message))
+            return;
+
+        jute_reader handshake(message.data() + jute_length_size, message.data() + message.size());
+        handshake.read_int();
+        handshake.read_long();
+        auto timeout = handshake.read_int();
+
+        jute_writer accepted;
+        accepted.write_int(0);
+        accepted.write_int(timeout);
+        accepted.write_long(0x42 + fd);
+        accepted.write_string(std::string(jute_password_size, 'p'));
+        accepted.write_bool(false);
+        write_message(fd, std::move(accepted));
+
+        while (read_message(fd, message))
+        {
+            jute_reader in(message.data() + jute_length_size, message.data() + message.size());
+            if (in.read_int() != jute_xid::ping)
+                continue; // the close among them
+
+            jute_writer pong;
+            pong.write_int(jute_xid::ping);
+            pong.write_long(0);
+            pong.write_int(0);
+            write_message(fd, std::move(pong));
+        }
+    }
+
+private:
+    int                      _listener;
+    std::uint16_t            _port = 0U;
+    std::thread              _acceptor;
+    std::vector<int>         _connections;
+    std::vector<std::thread> _workers;
+};
+
+GTEST_TEST(client_close_tests, close_all_closes_side_by_side)
+{
+    // Longer than zookeeper_close waits for a server which does not confirm the close (1.5 seconds), but well short of
+    // the time it takes the sessions to wait out their closes one after the other
+    constexpr auto one_close = std::chrono::milliseconds(2500);
+
+    unconfirmed_close_server srv;
+    std::vector<client>      clients;
+    for (int idx = 0; idx < 6; ++idx)
+        clients.push_back(client::connect(srv.connection_string()).get());
+
+    auto started = std::chrono::steady_clock::now();
+    close_all(clients).wait();
+    CHECK_LT(std::chrono::steady_clock::now() - started, one_close);
+}
+
 class stopping_client_tests :
         public server::server_fixture
 { };
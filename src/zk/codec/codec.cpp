@@ -0,0 +1,415 @@
+#include "codec.hpp"
+
+#include <zk/error.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <lz4.h>
+#include <zstd.h>
+
+namespace zk::codec
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// algorithm                                                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const algorithm& self)
+{
+    switch (self)
+    {
+    case algorithm::none: return os << "none";
+    case algorithm::lz4:  return os << "lz4";
+    case algorithm::zstd: return os << "zstd";
+    default:              return os << "algorithm(" << static_cast<int>(self) << ')';
+    }
+}
+
+std::string to_string(const algorithm& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// dictionary                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+dictionary::dictionary(std::uint32_t id, buffer content) :
+        _id(id),
+        _content(std::move(content))
+{
+    if (_id == 0U)
+        throw std::invalid_argument("Dictionary id 0 is reserved for data compressed without a dictionary");
+    if (_content.size() == 0U)
+        throw std::invalid_argument("Dictionary " + std::to_string(_id) + " is empty");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header                                                                                                             //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static constexpr unsigned char header_magic[] = { 0x89, 'z', 'c' };
+
+static void write_u32(char* out, std::uint32_t value)
+{
+    for (std::size_t idx = 0U; idx < 4U; ++idx)
+        out[idx] = static_cast<char>((value >> (8U * (3U - idx))) & 0xffU);
+}
+
+static std::uint32_t read_u32(const char* in)
+{
+    std::uint32_t value = 0U;
+    for (std::size_t idx = 0U; idx < 4U; ++idx)
+        value = (value << 8U) | static_cast<unsigned char>(in[idx]);
+    return value;
+}
+
+static bool starts_with_magic(const buffer& data)
+{
+    return data.size() >= sizeof header_magic
+        && std::memcmp(data.data(), header_magic, sizeof header_magic) == 0;
+}
+
+static std::uint32_t checked_size(std::size_t size)
+{
+    if (size > std::numeric_limits<std::uint32_t>::max())
+        throw std::length_error("Payloads of " + std::to_string(size) + " bytes are too large to encode");
+    return static_cast<std::uint32_t>(size);
+}
+
+static void write_header(char* out, algorithm alg, std::uint32_t dictionary_id, std::size_t original_size)
+{
+    std::memcpy(out, header_magic, sizeof header_magic);
+    out[3] = static_cast<char>(alg);
+    write_u32(out + 4, dictionary_id);
+    write_u32(out + 8, checked_size(original_size));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Thread Contexts                                                                                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The state each thread keeps to compress and decompress with: the contexts of the two libraries, which are costly to
+/// create and not safe to share, and a scratch space which payloads are compressed into and decompressed into before
+/// being copied into the returned \ref buffer.
+class thread_contexts final
+{
+public:
+    /// Scratch space past this size is freed after use, so one huge payload does not pin memory to the thread.
+    static constexpr std::size_t max_retained_scratch = buffer_pool::default_max_retained_size;
+
+public:
+    thread_contexts() :
+            _compress(ZSTD_createCCtx()),
+            _decompress(ZSTD_createDCtx()),
+            _lz4(LZ4_createStream())
+    {
+        if (!_compress || !_decompress || !_lz4)
+        {
+            release();
+            throw std::bad_alloc();
+        }
+    }
+
+    thread_contexts(const thread_contexts&) = delete;
+    thread_contexts& operator=(const thread_contexts&) = delete;
+
+    ~thread_contexts() noexcept
+    {
+        release();
+    }
+
+    static thread_contexts& current()
+    {
+        thread_local thread_contexts instance;
+        return instance;
+    }
+
+    ZSTD_CCtx*    compress()   const { return _compress; }
+    ZSTD_DCtx*    decompress() const { return _decompress; }
+    LZ4_stream_t* lz4()        const { return _lz4; }
+
+    std::vector<char>& scratch() { return _scratch; }
+
+    /// Copy the scratch space into a \ref buffer (from \a pool if there is one).
+    buffer take_scratch(buffer_pool* pool)
+    {
+        auto first = _scratch.data();
+        auto last  = first + _scratch.size();
+        auto out   = pool ? pool->acquire(first, last) : buffer(first, last);
+        if (_scratch.capacity() > max_retained_scratch)
+            std::vector<char>().swap(_scratch);
+        return out;
+    }
+
+private:
+    void release() noexcept
+    {
+        ZSTD_freeCCtx(_compress);
+        ZSTD_freeDCtx(_decompress);
+        if (_lz4)
+            LZ4_freeStream(_lz4);
+    }
+
+private:
+    ZSTD_CCtx*        _compress;
+    ZSTD_DCtx*        _decompress;
+    LZ4_stream_t*     _lz4;
+    std::vector<char> _scratch;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// payload_codec                                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// A \ref dictionary with what zstd builds from it ahead of time. LZ4 uses the content as it is.
+struct payload_codec::digested_dictionary final
+{
+    std::uint32_t id;
+    buffer        content;
+    ZSTD_CDict*   compress   = nullptr; //!< Only built for the dictionary written with, when compressing with zstd
+    ZSTD_DDict*   decompress = nullptr;
+
+    explicit digested_dictionary(const dictionary& source) :
+            id(source.id()),
+            content(source.content())
+    {
+        decompress = ZSTD_createDDict(content.data(), content.size());
+        if (!decompress)
+            throw std::invalid_argument("Could not load dictionary " + std::to_string(id));
+    }
+
+    digested_dictionary(const digested_dictionary&) = delete;
+    digested_dictionary& operator=(const digested_dictionary&) = delete;
+
+    ~digested_dictionary() noexcept
+    {
+        ZSTD_freeCDict(compress);
+        ZSTD_freeDDict(decompress);
+    }
+};
+
+payload_codec::payload_codec(codec_options options) :
+        _options(std::move(options))
+{
+    for (const auto& source : _options.dictionaries())
+    {
+        auto digested = std::make_shared<digested_dictionary>(source);
+        if (!_dictionaries.emplace(source.id(), digested).second)
+            throw std::invalid_argument("Dictionary " + std::to_string(source.id()) + " is listed more than once");
+    }
+
+    if (_options.write_dictionary() != 0U)
+    {
+        auto iter = _dictionaries.find(_options.write_dictionary());
+        if (iter == _dictionaries.end())
+            throw std::invalid_argument("The dictionary to write with (" + std::to_string(_options.write_dictionary())
+                                        + ") is not one of the known dictionaries"
+                                       );
+        _write_dictionary = iter->second;
+
+        if (_options.compression() == algorithm::zstd)
+        {
+            _write_dictionary->compress = ZSTD_createCDict(_write_dictionary->content.data(),
+                                                           _write_dictionary->content.size(),
+                                                           _options.zstd_level()
+                                                          );
+            if (!_write_dictionary->compress)
+                throw std::invalid_argument("Could not load dictionary " + std::to_string(_write_dictionary->id));
+        }
+    }
+}
+
+payload_codec::~payload_codec() noexcept = default;
+
+bool payload_codec::is_encoded(const buffer& stored)
+{
+    return stored.size() >= header_size
+        && starts_with_magic(stored)
+        && static_cast<unsigned char>(stored.data()[3]) <= static_cast<unsigned char>(algorithm::zstd);
+}
+
+/// Compress \a data into \a out behind a header.
+///
+/// \returns \c false if compressing did not make \a data any smaller.
+static bool compress_into(const buffer&        data,
+                          const codec_options& options,
+                          const buffer*        dictionary_content,
+                          std::uint32_t        dictionary_id,
+                          ZSTD_CDict*          zstd_dictionary,
+                          std::vector<char>&   out
+                         )
+{
+    auto& contexts = thread_contexts::current();
+    auto  size     = data.size();
+
+    std::size_t compressed = 0U;
+    if (options.compression() == algorithm::lz4)
+    {
+        if (size > std::size_t(LZ4_MAX_INPUT_SIZE))
+            return false;
+        auto bound = LZ4_compressBound(static_cast<int>(size));
+        out.resize(header_size + std::size_t(bound));
+
+        int written = 0;
+        if (dictionary_content)
+        {
+            // LZ4 only looks at the last 64 KiB of a dictionary, so loading it for every payload is cheap
+            LZ4_loadDict(contexts.lz4(), dictionary_content->data(), static_cast<int>(dictionary_content->size()));
+            written = LZ4_compress_fast_continue(contexts.lz4(), data.data(), out.data() + header_size,
+                                                 static_cast<int>(size), bound, options.lz4_acceleration()
+                                                );
+        }
+        else
+        {
+            written = LZ4_compress_fast(data.data(), out.data() + header_size, static_cast<int>(size), bound,
+                                        options.lz4_acceleration()
+                                       );
+        }
+        if (written <= 0)
+            return false;
+        compressed = std::size_t(written);
+    }
+    else
+    {
+        auto bound = ZSTD_compressBound(size);
+        out.resize(header_size + bound);
+        auto written = zstd_dictionary
+                     ? ZSTD_compress_usingCDict(contexts.compress(), out.data() + header_size, bound,
+                                                data.data(), size, zstd_dictionary
+                                               )
+                     : ZSTD_compressCCtx(contexts.compress(), out.data() + header_size, bound, data.data(), size,
+                                         options.zstd_level()
+                                        );
+        if (ZSTD_isError(written))
+            return false;
+        compressed = written;
+    }
+
+    if (header_size + compressed >= size)
+        return false;
+    out.resize(header_size + compressed);
+    write_header(out.data(), options.compression(), dictionary_id, size);
+    return true;
+}
+
+buffer payload_codec::encode(const buffer& data) const
+{
+    auto& contexts = thread_contexts::current();
+    auto& out      = contexts.scratch();
+
+    if (_options.compression() != algorithm::none && data.size() >= _options.min_size())
+    {
+        bool compressed = compress_into(data,
+                                        _options,
+                                        _write_dictionary ? &_write_dictionary->content : nullptr,
+                                        _write_dictionary ? _write_dictionary->id : 0U,
+                                        _write_dictionary ? _write_dictionary->compress : nullptr,
+                                        out
+                                       );
+        if (compressed)
+            return contexts.take_scratch(nullptr);
+    }
+
+    if (!starts_with_magic(data))
+        return data;
+
+    // Stored as it is, this would be taken for encoded data (or fail to decode) when it is read back
+    out.resize(header_size + data.size());
+    write_header(out.data(), algorithm::none, 0U, data.size());
+    std::memcpy(out.data() + header_size, data.data(), data.size());
+    return contexts.take_scratch(nullptr);
+}
+
+bool payload_codec::decode_into(const buffer& stored, std::vector<char>& out) const
+{
+    if (!is_encoded(stored))
+        return false;
+
+    const char* in            = stored.data();
+    auto        alg           = static_cast<algorithm>(static_cast<unsigned char>(in[3]));
+    auto        dictionary_id = read_u32(in + 4);
+    std::size_t size          = read_u32(in + 8);
+    const char* body          = in + header_size;
+    std::size_t body_size     = stored.size() - header_size;
+    if (size > _options.max_decoded_size())
+        throw marshalling_error();
+
+    const digested_dictionary* dict = nullptr;
+    if (dictionary_id != 0U)
+    {
+        auto iter = _dictionaries.find(dictionary_id);
+        if (iter == _dictionaries.end())
+            throw marshalling_error();
+        dict = iter->second.get();
+    }
+
+    out.resize(size);
+    switch (alg)
+    {
+    case algorithm::none:
+        if (dict || body_size != size)
+            throw marshalling_error();
+        std::copy(body, body + body_size, out.data());
+        break;
+    case algorithm::lz4:
+    {
+        if (body_size > std::size_t(std::numeric_limits<int>::max())
+            || size > std::size_t(std::numeric_limits<int>::max())
+           )
+            throw marshalling_error();
+        int got = dict
+                ? LZ4_decompress_safe_usingDict(body, out.data(), static_cast<int>(body_size), static_cast<int>(size),
+                                                dict->content.data(), static_cast<int>(dict->content.size())
+                                               )
+                : LZ4_decompress_safe(body, out.data(), static_cast<int>(body_size), static_cast<int>(size));
+        if (got < 0 || std::size_t(got) != size)
+            throw marshalling_error();
+        break;
+    }
+    default:
+    {
+        auto* context = thread_contexts::current().decompress();
+        auto  got     = dict
+                      ? ZSTD_decompress_usingDDict(context, out.data(), size, body, body_size, dict->decompress)
+                      : ZSTD_decompressDCtx(context, out.data(), size, body, body_size);
+        if (ZSTD_isError(got) || got != size)
+            throw marshalling_error();
+        break;
+    }
+    }
+    return true;
+}
+
+buffer payload_codec::decode(const buffer& stored) const
+{
+    auto& contexts = thread_contexts::current();
+    if (!decode_into(stored, contexts.scratch()))
+        return stored;
+    return contexts.take_scratch(nullptr);
+}
+
+get_result payload_codec::decode(get_result result) const
+{
+    auto& contexts = thread_contexts::current();
+    if (!decode_into(std::as_const(result).data(), contexts.scratch()))
+        return result;
+
+    const auto& pool = _options.read_buffer_pool();
+    auto        data = contexts.take_scratch(pool.get());
+    if (pool)
+        return get_result(std::move(data), result.stat(), pool);
+    else
+        return get_result(std::move(data), result.stat());
+}
+
+}
@@ -0,0 +1,178 @@
+/// \file
+/// Defines \ref zk::codec::payload_codec, which compresses the data of entries with LZ4 or zstd.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/buffer.hpp>
+#include <zk/buffer_pool.hpp>
+#include <zk/results.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace zk::codec
+{
+
+/// \defgroup Codec
+/// Transparent compression of the data stored in entries.
+/// \{
+
+/// The compression algorithms a \ref payload_codec can store data with.
+enum class algorithm : std::uint8_t
+{
+    none = 0, //!< The data is stored as it is, behind a header.
+    lz4  = 1, //!< LZ4: cheap to compress and very cheap to decompress.
+    zstd = 2, //!< Zstandard: smaller output for a little more CPU.
+};
+
+std::ostream& operator<<(std::ostream&, const algorithm&);
+
+std::string to_string(const algorithm&);
+
+/// Encoded data starts with this 12 byte header: the 3 bytes \c 0x89 \c 'z' \c 'c', the \ref algorithm, then the
+/// \ref dictionary::id the data was compressed with (\c 0 for none) and the size of the original data, both as 32-bit
+/// big-endian integers.
+constexpr std::size_t header_size = 12U;
+
+/// A trained dictionary, which lets small payloads with a lot in common (like the JSON documents of a service registry)
+/// compress far better than they do alone. Build one with \c zstd \c --train over samples of real payloads; the same
+/// content works for LZ4, which uses it as a prefix.
+///
+/// The \ref id is stored in the header of everything compressed with the dictionary, so a reader must know every
+/// dictionary ever written with. Keep old dictionaries in \ref codec_options::dictionaries after moving
+/// \ref codec_options::write_dictionary on to a new one.
+class dictionary final
+{
+public:
+    /// \throws std::invalid_argument if \a id is \c 0 (which stands for "no dictionary") or \a content is empty.
+    explicit dictionary(std::uint32_t id, buffer content);
+
+    std::uint32_t id() const { return _id; }
+
+    const buffer& content() const { return _content; }
+
+private:
+    std::uint32_t _id;
+    buffer        _content;
+};
+
+/// Settings for a \ref payload_codec.
+class codec_options final
+{
+public:
+    codec_options() = default;
+
+    /// The algorithm new data is compressed with. With \ref algorithm::none, nothing is compressed, but data written
+    /// with any algorithm can still be read.
+    algorithm  compression() const { return _compression; }
+    algorithm& compression()       { return _compression; }
+
+    /// The zstd compression level, from \c 1 (fastest) to \c 19 (smallest). Levels above \c 9 rarely pay for themselves
+    /// on payloads the size of an entry.
+    int  zstd_level() const { return _zstd_level; }
+    int& zstd_level()       { return _zstd_level; }
+
+    /// The LZ4 acceleration factor: \c 1 gives the best ratio and each step up trades some of it for speed.
+    int  lz4_acceleration() const { return _lz4_acceleration; }
+    int& lz4_acceleration()       { return _lz4_acceleration; }
+
+    /// Payloads smaller than this are stored uncompressed, as the header and the framing of the algorithm would eat
+    /// most of what compressing them saves. Payloads which do not shrink are stored uncompressed as well.
+    std::size_t  min_size() const { return _min_size; }
+    std::size_t& min_size()       { return _min_size; }
+
+    /// The largest original size a header may claim. Decoding fails with \ref marshalling_error past it, so a corrupt
+    /// header cannot make the reader allocate gigabytes.
+    std::size_t  max_decoded_size() const { return _max_decoded_size; }
+    std::size_t& max_decoded_size()       { return _max_decoded_size; }
+
+    /// The dictionaries data may have been compressed with.
+    const std::vector<dictionary>& dictionaries() const { return _dictionaries; }
+    std::vector<dictionary>&       dictionaries()       { return _dictionaries; }
+
+    /// The \ref dictionary::id of the entry of \ref dictionaries to compress with, or \c 0 to compress without one.
+    std::uint32_t  write_dictionary() const { return _write_dictionary; }
+    std::uint32_t& write_dictionary()       { return _write_dictionary; }
+
+    /// If set, decompressed data is written into buffers drawn from this pool (and given back to it when the
+    /// \ref get_result is destroyed), so reading compressed entries does not allocate once the pool is warm.
+    const std::shared_ptr<buffer_pool>& read_buffer_pool() const { return _read_buffer_pool; }
+    std::shared_ptr<buffer_pool>&       read_buffer_pool()       { return _read_buffer_pool; }
+
+private:
+    algorithm                    _compression      = algorithm::zstd;
+    int                          _zstd_level       = 3;
+    int                          _lz4_acceleration = 1;
+    std::size_t                  _min_size         = 256U;
+    std::size_t                  _max_decoded_size = 16U * 1024U * 1024U;
+    std::vector<dictionary>      _dictionaries;
+    std::uint32_t                _write_dictionary = 0U;
+    std::shared_ptr<buffer_pool> _read_buffer_pool;
+};
+
+/// Compresses data before it is written to an entry and decompresses it once it has been read.
+///
+/// Encoded data is self-describing: it starts with a \ref header_size byte header naming the algorithm and dictionary,
+/// so readers need no out-of-band knowledge of how an entry was written. Data without the header (written before the
+/// codec was in use, or by another client) is returned unchanged by \ref decode. The rare payload which happens to
+/// start with the header's magic is stored behind an \ref algorithm::none header, so it is never mistaken for encoded
+/// data.
+///
+/// A codec is safe to share between threads. The compression and decompression contexts are kept per thread and
+/// dictionaries are digested once, when the codec is created; the only allocation in the steady state is the returned
+/// \ref buffer (and, with \ref codec_options::read_buffer_pool, not even that on the read side).
+class payload_codec final
+{
+public:
+    /// \throws std::invalid_argument if \ref codec_options::write_dictionary is not one of the
+    ///  \ref codec_options::dictionaries, or two of them share an id.
+    explicit payload_codec(codec_options options = codec_options());
+
+    payload_codec(const payload_codec&) = delete;
+    payload_codec& operator=(const payload_codec&) = delete;
+
+    ~payload_codec() noexcept;
+
+    const codec_options& options() const { return _options; }
+
+    /// Get the form of \a data to store in an entry.
+    buffer encode(const buffer& data) const;
+
+    /// Get the original form of \a stored, the data read from an entry.
+    ///
+    /// \throws marshalling_error if \a stored has a header but its contents are corrupt, it was compressed with a
+    ///  dictionary this codec does not know, or it claims to be larger than \ref codec_options::max_decoded_size.
+    buffer decode(const buffer& stored) const;
+
+    /// Get \a result with its data decoded. Its \ref get_result::stat is kept as it is: the \c data_length there is
+    /// the size of the stored form.
+    ///
+    /// \throws marshalling_error See \ref decode.
+    get_result decode(get_result result) const;
+
+    /// Does \a stored start with the header written by \ref encode?
+    static bool is_encoded(const buffer& stored);
+
+private:
+    struct digested_dictionary;
+
+private:
+    /// Decode \a stored into the scratch space of the calling thread.
+    ///
+    /// \returns \c false if \a stored is legacy data, with nothing written.
+    bool decode_into(const buffer& stored, std::vector<char>& out) const;
+
+private:
+    codec_options                                                             _options;
+    std::unordered_map<std::uint32_t, std::shared_ptr<digested_dictionary>> _dictionaries;
+    std::shared_ptr<digested_dictionary>                                      _write_dictionary;
+};
+
+/// \}
+
+}
@@ -0,0 +1,198 @@
+#include <zk/server/server_tests.hpp>
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/tests/test.hpp>
+
+#include <stdexcept>
+#include <string>
+
+#include "codec.hpp"
+#include "compressed_client.hpp"
+
+namespace zk::codec
+{
+
+static buffer buffer_from(const std::string& text)
+{
+    return buffer(text.data(), text.data() + text.size());
+}
+
+/// A JSON-ish document which compresses well, like the payloads of a service registry.
+static buffer document(std::size_t copies, const std::string& tag = "alpha")
+{
+    std::string out;
+    for (std::size_t idx = 0U; idx < copies; ++idx)
+        out += "{\"service\":\"" + tag + "\",\"port\":" + std::to_string(8000U + idx) + ",\"healthy\":true}";
+    return buffer_from(out);
+}
+
+static codec_options options_for(algorithm alg)
+{
+    codec_options opts;
+    opts.compression() = alg;
+    return opts;
+}
+
+GTEST_TEST(codec_tests, algorithm_to_string)
+{
+    CHECK_EQ("none", to_string(algorithm::none));
+    CHECK_EQ("lz4",  to_string(algorithm::lz4));
+    CHECK_EQ("zstd", to_string(algorithm::zstd));
+}
+
+GTEST_TEST(codec_tests, round_trip)
+{
+    for (auto alg : { algorithm::lz4, algorithm::zstd })
+    {
+        payload_codec codec(options_for(alg));
+        auto          original = document(40U);
+        auto          stored   = codec.encode(original);
+        CHECK_TRUE(payload_codec::is_encoded(stored)) << alg;
+        CHECK_LT(stored.size(), original.size() / 2U) << alg;
+        CHECK_EQ(static_cast<char>(alg), stored.data()[3]);
+        CHECK_TRUE(original == codec.decode(stored)) << alg;
+    }
+}
+
+GTEST_TEST(codec_tests, small_and_legacy_payloads)
+{
+    payload_codec codec;
+
+    // Under the minimum size, the payload is stored as it is
+    auto small = buffer_from("short");
+    CHECK_TRUE(small == codec.encode(small));
+    CHECK_TRUE(small == codec.decode(small));
+    CHECK_TRUE(buffer() == codec.decode(codec.encode(buffer())));
+
+    // Data which was never encoded reads back unchanged, even if it is large
+    auto legacy = document(40U);
+    CHECK_FALSE(payload_codec::is_encoded(legacy));
+    CHECK_TRUE(legacy == codec.decode(legacy));
+
+    // ...but data which looks like a header is wrapped, so it is not mistaken for one
+    auto lookalike = buffer_from(std::string("\x89zc\x01", 4U) + "not really compressed");
+    auto stored    = codec.encode(lookalike);
+    CHECK_EQ(header_size + lookalike.size(), stored.size());
+    CHECK_EQ(static_cast<char>(algorithm::none), stored.data()[3]);
+    CHECK_TRUE(lookalike == codec.decode(stored));
+}
+
+GTEST_TEST(codec_tests, incompressible_stored_raw)
+{
+    std::string noise;
+    std::uint32_t state = 12345U;
+    for (std::size_t idx = 0U; idx < 1024U; ++idx)
+    {
+        state = state * 1103515245U + 12345U;
+        noise.push_back(static_cast<char>(state >> 24U));
+    }
+    if (noise[0] == '\x89')
+        noise[0] = 'x';
+
+    payload_codec codec(options_for(algorithm::lz4));
+    auto          original = buffer_from(noise);
+    CHECK_TRUE(original == codec.encode(original));
+}
+
+GTEST_TEST(codec_tests, dictionaries)
+{
+    auto sample = document(8U, "registry");
+
+    codec_options opts = options_for(algorithm::zstd);
+    opts.min_size() = 16U;
+    opts.dictionaries().emplace_back(7U, sample);
+    opts.write_dictionary() = 7U;
+
+    codec_options lz4_opts = opts;
+    lz4_opts.compression() = algorithm::lz4;
+
+    payload_codec plain(options_for(algorithm::zstd));
+    for (const auto& with : { opts, lz4_opts })
+    {
+        payload_codec codec(with);
+        auto          original = document(2U, "registry");
+        auto          stored   = codec.encode(original);
+        CHECK_TRUE(payload_codec::is_encoded(stored));
+        CHECK_TRUE(original == codec.decode(stored));
+
+        // A reader which does not know the dictionary cannot decode it
+        CHECK_THROWS(marshalling_error) { plain.decode(stored); };
+    }
+
+    codec_options unknown;
+    unknown.write_dictionary() = 3U;
+    CHECK_THROWS(std::invalid_argument) { payload_codec codec(unknown); };
+    CHECK_THROWS(std::invalid_argument) { dictionary(0U, sample); };
+}
+
+GTEST_TEST(codec_tests, corrupt_payloads)
+{
+    payload_codec codec;
+    auto          stored = codec.encode(document(40U));
+
+    auto truncated = buffer(stored.data(), stored.data() + stored.size() / 2U);
+    CHECK_THROWS(marshalling_error) { codec.decode(truncated); };
+
+    // A header which claims a huge payload is refused before anything is allocated
+    auto inflated = stored;
+    inflated[8]   = '\x7f';
+    CHECK_THROWS(marshalling_error) { codec.decode(inflated); };
+
+    auto garbage = stored;
+    for (std::size_t idx = header_size; idx < garbage.size(); ++idx)
+        garbage[idx] = static_cast<char>(idx);
+    CHECK_THROWS(marshalling_error) { codec.decode(garbage); };
+}
+
+GTEST_TEST(codec_tests, decode_into_pool)
+{
+    auto          pool = std::make_shared<buffer_pool>();
+    codec_options opts;
+    opts.read_buffer_pool() = pool;
+    payload_codec codec(opts);
+
+    auto original = document(40U);
+    auto stored   = codec.encode(original);
+    {
+        auto result = codec.decode(get_result(stored, stat{}));
+        CHECK_TRUE(original == result.data());
+    }
+    CHECK_EQ(1U, pool->idle_count());
+
+    // Legacy data is passed through without touching the pool
+    auto legacy = codec.decode(get_result(original, stat{}));
+    CHECK_TRUE(original == legacy.data());
+    CHECK_EQ(1U, pool->idle_count());
+}
+
+class compressed_client_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(compressed_client_tests, reads_what_it_writes)
+{
+    client            c = get_connected_client();
+    compressed_client cc(c, std::make_shared<payload_codec>(options_for(algorithm::lz4)));
+
+    auto large = document(40U);
+    cc.create("/codec", large).get();
+    CHECK_LT(c.get("/codec").get().data().size(), large.size());
+    CHECK_TRUE(large == cc.get("/codec").get().data());
+
+    // Entries written without the codec still read
+    c.create("/codec/legacy", buffer_from("plain")).get();
+    CHECK_TRUE(buffer_from("plain") == cc.get("/codec/legacy").get().data());
+
+    auto watch   = cc.watch("/codec").get();
+    CHECK_TRUE(large == watch.initial().data());
+    auto changed = document(50U, "beta");
+    cc.set("/codec", changed).get();
+    watch.next().get();
+    CHECK_TRUE(changed == cc.get("/codec").get().data());
+
+    auto again = document(60U, "gamma");
+    c.commit({ cc.set_op("/codec", again), cc.create_op("/codec/child", again) }).get();
+    CHECK_TRUE(again == cc.get("/codec/child").get().data());
+}
+
+}
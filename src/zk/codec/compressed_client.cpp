@@ -0,0 +1,125 @@
+#include "compressed_client.hpp"
+
+#include <zk/error.hpp>
+
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+namespace zk::codec
+{
+
+compressed_client::compressed_client(client inner, std::shared_ptr<const payload_codec> codec) :
+        _inner(std::move(inner)),
+        _codec(std::move(codec))
+{
+    if (!_codec)
+        throw std::invalid_argument("A compressed_client needs a codec");
+}
+
+future<create_result> compressed_client::create(path_view     path,
+                                                const buffer& data,
+                                                const acl&    rules,
+                                                create_mode   mode
+                                               )
+{
+    return _inner.create(path, _codec->encode(data), rules, mode);
+}
+
+future<create_result> compressed_client::create(path_view path, const buffer& data, create_mode mode)
+{
+    return _inner.create(path, _codec->encode(data), mode);
+}
+
+void compressed_client::create(path_view               path,
+                               const buffer&           data,
+                               const acl&              rules,
+                               create_mode             mode,
+                               callback<create_result> on_complete
+                              )
+{
+    _inner.create(path, _codec->encode(data), rules, mode, std::move(on_complete));
+}
+
+future<set_result> compressed_client::set(path_view path, const buffer& data, version check)
+{
+    return _inner.set(path, _codec->encode(data), check);
+}
+
+void compressed_client::set(path_view path, const buffer& data, version check, callback<set_result> on_complete)
+{
+    _inner.set(path, _codec->encode(data), check, std::move(on_complete));
+}
+
+/// Decode the data of a successful \a result with \a codec, turning a failure to decode into a failed outcome.
+template <typename TResult, typename FRebuild>
+static outcome<TResult> decoded(const payload_codec& codec, outcome<TResult> result, FRebuild&& rebuild)
+{
+    if (!result)
+        return result;
+
+    try
+    {
+        return std::forward<FRebuild>(rebuild)(codec, std::move(result).value());
+    }
+    catch (const marshalling_error&)
+    {
+        return outcome<TResult>(error_code::marshalling_error, std::current_exception());
+    }
+}
+
+future<get_result> compressed_client::get(path_view path) const
+{
+    return future_from_callback<get_result>([&] (auto cb) { get(path, std::move(cb)); });
+}
+
+void compressed_client::get(path_view path, callback<get_result> on_complete) const
+{
+    _inner.get(path,
+               [codec = _codec, on_complete = std::move(on_complete)] (outcome<get_result> result)
+               {
+                   on_complete(decoded(*codec,
+                                       std::move(result),
+                                       [] (const payload_codec& c, get_result res) { return c.decode(std::move(res)); }
+                                      )
+                              );
+               }
+              );
+}
+
+future<watch_result> compressed_client::watch(path_view path) const
+{
+    return future_from_callback<watch_result>([&] (auto cb) { watch(path, std::move(cb)); });
+}
+
+void compressed_client::watch(path_view path, callback<watch_result> on_complete) const
+{
+    _inner.watch(path,
+                 [codec = _codec, on_complete = std::move(on_complete)] (outcome<watch_result> result)
+                 {
+                     auto rebuild = [] (const payload_codec& c, watch_result res)
+                                    {
+                                        auto initial = c.decode(std::move(res).initial());
+                                        return watch_result(std::move(initial), std::move(res).next());
+                                    };
+                     on_complete(decoded(*codec, std::move(result), rebuild));
+                 }
+                );
+}
+
+op compressed_client::create_op(std::string path, const buffer& data, acl rules, create_mode mode) const
+{
+    return op::create(std::move(path), _codec->encode(data), std::move(rules), mode);
+}
+
+op compressed_client::create_op(std::string path, const buffer& data, create_mode mode) const
+{
+    return op::create(std::move(path), _codec->encode(data), mode);
+}
+
+op compressed_client::set_op(std::string path, const buffer& data, version check) const
+{
+    return op::set(std::move(path), _codec->encode(data), check);
+}
+
+}
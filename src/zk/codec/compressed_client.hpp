@@ -0,0 +1,112 @@
+/// \file
+/// Defines \ref zk::codec::compressed_client, a \ref zk::client whose entry data goes through a
+/// \ref zk::codec::payload_codec.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/acl.hpp>
+#include <zk/buffer.hpp>
+#include <zk/callback.hpp>
+#include <zk/client.hpp>
+#include <zk/codec/codec.hpp>
+#include <zk/future.hpp>
+#include <zk/multi.hpp>
+#include <zk/results.hpp>
+#include <zk/string_view.hpp>
+#include <zk/types.hpp>
+
+#include <memory>
+#include <string>
+
+namespace zk::codec
+{
+
+/// \addtogroup Codec
+/// \{
+
+/// Wraps a \ref client to compress the data it writes and decompress the data it reads with a \ref payload_codec.
+/// Only the operations which carry entry data are wrapped; everything else (erase, the children of an entry, ACLs,
+/// transactions without data) goes straight to \ref inner. Writes inside a transaction are encoded by building their
+/// operations with \ref create_op and \ref set_op.
+///
+/// \code
+/// zk::codec::codec_options opts;
+/// opts.compression() = zk::codec::algorithm::lz4;
+/// zk::codec::compressed_client cc(client, std::make_shared<zk::codec::payload_codec>(opts));
+/// cc.set("/config/large", document).get();
+/// auto doc = cc.get("/config/large").get().data();
+/// \endcode
+///
+/// Entries written by a plain \ref client (or before compression was turned on) read back unchanged, so a tree can be
+/// moved over to compressed payloads one writer at a time. The reverse does not hold: a reader which does not decode
+/// sees the header and the compressed bytes.
+class compressed_client final
+{
+public:
+    explicit compressed_client(client inner, std::shared_ptr<const payload_codec> codec);
+
+    /// \{
+    /// The wrapped client, for the operations which are not about entry data.
+    const client& inner() const { return _inner; }
+    client&       inner()       { return _inner; }
+    /// \}
+
+    const payload_codec& codec() const { return *_codec; }
+
+    /// \{
+    /// Create an entry holding the encoded form of \a data. See \ref client::create.
+    future<create_result> create(path_view     path,
+                                 const buffer& data,
+                                 const acl&    rules,
+                                 create_mode   mode = create_mode::normal
+                                );
+    future<create_result> create(path_view     path,
+                                 const buffer& data,
+                                 create_mode   mode = create_mode::normal
+                                );
+    void create(path_view               path,
+                const buffer&           data,
+                const acl&              rules,
+                create_mode             mode,
+                callback<create_result> on_complete
+               );
+    /// \}
+
+    /// \{
+    /// Set the data of an entry to the encoded form of \a data. See \ref client::set.
+    future<set_result> set(path_view path, const buffer& data, version check = version::any());
+    void set(path_view path, const buffer& data, version check, callback<set_result> on_complete);
+    /// \}
+
+    /// \{
+    /// Read and decode the data of an entry. See \ref client::get.
+    ///
+    /// \throws marshalling_error If the entry holds encoded data which cannot be decoded (see
+    ///  \ref payload_codec::decode), the result is delivered with \ref marshalling_error.
+    future<get_result> get(path_view path) const;
+    void get(path_view path, callback<get_result> on_complete) const;
+    /// \}
+
+    /// \{
+    /// Read and decode the data of an entry and watch it for changes. See \ref client::watch.
+    ///
+    /// \throws marshalling_error As with \ref get.
+    future<watch_result> watch(path_view path) const;
+    void watch(path_view path, callback<watch_result> on_complete) const;
+    /// \}
+
+    /// \{
+    /// Build an \ref op::create or \ref op::set operation whose data is encoded, to commit with \ref inner.
+    op create_op(std::string path, const buffer& data, acl rules, create_mode mode = create_mode::normal) const;
+    op create_op(std::string path, const buffer& data, create_mode mode = create_mode::normal) const;
+    op set_op(std::string path, const buffer& data, version check = version::any()) const;
+    /// \}
+
+private:
+    client                               _inner;
+    std::shared_ptr<const payload_codec> _codec;
+};
+
+/// \}
+
+}
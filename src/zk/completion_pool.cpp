@@ -0,0 +1,153 @@
+#include "completion_pool.hpp"
+
+#include <array>
+#include <iterator>
+#include <new>
+#include <utility>
+
+namespace zk
+{
+
+static constexpr std::size_t class_count = std::size(completion_pool::size_classes);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// completion_pool::thread_cache                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The blocks a thread holds on to, one list for each pool. This is trivially destructible, so it can still be looked
+/// at while the thread is being torn down (by the destructor of some other \c thread_local, say). Once \c retired is
+/// set, the thread caches nothing more.
+struct completion_pool::thread_cache final
+{
+    std::array<ptr<block>, class_count>  heads;
+    std::array<std::size_t, class_count> counts;
+    bool                                 retired;
+};
+
+completion_pool::thread_cache& completion_pool::local_cache() noexcept
+{
+    static thread_local thread_cache cache{};
+
+    // Hands what the thread still holds back to the pools when it exits, so it is not lost with the thread
+    struct retirer final
+    {
+        ~retirer() noexcept
+        {
+            cache.retired = true;
+            for (std::size_t idx = 0U; idx < class_count; ++idx)
+            {
+                auto first = std::exchange(cache.heads[idx], nullptr);
+                if (!first)
+                    continue;
+
+                auto last = first;
+                while (last->next)
+                    last = last->next;
+                for_size(size_classes[idx])->share(first, last);
+                cache.counts[idx] = 0U;
+            }
+        }
+    };
+    static thread_local retirer retire_on_exit;
+    (void) retire_on_exit;
+
+    return cache;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// completion_pool                                                                                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+completion_pool::completion_pool(std::size_t index, std::size_t block_size) :
+        _index(index),
+        _block_size(block_size),
+        _shared(nullptr),
+        _blocks_created(0U)
+{ }
+
+ptr<completion_pool> completion_pool::for_size(std::size_t size) noexcept
+{
+    // Never destroyed, as blocks can be given back by threads which are still running during static destruction
+    static const auto pools = []
+                              {
+                                  std::array<ptr<completion_pool>, class_count> out;
+                                  for (std::size_t idx = 0U; idx < class_count; ++idx)
+                                      out[idx] = new completion_pool(idx, size_classes[idx]);
+                                  return out;
+                              }();
+
+    for (std::size_t idx = 0U; idx < class_count; ++idx)
+    {
+        if (size <= size_classes[idx])
+            return pools[idx];
+    }
+    return nullptr;
+}
+
+ptr<void> completion_pool::allocate()
+{
+    auto& cache = local_cache();
+    if (cache.retired)
+    {
+        // Anything of the right size can go back into the pool, so a plain allocation is as good as a block
+        _blocks_created.fetch_add(1U, std::memory_order_relaxed);
+        return ::operator new(_block_size);
+    }
+
+    auto& head  = cache.heads[_index];
+    auto& count = cache.counts[_index];
+    if (!head)
+    {
+        // Taking the whole list at once is immune to the ABA problem a pop of a single block would have
+        head  = _shared.exchange(nullptr, std::memory_order_acquire);
+        count = 0U;
+        for (auto blk = head; blk; blk = blk->next)
+            ++count;
+    }
+
+    if (!head)
+    {
+        auto slab = static_cast<ptr<char>>(::operator new(_block_size * blocks_per_slab));
+        _blocks_created.fetch_add(blocks_per_slab, std::memory_order_relaxed);
+
+        // The first block is for the caller, the rest go onto the cache in order
+        for (std::size_t idx = blocks_per_slab - 1U; idx > 0U; --idx)
+        {
+            auto blk  = reinterpret_cast<ptr<block>>(slab + idx * _block_size);
+            blk->next = head;
+            head      = blk;
+        }
+        count = blocks_per_slab - 1U;
+        return slab;
+    }
+
+    auto blk = head;
+    head     = blk->next;
+    --count;
+    return blk;
+}
+
+void completion_pool::deallocate(ptr<void> p) noexcept
+{
+    auto  blk   = static_cast<ptr<block>>(p);
+    auto& cache = local_cache();
+    if (!cache.retired && cache.counts[_index] < max_cached_per_thread)
+    {
+        blk->next             = cache.heads[_index];
+        cache.heads[_index]   = blk;
+        cache.counts[_index] += 1U;
+    }
+    else
+    {
+        share(blk, blk);
+    }
+}
+
+void completion_pool::share(ptr<block> first, ptr<block> last) noexcept
+{
+    last->next = _shared.load(std::memory_order_relaxed);
+    while (!_shared.compare_exchange_weak(last->next, first, std::memory_order_release, std::memory_order_relaxed))
+    { }
+}
+
+}
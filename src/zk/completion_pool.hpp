@@ -0,0 +1,164 @@
+/// \file
+/// Defines \ref zk::completion_pool and \ref zk::completion_allocator, which recycle the small records every operation
+/// allocates to carry its result back.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// A thread-safe free list of fixed-size blocks for the records which track an operation between its submission and
+/// its completion (the completer, the shared state of its \c promise, a watcher). These are allocated on the thread
+/// making the request and freed on the completion thread, which is the pattern a general allocator handles worst.
+///
+/// Each thread keeps a small cache of blocks it can take without any synchronization. Blocks freed once that cache is
+/// full are pushed onto a list shared by every thread with a single compare-and-swap, and a thread whose cache runs
+/// dry takes that whole list in one exchange, so neither side ever waits on a lock. New blocks are carved from slabs
+/// which are never given back, so a pool settles at the size of the most records ever in flight at once.
+///
+/// The pools are shared by the whole process, one for each size class (see \ref for_size).
+class completion_pool final
+{
+public:
+    /// The block sizes of the pools, smallest first. Anything larger than the last is not pooled.
+    static constexpr std::size_t size_classes[] = { 64U, 128U, 256U, 512U };
+
+    /// The number of blocks a slab is carved into.
+    static constexpr std::size_t blocks_per_slab = 64U;
+
+    /// The most blocks a thread keeps for itself before it shares what it frees.
+    static constexpr std::size_t max_cached_per_thread = 128U;
+
+public:
+    completion_pool(const completion_pool&) = delete;
+    completion_pool& operator=(const completion_pool&) = delete;
+
+    /// The pool for records of \a size bytes, or \c nullptr if they are too large to be pooled.
+    static ptr<completion_pool> for_size(std::size_t size) noexcept;
+
+    std::size_t block_size() const noexcept { return _block_size; }
+
+    /// The number of blocks this pool has carved from slabs so far. Once the pool has warmed up, this stops going up.
+    std::size_t blocks_created() const noexcept { return _blocks_created.load(std::memory_order_relaxed); }
+
+    /// Get a block of \ref block_size bytes, aligned for any fundamental type.
+    ///
+    /// \throws std::bad_alloc if a new slab is needed and can not be allocated.
+    ptr<void> allocate();
+
+    /// Give back a block from \ref allocate. This can be called from any thread.
+    void deallocate(ptr<void> block) noexcept;
+
+private:
+    struct block
+    {
+        ptr<block> next;
+    };
+
+    struct thread_cache;
+
+    explicit completion_pool(std::size_t index, std::size_t block_size);
+
+    static thread_cache& local_cache() noexcept;
+
+    void share(ptr<block> first, ptr<block> last) noexcept;
+
+private:
+    std::size_t              _index;
+    std::size_t              _block_size;
+    std::atomic<ptr<block>>  _shared;
+    std::atomic<std::size_t> _blocks_created;
+};
+
+/// A standard allocator drawing from the \ref completion_pool of the size of what it allocates, for handing to
+/// \c std::allocate_shared or the \c std::allocator_arg constructor of \c std::promise. Allocations of more than one
+/// object, or of objects too large for any pool, go to \c operator \c new.
+template <typename T>
+class completion_allocator
+{
+public:
+    using value_type = T;
+
+public:
+    completion_allocator() noexcept = default;
+
+    template <typename U>
+    completion_allocator(const completion_allocator<U>&) noexcept
+    { }
+
+    ptr<T> allocate(std::size_t count)
+    {
+        if (auto pool = pool_for(count))
+            return static_cast<ptr<T>>(pool->allocate());
+        else
+            return static_cast<ptr<T>>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(ptr<T> p, std::size_t count) noexcept
+    {
+        if (auto pool = pool_for(count))
+            pool->deallocate(p);
+        else
+            ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const completion_allocator<U>&) const noexcept { return true; }
+
+    template <typename U>
+    bool operator!=(const completion_allocator<U>&) const noexcept { return false; }
+
+private:
+    static ptr<completion_pool> pool_for(std::size_t count) noexcept
+    {
+        return count == 1U && alignof(T) <= alignof(std::max_align_t) ? completion_pool::for_size(sizeof(T)) : nullptr;
+    }
+};
+
+/// Like \c std::make_shared, with the object and its control block in one block of a \ref completion_pool.
+template <typename T, typename... TArgs>
+std::shared_ptr<T> make_pooled_shared(TArgs&&... args)
+{
+    return std::allocate_shared<T>(completion_allocator<T>(), std::forward<TArgs>(args)...);
+}
+
+/// Derive from this to have \c new and \c delete of the derived type go through its \ref completion_pool. The derived
+/// type must be deleted through its own type (or a virtual destructor), so the size given back is the one it was
+/// allocated with.
+class pooled_completion
+{
+public:
+    static ptr<void> operator new(std::size_t size)
+    {
+        if (auto pool = completion_pool::for_size(size))
+            return pool->allocate();
+        else
+            return ::operator new(size);
+    }
+
+    static void operator delete(ptr<void> p, std::size_t size) noexcept
+    {
+        if (auto pool = completion_pool::for_size(size))
+            pool->deallocate(p);
+        else
+            ::operator delete(p);
+    }
+
+protected:
+    pooled_completion() noexcept = default;
+    ~pooled_completion() noexcept = default;
+};
+
+/// \}
+
+}
@@ -0,0 +1,102 @@
+#include <zk/tests/test.hpp>
+
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "completion_pool.hpp"
+#include "future.hpp"
+
+namespace zk
+{
+
+GTEST_TEST(completion_pool_tests, size_classes)
+{
+    CHECK_EQ(64U, completion_pool::for_size(1U)->block_size());
+    CHECK_EQ(64U, completion_pool::for_size(64U)->block_size());
+    CHECK_EQ(128U, completion_pool::for_size(65U)->block_size());
+    CHECK_EQ(512U, completion_pool::for_size(512U)->block_size());
+    CHECK_TRUE(completion_pool::for_size(513U) == nullptr);
+}
+
+GTEST_TEST(completion_pool_tests, reuses_blocks)
+{
+    auto& pool  = *completion_pool::for_size(200U);
+    auto  first = pool.allocate();
+    pool.deallocate(first);
+    CHECK_TRUE(first == pool.allocate());
+    pool.deallocate(first);
+
+    std::vector<ptr<void>> blocks;
+    for (std::size_t idx = 0U; idx < completion_pool::blocks_per_slab * 2U; ++idx)
+        blocks.push_back(pool.allocate());
+    CHECK_EQ(blocks.size(), std::set<ptr<void>>(blocks.begin(), blocks.end()).size());
+    for (auto block : blocks)
+        pool.deallocate(block);
+
+    auto created = pool.blocks_created();
+    for (auto& block : blocks)
+        block = pool.allocate();
+    for (auto block : blocks)
+        pool.deallocate(block);
+    CHECK_EQ(created, pool.blocks_created());
+}
+
+GTEST_TEST(completion_pool_tests, freed_on_another_thread)
+{
+    // More than a thread caches, so some are shared straight away and the rest when the thread exits
+    auto& pool  = *completion_pool::for_size(400U);
+    auto  count = completion_pool::max_cached_per_thread * 4U;
+
+    std::vector<ptr<void>> blocks;
+    for (std::size_t idx = 0U; idx < count; ++idx)
+        blocks.push_back(pool.allocate());
+    std::thread([&]
+                {
+                    for (auto block : blocks)
+                        pool.deallocate(block);
+                }
+               ).join();
+
+    auto created = pool.blocks_created();
+    for (auto& block : blocks)
+        block = pool.allocate();
+    CHECK_EQ(created, pool.blocks_created());
+    for (auto block : blocks)
+        pool.deallocate(block);
+}
+
+struct pooled_record final :
+        pooled_completion
+{
+    int  value = 0;
+    char padding[100];
+};
+
+GTEST_TEST(completion_pool_tests, pooled_types)
+{
+    auto& pool   = *completion_pool::for_size(sizeof(pooled_record));
+    auto  record = std::make_unique<pooled_record>();
+    auto  where  = static_cast<ptr<void>>(record.get());
+    record.reset();
+    CHECK_TRUE(where == pool.allocate());
+    pool.deallocate(where);
+
+    auto shared = make_pooled_shared<int>(42);
+    CHECK_EQ(42, *shared);
+
+#if ZKPP_FUTURE_USE_STD
+    promise<int> prom(std::allocator_arg, completion_allocator<int>());
+    auto fut = prom.get_future();
+    prom.set_value(7);
+    CHECK_EQ(7, fut.get());
+#endif
+
+    // Arrays and anything too large for a pool go to operator new
+    completion_allocator<char> alloc;
+    auto big = alloc.allocate(4096U);
+    alloc.deallocate(big, 4096U);
+}
+
+}
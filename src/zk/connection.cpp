@@ -1,13 +1,25 @@
 #include "connection.hpp"
+#include "acl.hpp"
+#include "buffer_pool.hpp"
+#include "cancellation.hpp"
 #include "connection_zk.hpp"
+#include "connection_zkn.hpp"
 #include "error.hpp"
+#include "multi.hpp"
+#include "results.hpp"
 #include "types.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <ostream>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <unordered_set>
 
 #include <zookeeper/zookeeper.h>
@@ -22,9 +34,48 @@ namespace zk
 connection::~connection() noexcept
 { }
 
+namespace
+{
+
+struct schema_registry final
+{
+    std::mutex                                        protect;
+    std::map<std::string, connection::schema_factory> factories;
+};
+
+schema_registry& registered_schemas()
+{
+    static schema_registry instance;
+    return instance;
+}
+
+}
+
 std::shared_ptr<connection> connection::connect(const connection_params& params)
 {
-    return std::make_shared<connection_zk>(params);
+    if (params.connection_schema() == "zkn")
+        return std::make_shared<connection_zkn>(params);
+
+    schema_factory make;
+    {
+        auto& registry = registered_schemas();
+        std::unique_lock<std::mutex> ax(registry.protect);
+        auto iter = registry.factories.find(params.connection_schema());
+        if (iter != registry.factories.end())
+            make = iter->second;
+    }
+
+    if (make)
+        return make(params);
+    else
+        return std::make_shared<connection_zk>(params);
+}
+
+void connection::register_schema(std::string schema, schema_factory make)
+{
+    auto& registry = registered_schemas();
+    std::unique_lock<std::mutex> ax(registry.protect);
+    registry.factories[std::move(schema)] = std::move(make);
 }
 
 std::shared_ptr<connection> connection::connect(string_view conn_string)
@@ -32,19 +83,647 @@ std::shared_ptr<connection> connection::connect(string_view conn_string)
     return connect(connection_params::parse(conn_string));
 }
 
+void connection::close_async(callback<void> on_closed)
+{
+    outcome<void> result;
+    try
+    {
+        close();
+    }
+    catch (const error& ex)
+    {
+        result = outcome<void>(ex.code(), std::current_exception());
+    }
+    on_closed(std::move(result));
+}
+
+future<void> connection::close_async()
+{
+    return future_from_callback<void>([&] (auto cb) { this->close_async(std::move(cb)); });
+}
+
+future<get_result> connection::get(path_view path)
+{
+    return future_from_callback<get_result>([&] (auto cb) { this->get(path, std::move(cb)); });
+}
+
+future<watch_result> connection::watch(path_view path)
+{
+    return future_from_callback<watch_result>([&] (auto cb) { this->watch(path, std::move(cb)); });
+}
+
+future<get_children_result> connection::get_children(path_view path)
+{
+    return future_from_callback<get_children_result>([&] (auto cb) { this->get_children(path, std::move(cb)); });
+}
+
+future<watch_children_result> connection::watch_children(path_view path)
+{
+    return future_from_callback<watch_children_result>([&] (auto cb) { this->watch_children(path, std::move(cb)); });
+}
+
+future<exists_result> connection::exists(path_view path)
+{
+    return future_from_callback<exists_result>([&] (auto cb) { this->exists(path, std::move(cb)); });
+}
+
+future<watch_exists_result> connection::watch_exists(path_view path)
+{
+    return future_from_callback<watch_exists_result>([&] (auto cb) { this->watch_exists(path, std::move(cb)); });
+}
+
+future<create_result> connection::create(path_view path, const buffer& data, const acl& rules, create_mode mode)
+{
+    return future_from_callback<create_result>([&] (auto cb) { this->create(path, data, rules, mode, std::move(cb)); });
+}
+
+void connection::create(path_view               path,
+                        const buffer&           data,
+                        const acl_handle&       rules,
+                        create_mode             mode,
+                        callback<create_result> on_complete
+                       )
+{
+    create(path, data, rules.rules(), mode, std::move(on_complete));
+}
+
+future<create_result> connection::create(path_view         path,
+                                         const buffer&     data,
+                                         const acl_handle& rules,
+                                         create_mode       mode
+                                        )
+{
+    return future_from_callback<create_result>([&] (auto cb) { this->create(path, data, rules, mode, std::move(cb)); });
+}
+
+future<set_result> connection::set(path_view path, const buffer& data, version check)
+{
+    return future_from_callback<set_result>([&] (auto cb) { this->set(path, data, check, std::move(cb)); });
+}
+
+future<void> connection::erase(path_view path, version check)
+{
+    return future_from_callback<void>([&] (auto cb) { this->erase(path, check, std::move(cb)); });
+}
+
+future<get_acl_result> connection::get_acl(path_view path) const
+{
+    return future_from_callback<get_acl_result>([&] (auto cb) { this->get_acl(path, std::move(cb)); });
+}
+
+future<void> connection::set_acl(path_view path, const acl& rules, acl_version check)
+{
+    return future_from_callback<void>([&] (auto cb) { this->set_acl(path, rules, check, std::move(cb)); });
+}
+
+future<multi_result> connection::commit(multi_op&& txn)
+{
+    return future_from_callback<multi_result>([&] (auto cb) { this->commit(std::move(txn), std::move(cb)); });
+}
+
+prepared_multi connection::prepare(multi_op txn) const
+{
+    return prepared_multi(std::move(txn));
+}
+
+void connection::commit(const prepared_multi& txn, callback<multi_result> on_complete)
+{
+    this->commit(multi_op(txn.ops()), std::move(on_complete));
+}
+
+future<multi_result> connection::commit(const prepared_multi& txn)
+{
+    return this->commit(multi_op(txn.ops()));
+}
+
+void connection::commit(const multi_op_view& txn, callback<multi_result> on_complete)
+{
+    this->commit(txn.to_multi_op(), std::move(on_complete));
+}
+
+future<multi_result> connection::commit(const multi_op_view& txn)
+{
+    return future_from_callback<multi_result>([&] (auto cb) { this->commit(txn, std::move(cb)); });
+}
+
+future<void> connection::load_fence()
+{
+    return future_from_callback<void>([&] (auto cb) { this->load_fence(std::move(cb)); });
+}
+
+future<get_result> connection::get_config()
+{
+    return future_from_callback<get_result>([&] (auto cb) { this->get_config(std::move(cb)); });
+}
+
+future<get_result> connection::reconfigure(const std::vector<std::string>& joining,
+                                           const std::vector<std::string>& leaving,
+                                           const std::vector<std::string>& members,
+                                           version                         from_config
+                                          )
+{
+    return future_from_callback<get_result>([&] (auto cb)
+                                            {
+                                                this->reconfigure(joining, leaving, members, from_config,
+                                                                  std::move(cb)
+                                                                 );
+                                            }
+                                           );
+}
+
+void connection::watch(path_view                 path,
+                       callback<watch_result>    on_complete,
+                       event_callback            on_event,
+                       const cancellation_token& cancel
+                      )
+{
+    watch(path, with_cancellation(cancel, std::move(on_complete)), std::move(on_event));
+}
+
+void connection::watch_children(path_view                       path,
+                                callback<watch_children_result> on_complete,
+                                event_callback                  on_event,
+                                const cancellation_token&       cancel
+                               )
+{
+    watch_children(path, with_cancellation(cancel, std::move(on_complete)), std::move(on_event));
+}
+
+void connection::watch_exists(path_view                     path,
+                              callback<watch_exists_result> on_complete,
+                              event_callback                on_event,
+                              const cancellation_token&     cancel
+                             )
+{
+    watch_exists(path, with_cancellation(cancel, std::move(on_complete)), std::move(on_event));
+}
+
+void connection::get_into(path_view path, buffer& target, callback<zk::stat> on_complete)
+{
+    this->get(path,
+              [&target, on_complete = std::move(on_complete)] (outcome<get_result> result)
+              {
+                  if (result)
+                  {
+                      const auto& data = result->data();
+                      buffer_assign(target, data.data(), data.data() + data.size());
+                      on_complete(result->stat());
+                  }
+                  else
+                  {
+                      on_complete(result.code());
+                  }
+              }
+             );
+}
+
+future<zk::stat> connection::get_into(path_view path, buffer& target)
+{
+    return future_from_callback<zk::stat>([&] (auto cb) { this->get_into(path, target, std::move(cb)); });
+}
+
+/// Issue \a read_one for every one of \a paths at once and deliver all of the outcomes when the last one completes.
+template <typename TResult, typename FRead>
+static void read_each(const std::vector<path_view>&          paths,
+                      callback<std::vector<outcome<TResult>>> on_complete,
+                      FRead&&                                read_one
+                     )
+{
+    struct batch
+    {
+        std::vector<optional<outcome<TResult>>> results;
+        std::atomic<std::size_t>                remaining;
+        callback<std::vector<outcome<TResult>>> on_complete;
+
+        void finish_one()
+        {
+            if (remaining.fetch_sub(1U, std::memory_order_acq_rel) != 1U)
+                return;
+
+            std::vector<outcome<TResult>> out;
+            out.reserve(results.size());
+            for (auto& result : results)
+                out.emplace_back(std::move(*result));
+            on_complete(std::move(out));
+        }
+    };
+
+    // The extra count is held by this function, so the batch can not finish while reads are still being issued
+    auto state = std::make_shared<batch>();
+    state->results.resize(paths.size());
+    state->remaining.store(paths.size() + 1U, std::memory_order_relaxed);
+    state->on_complete = std::move(on_complete);
+
+    for (std::size_t idx = 0U; idx < paths.size(); ++idx)
+    {
+        read_one(paths[idx],
+                 [state, idx] (outcome<TResult> result)
+                 {
+                     state->results[idx].emplace(std::move(result));
+                     state->finish_one();
+                 }
+                );
+    }
+    state->finish_one();
+}
+
+void connection::get_many(const std::vector<path_view>& paths, callback<std::vector<outcome<get_result>>> on_complete)
+{
+    read_each<get_result>(paths,
+                          std::move(on_complete),
+                          [this] (path_view path, callback<get_result> cb) { this->get(path, std::move(cb)); }
+                         );
+}
+
+future<std::vector<outcome<get_result>>> connection::get_many(const std::vector<path_view>& paths)
+{
+    return future_from_callback<std::vector<outcome<get_result>>>(
+        [&] (auto cb) { this->get_many(paths, std::move(cb)); }
+    );
+}
+
+void connection::get_children_many(const std::vector<path_view>&                       paths,
+                                   callback<std::vector<outcome<get_children_result>>> on_complete
+                                  )
+{
+    read_each<get_children_result>(paths,
+                                   std::move(on_complete),
+                                   [this] (path_view path, callback<get_children_result> cb)
+                                   {
+                                       this->get_children(path, std::move(cb));
+                                   }
+                                  );
+}
+
+future<std::vector<outcome<get_children_result>>> connection::get_children_many(const std::vector<path_view>& paths)
+{
+    return future_from_callback<std::vector<outcome<get_children_result>>>(
+        [&] (auto cb) { this->get_children_many(paths, std::move(cb)); }
+    );
+}
+
+void connection::exists_many(const std::vector<path_view>&                 paths,
+                             callback<std::vector<outcome<exists_result>>> on_complete
+                            )
+{
+    read_each<exists_result>(paths,
+                             std::move(on_complete),
+                             [this] (path_view path, callback<exists_result> cb) { this->exists(path, std::move(cb)); }
+                            );
+}
+
+future<std::vector<outcome<exists_result>>> connection::exists_many(const std::vector<path_view>& paths)
+{
+    return future_from_callback<std::vector<outcome<exists_result>>>(
+        [&] (auto cb) { this->exists_many(paths, std::move(cb)); }
+    );
+}
+
+void connection::read_many(const multi_op& txn, callback<multi_read_result> on_complete)
+{
+    for (std::size_t idx = 0U; idx < txn.size(); ++idx)
+    {
+        if (!is_read(txn[idx].type()))
+        {
+            // Like the failures of the reads themselves, this is delivered rather than thrown at the caller
+            auto cause = std::invalid_argument("Invalid op_type at index=" + std::to_string(idx) + " of a read_many: "
+                                               + to_string(txn[idx].type())
+                                              );
+            return on_complete(outcome<multi_read_result>(error_code::invalid_arguments,
+                                                          std::make_exception_ptr(std::move(cause))
+                                                         ));
+        }
+    }
+
+    struct batch
+    {
+        std::vector<optional<outcome<multi_result::part>>> results;
+        std::atomic<std::size_t>                           remaining;
+        callback<multi_read_result>                        on_complete;
+
+        void finish_one()
+        {
+            if (remaining.fetch_sub(1U, std::memory_order_acq_rel) != 1U)
+                return;
+
+            multi_read_result out;
+            out.reserve(results.size());
+            for (auto& result : results)
+                out.emplace_back(std::move(*result));
+            on_complete(std::move(out));
+        }
+    };
+
+    auto state = std::make_shared<batch>();
+    state->results.resize(txn.size());
+    state->remaining.store(txn.size() + 1U, std::memory_order_relaxed);
+    state->on_complete = std::move(on_complete);
+
+    auto part_of = [] (auto result) -> outcome<multi_result::part>
+                   {
+                       if (result)
+                           return multi_result::part(std::move(result).value());
+                       else
+                           return outcome<multi_result::part>(result.code(), result.error());
+                   };
+
+    for (std::size_t idx = 0U; idx < txn.size(); ++idx)
+    {
+        auto deliver = [state, idx, part_of] (auto result)
+                       {
+                           state->results[idx].emplace(part_of(std::move(result)));
+                           state->finish_one();
+                       };
+
+        if (txn[idx].type() == op_type::get)
+            get(txn[idx].as_get().path, callback<get_result>(deliver));
+        else
+            get_children(txn[idx].as_get_children().path, callback<get_children_result>(deliver));
+    }
+    state->finish_one();
+}
+
+future<multi_read_result> connection::read_many(const multi_op& txn)
+{
+    return future_from_callback<multi_read_result>([&] (auto cb) { this->read_many(txn, std::move(cb)); });
+}
+
+/// Send a fence through \a conn and issue \a read right behind it, delivering the read's outcome once both are done
+/// (unless the fence failed, which leaves the read without its guarantee).
+template <typename TResult, typename FRead>
+static void fenced_read(connection& conn, callback<TResult> on_complete, FRead&& read)
+{
+    struct pair
+    {
+        std::mutex                 protect;
+        optional<outcome<void>>    fence;
+        optional<outcome<TResult>> result;
+        callback<TResult>          on_complete;
+
+        void finish(std::unique_lock<std::mutex>& ax)
+        {
+            if (!fence || !result)
+                return;
+
+            outcome<TResult> out = *fence ? std::move(*result) : outcome<TResult>(fence->code(), fence->error());
+            auto             cb  = std::move(on_complete);
+            ax.unlock();
+            cb(std::move(out));
+        }
+    };
+
+    auto state         = std::make_shared<pair>();
+    state->on_complete = std::move(on_complete);
+
+    conn.load_fence([state] (outcome<void> fenced)
+                    {
+                        std::unique_lock<std::mutex> ax(state->protect);
+                        state->fence.emplace(std::move(fenced));
+                        state->finish(ax);
+                    }
+                   );
+    std::forward<FRead>(read)([state] (outcome<TResult> result)
+                              {
+                                  std::unique_lock<std::mutex> ax(state->protect);
+                                  state->result.emplace(std::move(result));
+                                  state->finish(ax);
+                              }
+                             );
+}
+
+void connection::get_linearizable(path_view path, callback<get_result> on_complete)
+{
+    fenced_read<get_result>(*this,
+                            std::move(on_complete),
+                            [&] (callback<get_result> cb) { this->get(path, std::move(cb)); }
+                           );
+}
+
+future<get_result> connection::get_linearizable(path_view path)
+{
+    return future_from_callback<get_result>([&] (auto cb) { this->get_linearizable(path, std::move(cb)); });
+}
+
+void connection::get_children_linearizable(path_view path, callback<get_children_result> on_complete)
+{
+    fenced_read<get_children_result>(*this,
+                                     std::move(on_complete),
+                                     [&] (callback<get_children_result> cb)
+                                     {
+                                         this->get_children(path, std::move(cb));
+                                     }
+                                    );
+}
+
+future<get_children_result> connection::get_children_linearizable(path_view path)
+{
+    return future_from_callback<get_children_result>(
+        [&] (auto cb) { this->get_children_linearizable(path, std::move(cb)); }
+    );
+}
+
+void connection::exists_linearizable(path_view path, callback<exists_result> on_complete)
+{
+    fenced_read<exists_result>(*this,
+                               std::move(on_complete),
+                               [&] (callback<exists_result> cb) { this->exists(path, std::move(cb)); }
+                              );
+}
+
+future<exists_result> connection::exists_linearizable(path_view path)
+{
+    return future_from_callback<exists_result>([&] (auto cb) { this->exists_linearizable(path, std::move(cb)); });
+}
+
+void connection::get_children_list(path_view path, callback<get_children_list_result> on_complete)
+{
+    get_children(path,
+                 [on_complete = std::move(on_complete)] (outcome<get_children_result> result)
+                 {
+                     if (result)
+                         on_complete(get_children_list_result(children_list(result->children()),
+                                                              result->parent_stat()
+                                                             )
+                                    );
+                     else
+                         on_complete(outcome<get_children_list_result>(result.code(), result.error()));
+                 }
+                );
+}
+
+future<get_children_list_result> connection::get_children_list(path_view path)
+{
+    return future_from_callback<get_children_list_result>([&] (auto cb)
+                                                          {
+                                                              this->get_children_list(path, std::move(cb));
+                                                          }
+                                                         );
+}
+
+void connection::watch_children_list(path_view path, callback<watch_children_list_result> on_complete)
+{
+    watch_children_list(path, std::move(on_complete), nullptr);
+}
+
+void connection::watch_children_list(path_view                            path,
+                                     callback<watch_children_list_result> on_complete,
+                                     event_callback                       on_event
+                                    )
+{
+    watch_children(path,
+                   [on_complete = std::move(on_complete)] (outcome<watch_children_result> result)
+                   {
+                       if (result)
+                       {
+                           auto& initial = result->initial();
+                           on_complete(watch_children_list_result(
+                                           get_children_list_result(children_list(initial.children()),
+                                                                    initial.parent_stat()
+                                                                   ),
+                                           std::move(result->next())
+                                       )
+                                      );
+                       }
+                       else
+                       {
+                           on_complete(outcome<watch_children_list_result>(result.code(), result.error()));
+                       }
+                   },
+                   std::move(on_event)
+                  );
+}
+
+future<watch_children_list_result> connection::watch_children_list(path_view path)
+{
+    return future_from_callback<watch_children_list_result>([&] (auto cb)
+                                                            {
+                                                                this->watch_children_list(path, std::move(cb));
+                                                            }
+                                                           );
+}
+
+void connection::watch_routed(path_view path, callback<get_result> on_complete)
+{
+    watch(path,
+          [on_complete = std::move(on_complete)] (outcome<watch_result> result)
+          {
+              if (result)
+                  on_complete(std::move(*result).initial());
+              else
+                  on_complete(outcome<get_result>(result.code(), result.error()));
+          },
+          [dispatcher = _dispatcher] (event ev) { dispatcher->dispatch(ev); }
+         );
+}
+
+void connection::watch_children_routed(path_view path, callback<get_children_result> on_complete)
+{
+    watch_children(path,
+                   [on_complete = std::move(on_complete)] (outcome<watch_children_result> result)
+                   {
+                       if (result)
+                           on_complete(std::move(*result).initial());
+                       else
+                           on_complete(outcome<get_children_result>(result.code(), result.error()));
+                   },
+                   [dispatcher = _dispatcher] (event ev) { dispatcher->dispatch(ev); }
+                  );
+}
+
+void connection::watch_exists_routed(path_view path, callback<exists_result> on_complete)
+{
+    watch_exists(path,
+                 [on_complete = std::move(on_complete)] (outcome<watch_exists_result> result)
+                 {
+                     if (result)
+                         on_complete(std::move(*result).initial());
+                     else
+                         on_complete(outcome<exists_result>(result.code(), result.error()));
+                 },
+                 [dispatcher = _dispatcher] (event ev) { dispatcher->dispatch(ev); }
+                );
+}
+
+void connection::for_each_child(path_view path, child_visitor visitor, callback<zk::stat> on_complete)
+{
+    get_children_list(path,
+                      [visitor = std::move(visitor), on_complete = std::move(on_complete)]
+                      (outcome<get_children_list_result> result)
+                      {
+                          if (result)
+                          {
+                              for (auto name : result->children())
+                                  visitor(name);
+                              on_complete(result->parent_stat());
+                          }
+                          else
+                          {
+                              on_complete(outcome<zk::stat>(result.code(), result.error()));
+                          }
+                      }
+                     );
+}
+
+future<zk::stat> connection::for_each_child(path_view path, child_visitor visitor)
+{
+    return future_from_callback<zk::stat>([&] (auto cb)
+                                          {
+                                              this->for_each_child(path, std::move(visitor), std::move(cb));
+                                          }
+                                         );
+}
+
+metrics_snapshot connection::metrics() const
+{
+    return metrics_snapshot();
+}
+
 future<zk::state> connection::watch_state()
 {
-    std::unique_lock<std::mutex> ax(_state_change_promises_protect);
+    std::unique_lock<std::mutex> ax(_state_change_protect);
     _state_change_promises.emplace_back();
     return _state_change_promises.rbegin()->get_future();
 }
 
+connection::state_subscription_id connection::subscribe_state(state_callback on_change)
+{
+    std::unique_lock<std::mutex> ax(_state_change_protect);
+    auto subscribers = _state_subscribers ? std::make_shared<state_subscriber_list>(*_state_subscribers)
+                                          : std::make_shared<state_subscriber_list>();
+    auto id          = _next_state_subscription++;
+    subscribers->push_back(state_subscriber{ id, std::move(on_change) });
+    _state_subscribers = std::move(subscribers);
+    return id;
+}
+
+void connection::unsubscribe_state(state_subscription_id id)
+{
+    std::unique_lock<std::mutex> ax(_state_change_protect);
+    if (!_state_subscribers)
+        return;
+
+    auto subscribers = std::make_shared<state_subscriber_list>();
+    subscribers->reserve(_state_subscribers->size());
+    for (const auto& subscriber : *_state_subscribers)
+        if (subscriber.id != id)
+            subscribers->push_back(subscriber);
+    _state_subscribers = std::move(subscribers);
+}
+
 void connection::on_session_event(zk::state new_state)
 {
-    std::unique_lock<std::mutex> ax(_state_change_promises_protect);
+    std::unique_lock<std::mutex> ax(_state_change_protect);
     auto l_state_change_promises = std::move(_state_change_promises);
+    _state_change_promises.clear();
+    auto subscribers = _state_subscribers;
     ax.unlock();
 
+    if (subscribers)
+    {
+        for (const auto& subscriber : *subscribers)
+            subscriber.on_change(new_state);
+    }
+
     auto ex = new_state == zk::state::expired_session       ? get_exception_ptr_of(error_code::session_expired)
             : new_state == zk::state::authentication_failed ? get_exception_ptr_of(error_code::authentication_failed)
             :                                                 std::exception_ptr();
@@ -67,8 +746,13 @@ connection_params::connection_params() noexcept :
         _hosts({}),
         _chroot("/"),
         _randomize_hosts(true),
+        _prefer_hosts(host_preference::none),
         _read_only(false),
-        _timeout(default_timeout)
+        _timeout(default_timeout),
+        _transport(io_transport::epoll),
+        _max_reads_in_flight(0U),
+        _max_writes_in_flight(0U),
+        _when_full(admission_policy::reject)
 { }
 
 connection_params::~connection_params() noexcept
@@ -140,6 +824,80 @@ static std::chrono::milliseconds extract_millis(string_view key, string_view val
     }
 }
 
+static std::size_t extract_size(string_view key, string_view val)
+{
+    if (val.empty() || !std::all_of(val.begin(), val.end(), [] (char c) { return '0' <= c && c <= '9'; }))
+        throw std::invalid_argument(std::string("Invalid value for ") + std::string(key) + std::string(" \"")
+                                    + std::string(val) + "\" -- expected a count"
+                                   );
+
+    return std::size_t(std::stoull(std::string(val)));
+}
+
+static admission_policy extract_admission_policy(string_view key, string_view val)
+{
+    if (val == "reject")
+        return admission_policy::reject;
+    else if (val == "wait")
+        return admission_policy::wait;
+    else
+        throw std::invalid_argument(std::string("Invalid value for ") + std::string(key) + std::string(" \"")
+                                    + std::string(val) + "\" -- expected \"reject\" or \"wait\""
+                                   );
+}
+
+static io_transport extract_transport(string_view key, string_view val)
+{
+    if (val == "epoll")
+        return io_transport::epoll;
+    else if (val == "io_uring")
+        return io_transport::io_uring;
+    else
+        throw std::invalid_argument(std::string("Invalid value for ") + std::string(key) + std::string(" \"")
+                                    + std::string(val) + "\" -- expected \"epoll\" or \"io_uring\""
+                                   );
+}
+
+static host_preference extract_host_preference(string_view key, string_view val)
+{
+    if (val == "none")
+        return host_preference::none;
+    else if (val == "zone")
+        return host_preference::zone;
+    else if (val == "latency")
+        return host_preference::latency;
+    else
+        throw std::invalid_argument(std::string("Invalid value for ") + std::string(key) + std::string(" \"")
+                                    + std::string(val) + "\" -- expected \"none\", \"zone\" or \"latency\""
+                                   );
+}
+
+/// The zones are given in the order of the hosts, which have been parsed by the time the query string is.
+static std::map<std::string, std::string> extract_host_zones(string_view key, string_view val,
+                                                             const connection_params::host_list& hosts
+                                                            )
+{
+    std::vector<std::string> zones;
+    split_each_substr(val, ',', [&] (string_view sub) { zones.emplace_back(std::string(sub)); });
+    // A blank zone for the last host leaves nothing after its comma
+    if (!val.empty() && val.back() == ',')
+        zones.emplace_back();
+
+    if (zones.size() != hosts.size())
+        throw std::invalid_argument(std::string("Invalid value for ") + std::string(key) + std::string(" \"")
+                                    + std::string(val) + "\" -- expected a zone for each of the "
+                                    + std::to_string(hosts.size()) + " hosts"
+                                   );
+
+    std::map<std::string, std::string> out;
+    for (std::size_t idx = 0U; idx < hosts.size(); ++idx)
+    {
+        if (!zones[idx].empty())
+            out[hosts[idx]] = std::move(zones[idx]);
+    }
+    return out;
+}
+
 static void extract_advanced_options(string_view src, connection_params& out)
 {
     if (src.empty() || src.size() == 1U)
@@ -171,10 +929,24 @@ static void extract_advanced_options(string_view src, connection_params& out)
 
         if (key == "randomize_hosts")
             out.randomize_hosts() = extract_bool(key, val);
+        else if (key == "prefer_hosts")
+            out.prefer_hosts() = extract_host_preference(key, val);
+        else if (key == "zone")
+            out.zone() = std::string(val);
+        else if (key == "host_zones")
+            out.host_zones() = extract_host_zones(key, val, out.hosts());
         else if (key == "read_only")
             out.read_only() = extract_bool(key, val);
         else if (key == "timeout")
             out.timeout() = extract_millis(key, val);
+        else if (key == "max_reads_in_flight")
+            out.max_reads_in_flight() = extract_size(key, val);
+        else if (key == "max_writes_in_flight")
+            out.max_writes_in_flight() = extract_size(key, val);
+        else if (key == "when_full")
+            out.when_full() = extract_admission_policy(key, val);
+        else if (key == "transport")
+            out.transport() = extract_transport(key, val);
         else
             invalid_key(key);
     });
@@ -213,12 +985,25 @@ connection_params connection_params::parse(string_view conn_string)
 
 bool operator==(const connection_params& lhs, const connection_params& rhs)
 {
-    return lhs.connection_schema() == rhs.connection_schema()
-        && lhs.hosts()             == rhs.hosts()
-        && lhs.chroot()            == rhs.chroot()
-        && lhs.randomize_hosts()   == rhs.randomize_hosts()
-        && lhs.read_only()         == rhs.read_only()
-        && lhs.timeout()           == rhs.timeout();
+    return lhs.connection_schema()    == rhs.connection_schema()
+        && lhs.hosts()                == rhs.hosts()
+        && lhs.chroot()               == rhs.chroot()
+        && lhs.randomize_hosts()      == rhs.randomize_hosts()
+        && lhs.prefer_hosts()         == rhs.prefer_hosts()
+        && lhs.zone()                 == rhs.zone()
+        && lhs.host_zones()           == rhs.host_zones()
+        && lhs.selector()             == rhs.selector()
+        && lhs.read_only()            == rhs.read_only()
+        && lhs.timeout()              == rhs.timeout()
+        && lhs.transport()            == rhs.transport()
+        && lhs.io_reactor()           == rhs.io_reactor()
+        && lhs.max_reads_in_flight()  == rhs.max_reads_in_flight()
+        && lhs.max_writes_in_flight() == rhs.max_writes_in_flight()
+        && lhs.when_full()            == rhs.when_full()
+        && lhs.read_buffer_pool()     == rhs.read_buffer_pool()
+        && lhs.observer()             == rhs.observer()
+        && lhs.completion_executor()  == rhs.completion_executor()
+        && lhs.resume_session()       == rhs.resume_session();
 }
 
 bool operator!=(const connection_params& lhs, const connection_params& rhs)
@@ -258,10 +1043,36 @@ std::ostream& operator<<(std::ostream& os, const connection_params& x)
                         };
     if (!x.randomize_hosts())
         query_string("randomize_hosts", "false");
+    if (x.prefer_hosts() != host_preference::none)
+        query_string("prefer_hosts", x.prefer_hosts());
+    if (!x.zone().empty())
+        query_string("zone", x.zone());
+    if (!x.host_zones().empty())
+    {
+        std::string zones;
+        for (const auto& host : x.hosts())
+        {
+            if (&host != &x.hosts().front())
+                zones += ',';
+
+            auto iter = x.host_zones().find(host);
+            if (iter != x.host_zones().end())
+                zones += iter->second;
+        }
+        query_string("host_zones", zones);
+    }
     if (x.read_only())
         query_string("read_only", "true");
     if (x.timeout() != connection_params::default_timeout)
         query_string("timeout", std::chrono::duration<double>(x.timeout()).count());
+    if (x.max_reads_in_flight() != 0U)
+        query_string("max_reads_in_flight", x.max_reads_in_flight());
+    if (x.max_writes_in_flight() != 0U)
+        query_string("max_writes_in_flight", x.max_writes_in_flight());
+    if (x.when_full() != admission_policy::reject)
+        query_string("when_full", x.when_full());
+    if (x.transport() != io_transport::epoll)
+        query_string("transport", x.transport());
     return os;
 }
 
@@ -3,16 +3,28 @@
 #include <zk/config.hpp>
 
 #include <chrono>
+#include <functional>
 #include <iosfwd>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
 
+#include "admission.hpp"
 #include "buffer.hpp"
+#include "callback.hpp"
 #include "forwards.hpp"
+#include "metrics.hpp"
 #include "future.hpp"
+#include "host_selection.hpp"
+#include "optional.hpp"
+#include "path.hpp"
+#include "reactor.hpp"
 #include "string_view.hpp"
+#include "types.hpp"
+#include "update.hpp"
+#include "watch_dispatcher.hpp"
 
 namespace zk
 {
@@ -30,53 +42,335 @@ public:
 
     static std::shared_ptr<connection> connect(string_view conn_string);
 
+    /// Makes the connections of a \ref connection_params::connection_schema other than \c "zk" and \c "zkn".
+    using schema_factory = std::function<std::shared_ptr<connection> (const connection_params&)>;
+
+    /// Make \ref connect create the connections of \a schema with \a make, replacing what was registered for it before.
+    /// This is how modules outside of the client library (such as \ref zk::fake::server, which registers \c "fakezk")
+    /// provide their connections.
+    static void register_schema(std::string schema, schema_factory make);
+
     virtual ~connection() noexcept;
 
     virtual void close() = 0;
 
-    virtual future<get_result> get(string_view path) = 0;
+    /// \{
+    /// Close the connection without waiting for the session to be over (see \ref client::close_async). The default
+    /// implementations call \ref close on the calling thread; connections whose close waits on the server override the
+    /// callback form to wait somewhere else.
+    virtual void close_async(callback<void> on_closed);
+
+    virtual future<void> close_async();
+    /// \}
+
+    /// \{
+    /// The completion-callback form of each operation. These are the primitives an implementation must provide; see the
+    /// \ref client method of the same name for the meaning of each.
+    virtual void get(path_view path, callback<get_result> on_complete) = 0;
+
+    virtual void watch(path_view path, callback<watch_result> on_complete) = 0;
+
+    virtual void get_children(path_view path, callback<get_children_result> on_complete) = 0;
+
+    virtual void watch_children(path_view path, callback<watch_children_result> on_complete) = 0;
+
+    virtual void exists(path_view path, callback<exists_result> on_complete) = 0;
+
+    virtual void watch_exists(path_view path, callback<watch_exists_result> on_complete) = 0;
+
+    virtual void watch(path_view path, callback<watch_result> on_complete, event_callback on_event) = 0;
+
+    virtual void watch_children(path_view                       path,
+                                callback<watch_children_result> on_complete,
+                                event_callback                  on_event
+                               ) = 0;
+
+    virtual void watch_exists(path_view path, callback<watch_exists_result> on_complete, event_callback on_event) = 0;
+
+    /// \{
+    /// Set a watch which is abandoned if \a cancel is cancelled before the initial data arrives, in which case
+    /// \a on_complete gets \ref error_code::operation_timeout. The default implementations only wrap \a on_complete
+    /// with \ref with_cancellation, so the abandoned watch stays set and \a on_event is still called when it triggers;
+    /// implementations which track their watches should override them to forget the watch on the spot.
+    virtual void watch(path_view                 path,
+                       callback<watch_result>    on_complete,
+                       event_callback            on_event,
+                       const cancellation_token& cancel
+                      );
+
+    virtual void watch_children(path_view                       path,
+                                callback<watch_children_result> on_complete,
+                                event_callback                  on_event,
+                                const cancellation_token&       cancel
+                               );
+
+    virtual void watch_exists(path_view                     path,
+                              callback<watch_exists_result> on_complete,
+                              event_callback                on_event,
+                              const cancellation_token&     cancel
+                             );
+    /// \}
+
+    virtual void create(path_view               path,
+                        const buffer&           data,
+                        const acl&              rules,
+                        create_mode             mode,
+                        callback<create_result> on_complete
+                       ) = 0;
+
+    /// Create with rules which are already encoded. The default implementation forwards the plain rules to the
+    /// overload taking an \ref acl; implementations which can send the encoding of the handle do.
+    virtual void create(path_view               path,
+                        const buffer&           data,
+                        const acl_handle&       rules,
+                        create_mode             mode,
+                        callback<create_result> on_complete
+                       );
+
+    virtual void set(path_view path, const buffer& data, version check, callback<set_result> on_complete) = 0;
+
+    virtual void erase(path_view path, version check, callback<void> on_complete) = 0;
+
+    virtual void get_acl(path_view path, callback<get_acl_result> on_complete) const = 0;
+
+    virtual void set_acl(path_view path, const acl& rules, acl_version check, callback<void> on_complete) = 0;
+
+    virtual void commit(multi_op&& txn, callback<multi_result> on_complete) = 0;
+
+    virtual void load_fence(callback<void> on_complete) = 0;
+    /// \}
+
+    /// \{
+    /// Read the data of the entry at \a path into the caller-owned \a target buffer, reusing its storage. The
+    /// \a target must not be touched until the operation completes. The default implementation reads through \ref get
+    /// and copies the result into \a target.
+    virtual void get_into(path_view path, buffer& target, callback<zk::stat> on_complete);
+
+    virtual future<zk::stat> get_into(path_view path, buffer& target);
+    /// \}
+
+    /// \{
+    /// Prepare \a txn to be committed many times (see \ref prepared_multi). The default implementation makes no
+    /// encoding of it, and committing a \ref prepared_multi without one of this connection's encodings copies its
+    /// operations into a \ref multi_op and commits that.
+    virtual prepared_multi prepare(multi_op txn) const;
+
+    virtual void commit(const prepared_multi& txn, callback<multi_result> on_complete);
+
+    virtual future<multi_result> commit(const prepared_multi& txn);
+    /// \}
+
+    /// \{
+    /// Commit the operations \a txn refers to, which only have to stay valid until this returns. The default
+    /// implementation copies them into a \ref multi_op and commits that.
+    virtual void commit(const multi_op_view& txn, callback<multi_result> on_complete);
+
+    virtual future<multi_result> commit(const multi_op_view& txn);
+    /// \}
+
+    /// \{
+    /// Batched reads, where result \c i is the outcome of the read of \c paths[i]. The default implementations issue
+    /// one \ref get (or \ref get_children or \ref exists) per path and collect the results.
+    virtual void get_many(const std::vector<path_view>& paths, callback<std::vector<outcome<get_result>>> on_complete);
+
+    virtual future<std::vector<outcome<get_result>>> get_many(const std::vector<path_view>& paths);
+
+    virtual void get_children_many(const std::vector<path_view>&                       paths,
+                                   callback<std::vector<outcome<get_children_result>>> on_complete
+                                  );
+
+    virtual future<std::vector<outcome<get_children_result>>> get_children_many(const std::vector<path_view>& paths);
+
+    virtual void exists_many(const std::vector<path_view>&                 paths,
+                             callback<std::vector<outcome<exists_result>>> on_complete
+                            );
+
+    virtual future<std::vector<outcome<exists_result>>> exists_many(const std::vector<path_view>& paths);
+    /// \}
+
+    /// \{
+    /// Read everything the \ref op::get and \ref op::get_children operations of \a txn ask for. The default
+    /// implementations issue each read on its own, pipelined, and collect the outcomes; an implementation whose server
+    /// can answer the whole batch in one response should override them.
+    ///
+    /// \throws std::invalid_argument if an operation of \a txn is not a read. Like every other failure, it is
+    ///  delivered through the callback or future (with \ref error_code::invalid_arguments), not thrown by the call.
+    virtual void read_many(const multi_op& txn, callback<multi_read_result> on_complete);
+
+    virtual future<multi_read_result> read_many(const multi_op& txn);
+    /// \}
+
+    /// \{
+    /// Reads which see every change committed before they were issued: a \ref load_fence and the read are sent back
+    /// to back, and the session being FIFO puts the read behind the fence without waiting out a round trip between
+    /// them. The outcome is the first failure of the two, or the result of the read.
+    virtual void get_linearizable(path_view path, callback<get_result> on_complete);
+
+    virtual future<get_result> get_linearizable(path_view path);
+
+    virtual void get_children_linearizable(path_view path, callback<get_children_result> on_complete);
+
+    virtual future<get_children_result> get_children_linearizable(path_view path);
+
+    virtual void exists_linearizable(path_view path, callback<exists_result> on_complete);
+
+    virtual future<exists_result> exists_linearizable(path_view path);
+    /// \}
+
+    /// \{
+    /// Reads of the children of an entry into a \ref children_list. The default implementations go through
+    /// \ref get_children and \ref watch_children and convert the result, so they save nothing; an implementation which
+    /// can fill the list straight from the response should override them.
+    virtual void get_children_list(path_view path, callback<get_children_list_result> on_complete);
+
+    virtual future<get_children_list_result> get_children_list(path_view path);
+
+    virtual void watch_children_list(path_view path, callback<watch_children_list_result> on_complete);
+
+    virtual void watch_children_list(path_view                            path,
+                                     callback<watch_children_list_result> on_complete,
+                                     event_callback                       on_event
+                                    );
+
+    virtual future<watch_children_list_result> watch_children_list(path_view path);
+    /// \}
+
+    /// \{
+    /// Set a watch whose event goes to \ref dispatcher rather than to a callback of its own (see
+    /// \ref client::watch_routed). The default implementations set an ordinary watch whose event callback hands the
+    /// event to the dispatcher; an implementation which can route the events itself should override them.
+    virtual void watch_routed(path_view path, callback<get_result> on_complete);
+
+    virtual void watch_children_routed(path_view path, callback<get_children_result> on_complete);
 
-    virtual future<watch_result> watch(string_view path) = 0;
+    virtual void watch_exists_routed(path_view path, callback<exists_result> on_complete);
+    /// \}
+
+    /// The dispatcher the events of routed watches are delivered to.
+    watch_dispatcher& dispatcher() const noexcept { return *_dispatcher; }
+
+    /// The updates of \ref client::update in progress through this connection.
+    update_table& updates() const noexcept { return *_updates; }
+
+    /// \{
+    /// Visit the children of an entry (see \ref client::for_each_child). The default implementation visits the result of
+    /// \ref get_children_list.
+    virtual void for_each_child(path_view path, child_visitor visitor, callback<zk::stat> on_complete);
+
+    virtual future<zk::stat> for_each_child(path_view path, child_visitor visitor);
+    /// \}
+
+    /// \{
+    /// Dynamic reconfiguration of the ensemble (see \ref client::get_config and \ref client::reconfigure). An empty
+    /// \a members makes the change incremental: the \a joining servers are added and the \a leaving IDs removed.
+    /// Otherwise \a members replaces the whole ensemble and both other lists must be empty.
+    virtual void get_config(callback<get_result> on_complete) = 0;
+
+    virtual future<get_result> get_config();
+
+    virtual void reconfigure(const std::vector<std::string>& joining,
+                             const std::vector<std::string>& leaving,
+                             const std::vector<std::string>& members,
+                             version                         from_config,
+                             callback<get_result>            on_complete
+                            ) = 0;
+
+    virtual future<get_result> reconfigure(const std::vector<std::string>& joining,
+                                           const std::vector<std::string>& leaving,
+                                           const std::vector<std::string>& members,
+                                           version                         from_config
+                                          );
+    /// \}
+
+    /// Replace the servers this connection may connect to (see \ref client::update_hosts).
+    ///
+    /// \throws std::invalid_argument if \a hosts is empty.
+    virtual void update_hosts(const std::vector<std::string>& hosts) = 0;
 
-    virtual future<get_children_result> get_children(string_view path) = 0;
+    /// The credentials of the session this connection has (see \ref client::current_session).
+    virtual optional<session_credentials> current_session() const = 0;
+
+    /// \{
+    /// The \c future form of each operation. The default implementations adapt the callback form with a \c promise; an
+    /// implementation can override them when it can fill the \c promise more directly.
+    virtual future<get_result> get(path_view path);
 
-    virtual future<watch_children_result> watch_children(string_view path) = 0;
+    virtual future<watch_result> watch(path_view path);
 
-    virtual future<exists_result> exists(string_view path) = 0;
+    virtual future<get_children_result> get_children(path_view path);
 
-    virtual future<watch_exists_result> watch_exists(string_view path) = 0;
+    virtual future<watch_children_result> watch_children(path_view path);
 
-    virtual future<create_result> create(string_view   path,
+    virtual future<exists_result> exists(path_view path);
+
+    virtual future<watch_exists_result> watch_exists(path_view path);
+
+    virtual future<create_result> create(path_view     path,
                                          const buffer& data,
                                          const acl&    rules,
                                          create_mode   mode
-                                        ) = 0;
+                                        );
 
-    virtual future<set_result> set(string_view path, const buffer& data, version check) = 0;
+    virtual future<create_result> create(path_view         path,
+                                         const buffer&     data,
+                                         const acl_handle& rules,
+                                         create_mode       mode
+                                        );
 
-    virtual future<void> erase(string_view path, version check) = 0;
+    virtual future<set_result> set(path_view path, const buffer& data, version check);
 
-    virtual future<get_acl_result> get_acl(string_view path) const = 0;
+    virtual future<void> erase(path_view path, version check);
 
-    virtual future<void> set_acl(string_view path, const acl& rules, acl_version check) = 0;
+    virtual future<get_acl_result> get_acl(path_view path) const;
 
-    virtual future<multi_result> commit(multi_op&& txn) = 0;
+    virtual future<void> set_acl(path_view path, const acl& rules, acl_version check);
 
-    virtual future<void> load_fence() = 0;
+    virtual future<multi_result> commit(multi_op&& txn);
+
+    virtual future<void> load_fence();
+    /// \}
 
     virtual zk::state state() const = 0;
 
+    /// Get the counters of the requests made through this connection. Implementations which do not measure anything
+    /// return an empty snapshot.
+    virtual metrics_snapshot metrics() const;
+
     /// Watch for a state change.
     virtual future<zk::state> watch_state();
 
+    /// Identifies a callback registered with \ref subscribe_state (\c 0 is never used).
+    using state_subscription_id = std::size_t;
+
+    /// Call \a on_change with every state the session enters, until \ref unsubscribe_state is called. Unlike
+    /// \ref watch_state, nothing has to be registered again after each change, so no change is missed.
+    state_subscription_id subscribe_state(state_callback on_change);
+
+    /// Stop calling the callback registered as \a id. If a change is being delivered, it may still get that one.
+    void unsubscribe_state(state_subscription_id id);
+
 protected:
     /// Call this from derived classes when a session event happens. This triggers the delivery of all promises of state
-    /// changes (issued through \ref watch_state).
+    /// changes (issued through \ref watch_state) and calls the subscribers of \ref subscribe_state.
     virtual void on_session_event(zk::state new_state);
 
 private:
-    mutable std::mutex              _state_change_promises_protect;
-    std::vector<promise<zk::state>> _state_change_promises;
+    struct state_subscriber final
+    {
+        state_subscription_id id;
+        state_callback        on_change;
+    };
+
+    /// Replaced as a whole when a subscriber comes or goes, so delivering a change only copies a pointer.
+    using state_subscriber_list = std::vector<state_subscriber>;
+
+private:
+    mutable std::mutex                           _state_change_protect;
+    std::vector<promise<zk::state>>              _state_change_promises;
+    std::shared_ptr<const state_subscriber_list> _state_subscribers;
+    state_subscription_id                        _next_state_subscription = 1U;
+    std::shared_ptr<watch_dispatcher>            _dispatcher = std::make_shared<watch_dispatcher>();
+    std::shared_ptr<update_table>                _updates    = std::make_shared<update_table>();
 };
 
 /// Used to specify parameters for a \c connection. This can either be created manually or through a
@@ -113,19 +407,29 @@ public:
     ///   seconds and sets a read-only client. Boolean values can be specified with \c true, \c t, or \c 1 for \c true
     ///   or \c false, \c f, or \c 0 for \c false. It is important to note that, unlike regular HTTP URLs, query
     ///   parameters which are not understood will result in an error.
+    ///   - `host_zones`: \ref connection_params::host_zones (comma-separated, in the order of the hosts)
+    ///   - `max_reads_in_flight`: \ref connection_params::max_reads_in_flight
+    ///   - `max_writes_in_flight`: \ref connection_params::max_writes_in_flight
+    ///   - `prefer_hosts`: \ref connection_params::prefer_hosts (\c none, \c zone or \c latency)
     ///   - `randomize_hosts`: \ref connection_params::randomize_hosts
     ///   - `read_only`: \ref connection_params::read_only
     ///   - `timeout`: \ref connection_params::timeout
+    ///   - `transport`: \ref connection_params::transport (\c epoll or \c io_uring)
+    ///   - `when_full`: \ref connection_params::when_full (\c reject or \c wait)
+    ///   - `zone`: \ref connection_params::zone
     ///
     /// \throws std::invalid_argument if the string is malformed in some way.
     static connection_params parse(string_view conn_string);
 
     /// \{
-    /// Determines the underlying \ref zk::connection implementation to use. The valid values are \c "zk" and
-    /// \c "fakezk".
+    /// Determines the underlying \ref zk::connection implementation to use. The valid values are \c "zk", \c "zkn"
+    /// and \c "fakezk".
     ///
     /// - `zk`: The standard-issue ZooKeeper connection to a real ZooKeeper cluster. This schema uses
     ///   \ref zk::connection_zk as the underlying connection.
+    /// - `zkn`: A connection to a real ZooKeeper cluster which speaks the protocol itself on shared reactor threads
+    ///   instead of going through the ZooKeeper C client. This schema uses \ref zk::connection_zkn as the underlying
+    ///   connection.
     /// - `fakezk`: Create a client connected to a fake ZooKeeper server (\ref zk::fake::server). Here, the
     ///   `host_address` refers to the name of the in-memory DB created when the server instance was. This schema uses
     ///   \ref zk::fake::connection_fake as the underlying connection.
@@ -154,11 +458,47 @@ public:
 
     /// \{
     /// Connect to a host at random (as opposed to attempting connections in order)? The default is to randomize (the
-    /// use cases for sequential connections are usually limited to testing purposes).
+    /// use cases for sequential connections are usually limited to testing purposes). The shuffling is done by the
+    /// \ref host_selector of the connection: the \c "zk" connections turn the ZooKeeper C client's own shuffling off,
+    /// which is a setting of the whole process, so that every connection gets the order its selector asked for.
     bool  randomize_hosts() const { return _randomize_hosts; }
     bool& randomize_hosts()       { return _randomize_hosts; }
     /// \}
 
+    /// \{
+    /// Which servers the connection would rather be on. The default (\ref host_preference::none) treats them all alike;
+    /// \ref host_preference::zone tries the servers in the client's \ref zone first and \ref host_preference::latency
+    /// the nearest. Either way, a session which loses its server moves on to the next best. Hosts which are equally
+    /// good are tried in a random order if \ref randomize_hosts is set.
+    ///
+    /// \see host_selector
+    host_preference  prefer_hosts() const { return _prefer_hosts; }
+    host_preference& prefer_hosts()       { return _prefer_hosts; }
+    /// \}
+
+    /// \{
+    /// The availability zone (or rack, or data center) the client runs in, for \ref host_preference::zone. This is
+    /// compared to the zones in \ref host_zones; it is blank by default, which prefers no server.
+    const std::string& zone() const { return _zone; }
+    std::string&       zone()       { return _zone; }
+    /// \}
+
+    /// \{
+    /// The zone of each server, keyed by its entry in \ref hosts. Servers which are missing from it are in no zone.
+    /// In a connection string, the zones are listed in the order of the hosts, with a blank entry for a server in no
+    /// zone: `"zk://a:2181,b:2181,c:2181/?prefer_hosts=zone&zone=east&host_zones=east,west,"`.
+    const std::map<std::string, std::string>& host_zones() const { return _host_zones; }
+    std::map<std::string, std::string>&       host_zones()       { return _host_zones; }
+    /// \}
+
+    /// \{
+    /// The selector which orders the \ref hosts, replacing the built-in one for \ref prefer_hosts. If unset (the
+    /// default), \ref host_selector::create makes the one \ref prefer_hosts asks for. Like \ref observer, this can not
+    /// be specified through a connection string.
+    const std::shared_ptr<host_selector>& selector() const { return _selector; }
+    std::shared_ptr<host_selector>&       selector()       { return _selector; }
+    /// \}
+
     /// \{
     /// Allow connections to read-only servers? The default (\c false) is to disallow. **/
     bool  read_only() const { return _read_only; }
@@ -176,13 +516,115 @@ public:
     std::chrono::milliseconds& timeout()       { return _timeout; }
     /// \}
 
+    /// \{
+    /// How a \c "zkn" connection moves its bytes (see \ref io_transport). The default is \ref io_transport::epoll;
+    /// \ref io_transport::io_uring saves most of the system calls of a busy session, and quietly falls back to
+    /// \c epoll on a kernel which can not run it. This is ignored by the other schemas.
+    io_transport  transport() const { return _transport; }
+    io_transport& transport()       { return _transport; }
+    /// \}
+
+    /// \{
+    /// The reactor a \c "zkn" connection runs its session on. If unset (the default), it goes on one of the loops of
+    /// \ref reactor::shared for its \ref transport. Give it a \ref reactor::external instead to have the session
+    /// served from the event loop of the application, with every completion and watch event run inline on that thread.
+    /// This can not be specified through a connection string and is ignored by the other schemas.
+    const std::shared_ptr<reactor>& io_reactor() const { return _io_reactor; }
+    std::shared_ptr<reactor>&       io_reactor()       { return _io_reactor; }
+    /// \}
+
+    /// \{
+    /// The most reads (\ref client::get, \ref client::exists, setting a watch and so on) the connection will have
+    /// outstanding at once; a batch such as \ref client::get_many counts once for each entry it reads. \c 0 (the
+    /// default) does not limit them. Reads and writes have separate budgets, so a flood of one does not starve the
+    /// other.
+    ///
+    /// \see when_full
+    std::size_t  max_reads_in_flight() const { return _max_reads_in_flight; }
+    std::size_t& max_reads_in_flight()       { return _max_reads_in_flight; }
+    /// \}
+
+    /// \{
+    /// The most writes (\ref client::create, \ref client::set, \ref client::erase, \ref client::set_acl and
+    /// \ref client::commit) the connection will have outstanding at once. \c 0 (the default) does not limit them.
+    ///
+    /// \see when_full
+    std::size_t  max_writes_in_flight() const { return _max_writes_in_flight; }
+    std::size_t& max_writes_in_flight()       { return _max_writes_in_flight; }
+    /// \}
+
+    /// \{
+    /// What to do with a request made when \ref max_reads_in_flight or \ref max_writes_in_flight is reached: fail it
+    /// with \ref throttled (\ref admission_policy::reject, the default) or block the caller until there is room
+    /// (\ref admission_policy::wait).
+    admission_policy  when_full() const { return _when_full; }
+    admission_policy& when_full()       { return _when_full; }
+    /// \}
+
+    /// \{
+    /// The pool that the data of \ref get_result instances is drawn from. If unset (the default), each read allocates a
+    /// new \ref buffer for its payload. This can not be specified through a connection string.
+    ///
+    /// \see buffer_pool
+    const std::shared_ptr<buffer_pool>& read_buffer_pool() const { return _read_buffer_pool; }
+    std::shared_ptr<buffer_pool>&       read_buffer_pool()       { return _read_buffer_pool; }
+    /// \}
+
+    /// \{
+    /// The observer told about every request made through the connection. If unset (the default), requests are not
+    /// traced. Like \ref read_buffer_pool, this can not be specified through a connection string.
+    ///
+    /// \see connection_observer
+    const std::shared_ptr<connection_observer>& observer() const { return _observer; }
+    std::shared_ptr<connection_observer>&       observer()       { return _observer; }
+    /// \}
+
+    /// \{
+    /// Where results are delivered. If unset (the default), futures are filled and callbacks are run on the ZooKeeper
+    /// completion thread, so one slow consumer holds up every completion of the session. If set, the completion thread
+    /// only decodes each result and hands it to this executor (\ref thread_pool_executor, for example) to fill the
+    /// future or run the callback with; watch events go the same way. The results for any one path are still delivered
+    /// in the order the server sent them, so the initial data of a watch always comes before its event. Like
+    /// \ref observer, this can not be specified through a connection string.
+    ///
+    /// \note The visitor given to \ref client::for_each_child is still called on the completion thread, as the names
+    ///  it is given only live as long as the response.
+    const std::shared_ptr<executor>& completion_executor() const { return _completion_executor; }
+    std::shared_ptr<executor>&       completion_executor()       { return _completion_executor; }
+    /// \}
+
+    /// \{
+    /// The session to carry on with instead of starting a new one, as saved from \ref client::current_session by an
+    /// earlier run of the process. If the server has expired it in the meantime, the connection goes straight to
+    /// \ref state::expired_session and a new connection without this has to be made. Rolling restarts which come back
+    /// within the session timeout this way keep their ephemeral entries, so nothing watching them fires. Since the
+    /// password is a secret, this can not be specified through a connection string.
+    ///
+    /// \note The watches of the old process are gone with it; they are not resumed.
+    const optional<session_credentials>& resume_session() const { return _resume_session; }
+    optional<session_credentials>&       resume_session()       { return _resume_session; }
+    /// \}
+
 private:
-    std::string               _connection_schema;
-    host_list                 _hosts;
-    std::string               _chroot;
-    bool                      _randomize_hosts;
-    bool                      _read_only;
-    std::chrono::milliseconds _timeout;
+    std::string                          _connection_schema;
+    host_list                            _hosts;
+    std::string                          _chroot;
+    bool                                 _randomize_hosts;
+    host_preference                      _prefer_hosts;
+    std::string                          _zone;
+    std::map<std::string, std::string>   _host_zones;
+    std::shared_ptr<host_selector>       _selector;
+    bool                                 _read_only;
+    std::chrono::milliseconds            _timeout;
+    io_transport                         _transport;
+    std::shared_ptr<reactor>             _io_reactor;
+    std::size_t                          _max_reads_in_flight;
+    std::size_t                          _max_writes_in_flight;
+    admission_policy                     _when_full;
+    std::shared_ptr<buffer_pool>         _read_buffer_pool;
+    std::shared_ptr<connection_observer> _observer;
+    std::shared_ptr<executor>            _completion_executor;
+    optional<session_credentials>        _resume_session;
 };
 
 bool operator==(const connection_params& lhs, const connection_params& rhs);
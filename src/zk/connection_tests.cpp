@@ -76,4 +76,56 @@ GTEST_TEST(connection_params_tests, timeout)
     CHECK_EQ(manual, res);
 }
 
+GTEST_TEST(connection_params_tests, in_flight_limits)
+{
+    const auto res = connection_params::parse("zk://localhost/?max_reads_in_flight=1000&max_writes_in_flight=50"
+                                              "&when_full=wait"
+                                             );
+    connection_params manual;
+    manual.hosts()                = { "localhost" };
+    manual.max_reads_in_flight()  = 1000U;
+    manual.max_writes_in_flight() = 50U;
+    manual.when_full()            = admission_policy::wait;
+    CHECK_EQ(manual, res);
+    CHECK_EQ(manual, connection_params::parse(to_string(manual)));
+}
+
+GTEST_TEST(connection_params_tests, in_flight_limits_invalid)
+{
+    CHECK_THROWS(std::invalid_argument) { connection_params::parse("zk://localhost/?max_reads_in_flight=-1"); };
+    CHECK_THROWS(std::invalid_argument) { connection_params::parse("zk://localhost/?when_full=drop"); };
+}
+
+GTEST_TEST(connection_params_tests, transport)
+{
+    const auto res = connection_params::parse("zkn://localhost/?transport=io_uring");
+    connection_params manual;
+    manual.connection_schema() = "zkn";
+    manual.hosts()             = { "localhost" };
+    manual.transport()         = io_transport::io_uring;
+    CHECK_EQ(manual, res);
+    CHECK_EQ(manual, connection_params::parse(to_string(manual)));
+    CHECK_EQ(io_transport::epoll, connection_params::parse("zkn://localhost/").transport());
+    CHECK_THROWS(std::invalid_argument) { connection_params::parse("zkn://localhost/?transport=kqueue"); };
+}
+
+GTEST_TEST(connection_params_tests, host_preference)
+{
+    const auto res = connection_params::parse("zk://a:2181,b:2181,c:2181/?prefer_hosts=zone&zone=east"
+                                              "&host_zones=east,,west"
+                                             );
+    connection_params manual;
+    manual.hosts()        = { "a:2181", "b:2181", "c:2181" };
+    manual.prefer_hosts() = host_preference::zone;
+    manual.zone()         = "east";
+    manual.host_zones()   = { { "a:2181", "east" }, { "c:2181", "west" } };
+    CHECK_EQ(manual, res);
+    CHECK_EQ(manual, connection_params::parse(to_string(manual)));
+
+    CHECK_EQ(host_preference::latency, connection_params::parse("zk://a/?prefer_hosts=latency").prefer_hosts());
+    CHECK_EQ(1U, connection_params::parse("zk://a,b/?host_zones=west,").host_zones().size());
+    CHECK_THROWS(std::invalid_argument) { connection_params::parse("zk://a/?prefer_hosts=nearest"); };
+    CHECK_THROWS(std::invalid_argument) { connection_params::parse("zk://a,b/?host_zones=east"); };
+}
+
 }
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cerrno>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <map>
@@ -12,12 +13,21 @@
 #include <string>
 #include <system_error>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 
 #include <zookeeper/zookeeper.h>
 
 #include "acl.hpp"
+#include "admission.hpp"
+#include "buffer_pool.hpp"
+#include "cancellation.hpp"
+#include "completion_pool.hpp"
+#include "detail/native.hpp"
 #include "error.hpp"
+#include "executor.hpp"
 #include "multi.hpp"
+#include "observer.hpp"
 #include "results.hpp"
 #include "types.hpp"
 
@@ -25,156 +35,641 @@ namespace zk
 {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Utility Functions                                                                                                  //
+// Native Adaptors                                                                                                    //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-template <typename FAction>
-auto with_str(string_view src, FAction&& action) noexcept(noexcept(std::forward<FAction>(action)(ptr<const char>())))
-        -> decltype(std::forward<FAction>(action)(ptr<const char>()))
+// The conversions which do not depend on the completers live in detail/native.hpp, where the benchmarks can reach them
+
+template <typename TResult>
+static TResult children_result_from_raw(const struct String_vector& strings, const struct Stat& stat);
+
+template <>
+get_children_result children_result_from_raw(const struct String_vector& strings, const struct Stat& stat)
 {
-    char buffer[src.size() + 1];
-    buffer[src.size()] = '\0';
-    std::memcpy(buffer, src.data(), src.size());
-    return std::forward<FAction>(action)(buffer);
+    return get_children_result(string_vector_from_raw(strings), stat_from_raw(stat));
 }
 
-static ACL encode_acl_part(const acl_rule& src)
+template <>
+get_children_list_result children_result_from_raw(const struct String_vector& strings, const struct Stat& stat)
 {
-    ACL out;
-    out.perms     = static_cast<int>(src.permissions());
-    out.id.scheme = const_cast<ptr<char>>(src.scheme().c_str());
-    out.id.id     = const_cast<ptr<char>>(src.id().c_str());
-    return out;
+    return get_children_list_result(children_list_from_raw(strings), stat_from_raw(stat));
 }
 
-template <typename FAction>
-auto with_acl(const acl& rules, FAction&& action) noexcept(noexcept(std::forward<FAction>(action)(ptr<ACL_vector>())))
-        -> decltype(std::forward<FAction>(action)(ptr<ACL_vector>()))
+static get_result get_result_from_raw(ptr<const char>                     data,
+                                      int                                 data_sz,
+                                      const struct Stat&                  stat_raw,
+                                      const std::shared_ptr<buffer_pool>& pool
+                                     )
 {
-    ACL parts[rules.size()];
-    for (std::size_t idx = 0; idx < rules.size(); ++idx)
-        parts[idx] = encode_acl_part(rules[idx]);
-
-    ACL_vector vec;
-    vec.count = int(rules.size());
-    vec.data  = parts;
-    return std::forward<FAction>(action)(&vec);
+    if (pool)
+        return get_result(pool->acquire(data, data + data_sz), stat_from_raw(stat_raw), pool);
+    else
+        return get_result(buffer(data, data + data_sz), stat_from_raw(stat_raw));
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Native Adaptors                                                                                                    //
+// Completers                                                                                                         //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static error_code error_code_from_raw(int raw)
+static std::size_t payload_of(const std::vector<path_view>& paths)
+{
+    std::size_t total = 0U;
+    for (const auto& path : paths)
+        total += path.size();
+    return total;
+}
+
+/// Measures one request for the \c connection_metrics of its connection, from the submission (when the probe is
+/// created) until \c finish is called from the completion, and tells the \c connection_observer (if there is one) about
+/// both ends. A default-constructed probe measures nothing. A completer which is destroyed without having been completed
+/// counts as \c closed, so \c in_flight never drifts and the observer sees a completion for every submission.
+///
+/// The probe also holds the request's share of its \c in_flight_budget. A request which was not \c admitted must not be
+/// sent; the submission functions fail it with \c error_code::throttled instead.
+///
+/// Finally, the probe knows where the result of the request is to be delivered: completers hand the filling of the
+/// promise (or the call of the callback) to \c deliver once the result is decoded.
+class request_probe final
 {
-    switch (raw)
+public:
+    request_probe() = default;
+
+    explicit request_probe(connection_metrics&      metrics,
+                           ptr<connection_observer> observer,
+                           ptr<in_flight_budget>    budget,
+                           ptr<ordered_executor>    deliver_through,
+                           request_type             type,
+                           string_view              path,
+                           std::size_t              payload_size,
+                           std::size_t              count = 1U
+                          ) :
+            _metrics(&metrics),
+            _type(type),
+            _start(std::chrono::steady_clock::now()),
+            _deliver_through(deliver_through),
+            _lane(deliver_through ? deliver_through->lane_for(path) : 0U)
     {
-    case ZOPERATIONTIMEOUT:
-        raw = ZCONNECTIONLOSS;
-        break;
-    case ZINVALIDCALLBACK:
-    case ZINVALIDACL:
-        raw = ZBADARGUMENTS;
-        break;
-    case ZSESSIONMOVED:
-        raw = ZCONNECTIONLOSS;
-        break;
-    default:
-        break;
+        metrics.on_submit(payload_size);
+        if (observer)
+        {
+            // The path is only kept when someone will look at it
+            _path     = std::string(path);
+            _context  = observer->on_submit(type, _path, payload_size);
+            _observer = observer;
+        }
+
+        if (budget)
+        {
+            _admitted = budget->acquire(count);
+            if (_admitted)
+            {
+                _budget       = budget;
+                _budget_count = count;
+            }
+        }
     }
-    return static_cast<error_code>(raw);
-}
 
-static event_type event_from_raw(int raw)
+    request_probe(request_probe&& src) noexcept :
+            _metrics(std::exchange(src._metrics, nullptr)),
+            _type(src._type),
+            _start(src._start),
+            _observer(std::exchange(src._observer, nullptr)),
+            _path(std::move(src._path)),
+            _context(src._context),
+            _budget(std::exchange(src._budget, nullptr)),
+            _budget_count(src._budget_count),
+            _admitted(src._admitted),
+            _deliver_through(src._deliver_through),
+            _lane(src._lane)
+    { }
+
+    request_probe& operator=(request_probe&& src) noexcept
+    {
+        if (this != &src)
+        {
+            finish(error_code::closed);
+            _metrics         = std::exchange(src._metrics, nullptr);
+            _type            = src._type;
+            _start           = src._start;
+            _observer        = std::exchange(src._observer, nullptr);
+            _path            = std::move(src._path);
+            _context         = src._context;
+            _budget          = std::exchange(src._budget, nullptr);
+            _budget_count    = src._budget_count;
+            _admitted        = src._admitted;
+            _deliver_through = src._deliver_through;
+            _lane            = src._lane;
+        }
+        return *this;
+    }
+
+    ~request_probe() noexcept
+    {
+        finish(error_code::closed);
+    }
+
+    void received(std::size_t data_size) noexcept
+    {
+        if (_metrics)
+            _metrics->on_receive(data_size);
+    }
+
+    /// Was the request given room in its budget? If not, it must be failed with \c error_code::throttled.
+    bool admitted() const noexcept
+    {
+        return _admitted;
+    }
+
+    /// Does \c deliver run its argument right away?
+    bool delivers_inline() const noexcept
+    {
+        return !_deliver_through;
+    }
+
+    /// Run \a deliver, which hands the result over to whoever made the request, on the completion executor of the
+    /// connection (in the lane of the request's path) -- or right away, if there is none.
+    template <typename FDeliver>
+    void deliver(FDeliver&& deliver)
+    {
+        if (!_deliver_through)
+        {
+            std::forward<FDeliver>(deliver)();
+        }
+        else
+        {
+            // std::function requires copyable targets and results can be move-only
+            auto pdeliver = make_pooled_shared<std::decay_t<FDeliver>>(std::forward<FDeliver>(deliver));
+            _deliver_through->execute(_lane, [pdeliver] { (*pdeliver)(); });
+        }
+    }
+
+    void finish(error_code rc) noexcept
+    {
+        if (auto budget = std::exchange(_budget, nullptr))
+            budget->release(_budget_count);
+
+        if (auto metrics = std::exchange(_metrics, nullptr))
+        {
+            auto latency = std::chrono::steady_clock::now() - _start;
+            metrics->on_complete(_type, latency, rc);
+            if (auto observer = std::exchange(_observer, nullptr))
+                observer->on_complete(_type, _path, rc, latency, _context);
+        }
+    }
+
+private:
+    ptr<connection_metrics>               _metrics = nullptr;
+    request_type                          _type    = request_type::get;
+    std::chrono::steady_clock::time_point _start;
+    ptr<connection_observer>              _observer = nullptr;
+    std::string                           _path;
+    ptr<void>                             _context  = nullptr;
+    ptr<in_flight_budget>                 _budget       = nullptr;
+    std::size_t                           _budget_count = 0U;
+    bool                                  _admitted     = true;
+    ptr<ordered_executor>                 _deliver_through = nullptr;
+    std::size_t                           _lane            = 0U;
+};
+
+/// A promise whose shared state comes from a \ref completion_pool, when the promise type can be told where to get it.
+template <typename TResult>
+static promise<TResult> pooled_promise()
 {
-    return static_cast<event_type>(raw);
+#if ZKPP_FUTURE_USE_STD
+    return promise<TResult>(std::allocator_arg, completion_allocator<TResult>());
+#else
+    return promise<TResult>();
+#endif
 }
 
-// ZooKeeper does not have this concept pre-3.5
-#if ZOO_MAJOR_VERSION <= 3 && ZOO_MINOR_VERSION <= 4
-static const int ZOO_NOTCONNECTED_STATE = 999;
-#endif
+// The context handed to the C client for every operation is a completer. The raw completion function decodes the
+// native result and passes it on, so the decoding is shared between the two ways of delivering a result: filling a
+// promise (promise_completer) or invoking a user-provided callback (callback_completer). A completer is owned by the C
+// client from a successful submission until the completion function runs, where it is reclaimed with take_completer.
+
+template <typename TResult>
+class promise_completer final :
+        public pooled_completion
+{
+public:
+    promise_completer() = default;
+
+    explicit promise_completer(request_probe probe) :
+            _probe(std::move(probe))
+    { }
+
+    future<TResult> get_future()
+    {
+        return _prom.get_future();
+    }
+
+    request_probe& probe()
+    {
+        return _probe;
+    }
+
+    template <typename... TArgs>
+    void complete(TArgs&&... result)
+    {
+        _probe.finish(error_code::ok);
+        if (_probe.delivers_inline())
+            _prom.set_value(std::forward<TArgs>(result)...);
+        else
+            _probe.deliver([prom = std::move(_prom), res = outcome<TResult>(std::forward<TArgs>(result)...)] () mutable
+                           {
+                               if constexpr (std::is_void<TResult>::value)
+                                   prom.set_value();
+                               else
+                                   prom.set_value(std::move(res).value());
+                           }
+                          );
+    }
+
+    void fail(error_code rc, std::exception_ptr cause = nullptr)
+    {
+        _probe.finish(rc);
+        if (!cause)
+            cause = get_exception_ptr_of(rc);
+
+        if (_probe.delivers_inline())
+            _prom.set_exception(std::move(cause));
+        else
+            _probe.deliver([prom = std::move(_prom), cause = std::move(cause)] () mutable
+                           {
+                               prom.set_exception(std::move(cause));
+                           }
+                          );
+    }
+
+    /// Preparing the request threw before it could be submitted -- the exception goes into the future.
+    void fail_submission(std::exception_ptr ex)
+    {
+        _probe.finish(error_code::marshalling_error);
+        _prom.set_exception(std::move(ex));
+    }
+
+private:
+    request_probe    _probe;
+    promise<TResult> _prom = pooled_promise<TResult>();
+};
 
-static state state_from_raw(int raw)
+template <typename TResult>
+class callback_completer final :
+        public pooled_completion
 {
-    // The C client will put us into `ZOO_NOTCONNECTED_STATE` for two reasons:
-    //
-    // 1. This is the state of the initial connection (zookeeper_init_internal), which is then replaced when the adaptor
-    //    threads first call the interest function.
-    // 2. During a reconfiguration, the client disconnects and transitions to this state (update_addrs), which is then
-    //    updated the next time the I/O thread touches interest.
-    //
-    // In both cases, the state is still "connecting" from the point of view of a client.
-    if (raw == ZOO_NOTCONNECTED_STATE)
+public:
+    explicit callback_completer(callback<TResult> on_complete, request_probe probe = request_probe()) :
+            _probe(std::move(probe)),
+            _on_complete(std::move(on_complete))
+    { }
+
+    request_probe& probe()
+    {
+        return _probe;
+    }
+
+    template <typename... TArgs>
+    void complete(TArgs&&... result)
+    {
+        _probe.finish(error_code::ok);
+        deliver(outcome<TResult>(std::forward<TArgs>(result)...));
+    }
+
+    void fail(error_code rc, std::exception_ptr cause = nullptr)
     {
-        raw = ZOO_CONNECTING_STATE;
+        _probe.finish(rc);
+        deliver(outcome<TResult>(rc, std::move(cause)));
     }
-    // `ZOO_ASSOCIATING_STATE` means we have connected to a server, but have not yet authenticated and created the
-    // session. We still can't perform any operations, so treat it as connecting -- the client does not care about the
-    // difference between establishing a TCP connection and negotiating credentials.
-    else if (raw == ZOO_ASSOCIATING_STATE)
+
+    /// Preparing the request threw before it could be submitted. This only happens on the caller's thread, so the
+    /// exception is simply propagated to them.
+    [[noreturn]]
+    void fail_submission(std::exception_ptr ex)
+    {
+        _probe.finish(error_code::marshalling_error);
+        std::rethrow_exception(std::move(ex));
+    }
+
+private:
+    void deliver(outcome<TResult> result)
     {
-        raw = ZOO_CONNECTING_STATE;
+        if (_probe.delivers_inline())
+            _on_complete(std::move(result));
+        else
+            _probe.deliver([on_complete = std::move(_on_complete), result = std::move(result)] () mutable
+                           {
+                               on_complete(std::move(result));
+                           }
+                          );
     }
 
-    return static_cast<state>(raw);
+private:
+    request_probe     _probe;
+    callback<TResult> _on_complete;
+};
+
+template <typename TCompleter>
+static std::unique_ptr<TCompleter> take_completer(ptr<const void> completer_in)
+{
+    // Only the C client hands completers back, and only on the threads it delivers completions on
+    completion_thread_scope::mark_forever();
+    return std::unique_ptr<TCompleter>(static_cast<ptr<TCompleter>>(const_cast<ptr<void>>(completer_in)));
 }
 
-static stat stat_from_raw(const struct Stat& raw)
+/// Call \a submit_raw with the address of \a completer as the operation's context. If the C client accepted the
+/// operation, it now owns the completer; otherwise the completer is failed with the code it was rejected with.
+///
+/// \returns Whether the operation was sent.
+template <typename TCompleter, typename FSubmit>
+static bool submit(std::unique_ptr<TCompleter> completer, FSubmit&& submit_raw)
 {
-    stat out;
-    out.acl_version = acl_version(raw.aversion);
-    out.child_modified_transaction = transaction_id(raw.pzxid);
-    out.child_version = child_version(raw.cversion);
-    out.children_count = raw.numChildren;
-    out.create_time = stat::time_point() + std::chrono::milliseconds(raw.ctime);
-    out.create_transaction = transaction_id(raw.czxid);
-    out.data_size = raw.dataLength;
-    out.data_version = version(raw.version);
-    out.ephemeral_owner = raw.ephemeralOwner;
-    out.modified_time = stat::time_point() + std::chrono::milliseconds(raw.mtime);
-    out.modified_transaction = transaction_id(raw.mzxid);
-    return out;
+    if (!completer->probe().admitted())
+    {
+        completer->fail(error_code::throttled);
+        return false;
+    }
+
+    auto rc = error_code_from_raw(std::forward<FSubmit>(submit_raw)(static_cast<ptr<void>>(completer.get())));
+    if (rc == error_code::ok)
+        completer.release();
+    else
+        completer->fail(rc);
+    return rc == error_code::ok;
 }
 
-static std::vector<std::string> string_vector_from_raw(const struct String_vector& raw)
+/// Run \a operation with a \c promise_completer measured by \a probe and get the future attached to it.
+template <typename TResult, typename FOperation>
+static future<TResult> with_future(request_probe probe, FOperation&& operation)
 {
-    std::vector<std::string> out;
-    out.reserve(raw.count);
-    for (std::int32_t idx = 0; idx < raw.count; ++idx)
-        out.emplace_back(raw.data[idx]);
-    return out;
+    auto completer = std::make_unique<promise_completer<TResult>>(std::move(probe));
+    auto fut       = completer->get_future();
+    std::forward<FOperation>(operation)(std::move(completer));
+    return fut;
+}
+
+template <typename TResult>
+static std::unique_ptr<callback_completer<TResult>> with_callback(callback<TResult> on_complete, request_probe probe)
+{
+    return std::make_unique<callback_completer<TResult>>(std::move(on_complete), std::move(probe));
 }
 
-static acl acl_from_raw(const struct ACL_vector& raw)
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Batches                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The reads of a batch are submitted back to back, so they are all in flight on the session at once. Instead of one
+// completer per read, each read gets the address of its slot in the batch as its context. The batch is freed by
+// whichever read completes last, which is also the one that delivers the results to the inner completer.
+
+template <typename TCompleter, typename TResult>
+class batch_completer final :
+        public pooled_completion
 {
-    auto sz = std::size_t(raw.count);
+public:
+    struct slot
+    {
+        ptr<batch_completer> owner;
+        std::size_t          index;
+    };
+
+public:
+    explicit batch_completer(std::unique_ptr<TCompleter>  inner,
+                             std::size_t                  count,
+                             std::shared_ptr<buffer_pool> read_buffer_pool = nullptr
+                            ) :
+            _inner(std::move(inner)),
+            _remaining(count + 1U),
+            _slots(count),
+            _read_buffer_pool(std::move(read_buffer_pool))
+    {
+        _results.reserve(count);
+        for (std::size_t idx = 0U; idx < count; ++idx)
+        {
+            _results.emplace_back(error_code::closed);
+            _slots[idx] = slot{ this, idx };
+        }
+    }
 
-    acl out;
-    out.reserve(sz);
-    for (std::size_t idx = 0; idx < sz; ++idx)
+    static slot& slot_from(ptr<const void> slot_in)
     {
-        const auto& item = raw.data[idx];
-        out.emplace_back(item.id.scheme, item.id.id, static_cast<permission>(item.perms));
+        completion_thread_scope::mark_forever();
+        return *static_cast<ptr<slot>>(const_cast<ptr<void>>(slot_in));
     }
-    return out;
+
+    ptr<void> context(std::size_t index)
+    {
+        return &_slots[index];
+    }
+
+    const std::shared_ptr<buffer_pool>& read_buffer_pool() const
+    {
+        return _read_buffer_pool;
+    }
+
+    TCompleter& inner()
+    {
+        return *_inner;
+    }
+
+    void complete(std::size_t index, outcome<TResult> result)
+    {
+        _results[index] = std::move(result);
+        finish_one();
+    }
+
+    /// Release one hold on the batch. There is one hold per read and one for the submitting thread, so the batch can
+    /// not be delivered (and freed) while the reads are still being submitted.
+    void finish_one()
+    {
+        if (_remaining.fetch_sub(1U, std::memory_order_acq_rel) == 1U)
+        {
+            _inner->complete(std::move(_results));
+            delete this;
+        }
+    }
+
+private:
+    std::unique_ptr<TCompleter>   _inner;
+    std::atomic<std::size_t>      _remaining;
+    std::vector<outcome<TResult>> _results;
+    std::vector<slot>             _slots;
+    std::shared_ptr<buffer_pool>  _read_buffer_pool;
+};
+
+/// Submit a read of every one of \a paths with \a submit_raw, which is called with the terminated path and the
+/// context for that read and returns the raw code of the submission.
+template <typename TBatch, typename FSubmit>
+static void submit_batch(const std::vector<path_view>& paths, std::unique_ptr<TBatch> batch_in, FSubmit&& submit_raw)
+{
+    if (!batch_in->inner().probe().admitted())
+        return batch_in->inner().fail(error_code::throttled);
+
+    auto batch = batch_in.release();
+    for (std::size_t idx = 0U; idx < paths.size(); ++idx)
+    {
+        auto rc = with_str(paths[idx], [&] (ptr<const char> path) noexcept
+                                       {
+                                           return error_code_from_raw(submit_raw(path, batch->context(idx)));
+                                       }
+                          );
+        if (rc != error_code::ok)
+            batch->complete(idx, rc);
+    }
+    batch->finish_one();
+}
+
+template <typename TCompleter>
+static void get_many_impl(ptr<zhandle_t>                      handle,
+                          const std::vector<path_view>&       paths,
+                          const std::shared_ptr<buffer_pool>& read_buffer_pool,
+                          std::unique_ptr<TCompleter>         completer
+                         )
+{
+    using batch_type = batch_completer<TCompleter, get_result>;
+
+    ::data_completion_t on_complete =
+        [] (int rc_in, ptr<const char> data, int data_sz, ptr<const struct Stat> pstat, ptr<const void> slot_in)
+            noexcept
+        {
+            auto& slot = batch_type::slot_from(slot_in);
+            auto  rc   = error_code_from_raw(rc_in);
+            if (rc == error_code::ok)
+            {
+                slot.owner->inner().probe().received(std::size_t(data_sz));
+                slot.owner->complete(slot.index,
+                                     get_result_from_raw(data, data_sz, *pstat, slot.owner->read_buffer_pool())
+                                    );
+            }
+            else
+                slot.owner->complete(slot.index, rc);
+        };
+
+    submit_batch(paths,
+                 std::make_unique<batch_type>(std::move(completer), paths.size(), read_buffer_pool),
+                 [&] (ptr<const char> path, ptr<void> ctx) { return ::zoo_aget(handle, path, 0, on_complete, ctx); }
+                );
+}
+
+template <typename TCompleter>
+static void get_children_many_impl(ptr<zhandle_t>                handle,
+                                   const std::vector<path_view>& paths,
+                                   std::unique_ptr<TCompleter>   completer
+                                  )
+{
+    using batch_type = batch_completer<TCompleter, get_children_result>;
+
+    ::strings_stat_completion_t on_complete =
+        [] (int                             rc_in,
+            ptr<const struct String_vector> strings_in,
+            ptr<const struct Stat>          stat_in,
+            ptr<const void>                 slot_in
+           ) noexcept
+        {
+            auto& slot = batch_type::slot_from(slot_in);
+            auto  rc   = error_code_from_raw(rc_in);
+            if (rc == error_code::ok)
+                slot.owner->complete(slot.index,
+                                     get_children_result(string_vector_from_raw(*strings_in), stat_from_raw(*stat_in))
+                                    );
+            else
+                slot.owner->complete(slot.index, rc);
+        };
+
+    submit_batch(paths,
+                 std::make_unique<batch_type>(std::move(completer), paths.size()),
+                 [&] (ptr<const char> path, ptr<void> ctx)
+                 {
+                     return ::zoo_aget_children2(handle, path, 0, on_complete, ctx);
+                 }
+                );
+}
+
+template <typename TCompleter>
+static void exists_many_impl(ptr<zhandle_t>                handle,
+                             const std::vector<path_view>& paths,
+                             std::unique_ptr<TCompleter>   completer
+                            )
+{
+    using batch_type = batch_completer<TCompleter, exists_result>;
+
+    ::stat_completion_t on_complete =
+        [] (int rc_in, ptr<const struct Stat> stat_in, ptr<const void> slot_in) noexcept
+        {
+            auto& slot = batch_type::slot_from(slot_in);
+            auto  rc   = error_code_from_raw(rc_in);
+            if (rc == error_code::ok)
+                slot.owner->complete(slot.index, exists_result(stat_from_raw(*stat_in)));
+            else if (rc == error_code::no_entry)
+                slot.owner->complete(slot.index, exists_result(nullopt));
+            else
+                slot.owner->complete(slot.index, rc);
+        };
+
+    submit_batch(paths,
+                 std::make_unique<batch_type>(std::move(completer), paths.size()),
+                 [&] (ptr<const char> path, ptr<void> ctx) { return ::zoo_aexists(handle, path, 0, on_complete, ctx); }
+                );
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // connection_zk                                                                                                      //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static std::unique_ptr<in_flight_budget> make_budget(std::size_t limit, admission_policy when_full)
+{
+    if (limit == 0U)
+        return nullptr;
+    else
+        return std::make_unique<in_flight_budget>(limit, when_full);
+}
+
+static bool is_write(request_type type)
+{
+    switch (type)
+    {
+    case request_type::create:
+    case request_type::set:
+    case request_type::erase:
+    case request_type::set_acl:
+    case request_type::commit:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Left to itself, the C client shuffles the hosts it is given, and whether it does is a setting of the whole library.
+/// The hosts of every connection are put in order by its \ref host_selector, which shuffles them itself when
+/// \c randomize_hosts asks for it, so the first connection turns the C client's shuffling off for the whole process,
+/// once and for good.
+static void take_over_host_order()
+{
+    static const bool taken = [] { ::zoo_deterministic_conn_order(1); return true; }();
+    static_cast<void>(taken);
+}
+
 connection_zk::connection_zk(const connection_params& params) :
-        _handle(nullptr)
+        _read_budget(make_budget(params.max_reads_in_flight(), params.when_full())),
+        _write_budget(make_budget(params.max_writes_in_flight(), params.when_full())),
+        _handle(nullptr),
+        _read_buffer_pool(params.read_buffer_pool()),
+        _observer(params.observer()),
+        _selector(host_selector::create(params)),
+        _completions(params.completion_executor() ? ordered_executor::create(params.completion_executor()) : nullptr),
+        _next_watch_key(1U)
 {
     if (params.connection_schema() != "zk")
         throw std::invalid_argument(std::string("Invalid connection string \"") + to_string(params) + "\"");
 
+    take_over_host_order();
+    auto hosts = params.hosts();
+    _selector->order(hosts);
+
     auto conn_string = [&] ()
                        {
                            std::ostringstream os;
                            bool first = true;
-                           for (const auto& host : params.hosts())
+                           for (const auto& host : hosts)
                            {
                                if (first)
                                    first = false;
@@ -186,12 +681,24 @@ connection_zk::connection_zk(const connection_params& params) :
                            return os.str();
                        }();
 
+    ::clientid_t resume{};
+    if (const auto& creds = params.resume_session())
+    {
+        if (creds->password.size() != sizeof resume.passwd)
+            throw std::invalid_argument("A session password is " + std::to_string(sizeof resume.passwd) + " bytes, not "
+                                        + std::to_string(creds->password.size())
+                                       );
+
+        resume.client_id = creds->id;
+        std::memcpy(resume.passwd, creds->password.data(), sizeof resume.passwd);
+    }
+
     _handle = ::zookeeper_init(conn_string.c_str(),
                                on_session_event_raw,
                                static_cast<int>(params.timeout().count()),
-                               nullptr,
+                               params.resume_session() ? &resume : nullptr,
                                this,
-                               0
+                               params.read_only() ? ZOO_READONLY : 0
                               );
 
     if (!_handle)
@@ -203,20 +710,46 @@ connection_zk::~connection_zk() noexcept
     close();
 }
 
-class connection_zk::watcher
+request_probe connection_zk::probe_for(request_type type,
+                                       string_view  path,
+                                       std::size_t  payload_size,
+                                       std::size_t  count
+                                      ) const
+{
+    auto budget = is_write(type) ? _write_budget.get() : _read_budget.get();
+    return request_probe(_metrics, _observer.get(), budget, _completions.get(), type, path, payload_size, count);
+}
+
+class connection_zk::watcher :
+        public std::enable_shared_from_this<connection_zk::watcher>
 {
 public:
-    watcher() :
-            _event_delivered(false)
+    explicit watcher(event_callback on_event = nullptr) :
+            _event_delivered(false),
+            _on_event(std::move(on_event))
     { }
 
     virtual ~watcher() noexcept {}
 
+    /// Fail the initial data of the watch with \a rc, unless it was already delivered.
+    ///
+    /// \returns \c true if the data was failed by this call; after that, the watch can be forgotten.
+    virtual bool abandon(error_code rc) = 0;
+
+    /// Get \a handler called if \a cancel is cancelled before the initial data is delivered.
+    void abandon_on(const cancellation_token& cancel, std::function<void ()> handler)
+    {
+        _cancel              = cancel;
+        _cancel_registration = cancel.on_cancel(std::move(handler));
+    }
+
     virtual void deliver_event(event ev)
     {
         if (!_event_delivered.exchange(true, std::memory_order_relaxed))
         {
-            _event_promise.set_value(std::move(ev));
+            _event_promise.set_value(ev);
+            if (_on_event)
+                _on_event(std::move(ev));
         }
     }
 
@@ -226,19 +759,41 @@ public:
     }
 
 protected:
-    std::atomic<bool> _event_delivered;
-    promise<event>    _event_promise;
+    /// Called once the initial data has been delivered, so the cancellation handler no longer refers to this watch.
+    void forget_cancellation()
+    {
+        _cancel.forget(_cancel_registration);
+    }
+
+protected:
+    std::atomic<bool>                _event_delivered;
+    promise<event>                   _event_promise = pooled_promise<event>();
+    event_callback                   _on_event;
+    cancellation_token               _cancel;
+    cancellation_token::registration _cancel_registration = 0U;
 };
 
+/// The initial data of a watch is delivered to \c _on_data if one was provided; otherwise, it goes to the promise
+/// behind \c get_data_future. Both the data and the event are handed over through the \c request_probe, so when the
+/// connection has a completion executor they reach it in that order.
 template <typename TResult>
 class connection_zk::basic_watcher :
         public connection_zk::watcher
 {
+public:
+    using result_type = TResult;
+
 public:
     basic_watcher() :
             _data_delivered(false)
     { }
 
+    explicit basic_watcher(callback<TResult> on_data, event_callback on_event = nullptr) :
+            watcher(std::move(on_event)),
+            _data_delivered(false),
+            _on_data(std::move(on_data))
+    { }
+
     future<TResult> get_data_future()
     {
         return _data_promise.get_future();
@@ -248,57 +803,384 @@ public:
     {
         if (!_data_delivered.load(std::memory_order_relaxed))
         {
-            deliver_data(nullopt, get_exception_ptr_of(error_code::closed));
+            deliver_error(error_code::closed);
         }
 
-        watcher::deliver_event(std::move(ev));
+        post([ev] (basic_watcher& self) mutable { self.watcher::deliver_event(std::move(ev)); });
     }
 
-    void deliver_data(optional<TResult> data, std::exception_ptr ex_ptr)
+    /// The measurement of the request which sets the watch. It finishes when the initial data is delivered.
+    request_probe& probe()
+    {
+        return _probe;
+    }
+
+    void deliver_data(TResult data)
     {
         if (!_data_delivered.exchange(true, std::memory_order_relaxed))
         {
-            if (ex_ptr)
-            {
-                _data_promise.set_exception(std::move(ex_ptr));
-            }
-            else
-            {
-                _data_promise.set_value(std::move(*data));
-            }
+            forget_cancellation();
+            _probe.finish(error_code::ok);
+            post([data = std::move(data)] (basic_watcher& self) mutable { self.hand_over(std::move(data)); });
         }
     }
 
-private:
-    std::atomic<bool> _data_delivered;
-    promise<TResult>  _data_promise;
-};
+    void deliver_error(error_code rc)
+    {
+        abandon(rc);
+    }
 
-std::shared_ptr<connection_zk::watcher> connection_zk::try_extract_watch(ptr<const void> addr)
-{
-    std::unique_lock<std::mutex> ax(_watches_protect);
-    auto iter = _watches.find(addr);
-    if (iter != _watches.end())
-        return _watches.extract(iter).mapped();
-    else
-        return nullptr;
-}
+    virtual bool abandon(error_code rc) override
+    {
+        if (_data_delivered.exchange(true, std::memory_order_relaxed))
+            return false;
 
-static ptr<connection_zk> connection_from_context(ptr<zhandle_t> zh)
-{
+        forget_cancellation();
+        _probe.finish(rc);
+        post([rc] (basic_watcher& self) { self.hand_over(rc); });
+        return true;
+    }
+
+private:
+    /// Run \a deliver with this watcher where the probe says results go. When that is not right here, the watcher is
+    /// kept alive until \a deliver has run.
+    template <typename FDeliver>
+    void post(FDeliver&& deliver)
+    {
+        if (_probe.delivers_inline())
+        {
+            deliver(*this);
+        }
+        else
+        {
+            auto self = std::static_pointer_cast<basic_watcher>(shared_from_this());
+            _probe.deliver([self, deliver = std::forward<FDeliver>(deliver)] () mutable { deliver(*self); });
+        }
+    }
+
+    void hand_over(outcome<TResult> result)
+    {
+        if (_on_data)
+            _on_data(std::move(result));
+        else if (result)
+            _data_promise.set_value(std::move(result).value());
+        else
+            _data_promise.set_exception(result.error());
+    }
+
+private:
+    std::atomic<bool> _data_delivered;
+    callback<TResult> _on_data;
+    promise<TResult>  _data_promise = pooled_promise<TResult>();
+    request_probe     _probe;
+};
+
+connection_zk::watch_shard& connection_zk::watch_shard_for(watch_key key)
+{
+    return _watch_shards[key % watch_shard_count];
+}
+
+connection_zk::watch_key connection_zk::register_watch(std::shared_ptr<watcher> p)
+{
+    auto  key   = _next_watch_key.fetch_add(1U, std::memory_order_relaxed);
+    auto& shard = watch_shard_for(key);
+    std::unique_lock<std::mutex> ax(shard.protect);
+    if (shard.spare_nodes.empty())
+    {
+        shard.watches.emplace(key, std::move(p));
+    }
+    else
+    {
+        auto node = std::move(shard.spare_nodes.back());
+        shard.spare_nodes.pop_back();
+        node.key()    = key;
+        node.mapped() = std::move(p);
+        shard.watches.insert(std::move(node));
+    }
+    return key;
+}
+
+std::shared_ptr<connection_zk::watcher> connection_zk::try_extract_watch(watch_key key)
+{
+    auto& shard = watch_shard_for(key);
+    std::unique_lock<std::mutex> ax(shard.protect);
+    auto iter = shard.watches.find(key);
+    if (iter == shard.watches.end())
+        return nullptr;
+
+    auto node = shard.watches.extract(iter);
+    auto out  = std::move(node.mapped());
+    if (shard.spare_nodes.size() < watch_shard::max_spare_nodes)
+        shard.spare_nodes.emplace_back(std::move(node));
+    return out;
+}
+
+class connection_zk::watch_group_base
+{
+public:
+    virtual ~watch_group_base() noexcept {}
+};
+
+/// The watches of one kind on one path which share a single watch with the ZooKeeper client. The watchers which join
+/// before the initial data arrives get it when it does; the ones which join later get a copy of it, which is still
+/// current since the watch has not triggered. Either way, they all get the event of the shared watch.
+template <typename TWatcher>
+class connection_zk::watch_group final :
+        public connection_zk::watch_group_base,
+        public std::enable_shared_from_this<connection_zk::watch_group<TWatcher>>
+{
+public:
+    using result_type  = typename TWatcher::result_type;
+    using initial_type = std::decay_t<decltype(std::declval<const result_type&>().initial())>;
+
+public:
+    explicit watch_group(connection_zk& owner, std::string key) :
+            _owner(&owner),
+            _key(std::move(key))
+    { }
+
+    const std::string& key() const { return _key; }
+
+    void join(std::shared_ptr<TWatcher> watcher)
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        if (!_initial && _failure == error_code::ok)
+        {
+            _watchers.emplace_back(std::move(watcher));
+            return;
+        }
+
+        // The rest of the group already has its data, so this one is caught up in the lane its events go through
+        auto initial = _initial;
+        auto rc      = _failure;
+        ax.unlock();
+        post([self = this->shared_from_this(), watcher = std::move(watcher), initial = std::move(initial), rc] ()
+             {
+                 if (rc != error_code::ok)
+                     return watcher->deliver_error(rc);
+
+                 watcher->deliver_data(result_type(*initial, watcher->get_event_future()));
+                 std::unique_lock<std::mutex> ax(self->_protect);
+                 if (self->_event)
+                 {
+                     auto ev = *self->_event;
+                     ax.unlock();
+                     watcher->deliver_event(std::move(ev));
+                 }
+                 else
+                 {
+                     self->_watchers.emplace_back(watcher);
+                 }
+             }
+            );
+    }
+
+    /// The initial data of the shared watch arrived (or it could not be set).
+    void deliver_data(outcome<result_type> result)
+    {
+        if (!result)
+        {
+            _owner->forget_watch_group(_key, this);
+            std::unique_lock<std::mutex> ax(_protect);
+            _failure      = result.code();
+            auto watchers = std::move(_watchers);
+            _watchers.clear();
+            ax.unlock();
+
+            for (const auto& watcher : watchers)
+                watcher->deliver_error(result.code());
+            return;
+        }
+
+        std::unique_lock<std::mutex> ax(_protect);
+        _initial      = std::move(result).value().initial();
+        auto watchers = _watchers;
+        ax.unlock();
+
+        // The event of the shared watch is delivered after this returns, so every watcher gets its data first
+        for (const auto& watcher : watchers)
+            watcher->deliver_data(result_type(*_initial, watcher->get_event_future()));
+    }
+
+    void deliver_event(event ev)
+    {
+        _owner->forget_watch_group(_key, this);
+        std::unique_lock<std::mutex> ax(_protect);
+        _event        = ev;
+        auto watchers = std::move(_watchers);
+        _watchers.clear();
+        ax.unlock();
+
+        for (const auto& watcher : watchers)
+            watcher->deliver_event(ev);
+    }
+
+private:
+    /// Run \a task in the lane of the completion executor the events of this path go through, if there is one.
+    template <typename FTask>
+    void post(FTask&& task)
+    {
+        if (auto completions = _owner->_completions.get())
+            completions->execute(completions->lane_for(string_view(_key).substr(1U)), std::forward<FTask>(task));
+        else
+            std::forward<FTask>(task)();
+    }
+
+private:
+    ptr<connection_zk>                     _owner;
+    std::string                            _key;
+    std::mutex                             _protect;
+    std::vector<std::shared_ptr<TWatcher>> _watchers;
+    optional<initial_type>                 _initial;
+    error_code                             _failure = error_code::ok;
+    optional<event>                        _event;
+};
+
+template <typename TWatcher, typename FSubmit>
+void connection_zk::coalesce_watch(char kind, path_view path, std::shared_ptr<TWatcher> watcher, FSubmit&& submit)
+{
+    using result_type = typename TWatcher::result_type;
+
+    std::string key;
+    key.reserve(path.size() + 1U);
+    key.push_back(kind);
+    key.append(path.data(), path.size());
+
+    std::unique_lock<std::mutex> ax(_watch_groups_protect);
+    auto iter = _watch_groups.find(key);
+    if (iter != _watch_groups.end())
+    {
+        auto group = std::static_pointer_cast<watch_group<TWatcher>>(iter->second);
+        ax.unlock();
+        _metrics.on_watch_coalesced();
+        return group->join(std::move(watcher));
+    }
+
+    auto group = make_pooled_shared<watch_group<TWatcher>>(*this, std::move(key));
+    _watch_groups.emplace(group->key(), group);
+    ax.unlock();
+
+    group->join(std::move(watcher));
+    std::forward<FSubmit>(submit)([group] (outcome<result_type> result) { group->deliver_data(std::move(result)); },
+                                  [group] (event ev) { group->deliver_event(std::move(ev)); }
+                                 );
+}
+
+void connection_zk::forget_watch_group(const std::string& key, ptr<const watch_group_base> group)
+{
+    std::unique_lock<std::mutex> ax(_watch_groups_protect);
+    auto iter = _watch_groups.find(key);
+    if (iter != _watch_groups.end() && iter->second.get() == group)
+        _watch_groups.erase(iter);
+}
+
+static ptr<connection_zk> connection_from_context(ptr<zhandle_t> zh)
+{
     return (ptr<connection_zk>) zoo_get_context(zh);
 }
 
 void connection_zk::deliver_watch(ptr<zhandle_t>  zh,
                                   int             type_in,
                                   int             state_in,
-                                  ptr<const char> path     [[gnu::unused]],
+                                  ptr<const char> path,
                                   ptr<void>       proms_in
                                  )
 {
+    completion_thread_scope::mark_forever();
     auto& self = *connection_from_context(zh);
-    if (auto watcher = self.try_extract_watch(proms_in))
-        watcher->deliver_event(event(event_from_raw(type_in), state_from_raw(state_in)));
+    if (auto watcher = self.try_extract_watch(reinterpret_cast<watch_key>(proms_in)))
+    {
+        self._metrics.on_watch_fired();
+        watcher->deliver_event(event(event_from_raw(type_in), state_from_raw(state_in), path ? path : ""));
+    }
+}
+
+void connection_zk::deliver_routed_watch(ptr<zhandle_t>  zh,
+                                         int             type_in,
+                                         int             state_in,
+                                         ptr<const char> path,
+                                         ptr<void>
+                                        )
+{
+    completion_thread_scope::mark_forever();
+    auto& self = *connection_from_context(zh);
+    self._metrics.on_watch_fired();
+    event ev(event_from_raw(type_in), state_from_raw(state_in), path ? path : "");
+
+    if (self._completions)
+    {
+        auto lane = self._completions->lane_for(ev.path());
+        self._completions->execute(lane,
+                                   [&self, ev = std::move(ev)]
+                                   {
+                                       self.dispatcher().dispatch(ev);
+                                   }
+                                  );
+    }
+    else
+    {
+        self.dispatcher().dispatch(ev);
+    }
+}
+
+/// The context of the read which sets a watch. It keeps the watcher alive until that read completes, as the watch
+/// itself can be forgotten before then.
+template <typename TWatcher>
+struct watch_data_context final :
+        pooled_completion
+{
+    explicit watch_data_context(std::shared_ptr<TWatcher> watcher) :
+            watcher(std::move(watcher))
+    { }
+
+    std::shared_ptr<TWatcher> watcher;
+};
+
+template <typename TWatcher, typename FSubmit>
+void connection_zk::set_watch(request_type              type,
+                              path_view                 path,
+                              std::shared_ptr<TWatcher> watcher,
+                              const cancellation_token& cancel,
+                              FSubmit&&                 submit
+                             )
+{
+    if (cancel.cancelled())
+        return watcher->deliver_error(error_code::operation_timeout);
+
+    watcher->probe() = probe_for(type, path, path.size());
+    if (!watcher->probe().admitted())
+        return watcher->deliver_error(error_code::throttled);
+
+    auto key = register_watch(watcher);
+    if (cancel.can_cancel())
+    {
+        // The watch is forgotten here, but the ZooKeeper client still holds its key: if it ever triggers, the key is
+        // not found and the event is dropped
+        watcher->abandon_on(cancel,
+                            [this, key, target = std::weak_ptr<TWatcher>(watcher)]
+                            {
+                                if (auto watcher = target.lock())
+                                    if (watcher->abandon(error_code::operation_timeout))
+                                        try_extract_watch(key);
+                            }
+                           );
+    }
+
+    auto data_context = std::make_unique<watch_data_context<TWatcher>>(watcher);
+    with_str(path, [&] (ptr<const char> path) noexcept
+    {
+        auto rc = error_code_from_raw(submit(path, reinterpret_cast<ptr<void>>(key), data_context.get()));
+        if (rc == error_code::ok)
+        {
+            data_context.release();
+            _metrics.on_watch_set();
+        }
+        else
+        {
+            try_extract_watch(key);
+            watcher->deliver_error(rc);
+        }
+    });
 }
 
 void connection_zk::close()
@@ -310,10 +1192,54 @@ void connection_zk::close()
             throw_error(err);
 
         _handle = nullptr;
+        close_watches();
+    }
+}
 
-        // Deliver a session event as if there was a close.
-        std::unique_lock<std::mutex> ax(_watches_protect);
-        auto l_watches = std::move(_watches);
+/// The most handles \ref connection_zk::close_async closes at once; any more wait for one of those to finish.
+static constexpr std::size_t max_concurrent_closes = 8U;
+
+/// The threads every \ref connection_zk::close_async hands its handle to. Closing a handle blocks until the server has
+/// heard of it, so closes run side by side (closing a pool takes about one round trip, not one per session), but on a
+/// fixed number of threads instead of each taking a thread of its own.
+static const std::shared_ptr<executor>& handle_closer()
+{
+    static const auto instance = thread_pool_executor(max_concurrent_closes);
+    return instance;
+}
+
+void connection_zk::close_async(callback<void> on_closed)
+{
+    auto self = weak_from_this().lock();
+    if (!self)
+        return connection::close_async(std::move(on_closed));
+
+    auto handle = std::exchange(_handle, nullptr);
+    if (!handle)
+        return on_closed(outcome<void>());
+
+    // Nothing more can be asked of the handle, so the watches are over already
+    close_watches();
+
+    handle_closer()->execute([self = std::move(self), handle, on_closed = std::move(on_closed)]
+                             {
+                                 auto err = error_code_from_raw(::zookeeper_close(handle));
+                                 if (err == error_code::ok)
+                                     on_closed(outcome<void>());
+                                 else
+                                     on_closed(outcome<void>(err));
+                             }
+                            );
+}
+
+void connection_zk::close_watches()
+{
+    // Deliver a session event as if there was a close.
+    for (auto& shard : _watch_shards)
+    {
+        std::unique_lock<std::mutex> ax(shard.protect);
+        auto l_watches = std::move(shard.watches);
+        shard.watches.clear();
         ax.unlock();
         for (const auto& pair : l_watches)
             pair.second->deliver_event(event(event_type::session, zk::state::closed));
@@ -328,41 +1254,227 @@ zk::state connection_zk::state() const
         return zk::state::closed;
 }
 
-future<get_result> connection_zk::get(string_view path)
+metrics_snapshot connection_zk::metrics() const
+{
+    return _metrics.snapshot();
+}
+
+/// Completions which need more context than just where to deliver the result wrap the delivering completer.
+template <typename TCompleter, typename TContext>
+struct contextual_completer final :
+        pooled_completion
+{
+    TCompleter inner;
+    TContext   context;
+
+    template <typename... TArgs>
+    explicit contextual_completer(TContext context, TArgs&&... inner_args) :
+            inner(std::forward<TArgs>(inner_args)...),
+            context(std::move(context))
+    { }
+
+    request_probe& probe()
+    {
+        return inner.probe();
+    }
+
+    void fail(error_code rc)
+    {
+        inner.fail(rc);
+    }
+};
+
+template <typename TCompleter>
+using get_completer = contextual_completer<TCompleter, std::shared_ptr<buffer_pool>>;
+
+/// \param watch_fn When set, a watch is left on the entry with this watcher and no context.
+///
+/// \returns Whether the read was sent, which is when the watch counts as set.
+template <typename TCompleter>
+static bool get_impl(ptr<zhandle_t>                             handle,
+                     path_view                                  path,
+                     std::unique_ptr<get_completer<TCompleter>> completer,
+                     ::watcher_fn                               watch_fn = nullptr
+                    )
 {
-    ::data_completion_t callback =
-        [] (int rc_in, ptr<const char> data, int data_sz, ptr<const struct Stat> pstat, ptr<const void> prom_in) noexcept
+    ::data_completion_t on_complete =
+        [] (int rc_in, ptr<const char> data, int data_sz, ptr<const struct Stat> pstat, ptr<const void> completer_in)
+            noexcept
         {
-            std::unique_ptr<promise<get_result>> prom((ptr<promise<get_result>>) prom_in);
-            auto rc = error_code_from_raw(rc_in);
+            auto completer = take_completer<get_completer<TCompleter>>(completer_in);
+            auto rc        = error_code_from_raw(rc_in);
             if (rc == error_code::ok)
-                prom->set_value(get_result(buffer(data, data + data_sz), stat_from_raw(*pstat)));
+            {
+                completer->inner.probe().received(std::size_t(data_sz));
+                completer->inner.complete(get_result_from_raw(data, data_sz, *pstat, completer->context));
+            }
             else
-                prom->set_exception(get_exception_ptr_of(rc));
+                completer->fail(rc);
         };
 
     return with_str(path, [&] (ptr<const char> path) noexcept
     {
-        auto ppromise = std::make_unique<promise<get_result>>();
-        auto fut      = ppromise->get_future();
-        auto rc = error_code_from_raw(::zoo_aget(_handle, path, 0, callback, ppromise.get()));
-        if (rc == error_code::ok)
-        {
-            ppromise.release();
-            return fut;
-        }
-        else
+        return submit(std::move(completer),
+                      [&] (ptr<void> ctx)
+                      {
+                          return watch_fn ? ::zoo_awget(handle, path, watch_fn, nullptr, on_complete, ctx)
+                                          : ::zoo_aget(handle, path, 0, on_complete, ctx);
+                      }
+                     );
+    });
+}
+
+future<get_result> connection_zk::get(path_view path)
+{
+    using completer_type = get_completer<promise_completer<get_result>>;
+    auto probe = probe_for(request_type::get, path, path.size());
+    auto completer = std::make_unique<completer_type>(_read_buffer_pool, std::move(probe));
+    auto fut       = completer->inner.get_future();
+    get_impl(_handle, path, std::move(completer));
+    return fut;
+}
+
+void connection_zk::get(path_view path, callback<get_result> on_complete)
+{
+    using completer_type = get_completer<callback_completer<get_result>>;
+    auto probe = probe_for(request_type::get, path, path.size());
+    get_impl(_handle,
+             path,
+             std::make_unique<completer_type>(_read_buffer_pool, std::move(on_complete), std::move(probe))
+            );
+}
+
+template <typename TCompleter>
+using get_into_completer = contextual_completer<TCompleter, ptr<buffer>>;
+
+template <typename TCompleter>
+static void get_into_impl(ptr<zhandle_t>                                  handle,
+                          path_view                                       path,
+                          std::unique_ptr<get_into_completer<TCompleter>> completer
+                         )
+{
+    ::data_completion_t on_complete =
+        [] (int rc_in, ptr<const char> data, int data_sz, ptr<const struct Stat> pstat, ptr<const void> completer_in)
+            noexcept
         {
-            ppromise->set_exception(get_exception_ptr_of(rc));
-            return fut;
-        }
+            auto completer = take_completer<get_into_completer<TCompleter>>(completer_in);
+            auto rc        = error_code_from_raw(rc_in);
+            if (rc == error_code::ok)
+            {
+                completer->inner.probe().received(std::size_t(data_sz));
+                buffer_assign(*completer->context, data, data + data_sz);
+                completer->inner.complete(stat_from_raw(*pstat));
+            }
+            else
+            {
+                completer->fail(rc);
+            }
+        };
+
+    with_str(path, [&] (ptr<const char> path) noexcept
+    {
+        submit(std::move(completer), [&] (ptr<void> ctx) { return ::zoo_aget(handle, path, 0, on_complete, ctx); });
     });
 }
 
+future<zk::stat> connection_zk::get_into(path_view path, buffer& target)
+{
+    auto probe = probe_for(request_type::get, path, path.size());
+    auto completer = std::make_unique<get_into_completer<promise_completer<zk::stat>>>(&target, std::move(probe));
+    auto fut       = completer->inner.get_future();
+    get_into_impl(_handle, path, std::move(completer));
+    return fut;
+}
+
+void connection_zk::get_into(path_view path, buffer& target, callback<zk::stat> on_complete)
+{
+    using completer_type = get_into_completer<callback_completer<zk::stat>>;
+    auto probe = probe_for(request_type::get, path, path.size());
+    get_into_impl(_handle, path, std::make_unique<completer_type>(&target, std::move(on_complete), std::move(probe)));
+}
+
+future<std::vector<outcome<get_result>>> connection_zk::get_many(const std::vector<path_view>& paths)
+{
+    auto probe = probe_for(request_type::get, string_view(), payload_of(paths), paths.size());
+    return with_future<std::vector<outcome<get_result>>>(std::move(probe),
+                                                         [&] (auto completer)
+                                                         {
+                                                             get_many_impl(_handle,
+                                                                           paths,
+                                                                           _read_buffer_pool,
+                                                                           std::move(completer)
+                                                                          );
+                                                         }
+                                                        );
+}
+
+void connection_zk::get_many(const std::vector<path_view>&            paths,
+                             callback<std::vector<outcome<get_result>>> on_complete
+                            )
+{
+    auto probe = probe_for(request_type::get, string_view(), payload_of(paths), paths.size());
+    get_many_impl(_handle, paths, _read_buffer_pool, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+future<std::vector<outcome<get_children_result>>> connection_zk::get_children_many(const std::vector<path_view>& paths)
+{
+    auto probe = probe_for(request_type::get_children, string_view(), payload_of(paths), paths.size());
+    return with_future<std::vector<outcome<get_children_result>>>(std::move(probe),
+                                                                  [&] (auto completer)
+                                                                  {
+                                                                      get_children_many_impl(_handle,
+                                                                                             paths,
+                                                                                             std::move(completer)
+                                                                                            );
+                                                                  }
+                                                                 );
+}
+
+void connection_zk::get_children_many(const std::vector<path_view>&                       paths,
+                                      callback<std::vector<outcome<get_children_result>>> on_complete
+                                     )
+{
+    auto probe = probe_for(request_type::get_children, string_view(), payload_of(paths), paths.size());
+    get_children_many_impl(_handle, paths, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+future<std::vector<outcome<exists_result>>> connection_zk::exists_many(const std::vector<path_view>& paths)
+{
+    auto probe = probe_for(request_type::exists, string_view(), payload_of(paths), paths.size());
+    return with_future<std::vector<outcome<exists_result>>>(std::move(probe),
+                                                            [&] (auto completer)
+                                                            {
+                                                                exists_many_impl(_handle, paths, std::move(completer));
+                                                            }
+                                                           );
+}
+
+void connection_zk::exists_many(const std::vector<path_view>&                 paths,
+                                callback<std::vector<outcome<exists_result>>> on_complete
+                               )
+{
+    auto probe = probe_for(request_type::exists, string_view(), payload_of(paths), paths.size());
+    exists_many_impl(_handle, paths, with_callback(std::move(on_complete), std::move(probe)));
+}
+
 class connection_zk::data_watcher :
         public connection_zk::basic_watcher<watch_result>
 {
 public:
+    static constexpr char coalesce_kind = 'd';
+
+    explicit data_watcher(std::shared_ptr<buffer_pool> read_buffer_pool) :
+            _read_buffer_pool(std::move(read_buffer_pool))
+    { }
+
+    explicit data_watcher(std::shared_ptr<buffer_pool> read_buffer_pool,
+                          callback<watch_result>       on_data,
+                          event_callback               on_event = nullptr
+                         ) :
+            basic_watcher<watch_result>(std::move(on_data), std::move(on_event)),
+            _read_buffer_pool(std::move(read_buffer_pool))
+    { }
+
     static void deliver_raw(int                    rc_in,
                             ptr<const char>        data,
                             int                    data_sz,
@@ -370,639 +1482,1228 @@ public:
                             ptr<const void>        self_in
                            ) noexcept
     {
-        auto& self = *static_cast<ptr<data_watcher>>(const_cast<ptr<void>>(self_in));
-        auto  rc   = error_code_from_raw(rc_in);
+        auto  owner = take_completer<watch_data_context<data_watcher>>(self_in);
+        auto& self  = *owner->watcher;
+        auto  rc    = error_code_from_raw(rc_in);
 
         if (rc == error_code::ok)
         {
-            self.deliver_data(watch_result(get_result(buffer(data, data + data_sz), stat_from_raw(*pstat)),
+            self.probe().received(std::size_t(data_sz));
+            self.deliver_data(watch_result(get_result_from_raw(data, data_sz, *pstat, self._read_buffer_pool),
                                            self.get_event_future()
-                                          ),
-                              std::exception_ptr()
+                                          )
                              );
         }
         else
         {
-            self.deliver_data(nullopt, get_exception_ptr_of(rc));
+            self.deliver_error(rc);
         }
     }
+
+private:
+    std::shared_ptr<buffer_pool> _read_buffer_pool;
 };
 
-future<watch_result> connection_zk::watch(string_view path)
+void connection_zk::watch_impl(path_view                     path,
+                               std::shared_ptr<data_watcher> watcher,
+                               const cancellation_token&     cancel
+                              )
+{
+    auto set = [&] (std::shared_ptr<data_watcher> target)
+               {
+                   set_watch(request_type::watch,
+                             path,
+                             std::move(target),
+                             cancel,
+                             [&] (ptr<const char> path, ptr<void> watch_context, ptr<void> data_context)
+                             {
+                                 return ::zoo_awget(_handle,
+                                                   path,
+                                                   deliver_watch,
+                                                   watch_context,
+                                                   data_watcher::deliver_raw,
+                                                   data_context
+                                                  );
+                             }
+                            );
+               };
+
+    // A watch which can be cancelled is abandoned on its own, so it never shares
+    if (cancel.can_cancel())
+        return set(std::move(watcher));
+
+    coalesce_watch(data_watcher::coalesce_kind,
+                   path,
+                   std::move(watcher),
+                   [&] (callback<watch_result> on_data, event_callback on_event)
+                   {
+                       set(make_pooled_shared<data_watcher>(_read_buffer_pool,
+                                                            std::move(on_data),
+                                                            std::move(on_event)
+                                                           )
+                          );
+                   }
+                  );
+}
+
+future<watch_result> connection_zk::watch(path_view path)
+{
+    auto watcher = make_pooled_shared<data_watcher>(_read_buffer_pool);
+    auto fut     = watcher->get_data_future();
+    watch_impl(path, std::move(watcher));
+    return fut;
+}
+
+void connection_zk::watch(path_view path, callback<watch_result> on_complete)
+{
+    watch_impl(path, make_pooled_shared<data_watcher>(_read_buffer_pool, std::move(on_complete)));
+}
+
+void connection_zk::watch(path_view path, callback<watch_result> on_complete, event_callback on_event)
+{
+    watch_impl(path, make_pooled_shared<data_watcher>(_read_buffer_pool, std::move(on_complete), std::move(on_event)));
+}
+
+void connection_zk::watch(path_view                 path,
+                          callback<watch_result>    on_complete,
+                          event_callback            on_event,
+                          const cancellation_token& cancel
+                         )
 {
+    watch_impl(path,
+               make_pooled_shared<data_watcher>(_read_buffer_pool, std::move(on_complete), std::move(on_event)),
+               cancel
+              );
+}
+
+template <typename TResult, typename TCompleter>
+static bool get_children_impl(ptr<zhandle_t>              handle,
+                              path_view                   path,
+                              std::unique_ptr<TCompleter> completer,
+                              ::watcher_fn                watch_fn = nullptr
+                             )
+{
+    ::strings_stat_completion_t on_complete =
+        [] (int                             rc_in,
+            ptr<const struct String_vector> strings_in,
+            ptr<const struct Stat>          stat_in,
+            ptr<const void>                 completer_in
+           ) noexcept
+        {
+            auto completer = take_completer<TCompleter>(completer_in);
+            auto rc        = error_code_from_raw(rc_in);
+            if (rc == error_code::ok)
+                completer->complete(children_result_from_raw<TResult>(*strings_in, *stat_in));
+            else
+                completer->fail(rc);
+        };
+
     return with_str(path, [&] (ptr<const char> path) noexcept
     {
-        std::unique_lock<std::mutex> ax(_watches_protect);
-        auto watcher = std::make_shared<data_watcher>();
-        auto rc      = error_code_from_raw(::zoo_awget(_handle,
-                                                       path,
-                                                       deliver_watch,
-                                                       watcher.get(),
-                                                       data_watcher::deliver_raw,
-                                                       watcher.get()
-                                                      )
-                                          );
-        if (rc == error_code::ok)
-            _watches.emplace(watcher.get(), watcher);
-        else
-            watcher->deliver_data(nullopt, get_exception_ptr_of(rc));
-
-        return watcher->get_data_future();
+        return submit(std::move(completer),
+                      [&] (ptr<void> ctx)
+                      {
+                          return watch_fn ? ::zoo_awget_children2(handle, path, watch_fn, nullptr, on_complete, ctx)
+                                          : ::zoo_aget_children2(handle, path, 0, on_complete, ctx);
+                      }
+                     );
     });
 }
 
-future<get_children_result> connection_zk::get_children(string_view path)
+future<get_children_result> connection_zk::get_children(path_view path)
+{
+    auto probe = probe_for(request_type::get_children, path, path.size());
+    return with_future<get_children_result>(std::move(probe),
+                                            [&] (auto completer)
+                                            {
+                                                get_children_impl<get_children_result>(_handle,
+                                                                                       path,
+                                                                                       std::move(completer)
+                                                                                      );
+                                            }
+                                           );
+}
+
+void connection_zk::get_children(path_view path, callback<get_children_result> on_complete)
 {
-    ::strings_stat_completion_t callback =
+    auto probe = probe_for(request_type::get_children, path, path.size());
+    get_children_impl<get_children_result>(_handle, path, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+future<get_children_list_result> connection_zk::get_children_list(path_view path)
+{
+    auto probe = probe_for(request_type::get_children, path, path.size());
+    return with_future<get_children_list_result>(std::move(probe),
+                                                 [&] (auto completer)
+                                                 {
+                                                     get_children_impl<get_children_list_result>(_handle,
+                                                                                                 path,
+                                                                                                 std::move(completer)
+                                                                                                );
+                                                 }
+                                                );
+}
+
+void connection_zk::get_children_list(path_view path, callback<get_children_list_result> on_complete)
+{
+    auto probe = probe_for(request_type::get_children, path, path.size());
+    get_children_impl<get_children_list_result>(_handle, path, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+template <typename TCompleter>
+using for_each_child_completer = contextual_completer<TCompleter, child_visitor>;
+
+template <typename TCompleter>
+static void for_each_child_impl(ptr<zhandle_t>                                        handle,
+                                path_view                                             path,
+                                std::unique_ptr<for_each_child_completer<TCompleter>> completer
+                               )
+{
+    ::strings_stat_completion_t on_complete =
         [] (int                             rc_in,
             ptr<const struct String_vector> strings_in,
             ptr<const struct Stat>          stat_in,
-            ptr<const void>                 prom_in
-           )
+            ptr<const void>                 completer_in
+           ) noexcept
         {
-            std::unique_ptr<promise<get_children_result>> prom((ptr<promise<get_children_result>>) prom_in);
-            auto rc = error_code_from_raw(rc_in);
-            try
+            auto completer = take_completer<for_each_child_completer<TCompleter>>(completer_in);
+            auto rc        = error_code_from_raw(rc_in);
+            if (rc == error_code::ok)
             {
-                if (rc != error_code::ok)
-                    throw_error(rc);
-
-                prom->set_value(get_children_result(string_vector_from_raw(*strings_in), stat_from_raw(*stat_in)));
+                // The names are owned by the C client and freed when this returns, which is the whole point
+                for (std::int32_t idx = 0; idx < strings_in->count; ++idx)
+                    completer->context(string_view(strings_in->data[idx]));
+                completer->inner.complete(stat_from_raw(*stat_in));
             }
-            catch (...)
+            else
             {
-                prom->set_exception(std::current_exception());
+                completer->fail(rc);
             }
         };
 
-    return with_str(path, [&] (ptr<const char> path) noexcept
+    with_str(path, [&] (ptr<const char> path) noexcept
     {
-        auto ppromise = std::make_unique<promise<get_children_result>>();
-        auto fut      = ppromise->get_future();
-        auto rc       = error_code_from_raw(::zoo_aget_children2(_handle,
-                                                                 path,
-                                                                 0,
-                                                                 callback,
-                                                                 ppromise.get()
-                                                                )
-                                           );
-        if (rc == error_code::ok)
-        {
-            ppromise.release();
-            return fut;
-        }
-        else
-        {
-            ppromise->set_exception(get_exception_ptr_of(rc));
-            return fut;
-        }
+        submit(std::move(completer),
+               [&] (ptr<void> ctx) { return ::zoo_aget_children2(handle, path, 0, on_complete, ctx); }
+              );
     });
 }
 
+future<zk::stat> connection_zk::for_each_child(path_view path, child_visitor visitor)
+{
+    using completer_type = for_each_child_completer<promise_completer<zk::stat>>;
+    auto probe = probe_for(request_type::get_children, path, path.size());
+    auto completer = std::make_unique<completer_type>(std::move(visitor), std::move(probe));
+    auto fut       = completer->inner.get_future();
+    for_each_child_impl(_handle, path, std::move(completer));
+    return fut;
+}
+
+void connection_zk::for_each_child(path_view path, child_visitor visitor, callback<zk::stat> on_complete)
+{
+    using completer_type = for_each_child_completer<callback_completer<zk::stat>>;
+    auto probe = probe_for(request_type::get_children, path, path.size());
+    for_each_child_impl(_handle,
+                        path,
+                        std::make_unique<completer_type>(std::move(visitor), std::move(on_complete), std::move(probe))
+                       );
+}
+
 class connection_zk::child_watcher :
         public connection_zk::basic_watcher<watch_children_result>
 {
 public:
+    static constexpr char coalesce_kind = 'c';
+
+    using basic_watcher<watch_children_result>::basic_watcher;
+
     static void deliver_raw(int                             rc_in,
                             ptr<const struct String_vector> strings_in,
                             ptr<const struct Stat>          stat_in,
                             ptr<const void>                 prom_in
                            ) noexcept
     {
-        auto& self = *static_cast<ptr<child_watcher>>(const_cast<ptr<void>>(prom_in));
-        auto  rc   = error_code_from_raw(rc_in);
+        auto  owner = take_completer<watch_data_context<child_watcher>>(prom_in);
+        auto& self  = *owner->watcher;
+        auto  rc    = error_code_from_raw(rc_in);
 
-        try
+        if (rc == error_code::ok)
         {
-            if (rc != error_code::ok)
-                throw_error(rc);
-
             self.deliver_data(watch_children_result(get_children_result(string_vector_from_raw(*strings_in),
                                                                         stat_from_raw(*stat_in)
                                                                        ),
                                                     self.get_event_future()
-                                                   ),
-                              std::exception_ptr()
+                                                   )
                              );
         }
-        catch (...)
+        else
         {
-            self.deliver_data(nullopt, std::current_exception());
+            self.deliver_error(rc);
         }
-
     }
 };
 
-future<watch_children_result> connection_zk::watch_children(string_view path)
+class connection_zk::child_list_watcher :
+        public connection_zk::basic_watcher<watch_children_list_result>
 {
-    return with_str(path, [&] (ptr<const char> path) noexcept
+public:
+    static constexpr char coalesce_kind = 'l';
+
+    using basic_watcher<watch_children_list_result>::basic_watcher;
+
+    static void deliver_raw(int                             rc_in,
+                            ptr<const struct String_vector> strings_in,
+                            ptr<const struct Stat>          stat_in,
+                            ptr<const void>                 prom_in
+                           ) noexcept
     {
-        std::unique_lock<std::mutex> ax(_watches_protect);
-        auto watcher = std::make_shared<child_watcher>();
-        auto rc      = error_code_from_raw(::zoo_awget_children2(_handle,
-                                                                 path,
-                                                                 deliver_watch,
-                                                                 watcher.get(),
-                                                                 child_watcher::deliver_raw,
-                                                                 watcher.get()
-                                                                )
-                                          );
+        auto  owner = take_completer<watch_data_context<child_list_watcher>>(prom_in);
+        auto& self  = *owner->watcher;
+        auto  rc    = error_code_from_raw(rc_in);
+
         if (rc == error_code::ok)
-            _watches.emplace(watcher.get(), watcher);
+        {
+            self.deliver_data(watch_children_list_result(get_children_list_result(children_list_from_raw(*strings_in),
+                                                                                  stat_from_raw(*stat_in)
+                                                                                 ),
+                                                         self.get_event_future()
+                                                        )
+                             );
+        }
         else
-            watcher->deliver_data(nullopt, get_exception_ptr_of(rc));
+        {
+            self.deliver_error(rc);
+        }
+    }
+};
 
-        return watcher->get_data_future();
-    });
+template <typename TWatcher>
+void connection_zk::watch_children_impl(path_view                 path,
+                                        std::shared_ptr<TWatcher> watcher,
+                                        const cancellation_token& cancel
+                                       )
+{
+    auto set = [&] (std::shared_ptr<TWatcher> target)
+               {
+                   set_watch(request_type::watch_children,
+                             path,
+                             std::move(target),
+                             cancel,
+                             [&] (ptr<const char> path, ptr<void> watch_context, ptr<void> data_context)
+                             {
+                                 return ::zoo_awget_children2(_handle,
+                                                             path,
+                                                             deliver_watch,
+                                                             watch_context,
+                                                             TWatcher::deliver_raw,
+                                                             data_context
+                                                            );
+                             }
+                            );
+               };
+
+    // A watch which can be cancelled is abandoned on its own, so it never shares
+    if (cancel.can_cancel())
+        return set(std::move(watcher));
+
+    coalesce_watch(TWatcher::coalesce_kind,
+                   path,
+                   std::move(watcher),
+                   [&] (callback<typename TWatcher::result_type> on_data, event_callback on_event)
+                   {
+                       set(make_pooled_shared<TWatcher>(std::move(on_data), std::move(on_event)));
+                   }
+                  );
+}
+
+future<watch_children_result> connection_zk::watch_children(path_view path)
+{
+    auto watcher = make_pooled_shared<child_watcher>();
+    auto fut     = watcher->get_data_future();
+    watch_children_impl(path, std::move(watcher));
+    return fut;
+}
+
+void connection_zk::watch_children(path_view path, callback<watch_children_result> on_complete)
+{
+    watch_children_impl(path, make_pooled_shared<child_watcher>(std::move(on_complete)));
+}
+
+void connection_zk::watch_children(path_view                       path,
+                                   callback<watch_children_result> on_complete,
+                                   event_callback                  on_event
+                                  )
+{
+    watch_children_impl(path, make_pooled_shared<child_watcher>(std::move(on_complete), std::move(on_event)));
+}
+
+void connection_zk::watch_children(path_view                       path,
+                                   callback<watch_children_result> on_complete,
+                                   event_callback                  on_event,
+                                   const cancellation_token&       cancel
+                                  )
+{
+    watch_children_impl(path, make_pooled_shared<child_watcher>(std::move(on_complete), std::move(on_event)), cancel);
+}
+
+future<watch_children_list_result> connection_zk::watch_children_list(path_view path)
+{
+    auto watcher = make_pooled_shared<child_list_watcher>();
+    auto fut     = watcher->get_data_future();
+    watch_children_impl(path, std::move(watcher));
+    return fut;
+}
+
+void connection_zk::watch_children_list(path_view path, callback<watch_children_list_result> on_complete)
+{
+    watch_children_impl(path, make_pooled_shared<child_list_watcher>(std::move(on_complete)));
 }
 
-future<exists_result> connection_zk::exists(string_view path)
+void connection_zk::watch_children_list(path_view                            path,
+                                        callback<watch_children_list_result> on_complete,
+                                        event_callback                       on_event
+                                       )
 {
-    ::stat_completion_t callback =
-        [] (int rc_in, ptr<const struct Stat> stat_in, ptr<const void> prom_in)
+    watch_children_impl(path, make_pooled_shared<child_list_watcher>(std::move(on_complete), std::move(on_event)));
+}
+
+template <typename TCompleter>
+static bool exists_impl(ptr<zhandle_t>              handle,
+                        path_view                   path,
+                        std::unique_ptr<TCompleter> completer,
+                        ::watcher_fn                watch_fn = nullptr
+                       )
+{
+    ::stat_completion_t on_complete =
+        [] (int rc_in, ptr<const struct Stat> stat_in, ptr<const void> completer_in) noexcept
         {
-            std::unique_ptr<promise<exists_result>> prom((ptr<promise<exists_result>>) prom_in);
-            auto rc = error_code_from_raw(rc_in);
+            auto completer = take_completer<TCompleter>(completer_in);
+            auto rc        = error_code_from_raw(rc_in);
             if (rc == error_code::ok)
-                prom->set_value(exists_result(stat_from_raw(*stat_in)));
+                completer->complete(exists_result(stat_from_raw(*stat_in)));
             else if (rc == error_code::no_entry)
-                prom->set_value(exists_result(nullopt));
+                completer->complete(exists_result(nullopt));
             else
-                prom->set_exception(get_exception_ptr_of(rc));
+                completer->fail(rc);
         };
 
     return with_str(path, [&] (ptr<const char> path) noexcept
     {
-        auto ppromise = std::make_unique<promise<exists_result>>();
-        auto fut      = ppromise->get_future();
-        auto rc       = error_code_from_raw(::zoo_aexists(_handle, path, 0, callback, ppromise.get()));
+        return submit(std::move(completer),
+                      [&] (ptr<void> ctx)
+                      {
+                          return watch_fn ? ::zoo_awexists(handle, path, watch_fn, nullptr, on_complete, ctx)
+                                          : ::zoo_aexists(handle, path, 0, on_complete, ctx);
+                      }
+                     );
+    });
+}
+
+future<exists_result> connection_zk::exists(path_view path)
+{
+    auto probe = probe_for(request_type::exists, path, path.size());
+    return with_future<exists_result>(std::move(probe),
+                                      [&] (auto completer)
+                                      {
+                                          exists_impl(_handle, path, std::move(completer));
+                                      }
+                                     );
+}
+
+void connection_zk::exists(path_view path, callback<exists_result> on_complete)
+{
+    auto probe = probe_for(request_type::exists, path, path.size());
+    exists_impl(_handle, path, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+class connection_zk::exists_watcher :
+        public connection_zk::basic_watcher<watch_exists_result>
+{
+public:
+    static constexpr char coalesce_kind = 'e';
+
+    using basic_watcher<watch_exists_result>::basic_watcher;
+
+    static void deliver_raw(int rc_in, ptr<const struct Stat> stat_in, ptr<const void> self_in) noexcept
+    {
+        auto  owner = take_completer<watch_data_context<exists_watcher>>(self_in);
+        auto& self  = *owner->watcher;
+        auto  rc    = error_code_from_raw(rc_in);
+
         if (rc == error_code::ok)
-        {
-            ppromise.release();
-            return fut;
-        }
+            self.deliver_data(watch_exists_result(exists_result(stat_from_raw(*stat_in)), self.get_event_future()));
+        else if (rc == error_code::no_entry)
+            self.deliver_data(watch_exists_result(exists_result(nullopt), self.get_event_future()));
         else
-        {
-            ppromise->set_exception(get_exception_ptr_of(rc));
-            return fut;
-        }
-    });
+            self.deliver_error(rc);
+    }
+};
+
+void connection_zk::watch_exists_impl(path_view                       path,
+                                      std::shared_ptr<exists_watcher> watcher,
+                                      const cancellation_token&       cancel
+                                     )
+{
+    auto set = [&] (std::shared_ptr<exists_watcher> target)
+               {
+                   set_watch(request_type::watch_exists,
+                             path,
+                             std::move(target),
+                             cancel,
+                             [&] (ptr<const char> path, ptr<void> watch_context, ptr<void> data_context)
+                             {
+                                 return ::zoo_awexists(_handle,
+                                                      path,
+                                                      deliver_watch,
+                                                      watch_context,
+                                                      exists_watcher::deliver_raw,
+                                                      data_context
+                                                     );
+                             }
+                            );
+               };
+
+    // A watch which can be cancelled is abandoned on its own, so it never shares
+    if (cancel.can_cancel())
+        return set(std::move(watcher));
+
+    coalesce_watch(exists_watcher::coalesce_kind,
+                   path,
+                   std::move(watcher),
+                   [&] (callback<watch_exists_result> on_data, event_callback on_event)
+                   {
+                       set(make_pooled_shared<exists_watcher>(std::move(on_data), std::move(on_event)));
+                   }
+                  );
+}
+
+future<watch_exists_result> connection_zk::watch_exists(path_view path)
+{
+    auto watcher = make_pooled_shared<exists_watcher>();
+    auto fut     = watcher->get_data_future();
+    watch_exists_impl(path, std::move(watcher));
+    return fut;
+}
+
+void connection_zk::watch_exists(path_view path, callback<watch_exists_result> on_complete)
+{
+    watch_exists_impl(path, make_pooled_shared<exists_watcher>(std::move(on_complete)));
+}
+
+void connection_zk::watch_exists(path_view path, callback<watch_exists_result> on_complete, event_callback on_event)
+{
+    watch_exists_impl(path, make_pooled_shared<exists_watcher>(std::move(on_complete), std::move(on_event)));
+}
+
+void connection_zk::watch_exists(path_view                     path,
+                                 callback<watch_exists_result> on_complete,
+                                 event_callback                on_event,
+                                 const cancellation_token&     cancel
+                                )
+{
+    watch_exists_impl(path, make_pooled_shared<exists_watcher>(std::move(on_complete), std::move(on_event)), cancel);
+}
+
+void connection_zk::watch_routed(path_view path, callback<get_result> on_complete)
+{
+    using completer_type = get_completer<callback_completer<get_result>>;
+    auto probe = probe_for(request_type::watch, path, path.size());
+    if (get_impl(_handle,
+                 path,
+                 std::make_unique<completer_type>(_read_buffer_pool, std::move(on_complete), std::move(probe)),
+                 deliver_routed_watch
+                ))
+        _metrics.on_watch_set();
+}
+
+void connection_zk::watch_children_routed(path_view path, callback<get_children_result> on_complete)
+{
+    auto probe = probe_for(request_type::watch_children, path, path.size());
+    if (get_children_impl<get_children_result>(_handle,
+                                               path,
+                                               with_callback(std::move(on_complete), std::move(probe)),
+                                               deliver_routed_watch
+                                              ))
+        _metrics.on_watch_set();
+}
+
+void connection_zk::watch_exists_routed(path_view path, callback<exists_result> on_complete)
+{
+    auto probe = probe_for(request_type::watch_exists, path, path.size());
+    if (exists_impl(_handle, path, with_callback(std::move(on_complete), std::move(probe)), deliver_routed_watch))
+        _metrics.on_watch_set();
+}
+
+/// Call \a action with the rules as the C client takes them, encoding them for the call.
+template <typename FAction>
+static void with_rules(const acl& rules, FAction&& action)
+{
+    with_acl(rules, std::forward<FAction>(action));
+}
+
+/// The handle already has them encoded.
+template <typename FAction>
+static void with_rules(const acl_handle& rules, FAction&& action)
+{
+    std::forward<FAction>(action)(rules.native());
 }
 
-class connection_zk::exists_watcher :
-        public connection_zk::basic_watcher<watch_exists_result>
+template <typename TCompleter, typename TRules>
+static void create_impl(ptr<zhandle_t>              handle,
+                        path_view                   path,
+                        const buffer&               data,
+                        const TRules&               rules,
+                        create_mode                 mode,
+                        std::unique_ptr<TCompleter> completer
+                       )
 {
-public:
-    static void deliver_raw(int rc_in, ptr<const struct Stat> stat_in, ptr<const void> self_in)
-    {
-        auto& self = *static_cast<ptr<exists_watcher>>(const_cast<ptr<void>>(self_in));
-        auto  rc   = error_code_from_raw(rc_in);
-
-        if (rc == error_code::ok)
-        {
-            self.deliver_data(watch_exists_result(exists_result(stat_from_raw(*stat_in)), self.get_event_future()),
-                              std::exception_ptr()
-                             );
-        }
-        else if (rc == error_code::no_entry)
-        {
-            self.deliver_data(watch_exists_result(exists_result(nullopt), self.get_event_future()),
-                              std::exception_ptr()
-                             );
-        }
-        else
+    ::string_completion_t on_complete =
+        [] (int rc_in, ptr<const char> name_in, ptr<const void> completer_in) noexcept
         {
-            self.deliver_data(nullopt, get_exception_ptr_of(rc));
-        }
-    }
-};
+            auto completer = take_completer<TCompleter>(completer_in);
+            auto rc        = error_code_from_raw(rc_in);
+            if (rc == error_code::ok)
+                completer->complete(create_result(std::string(name_in)));
+            else
+                completer->fail(rc);
+        };
 
-future<watch_exists_result> connection_zk::watch_exists(string_view path)
-{
-    return with_str(path, [&] (ptr<const char> path) noexcept
+    with_str(path, [&] (ptr<const char> path) noexcept
     {
-        std::unique_lock<std::mutex> ax(_watches_protect);
-        auto watcher = std::make_shared<exists_watcher>();
-        auto rc      = error_code_from_raw(::zoo_awexists(_handle,
-                                                          path,
-                                                          deliver_watch,
-                                                          watcher.get(),
-                                                          exists_watcher::deliver_raw,
-                                                          watcher.get()
-                                                         )
-                                          );
-        if (rc == error_code::ok)
-            _watches.emplace(watcher.get(), watcher);
-        else
-            watcher->deliver_data(nullopt, get_exception_ptr_of(rc));
-
-        return watcher->get_data_future();
+        with_rules(rules, [&] (ptr<const ACL_vector> rules) noexcept
+        {
+            submit(std::move(completer),
+                   [&] (ptr<void> ctx)
+                   {
+                       return ::zoo_acreate(handle,
+                                            path,
+                                            data.data(),
+                                            int(data.size()),
+                                            rules,
+                                            static_cast<int>(mode),
+                                            on_complete,
+                                            ctx
+                                           );
+                   }
+                  );
+        });
     });
 }
 
-future<create_result> connection_zk::create(string_view   path,
+future<create_result> connection_zk::create(path_view     path,
                                             const buffer& data,
                                             const acl&    rules,
                                             create_mode   mode
                                            )
 {
-    ::string_completion_t callback =
-        [] (int rc_in, ptr<const char> name_in, ptr<const void> prom_in)
-        {
-            std::unique_ptr<promise<create_result>> prom((ptr<promise<create_result>>) prom_in);
-            auto rc = error_code_from_raw(rc_in);
-            if (rc == error_code::ok)
-                prom->set_value(create_result(std::string(name_in)));
-            else
-                prom->set_exception(get_exception_ptr_of(rc));
-        };
+    auto probe = probe_for(request_type::create, path, path.size() + data.size());
+    return with_future<create_result>(std::move(probe),
+                                      [&] (auto completer)
+                                      {
+                                          create_impl(_handle, path, data, rules, mode, std::move(completer));
+                                      }
+                                     );
+}
 
-        return with_str(path, [&] (ptr<const char> path) noexcept
-        {
-            auto ppromise = std::make_unique<promise<create_result>>();
-            auto fut      = ppromise->get_future();
-            auto rc       = with_acl(rules, [&] (ptr<const ACL_vector> rules) noexcept
-            {
-                return error_code_from_raw(::zoo_acreate(_handle,
-                                                         path,
-                                                         data.data(),
-                                                         int(data.size()),
-                                                         rules,
-                                                         static_cast<int>(mode),
-                                                         callback,
-                                                         ppromise.get()
-                                                        )
-                                          );
-            });
+void connection_zk::create(path_view               path,
+                           const buffer&           data,
+                           const acl&              rules,
+                           create_mode             mode,
+                           callback<create_result> on_complete
+                          )
+{
+    auto probe = probe_for(request_type::create, path, path.size() + data.size());
+    create_impl(_handle, path, data, rules, mode, with_callback(std::move(on_complete), std::move(probe)));
+}
 
-            if (rc == error_code::ok)
-            {
-                ppromise.release();
-                return fut;
-            }
-            else
-            {
-                ppromise->set_exception(get_exception_ptr_of(rc));
-                return fut;
-            }
-        });
+future<create_result> connection_zk::create(path_view         path,
+                                            const buffer&     data,
+                                            const acl_handle& rules,
+                                            create_mode       mode
+                                           )
+{
+    auto probe = probe_for(request_type::create, path, path.size() + data.size());
+    return with_future<create_result>(std::move(probe),
+                                      [&] (auto completer)
+                                      {
+                                          create_impl(_handle, path, data, rules, mode, std::move(completer));
+                                      }
+                                     );
 }
 
-future<set_result> connection_zk::set(string_view path, const buffer& data, version check)
+void connection_zk::create(path_view               path,
+                           const buffer&           data,
+                           const acl_handle&       rules,
+                           create_mode             mode,
+                           callback<create_result> on_complete
+                          )
 {
-    ::stat_completion_t callback =
-        [] (int rc_in, ptr<const struct Stat> stat_raw, ptr<const void> prom_in)
+    auto probe = probe_for(request_type::create, path, path.size() + data.size());
+    create_impl(_handle, path, data, rules, mode, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+template <typename TCompleter>
+static void set_impl(ptr<zhandle_t>              handle,
+                     path_view                   path,
+                     const buffer&               data,
+                     version                     check,
+                     std::unique_ptr<TCompleter> completer
+                    )
+{
+    ::stat_completion_t on_complete =
+        [] (int rc_in, ptr<const struct Stat> stat_raw, ptr<const void> completer_in) noexcept
         {
-            std::unique_ptr<promise<set_result>> prom((ptr<promise<set_result>>) prom_in);
-            auto rc = error_code_from_raw(rc_in);
+            auto completer = take_completer<TCompleter>(completer_in);
+            auto rc        = error_code_from_raw(rc_in);
             if (rc == error_code::ok)
-                prom->set_value(set_result(stat_from_raw(*stat_raw)));
+                completer->complete(set_result(stat_from_raw(*stat_raw)));
             else
-                prom->set_exception(get_exception_ptr_of(rc));
+                completer->fail(rc);
         };
 
-    return with_str(path, [&] (ptr<const char> path) noexcept
+    with_str(path, [&] (ptr<const char> path) noexcept
     {
-        auto ppromise = std::make_unique<promise<set_result>>();
-        auto fut      = ppromise->get_future();
-        auto rc       = error_code_from_raw(::zoo_aset(_handle,
-                                                       path,
-                                                       data.data(),
-                                                       int(data.size()),
-                                                       check.value,
-                                                       callback,
-                                                       ppromise.get()
-                                                      ));
-
-        if (rc == error_code::ok)
-        {
-            ppromise.release();
-            return fut;
-        }
-        else
-        {
-            ppromise->set_exception(get_exception_ptr_of(rc));
-            return fut;
-        }
+        submit(std::move(completer),
+               [&] (ptr<void> ctx)
+               {
+                   return ::zoo_aset(handle, path, data.data(), int(data.size()), check.value, on_complete, ctx);
+               }
+              );
     });
 }
 
-future<void> connection_zk::erase(string_view path, version check)
+future<set_result> connection_zk::set(path_view path, const buffer& data, version check)
 {
-    ::void_completion_t callback =
-        [] (int rc_in, ptr<const void> prom_in)
-        {
-            std::unique_ptr<promise<void>> prom((ptr<promise<void>>) prom_in);
-            auto rc = error_code_from_raw(rc_in);
-            if (rc == error_code::ok)
-                prom->set_value();
-            else
-                prom->set_exception(get_exception_ptr_of(rc));
-        };
+    auto probe = probe_for(request_type::set, path, path.size() + data.size());
+    return with_future<set_result>(std::move(probe),
+                                   [&] (auto completer)
+                                   {
+                                       set_impl(_handle, path, data, check, std::move(completer));
+                                   }
+                                  );
+}
 
-    return with_str(path, [&] (ptr<const char> path) noexcept
+void connection_zk::set(path_view path, const buffer& data, version check, callback<set_result> on_complete)
+{
+    auto probe = probe_for(request_type::set, path, path.size() + data.size());
+    set_impl(_handle, path, data, check, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+template <typename TCompleter>
+static void void_completion(int rc_in, ptr<const void> completer_in) noexcept
+{
+    auto completer = take_completer<TCompleter>(completer_in);
+    auto rc        = error_code_from_raw(rc_in);
+    if (rc == error_code::ok)
+        completer->complete();
+    else
+        completer->fail(rc);
+}
+
+template <typename TCompleter>
+static void erase_impl(ptr<zhandle_t> handle, path_view path, version check, std::unique_ptr<TCompleter> completer)
+{
+    with_str(path, [&] (ptr<const char> path) noexcept
     {
-        auto ppromise = std::make_unique<promise<void>>();
-        auto fut      = ppromise->get_future();
-        auto rc       = error_code_from_raw(::zoo_adelete(_handle, path, check.value, callback, ppromise.get()));
-        if (rc == error_code::ok)
-        {
-            ppromise.release();
-            return fut;
-        }
-        else
-        {
-            ppromise->set_exception(get_exception_ptr_of(rc));
-            return fut;
-        }
+        submit(std::move(completer),
+               [&] (ptr<void> ctx)
+               {
+                   return ::zoo_adelete(handle, path, check.value, void_completion<TCompleter>, ctx);
+               }
+              );
     });
 }
 
-future<get_acl_result> connection_zk::get_acl(string_view path) const
+future<void> connection_zk::erase(path_view path, version check)
+{
+    auto probe = probe_for(request_type::erase, path, path.size());
+    return with_future<void>(std::move(probe),
+                             [&] (auto completer)
+                             {
+                                 erase_impl(_handle, path, check, std::move(completer));
+                             }
+                            );
+}
+
+void connection_zk::erase(path_view path, version check, callback<void> on_complete)
+{
+    auto probe = probe_for(request_type::erase, path, path.size());
+    erase_impl(_handle, path, check, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+template <typename TCompleter>
+static void get_acl_impl(ptr<zhandle_t> handle, path_view path, std::unique_ptr<TCompleter> completer)
 {
-    ::acl_completion_t callback =
-        [] (int rc_in, ptr<struct ACL_vector> acl_raw, ptr<struct Stat> stat_raw, ptr<const void> prom_in) noexcept
+    ::acl_completion_t on_complete =
+        [] (int rc_in, ptr<struct ACL_vector> acl_raw, ptr<struct Stat> stat_raw, ptr<const void> completer_in) noexcept
         {
-            std::unique_ptr<promise<get_acl_result>> prom((ptr<promise<get_acl_result>>) prom_in);
-            auto rc = error_code_from_raw(rc_in);
+            auto completer = take_completer<TCompleter>(completer_in);
+            auto rc        = error_code_from_raw(rc_in);
             if (rc == error_code::ok)
-                prom->set_value(get_acl_result(acl_from_raw(*acl_raw), stat_from_raw(*stat_raw)));
+                completer->complete(get_acl_result(acl_from_raw(*acl_raw), stat_from_raw(*stat_raw)));
             else
-                prom->set_exception(get_exception_ptr_of(rc));
+                completer->fail(rc);
         };
 
-    return with_str(path, [&] (ptr<const char> path) noexcept
+    with_str(path, [&] (ptr<const char> path) noexcept
     {
-        auto ppromise = std::make_unique<promise<get_acl_result>>();
-        auto fut      = ppromise->get_future();
-        auto rc       = error_code_from_raw(::zoo_aget_acl(_handle, path, callback, ppromise.get()));
-        if (rc == error_code::ok)
-        {
-            ppromise.release();
-            return fut;
-        }
-        else
-        {
-            ppromise->set_exception(get_exception_ptr_of(rc));
-            return fut;
-        }
+        submit(std::move(completer), [&] (ptr<void> ctx) { return ::zoo_aget_acl(handle, path, on_complete, ctx); });
     });
 }
 
-future<void> connection_zk::set_acl(string_view path, const acl& rules, acl_version check)
+future<get_acl_result> connection_zk::get_acl(path_view path) const
 {
-    ::void_completion_t callback =
-        [] (int rc_in, ptr<const void> prom_in)
-        {
-            std::unique_ptr<promise<void>> prom((ptr<promise<void>>) prom_in);
-            auto rc = error_code_from_raw(rc_in);
-            if (rc == error_code::ok)
-                prom->set_value();
-            else
-                prom->set_exception(get_exception_ptr_of(rc));
-        };
+    auto probe = probe_for(request_type::get_acl, path, path.size());
+    return with_future<get_acl_result>(std::move(probe),
+                                       [&] (auto completer)
+                                       {
+                                           get_acl_impl(_handle, path, std::move(completer));
+                                       }
+                                      );
+}
 
-    return with_str(path, [&] (ptr<const char> path) noexcept
+void connection_zk::get_acl(path_view path, callback<get_acl_result> on_complete) const
+{
+    auto probe = probe_for(request_type::get_acl, path, path.size());
+    get_acl_impl(_handle, path, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+template <typename TCompleter>
+static void set_acl_impl(ptr<zhandle_t>              handle,
+                         path_view                   path,
+                         const acl&                  rules,
+                         acl_version                 check,
+                         std::unique_ptr<TCompleter> completer
+                        )
+{
+    with_str(path, [&] (ptr<const char> path) noexcept
     {
-        return with_acl(rules, [&] (ptr<struct ACL_vector> rules) noexcept
+        with_acl(rules, [&] (ptr<struct ACL_vector> rules) noexcept
         {
-            auto ppromise = std::make_unique<promise<void>>();
-            auto fut      = ppromise->get_future();
-            auto rc       = error_code_from_raw(::zoo_aset_acl(_handle,
-                                                               path,
-                                                               check.value,
-                                                               rules,
-                                                               callback,
-                                                               ppromise.get()
-                                                              )
-                                               );
-            if (rc == error_code::ok)
-            {
-                ppromise.release();
-                return fut;
-            }
-            else
-            {
-                ppromise->set_exception(get_exception_ptr_of(rc));
-                return fut;
-            }
+            submit(std::move(completer),
+                   [&] (ptr<void> ctx)
+                   {
+                       return ::zoo_aset_acl(handle, path, check.value, rules, void_completion<TCompleter>, ctx);
+                   }
+                  );
         });
     });
 }
 
-struct connection_zk_commit_completer
+future<void> connection_zk::set_acl(path_view path, const acl& rules, acl_version check)
+{
+    auto probe = probe_for(request_type::set_acl, path, path.size());
+    return with_future<void>(std::move(probe),
+                             [&] (auto completer)
+                             {
+                                 set_acl_impl(_handle, path, rules, check, std::move(completer));
+                             }
+                            );
+}
+
+void connection_zk::set_acl(path_view path, const acl& rules, acl_version check, callback<void> on_complete)
+{
+    auto probe = probe_for(request_type::set_acl, path, path.size());
+    set_acl_impl(_handle, path, rules, check, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+/// The in-flight state of a commit. The \c encoding outlives \c source_txn when it comes from a \ref prepared_multi,
+/// but it is only used for the types of the operations once the request is submitted.
+template <typename TCompleter>
+struct connection_zk_commit_completer :
+        pooled_completion
 {
     multi_op                                 source_txn;
-    promise<multi_result>                    prom;
-    std::vector<zoo_op_result_t>             raw_results;
-    std::map<std::size_t, Stat>              raw_stats;
-    std::map<std::size_t, std::vector<char>> path_buffers;
+    std::shared_ptr<const multi_op_encoding> encoding;
+    TCompleter                               inner;
+    multi_op_buffers                         buffers;
 
-    explicit connection_zk_commit_completer(multi_op&& src) :
+    template <typename... TArgs>
+    explicit connection_zk_commit_completer(multi_op&& src, TArgs&&... inner_args) :
             source_txn(std::move(src)),
-            raw_results(source_txn.size())
-    {
-        for (zoo_op_result_t& x : raw_results)
-            x.err = -42;
-    }
-
-    ptr<Stat> raw_stat_at(std::size_t idx)
-    {
-        return &raw_stats[idx];
-    }
+            encoding(std::make_shared<const multi_op_encoding>(source_txn)),
+            inner(std::forward<TArgs>(inner_args)...),
+            buffers(encoding->make_buffers())
+    { }
 
-    ptr<std::vector<char>> path_buffer_for(std::size_t idx, const std::string& path, create_mode mode)
-    {
-        // If the creation is sequential, append 12 extra characters to store the digits
-        auto sz = path.size() + (is_set(mode, create_mode::sequential) ? 12 : 1);
-        path_buffers[idx] = std::vector<char>(sz);
-        return &path_buffers[idx];
-    }
+    template <typename... TArgs>
+    explicit connection_zk_commit_completer(std::shared_ptr<const multi_op_encoding> prepared,
+                                            TArgs&&...                               inner_args
+                                           ) :
+            encoding(std::move(prepared)),
+            inner(std::forward<TArgs>(inner_args)...),
+            buffers(encoding->make_buffers())
+    { }
 
     void deliver(error_code rc)
     {
-        try
+        if (rc == error_code::ok)
         {
-            if (rc == error_code::ok)
+            multi_result out;
+            out.reserve(buffers.raw_results.size());
+            for (std::size_t idx = 0; idx < encoding->size(); ++idx)
             {
-                multi_result out;
-                out.reserve(raw_results.size());
-                for (std::size_t idx = 0; idx < source_txn.size(); ++idx)
+                const auto& raw_res = buffers.raw_results[idx];
+
+                switch (encoding->type(idx))
                 {
-                    const auto& raw_res = raw_results[idx];
-
-                    switch (source_txn[idx].type())
-                    {
-                    case op_type::create:
-                        out.emplace_back(create_result(std::string(raw_res.value)));
-                        break;
-                    case op_type::set:
-                        out.emplace_back(set_result(stat_from_raw(*raw_res.stat)));
-                        break;
-                    default:
-                        out.emplace_back(source_txn[idx].type(), nullptr);
-                        break;
-                    }
+                case op_type::create:
+                    out.emplace_back(create_result(std::string(raw_res.value)));
+                    break;
+                case op_type::set:
+                    out.emplace_back(set_result(stat_from_raw(*raw_res.stat)));
+                    break;
+                default:
+                    out.emplace_back(encoding->type(idx), nullptr);
+                    break;
                 }
-
-                prom.set_value(std::move(out));
-            }
-            else
-            {
-                // All results until the failure are 0, equal to rc where we care, and runtime_inconsistency after that.
-                auto iter = std::partition_point(raw_results.begin(), raw_results.end(),
-                                                 [] (auto res) { return res.err == 0; }
-                                                );
-                throw transaction_failed(rc, std::size_t(std::distance(raw_results.begin(), iter)));
             }
+
+            inner.complete(std::move(out));
         }
-        catch (...)
+        else
         {
-            prom.set_exception(std::current_exception());
+            // All results until the failure are 0, equal to rc where we care, and runtime_inconsistency after that.
+            auto iter = std::partition_point(buffers.raw_results.begin(), buffers.raw_results.end(),
+                                             [] (auto res) { return res.err == 0; }
+                                            );
+            auto failed_idx = std::size_t(std::distance(buffers.raw_results.begin(), iter));
+            inner.fail(error_code::transaction_failed, std::make_exception_ptr(transaction_failed(rc, failed_idx)));
         }
     }
 };
 
-future<multi_result> connection_zk::commit(multi_op&& txn_in)
+/// Submit \a txn, which is the source transaction of \a pcompleter, the operations of the \ref prepared_multi its
+/// encoding came from or a \ref multi_op_view. The C client serializes the request inside of \c zoo_amulti, so \a txn
+/// is only read here.
+template <typename TTxn, typename TCompleter>
+static void commit_impl(ptr<zhandle_t>                                              handle,
+                        const TTxn&                                                 txn,
+                        std::unique_ptr<connection_zk_commit_completer<TCompleter>> pcompleter
+                       )
 {
-    ::void_completion_t callback =
-        [] (int rc_in, ptr<const void> completer_in)
+    ::void_completion_t on_complete =
+        [] (int rc_in, ptr<const void> completer_in) noexcept
         {
-            std::unique_ptr<connection_zk_commit_completer>
-                completer((ptr<connection_zk_commit_completer>) completer_in);
+            auto completer = take_completer<connection_zk_commit_completer<TCompleter>>(completer_in);
             completer->deliver(error_code_from_raw(rc_in));
         };
 
-    auto pcompleter = std::make_unique<connection_zk_commit_completer>(std::move(txn_in));
-    auto& txn = pcompleter->source_txn;
+    if (!pcompleter->inner.probe().admitted())
+        return pcompleter->inner.fail(error_code::throttled);
+
     try
     {
-        ::zoo_op raw_ops[txn.size()];
-        std::size_t create_op_count = 0;
-        std::size_t acl_piece_count = 0;
-        for (const auto& tx : txn)
-        {
-            if (tx.type() == op_type::create)
-            {
-                ++create_op_count;
-                acl_piece_count += tx.as_create().rules.size();
-            }
-        }
-        ACL_vector      encoded_acls[create_op_count];
-        ACL             acl_pieces[acl_piece_count];
-        ptr<ACL_vector> encoded_acl_iter = encoded_acls;
-        ptr<ACL>        acl_piece_iter   = acl_pieces;
-
-        for (std::size_t idx = 0; idx < txn.size(); ++idx)
-        {
-            auto& raw_op = raw_ops[idx];
-            auto& src_op = txn[idx];
-            switch (src_op.type())
-            {
-                case op_type::check:
-                    zoo_check_op_init(&raw_op, src_op.as_check().path.c_str(), src_op.as_check().check.value);
-                    break;
-                case op_type::create:
-                {
-                    const auto& cdata = src_op.as_create();
-                    encoded_acl_iter->count = int(cdata.rules.size());
-                    encoded_acl_iter->data  = acl_piece_iter;
-                    for (const auto& acl : cdata.rules)
-                    {
-                        *acl_piece_iter = encode_acl_part(acl);
-                        ++acl_piece_iter;
-                    }
-
-                    auto path_buf_ref = pcompleter->path_buffer_for(idx, cdata.path, cdata.mode);
-                    zoo_create_op_init(&raw_op,
-                                       cdata.path.c_str(),
-                                       cdata.data.data(),
-                                       int(cdata.data.size()),
-                                       encoded_acl_iter,
-                                       static_cast<int>(cdata.mode),
-                                       path_buf_ref->data(),
-                                       int(path_buf_ref->size())
-                                      );
-                    ++encoded_acl_iter;
-                    break;
-                }
-                case op_type::erase:
-                    zoo_delete_op_init(&raw_op, src_op.as_erase().path.c_str(), src_op.as_erase().check.value);
-                    break;
-                case op_type::set:
-                {
-                    const auto& setting = src_op.as_set();
-                    zoo_set_op_init(&raw_op,
-                                    setting.path.c_str(),
-                                    setting.data.data(),
-                                    int(setting.data.size()),
-                                    setting.check.value,
-                                    pcompleter->raw_stat_at(idx)
-                                   );
-                    break;
-                }
-                default:
-                {
-                    using std::to_string;
-                    throw std::invalid_argument("Invalid op_type at index=" + to_string(idx) + ": "
-                                                + to_string(src_op.type())
-                                               );
-                }
-            }
-        }
-        auto rc = error_code_from_raw(::zoo_amulti(_handle,
-                                                   int(txn.size()),
-                                                   raw_ops,
-                                                   pcompleter->raw_results.data(),
-                                                   callback,
-                                                   pcompleter.get()
-                                                  )
-                                     );
+        auto raw_ops = pcompleter->encoding->bind(txn, pcompleter->buffers);
+        auto rc      = error_code_from_raw(::zoo_amulti(handle,
+                                                        int(txn.size()),
+                                                        raw_ops,
+                                                        pcompleter->buffers.raw_results.data(),
+                                                        on_complete,
+                                                        pcompleter.get()
+                                                       )
+                                          );
         if (rc == error_code::ok)
-        {
-            auto f = pcompleter->prom.get_future();
             pcompleter.release();
-            return f;
-        }
         else
-        {
-            pcompleter->prom.set_exception(get_exception_ptr_of(rc));
-            return pcompleter->prom.get_future();
-        }
+            pcompleter->inner.fail(rc);
     }
     catch (...)
     {
-        pcompleter->prom.set_exception(std::current_exception());
-        return pcompleter->prom.get_future();
+        pcompleter->inner.fail_submission(std::current_exception());
     }
 }
 
-future<void> connection_zk::load_fence()
+template <typename TTxn>
+static std::size_t payload_of(const TTxn& txn)
+{
+    std::size_t total = 0U;
+    for (const auto& src : txn)
+    {
+        op_view src_op(src);
+        total += src_op.path().size() + src_op.data().size();
+    }
+    return total;
+}
+
+future<multi_result> connection_zk::commit(multi_op&& txn)
+{
+    using completer_type = connection_zk_commit_completer<promise_completer<multi_result>>;
+    auto probe = probe_for(request_type::commit, string_view(), payload_of(txn));
+    auto pcompleter = std::make_unique<completer_type>(std::move(txn), std::move(probe));
+    auto fut        = pcompleter->inner.get_future();
+    const auto& source = pcompleter->source_txn;
+    commit_impl(_handle, source, std::move(pcompleter));
+    return fut;
+}
+
+void connection_zk::commit(multi_op&& txn, callback<multi_result> on_complete)
+{
+    using completer_type = connection_zk_commit_completer<callback_completer<multi_result>>;
+    auto probe = probe_for(request_type::commit, string_view(), payload_of(txn));
+    auto pcompleter = std::make_unique<completer_type>(std::move(txn), std::move(on_complete), std::move(probe));
+    const auto& source = pcompleter->source_txn;
+    commit_impl(_handle, source, std::move(pcompleter));
+}
+
+prepared_multi connection_zk::prepare(multi_op txn) const
+{
+    return prepared_multi(std::move(txn),
+                          [] (const multi_op& ops) { return std::make_shared<const multi_op_encoding>(ops); }
+                         );
+}
+
+future<multi_result> connection_zk::commit(const prepared_multi& txn)
+{
+    auto encoding = std::dynamic_pointer_cast<const multi_op_encoding>(txn.encoded());
+    if (!encoding)
+        return connection::commit(txn);
+
+    using completer_type = connection_zk_commit_completer<promise_completer<multi_result>>;
+    auto probe = probe_for(request_type::commit, string_view(), payload_of(txn.ops()));
+    auto pcompleter = std::make_unique<completer_type>(std::move(encoding), std::move(probe));
+    auto fut        = pcompleter->inner.get_future();
+    commit_impl(_handle, txn.ops(), std::move(pcompleter));
+    return fut;
+}
+
+future<multi_result> connection_zk::commit(const multi_op_view& txn)
+{
+    using completer_type = connection_zk_commit_completer<promise_completer<multi_result>>;
+    auto probe      = probe_for(request_type::commit, string_view(), payload_of(txn));
+    auto encoding   = std::make_shared<const multi_op_encoding>(txn);
+    auto pcompleter = std::make_unique<completer_type>(std::move(encoding), std::move(probe));
+    auto fut        = pcompleter->inner.get_future();
+    commit_impl(_handle, txn, std::move(pcompleter));
+    return fut;
+}
+
+void connection_zk::commit(const multi_op_view& txn, callback<multi_result> on_complete)
+{
+    using completer_type = connection_zk_commit_completer<callback_completer<multi_result>>;
+    auto probe    = probe_for(request_type::commit, string_view(), payload_of(txn));
+    auto encoding = std::make_shared<const multi_op_encoding>(txn);
+    commit_impl(_handle,
+                txn,
+                std::make_unique<completer_type>(std::move(encoding), std::move(on_complete), std::move(probe))
+               );
+}
+
+void connection_zk::commit(const prepared_multi& txn, callback<multi_result> on_complete)
+{
+    auto encoding = std::dynamic_pointer_cast<const multi_op_encoding>(txn.encoded());
+    if (!encoding)
+        return connection::commit(txn, std::move(on_complete));
+
+    using completer_type = connection_zk_commit_completer<callback_completer<multi_result>>;
+    auto probe = probe_for(request_type::commit, string_view(), payload_of(txn.ops()));
+    commit_impl(_handle,
+                txn.ops(),
+                std::make_unique<completer_type>(std::move(encoding), std::move(on_complete), std::move(probe))
+               );
+}
+
+template <typename TCompleter>
+static void load_fence_impl(ptr<zhandle_t> handle, std::unique_ptr<TCompleter> completer)
 {
-    ::string_completion_t callback =
-        [] (int rc_in, ptr<const char>, ptr<const void> prom_in)
+    ::string_completion_t on_complete =
+        [] (int rc_in, ptr<const char>, ptr<const void> completer_in) noexcept
         {
-            std::unique_ptr<promise<void>> prom((ptr<promise<void>>) prom_in);
-            auto rc = error_code_from_raw(rc_in);
-            if (rc == error_code::ok)
-                prom->set_value();
-            else
-                prom->set_exception(get_exception_ptr_of(rc));
+            void_completion<TCompleter>(rc_in, completer_in);
         };
 
-    auto ppromise = std::make_unique<std::promise<void>>();
-    auto rc = error_code_from_raw(::zoo_async(_handle, "/", callback, ppromise.get()));
-    if (rc == error_code::ok)
+    submit(std::move(completer), [&] (ptr<void> ctx) { return ::zoo_async(handle, "/", on_complete, ctx); });
+}
+
+future<void> connection_zk::load_fence()
+{
+    auto probe = probe_for(request_type::load_fence, string_view(), 0U);
+    return with_future<void>(std::move(probe),
+                             [&] (auto completer)
+                             {
+                                 load_fence_impl(_handle, std::move(completer));
+                             }
+                            );
+}
+
+void connection_zk::load_fence(callback<void> on_complete)
+{
+    auto probe = probe_for(request_type::load_fence, string_view(), 0U);
+    load_fence_impl(_handle, with_callback(std::move(on_complete), std::move(probe)));
+}
+
+/// The entry the configuration of the ensemble is kept in, whatever the chroot (\c ZOO_CONFIG_NODE).
+static constexpr string_view config_path = "/zookeeper/config";
+
+/// Join \a servers with commas, which is how the C client takes a list of them. It takes \c nullptr for no list at all,
+/// which is what an empty \a servers is passed as.
+static optional<std::string> server_list(const std::vector<std::string>& servers)
+{
+    if (servers.empty())
+        return nullopt;
+
+    std::string out;
+    for (const auto& server : servers)
     {
-        auto f = ppromise->get_future();
-        ppromise.release();
-        return f;
+        if (!out.empty())
+            out += ',';
+        out += server;
     }
-    else
+    return out;
+}
+
+/// The size of the server lists of a reconfiguration, which is what it is measured by.
+static std::size_t payload_of(const std::vector<std::string>& joining,
+                              const std::vector<std::string>& leaving,
+                              const std::vector<std::string>& members
+                             )
+{
+    std::size_t out = 0U;
+    for (const auto* list : { &joining, &leaving, &members })
+        for (const auto& server : *list)
+            out += server.size();
+    return out;
+}
+
+/// Deliver the configuration \c zoo_agetconfig and \c zoo_areconfig complete with as a \ref get_result.
+template <typename TCompleter>
+static ::data_completion_t config_completion()
+{
+    return [] (int rc_in, ptr<const char> data, int data_sz, ptr<const struct Stat> pstat, ptr<const void> completer_in)
+               noexcept
+           {
+               auto completer = take_completer<get_completer<TCompleter>>(completer_in);
+               auto rc        = error_code_from_raw(rc_in);
+               if (rc == error_code::ok)
+               {
+                   completer->inner.probe().received(std::size_t(data_sz));
+                   completer->inner.complete(get_result_from_raw(data, data_sz, *pstat, completer->context));
+               }
+               else
+                   completer->fail(rc);
+           };
+}
+
+template <typename TCompleter>
+static void get_config_impl(ptr<zhandle_t> handle, std::unique_ptr<get_completer<TCompleter>> completer)
+{
+    submit(std::move(completer),
+           [&] (ptr<void> ctx) { return ::zoo_agetconfig(handle, 0, config_completion<TCompleter>(), ctx); }
+          );
+}
+
+future<get_result> connection_zk::get_config()
+{
+    using completer_type = get_completer<promise_completer<get_result>>;
+    auto probe     = probe_for(request_type::get, config_path, config_path.size());
+    auto completer = std::make_unique<completer_type>(_read_buffer_pool, std::move(probe));
+    auto fut       = completer->inner.get_future();
+    get_config_impl(_handle, std::move(completer));
+    return fut;
+}
+
+void connection_zk::get_config(callback<get_result> on_complete)
+{
+    using completer_type = get_completer<callback_completer<get_result>>;
+    auto probe     = probe_for(request_type::get, config_path, config_path.size());
+    auto completer = std::make_unique<completer_type>(_read_buffer_pool, std::move(on_complete), std::move(probe));
+    get_config_impl(_handle, std::move(completer));
+}
+
+template <typename TCompleter>
+static void reconfigure_impl(ptr<zhandle_t>                             handle,
+                             const std::vector<std::string>&            joining,
+                             const std::vector<std::string>&            leaving,
+                             const std::vector<std::string>&            members,
+                             version                                    from_config,
+                             std::unique_ptr<get_completer<TCompleter>> completer
+                            )
+{
+    auto joining_list = server_list(joining);
+    auto leaving_list = server_list(leaving);
+    auto members_list = server_list(members);
+    auto c_str        = [] (const optional<std::string>& src) { return src ? src->c_str() : nullptr; };
+
+    submit(std::move(completer),
+           [&] (ptr<void> ctx)
+           {
+               return ::zoo_areconfig(handle,
+                                      c_str(joining_list),
+                                      c_str(leaving_list),
+                                      c_str(members_list),
+                                      from_config.value,
+                                      config_completion<TCompleter>(),
+                                      ctx
+                                     );
+           }
+          );
+}
+
+future<get_result> connection_zk::reconfigure(const std::vector<std::string>& joining,
+                                              const std::vector<std::string>& leaving,
+                                              const std::vector<std::string>& members,
+                                              version                         from_config
+                                             )
+{
+    using completer_type = get_completer<promise_completer<get_result>>;
+    auto probe     = probe_for(request_type::set, config_path, payload_of(joining, leaving, members));
+    auto completer = std::make_unique<completer_type>(_read_buffer_pool, std::move(probe));
+    auto fut       = completer->inner.get_future();
+    reconfigure_impl(_handle, joining, leaving, members, from_config, std::move(completer));
+    return fut;
+}
+
+void connection_zk::reconfigure(const std::vector<std::string>& joining,
+                                const std::vector<std::string>& leaving,
+                                const std::vector<std::string>& members,
+                                version                         from_config,
+                                callback<get_result>            on_complete
+                               )
+{
+    using completer_type = get_completer<callback_completer<get_result>>;
+    auto probe = probe_for(request_type::set, config_path, payload_of(joining, leaving, members));
+    reconfigure_impl(_handle,
+                     joining,
+                     leaving,
+                     members,
+                     from_config,
+                     std::make_unique<completer_type>(_read_buffer_pool, std::move(on_complete), std::move(probe))
+                    );
+}
+
+void connection_zk::update_hosts(const std::vector<std::string>& hosts)
+{
+    auto ordered = hosts;
+    _selector->order(ordered);
+    auto list = server_list(ordered);
+    if (!list)
+        throw std::invalid_argument("A connection needs at least one host");
+
+    auto err = error_code_from_raw(::zoo_set_servers(_handle, list->c_str()));
+    if (err != error_code::ok)
+        throw_error(err);
+}
+
+optional<session_credentials> connection_zk::current_session() const
+{
+    switch (state())
     {
-        ppromise->set_exception(get_exception_ptr_of(rc));
-        return ppromise->get_future();
+    case zk::state::closed:
+    case zk::state::expired_session:
+    case zk::state::authentication_failed:
+        return nullopt;
+    default:
+        break;
     }
+
+    auto id = ::zoo_client_id(_handle);
+    if (!id || id->client_id == 0)
+        return nullopt;
+
+    session_credentials out;
+    out.id       = id->client_id;
+    out.password = std::string(id->passwd, sizeof id->passwd);
+    return out;
 }
 
 void connection_zk::on_session_event_raw(ptr<zhandle_t>  handle      [[gnu::unused]],
@@ -1012,6 +2713,7 @@ void connection_zk::on_session_event_raw(ptr<zhandle_t>  handle      [[gnu::unus
                                          ptr<void>       watcher_ctx
                                         ) noexcept
 {
+    completion_thread_scope::mark_forever();
     auto self = static_cast<ptr<connection_zk>>(watcher_ctx);
     // Most of the time, self's _handle will be the same thing that ZK provides to us. However, if we connect very
     // quickly, a session event will happen trigger *before* we set the _handle. This isn't a problem, just something to
@@ -1027,6 +2729,7 @@ void connection_zk::on_session_event_raw(ptr<zhandle_t>  handle      [[gnu::unus
         std::cerr << "WARNING: Got unexpected event " << ev << " in state=" << st << " with path=" << path << std::endl;
         return;
     }
+    self->_metrics.on_state_change(st);
     self->on_session_event(st);
 }
 
@@ -2,12 +2,20 @@
 
 #include <zk/config.hpp>
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "cancellation.hpp"
 #include "connection.hpp"
+#include "metrics.hpp"
 #include "string_view.hpp"
 
 typedef struct _zhandle zhandle_t;
@@ -15,11 +23,14 @@ typedef struct _zhandle zhandle_t;
 namespace zk
 {
 
+class request_probe;
+
 /// \addtogroup Client
 /// \{
 
 class connection_zk final :
-        public connection
+        public connection,
+        public std::enable_shared_from_this<connection_zk>
 {
 public:
     explicit connection_zk(const connection_params& params);
@@ -28,37 +39,170 @@ public:
 
     virtual void close() override;
 
-    virtual zk::state state() const override;
-
-    virtual future<get_result> get(string_view path) override;
-
-    virtual future<watch_result> watch(string_view path) override;
+    /// Closing with the C client waits for the server to hear of it and for the threads of the handle to stop, so this
+    /// queues the handle to be closed on a small pool of threads shared by every connection (which keeps this
+    /// connection alive until it is done). Up to 8 handles are closed at the same time, so closing that many sessions
+    /// at once takes about as long as closing one; any more wait for a free thread. The watches get their
+    /// \ref state::closed event before this returns. A connection which is not owned by a
+    /// \c shared_ptr has nothing to keep it alive and is closed on the calling thread.
+    virtual void close_async(callback<void> on_closed) override;
 
-    virtual future<get_children_result> get_children(string_view path) override;
+    using connection::close_async;
 
-    virtual future<watch_children_result> watch_children(string_view path) override;
-
-    virtual future<exists_result> exists(string_view path) override;
-
-    virtual future<watch_exists_result> watch_exists(string_view path) override;
+    virtual zk::state state() const override;
 
-    virtual future<create_result> create(string_view   path,
+    virtual metrics_snapshot metrics() const override;
+
+    virtual future<get_result> get(path_view path) override;
+    virtual void get(path_view path, callback<get_result> on_complete) override;
+
+    virtual future<zk::stat> get_into(path_view path, buffer& target) override;
+    virtual void get_into(path_view path, buffer& target, callback<zk::stat> on_complete) override;
+
+    virtual future<std::vector<outcome<get_result>>> get_many(const std::vector<path_view>& paths) override;
+    virtual void get_many(const std::vector<path_view>&            paths,
+                          callback<std::vector<outcome<get_result>>> on_complete
+                         ) override;
+
+    virtual future<std::vector<outcome<get_children_result>>>
+    get_children_many(const std::vector<path_view>& paths) override;
+    virtual void get_children_many(const std::vector<path_view>&                       paths,
+                                   callback<std::vector<outcome<get_children_result>>> on_complete
+                                  ) override;
+
+    virtual future<std::vector<outcome<exists_result>>> exists_many(const std::vector<path_view>& paths) override;
+    virtual void exists_many(const std::vector<path_view>&                 paths,
+                             callback<std::vector<outcome<exists_result>>> on_complete
+                            ) override;
+
+    virtual future<watch_result> watch(path_view path) override;
+    virtual void watch(path_view path, callback<watch_result> on_complete) override;
+    virtual void watch(path_view path, callback<watch_result> on_complete, event_callback on_event) override;
+    virtual void watch(path_view                 path,
+                       callback<watch_result>    on_complete,
+                       event_callback            on_event,
+                       const cancellation_token& cancel
+                      ) override;
+
+    virtual future<get_children_result> get_children(path_view path) override;
+    virtual void get_children(path_view path, callback<get_children_result> on_complete) override;
+
+    virtual future<watch_children_result> watch_children(path_view path) override;
+    virtual void watch_children(path_view path, callback<watch_children_result> on_complete) override;
+    virtual void watch_children(path_view                       path,
+                                callback<watch_children_result> on_complete,
+                                event_callback                  on_event
+                               ) override;
+    virtual void watch_children(path_view                       path,
+                                callback<watch_children_result> on_complete,
+                                event_callback                  on_event,
+                                const cancellation_token&       cancel
+                               ) override;
+
+    virtual future<get_children_list_result> get_children_list(path_view path) override;
+    virtual void get_children_list(path_view path, callback<get_children_list_result> on_complete) override;
+
+    virtual future<watch_children_list_result> watch_children_list(path_view path) override;
+    virtual void watch_children_list(path_view path, callback<watch_children_list_result> on_complete) override;
+    virtual void watch_children_list(path_view                            path,
+                                     callback<watch_children_list_result> on_complete,
+                                     event_callback                       on_event
+                                    ) override;
+
+    virtual future<zk::stat> for_each_child(path_view path, child_visitor visitor) override;
+    virtual void for_each_child(path_view path, child_visitor visitor, callback<zk::stat> on_complete) override;
+
+    virtual future<exists_result> exists(path_view path) override;
+    virtual void exists(path_view path, callback<exists_result> on_complete) override;
+
+    virtual future<watch_exists_result> watch_exists(path_view path) override;
+    virtual void watch_exists(path_view path, callback<watch_exists_result> on_complete) override;
+    virtual void watch_exists(path_view                     path,
+                              callback<watch_exists_result> on_complete,
+                              event_callback                on_event
+                             ) override;
+    virtual void watch_exists(path_view                     path,
+                              callback<watch_exists_result> on_complete,
+                              event_callback                on_event,
+                              const cancellation_token&     cancel
+                             ) override;
+
+    virtual void watch_routed(path_view path, callback<get_result> on_complete) override;
+    virtual void watch_children_routed(path_view path, callback<get_children_result> on_complete) override;
+    virtual void watch_exists_routed(path_view path, callback<exists_result> on_complete) override;
+
+    virtual future<create_result> create(path_view     path,
                                          const buffer& data,
                                          const acl&    rules,
                                          create_mode   mode
                                         ) override;
+    virtual void create(path_view               path,
+                        const buffer&           data,
+                        const acl&              rules,
+                        create_mode             mode,
+                        callback<create_result> on_complete
+                       ) override;
+    virtual future<create_result> create(path_view         path,
+                                         const buffer&     data,
+                                         const acl_handle& rules,
+                                         create_mode       mode
+                                        ) override;
+    virtual void create(path_view               path,
+                        const buffer&           data,
+                        const acl_handle&       rules,
+                        create_mode             mode,
+                        callback<create_result> on_complete
+                       ) override;
 
-    virtual future<set_result> set(string_view path, const buffer& data, version check) override;
+    virtual future<set_result> set(path_view path, const buffer& data, version check) override;
+    virtual void set(path_view path, const buffer& data, version check, callback<set_result> on_complete) override;
 
-    virtual future<void> erase(string_view path, version check) override;
+    virtual future<void> erase(path_view path, version check) override;
+    virtual void erase(path_view path, version check, callback<void> on_complete) override;
 
-    virtual future<get_acl_result> get_acl(string_view path) const override;
+    virtual future<get_acl_result> get_acl(path_view path) const override;
+    virtual void get_acl(path_view path, callback<get_acl_result> on_complete) const override;
 
-    virtual future<void> set_acl(string_view path, const acl& rules, acl_version check) override;
+    virtual future<void> set_acl(path_view path, const acl& rules, acl_version check) override;
+    virtual void set_acl(path_view path, const acl& rules, acl_version check, callback<void> on_complete) override;
 
     virtual future<multi_result> commit(multi_op&& txn) override;
+    virtual void commit(multi_op&& txn, callback<multi_result> on_complete) override;
+
+    /// Encodes the paths and ACLs of \a txn into what \c zoo_amulti takes once; each commit of the result only binds
+    /// the data and versions and allocates the buffers the C client writes the results into.
+    virtual prepared_multi prepare(multi_op txn) const override;
+
+    virtual future<multi_result> commit(const prepared_multi& txn) override;
+    virtual void commit(const prepared_multi& txn, callback<multi_result> on_complete) override;
+
+    virtual future<multi_result> commit(const multi_op_view& txn) override;
+    virtual void commit(const multi_op_view& txn, callback<multi_result> on_complete) override;
 
     virtual future<void> load_fence() override;
+    virtual void load_fence(callback<void> on_complete) override;
+
+    virtual future<get_result> get_config() override;
+    virtual void get_config(callback<get_result> on_complete) override;
+
+    virtual future<get_result> reconfigure(const std::vector<std::string>& joining,
+                                           const std::vector<std::string>& leaving,
+                                           const std::vector<std::string>& members,
+                                           version                         from_config
+                                          ) override;
+    virtual void reconfigure(const std::vector<std::string>& joining,
+                             const std::vector<std::string>& leaving,
+                             const std::vector<std::string>& members,
+                             version                         from_config,
+                             callback<get_result>            on_complete
+                            ) override;
+
+    /// Hands \a hosts to \c zoo_set_servers, which moves the session to one of them if that evens out the load: a
+    /// session whose server is no longer listed always moves, one whose server still is moves with the probability
+    /// that spreads the sessions evenly over the new list.
+    virtual void update_hosts(const std::vector<std::string>& hosts) override;
+
+    virtual optional<session_credentials> current_session() const override;
 
 private:
     static void on_session_event_raw(ptr<zhandle_t>  handle,
@@ -79,20 +223,121 @@ private:
 
     class child_watcher;
 
+    class child_list_watcher;
+
     class exists_watcher;
 
-    /** Erase the watch tracker for the watch with the value \a p.
+    /// Deliver a \ref state::closed event to every watch and forget them.
+    void close_watches();
+
+    /// Start measuring a request of \a type and take its share (\a count requests) of the read or write budget.
+    request_probe probe_for(request_type type,
+                            string_view  path,
+                            std::size_t  payload_size,
+                            std::size_t  count = 1U
+                           ) const;
+
+    /// The key a watch is tracked by, which is also the context the ZooKeeper client hands back when it triggers. Keys
+    /// are never reused, so a watch which was forgotten (see \ref set_watch) can not be mistaken for a later one.
+    using watch_key = std::uintptr_t;
+
+    /// Send the watch request made by \a submit for \a watcher, which is given the key to set the watch with and the
+    /// context for the completion of the initial data (a \c std::shared_ptr<TWatcher> owned by that completion). If
+    /// \a cancel is cancelled before the initial data arrives, the watch is forgotten and fails with
+    /// \ref error_code::operation_timeout.
+    template <typename TWatcher, typename FSubmit>
+    void set_watch(request_type              type,
+                   path_view                 path,
+                   std::shared_ptr<TWatcher> watcher,
+                   const cancellation_token& cancel,
+                   FSubmit&&                 submit
+                  );
+
+    void watch_impl(path_view                     path,
+                    std::shared_ptr<data_watcher> watcher,
+                    const cancellation_token&     cancel = cancellation_token()
+                   );
+
+    template <typename TWatcher>
+    void watch_children_impl(path_view                 path,
+                             std::shared_ptr<TWatcher> watcher,
+                             const cancellation_token& cancel = cancellation_token()
+                            );
+
+    void watch_exists_impl(path_view                       path,
+                           std::shared_ptr<exists_watcher> watcher,
+                           const cancellation_token&       cancel = cancellation_token()
+                          );
+
+    class watch_group_base;
+
+    template <typename TWatcher>
+    class watch_group;
+
+    using watch_group_table = std::unordered_map<std::string, std::shared_ptr<watch_group_base>>;
+
+    /// Set the watch of \a watcher by joining the identical watch (the same \a kind on the same \a path) which this
+    /// connection has already set or is setting. When there is none, \a submit is called with the callbacks of a new
+    /// watch to set, whose initial data and event go to every watcher which joins it before it triggers. That way, a
+    /// burst of watches on one entry costs a single request and a single registration with the ZooKeeper client.
+    template <typename TWatcher, typename FSubmit>
+    void coalesce_watch(char kind, path_view path, std::shared_ptr<TWatcher> watcher, FSubmit&& submit);
+
+    /// Stop joining watches to \a group, which was coalescing the watches under \a key.
+    void forget_watch_group(const std::string& key, ptr<const watch_group_base> group);
+
+    /// The watches which have been set but not yet delivered are spread over several tables, each with its own lock,
+    /// so that setting and delivering watches on unrelated entries rarely contend. The nodes of delivered watches are
+    /// kept for reuse, so the steady state of a watch-heavy workload does not allocate for the table at all.
+    struct watch_shard final
+    {
+        using table_type = std::unordered_map<watch_key, std::shared_ptr<watcher>>;
+
+        static constexpr std::size_t max_spare_nodes = 64U;
+
+        std::mutex                         protect;
+        table_type                         watches;
+        std::vector<table_type::node_type> spare_nodes;
+    };
+
+    static constexpr std::size_t watch_shard_count = 16U;
+
+    watch_shard& watch_shard_for(watch_key key);
+
+    /// Start tracking \a p. This must happen before the watch is sent to the server, since the server can trigger it
+    /// before the call which set it even returns.
+    ///
+    /// \returns The key \a p is tracked under.
+    watch_key register_watch(std::shared_ptr<watcher> p);
+
+    /** Erase the watch tracker for the watch with the \a key.
      *
-     *  \returns \c true if it was deleted (the watch should be delivered); \c false if \a p was not in the list.
+     *  \returns The tracker if it was erased (the watch should be delivered); \c nullptr if \a key was not in the list.
     **/
-    std::shared_ptr<watcher> try_extract_watch(ptr<const void> p);
+    std::shared_ptr<watcher> try_extract_watch(watch_key key);
 
     static void deliver_watch(ptr<zhandle_t> zh, int type_in, int state_in, ptr<const char>, ptr<void> proms_in);
 
+    /// The watcher of routed watches. They are all set with it and no context, so the ZooKeeper client keeps a single
+    /// registration for each path and kind of watch no matter how often it is set, and there is nothing to track here:
+    /// the event goes straight to the \ref connection::dispatcher.
+    static void deliver_routed_watch(ptr<zhandle_t> zh, int type_in, int state_in, ptr<const char> path, ptr<void>);
+
 private:
-    ptr<zhandle_t>                                                _handle;
-    std::unordered_map<ptr<const void>, std::shared_ptr<watcher>> _watches;
-    mutable std::mutex                                            _watches_protect;
+    // First so that it outlives anything which might still finish a request while the rest is torn down; mutable
+    // because const operations such as get_acl are measured too
+    mutable connection_metrics                 _metrics;
+    std::unique_ptr<in_flight_budget>          _read_budget;
+    std::unique_ptr<in_flight_budget>          _write_budget;
+    ptr<zhandle_t>                             _handle;
+    std::shared_ptr<buffer_pool>               _read_buffer_pool;
+    std::shared_ptr<connection_observer>       _observer;
+    std::shared_ptr<host_selector>             _selector;
+    std::shared_ptr<ordered_executor>          _completions;
+    std::array<watch_shard, watch_shard_count> _watch_shards;
+    std::atomic<watch_key>                     _next_watch_key;
+    std::mutex                                 _watch_groups_protect;
+    watch_group_table                          _watch_groups;
 };
 
 /// \}
@@ -0,0 +1,1757 @@
+#include "connection_zkn.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "acl.hpp"
+#include "buffer_pool.hpp"
+#include "cancellation.hpp"
+#include "error.hpp"
+#include "multi.hpp"
+#include "optional.hpp"
+#include "results.hpp"
+#include "types.hpp"
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Utility Functions                                                                                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/// Start a request message: the header (the transaction ID is filled in when the request is sent) and nothing else.
+jute_writer request_frame(jute_op op, std::size_t size_hint = 64U)
+{
+    jute_writer out(size_hint + 16U);
+    out.write_int(0);
+    out.write_int(static_cast<std::int32_t>(op));
+    return out;
+}
+
+/// The offset of the transaction ID in a request message.
+constexpr std::size_t xid_offset = 0U;
+
+std::string normalize_chroot(std::string chroot)
+{
+    while (!chroot.empty() && chroot.back() == '/')
+        chroot.pop_back();
+    return chroot;
+}
+
+/// Turn the code of a reply into the result of a request which was decoded by \a decode. The server is taken at its
+/// word on the sizes of things, so a reply which does not hold what it says fails as a \ref marshalling_error.
+template <typename TResult, typename FDecode>
+outcome<TResult> decode_reply(error_code rc, jute_reader& body, FDecode& decode)
+{
+    if (rc != error_code::ok)
+        return outcome<TResult>(rc);
+
+    try
+    {
+        return decode(body);
+    }
+    catch (...)
+    {
+        return outcome<TResult>(error_code::marshalling_error, std::current_exception());
+    }
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Watches                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// A watch the server has confirmed. It sits in one of the watch tables until its event arrives or the session ends.
+struct connection_zkn::watch_entry final
+{
+    explicit watch_entry(event_callback on_event) :
+            on_event(std::move(on_event))
+    { }
+
+    void deliver(event ev)
+    {
+        event_promise.set_value(ev);
+        if (on_event)
+            on_event(std::move(ev));
+    }
+
+    promise<event> event_promise;
+    event_callback on_event;
+};
+
+/// The initial result of a watch goes to whichever comes first of the reply and the cancellation of its token. When the
+/// token wins, the reply is dropped and the watch is never added to a table, so its event is not delivered either.
+template <typename TResult>
+class connection_zkn::initial_delivery final
+{
+public:
+    explicit initial_delivery(callback<TResult> on_complete) :
+            _settled(false),
+            _on_complete(std::move(on_complete))
+    { }
+
+    static std::shared_ptr<initial_delivery> create(callback<TResult> on_complete, const cancellation_token& cancel)
+    {
+        auto out = std::make_shared<initial_delivery>(std::move(on_complete));
+        if (cancel.can_cancel())
+        {
+            out->_cancel       = cancel;
+            out->_registration = cancel.on_cancel([target = std::weak_ptr<initial_delivery>(out)]
+                                                  {
+                                                      if (auto self = target.lock())
+                                                          if (!self->_settled.exchange(true))
+                                                              self->_on_complete(error_code::operation_timeout);
+                                                  }
+                                                 );
+        }
+        return out;
+    }
+
+    /// Take the right to deliver the result.
+    ///
+    /// \returns \c false if the token was cancelled first, in which case the result must be dropped.
+    bool claim()
+    {
+        if (_settled.exchange(true))
+            return false;
+
+        _cancel.forget(_registration);
+        return true;
+    }
+
+    void deliver(outcome<TResult> result)
+    {
+        _on_complete(std::move(result));
+    }
+
+private:
+    std::atomic<bool>                _settled;
+    callback<TResult>                _on_complete;
+    cancellation_token               _cancel;
+    cancellation_token::registration _registration = 0U;
+};
+
+void connection_zkn::add_watch(watch_table& table, std::string path, std::shared_ptr<watch_entry> entry)
+{
+    table[std::move(path)].emplace_back(std::move(entry));
+    _metrics.on_watch_set();
+}
+
+template <typename TResult, typename FComplete>
+void connection_zkn::set_watch(request_type              type,
+                               jute_op                   op,
+                               path_view                 path,
+                               callback<TResult>         on_complete,
+                               event_callback            on_event,
+                               const cancellation_token& cancel,
+                               FComplete                 complete
+                              )
+{
+    if (cancel.cancelled())
+        return on_complete(error_code::operation_timeout);
+
+    auto initial = initial_delivery<TResult>::create(std::move(on_complete), cancel);
+    auto entry   = std::make_shared<watch_entry>(std::move(on_event));
+
+    auto frame = request_frame(op, path.size());
+    write_path(frame, path.view());
+    frame.write_bool(true);
+    submit(type,
+           path.size(),
+           std::move(frame),
+           [initial, entry, complete = std::move(complete)] (error_code rc, jute_reader& body) mutable
+           {
+               if (!initial->claim())
+                   return;
+
+               auto decode = [&] (jute_reader& body) { return complete(rc, body, entry); };
+               // The server answers a watch on a missing entry with no_entry, which exists has to see
+               if (rc == error_code::ok || rc == error_code::no_entry)
+                   initial->deliver(decode_reply<TResult>(error_code::ok, body, decode));
+               else
+                   initial->deliver(rc);
+           }
+          );
+}
+
+void connection_zkn::deliver_notification(jute_reader& body)
+{
+    auto ev_type = static_cast<event_type>(body.read_int());
+    auto ev_state = static_cast<zk::state>(body.read_int());
+    auto path = strip_chroot(body.read_string());
+
+    std::vector<std::shared_ptr<watch_entry>> fired;
+    auto take = [&] (watch_table& table)
+                {
+                    auto iter = table.find(path);
+                    if (iter == table.end())
+                        return;
+
+                    for (auto& entry : iter->second)
+                        fired.emplace_back(std::move(entry));
+                    table.erase(iter);
+                };
+
+    switch (ev_type)
+    {
+    case event_type::created:
+    case event_type::changed:
+        take(_data_watches);
+        take(_exist_watches);
+        break;
+    case event_type::erased:
+        take(_data_watches);
+        take(_exist_watches);
+        take(_child_watches);
+        break;
+    case event_type::child:
+        take(_child_watches);
+        break;
+    default:
+        break;
+    }
+
+    for (auto& entry : fired)
+    {
+        _metrics.on_watch_fired();
+        entry->deliver(event(ev_type, ev_state, path));
+    }
+}
+
+void connection_zkn::send_set_watches()
+{
+    // Long lists are split so that no message gets near the default limit of the server (jute.maxbuffer)
+    static constexpr std::size_t max_batch_size = 128U * 1024U;
+
+    std::array<std::vector<string_view>, 3U> lists;
+    std::array<ptr<const watch_table>, 3U>   tables = { { &_data_watches, &_exist_watches, &_child_watches } };
+    for (std::size_t kind = 0U; kind < tables.size(); ++kind)
+    {
+        lists[kind].reserve(tables[kind]->size());
+        for (const auto& entry : *tables[kind])
+            lists[kind].emplace_back(entry.first);
+    }
+
+    std::array<std::size_t, 3U> next = { { 0U, 0U, 0U } };
+    auto done = [&]
+                {
+                    for (std::size_t kind = 0U; kind < lists.size(); ++kind)
+                        if (next[kind] < lists[kind].size())
+                            return false;
+                    return true;
+                };
+
+    while (!done())
+    {
+        auto        last       = next;
+        std::size_t batch_size = 0U;
+        for (std::size_t kind = 0U; kind < lists.size(); ++kind)
+        {
+            while (last[kind] < lists[kind].size()
+                   && (batch_size == 0U || batch_size + lists[kind][last[kind]].size() <= max_batch_size)
+                  )
+            {
+                batch_size += lists[kind][last[kind]].size() + _chroot.size() + 4U;
+                ++last[kind];
+            }
+        }
+
+        jute_writer frame(batch_size + 32U);
+        frame.write_int(jute_xid::set_watches);
+        frame.write_int(static_cast<std::int32_t>(jute_op::set_watches));
+        frame.write_long(_last_zxid);
+        for (std::size_t kind = 0U; kind < lists.size(); ++kind)
+        {
+            frame.write_int(std::int32_t(last[kind] - next[kind]));
+            for (std::size_t idx = next[kind]; idx < last[kind]; ++idx)
+                write_path(frame, lists[kind][idx]);
+        }
+        queue_bytes(std::move(frame).finish());
+        next = last;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// connection_zkn                                                                                                     //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename FTask>
+void connection_zkn::post(FTask&& task)
+{
+    _loop->post([this, life = std::weak_ptr<int>(_life), task = std::forward<FTask>(task)] () mutable
+                {
+                    if (auto alive = life.lock())
+                    {
+                        if (_phase == phase::closed)
+                            return;
+
+                        task();
+                        arm_timer();
+                    }
+                }
+               );
+}
+
+connection_zkn::connection_zkn(const connection_params& params) :
+        _reactor(params.io_reactor() ? params.io_reactor() : reactor::shared(params.transport())),
+        _loop(&_reactor->next_loop()),
+        _chroot(normalize_chroot(params.chroot())),
+        _requested_timeout(params.timeout()),
+        _read_only_allowed(params.read_only()),
+        _selector(host_selector::create(params)),
+        _read_buffer_pool(params.read_buffer_pool()),
+        _multi_read_refused(false),
+        _state(zk::state::connecting),
+        _life(std::make_shared<int>(0)),
+        _flush_posted(false),
+        _close_requested(false),
+        _refuse_with(error_code::ok),
+        _phase(phase::backoff),
+        _socket(-1),
+        _timer(-1),
+        _generation(0U),
+        _hosts(params.hosts()),
+        _next_host(0U),
+        _failed_attempts(0U),
+        _session_id(0),
+        _session_password(jute_password_size, '\0'),
+        _session_timeout(params.timeout()),
+        _last_zxid(0),
+        _next_xid(1),
+        _recv_used(0U),
+        _close_done(nullptr)
+{
+    if (params.connection_schema() != "zkn")
+        throw std::invalid_argument(std::string("Invalid connection string \"") + to_string(params) + "\"");
+    if (_hosts.empty())
+        throw std::invalid_argument(std::string("No hosts to connect to in \"") + to_string(params) + "\"");
+    if (params.max_reads_in_flight() != 0U || params.max_writes_in_flight() != 0U)
+        throw std::invalid_argument("The zkn connection does not limit the requests in flight");
+    if (params.observer())
+        throw std::invalid_argument("The zkn connection does not support a connection_observer");
+    if (params.completion_executor())
+        throw std::invalid_argument("The zkn connection does not support a completion_executor");
+
+    if (const auto& creds = params.resume_session())
+    {
+        if (creds->password.size() != jute_password_size)
+            throw std::invalid_argument("A session password is " + std::to_string(jute_password_size) + " bytes, not "
+                                        + std::to_string(creds->password.size())
+                                       );
+
+        // The handshake asks for this session instead of a new one
+        _session_id       = creds->id;
+        _session_password = creds->password;
+    }
+
+    _selector->order(_hosts);
+
+    _timer = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (_timer == -1)
+        throw std::system_error(errno, std::system_category(), "timerfd_create");
+
+    post([this]
+         {
+             _loop->watch(_timer, EPOLLIN, *this);
+             start_connect();
+         }
+        );
+}
+
+connection_zkn::~connection_zkn() noexcept
+{
+    // Tasks still queued on the loop must not touch this once it is gone
+    _life.reset();
+    close();
+}
+
+void connection_zkn::close()
+{
+    {
+        std::unique_lock<std::mutex> ax(_submit_protect);
+        if (std::exchange(_close_requested, true))
+            return;
+        _refuse_with = error_code::closed;
+    }
+
+    if (_loop->in_loop_thread())
+    {
+        begin_close(nullptr);
+    }
+    else
+    {
+        // This can not go through post, as the destructor has already let go of _life
+        std::promise<void> done;
+        auto               done_future = done.get_future();
+        _loop->post([this, &done] { begin_close([&done] (outcome<void>) { done.set_value(); }); });
+        done_future.wait();
+    }
+}
+
+void connection_zkn::close_async(callback<void> on_closed)
+{
+    auto self = weak_from_this().lock();
+    if (!self || _loop->in_loop_thread())
+        return connection::close_async(std::move(on_closed));
+
+    {
+        std::unique_lock<std::mutex> ax(_submit_protect);
+        if (std::exchange(_close_requested, true))
+        {
+            ax.unlock();
+            return on_closed(outcome<void>());
+        }
+        _refuse_with = error_code::closed;
+    }
+
+    // The callback holds on to this until the session is over, however soon the caller lets go of it
+    _loop->post([self, on_closed = std::move(on_closed)] () mutable
+                {
+                    auto& conn = *self;
+                    conn.begin_close([self = std::move(self), on_closed = std::move(on_closed)] (outcome<void> result)
+                                     {
+                                         on_closed(std::move(result));
+                                     }
+                                    );
+                }
+               );
+}
+
+zk::state connection_zkn::state() const
+{
+    return _state.load(std::memory_order_acquire);
+}
+
+metrics_snapshot connection_zkn::metrics() const
+{
+    return _metrics.snapshot();
+}
+
+void connection_zkn::set_state(zk::state new_state)
+{
+    if (_state.exchange(new_state, std::memory_order_acq_rel) == new_state)
+        return;
+
+    _metrics.on_state_change(new_state);
+    on_session_event(new_state);
+}
+
+void connection_zkn::write_path(jute_writer& frame, string_view path) const
+{
+    if (_chroot.empty())
+        frame.write_string(path);
+    else if (path == "/")
+        frame.write_string(_chroot);
+    else
+        frame.write_string(_chroot, path);
+}
+
+std::string connection_zkn::strip_chroot(string_view path) const
+{
+    if (_chroot.empty() || path.substr(0U, _chroot.size()) != _chroot)
+        return std::string(path);
+
+    auto rest = path.substr(_chroot.size());
+    if (rest.empty())
+        return "/";
+    else if (rest.front() == '/')
+        return std::string(rest);
+    else
+        return std::string(path);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sending                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void connection_zkn::submit(request_type type, std::size_t payload_size, jute_writer frame, reply_handler on_reply)
+{
+    _metrics.on_submit(payload_size);
+    request req{ type, true, clock::now(), std::move(frame), std::move(on_reply), 0 };
+
+    error_code refused;
+    bool       first;
+    {
+        std::unique_lock<std::mutex> ax(_submit_protect);
+        refused = _refuse_with;
+        if (refused == error_code::ok)
+        {
+            _submitted.emplace_back(std::move(req));
+            first = !std::exchange(_flush_posted, true);
+        }
+    }
+
+    if (refused != error_code::ok)
+    {
+        jute_reader empty;
+        complete(req, refused, empty);
+    }
+    else if (first)
+    {
+        // Everything submitted until the loop gets to this goes out in the same write
+        post([this] { take_submissions(); });
+    }
+}
+
+void connection_zkn::take_submissions()
+{
+    std::vector<request> batch;
+    {
+        std::unique_lock<std::mutex> ax(_submit_protect);
+        batch.swap(_submitted);
+        _flush_posted = false;
+    }
+
+    for (auto& req : batch)
+    {
+        if (_phase == phase::connected)
+            send(std::move(req));
+        else
+            _waiting.emplace_back(std::move(req));
+    }
+    flush();
+}
+
+void connection_zkn::send(request req)
+{
+    req.xid = _next_xid;
+    _next_xid = _next_xid == INT_MAX ? 1 : _next_xid + 1;
+
+    req.frame.patch_int(xid_offset, req.xid);
+    queue_bytes(std::move(req.frame).finish());
+    _in_flight.emplace_back(std::move(req));
+}
+
+void connection_zkn::queue_bytes(std::vector<char> bytes)
+{
+    if (_send_buffer.empty())
+        _send_buffer = std::move(bytes);
+    else
+        _send_buffer.insert(_send_buffer.end(), bytes.begin(), bytes.end());
+}
+
+void connection_zkn::flush()
+{
+    if (_socket == -1 || _phase == phase::connecting || _send_buffer.empty())
+        return;
+
+    // Everything queued since the last flush goes to the loop as one piece
+    _loop->send(_socket, std::move(_send_buffer));
+    _send_buffer.clear();
+    _last_send = clock::now();
+}
+
+void connection_zkn::complete(request& req, error_code rc, jute_reader& body)
+{
+    if (req.measured)
+        _metrics.on_complete(req.type, clock::now() - req.start, rc);
+    req.on_reply(rc, body);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Session                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void connection_zkn::start_connect()
+{
+    auto host = split_host(_hosts[_next_host]);
+    _next_host = (_next_host + 1U) % _hosts.size();
+
+    ::addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    ptr<::addrinfo> found = nullptr;
+    if (::getaddrinfo(host.first.c_str(), host.second.c_str(), &hints, &found) != 0 || !found)
+        return retry_later();
+
+    int fd = ::socket(found->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int rc = fd == -1 ? -1 : ::connect(fd, found->ai_addr, found->ai_addrlen);
+    int err = errno;
+    ::freeaddrinfo(found);
+
+    if (fd == -1)
+        return retry_later();
+    if (rc == -1 && err != EINPROGRESS)
+    {
+        ::close(fd);
+        return retry_later();
+    }
+
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+    // The server gets a share of the session timeout, so every host can be tried before the session is lost
+    auto attempt_timeout = std::max(_requested_timeout / std::chrono::milliseconds::rep(_hosts.size()),
+                                    std::chrono::milliseconds(1000)
+                                   );
+
+    _socket      = fd;
+    _phase       = phase::connecting;
+    _deadline    = clock::now() + attempt_timeout;
+    _loop->watch(_socket, EPOLLOUT, *this);
+}
+
+void connection_zkn::on_connect_complete()
+{
+    int       err = 0;
+    socklen_t len = sizeof err;
+    if (::getsockopt(_socket, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err != 0)
+    {
+        drop_socket();
+        return retry_later();
+    }
+
+    jute_writer frame(48U);
+    frame.write_int(0); // protocol version
+    frame.write_long(_last_zxid);
+    frame.write_int(std::int32_t(_requested_timeout.count()));
+    frame.write_long(_session_id);
+    frame.write_buffer(_session_password.data(), _session_password.size());
+    frame.write_bool(_read_only_allowed);
+
+    // From here on the loop does the reading and writing
+    _phase     = phase::handshaking;
+    _loop->forget(_socket);
+    _loop->attach(_socket, *this);
+    _last_recv = clock::now();
+    queue_bytes(std::move(frame).finish());
+    flush();
+}
+
+void connection_zkn::on_handshake(jute_reader& body)
+{
+    body.read_int(); // protocol version
+    auto timeout    = body.read_int();
+    auto session_id = body.read_long();
+    auto password   = body.read_buffer();
+    // Servers before 3.4 do not send the read-only flag
+    bool read_only  = body.remaining() > 0U && body.read_bool();
+
+    if (timeout <= 0)
+        return finish(zk::state::expired_session, error_code::session_expired);
+
+    _session_id       = session_id;
+    _session_password = std::string(password);
+    {
+        std::unique_lock<std::mutex> ax(_session_protect);
+        _published_session = session_credentials{ _session_id, _session_password };
+    }
+    _session_timeout  = std::chrono::milliseconds(timeout);
+    _failed_attempts  = 0U;
+    _phase            = phase::connected;
+    _last_recv        = clock::now();
+    _last_send        = _last_recv;
+
+    // The watches go first, so the server knows about them before the requests which were waiting make changes
+    send_set_watches();
+    auto waiting = std::move(_waiting);
+    _waiting.clear();
+    for (auto& req : waiting)
+        send(std::move(req));
+    flush();
+
+    if (_phase == phase::connected)
+        set_state(read_only ? zk::state::read_only : zk::state::connected);
+}
+
+void connection_zkn::on_reply(jute_reader& body)
+{
+    auto xid  = body.read_int();
+    auto zxid = body.read_long();
+    auto err  = body.read_int();
+    if (zxid > _last_zxid)
+        _last_zxid = zxid;
+
+    switch (xid)
+    {
+    case jute_xid::notification:
+        return deliver_notification(body);
+    case jute_xid::ping:
+        if (_ping_sent != clock::time_point())
+        {
+            auto round_trip = std::chrono::duration_cast<host_latency_table::duration_type>(clock::now() - _ping_sent);
+            host_latency_table::shared().record(current_host(), round_trip);
+            _ping_sent = clock::time_point();
+        }
+        return;
+    case jute_xid::set_watches:
+        return;
+    default:
+        break;
+    }
+
+    // The server answers in the order the requests were sent, so anything else means the stream is broken
+    if (_in_flight.empty() || _in_flight.front().xid != xid)
+        return connection_lost();
+
+    auto req = std::move(_in_flight.front());
+    _in_flight.pop_front();
+    complete(req, error_code_from_wire(err), body);
+}
+
+std::pair<ptr<char>, std::size_t> connection_zkn::receive_space(int)
+{
+    static constexpr std::size_t min_read_size = 64U * 1024U;
+
+    if (_recv_buffer.size() - _recv_used < min_read_size)
+        _recv_buffer.resize(std::max(_recv_buffer.size() * 2U, _recv_used + min_read_size));
+    return { _recv_buffer.data() + _recv_used, _recv_buffer.size() - _recv_used };
+}
+
+void connection_zkn::on_received(int, std::size_t count)
+{
+    // Whatever a callback lets go of, this stays around until the bytes are handled
+    auto self = weak_from_this().lock();
+
+    _recv_used += count;
+    _last_recv = clock::now();
+    process_messages();
+    arm_timer();
+}
+
+void connection_zkn::on_stream_error(int, int)
+{
+    auto self = weak_from_this().lock();
+
+    connection_lost();
+    arm_timer();
+}
+
+void connection_zkn::process_messages()
+{
+    auto        generation = _generation;
+    const char* iter       = _recv_buffer.data();
+    const char* last       = _recv_buffer.data() + _recv_used;
+    jute_reader body;
+    while (true)
+    {
+        try
+        {
+            if (!next_jute_message(iter, last, body))
+                break;
+
+            if (_phase == phase::handshaking)
+                on_handshake(body);
+            else
+                on_reply(body);
+        }
+        catch (const marshalling_error&)
+        {
+            return connection_lost();
+        }
+
+        // The connection was dropped or closed by the message (or by whoever it was delivered to)
+        if (generation != _generation)
+            return;
+    }
+
+    auto offset = std::size_t(iter - _recv_buffer.data());
+    if (offset > 0U)
+    {
+        std::memmove(_recv_buffer.data(), iter, _recv_used - offset);
+        _recv_used -= offset;
+    }
+}
+
+void connection_zkn::drop_socket()
+{
+    if (_socket != -1)
+    {
+        _loop->forget(_socket);
+        ::close(_socket);
+        _socket = -1;
+    }
+
+    ++_generation;
+    _ping_sent = clock::time_point();
+    _send_buffer.clear();
+    // The storage is kept, as it may be what the reply being delivered right now points into
+    _recv_used = 0U;
+}
+
+void connection_zkn::retry_later()
+{
+    // Back off from 10ms up to a second while no server will have the session
+    auto delay = std::chrono::milliseconds(10) * (1U << std::min(_failed_attempts, 7U));
+    ++_failed_attempts;
+
+    // The next session to pick servers by their distance should check on this one again
+    host_latency_table::shared().forget(current_host());
+
+    _phase    = phase::backoff;
+    _deadline = clock::now() + std::min(delay, std::chrono::milliseconds(1000));
+}
+
+void connection_zkn::connection_lost()
+{
+    if (_phase == phase::closing)
+        return finish(zk::state::closed, error_code::closed);
+
+    bool was_connected = _phase == phase::connected;
+    drop_socket();
+
+    auto failed = std::move(_in_flight);
+    _in_flight.clear();
+    if (was_connected)
+    {
+        // Straight on to the next server
+        _phase    = phase::backoff;
+        _deadline = clock::now();
+        set_state(zk::state::connecting);
+    }
+    else
+    {
+        retry_later();
+    }
+
+    for (auto& req : failed)
+    {
+        jute_reader empty;
+        complete(req, error_code::connection_loss, empty);
+    }
+}
+
+const std::string& connection_zkn::current_host() const
+{
+    return _hosts[(_next_host + _hosts.size() - 1U) % _hosts.size()];
+}
+
+std::chrono::milliseconds connection_zkn::read_timeout() const
+{
+    return _session_timeout * 2 / 3;
+}
+
+connection_zkn::clock::time_point connection_zkn::next_deadline() const
+{
+    switch (_phase)
+    {
+    case phase::connected:
+        return std::min(_last_recv + read_timeout(), _last_send + read_timeout() / 2);
+    case phase::closed:
+        return clock::time_point::max();
+    default:
+        return _deadline;
+    }
+}
+
+void connection_zkn::arm_timer()
+{
+    if (_timer == -1)
+        return;
+
+    auto when = next_deadline();
+    if (when == _armed_for)
+        return;
+    _armed_for = when;
+
+    ::itimerspec spec{};
+    if (when != clock::time_point::max())
+    {
+        auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(when - clock::now());
+        delay      = std::max(delay, std::chrono::nanoseconds(1000));
+        spec.it_value.tv_sec  = std::chrono::duration_cast<std::chrono::seconds>(delay).count();
+        spec.it_value.tv_nsec = (delay % std::chrono::seconds(1)).count();
+    }
+    ::timerfd_settime(_timer, 0, &spec, nullptr);
+}
+
+void connection_zkn::on_timer()
+{
+    std::uint64_t expirations;
+    while (::read(_timer, &expirations, sizeof expirations) == -1 && errno == EINTR)
+    { }
+    _armed_for = clock::time_point();
+
+    auto now = clock::now();
+    switch (_phase)
+    {
+    case phase::backoff:
+        if (now >= _deadline)
+            start_connect();
+        break;
+    case phase::connecting:
+    case phase::handshaking:
+        if (now >= _deadline)
+        {
+            drop_socket();
+            retry_later();
+        }
+        break;
+    case phase::connected:
+        if (now >= _last_recv + read_timeout())
+        {
+            connection_lost();
+        }
+        else if (now >= _last_send + read_timeout() / 2)
+        {
+            auto ping = request_frame(jute_op::ping, 0U);
+            ping.patch_int(xid_offset, jute_xid::ping);
+            queue_bytes(std::move(ping).finish());
+            flush();
+
+            // A ping sent behind other requests is only answered after them, which says little about the distance
+            if (_in_flight.empty() && _ping_sent == clock::time_point())
+                _ping_sent = clock::now();
+        }
+        break;
+    case phase::closing:
+        if (now >= _deadline)
+            finish(zk::state::closed, error_code::closed);
+        break;
+    case phase::closed:
+        break;
+    }
+}
+
+void connection_zkn::on_ready(int fd, std::uint32_t)
+{
+    // Whatever a callback lets go of, this stays around until the event is handled
+    auto self = weak_from_this().lock();
+
+    // Only the timer and a socket still connecting are watched; once connected, the socket is a stream of the loop
+    if (fd == _timer)
+        on_timer();
+    else if (fd == _socket && _phase == phase::connecting)
+        on_connect_complete();
+
+    arm_timer();
+}
+
+void connection_zkn::begin_close(callback<void> done)
+{
+    if (_phase == phase::closed)
+    {
+        // The session expired before this, which is still a state to move out of
+        set_state(zk::state::closed);
+        if (done)
+            done(outcome<void>());
+        return;
+    }
+
+    if (_phase == phase::connected)
+    {
+        auto frame = request_frame(jute_op::close_session, 0U);
+        if (done)
+        {
+            _close_done = std::move(done);
+            send(request{ request_type::erase,
+                          false,
+                          clock::now(),
+                          std::move(frame),
+                          [this] (error_code, jute_reader&) { finish(zk::state::closed, error_code::closed); },
+                          0
+                        }
+                );
+            _phase    = phase::closing;
+            _deadline = clock::now() + std::min(read_timeout(), std::chrono::milliseconds(2000));
+            flush();
+            arm_timer();
+            return;
+        }
+        else
+        {
+            // On the loop thread there is no waiting for the answer, but the server still hears it is over
+            frame.patch_int(xid_offset, _next_xid);
+            queue_bytes(std::move(frame).finish());
+            flush();
+        }
+    }
+
+    _close_done = std::move(done);
+    finish(zk::state::closed, error_code::closed);
+}
+
+void connection_zkn::finish(zk::state final_state, error_code fail_with)
+{
+    if (_phase == phase::closed)
+        return;
+    _phase = phase::closed;
+
+    {
+        std::unique_lock<std::mutex> ax(_session_protect);
+        _published_session = nullopt;
+    }
+
+    drop_socket();
+    if (_timer != -1)
+    {
+        _loop->forget(_timer);
+        ::close(_timer);
+        _timer = -1;
+    }
+
+    std::vector<request> submitted;
+    {
+        std::unique_lock<std::mutex> ax(_submit_protect);
+        if (_refuse_with == error_code::ok)
+            _refuse_with = fail_with;
+        submitted.swap(_submitted);
+    }
+
+    auto failed = std::move(_in_flight);
+    _in_flight.clear();
+    for (auto& req : _waiting)
+        failed.emplace_back(std::move(req));
+    _waiting.clear();
+    for (auto& req : submitted)
+        failed.emplace_back(std::move(req));
+
+    std::vector<std::shared_ptr<watch_entry>> watches;
+    for (auto table : { &_data_watches, &_exist_watches, &_child_watches })
+    {
+        for (auto& entry : *table)
+            for (auto& watch : entry.second)
+                watches.emplace_back(std::move(watch));
+        table->clear();
+    }
+
+    auto done = std::exchange(_close_done, nullptr);
+    set_state(final_state);
+
+    for (auto& req : failed)
+    {
+        jute_reader empty;
+        complete(req, fail_with, empty);
+    }
+
+    for (auto& watch : watches)
+        watch->deliver(event(event_type::session, final_state));
+
+    // The thread waiting in close may destroy this as soon as it is told, and the reply or event which got here may
+    // still be unwinding through this; so it is told once the loop is back to its own tasks
+    if (done)
+        _loop->post([done] { done(outcome<void>()); });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Operations                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename TResult, typename FDecode>
+void connection_zkn::call(request_type      type,
+                          std::size_t       payload_size,
+                          jute_writer       frame,
+                          callback<TResult> on_complete,
+                          FDecode           decode
+                         )
+{
+    submit(type,
+           payload_size,
+           std::move(frame),
+           [on_complete = std::move(on_complete), decode = std::move(decode)] (error_code rc, jute_reader& body) mutable
+           {
+               on_complete(decode_reply<TResult>(rc, body, decode));
+           }
+          );
+}
+
+void connection_zkn::get(path_view path, callback<get_result> on_complete)
+{
+    auto frame = request_frame(jute_op::get_data, path.size());
+    write_path(frame, path.view());
+    frame.write_bool(false);
+    call<get_result>(request_type::get,
+                     path.size(),
+                     std::move(frame),
+                     std::move(on_complete),
+                     [this] (jute_reader& body) { return read_data(body); }
+                    );
+}
+
+get_result connection_zkn::read_data(jute_reader& body)
+{
+    auto data = body.read_buffer();
+    auto st   = body.read_stat();
+    _metrics.on_receive(data.size());
+    if (_read_buffer_pool)
+        return get_result(_read_buffer_pool->acquire(data.data(), data.data() + data.size()), st, _read_buffer_pool);
+    else
+        return get_result(buffer(data.data(), data.data() + data.size()), st);
+}
+
+void connection_zkn::get_into(path_view path, buffer& target, callback<zk::stat> on_complete)
+{
+    auto frame = request_frame(jute_op::get_data, path.size());
+    write_path(frame, path.view());
+    frame.write_bool(false);
+    call<zk::stat>(request_type::get,
+                   path.size(),
+                   std::move(frame),
+                   std::move(on_complete),
+                   [this, &target] (jute_reader& body)
+                   {
+                       auto data = body.read_buffer();
+                       auto st   = body.read_stat();
+                       _metrics.on_receive(data.size());
+                       target.assign(data.data(), data.data() + data.size());
+                       return st;
+                   }
+                  );
+}
+
+void connection_zkn::watch(path_view path, callback<watch_result> on_complete)
+{
+    watch(path, std::move(on_complete), nullptr, cancellation_token());
+}
+
+void connection_zkn::watch(path_view path, callback<watch_result> on_complete, event_callback on_event)
+{
+    watch(path, std::move(on_complete), std::move(on_event), cancellation_token());
+}
+
+void connection_zkn::watch(path_view                 path,
+                           callback<watch_result>    on_complete,
+                           event_callback            on_event,
+                           const cancellation_token& cancel
+                          )
+{
+    set_watch<watch_result>(request_type::watch,
+                            jute_op::get_data,
+                            path,
+                            std::move(on_complete),
+                            std::move(on_event),
+                            cancel,
+                            [this, key = std::string(path.view())]
+                            (error_code rc, jute_reader& body, const std::shared_ptr<watch_entry>& entry) mutable
+                            {
+                                if (rc != error_code::ok)
+                                    return outcome<watch_result>(rc);
+
+                                auto data = body.read_buffer();
+                                auto st   = body.read_stat();
+                                _metrics.on_receive(data.size());
+                                add_watch(_data_watches, std::move(key), entry);
+                                return outcome<watch_result>(
+                                        watch_result(get_result(buffer(data.data(), data.data() + data.size()), st),
+                                                     entry->event_promise.get_future()
+                                                    )
+                                       );
+                            }
+                           );
+}
+
+void connection_zkn::get_children(path_view path, callback<get_children_result> on_complete)
+{
+    auto frame = request_frame(jute_op::get_children2, path.size());
+    write_path(frame, path.view());
+    frame.write_bool(false);
+    call<get_children_result>(request_type::get_children,
+                              path.size(),
+                              std::move(frame),
+                              std::move(on_complete),
+                              [] (jute_reader& body)
+                              {
+                                  auto children = body.read_string_vector();
+                                  auto st       = body.read_stat();
+                                  return get_children_result(std::move(children), st);
+                              }
+                             );
+}
+
+void connection_zkn::get_children_list(path_view path, callback<get_children_list_result> on_complete)
+{
+    auto frame = request_frame(jute_op::get_children2, path.size());
+    write_path(frame, path.view());
+    frame.write_bool(false);
+    call<get_children_list_result>(request_type::get_children,
+                                   path.size(),
+                                   std::move(frame),
+                                   std::move(on_complete),
+                                   [] (jute_reader& body)
+                                   {
+                                       auto children = body.read_children_list();
+                                       auto st       = body.read_stat();
+                                       return get_children_list_result(std::move(children), st);
+                                   }
+                                  );
+}
+
+void connection_zkn::watch_children(path_view path, callback<watch_children_result> on_complete)
+{
+    watch_children(path, std::move(on_complete), nullptr, cancellation_token());
+}
+
+void connection_zkn::watch_children(path_view                       path,
+                                    callback<watch_children_result> on_complete,
+                                    event_callback                  on_event
+                                   )
+{
+    watch_children(path, std::move(on_complete), std::move(on_event), cancellation_token());
+}
+
+void connection_zkn::watch_children(path_view                       path,
+                                    callback<watch_children_result> on_complete,
+                                    event_callback                  on_event,
+                                    const cancellation_token&       cancel
+                                   )
+{
+    set_watch<watch_children_result>(request_type::watch_children,
+                                     jute_op::get_children2,
+                                     path,
+                                     std::move(on_complete),
+                                     std::move(on_event),
+                                     cancel,
+                                     [this, key = std::string(path.view())]
+                                     (error_code                          rc,
+                                      jute_reader&                        body,
+                                      const std::shared_ptr<watch_entry>& entry
+                                     ) mutable
+                                     {
+                                         if (rc != error_code::ok)
+                                             return outcome<watch_children_result>(rc);
+
+                                         auto children = body.read_string_vector();
+                                         auto st       = body.read_stat();
+                                         add_watch(_child_watches, std::move(key), entry);
+                                         return outcome<watch_children_result>(
+                                                 watch_children_result(get_children_result(std::move(children), st),
+                                                                       entry->event_promise.get_future()
+                                                                      )
+                                                );
+                                     }
+                                    );
+}
+
+void connection_zkn::exists(path_view path, callback<exists_result> on_complete)
+{
+    auto frame = request_frame(jute_op::exists, path.size());
+    write_path(frame, path.view());
+    frame.write_bool(false);
+    submit(request_type::exists,
+           path.size(),
+           std::move(frame),
+           [on_complete = std::move(on_complete)] (error_code rc, jute_reader& body)
+           {
+               auto decode = [] (jute_reader& body) { return exists_result(body.read_stat()); };
+               if (rc == error_code::no_entry)
+                   on_complete(exists_result(nullopt));
+               else
+                   on_complete(decode_reply<exists_result>(rc, body, decode));
+           }
+          );
+}
+
+void connection_zkn::watch_exists(path_view path, callback<watch_exists_result> on_complete)
+{
+    watch_exists(path, std::move(on_complete), nullptr, cancellation_token());
+}
+
+void connection_zkn::watch_exists(path_view                     path,
+                                  callback<watch_exists_result> on_complete,
+                                  event_callback                on_event
+                                 )
+{
+    watch_exists(path, std::move(on_complete), std::move(on_event), cancellation_token());
+}
+
+void connection_zkn::watch_exists(path_view                     path,
+                                  callback<watch_exists_result> on_complete,
+                                  event_callback                on_event,
+                                  const cancellation_token&     cancel
+                                 )
+{
+    set_watch<watch_exists_result>(request_type::watch_exists,
+                                   jute_op::exists,
+                                   path,
+                                   std::move(on_complete),
+                                   std::move(on_event),
+                                   cancel,
+                                   [this, key = std::string(path.view())]
+                                   (error_code rc, jute_reader& body, const std::shared_ptr<watch_entry>& entry) mutable
+                                   {
+                                       // Like the server, an entry which is there is watched for its data and one which
+                                       // is not is watched for its creation
+                                       optional<zk::stat> st;
+                                       if (rc == error_code::ok)
+                                           st = body.read_stat();
+                                       add_watch(st ? _data_watches : _exist_watches, std::move(key), entry);
+                                       return outcome<watch_exists_result>(
+                                               watch_exists_result(exists_result(st), entry->event_promise.get_future())
+                                              );
+                                   }
+                                  );
+}
+
+template <typename TRules>
+void connection_zkn::create_impl(path_view               path,
+                                 const buffer&           data,
+                                 const TRules&           rules,
+                                 create_mode             mode,
+                                 callback<create_result> on_complete
+                                )
+{
+    bool container = is_set(mode, create_mode::container);
+    auto frame = request_frame(container ? jute_op::create_container : jute_op::create, path.size() + data.size());
+    write_path(frame, path.view());
+    frame.write_buffer(data);
+    frame.write_acl(rules);
+    frame.write_int(static_cast<std::int32_t>(mode));
+    call<create_result>(request_type::create,
+                        path.size() + data.size(),
+                        std::move(frame),
+                        std::move(on_complete),
+                        [this] (jute_reader& body)
+                        {
+                            // Containers are created with the newer request, whose response carries a stat as well
+                            return create_result(strip_chroot(body.read_string()));
+                        }
+                       );
+}
+
+void connection_zkn::create(path_view               path,
+                            const buffer&           data,
+                            const acl&              rules,
+                            create_mode             mode,
+                            callback<create_result> on_complete
+                           )
+{
+    create_impl(path, data, rules, mode, std::move(on_complete));
+}
+
+void connection_zkn::create(path_view               path,
+                            const buffer&           data,
+                            const acl_handle&       rules,
+                            create_mode             mode,
+                            callback<create_result> on_complete
+                           )
+{
+    create_impl(path, data, rules, mode, std::move(on_complete));
+}
+
+void connection_zkn::set(path_view path, const buffer& data, version check, callback<set_result> on_complete)
+{
+    auto frame = request_frame(jute_op::set_data, path.size() + data.size());
+    write_path(frame, path.view());
+    frame.write_buffer(data);
+    frame.write_int(check.value);
+    call<set_result>(request_type::set,
+                     path.size() + data.size(),
+                     std::move(frame),
+                     std::move(on_complete),
+                     [] (jute_reader& body) { return set_result(body.read_stat()); }
+                    );
+}
+
+void connection_zkn::erase(path_view path, version check, callback<void> on_complete)
+{
+    auto frame = request_frame(jute_op::erase, path.size());
+    write_path(frame, path.view());
+    frame.write_int(check.value);
+    call<void>(request_type::erase,
+               path.size(),
+               std::move(frame),
+               std::move(on_complete),
+               [] (jute_reader&) { return outcome<void>(); }
+              );
+}
+
+void connection_zkn::get_acl(path_view path, callback<get_acl_result> on_complete) const
+{
+    auto frame = request_frame(jute_op::get_acl, path.size());
+    write_path(frame, path.view());
+    // Reading the ACL changes nothing about the connection but what is in flight
+    const_cast<connection_zkn&>(*this).call<get_acl_result>(request_type::get_acl,
+                                                            path.size(),
+                                                            std::move(frame),
+                                                            std::move(on_complete),
+                                                            [] (jute_reader& body)
+                                                            {
+                                                                auto rules = body.read_acl();
+                                                                auto st    = body.read_stat();
+                                                                return get_acl_result(std::move(rules), st);
+                                                            }
+                                                           );
+}
+
+void connection_zkn::set_acl(path_view path, const acl& rules, acl_version check, callback<void> on_complete)
+{
+    auto frame = request_frame(jute_op::set_acl, path.size());
+    write_path(frame, path.view());
+    frame.write_acl(rules);
+    frame.write_int(check.value);
+    call<void>(request_type::set_acl,
+               path.size(),
+               std::move(frame),
+               std::move(on_complete),
+               [] (jute_reader&) { return outcome<void>(); }
+              );
+}
+
+void connection_zkn::commit(multi_op&& txn, callback<multi_result> on_complete)
+{
+    commit_ops(txn, std::move(on_complete));
+}
+
+void connection_zkn::commit(const multi_op_view& txn, callback<multi_result> on_complete)
+{
+    commit_ops(txn, std::move(on_complete));
+}
+
+template <typename TTxn>
+void connection_zkn::commit_ops(const TTxn& txn, callback<multi_result> on_complete)
+{
+    auto write_header = [] (jute_writer& frame, jute_op op, bool done)
+                        {
+                            frame.write_int(static_cast<std::int32_t>(op));
+                            frame.write_bool(done);
+                            frame.write_int(-1);
+                        };
+
+    std::size_t payload_size = 0U;
+    auto        frame        = request_frame(jute_op::multi, 64U * txn.size());
+    for (std::size_t idx = 0U; idx < txn.size(); ++idx)
+    {
+        op_view src_op(txn[idx]);
+        switch (src_op.type())
+        {
+        case op_type::check:
+            write_header(frame, jute_op::check, false);
+            write_path(frame, src_op.path().view());
+            frame.write_int(src_op.check().value);
+            break;
+        case op_type::create:
+        {
+            bool container = is_set(src_op.mode(), create_mode::container);
+            write_header(frame, container ? jute_op::create_container : jute_op::create, false);
+            write_path(frame, src_op.path().view());
+            frame.write_buffer(src_op.data().data(), src_op.data().size());
+            if (src_op.handle())
+                frame.write_acl(*src_op.handle());
+            else
+                frame.write_acl(*src_op.rules());
+            frame.write_int(static_cast<std::int32_t>(src_op.mode()));
+            break;
+        }
+        case op_type::erase:
+            write_header(frame, jute_op::erase, false);
+            write_path(frame, src_op.path().view());
+            frame.write_int(src_op.check().value);
+            break;
+        case op_type::set:
+            write_header(frame, jute_op::set_data, false);
+            write_path(frame, src_op.path().view());
+            frame.write_buffer(src_op.data().data(), src_op.data().size());
+            frame.write_int(src_op.check().value);
+            break;
+        default:
+        {
+            using std::to_string;
+            throw std::invalid_argument("Invalid op_type at index=" + to_string(idx) + ": " + to_string(src_op.type()));
+        }
+        }
+        payload_size += src_op.path().size() + src_op.data().size();
+    }
+    write_header(frame, jute_op::error, true);
+
+    submit(request_type::commit,
+           payload_size,
+           std::move(frame),
+           [this, on_complete = std::move(on_complete)] (error_code rc, jute_reader& body)
+           {
+               if (rc != error_code::ok)
+                   return on_complete(rc);
+
+               // Every operation has a result; the ones which failed (or were rolled back) are error results
+               optional<std::pair<error_code, std::size_t>> failure;
+               auto decode = [&] (jute_reader& body)
+                             {
+                                 multi_result out;
+                                 for (std::size_t idx = 0U; ; ++idx)
+                                 {
+                                     auto op   = static_cast<jute_op>(body.read_int());
+                                     auto done = body.read_bool();
+                                     body.read_int();
+                                     if (done)
+                                         break;
+
+                                     switch (op)
+                                     {
+                                     case jute_op::create:
+                                         out.emplace_back(create_result(strip_chroot(body.read_string())));
+                                         break;
+                                     case jute_op::create2:
+                                     case jute_op::create_container:
+                                         out.emplace_back(create_result(strip_chroot(body.read_string())));
+                                         body.read_stat();
+                                         break;
+                                     case jute_op::set_data:
+                                         out.emplace_back(set_result(body.read_stat()));
+                                         break;
+                                     case jute_op::erase:
+                                         out.emplace_back(op_type::erase, nullptr);
+                                         break;
+                                     case jute_op::check:
+                                         out.emplace_back(op_type::check, nullptr);
+                                         break;
+                                     case jute_op::error:
+                                     {
+                                         auto err = error_code_from_wire(body.read_int());
+                                         if (err != error_code::ok && !failure)
+                                             failure.emplace(err, idx);
+                                         break;
+                                     }
+                                     default:
+                                         throw_error(error_code::marshalling_error);
+                                     }
+                                 }
+                                 return out;
+                             };
+
+               auto result = decode_reply<multi_result>(rc, body, decode);
+               if (result && failure)
+                   on_complete(outcome<multi_result>(error_code::transaction_failed,
+                                                     std::make_exception_ptr(transaction_failed(failure->first,
+                                                                                                failure->second
+                                                                                               )
+                                                                            )
+                                                    )
+                              );
+               else
+                   on_complete(std::move(result));
+           }
+          );
+}
+
+void connection_zkn::read_many(const multi_op& txn, callback<multi_read_result> on_complete)
+{
+    if (txn.size() == 0U || _multi_read_refused.load(std::memory_order_relaxed))
+        return connection::read_many(txn, std::move(on_complete));
+
+    auto write_header = [] (jute_writer& frame, jute_op op, bool done)
+                        {
+                            frame.write_int(static_cast<std::int32_t>(op));
+                            frame.write_bool(done);
+                            frame.write_int(-1);
+                        };
+
+    std::size_t payload_size = 0U;
+    auto        frame        = request_frame(jute_op::multi_read, 32U * txn.size());
+    for (std::size_t idx = 0U; idx < txn.size(); ++idx)
+    {
+        const auto& src_op = txn[idx];
+        switch (src_op.type())
+        {
+        case op_type::get:
+            write_header(frame, jute_op::get_data, false);
+            write_path(frame, src_op.as_get().path);
+            payload_size += src_op.as_get().path.size();
+            break;
+        case op_type::get_children:
+            write_header(frame, jute_op::get_children, false);
+            write_path(frame, src_op.as_get_children().path);
+            payload_size += src_op.as_get_children().path.size();
+            break;
+        default:
+        {
+            using std::to_string;
+            auto cause = std::invalid_argument("Invalid op_type at index=" + to_string(idx) + " of a read_many: "
+                                               + to_string(src_op.type())
+                                              );
+            return on_complete(outcome<multi_read_result>(error_code::invalid_arguments,
+                                                          std::make_exception_ptr(std::move(cause))
+                                                         ));
+        }
+        }
+        frame.write_bool(false);
+    }
+    write_header(frame, jute_op::error, true);
+
+    // Kept for the server which turns out not to know the request, so the reads can be sent again one by one
+    auto retry = std::make_shared<multi_op>(txn);
+    submit(request_type::commit,
+           payload_size,
+           std::move(frame),
+           [this, retry, on_complete = std::move(on_complete)] (error_code rc, jute_reader& body) mutable
+           {
+               if (rc == error_code::not_implemented)
+               {
+                   _multi_read_refused.store(true, std::memory_order_relaxed);
+                   return connection::read_many(*retry, std::move(on_complete));
+               }
+               else if (rc != error_code::ok)
+               {
+                   return on_complete(rc);
+               }
+
+               auto decode = [&] (jute_reader& body)
+                             {
+                                 multi_read_result out;
+                                 out.reserve(retry->size());
+                                 while (true)
+                                 {
+                                     auto op   = static_cast<jute_op>(body.read_int());
+                                     auto done = body.read_bool();
+                                     body.read_int();
+                                     if (done)
+                                         break;
+
+                                     switch (op)
+                                     {
+                                     case jute_op::get_data:
+                                         out.emplace_back(multi_result::part(read_data(body)));
+                                         break;
+                                     case jute_op::get_children:
+                                         out.emplace_back(multi_result::part(
+                                                 get_children_result(body.read_string_vector(), zk::stat())
+                                                ));
+                                         break;
+                                     case jute_op::error:
+                                         out.emplace_back(error_code_from_wire(body.read_int()));
+                                         break;
+                                     default:
+                                         throw_error(error_code::marshalling_error);
+                                     }
+                                 }
+                                 if (out.size() != retry->size())
+                                     throw_error(error_code::marshalling_error);
+                                 return out;
+                             };
+               on_complete(decode_reply<multi_read_result>(rc, body, decode));
+           }
+          );
+}
+
+void connection_zkn::load_fence(callback<void> on_complete)
+{
+    auto frame = request_frame(jute_op::sync, 1U);
+    write_path(frame, "/");
+    call<void>(request_type::load_fence,
+               0U,
+               std::move(frame),
+               std::move(on_complete),
+               [] (jute_reader&) { return outcome<void>(); }
+              );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reconfiguration                                                                                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The entry the configuration of the ensemble is kept in. It is read as it is, not under the chroot.
+static constexpr string_view config_path = "/zookeeper/config";
+
+/// Write \a servers as one comma-separated string, or as a null string when there are none (which is how the server
+/// tells an incremental change from a new member list).
+static std::size_t write_server_list(jute_writer& frame, const std::vector<std::string>& servers)
+{
+    if (servers.empty())
+    {
+        frame.write_int(-1);
+        return 0U;
+    }
+
+    std::string list;
+    for (const auto& server : servers)
+    {
+        if (!list.empty())
+            list += ',';
+        list += server;
+    }
+    frame.write_string(list);
+    return list.size();
+}
+
+void connection_zkn::get_config(callback<get_result> on_complete)
+{
+    auto frame = request_frame(jute_op::get_data, config_path.size());
+    frame.write_string(config_path);
+    frame.write_bool(false);
+    call<get_result>(request_type::get,
+                     config_path.size(),
+                     std::move(frame),
+                     std::move(on_complete),
+                     [this] (jute_reader& body) { return read_data(body); }
+                    );
+}
+
+void connection_zkn::reconfigure(const std::vector<std::string>& joining,
+                                 const std::vector<std::string>& leaving,
+                                 const std::vector<std::string>& members,
+                                 version                         from_config,
+                                 callback<get_result>            on_complete
+                                )
+{
+    auto        frame   = request_frame(jute_op::reconfig);
+    std::size_t payload = write_server_list(frame, joining);
+    payload += write_server_list(frame, leaving);
+    payload += write_server_list(frame, members);
+    frame.write_long(from_config.value);
+    call<get_result>(request_type::set,
+                     payload,
+                     std::move(frame),
+                     std::move(on_complete),
+                     [this] (jute_reader& body) { return read_data(body); }
+                    );
+}
+
+optional<session_credentials> connection_zkn::current_session() const
+{
+    std::unique_lock<std::mutex> ax(_session_protect);
+    return _published_session;
+}
+
+void connection_zkn::update_hosts(const std::vector<std::string>& hosts)
+{
+    if (hosts.empty())
+        throw std::invalid_argument("A connection needs at least one host");
+
+    // Ordering may probe the servers, which the loop thread has no time for
+    auto ordered = hosts;
+    _selector->order(ordered);
+    post([this, ordered = std::move(ordered)] () mutable { rebalance(std::move(ordered)); });
+}
+
+void connection_zkn::rebalance(std::vector<std::string> hosts)
+{
+    thread_local std::mt19937 rng(std::random_device{}());
+
+    bool attached  = _phase == phase::connecting || _phase == phase::handshaking || _phase == phase::connected;
+    auto current   = attached ? current_host() : std::string();
+    auto old_count = _hosts.size();
+
+    _hosts     = std::move(hosts);
+    _next_host = 0U;
+    if (!attached)
+        return;
+
+    auto iter = std::find(_hosts.begin(), _hosts.end(), current);
+    bool move = iter == _hosts.end();
+    if (!move)
+    {
+        _next_host = (std::size_t(iter - _hosts.begin()) + 1U) % _hosts.size();
+
+        // When servers were added, this many of the sessions of each old server have to move to the new ones for every
+        // server to end up with the same share
+        if (_hosts.size() > old_count)
+        {
+            auto share = 1.0 - double(old_count) / double(_hosts.size());
+            move       = std::uniform_real_distribution<double>(0.0, 1.0)(rng) < share;
+        }
+    }
+
+    if (move)
+        connection_lost();
+}
+
+}
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "connection.hpp"
+#include "host_selection.hpp"
+#include "jute.hpp"
+#include "metrics.hpp"
+#include "reactor.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// A connection which speaks the ZooKeeper protocol itself instead of going through the ZooKeeper C client. This is the
+/// implementation behind the \c "zkn" schema (`"zkn://server-a:2181,server-b:2181/app"`). The sockets of all sessions
+/// are served by the threads of \ref reactor::shared, which decode each response straight into its result and complete
+/// it right there. Unlike \ref connection_zk, a session costs no threads of its own and the data of a read is copied
+/// once, from the receive buffer into the \ref buffer of its result. Which \ref io_transport the loops move the bytes
+/// with is picked by \ref connection_params::transport. A session given a \ref reactor::external through
+/// \ref connection_params::io_reactor runs on the thread which drives that reactor instead, and has no I/O thread at
+/// all.
+///
+/// Requests made while the session is between servers wait until it is connected again; those which were already sent
+/// fail with \ref error_code::connection_loss. Watches which were set survive the move to another server. The \c chroot
+/// of the \ref connection_params is honored for every path sent and received.
+///
+/// \note
+/// Callbacks run on a reactor thread, which serves other sessions as well: while a callback runs, none of them make
+/// progress. This connection does not support the \c max_reads_in_flight, \c max_writes_in_flight, \c observer and
+/// \c completion_executor parameters yet: the constructor throws \c std::invalid_argument when any of them is set,
+/// rather than ignoring it.
+class connection_zkn final :
+        public connection,
+        public std::enable_shared_from_this<connection_zkn>,
+        private reactor::handler,
+        private reactor::stream_handler
+{
+public:
+    explicit connection_zkn(const connection_params& params);
+
+    virtual ~connection_zkn() noexcept;
+
+    virtual void close() override;
+
+    /// The close is sent from the loop thread and \a on_closed called there once the server has answered (or the
+    /// close timed out), so nothing waits in the meantime. The connection stays alive until then.
+    virtual void close_async(callback<void> on_closed) override;
+
+    virtual zk::state state() const override;
+
+    virtual metrics_snapshot metrics() const override;
+
+    virtual void get(path_view path, callback<get_result> on_complete) override;
+
+    virtual void get_into(path_view path, buffer& target, callback<zk::stat> on_complete) override;
+
+    virtual void watch(path_view path, callback<watch_result> on_complete) override;
+    virtual void watch(path_view path, callback<watch_result> on_complete, event_callback on_event) override;
+    virtual void watch(path_view                 path,
+                       callback<watch_result>    on_complete,
+                       event_callback            on_event,
+                       const cancellation_token& cancel
+                      ) override;
+
+    virtual void get_children(path_view path, callback<get_children_result> on_complete) override;
+
+    virtual void get_children_list(path_view path, callback<get_children_list_result> on_complete) override;
+
+    virtual void watch_children(path_view path, callback<watch_children_result> on_complete) override;
+    virtual void watch_children(path_view                       path,
+                                callback<watch_children_result> on_complete,
+                                event_callback                  on_event
+                               ) override;
+    virtual void watch_children(path_view                       path,
+                                callback<watch_children_result> on_complete,
+                                event_callback                  on_event,
+                                const cancellation_token&       cancel
+                               ) override;
+
+    virtual void exists(path_view path, callback<exists_result> on_complete) override;
+
+    virtual void watch_exists(path_view path, callback<watch_exists_result> on_complete) override;
+    virtual void watch_exists(path_view                     path,
+                              callback<watch_exists_result> on_complete,
+                              event_callback                on_event
+                             ) override;
+    virtual void watch_exists(path_view                     path,
+                              callback<watch_exists_result> on_complete,
+                              event_callback                on_event,
+                              const cancellation_token&     cancel
+                             ) override;
+
+    virtual void create(path_view               path,
+                        const buffer&           data,
+                        const acl&              rules,
+                        create_mode             mode,
+                        callback<create_result> on_complete
+                       ) override;
+    virtual void create(path_view               path,
+                        const buffer&           data,
+                        const acl_handle&       rules,
+                        create_mode             mode,
+                        callback<create_result> on_complete
+                       ) override;
+
+    virtual void set(path_view path, const buffer& data, version check, callback<set_result> on_complete) override;
+
+    virtual void erase(path_view path, version check, callback<void> on_complete) override;
+
+    virtual void get_acl(path_view path, callback<get_acl_result> on_complete) const override;
+
+    virtual void set_acl(path_view path, const acl& rules, acl_version check, callback<void> on_complete) override;
+
+    virtual void commit(multi_op&& txn, callback<multi_result> on_complete) override;
+
+    /// The operations are encoded straight into the request, so this copies nothing \a txn refers to beyond that.
+    virtual void commit(const multi_op_view& txn, callback<multi_result> on_complete) override;
+
+    /// The reads go out as one \c multiRead request (ZooKeeper 3.6+), which the server answers in one response. A
+    /// server which does not know it answers with \ref error_code::not_implemented; that batch and every one after it
+    /// fall back to pipelined reads. A \ref get_children_result of a batched read has a default \ref stat, as the
+    /// server does not send it.
+    virtual void read_many(const multi_op& txn, callback<multi_read_result> on_complete) override;
+
+    virtual void load_fence(callback<void> on_complete) override;
+
+    /// The configuration is read from \c "/zookeeper/config" itself, not the entry of that name under the chroot.
+    virtual void get_config(callback<get_result> on_complete) override;
+
+    virtual void reconfigure(const std::vector<std::string>& joining,
+                             const std::vector<std::string>& leaving,
+                             const std::vector<std::string>& members,
+                             version                         from_config,
+                             callback<get_result>            on_complete
+                            ) override;
+
+    /// Switch to \a hosts the way \c zoo_set_servers of the C client does: a session whose server is not in \a hosts
+    /// moves to one which is; when servers were added, a session moves to one of them with the probability which gives
+    /// every server the same share of the sessions. Moving fails the requests in flight with
+    /// \ref error_code::connection_loss, like any other move to another server.
+    virtual void update_hosts(const std::vector<std::string>& hosts) override;
+
+    virtual optional<session_credentials> current_session() const override;
+
+    using connection::close_async;
+    using connection::read_many;
+    using connection::get;
+    using connection::get_into;
+    using connection::watch;
+    using connection::get_children;
+    using connection::get_children_list;
+    using connection::watch_children;
+    using connection::exists;
+    using connection::watch_exists;
+    using connection::create;
+    using connection::set;
+    using connection::erase;
+    using connection::get_acl;
+    using connection::set_acl;
+    using connection::commit;
+    using connection::load_fence;
+    using connection::get_config;
+    using connection::reconfigure;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    /// Called with the code of the reply to a request and its body (what follows the reply header). Requests which are
+    /// failed without a reply get an empty body. The views read from the body only live as long as the call.
+    using reply_handler = std::function<void (error_code, jute_reader&)>;
+
+    struct request final
+    {
+        request_type      type;
+        bool              measured;
+        clock::time_point start;
+        jute_writer       frame;
+        reply_handler     on_reply;
+        std::int32_t      xid;
+    };
+
+    /// Where the session is. Every phase but \c closed can move on to \c closed; \c connected moves to \c backoff when
+    /// the connection to the server is lost.
+    enum class phase
+    {
+        backoff,     //!< Waiting until \c _deadline to connect to the next server.
+        connecting,  //!< The TCP connection is being made.
+        handshaking, //!< The session request was sent and the response is awaited.
+        connected,   //!< Requests can be sent.
+        closing,     //!< The session is being closed; waiting for the server to confirm until \c _deadline.
+        closed,      //!< Nothing more happens on this connection.
+    };
+
+    struct watch_entry;
+
+    template <typename TResult>
+    class initial_delivery;
+
+    using watch_table = std::unordered_map<std::string, std::vector<std::shared_ptr<watch_entry>>>;
+
+private:
+    virtual void on_ready(int fd, std::uint32_t events) override;
+
+    virtual std::pair<ptr<char>, std::size_t> receive_space(int fd) override;
+
+    virtual void on_received(int fd, std::size_t count) override;
+
+    virtual void on_stream_error(int fd, int err) override;
+
+    /// Run \a task on the loop, unless this connection is gone by the time it gets there.
+    template <typename FTask>
+    void post(FTask&& task);
+
+    /// Queue \a frame (a request made with \c request_frame) to be sent to the server. This can be called from any
+    /// thread; \a on_reply is called on the loop thread.
+    void submit(request_type type, std::size_t payload_size, jute_writer frame, reply_handler on_reply);
+
+    template <typename TResult, typename FDecode>
+    void call(request_type      type,
+              std::size_t       payload_size,
+              jute_writer       frame,
+              callback<TResult> on_complete,
+              FDecode           decode
+             );
+
+    /// Encode a creation with \a rules (an \ref acl or an \ref acl_handle) and submit it.
+    template <typename TRules>
+    void create_impl(path_view               path,
+                     const buffer&           data,
+                     const TRules&           rules,
+                     create_mode             mode,
+                     callback<create_result> on_complete
+                    );
+
+    /// Encode the operations of \a txn (a \ref multi_op or a \ref multi_op_view) and submit them as one request.
+    template <typename TTxn>
+    void commit_ops(const TTxn& txn, callback<multi_result> on_complete);
+
+    template <typename TResult, typename FComplete>
+    void set_watch(request_type              type,
+                   jute_op           op,
+                   path_view                 path,
+                   callback<TResult>         on_complete,
+                   event_callback            on_event,
+                   const cancellation_token& cancel,
+                   FComplete                 complete
+                  );
+
+    void write_path(jute_writer& frame, string_view path) const;
+
+    /// Decode the data and stat of a \c get_data (or \c reconfig) reply into a \ref get_result.
+    get_result read_data(jute_reader& body);
+
+    /// Replace \ref _hosts with \a hosts and move the session if it should (see \ref update_hosts).
+    void rebalance(std::vector<std::string> hosts);
+
+    /// Turn a path from the server back into the one the client knows (without the chroot).
+    std::string strip_chroot(string_view path) const;
+
+    void add_watch(watch_table& table, std::string path, std::shared_ptr<watch_entry> entry);
+
+    void take_submissions();
+
+    void send(request req);
+
+    void queue_bytes(std::vector<char> bytes);
+
+    /// Hand what was queued with \ref queue_bytes to the loop to send.
+    void flush();
+
+    void complete(request& req, error_code rc, jute_reader& body);
+
+    void start_connect();
+
+    void on_connect_complete();
+
+    void on_handshake(jute_reader& body);
+
+    void on_reply(jute_reader& body);
+
+    void deliver_notification(jute_reader& body);
+
+    void send_set_watches();
+
+    void process_messages();
+
+    /// Close the socket and forget what was in flight on it.
+    void drop_socket();
+
+    /// Schedule the next connection attempt after a failed one.
+    void retry_later();
+
+    void connection_lost();
+
+    void on_timer();
+
+    clock::time_point next_deadline() const;
+
+    void arm_timer();
+
+    void set_state(zk::state new_state);
+
+    /// Start closing the session; \a done is called once it is closed (it is empty when \ref close is called on the
+    /// loop thread, which can not wait for the server).
+    void begin_close(callback<void> done);
+
+    /// End the session for good, failing everything outstanding with \a fail_with.
+    void finish(zk::state final_state, error_code fail_with);
+
+    std::chrono::milliseconds read_timeout() const;
+
+    /// The host the session is on (or trying to get on): \ref start_connect has already moved past it.
+    const std::string& current_host() const;
+
+private:
+    // Usable from any thread
+    mutable connection_metrics     _metrics;
+    std::shared_ptr<reactor>       _reactor;
+    ptr<reactor::loop>             _loop;
+    std::string                    _chroot;
+    std::chrono::milliseconds      _requested_timeout;
+    bool                           _read_only_allowed;
+    std::shared_ptr<host_selector> _selector;
+    std::shared_ptr<buffer_pool>   _read_buffer_pool;
+    std::atomic<bool>              _multi_read_refused; //!< The server is older than 3.6 and has no batched reads
+    std::atomic<zk::state>         _state;
+    std::shared_ptr<int>           _life;
+
+    std::mutex                     _submit_protect;
+    std::vector<request>           _submitted;
+    bool                           _flush_posted;
+    bool                           _close_requested;
+    error_code                     _refuse_with;
+
+    mutable std::mutex             _session_protect;
+    optional<session_credentials>  _published_session; //!< A copy of the credentials the loop thread works with
+
+    // Only touched on the loop thread
+    phase                          _phase;
+    int                            _socket;
+    int                            _timer;
+    std::uint64_t                  _generation;
+    std::vector<std::string>       _hosts;
+    std::size_t                    _next_host;
+    unsigned                       _failed_attempts;
+    clock::time_point              _deadline;
+    clock::time_point              _armed_for;
+    clock::time_point              _last_send;
+    clock::time_point              _last_recv;
+    clock::time_point              _ping_sent; //!< When the ping being timed was sent (or zero if none is)
+    std::int64_t                   _session_id;
+    std::string                    _session_password;
+    std::chrono::milliseconds      _session_timeout;
+    std::int64_t                   _last_zxid;
+    std::int32_t                   _next_xid;
+    std::vector<char>              _send_buffer;
+    std::vector<char>              _recv_buffer;
+    std::size_t                    _recv_used;
+    std::deque<request>            _waiting;
+    std::deque<request>            _in_flight;
+    watch_table                    _data_watches;
+    watch_table                    _exist_watches;
+    watch_table                    _child_watches;
+    callback<void>                 _close_done;
+};
+
+/// \}
+
+}
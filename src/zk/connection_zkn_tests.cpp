@@ -0,0 +1,712 @@
+#include <zk/tests/test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "client.hpp"
+#include "connection_zkn.hpp"
+#include "error.hpp"
+#include "executor.hpp"
+#include "jute.hpp"
+#include "multi.hpp"
+#include "observer.hpp"
+#include "results.hpp"
+
+namespace zk
+{
+
+static buffer buffer_from(string_view str)
+{
+    return buffer(str.data(), str.data() + str.size());
+}
+
+static jute_reader reader_of(const std::vector<char>& message)
+{
+    return jute_reader(message.data() + jute_length_size, message.data() + message.size());
+}
+
+GTEST_TEST(connection_zkn_tests, jute_round_trip)
+{
+    jute_writer out;
+    out.write_int(-101);
+    out.write_long(0x0102030405060708);
+    out.write_bool(true);
+    out.write_string("/app", "/a");
+    out.write_buffer(buffer_from("data"));
+    out.write_acl(acls::open_unsafe());
+    auto message = std::move(out).finish();
+
+    CHECK_EQ(message.size() - jute_length_size, std::size_t(std::uint8_t(message[3])));
+    auto in = reader_of(message);
+    CHECK_EQ(-101, in.read_int());
+    CHECK_EQ(0x0102030405060708, in.read_long());
+    CHECK_TRUE(in.read_bool());
+    CHECK_EQ("/app/a", in.read_string());
+    CHECK_EQ("data", in.read_buffer());
+    CHECK_EQ(acls::open_unsafe(), in.read_acl());
+    CHECK_EQ(0U, in.remaining());
+}
+
+GTEST_TEST(connection_zkn_tests, jute_truncated)
+{
+    jute_writer out;
+    out.write_int(40);
+    out.write_int(3);
+    auto message = std::move(out).finish();
+
+    auto in = reader_of(message);
+    CHECK_THROWS(marshalling_error) { in.read_string(); };
+
+    // A null string or vector reads as empty
+    jute_writer nulls;
+    nulls.write_int(-1);
+    nulls.write_int(-1);
+    auto null_message = std::move(nulls).finish();
+    auto null_in = reader_of(null_message);
+    CHECK_EQ("", null_in.read_string());
+    CHECK_EQ(0U, null_in.read_string_vector().size());
+}
+
+/// Just enough of a ZooKeeper server to serve one client at a time over the loopback interface. Entries live under
+/// \c /app, so the client has to apply its chroot to reach them.
+class loopback_server final
+{
+public:
+    loopback_server() :
+            _listener(::socket(AF_INET, SOCK_STREAM, 0)),
+            _connection(-1),
+            _zxid(0)
+    {
+        ::sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(_listener, reinterpret_cast<ptr<::sockaddr>>(&addr), sizeof addr);
+        ::listen(_listener, 4);
+
+        socklen_t len = sizeof addr;
+        ::getsockname(_listener, reinterpret_cast<ptr<::sockaddr>>(&addr), &len);
+        _port = ntohs(addr.sin_port);
+
+        _entries["/app"]   = "";
+        _entries["/app/a"] = "hello";
+        _worker = std::thread([this] { run(); });
+    }
+
+    ~loopback_server() noexcept
+    {
+        ::shutdown(_listener, SHUT_RDWR);
+        {
+            std::unique_lock<std::mutex> ax(_protect);
+            if (_connection != -1)
+                ::shutdown(_connection, SHUT_RDWR);
+        }
+        _worker.join();
+        ::close(_listener);
+    }
+
+    std::string connection_string(io_transport transport = io_transport::epoll) const
+    {
+        return "zkn://127.0.0.1:" + std::to_string(_port) + "/app?randomize_hosts=false&transport="
+             + to_string(transport);
+    }
+
+    /// Hang up instead of answering the next request.
+    void drop_next_request()
+    {
+        _drop_next = true;
+    }
+
+    /// Answer batched reads as a server older than 3.6 does.
+    void refuse_multi_read()
+    {
+        _refuse_multi_read = true;
+    }
+
+    /// The number of batched reads answered so far.
+    std::size_t multi_reads() const
+    {
+        return _multi_reads.load();
+    }
+
+    std::vector<std::int64_t> sessions_asked_for() const
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        return _sessions_asked_for;
+    }
+
+    std::set<std::string> watches_restored() const
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        return _watches_restored;
+    }
+
+    bool session_closed() const
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        return _session_closed;
+    }
+
+private:
+    static bool read_message(int fd, std::vector<char>& out)
+    {
+        auto read_exactly = [fd] (ptr<char> dest, std::size_t count)
+                            {
+                                while (count > 0U)
+                                {
+                                    auto got = ::recv(fd, dest, count, 0);
+                                    if (got <= 0)
+                                        return false;
+                                    dest  += got;
+                                    count -= std::size_t(got);
+                                }
+                                return true;
+                            };
+
+        out.resize(jute_length_size);
+        if (!read_exactly(out.data(), jute_length_size))
+            return false;
+        auto length = std::size_t(std::uint32_t(reader_of_length(out).read_int()));
+        out.resize(jute_length_size + length);
+        return read_exactly(out.data() + jute_length_size, length);
+    }
+
+    static jute_reader reader_of_length(const std::vector<char>& message)
+    {
+        return jute_reader(message.data(), message.data() + jute_length_size);
+    }
+
+    static void write_message(int fd, jute_writer out)
+    {
+        auto message = std::move(out).finish();
+        ::send(fd, message.data(), message.size(), MSG_NOSIGNAL);
+    }
+
+    jute_writer reply(std::int32_t xid, std::int32_t err)
+    {
+        jute_writer out;
+        out.write_int(xid);
+        out.write_long(++_zxid);
+        out.write_int(err);
+        return out;
+    }
+
+    static void write_stat(jute_writer& out, const std::string& data)
+    {
+        for (int idx = 0; idx < 4; ++idx)
+            out.write_long(1);
+        for (int idx = 0; idx < 3; ++idx)
+            out.write_int(0);
+        out.write_long(0);
+        out.write_int(std::int32_t(data.size()));
+        out.write_int(0);
+        out.write_long(1);
+    }
+
+    void run()
+    {
+        while (true)
+        {
+            int fd = ::accept(_listener, nullptr, nullptr);
+            if (fd == -1)
+                return;
+
+            {
+                std::unique_lock<std::mutex> ax(_protect);
+                _connection = fd;
+            }
+            serve(fd);
+            {
+                std::unique_lock<std::mutex> ax(_protect);
+                _connection = -1;
+            }
+            ::close(fd);
+        }
+    }
+
+    void serve(int fd)
+    {
+        std::vector<char> message;
+        if (!read_message(fd, message))
+            return;
+
+        auto handshake = reader_of(message);
+        handshake.read_int();
+        handshake.read_long();
+        auto timeout = handshake.read_int();
+        {
+            std::unique_lock<std::mutex> ax(_protect);
+            _sessions_asked_for.push_back(handshake.read_long());
+        }
+
+        jute_writer accepted;
+        accepted.write_int(0);
+        accepted.write_int(timeout);
+        accepted.write_long(0x42);
+        accepted.write_string(std::string(jute_password_size, 'p'));
+        accepted.write_bool(false);
+        write_message(fd, std::move(accepted));
+
+        std::set<std::string> watched;
+        while (read_message(fd, message))
+        {
+            auto in  = reader_of(message);
+            auto xid = in.read_int();
+            auto op  = static_cast<jute_op>(in.read_int());
+            if (_drop_next.exchange(false))
+                return;
+
+            switch (op)
+            {
+            case jute_op::get_data:
+            case jute_op::exists:
+            {
+                auto path = std::string(in.read_string());
+                auto iter = _entries.find(path);
+                if (in.read_bool())
+                    watched.insert(path);
+
+                if (iter == _entries.end())
+                {
+                    write_message(fd, reply(xid, -101));
+                    break;
+                }
+
+                auto out = reply(xid, 0);
+                if (op == jute_op::get_data)
+                    out.write_string(iter->second);
+                write_stat(out, iter->second);
+                write_message(fd, std::move(out));
+                break;
+            }
+            case jute_op::set_data:
+            {
+                auto path = std::string(in.read_string());
+                _entries[path] = std::string(in.read_buffer());
+                if (watched.erase(path) != 0U)
+                {
+                    // Like the server, the event goes out before the reply to the change which triggered it
+                    auto note = reply(jute_xid::notification, 0);
+                    note.write_int(static_cast<std::int32_t>(event_type::changed));
+                    note.write_int(static_cast<std::int32_t>(state::connected));
+                    note.write_string(path);
+                    write_message(fd, std::move(note));
+                }
+
+                auto out = reply(xid, 0);
+                write_stat(out, _entries[path]);
+                write_message(fd, std::move(out));
+                break;
+            }
+            case jute_op::multi:
+            {
+                // Only checks of entries which exist and sets, which is all the tests commit
+                auto out = reply(xid, 0);
+                while (true)
+                {
+                    auto part = static_cast<jute_op>(in.read_int());
+                    auto done = in.read_bool();
+                    in.read_int();
+                    if (done)
+                        break;
+
+                    auto path = std::string(in.read_string());
+                    if (part == jute_op::set_data)
+                        _entries[path] = std::string(in.read_buffer());
+                    in.read_int();
+
+                    out.write_int(static_cast<std::int32_t>(part));
+                    out.write_bool(false);
+                    out.write_int(-1);
+                    if (part == jute_op::set_data)
+                        write_stat(out, _entries[path]);
+                }
+                out.write_int(-1);
+                out.write_bool(true);
+                out.write_int(-1);
+                write_message(fd, std::move(out));
+                break;
+            }
+            case jute_op::multi_read:
+            {
+                if (_refuse_multi_read)
+                {
+                    write_message(fd, reply(xid, static_cast<std::int32_t>(error_code::not_implemented)));
+                    break;
+                }
+
+                ++_multi_reads;
+                auto out = reply(xid, 0);
+                while (true)
+                {
+                    auto part = static_cast<jute_op>(in.read_int());
+                    auto done = in.read_bool();
+                    in.read_int();
+                    if (done)
+                        break;
+
+                    auto path = std::string(in.read_string());
+                    in.read_bool();
+                    auto iter = _entries.find(path);
+                    if (iter == _entries.end())
+                    {
+                        out.write_int(static_cast<std::int32_t>(jute_op::error));
+                        out.write_bool(false);
+                        out.write_int(-101);
+                        out.write_int(-101);
+                        continue;
+                    }
+
+                    out.write_int(static_cast<std::int32_t>(part));
+                    out.write_bool(false);
+                    out.write_int(-1);
+                    if (part == jute_op::get_data)
+                    {
+                        out.write_string(iter->second);
+                        write_stat(out, iter->second);
+                    }
+                    else
+                    {
+                        std::vector<std::string> children;
+                        for (const auto& entry : _entries)
+                        {
+                            if (entry.first.size() > path.size() + 1U
+                                && entry.first.compare(0U, path.size() + 1U, path + "/") == 0
+                                && entry.first.find('/', path.size() + 1U) == std::string::npos
+                               )
+                                children.push_back(entry.first.substr(path.size() + 1U));
+                        }
+                        out.write_int(static_cast<std::int32_t>(children.size()));
+                        for (const auto& child : children)
+                            out.write_string(child);
+                    }
+                }
+                out.write_int(-1);
+                out.write_bool(true);
+                out.write_int(-1);
+                write_message(fd, std::move(out));
+                break;
+            }
+            case jute_op::set_watches:
+            {
+                in.read_long();
+                std::unique_lock<std::mutex> ax(_protect);
+                for (int kind = 0; kind < 3; ++kind)
+                {
+                    for (auto& path : in.read_string_vector())
+                    {
+                        watched.insert(path);
+                        _watches_restored.insert(path);
+                    }
+                }
+                ax.unlock();
+                write_message(fd, reply(xid, 0));
+                break;
+            }
+            case jute_op::close_session:
+            {
+                {
+                    std::unique_lock<std::mutex> ax(_protect);
+                    _session_closed = true;
+                }
+                write_message(fd, reply(xid, 0));
+                return;
+            }
+            default:
+                write_message(fd, reply(xid, static_cast<std::int32_t>(error_code::not_implemented)));
+                break;
+            }
+        }
+    }
+
+private:
+    int                                _listener;
+    std::uint16_t                      _port;
+    mutable std::mutex                 _protect;
+    int                                _connection;
+    std::int64_t                       _zxid;
+    std::atomic<bool>                  _drop_next { false };
+    std::atomic<bool>                  _refuse_multi_read { false };
+    std::atomic<std::size_t>           _multi_reads { 0U };
+    std::map<std::string, std::string> _entries;
+    std::vector<std::int64_t>          _sessions_asked_for;
+    std::set<std::string>              _watches_restored;
+    bool                               _session_closed = false;
+    std::thread                        _worker;
+};
+
+static void check_get_and_watch(io_transport transport)
+{
+    loopback_server server;
+    client c = client::connect(server.connection_string(transport)).get();
+
+    CHECK_EQ(buffer_from("hello"), c.get("/a").get().data());
+    CHECK_FALSE(c.exists("/missing").get());
+    CHECK_THROWS(no_entry) { c.get("/missing").get(); };
+
+    auto watch = c.watch("/a").get();
+    c.set("/a", buffer_from("bye")).get();
+    auto ev = watch.next().get();
+    CHECK_EQ(event_type::changed, ev.type());
+    CHECK_EQ(buffer_from("bye"), c.get("/a").get().data());
+
+    c.close();
+    CHECK_TRUE(server.session_closed());
+    CHECK_THROWS(closed) { c.get("/a").get(); };
+}
+
+GTEST_TEST(connection_zkn_tests, connect_get_and_watch)
+{
+    check_get_and_watch(io_transport::epoll);
+}
+
+GTEST_TEST(connection_zkn_tests, connect_get_and_watch_io_uring)
+{
+    check_get_and_watch(io_transport::io_uring);
+}
+
+static void check_reconnect(io_transport transport)
+{
+    loopback_server server;
+    client c = client::connect(server.connection_string(transport)).get();
+    auto watch = c.watch("/a").get();
+
+    server.drop_next_request();
+    CHECK_THROWS(connection_loss) { c.get("/a").get(); };
+
+    // Asked for once the session is back, which brings the watch back to the server as well
+    c.set("/a", buffer_from("moved")).get();
+    CHECK_EQ(event_type::changed, watch.next().get().type());
+
+    auto sessions = server.sessions_asked_for();
+    CHECK_EQ(2U, sessions.size());
+    CHECK_EQ(0, sessions[0]);
+    CHECK_EQ(0x42, sessions[1]);
+    CHECK_EQ(1U, server.watches_restored().count("/app/a"));
+}
+
+GTEST_TEST(connection_zkn_tests, reconnect_keeps_session_and_watches)
+{
+    check_reconnect(io_transport::epoll);
+}
+
+GTEST_TEST(connection_zkn_tests, reconnect_keeps_session_and_watches_io_uring)
+{
+    check_reconnect(io_transport::io_uring);
+}
+
+GTEST_TEST(connection_zkn_tests, resume_session)
+{
+    loopback_server server;
+    auto params = connection_params::parse(server.connection_string());
+    params.resume_session() = session_credentials{ 0x77, std::string(jute_password_size, 'q') };
+
+    client c = client::connect(params).get();
+    CHECK_EQ(buffer_from("hello"), c.get("/a").get().data());
+
+    auto sessions = server.sessions_asked_for();
+    CHECK_EQ(1U, sessions.size());
+    CHECK_EQ(0x77, sessions[0]);
+
+    // Whatever the server hands back is what the next run should resume
+    auto current = c.current_session();
+    CHECK_TRUE(current);
+    CHECK_EQ(0x42, current->id);
+    CHECK_EQ(std::string(jute_password_size, 'p'), current->password);
+
+    c.close();
+    CHECK_FALSE(c.current_session());
+
+    params.resume_session()->password = "short";
+    CHECK_THROWS(std::invalid_argument) { connection_zkn conn(params); };
+}
+
+GTEST_TEST(connection_zkn_tests, close_async)
+{
+    loopback_server server;
+    future<void>    closing;
+    future<event>   pending;
+    {
+        client c = client::connect(server.connection_string()).get();
+        pending  = c.watch("/a").get().next();
+
+        // Letting go of the client right away must neither wait for the server nor cut the close short
+        closing = c.close_async();
+    }
+    closing.get();
+    CHECK_TRUE(server.session_closed());
+
+    auto ev = pending.get();
+    CHECK_EQ(event_type::session, ev.type());
+    CHECK_EQ(state::closed, ev.state());
+}
+
+static multi_op reads_of_a()
+{
+    return multi_op{ op::get("/a"), op::get("/missing"), op::get_children("/") };
+}
+
+GTEST_TEST(connection_zkn_tests, read_many_batched)
+{
+    loopback_server server;
+    client c = client::connect(server.connection_string()).get();
+
+    auto result = c.read_many(reads_of_a()).get();
+    CHECK_EQ(1U, server.multi_reads());
+    CHECK_EQ(3U, result.size());
+    CHECK_EQ(buffer_from("hello"), result[0].value().as_get().data());
+    CHECK_EQ(error_code::no_entry, result[1].code());
+    CHECK_EQ(std::vector<std::string>{ "a" }, result[2].value().as_get_children().children());
+    auto mixed = c.read_many(multi_op{ op::get("/a"), op::erase("/a") });
+    CHECK_THROWS(std::invalid_argument) { mixed.get(); };
+}
+
+GTEST_TEST(connection_zkn_tests, read_many_falls_back)
+{
+    loopback_server server;
+    server.refuse_multi_read();
+    client c = client::connect(server.connection_string()).get();
+
+    // Both times through plain reads: the first after the server refused the batch, the second without asking again
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        auto result = c.read_many(multi_op{ op::get("/a"), op::get("/missing") }).get();
+        CHECK_EQ(2U, result.size());
+        CHECK_EQ(buffer_from("hello"), result[0].value().as_get().data());
+        CHECK_EQ(error_code::no_entry, result[1].code());
+    }
+    CHECK_EQ(0U, server.multi_reads());
+}
+
+GTEST_TEST(connection_zkn_tests, commit_views_and_prepared)
+{
+    loopback_server server;
+    client c = client::connect(server.connection_string()).get();
+
+    // Neither the path nor the data is terminated where the view of it ends
+    const std::string paths = "/a/b";
+    const std::string data  = "viewed-data and more";
+    multi_op_view txn = { op_view::check(string_view(paths).substr(0U, 2U)),
+                          op_view::set(string_view(paths).substr(0U, 2U), string_view(data).substr(0U, 11U)),
+                        };
+    auto res = c.commit(txn).get();
+    CHECK_EQ(2U, res.size());
+    CHECK_EQ(op_type::check, res[0].type());
+    CHECK_EQ(op_type::set, res[1].type());
+    CHECK_EQ(buffer_from("viewed-data"), c.get("/a").get().data());
+
+    // This connection does not encode prepared transactions, so they are committed as copies
+    auto prepared = c.prepare({ op::set("/a", buffer_from("first")) });
+    CHECK_TRUE(prepared.encoded() == nullptr);
+    c.commit(prepared).get();
+    prepared.bind_data(0U, buffer_from("second"));
+    c.commit(prepared).get();
+    CHECK_EQ(buffer_from("second"), c.get("/a").get().data());
+}
+
+/// Turn an external reactor until \a done says so, the way an application's own loop would.
+template <typename FDone>
+static bool process_until(reactor& react, FDone&& done)
+{
+    for (int turn = 0; turn < 500 && !done(); ++turn)
+        react.process(std::chrono::milliseconds(10));
+    return done();
+}
+
+GTEST_TEST(connection_zkn_tests, external_reactor)
+{
+    loopback_server server;
+    auto            react  = reactor::external();
+    auto            params = connection_params::parse(server.connection_string());
+    params.io_reactor() = react;
+    client c(params);
+
+    // Everything is finished inside process, so nothing needs to lock here
+    const auto                    caller      = std::this_thread::get_id();
+    bool                          inline_only = true;
+    optional<outcome<get_result>> got;
+    c.get("/a",
+          [&] (outcome<get_result> result)
+          {
+              inline_only = inline_only && std::this_thread::get_id() == caller;
+              got = std::move(result);
+          }
+         );
+    CHECK_TRUE(process_until(*react, [&] { return bool(got); }));
+    CHECK_EQ(buffer_from("hello"), got->value().data());
+
+    bool            watching = false;
+    optional<event> fired;
+    c.watch("/a",
+            [&] (outcome<watch_result> result) { watching = bool(result); },
+            [&] (const event& ev)
+            {
+                inline_only = inline_only && std::this_thread::get_id() == caller;
+                fired = ev;
+            }
+           );
+    CHECK_TRUE(process_until(*react, [&] { return watching; }));
+    c.set("/a", buffer_from("bye"), version::any(), [] (outcome<set_result>) { });
+    CHECK_TRUE(process_until(*react, [&] { return bool(fired); }));
+    CHECK_EQ(event_type::changed, fired->type());
+    CHECK_TRUE(inline_only);
+
+    // On the thread of the loop, closing does not wait for the loop to be turned
+    c.close();
+    CHECK_THROWS(std::logic_error) { reactor::shared()->poll_fd(); };
+}
+
+GTEST_TEST(connection_zkn_tests, rejects_other_schemas)
+{
+    CHECK_THROWS(std::invalid_argument) { connection_zkn(connection_params::parse("zk://127.0.0.1:2181/")); };
+}
+
+namespace
+{
+
+class null_observer final :
+        public connection_observer
+{
+public:
+    virtual ptr<void> on_submit(request_type, string_view, std::size_t) noexcept override
+    {
+        return nullptr;
+    }
+
+    virtual void on_complete(request_type, string_view, error_code, duration, ptr<void>) noexcept override
+    { }
+};
+
+}
+
+GTEST_TEST(connection_zkn_tests, rejects_unsupported_params)
+{
+    CHECK_THROWS(std::invalid_argument)
+    {
+        connection_zkn(connection_params::parse("zkn://127.0.0.1:2181/?max_reads_in_flight=8"));
+    };
+    CHECK_THROWS(std::invalid_argument)
+    {
+        connection_zkn(connection_params::parse("zkn://127.0.0.1:2181/?max_writes_in_flight=8"));
+    };
+
+    auto observed = connection_params::parse("zkn://127.0.0.1:2181/");
+    observed.observer() = std::make_shared<null_observer>();
+    CHECK_THROWS(std::invalid_argument) { connection_zkn conn(observed); };
+
+    auto executed = connection_params::parse("zkn://127.0.0.1:2181/");
+    executed.completion_executor() = thread_pool_executor(1U);
+    CHECK_THROWS(std::invalid_argument) { connection_zkn conn(executed); };
+}
+
+}
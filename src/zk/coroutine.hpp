@@ -0,0 +1,308 @@
+/// \file
+/// Defines \ref zk::awaitable_client, which lets a C++20 coroutine \c co_await the operations of a \ref zk::client.
+#pragma once
+
+#include <zk/config.hpp>
+
+/// \def ZKPP_HAS_COROUTINES
+/// Set to \c 1 when the compiler supports C++20 coroutines (and so this header provides something) and \c 0 when it
+/// does not. The rest of the library does not need coroutines, so it is still built as C++17.
+#ifndef ZKPP_HAS_COROUTINES
+#   if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#       define ZKPP_HAS_COROUTINES 1
+#   else
+#       define ZKPP_HAS_COROUTINES 0
+#   endif
+#endif
+
+#if ZKPP_HAS_COROUTINES
+
+#include <coroutine>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "acl.hpp"
+#include "callback.hpp"
+#include "client.hpp"
+#include "executor.hpp"
+#include "multi.hpp"
+#include "optional.hpp"
+#include "outcome.hpp"
+#include "path.hpp"
+#include "results.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// The awaiter for an operation submitted with a \ref callback. Suspending the coroutine submits the operation and the
+/// completion resumes it, either right on the ZooKeeper completion thread or through an \ref executor. The result is
+/// stored in the awaiter itself (which lives in the coroutine frame), so there is no \c promise, \c future or condition
+/// variable between the completion and the coroutine.
+///
+/// \c co_await produces the \ref outcome of the operation: failures are codes, not exceptions. An operation which could
+/// not be submitted at all (for example: a \ref multi_op with an unknown operation type) throws from the \c co_await.
+///
+/// \tparam FSubmit A callable taking the \ref callback<TResult> to hand to the operation.
+template <typename TResult, typename FSubmit>
+class callback_awaiter final
+{
+public:
+    explicit callback_awaiter(FSubmit submit, std::shared_ptr<executor> resume_on = nullptr) :
+            _submit(std::move(submit)),
+            _resume_on(std::move(resume_on))
+    { }
+
+    callback_awaiter(const callback_awaiter&) = delete;
+    callback_awaiter& operator=(const callback_awaiter&) = delete;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> waiter)
+    {
+        // Once the coroutine is resumed, it can complete and destroy this awaiter (on another thread, even), so the
+        // completion must not touch any member after handing control back to it.
+        _submit([this, waiter] (outcome<TResult> result)
+                {
+                    _result.emplace(std::move(result));
+                    if (auto target = _resume_on)
+                        target->execute([waiter] { waiter.resume(); });
+                    else
+                        waiter.resume();
+                }
+               );
+    }
+
+    outcome<TResult> await_resume()
+    {
+        return std::move(*_result);
+    }
+
+private:
+    FSubmit                    _submit;
+    std::shared_ptr<executor>  _resume_on;
+    optional<outcome<TResult>> _result;
+};
+
+/// Make an awaiter for an operation which delivers its result to a \ref callback. \a submit is called (on the thread
+/// that suspends the coroutine) with the callback to pass along.
+///
+/// \code
+/// auto res = co_await zk::await_callback<zk::get_result>([&] (auto cb) { conn->get("/some/path", std::move(cb)); });
+/// \endcode
+template <typename TResult, typename FSubmit>
+callback_awaiter<TResult, std::decay_t<FSubmit>> await_callback(FSubmit&& submit,
+                                                                 std::shared_ptr<executor> resume_on = nullptr
+                                                                )
+{
+    return callback_awaiter<TResult, std::decay_t<FSubmit>>(std::forward<FSubmit>(submit), std::move(resume_on));
+}
+
+/// A view of a \ref client whose operations are awaited by coroutines. Each operation has the same meaning as in
+/// \ref client, but returns a \ref callback_awaiter instead of a \c future.
+///
+/// \code
+/// zk::awaitable_client zc(client, worker_pool);
+/// auto created = co_await zc.create("/app/lock-", {}, zk::create_mode::ephemeral | zk::create_mode::sequential);
+/// auto peers   = co_await zc.get_children("/app");
+/// \endcode
+///
+/// \warning
+/// The path, data and other arguments are referenced by the awaiter, not copied, until the operation is submitted when
+/// the coroutine suspends. Await an operation in the same expression which starts it (as above) and this is never a
+/// concern. The \c awaitable_client must also outlive the awaits made through it.
+class awaitable_client final
+{
+public:
+    /// Await the operations of \a inner. If \a resume_on is given, coroutines are resumed through it; otherwise they
+    /// are resumed on the ZooKeeper completion thread, with the same restrictions as a \ref callback (in particular: do
+    /// not block waiting on another operation of the same connection before the next \c co_await).
+    explicit awaitable_client(client inner, std::shared_ptr<executor> resume_on = nullptr) :
+            _client(std::move(inner)),
+            _resume_on(std::move(resume_on))
+    { }
+
+    /// The client the operations are made with.
+    client& inner() { return _client; }
+
+    /// The executor coroutines are resumed through or \c nullptr if they resume on the completion thread.
+    const std::shared_ptr<executor>& resume_on() const { return _resume_on; }
+
+    auto get(path_view path)
+    {
+        return await<get_result>([this, path] (auto cb) { _client.get(path, std::move(cb)); });
+    }
+
+    auto get_into(path_view path, buffer& target)
+    {
+        return await<zk::stat>([this, path, &target] (auto cb)
+                               {
+                                   _client.get_into(path, target, std::move(cb));
+                               }
+                              );
+    }
+
+    auto get_many(const std::vector<path_view>& paths)
+    {
+        return await<std::vector<outcome<get_result>>>([this, &paths] (auto cb)
+                                                       {
+                                                           _client.get_many(paths, std::move(cb));
+                                                       }
+                                                      );
+    }
+
+    auto get_children_many(const std::vector<path_view>& paths)
+    {
+        return await<std::vector<outcome<get_children_result>>>([this, &paths] (auto cb)
+                                                                {
+                                                                    _client.get_children_many(paths, std::move(cb));
+                                                                }
+                                                               );
+    }
+
+    auto exists_many(const std::vector<path_view>& paths)
+    {
+        return await<std::vector<outcome<exists_result>>>([this, &paths] (auto cb)
+                                                          {
+                                                              _client.exists_many(paths, std::move(cb));
+                                                          }
+                                                         );
+    }
+
+    auto watch(path_view path)
+    {
+        return await<watch_result>([this, path] (auto cb) { _client.watch(path, std::move(cb)); });
+    }
+
+    auto get_children(path_view path)
+    {
+        return await<get_children_result>([this, path] (auto cb) { _client.get_children(path, std::move(cb)); });
+    }
+
+    auto watch_children(path_view path)
+    {
+        return await<watch_children_result>([this, path] (auto cb) { _client.watch_children(path, std::move(cb)); });
+    }
+
+    auto get_children_list(path_view path)
+    {
+        return await<get_children_list_result>([this, path] (auto cb)
+                                               {
+                                                   _client.get_children_list(path, std::move(cb));
+                                               }
+                                              );
+    }
+
+    auto watch_children_list(path_view path)
+    {
+        return await<watch_children_list_result>([this, path] (auto cb)
+                                                 {
+                                                     _client.watch_children_list(path, std::move(cb));
+                                                 }
+                                                );
+    }
+
+    /// \a visitor is called on the completion thread, regardless of \ref resume_on.
+    auto for_each_child(path_view path, child_visitor visitor)
+    {
+        return await<zk::stat>([this, path, visitor = std::move(visitor)] (auto cb) mutable
+                               {
+                                   _client.for_each_child(path, std::move(visitor), std::move(cb));
+                               }
+                              );
+    }
+
+    auto exists(path_view path)
+    {
+        return await<exists_result>([this, path] (auto cb) { _client.exists(path, std::move(cb)); });
+    }
+
+    auto watch_exists(path_view path)
+    {
+        return await<watch_exists_result>([this, path] (auto cb) { _client.watch_exists(path, std::move(cb)); });
+    }
+
+    auto create(path_view path, const buffer& data, const acl& rules, create_mode mode = create_mode::normal)
+    {
+        return await<create_result>([this, path, &data, &rules, mode] (auto cb)
+                                    {
+                                        _client.create(path, data, rules, mode, std::move(cb));
+                                    }
+                                   );
+    }
+
+    auto create(path_view path, const buffer& data, create_mode mode = create_mode::normal)
+    {
+        return await<create_result>([this, path, &data, mode] (auto cb)
+                                    {
+                                        _client.create(path, data, mode, std::move(cb));
+                                    }
+                                   );
+    }
+
+    auto set(path_view path, const buffer& data, version check = version::any())
+    {
+        return await<set_result>([this, path, &data, check] (auto cb)
+                                 {
+                                     _client.set(path, data, check, std::move(cb));
+                                 }
+                                );
+    }
+
+    auto get_acl(path_view path)
+    {
+        return await<get_acl_result>([this, path] (auto cb) { _client.get_acl(path, std::move(cb)); });
+    }
+
+    auto set_acl(path_view path, const acl& rules, acl_version check = acl_version::any())
+    {
+        return await<void>([this, path, &rules, check] (auto cb)
+                           {
+                               _client.set_acl(path, rules, check, std::move(cb));
+                           }
+                          );
+    }
+
+    auto erase(path_view path, version check = version::any())
+    {
+        return await<void>([this, path, check] (auto cb) { _client.erase(path, check, std::move(cb)); });
+    }
+
+    auto load_fence()
+    {
+        return await<void>([this] (auto cb) { _client.load_fence(std::move(cb)); });
+    }
+
+    auto commit(multi_op txn)
+    {
+        return await<multi_result>([this, txn = std::move(txn)] (auto cb) mutable
+                                   {
+                                       _client.commit(std::move(txn), std::move(cb));
+                                   }
+                                  );
+    }
+
+private:
+    template <typename TResult, typename FSubmit>
+    callback_awaiter<TResult, FSubmit> await(FSubmit submit)
+    {
+        return callback_awaiter<TResult, FSubmit>(std::move(submit), _resume_on);
+    }
+
+private:
+    client                    _client;
+    std::shared_ptr<executor> _resume_on;
+};
+
+/// \}
+
+}
+
+#endif
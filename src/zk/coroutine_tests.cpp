@@ -0,0 +1,158 @@
+#include <zk/server/server_tests.hpp>
+
+#include "coroutine.hpp"
+
+#if ZKPP_HAS_COROUTINES
+
+#include <exception>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "client.hpp"
+#include "error.hpp"
+#include "executor.hpp"
+#include "optional.hpp"
+
+namespace zk
+{
+
+namespace
+{
+
+/// The smallest coroutine type there is: it starts right away and nobody waits on it. The lambdas in these tests are
+/// named so that their captures are still there when the coroutine is resumed.
+struct detached_task
+{
+    struct promise_type
+    {
+        detached_task get_return_object() { return {}; }
+
+        std::suspend_never initial_suspend() noexcept { return {}; }
+
+        std::suspend_never final_suspend() noexcept { return {}; }
+
+        void return_void() { }
+
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+class queue_executor final :
+        public executor
+{
+public:
+    virtual void execute(task_type task) override
+    {
+        tasks.emplace_back(std::move(task));
+    }
+
+    std::vector<task_type> tasks;
+};
+
+}
+
+GTEST_TEST(coroutine_tests, completes_inline)
+{
+    int seen = 0;
+    auto body = [&] () -> detached_task
+    {
+        auto res = co_await await_callback<int>([] (callback<int> cb) { cb(outcome<int>(7)); });
+        seen = res.value();
+    };
+    body();
+    CHECK_EQ(7, seen);
+}
+
+GTEST_TEST(coroutine_tests, completes_later)
+{
+    callback<int> pending;
+    error_code    seen = error_code::ok;
+    bool          done = false;
+    auto body = [&] () -> detached_task
+    {
+        auto res = co_await await_callback<int>([&] (callback<int> cb) { pending = std::move(cb); });
+        seen = res.code();
+        done = true;
+    };
+    body();
+    CHECK_FALSE(done);
+
+    pending(outcome<int>(error_code::no_entry));
+    CHECK_TRUE(done);
+    CHECK_EQ(error_code::no_entry, seen);
+}
+
+GTEST_TEST(coroutine_tests, resumes_through_executor)
+{
+    auto exec = std::make_shared<queue_executor>();
+    bool done = false;
+    auto body = [&] () -> detached_task
+    {
+        co_await await_callback<void>([] (callback<void> cb) { cb(outcome<void>()); }, exec);
+        done = true;
+    };
+    body();
+    CHECK_FALSE(done);
+    CHECK_EQ(1U, exec->tasks.size());
+
+    exec->tasks[0]();
+    CHECK_TRUE(done);
+}
+
+GTEST_TEST(coroutine_tests, submission_failure_throws)
+{
+    bool caught = false;
+    auto body = [&] () -> detached_task
+    {
+        try
+        {
+            co_await await_callback<int>([] (callback<int>) { throw std::invalid_argument("bad operation"); });
+        }
+        catch (const std::invalid_argument&)
+        {
+            caught = true;
+        }
+    };
+    body();
+    CHECK_TRUE(caught);
+}
+
+class coroutine_client_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(coroutine_client_tests, create_get_erase)
+{
+    awaitable_client zc(get_connected_client());
+    buffer           data = { 'c', 'o' };
+
+    // The checks are made after the coroutine finishes, as a failed check returns from the function it is in
+    optional<outcome<create_result>> created;
+    optional<outcome<get_result>>    contents;
+    optional<outcome<get_result>>    missing;
+    optional<outcome<void>>          erased;
+    std::promise<void>               finished;
+    auto                             finished_fut = finished.get_future();
+    auto body = [&] () -> detached_task
+    {
+        created.emplace(co_await zc.create("/coroutine", data));
+        contents.emplace(co_await zc.get("/coroutine"));
+        missing.emplace(co_await zc.get("/coroutine/missing"));
+        erased.emplace(co_await zc.erase("/coroutine"));
+        finished.set_value();
+    };
+    body();
+    finished_fut.get();
+
+    CHECK_EQ("/coroutine", created->value().name());
+    CHECK_TRUE(contents->value().data() == data);
+    CHECK_EQ(error_code::no_entry, missing->code());
+    CHECK_TRUE(*erased);
+}
+
+}
+
+#endif
@@ -0,0 +1,450 @@
+/// \file
+/// Conversions between the types of the ZooKeeper C library and the ones of this library. This is an implementation
+/// detail of \ref zk::connection_zk; it is a header so that the benchmarks can measure the same code.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <zookeeper/zookeeper.h>
+
+#include <zk/acl.hpp>
+#include <zk/children_list.hpp>
+#include <zk/error.hpp>
+#include <zk/multi.hpp>
+#include <zk/path.hpp>
+#include <zk/string_view.hpp>
+#include <zk/types.hpp>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Utility Functions                                                                                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Scratch space for \a count elements of \a T, which is on the stack for up to \a InlineCount of them and on the heap
+/// past that. The sizes come from the paths and ACLs a caller builds, so none of them can be trusted to fit the stack.
+template <typename T, std::size_t InlineCount>
+class scratch_array final
+{
+public:
+    explicit scratch_array(std::size_t count) :
+            _heap(count > InlineCount ? std::make_unique<T[]>(count) : nullptr)
+    { }
+
+    scratch_array(const scratch_array&) = delete;
+    scratch_array& operator=(const scratch_array&) = delete;
+
+    ptr<T> data() noexcept { return _heap ? _heap.get() : _inline; }
+
+private:
+    T                    _inline[InlineCount];
+    std::unique_ptr<T[]> _heap;
+};
+
+/// Call \a action with a NUL-terminated copy of \a src. Paths longer than a few hundred bytes are copied to the heap,
+/// so this can throw \c std::bad_alloc even when \a action can not.
+template <typename FAction>
+auto with_str(string_view src, FAction&& action) -> decltype(std::forward<FAction>(action)(ptr<const char>()))
+{
+    scratch_array<char, 256U> buffer(src.size() + 1);
+    buffer.data()[src.size()] = '\0';
+    std::memcpy(buffer.data(), src.data(), src.size());
+    return std::forward<FAction>(action)(buffer.data());
+}
+
+/// Paths which are already NUL-terminated are passed through as-is; only plain string views pay for the copy.
+template <typename FAction>
+auto with_str(path_view src, FAction&& action) -> decltype(std::forward<FAction>(action)(ptr<const char>()))
+{
+    if (src.is_terminated())
+        return std::forward<FAction>(action)(src.data());
+    else
+        return with_str(src.view(), std::forward<FAction>(action));
+}
+
+inline ACL encode_acl_part(const acl_rule& src)
+{
+    ACL out;
+    out.perms     = static_cast<int>(src.permissions());
+    out.id.scheme = const_cast<ptr<char>>(src.scheme().c_str());
+    out.id.id     = const_cast<ptr<char>>(src.id().c_str());
+    return out;
+}
+
+template <typename FAction>
+auto with_acl(const acl& rules, FAction&& action) -> decltype(std::forward<FAction>(action)(ptr<ACL_vector>()))
+{
+    scratch_array<ACL, 8U> parts(rules.size());
+    for (std::size_t idx = 0; idx < rules.size(); ++idx)
+        parts.data()[idx] = encode_acl_part(rules[idx]);
+
+    ACL_vector vec;
+    vec.count = int(rules.size());
+    vec.data  = parts.data();
+    return std::forward<FAction>(action)(&vec);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Native Adaptors                                                                                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline error_code error_code_from_raw(int raw)
+{
+    switch (raw)
+    {
+    case ZOPERATIONTIMEOUT:
+        raw = ZCONNECTIONLOSS;
+        break;
+    case ZINVALIDCALLBACK:
+    case ZINVALIDACL:
+        raw = ZBADARGUMENTS;
+        break;
+    case ZSESSIONMOVED:
+        raw = ZCONNECTIONLOSS;
+        break;
+    default:
+        break;
+    }
+    return static_cast<error_code>(raw);
+}
+
+inline event_type event_from_raw(int raw)
+{
+    return static_cast<event_type>(raw);
+}
+
+// ZooKeeper does not have this concept pre-3.5
+#if ZOO_MAJOR_VERSION <= 3 && ZOO_MINOR_VERSION <= 4
+static const int ZOO_NOTCONNECTED_STATE = 999;
+#endif
+
+inline state state_from_raw(int raw)
+{
+    // The C client will put us into `ZOO_NOTCONNECTED_STATE` for two reasons:
+    //
+    // 1. This is the state of the initial connection (zookeeper_init_internal), which is then replaced when the adaptor
+    //    threads first call the interest function.
+    // 2. During a reconfiguration, the client disconnects and transitions to this state (update_addrs), which is then
+    //    updated the next time the I/O thread touches interest.
+    //
+    // In both cases, the state is still "connecting" from the point of view of a client.
+    if (raw == ZOO_NOTCONNECTED_STATE)
+    {
+        raw = ZOO_CONNECTING_STATE;
+    }
+    // `ZOO_ASSOCIATING_STATE` means we have connected to a server, but have not yet authenticated and created the
+    // session. We still can't perform any operations, so treat it as connecting -- the client does not care about the
+    // difference between establishing a TCP connection and negotiating credentials.
+    else if (raw == ZOO_ASSOCIATING_STATE)
+    {
+        raw = ZOO_CONNECTING_STATE;
+    }
+
+    return static_cast<state>(raw);
+}
+
+inline stat stat_from_raw(const struct Stat& raw)
+{
+    stat out;
+    out.acl_version = acl_version(raw.aversion);
+    out.child_modified_transaction = transaction_id(raw.pzxid);
+    out.child_version = child_version(raw.cversion);
+    out.children_count = raw.numChildren;
+    out.create_time = stat::time_point() + std::chrono::milliseconds(raw.ctime);
+    out.create_transaction = transaction_id(raw.czxid);
+    out.data_size = raw.dataLength;
+    out.data_version = version(raw.version);
+    out.ephemeral_owner = raw.ephemeralOwner;
+    out.modified_time = stat::time_point() + std::chrono::milliseconds(raw.mtime);
+    out.modified_transaction = transaction_id(raw.mzxid);
+    return out;
+}
+
+inline std::vector<std::string> string_vector_from_raw(const struct String_vector& raw)
+{
+    std::vector<std::string> out;
+    out.reserve(raw.count);
+    for (std::int32_t idx = 0; idx < raw.count; ++idx)
+        out.emplace_back(raw.data[idx]);
+    return out;
+}
+
+/// Unlike \c string_vector_from_raw, this allocates twice no matter how many children there are.
+inline children_list children_list_from_raw(const struct String_vector& raw)
+{
+    auto count = std::size_t(raw.count);
+
+    std::size_t total_length = 0U;
+    for (std::size_t idx = 0U; idx < count; ++idx)
+        total_length += std::strlen(raw.data[idx]);
+
+    children_list out;
+    out.reserve(count, total_length);
+    for (std::size_t idx = 0U; idx < count; ++idx)
+        out.push_back(raw.data[idx]);
+    return out;
+}
+
+inline acl acl_from_raw(const struct ACL_vector& raw)
+{
+    auto sz = std::size_t(raw.count);
+
+    acl out;
+    out.reserve(sz);
+    for (std::size_t idx = 0; idx < sz; ++idx)
+    {
+        const auto& item = raw.data[idx];
+        out.emplace_back(item.id.scheme, item.id.id, static_cast<permission>(item.perms));
+    }
+    return out;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Transactions                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The storage one \c zoo_amulti call is encoded into and the C client writes the results into. It must stay in place
+/// until the completion is called. Everything is sized up front by the \ref multi_op_encoding of the transaction, so a
+/// commit allocates the same handful of blocks no matter how many operations it has.
+struct multi_op_buffers
+{
+    std::vector<::zoo_op>        raw_ops;
+    std::vector<zoo_op_result_t> raw_results;
+    std::vector<Stat>            raw_stats;
+    std::vector<char>            path_buffers;
+
+    explicit multi_op_buffers(std::size_t op_count, std::size_t stat_count, std::size_t path_buffer_size) :
+            raw_ops(op_count),
+            raw_results(op_count),
+            raw_stats(stat_count),
+            path_buffers(path_buffer_size)
+    {
+        for (zoo_op_result_t& x : raw_results)
+            x.err = -42;
+    }
+};
+
+/// The parts of a transaction which \c zoo_amulti needs and which do not change from one commit of it to the next:
+/// the type of each operation, its path, the encoded ACLs of creations and their modes. Binding it to the data and
+/// versions of a transaction with the same operations finishes the \c zoo_op array.
+///
+/// This points into the paths and ACLs of the transaction it was made from, which must outlive it; only the paths which
+/// are not already NUL-terminated are copied. It is the \ref prepared_multi::encoding of \ref connection_zk.
+class multi_op_encoding final :
+        public prepared_multi::encoding
+{
+public:
+    /// \{
+    /// \throws std::invalid_argument if an operation of \a txn has an unknown \ref op_type or is a read.
+    explicit multi_op_encoding(const multi_op& txn)
+    {
+        encode(txn);
+    }
+
+    explicit multi_op_encoding(const multi_op_view& txn)
+    {
+        encode(txn);
+    }
+    /// \}
+
+    /// The number of operations in the transaction.
+    std::size_t size() const noexcept { return _parts.size(); }
+
+    op_type type(std::size_t idx) const noexcept { return _parts[idx].type; }
+
+    /// Make the buffers for one commit of the transaction.
+    multi_op_buffers make_buffers() const
+    {
+        return multi_op_buffers(_parts.size(), _stat_count, _path_buffer_size);
+    }
+
+    /// \{
+    /// Fill the \c zoo_op array of \a out with the fixed parts of this encoding and the data and versions of \a txn,
+    /// with the outputs of the operations pointing into \a out. The paths and data of \a txn are not copied, so the
+    /// array is only good for as long as both of them are unchanged.
+    ///
+    /// \throws std::logic_error if \a txn does not have as many operations as the one this was made from.
+    ptr<zoo_op> bind(const multi_op& txn, multi_op_buffers& out) const
+    {
+        return bind_impl(txn, out);
+    }
+
+    ptr<zoo_op> bind(const multi_op_view& txn, multi_op_buffers& out) const
+    {
+        return bind_impl(txn, out);
+    }
+    /// \}
+
+private:
+    struct part
+    {
+        op_type               type;
+        ptr<const char>       path;
+        ptr<const ACL_vector> rules;
+        int                   flags;
+        std::size_t           output_offset; //!< Into the path buffers for a creation or the stats for a set
+        std::size_t           output_size;
+    };
+
+    template <typename TTxn>
+    void encode(const TTxn& txn)
+    {
+        std::size_t create_op_count = 0U;
+        std::size_t acl_piece_count = 0U;
+        std::size_t path_copy_size  = 0U;
+        for (const auto& tx : txn)
+        {
+            op_view src_op(tx);
+            // Rules given as a handle are already encoded
+            if (src_op.type() == op_type::create && !src_op.handle())
+            {
+                ++create_op_count;
+                acl_piece_count += src_op.rules()->size();
+            }
+            if (!src_op.path().is_terminated())
+                path_copy_size += src_op.path().size() + 1U;
+        }
+        // Sized up front so the pointers into them stay valid as they are filled
+        _parts.reserve(txn.size());
+        _acls.reserve(create_op_count);
+        _acl_pieces.reserve(acl_piece_count);
+        _path_copies.reserve(path_copy_size);
+
+        for (std::size_t idx = 0; idx < txn.size(); ++idx)
+        {
+            op_view src_op(txn[idx]);
+            auto&   part = add_part(src_op);
+            switch (src_op.type())
+            {
+            case op_type::check:
+            case op_type::erase:
+                break;
+            case op_type::create:
+            {
+                if (auto handle = src_op.handle())
+                {
+                    part.rules = handle->native();
+                }
+                else
+                {
+                    const auto& rules = *src_op.rules();
+
+                    ACL_vector encoded;
+                    encoded.count = int(rules.size());
+                    encoded.data  = _acl_pieces.data() + _acl_pieces.size();
+                    for (const auto& rule : rules)
+                        _acl_pieces.push_back(encode_acl_part(rule));
+                    _acls.push_back(encoded);
+                    part.rules = &_acls.back();
+                }
+
+                // If the creation is sequential, append 12 extra characters to store the digits
+                part.flags         = static_cast<int>(src_op.mode());
+                part.output_offset = _path_buffer_size;
+                part.output_size   = src_op.path().size() + (is_set(src_op.mode(), create_mode::sequential) ? 12U : 1U);
+                _path_buffer_size += part.output_size;
+                break;
+            }
+            case op_type::set:
+                part.output_offset = _stat_count++;
+                break;
+            default:
+            {
+                using std::to_string;
+                throw std::invalid_argument("Invalid op_type at index=" + to_string(idx) + ": "
+                                            + to_string(src_op.type())
+                                           );
+            }
+            }
+        }
+    }
+
+    part& add_part(const op_view& src)
+    {
+        auto path = src.path();
+        ptr<const char> terminated = path.data();
+        if (!path.is_terminated())
+        {
+            terminated = _path_copies.data() + _path_copies.size();
+            _path_copies.insert(_path_copies.end(), path.data(), path.data() + path.size());
+            _path_copies.push_back('\0');
+        }
+        _parts.push_back(part{ src.type(), terminated, nullptr, 0, 0U, 0U });
+        return _parts.back();
+    }
+
+    template <typename TTxn>
+    ptr<zoo_op> bind_impl(const TTxn& txn, multi_op_buffers& out) const
+    {
+        if (txn.size() != _parts.size())
+            throw std::logic_error("Transaction of " + std::to_string(txn.size()) + " operations does not match the "
+                                   + std::to_string(_parts.size()) + " it was encoded from"
+                                  );
+
+        for (std::size_t idx = 0; idx < _parts.size(); ++idx)
+        {
+            const auto& part   = _parts[idx];
+            auto&       raw_op = out.raw_ops[idx];
+            op_view     src_op(txn[idx]);
+            if (src_op.type() != part.type)
+                throw std::logic_error("Operation " + std::to_string(idx) + " is a " + to_string(src_op.type())
+                                       + ", but it was encoded from a " + to_string(part.type)
+                                      );
+
+            switch (part.type)
+            {
+            case op_type::check:
+                zoo_check_op_init(&raw_op, part.path, src_op.check().value);
+                break;
+            case op_type::create:
+                zoo_create_op_init(&raw_op,
+                                   part.path,
+                                   src_op.data().data(),
+                                   int(src_op.data().size()),
+                                   part.rules,
+                                   part.flags,
+                                   out.path_buffers.data() + part.output_offset,
+                                   int(part.output_size)
+                                  );
+                break;
+            case op_type::erase:
+                zoo_delete_op_init(&raw_op, part.path, src_op.check().value);
+                break;
+            case op_type::set:
+                zoo_set_op_init(&raw_op,
+                                part.path,
+                                src_op.data().data(),
+                                int(src_op.data().size()),
+                                src_op.check().value,
+                                &out.raw_stats[part.output_offset]
+                               );
+                break;
+            case op_type::get:
+            case op_type::get_children:
+                // Refused by encode, as the C client has no reads in a multi
+                break;
+            }
+        }
+        return out.raw_ops.data();
+    }
+
+private:
+    std::vector<part>       _parts;
+    std::vector<ACL_vector> _acls;
+    std::vector<ACL>        _acl_pieces;
+    std::vector<char>       _path_copies;
+    std::size_t             _stat_count       = 0U;
+    std::size_t             _path_buffer_size = 0U;
+};
+
+}
@@ -1,5 +1,7 @@
 #include "error.hpp"
 
+#include <array>
+#include <iterator>
 #include <sstream>
 #include <ostream>
 
@@ -34,6 +36,7 @@ void throw_error(error_code code)
     {
     case error_code::connection_loss:               throw connection_loss();
     case error_code::marshalling_error:             throw marshalling_error();
+    case error_code::operation_timeout:             throw operation_timeout();
     case error_code::not_implemented:               throw not_implemented("unspecified");
     case error_code::invalid_arguments:             throw invalid_arguments();
     case error_code::new_configuration_no_quorum:   throw new_configuration_no_quorum();
@@ -50,12 +53,13 @@ void throw_error(error_code code)
     case error_code::read_only_connection:          throw read_only_connection();
     case error_code::ephemeral_on_local_session:    throw ephemeral_on_local_session();
     case error_code::reconfiguration_disabled:      throw reconfiguration_disabled();
+    case error_code::throttled:                     throw throttled();
     case error_code::transaction_failed:            throw transaction_failed(error_code::transaction_failed, 0U);
     default:                                        throw error(code, "unknown");
     }
 }
 
-std::exception_ptr get_exception_ptr_of(error_code code)
+static std::exception_ptr make_exception_ptr_of(error_code code)
 {
     try
     {
@@ -67,6 +71,43 @@ std::exception_ptr get_exception_ptr_of(error_code code)
     }
 }
 
+// None of these exceptions carry anything beyond their code, so one instance of each can be handed to everybody
+static constexpr error_code shared_exception_codes[] =
+    {
+        error_code::no_entry,
+        error_code::entry_exists,
+        error_code::not_empty,
+        error_code::version_mismatch,
+        error_code::no_children_for_ephemerals,
+        error_code::connection_loss,
+        error_code::operation_timeout,
+        error_code::closed,
+        error_code::session_expired,
+        error_code::throttled,
+    };
+
+using shared_exception_table = std::array<std::exception_ptr, std::size(shared_exception_codes)>;
+
+static shared_exception_table make_shared_exceptions()
+{
+    shared_exception_table out;
+    for (std::size_t idx = 0U; idx < out.size(); ++idx)
+        out[idx] = make_exception_ptr_of(shared_exception_codes[idx]);
+    return out;
+}
+
+std::exception_ptr get_exception_ptr_of(error_code code)
+{
+    static const shared_exception_table shared_exceptions = make_shared_exceptions();
+
+    for (std::size_t idx = 0U; idx < shared_exceptions.size(); ++idx)
+    {
+        if (shared_exception_codes[idx] == code)
+            return shared_exceptions[idx];
+    }
+    return make_exception_ptr_of(code);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // error_category                                                                                                     //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -127,12 +168,24 @@ marshalling_error::marshalling_error() :
 
 marshalling_error::~marshalling_error() noexcept = default;
 
+operation_timeout::operation_timeout() :
+        transport_error(error_code::operation_timeout, "operation timed out")
+{ }
+
+operation_timeout::~operation_timeout() noexcept = default;
+
 not_implemented::not_implemented(ptr<const char> op_name) :
         error(error_code::not_implemented, std::string("Operation not implemented: ") + op_name)
 { }
 
 not_implemented::~not_implemented() noexcept = default;
 
+throttled::throttled() :
+        error(error_code::throttled, "too many requests in flight")
+{ }
+
+throttled::~throttled() noexcept = default;
+
 invalid_arguments::invalid_arguments(error_code code, const std::string& description) :
         error(code, description)
 { }
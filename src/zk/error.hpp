@@ -21,6 +21,7 @@ enum class error_code : int
     connection_loss             =   -4, //!< Code for \ref connection_loss.
     marshalling_error           =   -5, //!< Code for \ref marshalling_error.
     not_implemented             =   -6, //!< Code for \ref not_implemented.
+    operation_timeout           =   -7, //!< Code for \ref operation_timeout.
     invalid_arguments           =   -8, //!< Code for \ref invalid_arguments.
     new_configuration_no_quorum =  -13, //!< Code for \ref new_configuration_no_quorum.
     reconfiguration_in_progress =  -14, //!< Code for \ref reconfiguration_in_progress.
@@ -36,6 +37,7 @@ enum class error_code : int
     read_only_connection        = -119, //!< Code for \ref read_only_connection.
     ephemeral_on_local_session  = -120, //!< Code for \ref ephemeral_on_local_session.
     reconfiguration_disabled    = -123, //!< Code for \ref reconfiguration_disabled.
+    throttled                   = -127, //!< Code for \ref throttled.
     transaction_failed          = -199, //!< Code for \ref transaction_failed.
 };
 
@@ -43,7 +45,8 @@ enum class error_code : int
 inline constexpr bool is_transport_error(error_code code)
 {
     return code == error_code::connection_loss
-        || code == error_code::marshalling_error;
+        || code == error_code::marshalling_error
+        || code == error_code::operation_timeout;
 }
 
 /// Check if the provided \a code is an exception code for a \ref invalid_arguments type of exception.
@@ -93,6 +96,12 @@ void throw_error(error_code code);
 
 /// Get an \c std::exception_ptr containing an exception with the proper type for the given \a code.
 ///
+/// The codes which show up in normal operation (the \ref is_check_failed codes other than
+/// \ref error_code::transaction_failed, plus \ref error_code::connection_loss, \ref error_code::operation_timeout,
+/// \ref error_code::closed, \ref error_code::session_expired and \ref error_code::throttled) are answered from a table
+/// built on first use, so failing a busy stream of requests with them does not throw and catch an exception each time.
+/// Everyone who gets one of these shares the same exception object: catch it by \c const reference.
+///
 /// \see throw_error
 std::exception_ptr get_exception_ptr_of(error_code code);
 
@@ -162,6 +171,19 @@ public:
     virtual ~marshalling_error() noexcept;
 };
 
+/// The operation was given up on before its result arrived, as its \ref cancellation_token expired or was cancelled.
+///
+/// Like a \ref connection_loss, this says nothing about what the server did: the request may already have been sent,
+/// so a modification can still be applied after this is delivered. The late reply is discarded.
+class operation_timeout final :
+        public transport_error
+{
+public:
+    explicit operation_timeout();
+
+    virtual ~operation_timeout() noexcept;
+};
+
 /// Operation was attempted that was not implemented. If you happen to be writing a \ref connection implementation, you
 /// are encouraged to raise this error in cases where you have not implemented an operation.
 class not_implemented final :
@@ -174,6 +196,18 @@ public:
     virtual ~not_implemented() noexcept;
 };
 
+/// The operation was never sent, as the connection already had as many requests in flight as it allows (see
+/// \ref connection_params::max_reads_in_flight). Nothing was changed, so the operation can safely be retried once
+/// some of the outstanding requests have completed.
+class throttled final :
+        public error
+{
+public:
+    explicit throttled();
+
+    virtual ~throttled() noexcept;
+};
+
 /// Arguments to an operation were invalid.
 class invalid_arguments :
         public error
@@ -26,6 +26,8 @@ static error_code all_error_codes[] =
         error_code::ephemeral_on_local_session,
         error_code::reconfiguration_disabled,
         error_code::transaction_failed,
+        error_code::throttled,
+        error_code::operation_timeout,
     };
 
 GTEST_TEST(error_code_tests, throwing)
@@ -73,6 +75,11 @@ GTEST_TEST(error_code_tests, throwing)
                 CHECK_EQ(code, ex.code());
                 throw;
             }
+            catch (const throttled& ex)
+            {
+                CHECK_EQ(error_code::throttled, ex.code());
+                throw;
+            }
             catch (const error& ex)
             {
                 // not a real error, so it will come across as unknown
@@ -88,6 +95,38 @@ GTEST_TEST(error_code_tests, throwing)
     }
 }
 
+GTEST_TEST(error_code_tests, exception_ptr_of)
+{
+    for (error_code code : all_error_codes)
+    {
+        try
+        {
+            std::rethrow_exception(get_exception_ptr_of(code));
+        }
+        catch (const error& ex)
+        {
+            CHECK_EQ(code, ex.code());
+        }
+    }
+}
+
+GTEST_TEST(error_code_tests, exception_ptr_of_common_codes_is_shared)
+{
+    CHECK_TRUE(get_exception_ptr_of(error_code::no_entry) == get_exception_ptr_of(error_code::no_entry));
+    CHECK_TRUE(get_exception_ptr_of(error_code::entry_exists) == get_exception_ptr_of(error_code::entry_exists));
+    CHECK_FALSE(get_exception_ptr_of(error_code::no_entry) == get_exception_ptr_of(error_code::entry_exists));
+
+    // transaction_failed carries the failed operation, so it is never shared
+    CHECK_FALSE(get_exception_ptr_of(error_code::transaction_failed)
+                == get_exception_ptr_of(error_code::transaction_failed)
+               );
+
+    CHECK_THROWS(no_entry)
+    {
+        std::rethrow_exception(get_exception_ptr_of(error_code::no_entry));
+    };
+}
+
 GTEST_TEST(error_code_tests, to_string_bogus_code)
 {
     CHECK_EQ("error_code(19)", to_string(static_cast<error_code>(19)));
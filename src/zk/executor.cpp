@@ -0,0 +1,193 @@
+#include "executor.hpp"
+#include "admission.hpp"
+
+#include <condition_variable>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// executor                                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+executor::~executor() noexcept
+{ }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// inline_executor                                                                                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+class inline_executor_impl final :
+        public executor
+{
+public:
+    virtual void execute(task_type task) override
+    {
+        task();
+    }
+};
+
+}
+
+std::shared_ptr<executor> inline_executor()
+{
+    static const auto instance = std::make_shared<inline_executor_impl>();
+    return instance;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// thread_pool_executor                                                                                               //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+class thread_pool_executor_impl final :
+        public executor
+{
+public:
+    explicit thread_pool_executor_impl(std::size_t thread_count) :
+            _state(std::make_shared<pool_state>())
+    {
+        _workers.reserve(thread_count);
+        for (std::size_t idx = 0U; idx < thread_count; ++idx)
+            _workers.emplace_back([state = _state] { run(*state); });
+    }
+
+    virtual ~thread_pool_executor_impl() noexcept
+    {
+        {
+            std::unique_lock<std::mutex> ax(_state->protect);
+            _state->stopping = true;
+        }
+        _state->tasks_cv.notify_all();
+
+        for (auto& worker : _workers)
+        {
+            // The last reference can be dropped by a task, in which case its own thread can not be joined; it shares
+            // the queue, so it finishes whatever is left and exits on its own
+            if (worker.get_id() == std::this_thread::get_id())
+                worker.detach();
+            else
+                worker.join();
+        }
+    }
+
+    virtual void execute(task_type task) override
+    {
+        {
+            std::unique_lock<std::mutex> ax(_state->protect);
+            _state->tasks.emplace_back(std::move(task));
+        }
+        _state->tasks_cv.notify_one();
+    }
+
+private:
+    struct pool_state
+    {
+        std::mutex              protect;
+        std::condition_variable tasks_cv;
+        std::deque<task_type>   tasks;
+        bool                    stopping = false;
+    };
+
+    static void run(pool_state& state)
+    {
+        std::unique_lock<std::mutex> ax(state.protect);
+        while (true)
+        {
+            state.tasks_cv.wait(ax, [&] { return state.stopping || !state.tasks.empty(); });
+            if (state.tasks.empty())
+                return;
+
+            auto task = std::move(state.tasks.front());
+            state.tasks.pop_front();
+            ax.unlock();
+            task();
+            task = nullptr;
+            ax.lock();
+        }
+    }
+
+private:
+    std::shared_ptr<pool_state> _state;
+    std::vector<std::thread>    _workers;
+};
+
+}
+
+std::shared_ptr<executor> thread_pool_executor(std::size_t thread_count)
+{
+    if (thread_count == 0U)
+        throw std::invalid_argument("A thread_pool_executor needs at least one thread");
+
+    return std::make_shared<thread_pool_executor_impl>(thread_count);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ordered_executor                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ordered_executor::ordered_executor(std::shared_ptr<executor> target, std::size_t lane_count) :
+        _target(std::move(target)),
+        _lane_count(lane_count),
+        _lanes(new lane_state[lane_count])
+{ }
+
+std::shared_ptr<ordered_executor> ordered_executor::create(std::shared_ptr<executor> target, std::size_t lane_count)
+{
+    if (!target)
+        throw std::invalid_argument("An ordered_executor needs a target executor");
+    if (lane_count == 0U)
+        throw std::invalid_argument("An ordered_executor needs at least one lane");
+
+    return std::shared_ptr<ordered_executor>(new ordered_executor(std::move(target), lane_count));
+}
+
+ordered_executor::~ordered_executor() noexcept = default;
+
+std::size_t ordered_executor::lane_for(string_view key) const
+{
+    return std::hash<string_view>()(key) % _lane_count;
+}
+
+void ordered_executor::execute(std::size_t lane, task_type task)
+{
+    auto& state = _lanes[lane % _lane_count];
+    {
+        std::unique_lock<std::mutex> ax(state.protect);
+        state.tasks.emplace_back(std::move(task));
+        if (std::exchange(state.scheduled, true))
+            return;
+    }
+
+    // The lane holds the executor alive until it has drained, even if whoever made it is gone by then
+    _target->execute([self = shared_from_this(), lane] { self->drain(lane); });
+}
+
+void ordered_executor::drain(std::size_t lane)
+{
+    completion_thread_scope delivering;
+
+    auto& state = _lanes[lane % _lane_count];
+    std::unique_lock<std::mutex> ax(state.protect);
+    while (!state.tasks.empty())
+    {
+        auto task = std::move(state.tasks.front());
+        state.tasks.pop_front();
+        ax.unlock();
+        task();
+        task = nullptr;
+        ax.lock();
+    }
+    state.scheduled = false;
+}
+
+}
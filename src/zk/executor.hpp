@@ -0,0 +1,91 @@
+/// \file
+/// Defines the \ref zk::executor interface used to control where callbacks run.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "string_view.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// Something which runs tasks. This is the extension point for choosing the thread which user code is run on (see
+/// \ref via). Implementations must be thread-safe, as \ref execute is called from the ZooKeeper completion thread.
+class executor
+{
+public:
+    using task_type = std::function<void ()>;
+
+public:
+    virtual ~executor() noexcept;
+
+    /// Arrange for \a task to be run. This should not block for long -- while it is running, no other completions can be
+    /// delivered by the connection which called it.
+    virtual void execute(task_type task) = 0;
+};
+
+/// Get an \ref executor which runs tasks immediately on the thread that submits them.
+std::shared_ptr<executor> inline_executor();
+
+/// Create an \ref executor which runs tasks on \a thread_count threads of its own, in no particular order. Tasks which
+/// are still queued when the last reference to the pool goes away are run before its threads exit.
+///
+/// \param thread_count How many threads to run tasks on. It must be greater than \c 0.
+std::shared_ptr<executor> thread_pool_executor(std::size_t thread_count);
+
+/// Runs tasks through a target \ref executor while keeping the tasks of each lane in the order they were submitted:
+/// a lane has at most one task handed to the target at a time. Tasks in different lanes run in parallel, as far as the
+/// target allows. Which lane a task belongs in is up to the caller; \ref lane_for picks one from a key such as a path.
+class ordered_executor final :
+        public std::enable_shared_from_this<ordered_executor>
+{
+public:
+    using task_type = executor::task_type;
+
+public:
+    /// \param target Where the tasks are run.
+    /// \param lane_count The number of lanes. It must be greater than \c 0. Tasks with unrelated keys can still share
+    ///  a lane, so more lanes means less unneeded waiting.
+    static std::shared_ptr<ordered_executor> create(std::shared_ptr<executor> target, std::size_t lane_count = 64U);
+
+    ~ordered_executor() noexcept;
+
+    std::size_t lane_count() const { return _lane_count; }
+
+    /// Get the lane the tasks for \a key go in. The same key always gets the same lane.
+    std::size_t lane_for(string_view key) const;
+
+    /// Run \a task after every task previously given to \a lane.
+    void execute(std::size_t lane, task_type task);
+
+private:
+    struct lane_state
+    {
+        std::mutex            protect;
+        std::deque<task_type> tasks;
+        bool                  scheduled = false;
+    };
+
+    ordered_executor(std::shared_ptr<executor> target, std::size_t lane_count);
+
+    /// Run the tasks of \a lane until it is empty. This is what is handed to the target.
+    void drain(std::size_t lane);
+
+private:
+    std::shared_ptr<executor>     _target;
+    std::size_t                   _lane_count;
+    std::unique_ptr<lane_state[]> _lanes;
+};
+
+/// \}
+
+}
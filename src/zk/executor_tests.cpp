@@ -0,0 +1,67 @@
+#include <zk/tests/test.hpp>
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "executor.hpp"
+
+namespace zk
+{
+
+GTEST_TEST(executor_tests, thread_pool_runs_everything)
+{
+    std::atomic<int>   count(0);
+    std::promise<void> all_done;
+    {
+        auto pool = thread_pool_executor(3U);
+        for (int idx = 0; idx < 100; ++idx)
+            pool->execute([&] { if (++count == 100) all_done.set_value(); });
+        all_done.get_future().get();
+    }
+    CHECK_EQ(100, count.load());
+}
+
+GTEST_TEST(executor_tests, thread_pool_needs_threads)
+{
+    CHECK_THROWS(std::invalid_argument) { thread_pool_executor(0U); };
+}
+
+GTEST_TEST(executor_tests, ordered_keeps_lane_order)
+{
+    auto ordered = ordered_executor::create(thread_pool_executor(4U), 8U);
+    CHECK_EQ(8U, ordered->lane_count());
+    CHECK_EQ(ordered->lane_for("/a/b"), ordered->lane_for("/a/b"));
+
+    std::mutex         seen_protect;
+    std::vector<int>   seen;
+    std::promise<void> all_done;
+    auto               lane = ordered->lane_for("/a/b");
+    for (int idx = 0; idx < 500; ++idx)
+    {
+        ordered->execute(lane,
+                         [&, idx]
+                         {
+                             std::unique_lock<std::mutex> ax(seen_protect);
+                             seen.push_back(idx);
+                             if (seen.size() == 500U)
+                                 all_done.set_value();
+                         }
+                        );
+    }
+    all_done.get_future().get();
+
+    std::unique_lock<std::mutex> ax(seen_protect);
+    for (int idx = 0; idx < 500; ++idx)
+        CHECK_EQ(idx, seen[std::size_t(idx)]);
+}
+
+GTEST_TEST(executor_tests, ordered_needs_target)
+{
+    CHECK_THROWS(std::invalid_argument) { ordered_executor::create(nullptr); };
+    CHECK_THROWS(std::invalid_argument) { ordered_executor::create(inline_executor(), 0U); };
+}
+
+}
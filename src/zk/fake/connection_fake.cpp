@@ -0,0 +1,262 @@
+#include "connection_fake.hpp"
+#include "server.hpp"
+
+#include <zk/error.hpp>
+#include <zk/multi.hpp>
+#include <zk/results.hpp>
+#include <zk/types.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+namespace zk::fake
+{
+
+namespace
+{
+
+/// The two places the event of a watch goes: the \c future of its result and the callback it was set with (if any).
+struct watch_entry final
+{
+    explicit watch_entry(event_callback on_event) :
+            on_event(std::move(on_event))
+    { }
+
+    void deliver(event ev)
+    {
+        event_promise.set_value(ev);
+        if (on_event)
+            on_event(std::move(ev));
+    }
+
+    promise<event> event_promise;
+    event_callback on_event;
+};
+
+std::shared_ptr<server> find_target(const connection_params& params)
+{
+    if (params.hosts().size() != 1U)
+        throw std::invalid_argument("A fakezk connection string names one server");
+
+    auto out = server::find(params.hosts().front());
+    if (!out)
+        throw std::invalid_argument("No fakezk server is named \"" + params.hosts().front() + "\"");
+    return out;
+}
+
+/// Set a watch through \a request and complete \a on_complete with the \c TWatchResult made of the initial result and
+/// the \c future of the event.
+template <typename TWatchResult, typename TResult, typename FRequest>
+void set_watch(callback<TWatchResult> on_complete, event_callback on_event, FRequest request)
+{
+    auto entry = std::make_shared<watch_entry>(std::move(on_event));
+    request([entry] (event ev) { entry->deliver(std::move(ev)); },
+            [entry, on_complete = std::move(on_complete)] (outcome<TResult> result)
+            {
+                if (result)
+                    on_complete(TWatchResult(std::move(result).value(), entry->event_promise.get_future()));
+                else
+                    on_complete(outcome<TWatchResult>(result.code(), result.error()));
+            }
+           );
+}
+
+}
+
+connection_fake::connection_fake(const connection_params& params) :
+        connection_fake(find_target(params), params)
+{ }
+
+connection_fake::connection_fake(std::shared_ptr<server> target, const connection_params& params) :
+        _server(std::move(target)),
+        _life(std::make_shared<int>(0)),
+        _state(zk::state::connecting)
+{
+    if (!_server)
+        throw std::invalid_argument("A fakezk connection needs a server");
+
+    _session = _server->open_session(params,
+                                     [this, life = std::weak_ptr<int>(_life)] (zk::state new_state)
+                                     {
+                                         if (auto alive = life.lock())
+                                             on_state(new_state);
+                                     }
+                                    );
+    _state.store(_server->session_state(_session), std::memory_order_release);
+}
+
+connection_fake::~connection_fake() noexcept
+{
+    _life.reset();
+    _server->close_session(_session);
+}
+
+void connection_fake::close()
+{
+    _server->close_session(_session);
+}
+
+zk::state connection_fake::state() const
+{
+    return _state.load(std::memory_order_acquire);
+}
+
+void connection_fake::on_state(zk::state new_state)
+{
+    _state.store(new_state, std::memory_order_release);
+    on_session_event(new_state);
+}
+
+void connection_fake::get(path_view path, callback<get_result> on_complete)
+{
+    _server->get(_session, path, nullptr, std::move(on_complete));
+}
+
+void connection_fake::watch(path_view path, callback<watch_result> on_complete)
+{
+    watch(path, std::move(on_complete), nullptr);
+}
+
+void connection_fake::watch(path_view path, callback<watch_result> on_complete, event_callback on_event)
+{
+    set_watch<watch_result, get_result>(std::move(on_complete),
+                                        std::move(on_event),
+                                        [&] (event_callback deliver, callback<get_result> on_initial)
+                                        {
+                                            _server->get(_session, path, std::move(deliver), std::move(on_initial));
+                                        }
+                                       );
+}
+
+void connection_fake::get_children(path_view path, callback<get_children_result> on_complete)
+{
+    _server->get_children(_session, path, nullptr, std::move(on_complete));
+}
+
+void connection_fake::watch_children(path_view path, callback<watch_children_result> on_complete)
+{
+    watch_children(path, std::move(on_complete), nullptr);
+}
+
+void connection_fake::watch_children(path_view                       path,
+                                     callback<watch_children_result> on_complete,
+                                     event_callback                  on_event
+                                    )
+{
+    set_watch<watch_children_result, get_children_result>(
+            std::move(on_complete),
+            std::move(on_event),
+            [&] (event_callback deliver, callback<get_children_result> on_initial)
+            {
+                _server->get_children(_session, path, std::move(deliver), std::move(on_initial));
+            }
+           );
+}
+
+void connection_fake::exists(path_view path, callback<exists_result> on_complete)
+{
+    _server->exists(_session, path, nullptr, std::move(on_complete));
+}
+
+void connection_fake::watch_exists(path_view path, callback<watch_exists_result> on_complete)
+{
+    watch_exists(path, std::move(on_complete), nullptr);
+}
+
+void connection_fake::watch_exists(path_view                     path,
+                                   callback<watch_exists_result> on_complete,
+                                   event_callback                on_event
+                                  )
+{
+    set_watch<watch_exists_result, exists_result>(std::move(on_complete),
+                                                  std::move(on_event),
+                                                  [&] (event_callback deliver, callback<exists_result> on_initial)
+                                                  {
+                                                      _server->exists(_session,
+                                                                      path,
+                                                                      std::move(deliver),
+                                                                      std::move(on_initial)
+                                                                     );
+                                                  }
+                                                 );
+}
+
+void connection_fake::create(path_view               path,
+                             const buffer&           data,
+                             const acl&              rules,
+                             create_mode             mode,
+                             callback<create_result> on_complete
+                            )
+{
+    _server->create(_session,
+                    path,
+                    string_view(data.data(), data.size()),
+                    rules,
+                    mode,
+                    std::move(on_complete)
+                   );
+}
+
+void connection_fake::set(path_view path, const buffer& data, version check, callback<set_result> on_complete)
+{
+    _server->set(_session, path, string_view(data.data(), data.size()), check, std::move(on_complete));
+}
+
+void connection_fake::erase(path_view path, version check, callback<void> on_complete)
+{
+    _server->erase(_session, path, check, std::move(on_complete));
+}
+
+void connection_fake::get_acl(path_view path, callback<get_acl_result> on_complete) const
+{
+    _server->get_acl(_session, path, std::move(on_complete));
+}
+
+void connection_fake::set_acl(path_view path, const acl& rules, acl_version check, callback<void> on_complete)
+{
+    _server->set_acl(_session, path, rules, check, std::move(on_complete));
+}
+
+void connection_fake::commit(multi_op&& txn, callback<multi_result> on_complete)
+{
+    // The server applies the transaction before this returns, so it can work on a view of the operations
+    _server->commit(_session, multi_op_view(txn), std::move(on_complete));
+}
+
+void connection_fake::commit(const multi_op_view& txn, callback<multi_result> on_complete)
+{
+    _server->commit(_session, txn, std::move(on_complete));
+}
+
+void connection_fake::load_fence(callback<void> on_complete)
+{
+    _server->load_fence(_session, std::move(on_complete));
+}
+
+void connection_fake::get_config(callback<get_result> on_complete)
+{
+    _server->get_config(_session, std::move(on_complete));
+}
+
+void connection_fake::reconfigure(const std::vector<std::string>&,
+                                  const std::vector<std::string>&,
+                                  const std::vector<std::string>&,
+                                  version,
+                                  callback<get_result> on_complete
+                                 )
+{
+    on_complete(error_code::reconfiguration_disabled);
+}
+
+void connection_fake::update_hosts(const std::vector<std::string>& hosts)
+{
+    if (hosts.empty())
+        throw std::invalid_argument("A connection needs at least one host");
+}
+
+optional<session_credentials> connection_fake::current_session() const
+{
+    return _server->credentials(_session);
+}
+
+}
@@ -0,0 +1,119 @@
+/// \file
+/// Defines \ref zk::fake::connection_fake, the connection behind the \c "fakezk" schema.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/connection.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zk::fake
+{
+
+/// \addtogroup Fake
+/// \{
+
+class server;
+
+/// A session on a \ref server in the memory of this process. This is the implementation behind the \c "fakezk" schema;
+/// the only host of the \ref connection_params is the \ref server::name (`"fakezk://unit-tests/app"`). Every request
+/// is served by the server on the calling thread, so with no \ref server::latency its result is delivered before the
+/// call which made it returns. The \c chroot and \c resume_session of the \ref connection_params are honored; the
+/// parameters about the network and the admission of requests are not used.
+class connection_fake final :
+        public connection
+{
+public:
+    /// Open a session on the server named by the only host of \a params.
+    ///
+    /// \throws std::invalid_argument if \a params does not have exactly one host or no server has that name.
+    explicit connection_fake(const connection_params& params);
+
+    /// Open a session on \a target, ignoring the hosts of \a params.
+    explicit connection_fake(std::shared_ptr<server> target, const connection_params& params = connection_params());
+
+    virtual ~connection_fake() noexcept;
+
+    virtual void close() override;
+
+    virtual zk::state state() const override;
+
+    virtual void get(path_view path, callback<get_result> on_complete) override;
+
+    virtual void watch(path_view path, callback<watch_result> on_complete) override;
+    virtual void watch(path_view path, callback<watch_result> on_complete, event_callback on_event) override;
+
+    virtual void get_children(path_view path, callback<get_children_result> on_complete) override;
+
+    virtual void watch_children(path_view path, callback<watch_children_result> on_complete) override;
+    virtual void watch_children(path_view                       path,
+                                callback<watch_children_result> on_complete,
+                                event_callback                  on_event
+                               ) override;
+
+    virtual void exists(path_view path, callback<exists_result> on_complete) override;
+
+    virtual void watch_exists(path_view path, callback<watch_exists_result> on_complete) override;
+    virtual void watch_exists(path_view                     path,
+                              callback<watch_exists_result> on_complete,
+                              event_callback                on_event
+                             ) override;
+
+    virtual void create(path_view               path,
+                        const buffer&           data,
+                        const acl&              rules,
+                        create_mode             mode,
+                        callback<create_result> on_complete
+                       ) override;
+
+    virtual void set(path_view path, const buffer& data, version check, callback<set_result> on_complete) override;
+
+    virtual void erase(path_view path, version check, callback<void> on_complete) override;
+
+    virtual void get_acl(path_view path, callback<get_acl_result> on_complete) const override;
+
+    virtual void set_acl(path_view path, const acl& rules, acl_version check, callback<void> on_complete) override;
+
+    virtual void commit(multi_op&& txn, callback<multi_result> on_complete) override;
+
+    virtual void commit(const multi_op_view& txn, callback<multi_result> on_complete) override;
+
+    virtual void load_fence(callback<void> on_complete) override;
+
+    /// A fake server is one standalone member with reconfiguration disabled: its configuration is that of
+    /// \c "/zookeeper/config" and \ref reconfigure fails with \ref error_code::reconfiguration_disabled.
+    virtual void get_config(callback<get_result> on_complete) override;
+
+    virtual void reconfigure(const std::vector<std::string>& joining,
+                             const std::vector<std::string>& leaving,
+                             const std::vector<std::string>& members,
+                             version                         from_config,
+                             callback<get_result>            on_complete
+                            ) override;
+
+    /// There is nowhere to move the session to, so this only checks \a hosts.
+    virtual void update_hosts(const std::vector<std::string>& hosts) override;
+
+    virtual optional<session_credentials> current_session() const override;
+
+    /// The server this session is on.
+    const std::shared_ptr<server>& target() const { return _server; }
+
+private:
+    /// Called by the server for each state the session enters.
+    void on_state(zk::state new_state);
+
+private:
+    std::shared_ptr<server> _server;
+    std::shared_ptr<int>    _life;
+    std::atomic<zk::state>  _state;
+    std::int64_t            _session;
+};
+
+/// \}
+
+}
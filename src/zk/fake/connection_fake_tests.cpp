@@ -0,0 +1,264 @@
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/multi.hpp>
+#include <zk/tests/test.hpp>
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include "connection_fake.hpp"
+#include "server.hpp"
+
+namespace zk::fake
+{
+
+static buffer buffer_from(const std::string& text)
+{
+    return buffer(text.data(), text.data() + text.size());
+}
+
+static bool is_ready(const future<event>& next)
+{
+    return next.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+static bool is_ready_void(const future<void>& done)
+{
+    return done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+GTEST_TEST(connection_fake_tests, connect_by_schema)
+{
+    auto srv = server::create("fake-connect");
+    CHECK_THROWS(std::invalid_argument) { server::create("fake-connect"); };
+    CHECK_THROWS(std::invalid_argument) { client("fakezk://nobody-has-this-name/"); };
+
+    client c = client::connect(srv->connection_string()).get();
+    CHECK_TRUE(c.exists("/zookeeper").get());
+    CHECK_EQ(1U, srv->session_count());
+    CHECK_TRUE(c.current_session());
+
+    c.close();
+    CHECK_EQ(0U, srv->session_count());
+    CHECK_FALSE(c.current_session());
+    CHECK_THROWS(closed) { c.exists("/").get(); };
+}
+
+GTEST_TEST(connection_fake_tests, stat_versions)
+{
+    auto   srv = server::create("fake-stat");
+    client c(srv->connection_string());
+
+    auto before = srv->last_transaction();
+    c.create("/stat", buffer_from("one")).get();
+    auto created = c.get("/stat").get();
+    CHECK_TRUE(buffer_from("one") == created.data());
+    CHECK_EQ(before.value + 1U, created.stat().create_transaction.value);
+    CHECK_EQ(created.stat().create_transaction, created.stat().modified_transaction);
+    CHECK_EQ(0, created.stat().data_version.value);
+    CHECK_EQ(3U, created.stat().data_size);
+
+    auto changed = c.set("/stat", buffer_from("two"), created.stat().data_version).get();
+    CHECK_EQ(1, changed.stat().data_version.value);
+    CHECK_EQ(created.stat().create_transaction, changed.stat().create_transaction);
+    CHECK_LT(created.stat().modified_transaction.value, changed.stat().modified_transaction.value);
+    CHECK_THROWS(version_mismatch) { c.set("/stat", buffer_from("three"), version(0)).get(); };
+    CHECK_THROWS(version_mismatch) { c.erase("/stat", version(0)).get(); };
+
+    c.create("/stat/child", buffer()).get();
+    auto parent = c.get("/stat").get().stat();
+    CHECK_EQ(1, parent.child_version.value);
+    CHECK_EQ(1U, parent.children_count);
+    CHECK_EQ(srv->last_transaction(), parent.child_modified_transaction);
+    CHECK_THROWS(not_empty) { c.erase("/stat").get(); };
+    CHECK_THROWS(entry_exists) { c.create("/stat", buffer()).get(); };
+    CHECK_THROWS(no_entry) { c.create("/missing/child", buffer()).get(); };
+    CHECK_THROWS(invalid_arguments) { c.get("relative").get(); };
+}
+
+GTEST_TEST(connection_fake_tests, sequential_and_ephemeral)
+{
+    auto   srv = server::create("fake-sequence");
+    client c(srv->connection_string());
+
+    c.create("/queue", buffer()).get();
+    c.create("/queue/other", buffer()).get();
+    CHECK_EQ("/queue/item-0000000001", c.create("/queue/item-", buffer(), create_mode::sequential).get().name());
+    CHECK_EQ("/queue/item-0000000002", c.create("/queue/item-", buffer(), create_mode::sequential).get().name());
+
+    {
+        client owner(srv->connection_string());
+        owner.create("/queue/owned", buffer(), create_mode::ephemeral).get();
+        CHECK_THROWS(no_children_for_ephemerals) { owner.create("/queue/owned/child", buffer()).get(); };
+        CHECK_TRUE(c.exists("/queue/owned").get());
+    }
+    CHECK_FALSE(c.exists("/queue/owned").get());
+}
+
+GTEST_TEST(connection_fake_tests, watches)
+{
+    auto   srv = server::create("fake-watch");
+    client c(srv->connection_string());
+
+    auto creation = c.watch_exists("/watched").get();
+    CHECK_FALSE(creation.initial());
+    c.create("/watched", buffer_from("a")).get();
+    auto created = creation.next().get();
+    CHECK_EQ(event_type::created, created.type());
+    CHECK_EQ("/watched", created.path());
+
+    auto data     = c.watch("/watched").get();
+    auto children = c.watch_children("/watched").get();
+    c.set("/watched", buffer_from("b")).get();
+    CHECK_EQ(event_type::changed, data.next().get().type());
+    CHECK_FALSE(is_ready(children.next()));
+
+    // A watch triggers once
+    auto again = c.watch("/watched").get();
+    c.create("/watched/child", buffer()).get();
+    CHECK_EQ(event_type::child, children.next().get().type());
+    CHECK_FALSE(is_ready(again.next()));
+    c.erase("/watched/child").get();
+    c.erase("/watched").get();
+    CHECK_EQ(event_type::erased, again.next().get().type());
+}
+
+GTEST_TEST(connection_fake_tests, chroot)
+{
+    auto   srv = server::create("fake-chroot");
+    client root(srv->connection_string());
+    root.create("/app", buffer()).get();
+
+    client app("fakezk://fake-chroot/app");
+    CHECK_EQ("/entry", app.create("/entry", buffer_from("x")).get().name());
+    CHECK_TRUE(root.exists("/app/entry").get());
+
+    auto watching = app.watch("/entry").get();
+    root.set("/app/entry", buffer_from("y")).get();
+    CHECK_EQ("/entry", watching.next().get().path());
+    CHECK_EQ(std::vector<std::string>{ "entry" }, app.get_children("/").get().children());
+}
+
+GTEST_TEST(connection_fake_tests, multi_is_atomic)
+{
+    auto   srv = server::create("fake-multi");
+    client c(srv->connection_string());
+    c.create("/txn", buffer_from("0")).get();
+
+    multi_op good;
+    good.push_back(op::check("/txn", version(0)));
+    good.push_back(op::create("/txn/a", buffer()));
+    good.push_back(op::set("/txn", buffer_from("1")));
+    auto before = srv->last_transaction();
+    auto result = c.commit(good).get();
+    CHECK_EQ(3U, result.size());
+    CHECK_EQ("/txn/a", result[1].as_create().name());
+    CHECK_EQ(1, result[2].as_set().stat().data_version.value);
+    CHECK_EQ(before.value + 1U, srv->last_transaction().value);
+
+    auto watching = c.watch("/txn").get();
+    multi_op bad;
+    bad.push_back(op::create("/txn/b", buffer()));
+    bad.push_back(op::erase("/txn/a"));
+    bad.push_back(op::set("/txn", buffer_from("2"), version(0)));
+    try
+    {
+        c.commit(bad).get();
+        CHECK_FAIL() << "The transaction should have failed";
+    }
+    catch (const transaction_failed& ex)
+    {
+        CHECK_EQ(error_code::version_mismatch, ex.underlying_cause());
+        CHECK_EQ(2U, ex.failed_op_index());
+    }
+
+    // Nothing of the failed transaction is left and no watch fired for it
+    CHECK_FALSE(c.exists("/txn/b").get());
+    CHECK_TRUE(c.exists("/txn/a").get());
+    CHECK_TRUE(buffer_from("1") == c.get("/txn").get().data());
+    CHECK_EQ(1, c.get("/txn").get().stat().child_version.value);
+    CHECK_FALSE(is_ready(watching.next()));
+}
+
+GTEST_TEST(connection_fake_tests, resume_session)
+{
+    auto srv   = server::create("fake-resume");
+    auto first = connection::connect(srv->connection_string());
+    first->create("/resumed", buffer(), acls::open_unsafe(), create_mode::ephemeral).get();
+    auto credentials = *first->current_session();
+
+    auto params             = connection_params::parse(srv->connection_string());
+    params.resume_session() = credentials;
+    client second(params);
+    CHECK_TRUE(second.current_session() == credentials);
+    CHECK_TRUE(second.exists("/resumed").get());
+
+    params.resume_session()->password = std::string(16U, 'x');
+    connection_fake stranger(params);
+    CHECK_EQ(state::expired_session, stranger.state());
+    CHECK_FALSE(stranger.current_session());
+}
+
+GTEST_TEST(connection_fake_tests, linearizable_reads)
+{
+    auto   srv = server::create("fake-linearizable");
+    client c(srv->connection_string());
+    client writer(srv->connection_string());
+
+    writer.create("/lease", buffer_from("held")).get();
+    writer.create("/lease/holder", buffer()).get();
+    CHECK_TRUE(buffer_from("held") == c.get_linearizable("/lease").get().data());
+    CHECK_EQ(std::vector<std::string>{ "holder" }, c.get_children_linearizable("/lease").get().children());
+    CHECK_TRUE(c.exists_linearizable("/lease").get());
+    CHECK_FALSE(c.exists_linearizable("/free").get());
+    CHECK_THROWS(no_entry) { c.get_linearizable("/free").get(); };
+
+    // The fence goes first, and a read it failed ahead of is not vouched for even though it succeeded
+    srv->fail_next(error_code::connection_loss);
+    CHECK_THROWS(connection_loss) { c.get_linearizable("/lease").get(); };
+    CHECK_TRUE(buffer_from("held") == c.get_linearizable("/lease").get().data());
+}
+
+GTEST_TEST(connection_fake_tests, read_many)
+{
+    auto   srv = server::create("fake-read-many");
+    client c(srv->connection_string());
+    c.create("/config", buffer_from("v1")).get();
+    c.create("/config/a", buffer()).get();
+
+    auto result = c.read_many(multi_op{ op::get("/config"), op::get_children("/config"), op::get("/nope") }).get();
+    CHECK_EQ(3U, result.size());
+    CHECK_TRUE(buffer_from("v1") == result[0].value().as_get().data());
+    CHECK_EQ(std::vector<std::string>{ "a" }, result[1].value().as_get_children().children());
+    CHECK_EQ(error_code::no_entry, result[2].code());
+    CHECK_EQ(0U, c.read_many(multi_op()).get().size());
+
+    multi_op mixed{ op::get("/config"), op::set("/config", buffer()) };
+    auto refused = c.read_many(mixed);
+    CHECK_THROWS(std::invalid_argument) { refused.get(); };
+    CHECK_THROWS(std::invalid_argument) { c.commit(multi_op{ op::get("/config") }).get(); };
+}
+
+GTEST_TEST(connection_fake_tests, close_all)
+{
+    auto srv = server::create("fake-close-all");
+    CHECK_TRUE(is_ready_void(close_all({})));
+
+    std::vector<client> clients;
+    for (int idx = 0; idx < 4; ++idx)
+        clients.emplace_back(srv->connection_string());
+    auto watching = clients.front().watch_exists("/never").get();
+    CHECK_EQ(4U, srv->session_count());
+
+    close_all(clients).get();
+    CHECK_EQ(0U, srv->session_count());
+    CHECK_EQ(state::closed, watching.next().get().state());
+    for (const auto& c : clients)
+        CHECK_THROWS(closed) { c.exists("/").get(); };
+
+    // Closing again is harmless
+    close_all(clients).get();
+}
+
+}
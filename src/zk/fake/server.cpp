@@ -0,0 +1,1067 @@
+#include "server.hpp"
+#include "connection_fake.hpp"
+
+#include <zk/connection.hpp>
+#include <zk/path.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <stdexcept>
+
+namespace zk::fake
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// delivery_queue                                                                                                     //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Shared by the server and its worker thread, so the thread can finish on its own when the last reference to the
+/// server goes away in one of the deliveries it makes.
+class server::delivery_queue final
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+public:
+    /// Deliver everything which was queued, each when it is due. Once \c stopping is set, what is left is delivered
+    /// without waiting for it.
+    static void run(std::shared_ptr<delivery_queue> self)
+    {
+        std::unique_lock<std::mutex> ax(self->protect);
+        while (true)
+        {
+            if (self->pending.empty())
+            {
+                if (self->stopping)
+                    return;
+
+                self->wake.wait(ax);
+                continue;
+            }
+
+            auto due = self->pending.front().first;
+            if (!self->stopping && clock::now() < due)
+            {
+                self->wake.wait_until(ax, due);
+                continue;
+            }
+
+            auto task = std::move(self->pending.front().second);
+            self->pending.pop_front();
+            self->busy = true;
+            ax.unlock();
+
+            task();
+            // What the task holds may be the last reference to the server, whose destructor takes the lock
+            task = nullptr;
+
+            ax.lock();
+            self->busy = false;
+        }
+    }
+
+public:
+    std::mutex                                         protect;
+    std::condition_variable                            wake;
+    std::deque<std::pair<clock::time_point, delivery>> pending;
+    duration_type                                      delay    = duration_type::zero();
+    bool                                               busy     = false;
+    bool                                               stopping = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Registry                                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+struct server_registry final
+{
+    std::mutex                                                protect;
+    std::map<std::string, std::weak_ptr<server>, std::less<>> servers;
+};
+
+server_registry& registered_servers()
+{
+    static server_registry instance;
+    return instance;
+}
+
+}
+
+std::shared_ptr<server> server::create(std::string name)
+{
+    if (name.empty() || name.find_first_of("/,") != std::string::npos)
+        throw std::invalid_argument("Invalid fakezk server name \"" + name + "\"");
+
+    // The client library does not know this module, so the schema is taught to it by the first server
+    static std::once_flag registered;
+    std::call_once(registered,
+                   []
+                   {
+                       connection::register_schema("fakezk",
+                                                   [] (const connection_params& params)
+                                                   {
+                                                       return std::make_shared<connection_fake>(params);
+                                                   }
+                                                  );
+                   }
+                  );
+
+    auto& registry = registered_servers();
+    std::unique_lock<std::mutex> ax(registry.protect);
+    auto iter = registry.servers.find(name);
+    if (iter != registry.servers.end() && !iter->second.expired())
+        throw std::invalid_argument("A fakezk server named \"" + name + "\" already exists");
+
+    std::shared_ptr<server> out(new server(name));
+    registry.servers[std::move(name)] = out;
+    return out;
+}
+
+std::shared_ptr<server> server::find(string_view name)
+{
+    auto& registry = registered_servers();
+    std::unique_lock<std::mutex> ax(registry.protect);
+    auto iter = registry.servers.find(name);
+    if (iter == registry.servers.end())
+        return nullptr;
+    else
+        return iter->second.lock();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// server                                                                                                             //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// A stat of the state of the tree before anything was done to it.
+static zk::stat initial_stat()
+{
+    zk::stat out{};
+    out.create_transaction         = transaction_id(0U);
+    out.modified_transaction       = transaction_id(0U);
+    out.child_modified_transaction = transaction_id(0U);
+    out.data_version               = version(0);
+    out.child_version              = child_version(0);
+    out.acl_version                = acl_version(0);
+    out.ephemeral_owner            = 0U;
+    out.data_size                  = 0U;
+    out.children_count             = 0U;
+    return out;
+}
+
+server::server(std::string name) :
+        _name(std::move(name)),
+        _queue(std::make_shared<delivery_queue>())
+{
+    auto root   = entry{ buffer(), acls::open_unsafe(), initial_stat(), {} };
+    auto zoo    = root;
+    auto config = root;
+    root.children.insert("zookeeper");
+    root.stat.children_count = 1U;
+    zoo.children.insert("config");
+    zoo.stat.children_count = 1U;
+    config.rules = acls::read_unsafe();
+
+    _tree.emplace("/", std::move(root));
+    _tree.emplace("/zookeeper", std::move(zoo));
+    _tree.emplace("/zookeeper/config", std::move(config));
+}
+
+server::~server() noexcept
+{
+    {
+        std::unique_lock<std::mutex> ax(_queue->protect);
+        _queue->stopping = true;
+    }
+    _queue->wake.notify_one();
+
+    if (_worker.joinable())
+    {
+        // The worker outlives this when it is the one letting go of the server
+        if (_worker.get_id() == std::this_thread::get_id())
+            _worker.detach();
+        else
+            _worker.join();
+    }
+
+    auto& registry = registered_servers();
+    std::unique_lock<std::mutex> ax(registry.protect);
+    auto iter = registry.servers.find(_name);
+    if (iter != registry.servers.end() && iter->second.expired())
+        registry.servers.erase(iter);
+}
+
+std::string server::connection_string() const
+{
+    return "fakezk://" + _name + "/";
+}
+
+server::duration_type server::latency() const
+{
+    std::unique_lock<std::mutex> ax(_queue->protect);
+    return _queue->delay;
+}
+
+void server::latency(duration_type value)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    {
+        std::unique_lock<std::mutex> qx(_queue->protect);
+        _queue->delay = std::max(value, duration_type::zero());
+    }
+
+    if (value > duration_type::zero() && !_worker.joinable())
+        _worker = std::thread(&delivery_queue::run, _queue);
+}
+
+void server::fail_next(error_code code, std::size_t count)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    _fail_next_with  = code;
+    _fail_next_count = code == error_code::ok ? 0U : count;
+}
+
+void server::lose_next_replies(error_code code, std::size_t count)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    _lose_next_with  = code;
+    _lose_next_count = code == error_code::ok ? 0U : count;
+}
+
+void server::fail_randomly(error_code code, double probability, std::uint64_t seed)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    _fail_randomly_with = code;
+    _fail_probability   = code == error_code::ok ? 0.0 : std::clamp(probability, 0.0, 1.0);
+    _rng.seed(seed);
+}
+
+void server::disconnect()
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    delivery_list out;
+    _reachable = false;
+    for (auto& [id, subject] : _sessions)
+    {
+        if (subject.state == zk::state::connected)
+            change_state(subject, zk::state::connecting, out);
+    }
+    deliver(ax, out);
+}
+
+void server::reconnect()
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    delivery_list out;
+    _reachable = true;
+    for (auto& [id, subject] : _sessions)
+    {
+        if (subject.state == zk::state::connecting)
+            change_state(subject, zk::state::connected, out);
+    }
+    deliver(ax, out);
+}
+
+void server::expire_sessions()
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    delivery_list out;
+    for (auto& [id, subject] : _sessions)
+    {
+        if (subject.state == zk::state::connected || subject.state == zk::state::connecting)
+            end_session(subject, zk::state::expired_session, out);
+    }
+    deliver(ax, out);
+}
+
+transaction_id server::last_transaction() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return transaction_id(_last_zxid);
+}
+
+std::size_t server::session_count() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return static_cast<std::size_t>(std::count_if(_sessions.begin(), _sessions.end(),
+                                                  [] (const auto& item)
+                                                  {
+                                                      return item.second.state == zk::state::connected
+                                                          || item.second.state == zk::state::connecting;
+                                                  }
+                                                 )
+                                   );
+}
+
+std::size_t server::entry_count() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return _tree.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sessions                                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::int64_t server::open_session(const connection_params& params, state_callback on_state)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+
+    auto chroot = params.chroot() == "/" ? std::string() : params.chroot();
+    if (auto resume = params.resume_session())
+    {
+        // Taking over a session moves it to this connection; one which is not known any more (or the wrong password)
+        // gets a session which is already over, as the ensemble would tell the client
+        auto iter = _sessions.find(resume->id);
+        if (iter != _sessions.end() && iter->second.password == resume->password
+            && (iter->second.state == zk::state::connected || iter->second.state == zk::state::connecting)
+           )
+        {
+            iter->second.chroot   = std::move(chroot);
+            iter->second.on_state = std::move(on_state);
+            return iter->first;
+        }
+
+        auto id = (std::int64_t(1) << 56) | ++_last_session;
+        _sessions.emplace(id, session{ id, std::string(), std::move(chroot), zk::state::expired_session, nullptr });
+        return id;
+    }
+
+    std::string password(session_credentials::password_size, '\0');
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (auto& c : password)
+        c = static_cast<char>(byte(_rng));
+
+    auto id    = (std::int64_t(1) << 56) | ++_last_session;
+    auto state = _reachable ? zk::state::connected : zk::state::connecting;
+    _sessions.emplace(id, session{ id, std::move(password), std::move(chroot), state, std::move(on_state) });
+    return id;
+}
+
+void server::close_session(std::int64_t id)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    auto iter = _sessions.find(id);
+    if (iter == _sessions.end())
+        return;
+
+    delivery_list out;
+    if (iter->second.state != zk::state::closed)
+        end_session(iter->second, zk::state::closed, out);
+    _sessions.erase(iter);
+    deliver(ax, out);
+}
+
+zk::state server::session_state(std::int64_t id) const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    auto iter = _sessions.find(id);
+    return iter == _sessions.end() ? zk::state::closed : iter->second.state;
+}
+
+optional<session_credentials> server::credentials(std::int64_t id) const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    auto iter = _sessions.find(id);
+    if (iter == _sessions.end()
+        || (iter->second.state != zk::state::connected && iter->second.state != zk::state::connecting)
+       )
+        return nullopt;
+
+    session_credentials out;
+    out.id       = iter->second.id;
+    out.password = iter->second.password;
+    return out;
+}
+
+void server::change_state(session& subject, zk::state to, delivery_list& out)
+{
+    subject.state = to;
+    if (subject.on_state)
+        out.emplace_back([on_state = subject.on_state, to] { on_state(to); });
+}
+
+void server::end_session(session& subject, zk::state final_state, delivery_list& out)
+{
+    for (auto table : { &_data_watches, &_exist_watches, &_child_watches })
+    {
+        for (auto iter = table->begin(); iter != table->end(); )
+        {
+            auto& watches = iter->second;
+            auto  mine    = std::stable_partition(watches.begin(), watches.end(),
+                                                  [&] (const watch& x) { return x.session != subject.id; }
+                                                 );
+            for (auto fired = mine; fired != watches.end(); ++fired)
+                out.emplace_back([on_event = std::move(fired->on_event), final_state]
+                                 {
+                                     on_event(event(event_type::session, final_state));
+                                 }
+                                );
+            watches.erase(mine, watches.end());
+
+            if (watches.empty())
+                iter = table->erase(iter);
+            else
+                ++iter;
+        }
+    }
+
+    std::vector<std::string> owned;
+    for (const auto& [path, node] : _tree)
+    {
+        if (node.stat.ephemeral_owner == static_cast<std::uint64_t>(subject.id))
+            owned.push_back(path);
+    }
+
+    if (!owned.empty())
+    {
+        // The ephemerals of a session all go in the one transaction which closes it; the deepest go first
+        change_list changes;
+        auto        zxid = _last_zxid + 1U;
+        std::sort(owned.rbegin(), owned.rend());
+        for (const auto& path : owned)
+            apply_erase(path, version::any(), zxid, nullptr, changes);
+        _last_zxid = zxid;
+        trigger(changes, out);
+    }
+
+    change_state(subject, final_state, out);
+}
+
+std::string server::full_path(const session& subject, string_view path) const
+{
+    // A relative path is left as it is, for the validation of the request to reject
+    if (subject.chroot.empty() || path.empty() || path.front() != '/')
+        return std::string(path);
+    else if (path == "/")
+        return subject.chroot;
+    else
+        return subject.chroot + std::string(path);
+}
+
+std::string server::client_path(std::int64_t session_id, const std::string& full) const
+{
+    auto iter = _sessions.find(session_id);
+    if (iter == _sessions.end() || iter->second.chroot.empty())
+        return full;
+    else if (full.size() == iter->second.chroot.size())
+        return "/";
+    else
+        return full.substr(iter->second.chroot.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Delivery                                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool server::defer(delivery_list& out)
+{
+    std::unique_lock<std::mutex> ax(_queue->protect);
+    // Whatever is already waiting must go first, even once the latency is back to zero
+    if (_queue->delay == duration_type::zero() && _queue->pending.empty() && !_queue->busy)
+        return false;
+
+    auto due = delivery_queue::clock::now() + _queue->delay;
+    for (auto& task : out)
+        _queue->pending.emplace_back(due, std::move(task));
+    out.clear();
+    ax.unlock();
+    _queue->wake.notify_one();
+    return true;
+}
+
+void server::deliver(std::unique_lock<std::mutex>& ax, delivery_list& out)
+{
+    if (out.empty() || defer(out))
+        return;
+
+    ax.unlock();
+    for (auto& task : out)
+        task();
+}
+
+error_code server::refusal(std::int64_t id)
+{
+    auto iter = _sessions.find(id);
+    if (iter == _sessions.end() || iter->second.state == zk::state::closed)
+        return error_code::closed;
+    else if (iter->second.state == zk::state::expired_session)
+        return error_code::session_expired;
+    else if (!_reachable)
+        return error_code::connection_loss;
+
+    if (_fail_next_count > 0U)
+    {
+        --_fail_next_count;
+        return _fail_next_with;
+    }
+
+    if (_fail_probability > 0.0 && std::bernoulli_distribution(_fail_probability)(_rng))
+        return _fail_randomly_with;
+
+    return error_code::ok;
+}
+
+template <typename TResult, typename FApply>
+void server::submit(std::int64_t id, callback<TResult> on_complete, FApply apply)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    delivery_list out;
+
+    auto rc      = refusal(id);
+    auto applied = rc == error_code::ok ? apply(_sessions.at(id), out) : outcome<TResult>(rc);
+    bool lost    = rc == error_code::ok && _lose_next_count > 0U;
+    if (lost)
+        --_lose_next_count;
+
+    auto result = std::make_shared<outcome<TResult>>(lost ? outcome<TResult>(_lose_next_with) : std::move(applied));
+    out.emplace_back([on_complete = std::move(on_complete), result] { on_complete(std::move(*result)); });
+    deliver(ax, out);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Watches                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void server::add_watch(watch_table& kind, const std::string& path, std::int64_t id, event_callback on_event)
+{
+    if (on_event)
+        kind[path].push_back(watch{ id, std::move(on_event) });
+}
+
+void server::trigger(const change_list& changes, delivery_list& out)
+{
+    for (const auto& change : changes)
+    {
+        std::vector<watch> fired;
+        auto take = [&] (watch_table& table)
+                    {
+                        auto iter = table.find(change.first);
+                        if (iter == table.end())
+                            return;
+
+                        for (auto& entry : iter->second)
+                            fired.emplace_back(std::move(entry));
+                        table.erase(iter);
+                    };
+
+        switch (change.second)
+        {
+        case event_type::created:
+        case event_type::changed:
+            take(_data_watches);
+            take(_exist_watches);
+            break;
+        case event_type::erased:
+            take(_data_watches);
+            take(_exist_watches);
+            take(_child_watches);
+            break;
+        case event_type::child:
+            take(_child_watches);
+            break;
+        default:
+            break;
+        }
+
+        for (auto& entry : fired)
+        {
+            event ev(change.second, zk::state::connected, client_path(entry.session, change.first));
+            out.emplace_back([on_event = std::move(entry.on_event), ev = std::move(ev)] { on_event(ev); });
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tree                                                                                                               //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The parent of the valid, non-root \a path.
+static std::string parent_of(const std::string& path)
+{
+    auto slash = path.rfind('/');
+    return slash == 0U ? std::string("/") : path.substr(0U, slash);
+}
+
+/// Paths of the tree which belong to the server itself and may not be changed by clients.
+static bool is_reserved(const std::string& path)
+{
+    return path == "/" || path == "/zookeeper" || path.compare(0U, 11U, "/zookeeper/") == 0;
+}
+
+static bool version_matches(std::int32_t expected, std::int32_t actual)
+{
+    return expected == -1 || expected == actual;
+}
+
+void server::save(const std::string& path, undo_log* undo) const
+{
+    if (!undo)
+        return;
+
+    auto saved = std::find_if(undo->begin(), undo->end(), [&] (const auto& item) { return item.first == path; });
+    if (saved != undo->end())
+        return;
+
+    auto iter = _tree.find(path);
+    if (iter == _tree.end())
+        undo->emplace_back(path, nullopt);
+    else
+        undo->emplace_back(path, iter->second);
+}
+
+error_code server::apply_check(const std::string& path, version check) const
+{
+    auto iter = _tree.find(path);
+    if (iter == _tree.end())
+        return error_code::no_entry;
+    else if (!version_matches(check.value, iter->second.stat.data_version.value))
+        return error_code::version_mismatch;
+    else
+        return error_code::ok;
+}
+
+error_code server::apply_create(const session&     owner,
+                                const std::string& path,
+                                string_view        data,
+                                const acl&         rules,
+                                create_mode        mode,
+                                std::size_t        zxid,
+                                std::string&       created,
+                                undo_log*          undo,
+                                change_list&       changes
+                               )
+{
+    bool sequential = is_set(mode, create_mode::sequential);
+    if (!path::is_valid(sequential ? path + "0" : path) || path == "/" || rules.size() == 0U)
+        return error_code::invalid_arguments;
+
+    auto parent_path = parent_of(path);
+    auto parent      = _tree.find(parent_path);
+    if (parent == _tree.end())
+        return error_code::no_entry;
+    else if (parent->second.stat.ephemeral_owner != 0U)
+        return error_code::no_children_for_ephemerals;
+
+    created = path;
+    if (sequential)
+    {
+        char suffix[16];
+        std::snprintf(suffix, sizeof suffix, "%010d", parent->second.stat.child_version.value);
+        created += suffix;
+    }
+
+    if (is_reserved(created))
+        return error_code::invalid_arguments;
+    else if (_tree.count(created) != 0U)
+        return error_code::entry_exists;
+
+    save(parent_path, undo);
+    save(created, undo);
+
+    entry node{ buffer(data.data(), data.data() + data.size()), rules, initial_stat(), {} };
+    node.stat.create_transaction         = transaction_id(zxid);
+    node.stat.modified_transaction       = transaction_id(zxid);
+    node.stat.child_modified_transaction = transaction_id(zxid);
+    node.stat.create_time                = std::chrono::system_clock::now();
+    node.stat.modified_time              = node.stat.create_time;
+    node.stat.data_size                  = data.size();
+    if (is_set(mode, create_mode::ephemeral))
+        node.stat.ephemeral_owner = static_cast<std::uint64_t>(owner.id);
+    _tree.emplace(created, std::move(node));
+
+    auto& parent_node = parent->second;
+    parent_node.children.insert(created.substr(parent_path.size() == 1U ? 1U : parent_path.size() + 1U));
+    parent_node.stat.child_version              = child_version(parent_node.stat.child_version.value + 1);
+    parent_node.stat.child_modified_transaction = transaction_id(zxid);
+    parent_node.stat.children_count             = parent_node.children.size();
+
+    changes.emplace_back(created, event_type::created);
+    changes.emplace_back(parent_path, event_type::child);
+    return error_code::ok;
+}
+
+error_code server::apply_set(const std::string& path,
+                             string_view        data,
+                             version            check,
+                             std::size_t        zxid,
+                             zk::stat&          result,
+                             undo_log*          undo,
+                             change_list&       changes
+                            )
+{
+    if (!path::is_valid(path) || is_reserved(path))
+        return error_code::invalid_arguments;
+
+    auto iter = _tree.find(path);
+    if (iter == _tree.end())
+        return error_code::no_entry;
+    else if (!version_matches(check.value, iter->second.stat.data_version.value))
+        return error_code::version_mismatch;
+
+    save(path, undo);
+    auto& node = iter->second;
+    node.data.assign(data.data(), data.data() + data.size());
+    node.stat.modified_transaction = transaction_id(zxid);
+    node.stat.modified_time        = std::chrono::system_clock::now();
+    node.stat.data_version         = version(node.stat.data_version.value + 1);
+    node.stat.data_size            = data.size();
+    result = node.stat;
+
+    changes.emplace_back(path, event_type::changed);
+    return error_code::ok;
+}
+
+error_code server::apply_erase(const std::string& path,
+                               version            check,
+                               std::size_t        zxid,
+                               undo_log*          undo,
+                               change_list&       changes
+                              )
+{
+    if (!path::is_valid(path) || is_reserved(path))
+        return error_code::invalid_arguments;
+
+    auto iter = _tree.find(path);
+    if (iter == _tree.end())
+        return error_code::no_entry;
+    else if (!version_matches(check.value, iter->second.stat.data_version.value))
+        return error_code::version_mismatch;
+    else if (!iter->second.children.empty())
+        return error_code::not_empty;
+
+    auto parent_path = parent_of(path);
+    save(parent_path, undo);
+    save(path, undo);
+    _tree.erase(iter);
+
+    auto& parent_node = _tree.at(parent_path);
+    parent_node.children.erase(path.substr(parent_path.size() == 1U ? 1U : parent_path.size() + 1U));
+    parent_node.stat.child_version              = child_version(parent_node.stat.child_version.value + 1);
+    parent_node.stat.child_modified_transaction = transaction_id(zxid);
+    parent_node.stat.children_count             = parent_node.children.size();
+
+    changes.emplace_back(path, event_type::erased);
+    changes.emplace_back(parent_path, event_type::child);
+    return error_code::ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Operations                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void server::get(std::int64_t id, string_view path, event_callback on_event, callback<get_result> on_complete)
+{
+    submit<get_result>(id,
+                       std::move(on_complete),
+                       [&] (session& subject, delivery_list&) -> outcome<get_result>
+                       {
+                           auto full = full_path(subject, path);
+                           if (!path::is_valid(path))
+                               return error_code::invalid_arguments;
+
+                           auto iter = _tree.find(full);
+                           if (iter == _tree.end())
+                               return error_code::no_entry;
+
+                           add_watch(_data_watches, full, subject.id, std::move(on_event));
+                           return get_result(iter->second.data, iter->second.stat);
+                       }
+                      );
+}
+
+void server::get_children(std::int64_t                  id,
+                          string_view                   path,
+                          event_callback                on_event,
+                          callback<get_children_result> on_complete
+                         )
+{
+    submit<get_children_result>(id,
+                                std::move(on_complete),
+                                [&] (session& subject, delivery_list&) -> outcome<get_children_result>
+                                {
+                                    auto full = full_path(subject, path);
+                                    if (!path::is_valid(path))
+                                        return error_code::invalid_arguments;
+
+                                    auto iter = _tree.find(full);
+                                    if (iter == _tree.end())
+                                        return error_code::no_entry;
+
+                                    add_watch(_child_watches, full, subject.id, std::move(on_event));
+                                    const auto& node = iter->second;
+                                    return get_children_result(
+                                            get_children_result::children_list_type(node.children.begin(),
+                                                                                    node.children.end()
+                                                                                   ),
+                                            node.stat
+                                           );
+                                }
+                               );
+}
+
+void server::exists(std::int64_t id, string_view path, event_callback on_event, callback<exists_result> on_complete)
+{
+    submit<exists_result>(id,
+                          std::move(on_complete),
+                          [&] (session& subject, delivery_list&) -> outcome<exists_result>
+                          {
+                              auto full = full_path(subject, path);
+                              if (!path::is_valid(path))
+                                  return error_code::invalid_arguments;
+
+                              // As on a real server, a watch on an entry which is not there waits for its creation
+                              auto iter = _tree.find(full);
+                              if (iter == _tree.end())
+                              {
+                                  add_watch(_exist_watches, full, subject.id, std::move(on_event));
+                                  return exists_result(nullopt);
+                              }
+                              else
+                              {
+                                  add_watch(_data_watches, full, subject.id, std::move(on_event));
+                                  return exists_result(iter->second.stat);
+                              }
+                          }
+                         );
+}
+
+void server::create(std::int64_t            id,
+                    string_view             path,
+                    string_view             data,
+                    const acl&              rules,
+                    create_mode             mode,
+                    callback<create_result> on_complete
+                   )
+{
+    submit<create_result>(id,
+                          std::move(on_complete),
+                          [&] (session& subject, delivery_list& out) -> outcome<create_result>
+                          {
+                              change_list changes;
+                              std::string created;
+                              auto        zxid = _last_zxid + 1U;
+                              auto        rc   = apply_create(subject,
+                                                              full_path(subject, path),
+                                                              data,
+                                                              rules,
+                                                              mode,
+                                                              zxid,
+                                                              created,
+                                                              nullptr,
+                                                              changes
+                                                             );
+                              if (rc != error_code::ok)
+                                  return rc;
+
+                              _last_zxid = zxid;
+                              trigger(changes, out);
+                              return create_result(client_path(subject.id, created));
+                          }
+                         );
+}
+
+void server::set(std::int64_t id, string_view path, string_view data, version check, callback<set_result> on_complete)
+{
+    submit<set_result>(id,
+                       std::move(on_complete),
+                       [&] (session& subject, delivery_list& out) -> outcome<set_result>
+                       {
+                           change_list changes;
+                           zk::stat    result;
+                           auto        zxid = _last_zxid + 1U;
+                           auto        rc   = apply_set(full_path(subject, path),
+                                                        data,
+                                                        check,
+                                                        zxid,
+                                                        result,
+                                                        nullptr,
+                                                        changes
+                                                       );
+                           if (rc != error_code::ok)
+                               return rc;
+
+                           _last_zxid = zxid;
+                           trigger(changes, out);
+                           return set_result(result);
+                       }
+                      );
+}
+
+void server::erase(std::int64_t id, string_view path, version check, callback<void> on_complete)
+{
+    submit<void>(id,
+                 std::move(on_complete),
+                 [&] (session& subject, delivery_list& out) -> outcome<void>
+                 {
+                     change_list changes;
+                     auto        zxid = _last_zxid + 1U;
+                     auto        rc   = apply_erase(full_path(subject, path), check, zxid, nullptr, changes);
+                     if (rc != error_code::ok)
+                         return rc;
+
+                     _last_zxid = zxid;
+                     trigger(changes, out);
+                     return outcome<void>();
+                 }
+                );
+}
+
+void server::get_acl(std::int64_t id, string_view path, callback<get_acl_result> on_complete)
+{
+    submit<get_acl_result>(id,
+                           std::move(on_complete),
+                           [&] (session& subject, delivery_list&) -> outcome<get_acl_result>
+                           {
+                               if (!path::is_valid(path))
+                                   return error_code::invalid_arguments;
+
+                               auto iter = _tree.find(full_path(subject, path));
+                               if (iter == _tree.end())
+                                   return error_code::no_entry;
+                               else
+                                   return get_acl_result(iter->second.rules, iter->second.stat);
+                           }
+                          );
+}
+
+void server::set_acl(std::int64_t id, string_view path, const acl& rules, acl_version check, callback<void> on_complete)
+{
+    submit<void>(id,
+                 std::move(on_complete),
+                 [&] (session& subject, delivery_list&) -> outcome<void>
+                 {
+                     auto full = full_path(subject, path);
+                     if (!path::is_valid(path) || is_reserved(full) || rules.size() == 0U)
+                         return error_code::invalid_arguments;
+
+                     auto iter = _tree.find(full);
+                     if (iter == _tree.end())
+                         return error_code::no_entry;
+                     else if (!version_matches(check.value, iter->second.stat.acl_version.value))
+                         return error_code::version_mismatch;
+
+                     // Changing the rules is a transaction, but it leaves the modification zxid and time alone
+                     iter->second.rules            = rules;
+                     iter->second.stat.acl_version = acl_version(iter->second.stat.acl_version.value + 1);
+                     ++_last_zxid;
+                     return outcome<void>();
+                 }
+                );
+}
+
+void server::commit(std::int64_t id, const multi_op_view& txn, callback<multi_result> on_complete)
+{
+    for (std::size_t idx = 0U; idx < txn.size(); ++idx)
+    {
+        if (is_read(txn[idx].type()))
+            throw std::invalid_argument("Invalid op_type at index=" + std::to_string(idx) + ": "
+                                        + to_string(txn[idx].type())
+                                       );
+    }
+
+    submit<multi_result>(id,
+                         std::move(on_complete),
+                         [&] (session& subject, delivery_list& out) -> outcome<multi_result>
+                         {
+                             change_list  changes;
+                             undo_log     undo;
+                             multi_result result;
+                             result.reserve(txn.size());
+
+                             // Every operation is part of the one transaction, so they all get the same zxid
+                             auto zxid = _last_zxid + 1U;
+                             for (std::size_t idx = 0U; idx < txn.size(); ++idx)
+                             {
+                                 const auto& src_op = txn[idx];
+                                 auto        full   = full_path(subject, src_op.path().view());
+                                 auto        rc     = error_code::ok;
+                                 switch (src_op.type())
+                                 {
+                                 case op_type::check:
+                                     rc = apply_check(full, src_op.check());
+                                     if (rc == error_code::ok)
+                                         result.emplace_back(op_type::check, nullptr);
+                                     break;
+                                 case op_type::create:
+                                 {
+                                     std::string created;
+                                     const acl&  rules = src_op.handle() ? src_op.handle()->rules() : *src_op.rules();
+                                     rc = apply_create(subject,
+                                                       full,
+                                                       src_op.data(),
+                                                       rules,
+                                                       src_op.mode(),
+                                                       zxid,
+                                                       created,
+                                                       &undo,
+                                                       changes
+                                                      );
+                                     if (rc == error_code::ok)
+                                         result.emplace_back(create_result(client_path(subject.id, created)));
+                                     break;
+                                 }
+                                 case op_type::erase:
+                                     rc = apply_erase(full, src_op.check(), zxid, &undo, changes);
+                                     if (rc == error_code::ok)
+                                         result.emplace_back(op_type::erase, nullptr);
+                                     break;
+                                 case op_type::set:
+                                 {
+                                     zk::stat st;
+                                     rc = apply_set(full, src_op.data(), src_op.check(), zxid, st, &undo, changes);
+                                     if (rc == error_code::ok)
+                                         result.emplace_back(set_result(st));
+                                     break;
+                                 }
+                                 default:
+                                     rc = error_code::invalid_arguments;
+                                     break;
+                                 }
+
+                                 if (rc != error_code::ok)
+                                 {
+                                     for (auto iter = undo.rbegin(); iter != undo.rend(); ++iter)
+                                     {
+                                         if (iter->second)
+                                             _tree[iter->first] = std::move(*iter->second);
+                                         else
+                                             _tree.erase(iter->first);
+                                     }
+                                     return outcome<multi_result>(error_code::transaction_failed,
+                                                                  std::make_exception_ptr(transaction_failed(rc, idx))
+                                                                 );
+                                 }
+                             }
+
+                             if (!txn.empty())
+                                 _last_zxid = zxid;
+                             trigger(changes, out);
+                             return result;
+                         }
+                        );
+}
+
+void server::load_fence(std::int64_t id, callback<void> on_complete)
+{
+    // Every session sees every change as soon as it is made, so there is never anything to wait for
+    submit<void>(id, std::move(on_complete), [] (session&, delivery_list&) { return outcome<void>(); });
+}
+
+void server::get_config(std::int64_t id, callback<get_result> on_complete)
+{
+    submit<get_result>(id,
+                       std::move(on_complete),
+                       [&] (session&, delivery_list&) -> outcome<get_result>
+                       {
+                           const auto& node = _tree.at("/zookeeper/config");
+                           return get_result(node.data, node.stat);
+                       }
+                      );
+}
+
+}
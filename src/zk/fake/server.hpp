@@ -0,0 +1,311 @@
+/// \file
+/// Defines \ref zk::fake::server, a ZooKeeper ensemble which lives in the memory of this process.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/acl.hpp>
+#include <zk/buffer.hpp>
+#include <zk/callback.hpp>
+#include <zk/error.hpp>
+#include <zk/forwards.hpp>
+#include <zk/multi.hpp>
+#include <zk/optional.hpp>
+#include <zk/results.hpp>
+#include <zk/string_view.hpp>
+#include <zk/types.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace zk::fake
+{
+
+/// \defgroup Fake
+/// An in-memory stand-in for a ZooKeeper ensemble, for tests which need one but not a JVM and for benchmarks of the
+/// client side alone.
+/// \{
+
+class connection_fake;
+
+/// A ZooKeeper ensemble which lives in the memory of this process. Clients reach it through the \c "fakezk" schema,
+/// with the \ref name of the server as the only host: `"fakezk://unit-tests/app"` is a session on the server created
+/// as \c "unit-tests", chrooted to \c "/app" (see \ref connection_string).
+///
+/// The semantics applications depend on are those of a real ensemble. Every change is a transaction with the next
+/// zxid, which the \ref zk::stat of the entries it touched records along with their versions. Sequential entries are
+/// named after the child version of their parent, ephemeral entries are erased with the session which created them and
+/// a \ref multi_op is applied entirely or not at all. Watches trigger once, with the event a server would send, and the
+/// session which made a change gets the events it triggers before the result of the change. Neither authentication nor
+/// ACLs are enforced: the rules of an entry are kept and returned, but every session may do everything. Containers are
+/// never erased for being empty.
+///
+/// Faults can be injected to see how an application copes with them: the \ref latency of every reply, failures of
+/// requests with a chosen \ref error_code (\ref fail_next and \ref fail_randomly), losing the replies to requests which
+/// were applied (\ref lose_next_replies), losing contact with the ensemble (\ref disconnect) and the expiry of sessions
+/// (\ref expire_sessions).
+class server final :
+        public std::enable_shared_from_this<server>
+{
+public:
+    using duration_type = std::chrono::microseconds;
+
+public:
+    /// Create a server reachable as \a name. It starts out with only the \c "/", \c "/zookeeper" and
+    /// \c "/zookeeper/config" entries. The name is free again once the server and every connection to it are gone.
+    ///
+    /// \throws std::invalid_argument if \a name is empty or contains a \c '/' or \c ',', or another server has it.
+    static std::shared_ptr<server> create(std::string name);
+
+    /// Find the server named \a name.
+    ///
+    /// \returns The server or \c nullptr if there is none of that name.
+    static std::shared_ptr<server> find(string_view name);
+
+    server(const server&) = delete;
+    server& operator=(const server&) = delete;
+
+    ~server() noexcept;
+
+    const std::string& name() const { return _name; }
+
+    /// The connection string of a session on this server (`"fakezk://name/"`).
+    std::string connection_string() const;
+
+    /// \{
+    /// How long replies take. With zero (the default), a request completes on the calling thread before the call which
+    /// made it returns. Otherwise the results of requests, watch events and session events are delivered by a thread of
+    /// this server this long after they happened, in the order they happened. Changes are applied right away either
+    /// way, so another session can see a change before the one which made it learns that it is done.
+    duration_type latency() const;
+    void          latency(duration_type value);
+    /// \}
+
+    /// Fail the next \a count requests with \a code. They change nothing and set no watches.
+    void fail_next(error_code code, std::size_t count = 1U);
+
+    /// Apply the next \a count requests, but fail their replies with \a code, as when the connection drops after the
+    /// ensemble heard a request and before its answer arrived. Their changes and watches stay.
+    void lose_next_replies(error_code code, std::size_t count = 1U);
+
+    /// Fail each request with \a code at the given \a probability (\c 0 stops failing them). The choice is made by a
+    /// generator started from \a seed, so the same sequence of requests fails in the same places on every run.
+    void fail_randomly(error_code code, double probability, std::uint64_t seed = 0U);
+
+    /// Make the ensemble unreachable. Every open session goes to \ref state::connecting and requests fail with
+    /// \ref error_code::connection_loss until \ref reconnect. Sessions and watches are kept, as they are over a
+    /// partition which heals before the session timeout.
+    void disconnect();
+
+    /// Make the ensemble reachable again after \ref disconnect; the sessions go back to \ref state::connected.
+    void reconnect();
+
+    /// Expire every open session. Their ephemeral entries are erased, their watches get a \ref state::expired_session
+    /// event and their requests fail with \ref error_code::session_expired from then on.
+    void expire_sessions();
+
+    /// The zxid of the last transaction.
+    transaction_id last_transaction() const;
+
+    /// The number of sessions which have neither been closed nor expired.
+    std::size_t session_count() const;
+
+    /// The number of entries in the tree, \c "/" included.
+    std::size_t entry_count() const;
+
+private:
+    /// Runs the deliveries which are not made on the calling thread (see \ref latency).
+    class delivery_queue;
+
+    /// Something to tell a client once the server lock is let go: the result of a request or an event.
+    using delivery = std::function<void ()>;
+
+    using delivery_list = std::vector<delivery>;
+
+    struct entry final
+    {
+        buffer                data;
+        acl                   rules;
+        zk::stat              stat;
+        std::set<std::string> children;
+    };
+
+    using entry_map = std::map<std::string, entry>;
+
+    struct session final
+    {
+        std::int64_t   id;
+        std::string    password;
+        std::string    chroot;
+        zk::state      state;
+        state_callback on_state;
+    };
+
+    struct watch final
+    {
+        std::int64_t   session;
+        event_callback on_event;
+    };
+
+    using watch_table = std::unordered_map<std::string, std::vector<watch>>;
+
+    /// The entries changed by a transaction and how, to trigger their watches with once it is applied.
+    using change_list = std::vector<std::pair<std::string, event_type>>;
+
+    /// What the entries a transaction changed were before it, to put back if one of its operations fails. An entry
+    /// which did not exist is saved as \c nullopt.
+    using undo_log = std::vector<std::pair<std::string, optional<entry>>>;
+
+    friend class connection_fake;
+
+private:
+    explicit server(std::string name);
+
+    /// \{
+    /// The interface to \ref connection_fake. Paths are those the client gave, before its chroot is applied.
+    std::int64_t open_session(const connection_params& params, state_callback on_state);
+
+    void close_session(std::int64_t id);
+
+    zk::state session_state(std::int64_t id) const;
+
+    optional<session_credentials> credentials(std::int64_t id) const;
+
+    void get(std::int64_t id, string_view path, event_callback on_event, callback<get_result> on_complete);
+
+    void get_children(std::int64_t                  id,
+                      string_view                   path,
+                      event_callback                on_event,
+                      callback<get_children_result> on_complete
+                     );
+
+    void exists(std::int64_t id, string_view path, event_callback on_event, callback<exists_result> on_complete);
+
+    void create(std::int64_t            id,
+                string_view             path,
+                string_view             data,
+                const acl&              rules,
+                create_mode             mode,
+                callback<create_result> on_complete
+               );
+
+    void set(std::int64_t id, string_view path, string_view data, version check, callback<set_result> on_complete);
+
+    void erase(std::int64_t id, string_view path, version check, callback<void> on_complete);
+
+    void get_acl(std::int64_t id, string_view path, callback<get_acl_result> on_complete);
+
+    void set_acl(std::int64_t id, string_view path, const acl& rules, acl_version check, callback<void> on_complete);
+
+    void commit(std::int64_t id, const multi_op_view& txn, callback<multi_result> on_complete);
+
+    void load_fence(std::int64_t id, callback<void> on_complete);
+
+    void get_config(std::int64_t id, callback<get_result> on_complete);
+    /// \}
+
+    /// Run a request of session \a id: \a apply makes its result unless the session may not make requests or a failure
+    /// is injected, and the result goes to \a on_complete after the events \a apply adds to the deliveries.
+    template <typename TResult, typename FApply>
+    void submit(std::int64_t id, callback<TResult> on_complete, FApply apply);
+
+    /// Why session \a id may not make a request right now (or a failure to inject), if there is a reason.
+    error_code refusal(std::int64_t id);
+
+    /// Hand \a out to the \ref delivery_queue if it has to wait, which keeps deliveries in the order they were made in.
+    /// This is called with the server lock held.
+    ///
+    /// \returns \c false if \a out is to be delivered on the calling thread (once the lock is let go).
+    bool defer(delivery_list& out);
+
+    /// Deliver everything in \a out, as \ref defer has decided.
+    void deliver(std::unique_lock<std::mutex>& ax, delivery_list& out);
+
+    /// Tell the session \a subject that it is in state \a to now.
+    void change_state(session& subject, zk::state to, delivery_list& out);
+
+    /// End session \a subject as \a final_state: its watches get a session event and its ephemerals are erased.
+    void end_session(session& subject, zk::state final_state, delivery_list& out);
+
+    std::string full_path(const session& subject, string_view path) const;
+
+    std::string client_path(std::int64_t session_id, const std::string& full) const;
+
+    /// \{
+    /// The effect of each kind of change on the tree. These do not check what the request may do and leave the watches
+    /// to \ref trigger; \a zxid is the transaction the change is part of.
+    error_code apply_check(const std::string& path, version check) const;
+
+    error_code apply_create(const session&     owner,
+                            const std::string& path,
+                            string_view        data,
+                            const acl&         rules,
+                            create_mode        mode,
+                            std::size_t        zxid,
+                            std::string&       created,
+                            undo_log*          undo,
+                            change_list&       changes
+                           );
+
+    error_code apply_set(const std::string& path,
+                         string_view        data,
+                         version            check,
+                         std::size_t        zxid,
+                         zk::stat&          result,
+                         undo_log*          undo,
+                         change_list&       changes
+                        );
+
+    error_code apply_erase(const std::string& path,
+                           version            check,
+                           std::size_t        zxid,
+                           undo_log*          undo,
+                           change_list&       changes
+                          );
+    /// \}
+
+    /// Note what \a path was before a change, unless \a undo is \c nullptr or the entry was already saved.
+    void save(const std::string& path, undo_log* undo) const;
+
+    /// Trigger the watches of every change in \a changes: the events are added to \a out and the watches forgotten.
+    void trigger(const change_list& changes, delivery_list& out);
+
+    /// Set a \a kind watch on \a path for the session \a id (nothing happens if \a on_event is empty).
+    void add_watch(watch_table& kind, const std::string& path, std::int64_t id, event_callback on_event);
+
+private:
+    std::string                     _name;
+    std::shared_ptr<delivery_queue> _queue;
+    std::thread                     _worker;
+    mutable std::mutex              _protect;
+    entry_map                       _tree;
+    std::size_t                     _last_zxid = 0U;
+    std::map<std::int64_t, session> _sessions;
+    std::int64_t                    _last_session = 0;
+    watch_table                     _data_watches;
+    watch_table                     _exist_watches;
+    watch_table                     _child_watches;
+    bool                            _reachable = true;
+    error_code                      _fail_next_with = error_code::ok;
+    std::size_t                     _fail_next_count = 0U;
+    error_code                      _lose_next_with = error_code::ok;
+    std::size_t                     _lose_next_count = 0U;
+    error_code                      _fail_randomly_with = error_code::ok;
+    double                          _fail_probability = 0.0;
+    std::mt19937_64                 _rng;
+};
+
+/// \}
+
+}
@@ -0,0 +1,150 @@
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/tests/test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include "connection_fake.hpp"
+#include "server.hpp"
+
+namespace zk::fake
+{
+
+GTEST_TEST(fake_server_tests, registry)
+{
+    CHECK_THROWS(std::invalid_argument) { server::create(""); };
+    CHECK_THROWS(std::invalid_argument) { server::create("a/b"); };
+
+    {
+        auto srv = server::create("fake-registry");
+        CHECK_TRUE(server::find("fake-registry") == srv);
+        CHECK_EQ("fakezk://fake-registry/", srv->connection_string());
+        CHECK_EQ(3U, srv->entry_count());
+    }
+    CHECK_FALSE(server::find("fake-registry"));
+
+    // The name is free again
+    auto srv = server::create("fake-registry");
+}
+
+GTEST_TEST(fake_server_tests, fail_next)
+{
+    auto   srv = server::create("fake-fail-next");
+    client c(srv->connection_string());
+
+    srv->fail_next(error_code::connection_loss, 2U);
+    CHECK_THROWS(connection_loss) { c.create("/failed", buffer()).get(); };
+    CHECK_THROWS(connection_loss) { c.exists("/").get(); };
+    CHECK_FALSE(c.exists("/failed").get());
+}
+
+GTEST_TEST(fake_server_tests, lose_next_replies)
+{
+    auto   srv = server::create("fake-lose-next-replies");
+    client c(srv->connection_string());
+
+    srv->lose_next_replies(error_code::connection_loss);
+    CHECK_THROWS(connection_loss) { c.create("/applied", buffer()).get(); };
+    CHECK_TRUE(c.exists("/applied").get());
+}
+
+GTEST_TEST(fake_server_tests, fail_randomly)
+{
+    auto   srv = server::create("fake-fail-randomly");
+    client c(srv->connection_string());
+
+    auto count_failures = [&]
+                          {
+                              int failures = 0;
+                              for (int attempt = 0; attempt < 200; ++attempt)
+                              {
+                                  if (!c.try_get("/").get())
+                                      ++failures;
+                              }
+                              return failures;
+                          };
+
+    srv->fail_randomly(error_code::operation_timeout, 0.25, 7U);
+    auto first = count_failures();
+    CHECK_LT(20, first);
+    CHECK_GT(80, first);
+
+    // The same seed fails the same requests
+    srv->fail_randomly(error_code::operation_timeout, 0.25, 7U);
+    CHECK_EQ(first, count_failures());
+
+    srv->fail_randomly(error_code::operation_timeout, 0.0);
+    CHECK_EQ(0, count_failures());
+}
+
+GTEST_TEST(fake_server_tests, latency)
+{
+    auto   srv = server::create("fake-latency");
+    client c(srv->connection_string());
+
+    srv->latency(std::chrono::milliseconds(50));
+    auto start   = std::chrono::steady_clock::now();
+    auto pending = c.create("/slow", buffer());
+
+    // The change is made right away; only the reply takes its time
+    CHECK_EQ(std::future_status::timeout, pending.wait_for(std::chrono::milliseconds(0)));
+    CHECK_EQ(4U, srv->entry_count());
+    pending.get();
+    CHECK_LE(std::chrono::milliseconds(50), std::chrono::steady_clock::now() - start);
+
+    srv->latency(server::duration_type::zero());
+    CHECK_TRUE(c.exists("/slow").get());
+}
+
+GTEST_TEST(fake_server_tests, disconnect)
+{
+    auto   srv  = server::create("fake-disconnect");
+    auto   conn = std::make_shared<connection_fake>(srv);
+    client c(conn);
+    auto   watching = c.watch_exists("/later").get();
+
+    std::atomic<int> changes(0);
+    {
+        auto subscription = c.subscribe_state([&] (state) { ++changes; });
+        srv->disconnect();
+        CHECK_EQ(state::connecting, conn->state());
+        CHECK_THROWS(connection_loss) { c.exists("/").get(); };
+
+        srv->reconnect();
+        CHECK_EQ(state::connected, conn->state());
+    }
+    CHECK_EQ(2, changes.load());
+
+    // Watches survive the trip
+    c.create("/later", buffer()).get();
+    CHECK_EQ(event_type::created, watching.next().get().type());
+}
+
+GTEST_TEST(fake_server_tests, expire_sessions)
+{
+    auto   srv  = server::create("fake-expire");
+    auto   conn = std::make_shared<connection_fake>(srv);
+    client c(conn);
+    client other(srv->connection_string());
+
+    c.create("/mine", buffer(), create_mode::ephemeral).get();
+    auto watching = c.watch("/mine").get();
+    auto others   = other.watch("/mine").get();
+
+    srv->expire_sessions();
+    CHECK_EQ(state::expired_session, conn->state());
+    CHECK_EQ(0U, srv->session_count());
+    CHECK_EQ(event_type::session, watching.next().get().type());
+    CHECK_THROWS(session_expired) { c.exists("/").get(); };
+
+    // The other session saw the ephemeral go before it expired in turn
+    auto erased = others.next().get();
+    CHECK_EQ(event_type::erased, erased.type());
+    CHECK_EQ("/mine", erased.path());
+}
+
+}
@@ -6,11 +6,16 @@ namespace zk
 {
 
 class acl;
+class acl_handle;
 class acl_rule;
 struct acl_version;
+class buffer_pool;
+class cancellation_token;
+class children_list;
 struct child_version;
 class client;
 class connection;
+class connection_observer;
 class connection_params;
 enum class create_mode : unsigned int;
 class create_result;
@@ -20,19 +25,38 @@ class exists_result;
 enum class error_code : int;
 enum class event_type : int;
 class get_acl_result;
+class get_children_list_result;
 class get_children_result;
 class get_result;
+class host_latency_table;
+enum class host_preference : int;
+class host_selector;
 class multi_result;
 class multi_op;
+class multi_op_view;
+class multi_read_result;
+class node_cache;
 class op;
+class path;
+class path_view;
 enum class op_type : int;
 enum class permission : unsigned int;
+class prepared_multi;
+struct session_credentials;
 class set_result;
+class shared_buffer;
 enum class state : int;
 struct transaction_id;
+class tree_cache;
+class update_policy;
+class update_table;
 struct version;
+class watch_children_list_result;
 class watch_children_result;
+class watch_dispatcher;
 class watch_exists_result;
 class watch_result;
+class watch_stream;
+class watch_update;
 
 }
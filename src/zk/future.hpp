@@ -18,6 +18,15 @@
 #   define ZKPP_FUTURE_USE_STD_EXPERIMENTAL 0
 #endif
 
+/** \def ZKPP_FUTURE_USE_ZK
+ *  Set this to 1 to use \c zk::basic_future and \c zk::basic_promise, which this library ships itself, as the backing
+ *  types for \c zk::future and \c zk::promise. Unlike \c std::future, these can be chained with \c then and combined
+ *  with \c when_all and \c when_any, so results can be composed without a thread waiting for each.
+**/
+#ifndef ZKPP_FUTURE_USE_ZK
+#   define ZKPP_FUTURE_USE_ZK 0
+#endif
+
 /** \def ZKPP_FUTURE_USE_CUSTOM
  *  Set this to 1 to use custom definitions of \c zk::future and \c zk::promise. If this is set, you must also set
  *  \c ZKPP_FUTURE_TEMPLATE, \c ZKPP_PROMISE_TEMPLATE, and \c ZKPP_FUTURE_INCLUDE.
@@ -41,7 +50,7 @@
  *  This is the default behavior.
 **/
 #ifndef ZKPP_FUTURE_USE_STD
-#   if ZKPP_FUTURE_USE_STD_EXPERIMENTAL || ZKPP_FUTURE_USE_CUSTOM
+#   if ZKPP_FUTURE_USE_STD_EXPERIMENTAL || ZKPP_FUTURE_USE_ZK || ZKPP_FUTURE_USE_CUSTOM
 #       define ZKPP_FUTURE_USE_STD 0
 #   else
 #       define ZKPP_FUTURE_USE_STD 1
@@ -56,6 +65,10 @@
 #   define ZKPP_FUTURE_INCLUDE   <experimental/future>
 #   define ZKPP_FUTURE_TEMPLATE  std::experimental::future
 #   define ZKPP_PROMISE_TEMPLATE std::experimental::promise
+#elif ZKPP_FUTURE_USE_ZK
+#   define ZKPP_FUTURE_INCLUDE   "basic_future.hpp"
+#   define ZKPP_FUTURE_TEMPLATE  zk::basic_future
+#   define ZKPP_PROMISE_TEMPLATE zk::basic_promise
 #elif ZKPP_FUTURE_USE_CUSTOM
 #   if !defined ZKPP_FUTURE_TEMPLATE || !defined ZKPP_PROMISE_TEMPLATE || !defined ZKPP_FUTURE_INCLUDE
 #       error "When ZKPP_FUTURE_USE_CUSTOM is set, you must also define ZKPP_FUTURE_TEMPLATE, ZKPP_PROMISE_TEMPLATE,"
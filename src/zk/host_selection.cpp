@@ -0,0 +1,396 @@
+#include "host_selection.hpp"
+#include "connection.hpp"
+#include "executor.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <ostream>
+#include <random>
+#include <set>
+#include <sstream>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// host_preference                                                                                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const host_preference& preference)
+{
+    switch (preference)
+    {
+    case host_preference::none:    return os << "none";
+    case host_preference::zone:    return os << "zone";
+    case host_preference::latency: return os << "latency";
+    default:                       return os << "host_preference(" << static_cast<int>(preference) << ')';
+    }
+}
+
+std::string to_string(const host_preference& preference)
+{
+    std::ostringstream os;
+    os << preference;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// host_latency_table                                                                                                 //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+host_latency_table::host_latency_table() = default;
+
+host_latency_table::~host_latency_table() noexcept = default;
+
+host_latency_table& host_latency_table::shared()
+{
+    static host_latency_table instance;
+    return instance;
+}
+
+void host_latency_table::record(const std::string& host, duration_type round_trip)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    auto iter = _estimates.find(host);
+    if (iter == _estimates.end())
+        _estimates.emplace(host, round_trip);
+    else
+        iter->second += (round_trip - iter->second) / 8;
+}
+
+void host_latency_table::forget(const std::string& host)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    _estimates.erase(host);
+}
+
+optional<host_latency_table::duration_type> host_latency_table::estimate(const std::string& host) const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    auto iter = _estimates.find(host);
+    if (iter == _estimates.end())
+        return nullopt;
+    else
+        return iter->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Probing                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::pair<std::string, std::string> split_host(const std::string& host)
+{
+    static const std::string default_port = "2181";
+
+    if (!host.empty() && host.front() == '[')
+    {
+        auto close = host.find(']');
+        if (close == std::string::npos)
+            return { host, default_port };
+
+        auto name = host.substr(1U, close - 1U);
+        if (close + 1U < host.size() && host[close + 1U] == ':')
+            return { std::move(name), host.substr(close + 2U) };
+        else
+            return { std::move(name), default_port };
+    }
+
+    auto colon = host.rfind(':');
+    if (colon == std::string::npos)
+        return { host, default_port };
+    else
+        return { host.substr(0U, colon), host.substr(colon + 1U) };
+}
+
+namespace
+{
+
+using probe_clock = std::chrono::steady_clock;
+
+/// The state of probing one host.
+struct probe
+{
+    int                       fd        = -1;
+    bool                      connected = false;
+    probe_clock::time_point   start;
+    std::chrono::microseconds round_trip;
+};
+
+/// Start connecting \a host; the socket is left at \c -1 if that failed right away.
+void start_probe(const std::string& host, probe& out)
+{
+    auto name = split_host(host);
+
+    ::addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    ptr<::addrinfo> found = nullptr;
+    if (::getaddrinfo(name.first.c_str(), name.second.c_str(), &hints, &found) != 0 || !found)
+        return;
+
+    out.fd    = ::socket(found->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    out.start = probe_clock::now();
+    int rc    = out.fd == -1 ? -1 : ::connect(out.fd, found->ai_addr, found->ai_addrlen);
+    int err   = errno;
+    ::freeaddrinfo(found);
+
+    if (out.fd != -1 && rc == -1 && err != EINPROGRESS)
+    {
+        ::close(out.fd);
+        out.fd = -1;
+    }
+}
+
+/// The connection of \a state is up: note the round trip and ask the server whether it is well.
+///
+/// \returns \c false if the question could not be sent.
+bool on_probe_connected(probe& state)
+{
+    state.connected  = true;
+    state.round_trip = std::chrono::duration_cast<std::chrono::microseconds>(probe_clock::now() - state.start);
+    return ::send(state.fd, "ruok", 4U, MSG_NOSIGNAL) == 4;
+}
+
+}
+
+std::vector<optional<std::chrono::microseconds>> probe_hosts(const std::vector<std::string>& hosts,
+                                                             std::chrono::milliseconds       timeout
+                                                            )
+{
+    std::vector<optional<std::chrono::microseconds>> out(hosts.size());
+    std::vector<probe>                               probes(hosts.size());
+
+    auto deadline = probe_clock::now() + timeout;
+    for (std::size_t idx = 0U; idx < hosts.size(); ++idx)
+        start_probe(hosts[idx], probes[idx]);
+
+    std::vector<::pollfd>    polls;
+    std::vector<std::size_t> polled;
+    while (true)
+    {
+        polls.clear();
+        polled.clear();
+        for (std::size_t idx = 0U; idx < probes.size(); ++idx)
+        {
+            if (probes[idx].fd == -1)
+                continue;
+
+            ::pollfd entry{};
+            entry.fd     = probes[idx].fd;
+            entry.events = probes[idx].connected ? POLLIN : POLLOUT;
+            polls.push_back(entry);
+            polled.push_back(idx);
+        }
+
+        auto now = probe_clock::now();
+        if (polls.empty() || now >= deadline)
+            break;
+
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+        int  rc   = ::poll(polls.data(), polls.size(), static_cast<int>(wait));
+        if (rc < 0 && errno != EINTR)
+            break;
+
+        for (std::size_t pos = 0U; rc > 0 && pos < polls.size(); ++pos)
+        {
+            if (polls[pos].revents == 0)
+                continue;
+
+            auto& state = probes[polled[pos]];
+            bool  done  = true;
+            if (!state.connected)
+            {
+                int       err = 0;
+                socklen_t len = sizeof err;
+                if (::getsockopt(state.fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0)
+                    done = !on_probe_connected(state);
+            }
+            else
+            {
+                // Whatever the server says (or its closing the connection on a word it does not allow) shows it is
+                // serving connections
+                char reply[4];
+                auto got = ::recv(state.fd, reply, sizeof reply, 0);
+                if (got >= 0 || errno == ECONNRESET)
+                    out[polled[pos]] = state.round_trip;
+                else if (errno == EAGAIN || errno == EINTR)
+                    done = false;
+            }
+
+            if (done)
+            {
+                ::close(state.fd);
+                state.fd = -1;
+            }
+        }
+    }
+
+    for (auto& state : probes)
+    {
+        if (state.fd != -1)
+            ::close(state.fd);
+    }
+    return out;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// host_selector                                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+host_selector::~host_selector() noexcept = default;
+
+namespace
+{
+
+/// The hosts being probed to fill in \ref host_latency_table::shared and the thread probing them. Probes run one list
+/// after the other, and a host already queued is not queued again.
+class background_prober final
+{
+public:
+    static background_prober& shared()
+    {
+        static background_prober instance;
+        return instance;
+    }
+
+    void probe(std::vector<std::string> hosts, std::chrono::milliseconds timeout)
+    {
+        {
+            std::unique_lock<std::mutex> ax(_protect);
+            hosts.erase(std::remove_if(hosts.begin(), hosts.end(),
+                                       [this] (const std::string& host) { return !_queued.insert(host).second; }
+                                      ),
+                        hosts.end()
+                       );
+        }
+        if (hosts.empty())
+            return;
+
+        _worker->execute([this, hosts = std::move(hosts), timeout]
+                         {
+                             auto probed = probe_hosts(hosts, timeout);
+                             for (std::size_t idx = 0U; idx < hosts.size(); ++idx)
+                             {
+                                 if (probed[idx])
+                                     host_latency_table::shared().record(hosts[idx], *probed[idx]);
+                             }
+
+                             std::unique_lock<std::mutex> ax(_protect);
+                             for (const auto& host : hosts)
+                                 _queued.erase(host);
+                         }
+                        );
+    }
+
+private:
+    background_prober() :
+            _worker(thread_pool_executor(1U))
+    { }
+
+private:
+    std::mutex                _protect;
+    std::set<std::string>     _queued;
+    std::shared_ptr<executor> _worker;
+};
+
+/// The selector for the \ref host_preference of a \ref connection_params.
+class preference_selector final :
+        public host_selector
+{
+public:
+    explicit preference_selector(const connection_params& params) :
+            _preference(params.prefer_hosts()),
+            _randomize(params.randomize_hosts()),
+            _zone(params.zone()),
+            _host_zones(params.host_zones()),
+            // Probing is only a head start on the session timeout, so it may not take much of it
+            _probe_timeout(std::min(params.timeout() / 4, std::chrono::milliseconds(1000)))
+    { }
+
+    virtual void order(std::vector<std::string>& hosts) override
+    {
+        // Shuffling first leaves the hosts which are equally good in a random order
+        thread_local std::mt19937 rng(std::random_device{}());
+        if (_randomize)
+            std::shuffle(hosts.begin(), hosts.end(), rng);
+
+        switch (_preference)
+        {
+        case host_preference::zone:
+            std::stable_partition(hosts.begin(), hosts.end(),
+                                  [this] (const std::string& host) { return in_zone(host); }
+                                 );
+            break;
+        case host_preference::latency:
+            order_by_latency(hosts);
+            break;
+        case host_preference::none:
+        default:
+            break;
+        }
+    }
+
+private:
+    bool in_zone(const std::string& host) const
+    {
+        if (_zone.empty())
+            return false;
+
+        auto iter = _host_zones.find(host);
+        return iter != _host_zones.end() && iter->second == _zone;
+    }
+
+    void order_by_latency(std::vector<std::string>& hosts) const
+    {
+        auto& table = host_latency_table::shared();
+
+        std::vector<std::pair<std::string, optional<std::chrono::microseconds>>> ranked;
+        std::vector<std::string>                                                 unknown;
+        for (auto& host : hosts)
+        {
+            auto estimate = table.estimate(host);
+            if (!estimate)
+                unknown.push_back(host);
+            ranked.emplace_back(std::move(host), estimate);
+        }
+
+        // Probing here would hold up the thread making the connection (which may be connecting asynchronously), so the
+        // hosts which have not been measured yet go last this time and are measured for the sessions which follow
+        if (!unknown.empty())
+            background_prober::shared().probe(std::move(unknown), _probe_timeout);
+
+        std::stable_sort(ranked.begin(), ranked.end(),
+                         [] (const auto& a, const auto& b)
+                         {
+                             return a.second && (!b.second || *a.second < *b.second);
+                         }
+                        );
+
+        for (std::size_t idx = 0U; idx < hosts.size(); ++idx)
+            hosts[idx] = std::move(ranked[idx].first);
+    }
+
+private:
+    host_preference                    _preference;
+    bool                               _randomize;
+    std::string                        _zone;
+    std::map<std::string, std::string> _host_zones;
+    std::chrono::milliseconds          _probe_timeout;
+};
+
+}
+
+std::shared_ptr<host_selector> host_selector::create(const connection_params& params)
+{
+    if (params.selector())
+        return params.selector();
+    else
+        return std::make_shared<preference_selector>(params);
+}
+
+}
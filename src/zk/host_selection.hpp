@@ -0,0 +1,114 @@
+/// \file
+/// Defines \ref zk::host_selector, which decides the order a connection tries the servers of its ensemble in.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <chrono>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "forwards.hpp"
+#include "optional.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// Which servers of the ensemble a connection would rather be on (see \ref connection_params::prefer_hosts).
+enum class host_preference : int
+{
+    /// All servers are as good as each other. They are tried in the order given, or in a random order when
+    /// \ref connection_params::randomize_hosts is set.
+    none,
+    /// The servers in the client's \ref connection_params::zone are tried before the others. This keeps the sessions
+    /// of a deployment spread over several availability zones off the links between them.
+    zone,
+    /// The servers are tried nearest first, by the round trip times in \ref host_latency_table::shared. Servers with no
+    /// measured round trip go last; they are probed in the background, so the sessions which follow find them measured.
+    latency,
+};
+
+std::ostream& operator<<(std::ostream&, const host_preference&);
+
+std::string to_string(const host_preference&);
+
+/// The smoothed round trip times to servers, keyed by their host (as in \ref connection_params::hosts). The \c "zkn"
+/// sessions keep the \ref shared table up to date with the time their handshakes and pings take, so a new session
+/// with \ref host_preference::latency usually finds the distances already measured; the servers which are not in it
+/// are probed off the thread making the session and recorded for the next one.
+class host_latency_table final
+{
+public:
+    using duration_type = std::chrono::microseconds;
+
+public:
+    host_latency_table();
+
+    host_latency_table(const host_latency_table&) = delete;
+    host_latency_table& operator=(const host_latency_table&) = delete;
+
+    ~host_latency_table() noexcept;
+
+    /// The table used by every connection in this process.
+    static host_latency_table& shared();
+
+    /// Fold the measured \a round_trip to \a host into its estimate. Like TCP's smoothed RTT, each sample moves the
+    /// estimate an eighth of the way, so a single slow reply does not make a nearby server look far away.
+    void record(const std::string& host, duration_type round_trip);
+
+    /// Drop the estimate of \a host, which could not be reached, so the next selection probes it again.
+    void forget(const std::string& host);
+
+    /// Get the estimated round trip to \a host, if there is one.
+    optional<duration_type> estimate(const std::string& host) const;
+
+private:
+    mutable std::mutex                   _protect;
+    std::map<std::string, duration_type> _estimates;
+};
+
+/// Split \a host (`"name:port"`, `"[v6 address]:port"` or just the name) into the name and port to pass to
+/// \c getaddrinfo. The port is \c "2181" if unspecified.
+std::pair<std::string, std::string> split_host(const std::string& host);
+
+/// Measure the round trip to each of \a hosts by how long its server takes to accept a TCP connection. The connections
+/// are made all at once, so probing a list costs about the time of the slowest. A server counts as healthy if it then
+/// answers \c ruok or closes the connection (which is what servers which do not whitelist \c ruok do); one which stays
+/// silent until the \a timeout, or could not be connected to, is not.
+///
+/// \returns The round trip to each host, in the order of \a hosts; \c nullopt for those which are not healthy.
+std::vector<optional<std::chrono::microseconds>> probe_hosts(const std::vector<std::string>& hosts,
+                                                             std::chrono::milliseconds       timeout
+                                                            );
+
+/// Decides the order the servers of a connection are tried in. A connection orders its hosts with it when it is made
+/// and again on \ref client::update_hosts, then goes through them in that order: it connects to the first and, when
+/// that server fails, moves on to the next. The built-in selectors implement \ref host_preference; set your own with
+/// \ref connection_params::selector.
+class host_selector
+{
+public:
+    virtual ~host_selector() noexcept;
+
+    /// Get the selector the settings of \a params call for: \ref connection_params::selector if it is set or the
+    /// built-in one for \ref connection_params::prefer_hosts.
+    static std::shared_ptr<host_selector> create(const connection_params& params);
+
+    /// Put \a hosts in the order to try them in. This is called on the thread creating the connection (or calling
+    /// \ref client::update_hosts), which may be connecting asynchronously, so it should not wait on the network.
+    /// Nothing shuffles the result afterwards (the \c "zk" connections turn the C client's shuffling off for the whole
+    /// process), so a selector which wants sessions spread over the servers has to shuffle them itself.
+    virtual void order(std::vector<std::string>& hosts) = 0;
+};
+
+/// \}
+
+}
@@ -0,0 +1,188 @@
+#include <zk/tests/test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "connection.hpp"
+#include "host_selection.hpp"
+
+namespace zk
+{
+
+/// Listens on an ephemeral loopback port and answers one \c ruok with \c imok.
+class ruok_server final
+{
+public:
+    ruok_server() :
+            _fd(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0))
+    {
+        ::sockaddr_in address{};
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(_fd, reinterpret_cast<const ::sockaddr*>(&address), sizeof address);
+        ::listen(_fd, 1);
+
+        socklen_t size = sizeof address;
+        ::getsockname(_fd, reinterpret_cast<::sockaddr*>(&address), &size);
+        _port = ntohs(address.sin_port);
+
+        _worker = std::thread([this]
+                              {
+                                  int  conn = ::accept(_fd, nullptr, nullptr);
+                                  char word[4];
+                                  ::recv(conn, word, sizeof word, MSG_WAITALL);
+                                  ::send(conn, "imok", 4U, MSG_NOSIGNAL);
+                                  ::close(conn);
+                              }
+                             );
+    }
+
+    ~ruok_server() noexcept
+    {
+        _worker.join();
+        ::close(_fd);
+    }
+
+    std::string host() const { return "127.0.0.1:" + std::to_string(_port); }
+
+private:
+    int           _fd;
+    std::uint16_t _port = 0U;
+    std::thread   _worker;
+};
+
+/// Get a loopback address which nothing listens on.
+static std::string closed_host()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ::sockaddr_in address{};
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(fd, reinterpret_cast<const ::sockaddr*>(&address), sizeof address);
+
+    socklen_t size = sizeof address;
+    ::getsockname(fd, reinterpret_cast<::sockaddr*>(&address), &size);
+    ::close(fd);
+    return "127.0.0.1:" + std::to_string(ntohs(address.sin_port));
+}
+
+GTEST_TEST(host_selection_tests, split_host)
+{
+    CHECK_TRUE(std::make_pair(std::string("server-a"), std::string("2181")) == split_host("server-a"));
+    CHECK_TRUE(std::make_pair(std::string("server-a"), std::string("2182")) == split_host("server-a:2182"));
+    CHECK_TRUE(std::make_pair(std::string("::1"), std::string("2181")) == split_host("[::1]"));
+    CHECK_TRUE(std::make_pair(std::string("fd2d::73b"), std::string("3000")) == split_host("[fd2d::73b]:3000"));
+}
+
+GTEST_TEST(host_selection_tests, latency_table)
+{
+    host_latency_table table;
+    CHECK_FALSE(table.estimate("a:2181"));
+
+    table.record("a:2181", std::chrono::microseconds(800));
+    CHECK_EQ(800, table.estimate("a:2181")->count());
+
+    // One slow sample only moves the estimate an eighth of the way
+    table.record("a:2181", std::chrono::microseconds(8800));
+    CHECK_EQ(1800, table.estimate("a:2181")->count());
+
+    table.forget("a:2181");
+    CHECK_FALSE(table.estimate("a:2181"));
+}
+
+GTEST_TEST(host_selection_tests, no_preference)
+{
+    connection_params params;
+    params.randomize_hosts() = false;
+    std::vector<std::string> hosts = { "c", "a", "b" };
+    host_selector::create(params)->order(hosts);
+    CHECK_TRUE((std::vector<std::string>{ "c", "a", "b" }) == hosts);
+
+    params.randomize_hosts() = true;
+    host_selector::create(params)->order(hosts);
+    std::sort(hosts.begin(), hosts.end());
+    CHECK_TRUE((std::vector<std::string>{ "a", "b", "c" }) == hosts);
+}
+
+GTEST_TEST(host_selection_tests, no_preference_spreads_sessions)
+{
+    // The C client does not shuffle the hosts of any connection in the process, so this is what spreads them
+    connection_params params;
+    params.hosts() = { "a", "b", "c", "d", "e" };
+
+    std::set<std::vector<std::string>> seen;
+    for (int attempt = 0; attempt < 50; ++attempt)
+    {
+        auto hosts = params.hosts();
+        host_selector::create(params)->order(hosts);
+        seen.insert(std::move(hosts));
+    }
+    CHECK_LT(1U, seen.size());
+}
+
+GTEST_TEST(host_selection_tests, zone_first)
+{
+    auto params = connection_params::parse("zk://w1,e1,w2,e2,x/?randomize_hosts=false&prefer_hosts=zone&zone=east"
+                                           "&host_zones=west,east,west,east,"
+                                          );
+    auto hosts = params.hosts();
+    host_selector::create(params)->order(hosts);
+    CHECK_TRUE((std::vector<std::string>{ "e1", "e2", "w1", "w2", "x" }) == hosts);
+
+    // Randomizing only shuffles hosts which are as good as each other
+    params.randomize_hosts() = true;
+    for (int attempt = 0; attempt < 10; ++attempt)
+    {
+        host_selector::create(params)->order(hosts);
+        CHECK_EQ("east", params.host_zones().at(hosts[0]));
+        CHECK_EQ("east", params.host_zones().at(hosts[1]));
+    }
+}
+
+GTEST_TEST(host_selection_tests, probe)
+{
+    auto closed = closed_host();
+    ruok_server live;
+
+    auto probed = probe_hosts({ closed, live.host() }, std::chrono::seconds(5));
+    CHECK_EQ(2U, probed.size());
+    CHECK_FALSE(probed[0]);
+    CHECK_TRUE(probed[1]);
+}
+
+GTEST_TEST(host_selection_tests, latency_order)
+{
+    auto closed = closed_host();
+    ruok_server live;
+
+    connection_params params;
+    params.randomize_hosts() = false;
+    params.prefer_hosts()    = host_preference::latency;
+    params.hosts()           = { closed, live.host() };
+
+    // Nothing is measured yet and ordering does not wait for the probes, so the order is the one given
+    auto selector = host_selector::create(params);
+    auto hosts    = params.hosts();
+    selector->order(hosts);
+    CHECK_TRUE((std::vector<std::string>{ closed, live.host() }) == hosts);
+
+    // What is measured in the background is kept for the next session; the host which did not answer is probed again
+    for (int attempt = 0; attempt < 500 && !host_latency_table::shared().estimate(live.host()); ++attempt)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK_TRUE(host_latency_table::shared().estimate(live.host()));
+    CHECK_FALSE(host_latency_table::shared().estimate(closed));
+
+    hosts = params.hosts();
+    selector->order(hosts);
+    CHECK_TRUE((std::vector<std::string>{ live.host(), closed }) == hosts);
+    host_latency_table::shared().forget(live.host());
+}
+
+}
@@ -0,0 +1,253 @@
+#include "jute.hpp"
+
+#include <stdexcept>
+
+namespace zk
+{
+
+error_code error_code_from_wire(std::int32_t raw)
+{
+    switch (raw)
+    {
+    case -7:   // ZOPERATIONTIMEOUT
+    case -118: // ZSESSIONMOVED
+        return error_code::connection_loss;
+    case -113: // ZINVALIDCALLBACK
+    case -114: // ZINVALIDACL
+        return error_code::invalid_arguments;
+    default:
+        return static_cast<error_code>(raw);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// jute_writer                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void jute_writer::write_acl(const acl& rules)
+{
+    write_int(std::int32_t(rules.size()));
+    for (const auto& rule : rules)
+    {
+        write_int(static_cast<std::int32_t>(rule.permissions()));
+        write_string(rule.scheme());
+        write_string(rule.id());
+    }
+}
+
+void jute_writer::write_stat(const stat& value)
+{
+    auto time_to_wire = [] (stat::time_point time)
+                        {
+                            using std::chrono::milliseconds;
+                            return std::chrono::duration_cast<milliseconds>(time.time_since_epoch()).count();
+                        };
+
+    write_long(static_cast<std::int64_t>(value.create_transaction.value));
+    write_long(static_cast<std::int64_t>(value.modified_transaction.value));
+    write_long(time_to_wire(value.create_time));
+    write_long(time_to_wire(value.modified_time));
+    write_int(value.data_version.value);
+    write_int(value.child_version.value);
+    write_int(value.acl_version.value);
+    write_long(static_cast<std::int64_t>(value.ephemeral_owner));
+    write_int(static_cast<std::int32_t>(value.data_size));
+    write_int(static_cast<std::int32_t>(value.children_count));
+    write_long(static_cast<std::int64_t>(value.child_modified_transaction.value));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// jute_gather_writer                                                                                                 //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+jute_gather_writer::jute_gather_writer(std::size_t inline_limit) :
+        _inline_limit(inline_limit),
+        _size(0U)
+{
+    _owned.reserve(64U);
+    _pieces.reserve(8U);
+    clear();
+}
+
+void jute_gather_writer::write_acl(const acl& rules)
+{
+    write_int(std::int32_t(rules.size()));
+    for (const auto& rule : rules)
+    {
+        write_int(static_cast<std::int32_t>(rule.permissions()));
+        write_string(rule.scheme());
+        write_string(rule.id());
+    }
+}
+
+void jute_gather_writer::write_owned(const char* data, std::size_t size)
+{
+    if (size == 0U)
+        return;
+
+    // Bytes of the writer only ever go at the end of its storage, so a run of them since the last referenced piece
+    // stays one piece
+    if (_pieces.back().data == nullptr)
+        _pieces.back().size += size;
+    else
+        _pieces.push_back(piece{ nullptr, _owned.size(), size });
+
+    _owned.insert(_owned.end(), data, data + size);
+    _size += size;
+}
+
+void jute_gather_writer::patch_int(std::size_t offset, std::int32_t value)
+{
+    auto pos = jute_length_size + offset;
+    for (const auto& part : _pieces)
+    {
+        if (pos < part.size)
+        {
+            if (part.data != nullptr)
+                throw std::invalid_argument("The bytes to patch in a jute_gather_writer are not its own");
+
+            // write_int puts all 4 bytes in the same piece
+            auto raw = std::uint32_t(value);
+            for (std::size_t idx = 0U; idx < 4U; ++idx)
+                _owned[part.offset + pos + idx] = char((raw >> (8U * (3U - idx))) & 0xffU);
+            return;
+        }
+        pos -= part.size;
+    }
+    throw std::out_of_range("Offset to patch is past the end of the message");
+}
+
+const std::vector<::iovec>& jute_gather_writer::finish()
+{
+    auto length = std::uint32_t(size());
+    for (std::size_t idx = 0U; idx < 4U; ++idx)
+        _owned[idx] = char((length >> (8U * (3U - idx))) & 0xffU);
+
+    // Only now is the storage of the writer done moving around
+    _iovecs.clear();
+    _iovecs.reserve(_pieces.size());
+    for (const auto& part : _pieces)
+    {
+        auto base = part.data == nullptr ? _owned.data() + part.offset : part.data;
+        _iovecs.push_back(::iovec{ const_cast<ptr<char>>(base), part.size });
+    }
+    return _iovecs;
+}
+
+void jute_gather_writer::copy_to(std::vector<char>& out) const
+{
+    out.reserve(out.size() + _size);
+    for (const auto& part : _pieces)
+    {
+        auto base = part.data == nullptr ? _owned.data() + part.offset : part.data;
+        out.insert(out.end(), base, base + part.size);
+    }
+}
+
+void jute_gather_writer::clear()
+{
+    _owned.assign(jute_length_size, '\0');
+    _pieces.clear();
+    _pieces.push_back(piece{ nullptr, 0U, jute_length_size });
+    _iovecs.clear();
+    _size = jute_length_size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// jute_reader                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/// Times are milliseconds since the epoch. One so far off that the clock can not hold it is a corrupt message, not a
+/// time to overflow over.
+stat::time_point time_from_wire(std::int64_t raw)
+{
+    static const auto limit = std::chrono::duration_cast<std::chrono::milliseconds>(stat::time_point::duration::max());
+    if (raw > limit.count() || raw < -limit.count())
+        throw_error(error_code::marshalling_error);
+    return stat::time_point() + std::chrono::milliseconds(raw);
+}
+
+}
+
+stat jute_reader::read_stat()
+{
+    stat out;
+    out.create_transaction         = transaction_id(static_cast<std::size_t>(read_long()));
+    out.modified_transaction       = transaction_id(static_cast<std::size_t>(read_long()));
+    out.create_time                = time_from_wire(read_long());
+    out.modified_time              = time_from_wire(read_long());
+    out.data_version               = version(read_int());
+    out.child_version              = child_version(read_int());
+    out.acl_version                = acl_version(read_int());
+    out.ephemeral_owner            = static_cast<std::uint64_t>(read_long());
+    out.data_size                  = static_cast<std::size_t>(read_int());
+    out.children_count             = static_cast<std::size_t>(read_int());
+    out.child_modified_transaction = transaction_id(static_cast<std::size_t>(read_long()));
+    return out;
+}
+
+acl jute_reader::read_acl()
+{
+    auto count = read_count();
+    acl out;
+    out.reserve(count);
+    for (std::size_t idx = 0U; idx < count; ++idx)
+    {
+        auto perms  = static_cast<permission>(read_int());
+        auto scheme = read_string();
+        auto id     = read_string();
+        out.emplace_back(std::string(scheme), std::string(id), perms);
+    }
+    return out;
+}
+
+std::vector<std::string> jute_reader::read_string_vector()
+{
+    auto count = read_count();
+    std::vector<std::string> out;
+    out.reserve(count);
+    for (std::size_t idx = 0U; idx < count; ++idx)
+        out.emplace_back(read_string());
+    return out;
+}
+
+children_list jute_reader::read_children_list()
+{
+    auto first = *this;
+    auto count = read_count();
+
+    std::size_t total_length = 0U;
+    for (std::size_t idx = 0U; idx < count; ++idx)
+        total_length += read_string().size();
+
+    *this = first;
+    read_count();
+    children_list out;
+    out.reserve(count, total_length);
+    for (std::size_t idx = 0U; idx < count; ++idx)
+        out.push_back(read_string());
+    return out;
+}
+
+bool next_jute_message(const char*& first, const char* last, jute_reader& body)
+{
+    jute_reader framing(first, last);
+    if (framing.remaining() < jute_length_size)
+        return false;
+
+    auto length = framing.read_int();
+    if (length < 0 || std::size_t(length) > jute_max_message_size)
+        throw_error(error_code::marshalling_error);
+    if (framing.remaining() < std::size_t(length))
+        return false;
+
+    auto start = first + jute_length_size;
+    body  = jute_reader(start, start + length);
+    first = start + length;
+    return true;
+}
+
+}
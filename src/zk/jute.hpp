@@ -0,0 +1,449 @@
+/// \file
+/// The jute encoding the ZooKeeper protocol is written in: big-endian integers, length-prefixed strings and buffers,
+/// and count-prefixed vectors. \ref zk::connection_zkn speaks the protocol with these, and they are public so that
+/// anything else which reads or writes the format (a proxy, a tool reading snapshots or transaction logs) can share
+/// them.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "acl.hpp"
+#include "buffer.hpp"
+#include "children_list.hpp"
+#include "error.hpp"
+#include "string_view.hpp"
+#include "types.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Protocol Constants                                                                                                 //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The operation codes of the requests in the ZooKeeper protocol.
+enum class jute_op : std::int32_t
+{
+    notification     =   0,
+    create           =   1,
+    erase            =   2,
+    exists           =   3,
+    get_data         =   4,
+    set_data         =   5,
+    get_acl          =   6,
+    set_acl          =   7,
+    get_children     =   8,
+    sync             =   9,
+    ping             =  11,
+    get_children2    =  12,
+    check            =  13,
+    multi            =  14,
+    create2          =  15,
+    reconfig         =  16,
+    create_container =  19,
+    multi_read       =  22,
+    set_watches      = 101,
+    close_session    = -11,
+    error            =  -1,
+};
+
+/// The transaction IDs the server uses for messages which do not answer a request of the client.
+namespace jute_xid
+{
+
+constexpr std::int32_t notification = -1;
+constexpr std::int32_t ping         = -2;
+constexpr std::int32_t set_watches  = -8;
+
+}
+
+/// Every message in either direction is prefixed by its length, which is a 4 byte integer.
+constexpr std::size_t jute_length_size = 4U;
+
+/// Messages longer than this are taken as a sign of a broken stream rather than allocated for.
+constexpr std::size_t jute_max_message_size = 64U * 1024U * 1024U;
+
+/// The length of the password the server hands out with a session.
+constexpr std::size_t jute_password_size = 16U;
+
+/// Convert the error code of a reply into an \ref error_code, folding the codes this library does not distinguish in
+/// the same way as the conversion of the C client codes does.
+error_code error_code_from_wire(std::int32_t raw);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// jute_writer                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Builds one length-prefixed message into storage of its own. The length is filled in by \ref finish, so the parts of
+/// the message can be written without knowing their sizes ahead of time.
+///
+/// \see jute_gather_writer for writing a message out of storage which the caller already has
+class jute_writer final
+{
+public:
+    explicit jute_writer(std::size_t size_hint = 64U)
+    {
+        _bytes.reserve(jute_length_size + size_hint);
+        _bytes.resize(jute_length_size);
+    }
+
+    void write_int(std::int32_t value)
+    {
+        write_big_endian(std::uint32_t(value), 4U);
+    }
+
+    void write_long(std::int64_t value)
+    {
+        write_big_endian(std::uint64_t(value), 8U);
+    }
+
+    void write_bool(bool value)
+    {
+        _bytes.push_back(value ? char(1) : char(0));
+    }
+
+    void write_buffer(const char* data, std::size_t size)
+    {
+        write_int(std::int32_t(size));
+        _bytes.insert(_bytes.end(), data, data + size);
+    }
+
+    void write_buffer(const buffer& data)
+    {
+        write_buffer(data.data(), data.size());
+    }
+
+    void write_string(string_view value)
+    {
+        write_buffer(value.data(), value.size());
+    }
+
+    /// Write \a prefix and \a suffix as a single string, which is how paths under a chroot are sent.
+    void write_string(string_view prefix, string_view suffix)
+    {
+        write_int(std::int32_t(prefix.size() + suffix.size()));
+        _bytes.insert(_bytes.end(), prefix.begin(), prefix.end());
+        _bytes.insert(_bytes.end(), suffix.begin(), suffix.end());
+    }
+
+    void write_acl(const acl& rules);
+
+    /// Copy the encoding \a rules already has.
+    void write_acl(const acl_handle& rules)
+    {
+        auto wire = rules.wire();
+        _bytes.insert(_bytes.end(), wire.begin(), wire.end());
+    }
+
+    /// Write a \ref stat in the layout \ref jute_reader::read_stat reads.
+    void write_stat(const stat& value);
+
+    /// Overwrite the 4 bytes at \a offset (counted from the start of the message, after its length) with \a value.
+    void patch_int(std::size_t offset, std::int32_t value)
+    {
+        auto pos = jute_length_size + offset;
+        auto raw = std::uint32_t(value);
+        for (std::size_t idx = 0U; idx < 4U; ++idx)
+            _bytes[pos + idx] = char((raw >> (8U * (3U - idx))) & 0xffU);
+    }
+
+    /// The size of the message written so far, not counting its length prefix.
+    std::size_t size() const
+    {
+        return _bytes.size() - jute_length_size;
+    }
+
+    /// Fill in the length prefix and take the finished message.
+    std::vector<char> finish() &&
+    {
+        auto length = std::uint32_t(size());
+        for (std::size_t idx = 0U; idx < 4U; ++idx)
+            _bytes[idx] = char((length >> (8U * (3U - idx))) & 0xffU);
+        return std::move(_bytes);
+    }
+
+private:
+    template <typename TUnsigned>
+    void write_big_endian(TUnsigned value, std::size_t width)
+    {
+        for (std::size_t idx = 0U; idx < width; ++idx)
+            _bytes.push_back(char((value >> (8U * (width - 1U - idx))) & 0xffU));
+    }
+
+private:
+    std::vector<char> _bytes;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// jute_gather_writer                                                                                                 //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Builds one length-prefixed message as a list of pieces for \c writev or \c sendmsg, without copying the strings and
+/// buffers it is given. The integers and length prefixes are written into storage of the writer; the contents of a
+/// \ref buffer, a path or the entries of an \ref acl are referred to where they are, so they must stay unchanged until
+/// the message has been sent.
+///
+/// Pieces no longer than the inline limit are copied anyway: below a few dozen bytes the copy costs less than the piece
+/// it would take in the kernel's walk of the vector.
+///
+/// \code
+/// jute_gather_writer frame;
+/// frame.write_int(xid);
+/// frame.write_int(static_cast<std::int32_t>(jute_op::set_data));
+/// frame.write_string(path);
+/// frame.write_buffer(data); // data is not copied
+/// frame.write_int(-1);
+/// const auto& pieces = frame.finish();
+/// ::writev(fd, pieces.data(), int(pieces.size()));
+/// \endcode
+class jute_gather_writer final
+{
+public:
+    /// Pieces of this size or smaller are copied unless the writer is told otherwise.
+    static constexpr std::size_t default_inline_limit = 32U;
+
+public:
+    /// \param inline_limit Strings and buffers of up to this many bytes are copied into the writer rather than
+    ///  referred to. Use \c 0 to refer to everything.
+    explicit jute_gather_writer(std::size_t inline_limit = default_inline_limit);
+
+    void write_int(std::int32_t value)
+    {
+        write_big_endian(std::uint32_t(value), 4U);
+    }
+
+    void write_long(std::int64_t value)
+    {
+        write_big_endian(std::uint64_t(value), 8U);
+    }
+
+    void write_bool(bool value)
+    {
+        char raw = value ? char(1) : char(0);
+        write_owned(&raw, 1U);
+    }
+
+    /// Write the length of \a data and refer to the \a size bytes at \a data.
+    void write_buffer(const char* data, std::size_t size)
+    {
+        write_int(std::int32_t(size));
+        write_referenced(data, size);
+    }
+
+    void write_buffer(const buffer& data)
+    {
+        write_buffer(data.data(), data.size());
+    }
+
+    void write_string(string_view value)
+    {
+        write_buffer(value.data(), value.size());
+    }
+
+    /// Write \a prefix and \a suffix as a single string, which is how paths under a chroot are sent.
+    void write_string(string_view prefix, string_view suffix)
+    {
+        write_int(std::int32_t(prefix.size() + suffix.size()));
+        write_referenced(prefix.data(), prefix.size());
+        write_referenced(suffix.data(), suffix.size());
+    }
+
+    /// Write \a rules, referring to the scheme and ID of each rule in place.
+    void write_acl(const acl& rules);
+
+    /// Refer to the encoding \a rules already has, which lives as long as any copy of the handle does.
+    void write_acl(const acl_handle& rules)
+    {
+        auto wire = rules.wire();
+        write_referenced(wire.data(), wire.size());
+    }
+
+    /// Overwrite the 4 bytes at \a offset (counted from the start of the message, after its length) with \a value.
+    /// They must have been written with \ref write_int.
+    ///
+    /// \throws std::invalid_argument if \a offset is in a piece the writer refers to.
+    /// \throws std::out_of_range if \a offset is past the end of the message.
+    void patch_int(std::size_t offset, std::int32_t value);
+
+    /// The size of the message written so far, not counting its length prefix.
+    std::size_t size() const
+    {
+        return _size - jute_length_size;
+    }
+
+    /// Fill in the length prefix and get the pieces of the message, in order. They stay valid until the writer is
+    /// changed or destroyed (and as long as the storage the writer refers to does).
+    const std::vector<::iovec>& finish();
+
+    /// Append a copy of the finished message to \a out, for when it has to outlive what it refers to.
+    void copy_to(std::vector<char>& out) const;
+
+    /// Forget the message and start a new one, keeping the storage of the old one.
+    void clear();
+
+private:
+    /// A part of the message: \c size bytes at \c data, or at \c offset into \c _owned when \c data is \c nullptr.
+    struct piece
+    {
+        const char* data;
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    void write_owned(const char* data, std::size_t size);
+
+    void write_referenced(const char* data, std::size_t size)
+    {
+        if (size <= _inline_limit)
+            write_owned(data, size);
+        else
+        {
+            _pieces.push_back(piece{ data, 0U, size });
+            _size += size;
+        }
+    }
+
+    template <typename TUnsigned>
+    void write_big_endian(TUnsigned value, std::size_t width)
+    {
+        char raw[8];
+        for (std::size_t idx = 0U; idx < width; ++idx)
+            raw[idx] = char((value >> (8U * (width - 1U - idx))) & 0xffU);
+        write_owned(raw, width);
+    }
+
+private:
+    std::size_t          _inline_limit;
+    std::size_t          _size;
+    std::vector<char>    _owned;
+    std::vector<piece>   _pieces;
+    std::vector<::iovec> _iovecs;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// jute_reader                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Reads the fields of a message in place. The views it hands out point into the message, so they only live as long as
+/// the receive buffer it was read into.
+///
+/// \throws marshalling_error from any of the \c read_ functions if the message ends before the field does.
+class jute_reader final
+{
+public:
+    jute_reader() noexcept :
+            _iter(nullptr),
+            _end(nullptr)
+    { }
+
+    explicit jute_reader(const char* first, const char* last) noexcept :
+            _iter(first),
+            _end(last)
+    { }
+
+    std::size_t remaining() const noexcept
+    {
+        return std::size_t(_end - _iter);
+    }
+
+    std::int32_t read_int()
+    {
+        return std::int32_t(read_big_endian<std::uint32_t>(4U));
+    }
+
+    std::int64_t read_long()
+    {
+        return std::int64_t(read_big_endian<std::uint64_t>(8U));
+    }
+
+    bool read_bool()
+    {
+        need(1U);
+        return *_iter++ != 0;
+    }
+
+    /// Read a string or buffer. A null value (which has a length of \c -1) is read as empty.
+    string_view read_buffer()
+    {
+        auto length = read_int();
+        if (length <= 0)
+            return string_view();
+
+        need(std::size_t(length));
+        auto out = string_view(_iter, std::size_t(length));
+        _iter += length;
+        return out;
+    }
+
+    string_view read_string()
+    {
+        return read_buffer();
+    }
+
+    /// Read a vector count, where a null vector counts as empty.
+    std::size_t read_count()
+    {
+        auto count = read_int();
+        if (count <= 0)
+            return 0U;
+
+        // Every element takes at least 1 byte, which keeps a corrupt count from reserving the world
+        need(std::size_t(count));
+        return std::size_t(count);
+    }
+
+    /// Read a \ref stat. A time too far from the epoch for the clock to hold counts as a corrupt message.
+    stat read_stat();
+
+    acl read_acl();
+
+    std::vector<std::string> read_string_vector();
+
+    /// Like \ref read_string_vector, but into the packed storage of a \ref children_list. The names are walked twice:
+    /// once to size the storage and once to fill it.
+    children_list read_children_list();
+
+private:
+    void need(std::size_t count) const
+    {
+        if (remaining() < count)
+            throw_error(error_code::marshalling_error);
+    }
+
+    template <typename TUnsigned>
+    TUnsigned read_big_endian(std::size_t width)
+    {
+        need(width);
+        TUnsigned out = 0U;
+        for (std::size_t idx = 0U; idx < width; ++idx)
+            out = TUnsigned((out << 8U) | TUnsigned(static_cast<unsigned char>(*_iter++)));
+        return out;
+    }
+
+private:
+    const char* _iter;
+    const char* _end;
+};
+
+/// Find the first whole message in the received bytes from \a first to \a last. If there is one, \a body is set to read
+/// it in place and \a first is moved past it; if the message is still arriving, nothing is changed.
+///
+/// \returns \c true if a message was found.
+/// \throws marshalling_error if the length of the message is negative or more than \ref jute_max_message_size, which
+///  means the stream is broken.
+bool next_jute_message(const char*& first, const char* last, jute_reader& body);
+
+/// \}
+
+}
@@ -0,0 +1,156 @@
+#include <zk/client.hpp>
+#include <zk/connection.hpp>
+#include <zk/server/classpath.hpp>
+#include <zk/server/configuration.hpp>
+#include <zk/server/monitor.hpp>
+#include <zk/server/server_group.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <ftw.h>
+
+#include "options.hpp"
+#include "report.hpp"
+#include "workload.hpp"
+
+namespace zk::loadgen
+{
+
+static void delete_directory(const std::string& path)
+{
+    auto unlink_cb = [] (ptr<const char> fpath, ptr<const struct ::stat>, int, ptr<struct FTW>) -> int
+                     {
+                         return std::remove(fpath);
+                     };
+
+    if (nftw(path.c_str(), unlink_cb, 64, FTW_DEPTH | FTW_PHYS) && errno != ENOENT)
+        throw std::system_error(errno, std::system_category());
+}
+
+/// Connect \a count sessions at once.
+static std::vector<client> connect_sessions(const std::string& conn_string, std::size_t count)
+{
+    std::vector<future<client>> pending;
+    pending.reserve(count);
+    for (std::size_t idx = 0U; idx < count; ++idx)
+        pending.emplace_back(client::connect(conn_string));
+
+    std::vector<client> out;
+    out.reserve(count);
+    for (auto& fut : pending)
+        out.emplace_back(fut.get());
+    return out;
+}
+
+static int run(const options& settings)
+{
+    server::server_group ensemble;
+    std::string          conn_string = settings.connection_string;
+    if (conn_string.empty())
+    {
+        delete_directory(settings.data_directory);
+        auto base = server::configuration::make_minimal(settings.data_directory);
+        if (settings.server_stats)
+            base.four_letter_word_whitelist(server::configuration::all_four_letter_word_whitelist);
+        ensemble = server::server_group::make_ensemble(settings.ensemble_size, base);
+        ensemble.start_all_servers(settings.classpath.empty() ? server::classpath::system_default()
+                                                              : server::classpath(settings.classpath)
+                                  );
+        conn_string = ensemble.get_connection_string();
+        std::cerr << "Started an ensemble of " << settings.ensemble_size << " at " << conn_string << std::endl;
+    }
+
+    auto sessions = connect_sessions(conn_string, settings.sessions);
+
+    workload load(settings);
+    std::cerr << "Building a tree of " << load.leaves().size() << " leaves under " << settings.root << std::endl;
+    load.build(sessions.front());
+
+    // Only the numbers every server reports cheaply; listing the connections and watches would add to the load
+    server::monitor_options monitoring;
+    monitoring.scrape_watches()     = false;
+    monitoring.scrape_connections() = false;
+    server::monitor servers(settings.server_stats ? server::endpoint::all_of(connection_params::parse(conn_string))
+                                                  : std::vector<server::endpoint>(),
+                            monitoring
+                           );
+    servers.sample();
+
+    std::vector<recorder>    recorders(settings.threads);
+    std::vector<std::thread> threads;
+    threads.reserve(settings.threads);
+
+    auto start    = std::chrono::steady_clock::now();
+    auto deadline = start + settings.duration;
+    for (std::size_t idx = 0U; idx < settings.threads; ++idx)
+    {
+        threads.emplace_back([&, idx]
+                             {
+                                 load.run(sessions[idx % sessions.size()], idx, deadline, recorders[idx]);
+                             }
+                            );
+    }
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    servers.sample();
+
+    load.tear_down(sessions.front());
+
+    recorder combined;
+    for (auto& rec : recorders)
+        combined.merge(std::move(rec));
+
+    auto result = report::from(settings, std::move(combined), elapsed);
+    for (auto& delta : servers.deltas())
+        if (delta)
+            result.servers.emplace_back(std::move(*delta));
+    if (settings.format == output_format::csv)
+        write_csv(std::cout, result);
+    else
+        write_json(std::cout, result);
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        if (std::string(argv[idx]) == "--help" || std::string(argv[idx]) == "-h")
+        {
+            std::cout << zk::loadgen::usage(argv[0]);
+            return 0;
+        }
+    }
+
+    zk::loadgen::options settings;
+    try
+    {
+        settings = zk::loadgen::parse_options(argc, argv);
+    }
+    catch (const std::invalid_argument& ex)
+    {
+        std::cerr << ex.what() << "\n\n" << zk::loadgen::usage(argv[0]);
+        return 2;
+    }
+
+    try
+    {
+        return zk::loadgen::run(settings);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Load generation failed: " << ex.what() << std::endl;
+        return 1;
+    }
+}
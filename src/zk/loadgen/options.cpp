@@ -0,0 +1,192 @@
+#include "options.hpp"
+
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace zk::loadgen
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// operation                                                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const operation& self)
+{
+    switch (self)
+    {
+    case operation::get:    return os << "get";
+    case operation::set:    return os << "set";
+    case operation::create: return os << "create";
+    case operation::multi:  return os << "multi";
+    case operation::watch:  return os << "watch";
+    default:                return os << "operation(" << static_cast<int>(self) << ')';
+    }
+}
+
+std::string to_string(const operation& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// options                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static std::size_t parse_count(const std::string& name, const std::string& value, std::size_t minimum)
+{
+    std::size_t        used = 0U;
+    unsigned long long out  = 0U;
+    try
+    {
+        out = std::stoull(value, &used);
+    }
+    catch (const std::exception&)
+    {
+        used = 0U;
+    }
+
+    if (used == 0U || used != value.size() || value[0] == '-')
+        throw std::invalid_argument("--" + name + " must be a number (got \"" + value + "\")");
+    if (out < minimum)
+        throw std::invalid_argument("--" + name + " must be at least " + std::to_string(minimum));
+    return std::size_t(out);
+}
+
+static std::vector<std::string> split(const std::string& src, char delim)
+{
+    std::vector<std::string> out;
+    std::string::size_type start = 0U;
+    while (true)
+    {
+        auto end = src.find(delim, start);
+        out.emplace_back(src.substr(start, end - start));
+        if (end == std::string::npos)
+            return out;
+        start = end + 1U;
+    }
+}
+
+static void parse_mix(const std::string& value, options& out)
+{
+    out.mix.fill(0U);
+    for (const auto& part : split(value, ','))
+    {
+        auto colon = part.find(':');
+        if (colon == std::string::npos)
+            throw std::invalid_argument("--mix entries look like \"get:70\" (got \"" + part + "\")");
+
+        auto name   = part.substr(0, colon);
+        auto weight = parse_count("mix", part.substr(colon + 1U), 0U);
+        bool found  = false;
+        for (std::size_t idx = 0U; idx < operation_count; ++idx)
+        {
+            if (to_string(static_cast<operation>(idx)) == name)
+            {
+                out.mix[idx] = unsigned(weight);
+                found        = true;
+            }
+        }
+        if (!found)
+            throw std::invalid_argument("Unknown operation in --mix: \"" + name + "\"");
+    }
+
+    unsigned total = 0U;
+    for (auto weight : out.mix)
+        total += weight;
+    if (total == 0U)
+        throw std::invalid_argument("--mix must give at least one operation a weight");
+}
+
+options parse_options(int argc, char** argv)
+{
+    options out;
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        std::string arg = argv[idx];
+        auto        eq  = arg.find('=');
+        if (arg.compare(0, 2U, "--") != 0 || eq == std::string::npos)
+            throw std::invalid_argument("Options look like --name=value (got \"" + arg + "\")");
+
+        auto name  = arg.substr(2U, eq - 2U);
+        auto value = arg.substr(eq + 1U);
+        if (name == "connect")
+            out.connection_string = value;
+        else if (name == "ensemble")
+        {
+            out.ensemble_size = parse_count(name, value, 1U);
+            out.connection_string.clear();
+        }
+        else if (name == "classpath")
+            out.classpath = split(value, ':');
+        else if (name == "data-dir")
+            out.data_directory = value;
+        else if (name == "threads")
+            out.threads = parse_count(name, value, 1U);
+        else if (name == "sessions")
+            out.sessions = parse_count(name, value, 1U);
+        else if (name == "duration")
+            out.duration = std::chrono::seconds(parse_count(name, value, 1U));
+        else if (name == "mix")
+            parse_mix(value, out);
+        else if (name == "payload")
+            out.payload_size = parse_count(name, value, 0U);
+        else if (name == "fanout")
+            out.tree_fanout = parse_count(name, value, 1U);
+        else if (name == "depth")
+            out.tree_depth = parse_count(name, value, 1U);
+        else if (name == "multi-size")
+            out.multi_size = parse_count(name, value, 1U);
+        else if (name == "root")
+            out.root = value;
+        else if (name == "format")
+        {
+            if (value == "json")
+                out.format = output_format::json;
+            else if (value == "csv")
+                out.format = output_format::csv;
+            else
+                throw std::invalid_argument("--format must be json or csv (got \"" + value + "\")");
+        }
+        else if (name == "server-stats")
+            out.server_stats = parse_count(name, value, 0U) != 0U;
+        else
+            throw std::invalid_argument("Unknown option --" + name);
+    }
+
+    if (out.sessions > out.threads)
+        throw std::invalid_argument("--sessions can not be more than --threads; the extra sessions would be idle");
+    if (out.root.empty() || out.root[0] != '/' || out.root == "/")
+        throw std::invalid_argument("--root must be an absolute path other than /");
+    return out;
+}
+
+std::string usage(const std::string& program_name)
+{
+    std::ostringstream os;
+    os << "Usage: " << program_name << " [--name=value]...\n"
+       << "\n"
+       << "Drives a mix of requests against a ZooKeeper ensemble and reports throughput and latency percentiles.\n"
+       << "\n"
+       << "  --connect=STRING     Connection string of the ensemble (default zk://127.0.0.1:2181)\n"
+       << "  --ensemble=N         Start an ensemble of N local servers instead of connecting to --connect\n"
+       << "  --classpath=A:B      JARs to run the started servers with (default: the system ZooKeeper)\n"
+       << "  --data-dir=PATH      Where the started servers keep their data (default zkpp-loadgen-data)\n"
+       << "  --threads=N          Threads issuing requests, one at a time each (default 4)\n"
+       << "  --sessions=M         Sessions shared by the threads (default 1)\n"
+       << "  --duration=SECONDS   How long to measure for (default 10)\n"
+       << "  --mix=OP:W,...       Weights of get, set, create, multi and watch (default get:70,set:20,create:5,"
+          "multi:3,watch:2)\n"
+       << "  --payload=BYTES      Size of the data written (default 128)\n"
+       << "  --fanout=N           Children of each inner entry of the tree (default 10)\n"
+       << "  --depth=N            Levels of the tree (default 2)\n"
+       << "  --multi-size=N       Operations in each multi (default 4)\n"
+       << "  --root=PATH          Entry the tree is built under, erased afterwards (default /zkpp-loadgen)\n"
+       << "  --format=json|csv    Format of the report on stdout (default json)\n"
+       << "  --server-stats=0|1   Report the change in the servers' mntr numbers over the run (default 1)\n";
+    return os.str();
+}
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace zk::loadgen
+{
+
+/// The kinds of operation the load generator issues.
+enum class operation : int
+{
+    get,
+    set,
+    create,
+    multi,
+    watch,
+};
+
+static constexpr std::size_t operation_count = 5U;
+
+std::ostream& operator<<(std::ostream&, const operation&);
+
+std::string to_string(const operation&);
+
+/// How to report the results.
+enum class output_format : int
+{
+    json,
+    csv,
+};
+
+/// Everything that describes a run. The defaults describe a small read-heavy load against an external server on the
+/// local machine.
+struct options final
+{
+    /// The ensemble to run against. When empty, an ensemble of \ref ensemble_size servers is started instead.
+    std::string connection_string = "zk://127.0.0.1:2181";
+
+    /// The number of servers to start when there is no \ref connection_string. This should be odd.
+    std::size_t ensemble_size = 0U;
+
+    /// The JARs to run the started servers with. When empty, \c server::classpath::system_default is used. Pointing
+    /// this at a different release is how two server versions are compared.
+    std::vector<std::string> classpath;
+
+    /// Where the started servers keep their data; it is erased first.
+    std::string data_directory = "zkpp-loadgen-data";
+
+    /// The number of threads issuing requests. Each waits for its request to finish before issuing the next one.
+    std::size_t threads = 4U;
+
+    /// The number of sessions the threads share. Thread \c i uses session \c i % sessions.
+    std::size_t sessions = 1U;
+
+    /// How long to measure for, after the tree was built.
+    std::chrono::milliseconds duration = std::chrono::seconds(10);
+
+    /// The relative weight of each \ref operation in the mix, indexed by its value.
+    std::array<unsigned, operation_count> mix = { 70U, 20U, 5U, 3U, 2U };
+
+    /// The size of the data written by \c set, \c create and \c multi.
+    std::size_t payload_size = 128U;
+
+    /// The tree the requests target: every inner entry has \ref tree_fanout children, \ref tree_depth levels deep
+    /// under \ref root. The operations pick one of the leaves at random.
+    std::size_t tree_fanout = 10U;
+    std::size_t tree_depth  = 2U;
+
+    /// The number of \c set operations in each \c multi.
+    std::size_t multi_size = 4U;
+
+    /// The entry the tree is built under. It is erased when the run is over.
+    std::string root = "/zkpp-loadgen";
+
+    output_format format = output_format::json;
+
+    /// Scrape the servers with \c "mntr" before and after the measurement and report how their numbers changed next to
+    /// the client's. The servers must allow the word; the ones started for the run do.
+    bool server_stats = true;
+};
+
+/// Parse the command line. Options take the form \c --name=value; see \ref usage.
+///
+/// \throws std::invalid_argument if an option is unknown or a value does not make sense.
+options parse_options(int argc, char** argv);
+
+/// The help text listing the options.
+std::string usage(const std::string& program_name);
+
+}
@@ -0,0 +1,176 @@
+#include "report.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <ostream>
+#include <utility>
+
+namespace zk::loadgen
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// recorder                                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void recorder::record(operation op, std::chrono::steady_clock::duration latency, bool succeeded)
+{
+    if (succeeded)
+        _latencies_us[index(op)].push_back(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+    else
+        ++_errors[index(op)];
+}
+
+void recorder::merge(recorder&& other)
+{
+    for (std::size_t idx = 0U; idx < operation_count; ++idx)
+    {
+        auto& into = _latencies_us[idx];
+        auto& from = other._latencies_us[idx];
+        into.insert(into.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+        from.clear();
+
+        _errors[idx] += std::exchange(other._errors[idx], 0U);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// report                                                                                                             //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The nearest-rank percentile of the sorted \a values.
+static std::int64_t percentile(const std::vector<std::int64_t>& values, double fraction)
+{
+    if (values.empty())
+        return 0;
+
+    auto rank = std::size_t(fraction * double(values.size()));
+    return values[std::min(rank, values.size() - 1U)];
+}
+
+operation_summary operation_summary::from(std::vector<std::int64_t>&    latencies_us,
+                                          std::uint64_t                 errors,
+                                          std::chrono::duration<double> elapsed
+                                         )
+{
+    std::sort(latencies_us.begin(), latencies_us.end());
+
+    operation_summary out;
+    out.count      = latencies_us.size();
+    out.errors     = errors;
+    out.throughput = elapsed.count() > 0.0 ? double(out.count) / elapsed.count() : 0.0;
+    out.p50        = percentile(latencies_us, 0.5);
+    out.p99        = percentile(latencies_us, 0.99);
+    out.p999       = percentile(latencies_us, 0.999);
+    out.max        = latencies_us.empty() ? 0 : latencies_us.back();
+    return out;
+}
+
+report report::from(const options& settings, recorder&& combined, std::chrono::duration<double> elapsed)
+{
+    report out;
+    out.settings = settings;
+    out.elapsed  = elapsed;
+
+    std::vector<std::int64_t> all;
+    std::uint64_t             all_errors = 0U;
+    for (std::size_t idx = 0U; idx < operation_count; ++idx)
+    {
+        auto op = static_cast<operation>(idx);
+        std::vector<std::int64_t> latencies = combined.latencies_of(op);
+        out.operations[idx] = operation_summary::from(latencies, combined.errors_of(op), elapsed);
+
+        all.insert(all.end(), latencies.begin(), latencies.end());
+        all_errors += combined.errors_of(op);
+    }
+    out.total = operation_summary::from(all, all_errors, elapsed);
+    return out;
+}
+
+static void write_json_summary(std::ostream& os, const operation_summary& src)
+{
+    os << "{\"count\":" << src.count
+       << ",\"errors\":" << src.errors
+       << ",\"throughput\":" << src.throughput
+       << ",\"p50_us\":" << src.p50
+       << ",\"p99_us\":" << src.p99
+       << ",\"p999_us\":" << src.p999
+       << ",\"max_us\":" << src.max
+       << '}';
+}
+
+static void write_json_server(std::ostream& os, const server::server_stats_delta& src)
+{
+    os << "{\"server\":\"" << src.source << '"'
+       << ",\"packets_received\":" << src.packets_received
+       << ",\"packets_sent\":" << src.packets_sent
+       << ",\"outstanding_requests\":" << src.outstanding_requests
+       << ",\"znode_count\":" << src.znode_count
+       << ",\"watch_count\":" << src.watch_count
+       << ",\"ephemerals_count\":" << src.ephemerals_count
+       << ",\"fsync_threshold_exceed_count\":" << src.fsync_threshold_exceed_count
+       << '}';
+}
+
+void write_json(std::ostream& os, const report& src)
+{
+    const auto& settings = src.settings;
+    os << "{\"elapsed_s\":" << src.elapsed.count()
+       << ",\"threads\":" << settings.threads
+       << ",\"sessions\":" << settings.sessions
+       << ",\"payload_size\":" << settings.payload_size
+       << ",\"tree_fanout\":" << settings.tree_fanout
+       << ",\"tree_depth\":" << settings.tree_depth
+       << ",\"operations\":{";
+    bool first = true;
+    for (std::size_t idx = 0U; idx < operation_count; ++idx)
+    {
+        if (settings.mix[idx] == 0U)
+            continue;
+
+        if (first)
+            first = false;
+        else
+            os << ',';
+        os << '"' << static_cast<operation>(idx) << "\":";
+        write_json_summary(os, src.operations[idx]);
+    }
+    os << "},\"total\":";
+    write_json_summary(os, src.total);
+    if (!src.servers.empty())
+    {
+        os << ",\"servers\":[";
+        for (std::size_t idx = 0U; idx < src.servers.size(); ++idx)
+        {
+            if (idx > 0U)
+                os << ',';
+            write_json_server(os, src.servers[idx]);
+        }
+        os << ']';
+    }
+    os << "}\n";
+}
+
+static void write_csv_summary(std::ostream& os, const char* name, const operation_summary& src)
+{
+    os << name << ','
+       << src.count << ','
+       << src.errors << ','
+       << src.throughput << ','
+       << src.p50 << ','
+       << src.p99 << ','
+       << src.p999 << ','
+       << src.max << '\n';
+}
+
+void write_csv(std::ostream& os, const report& src)
+{
+    os << "operation,count,errors,throughput,p50_us,p99_us,p999_us,max_us\n";
+    for (std::size_t idx = 0U; idx < operation_count; ++idx)
+    {
+        if (src.settings.mix[idx] != 0U)
+            write_csv_summary(os, to_string(static_cast<operation>(idx)).c_str(), src.operations[idx]);
+    }
+    write_csv_summary(os, "total", src.total);
+}
+
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/server/monitor.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "options.hpp"
+
+namespace zk::loadgen
+{
+
+/// The latencies one thread observed. Every request is kept, so the percentiles are exact rather than estimated from
+/// buckets; at a few bytes per request this is cheap next to what a request costs.
+class recorder final
+{
+public:
+    void record(operation op, std::chrono::steady_clock::duration latency, bool succeeded);
+
+    /// Move everything \a other recorded into this one.
+    void merge(recorder&& other);
+
+    const std::vector<std::int64_t>& latencies_of(operation op) const { return _latencies_us[index(op)]; }
+
+    std::uint64_t errors_of(operation op) const { return _errors[index(op)]; }
+
+private:
+    static std::size_t index(operation op) { return static_cast<std::size_t>(op); }
+
+private:
+    std::array<std::vector<std::int64_t>, operation_count> _latencies_us;
+    std::array<std::uint64_t, operation_count>             _errors{};
+};
+
+/// The summary of one \ref operation (or all of them) over a run. The latencies are in microseconds.
+struct operation_summary final
+{
+    std::uint64_t count      = 0U;
+    std::uint64_t errors     = 0U;
+    double        throughput = 0.0; //!< Successful requests per second.
+    std::int64_t  p50        = 0;
+    std::int64_t  p99        = 0;
+    std::int64_t  p999       = 0;
+    std::int64_t  max        = 0;
+
+    /// Summarize \a latencies_us (which is sorted in the process) of a run of \a elapsed.
+    static operation_summary from(std::vector<std::int64_t>&    latencies_us,
+                                  std::uint64_t                 errors,
+                                  std::chrono::duration<double> elapsed
+                                 );
+};
+
+/// What a run did, ready to be printed.
+struct report final
+{
+    options                                        settings;
+    std::chrono::duration<double>                  elapsed{ 0.0 };
+    std::array<operation_summary, operation_count> operations;
+    operation_summary                              total;
+    std::vector<server::server_stats_delta>        servers; //!< The servers which answered \c "mntr" both times
+
+    static report from(const options& settings, recorder&& combined, std::chrono::duration<double> elapsed);
+};
+
+/// Write \a src as a single JSON object. The \ref report::servers are in its \c "servers" array.
+void write_json(std::ostream& os, const report& src);
+
+/// Write \a src as CSV: a header line, then one line for each operation that ran and one for the total. The
+/// \ref report::servers are left out, as they do not fit the columns.
+void write_csv(std::ostream& os, const report& src);
+
+}
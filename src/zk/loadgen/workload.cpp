@@ -0,0 +1,140 @@
+#include "workload.hpp"
+
+#include <zk/error.hpp>
+#include <zk/multi.hpp>
+
+#include <utility>
+
+namespace zk::loadgen
+{
+
+workload::workload(const options& settings) :
+        _settings(settings),
+        _payload(settings.payload_size, 'x')
+{
+    std::vector<std::string> level = { settings.root };
+    for (std::size_t depth = 0U; depth < settings.tree_depth; ++depth)
+    {
+        std::vector<std::string> next;
+        next.reserve(level.size() * settings.tree_fanout);
+        for (const auto& parent : level)
+            for (std::size_t idx = 0U; idx < settings.tree_fanout; ++idx)
+                next.emplace_back(parent + "/n" + std::to_string(idx));
+        level = std::move(next);
+    }
+    _leaves = std::move(level);
+}
+
+void workload::build(client session)
+{
+    erase_tree(session, _settings.root);
+    session.create(_settings.root, buffer()).get();
+
+    // Create each level with all of its creations in flight at once; the tree can have tens of thousands of entries
+    std::vector<std::string> level = { _settings.root };
+    for (std::size_t depth = 0U; depth < _settings.tree_depth; ++depth)
+    {
+        bool is_leaf_level = depth + 1U == _settings.tree_depth;
+
+        std::vector<std::string>           next;
+        std::vector<future<create_result>> pending;
+        for (const auto& parent : level)
+        {
+            for (std::size_t idx = 0U; idx < _settings.tree_fanout; ++idx)
+            {
+                next.emplace_back(parent + "/n" + std::to_string(idx));
+                pending.emplace_back(session.create(next.back(), is_leaf_level ? _payload : buffer()));
+            }
+        }
+        for (auto& fut : pending)
+            fut.get();
+        level = std::move(next);
+    }
+}
+
+void workload::tear_down(client session)
+{
+    erase_tree(session, _settings.root);
+}
+
+void workload::erase_tree(client& session, const std::string& path)
+{
+    try
+    {
+        for (auto child : session.get_children_list(path).get().children())
+            erase_tree(session, path + "/" + std::string(child));
+        session.erase(path).get();
+    }
+    catch (const no_entry&)
+    {
+        // someone else already erased it (or it was never created)
+    }
+}
+
+void workload::issue(client& session, operation kind, const std::string& leaf, std::mt19937_64& rng)
+{
+    switch (kind)
+    {
+    case operation::get:
+        session.get(leaf).get();
+        break;
+    case operation::set:
+        session.set(leaf, _payload).get();
+        break;
+    case operation::create:
+        // Ephemeral so that they do not pile up across runs if the tear down does not happen
+        session.create(leaf + "/c-", _payload, create_mode::ephemeral | create_mode::sequential).get();
+        break;
+    case operation::multi:
+    {
+        std::uniform_int_distribution<std::size_t> pick(0U, _leaves.size() - 1U);
+        std::vector<op> ops;
+        ops.reserve(_settings.multi_size);
+        ops.emplace_back(op::set(leaf, _payload));
+        while (ops.size() < _settings.multi_size)
+            ops.emplace_back(op::set(_leaves[pick(rng)], _payload));
+        session.commit(multi_op(std::move(ops))).get();
+        break;
+    }
+    case operation::watch:
+    {
+        // The time for a change to come back as an event: set the watch, change the entry and wait for the trigger
+        auto watch = session.watch(leaf).get();
+        session.set(leaf, _payload).get();
+        watch.next().get();
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void workload::run(client                                session,
+                   std::size_t                           thread_idx,
+                   std::chrono::steady_clock::time_point deadline,
+                   recorder&                             out
+                  )
+{
+    std::mt19937_64                            rng(0x9E3779B97F4A7C15ULL * (thread_idx + 1U));
+    std::discrete_distribution<std::size_t>    pick_op(_settings.mix.begin(), _settings.mix.end());
+    std::uniform_int_distribution<std::size_t> pick_leaf(0U, _leaves.size() - 1U);
+
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        auto        kind  = static_cast<operation>(pick_op(rng));
+        const auto& leaf  = _leaves[pick_leaf(rng)];
+        auto        start = std::chrono::steady_clock::now();
+        bool        ok    = true;
+        try
+        {
+            issue(session, kind, leaf, rng);
+        }
+        catch (const error&)
+        {
+            ok = false;
+        }
+        out.record(kind, std::chrono::steady_clock::now() - start, ok);
+    }
+}
+
+}
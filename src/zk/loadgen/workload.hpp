@@ -0,0 +1,49 @@
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/client.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "options.hpp"
+#include "report.hpp"
+
+namespace zk::loadgen
+{
+
+/// The tree a run works on and the requests it makes against it. A workload is built once and shared by every thread;
+/// \ref run holds no state of its own beyond what it is passed, so it can be called concurrently.
+class workload final
+{
+public:
+    explicit workload(const options& settings);
+
+    /// Create the tree under \c options::root (erasing whatever was there) through \a session.
+    void build(client session);
+
+    /// Issue requests through \a session from the calling thread until \a deadline, adding their latencies to \a out.
+    /// \a thread_idx keeps the threads from picking the same sequence of entries.
+    void run(client session, std::size_t thread_idx, std::chrono::steady_clock::time_point deadline, recorder& out);
+
+    /// Erase the tree.
+    void tear_down(client session);
+
+    const std::vector<std::string>& leaves() const { return _leaves; }
+
+private:
+    /// Issue a single request of \a kind against \a leaf.
+    void issue(client& session, operation kind, const std::string& leaf, std::mt19937_64& rng);
+
+    void erase_tree(client& session, const std::string& path);
+
+private:
+    options                  _settings;
+    buffer                   _payload;
+    std::vector<std::string> _leaves;
+};
+
+}
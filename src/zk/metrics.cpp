@@ -0,0 +1,253 @@
+#include "metrics.hpp"
+#include "error.hpp"
+#include "types.hpp"
+
+#include <ostream>
+#include <sstream>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// request_type                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const request_type& self)
+{
+    switch (self)
+    {
+    case request_type::get:            return os << "get";
+    case request_type::get_children:   return os << "get_children";
+    case request_type::exists:         return os << "exists";
+    case request_type::watch:          return os << "watch";
+    case request_type::watch_children: return os << "watch_children";
+    case request_type::watch_exists:   return os << "watch_exists";
+    case request_type::create:         return os << "create";
+    case request_type::set:            return os << "set";
+    case request_type::erase:          return os << "erase";
+    case request_type::get_acl:        return os << "get_acl";
+    case request_type::set_acl:        return os << "set_acl";
+    case request_type::commit:         return os << "commit";
+    case request_type::load_fence:     return os << "load_fence";
+    default:                           return os << "request_type(" << static_cast<int>(self) << ')';
+    }
+}
+
+std::string to_string(const request_type& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// latency_histogram                                                                                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::chrono::microseconds latency_histogram::upper_bound(std::size_t idx)
+{
+    if (idx + 1U >= bucket_count)
+        return std::chrono::microseconds::max();
+    else
+        return std::chrono::microseconds(std::int64_t(16) << idx);
+}
+
+std::size_t latency_histogram::bucket_for(std::chrono::microseconds latency)
+{
+    std::size_t idx = 0U;
+    while (idx + 1U < bucket_count && latency > upper_bound(idx))
+        ++idx;
+    return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// metrics_snapshot                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::size_t metrics_snapshot::state_index(zk::state st)
+{
+    switch (st)
+    {
+    case zk::state::connecting:            return 1U;
+    case zk::state::connected:             return 2U;
+    case zk::state::read_only:             return 3U;
+    case zk::state::expired_session:       return 4U;
+    case zk::state::authentication_failed: return 5U;
+    case zk::state::closed:
+    default:                               return 0U;
+    }
+}
+
+static void write_seconds(std::ostream& os, std::chrono::microseconds value)
+{
+    os << (double(value.count()) / 1e6);
+}
+
+void write_prometheus(std::ostream& os, const metrics_snapshot& snapshot, string_view prefix)
+{
+    os << "# HELP " << prefix << "_request_latency_seconds Time from submitting a request to its completion.\n"
+       << "# TYPE " << prefix << "_request_latency_seconds histogram\n";
+    for (std::size_t type_idx = 0U; type_idx < request_type_count; ++type_idx)
+    {
+        const auto& hist = snapshot.latencies[type_idx];
+        auto        type = static_cast<request_type>(type_idx);
+
+        // Prometheus buckets are cumulative
+        std::uint64_t cumulative = 0U;
+        for (std::size_t idx = 0U; idx < latency_histogram::bucket_count; ++idx)
+        {
+            cumulative += hist.buckets[idx];
+            os << prefix << "_request_latency_seconds_bucket{type=\"" << type << "\",le=\"";
+            if (idx + 1U == latency_histogram::bucket_count)
+                os << "+Inf";
+            else
+                write_seconds(os, latency_histogram::upper_bound(idx));
+            os << "\"} " << cumulative << '\n';
+        }
+        os << prefix << "_request_latency_seconds_sum{type=\"" << type << "\"} ";
+        write_seconds(os, hist.total);
+        os << '\n';
+        os << prefix << "_request_latency_seconds_count{type=\"" << type << "\"} " << hist.count << '\n';
+    }
+
+    os << "# HELP " << prefix << "_request_errors_total Requests which completed with an error.\n"
+       << "# TYPE " << prefix << "_request_errors_total counter\n";
+    for (std::size_t type_idx = 0U; type_idx < request_type_count; ++type_idx)
+        os << prefix << "_request_errors_total{type=\"" << static_cast<request_type>(type_idx) << "\"} "
+           << snapshot.errors[type_idx] << '\n';
+
+    os << "# HELP " << prefix << "_requests_in_flight Requests submitted which have not completed.\n"
+       << "# TYPE " << prefix << "_requests_in_flight gauge\n"
+       << prefix << "_requests_in_flight " << snapshot.in_flight << '\n';
+
+    auto write_counter = [&] (string_view name, string_view help, std::uint64_t value)
+                         {
+                             os << "# HELP " << prefix << '_' << name << ' ' << help << '\n'
+                                << "# TYPE " << prefix << '_' << name << " counter\n"
+                                << prefix << '_' << name << ' ' << value << '\n';
+                         };
+    write_counter("sent_bytes_total",        "Bytes of paths and data sent in requests.", snapshot.bytes_sent);
+    write_counter("received_bytes_total",    "Bytes of entry data received.",             snapshot.bytes_received);
+    write_counter("watches_set_total",       "Watches registered.",                       snapshot.watches_set);
+    write_counter("watches_fired_total",     "Watches triggered.",                        snapshot.watches_fired);
+    write_counter("watches_coalesced_total", "Watches which shared one already set.",     snapshot.watches_coalesced);
+
+    static constexpr zk::state all_states[] = { zk::state::closed,
+                                                zk::state::connecting,
+                                                zk::state::connected,
+                                                zk::state::read_only,
+                                                zk::state::expired_session,
+                                                zk::state::authentication_failed,
+                                              };
+    os << "# HELP " << prefix << "_state_transitions_total Times the session entered each state.\n"
+       << "# TYPE " << prefix << "_state_transitions_total counter\n";
+    for (auto st : all_states)
+        os << prefix << "_state_transitions_total{state=\"" << st << "\"} " << snapshot.transitions_to(st) << '\n';
+}
+
+std::string to_prometheus(const metrics_snapshot& snapshot, string_view prefix)
+{
+    std::ostringstream os;
+    write_prometheus(os, snapshot, prefix);
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// connection_metrics                                                                                                 //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+connection_metrics::connection_metrics() noexcept :
+        _in_flight(0),
+        _bytes_sent(0U),
+        _bytes_received(0U),
+        _watches_set(0U),
+        _watches_fired(0U),
+        _watches_coalesced(0U)
+{
+    for (auto& request : _requests)
+    {
+        for (auto& bucket : request.buckets)
+            bucket.store(0U, std::memory_order_relaxed);
+        request.count.store(0U, std::memory_order_relaxed);
+        request.total_us.store(0U, std::memory_order_relaxed);
+        request.errors.store(0U, std::memory_order_relaxed);
+    }
+    for (auto& transitions : _state_transitions)
+        transitions.store(0U, std::memory_order_relaxed);
+}
+
+connection_metrics::~connection_metrics() noexcept = default;
+
+void connection_metrics::on_submit(std::size_t payload_size) noexcept
+{
+    _in_flight.fetch_add(1, std::memory_order_relaxed);
+    _bytes_sent.fetch_add(payload_size, std::memory_order_relaxed);
+}
+
+void connection_metrics::on_complete(request_type                        type,
+                                     std::chrono::steady_clock::duration latency,
+                                     error_code                          rc
+                                    ) noexcept
+{
+    auto  latency_us = std::chrono::duration_cast<std::chrono::microseconds>(latency);
+    auto& request    = _requests[static_cast<std::size_t>(type)];
+    request.buckets[latency_histogram::bucket_for(latency_us)].fetch_add(1U, std::memory_order_relaxed);
+    request.count.fetch_add(1U, std::memory_order_relaxed);
+    request.total_us.fetch_add(static_cast<std::uint64_t>(latency_us.count()), std::memory_order_relaxed);
+    if (rc != error_code::ok)
+        request.errors.fetch_add(1U, std::memory_order_relaxed);
+
+    _in_flight.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void connection_metrics::on_receive(std::size_t data_size) noexcept
+{
+    _bytes_received.fetch_add(data_size, std::memory_order_relaxed);
+}
+
+void connection_metrics::on_watch_set() noexcept
+{
+    _watches_set.fetch_add(1U, std::memory_order_relaxed);
+}
+
+void connection_metrics::on_watch_fired() noexcept
+{
+    _watches_fired.fetch_add(1U, std::memory_order_relaxed);
+}
+
+void connection_metrics::on_watch_coalesced() noexcept
+{
+    _watches_coalesced.fetch_add(1U, std::memory_order_relaxed);
+}
+
+void connection_metrics::on_state_change(zk::state st) noexcept
+{
+    _state_transitions[metrics_snapshot::state_index(st)].fetch_add(1U, std::memory_order_relaxed);
+}
+
+metrics_snapshot connection_metrics::snapshot() const
+{
+    metrics_snapshot out;
+    for (std::size_t type_idx = 0U; type_idx < request_type_count; ++type_idx)
+    {
+        const auto& request = _requests[type_idx];
+        auto&       hist    = out.latencies[type_idx];
+        for (std::size_t idx = 0U; idx < latency_histogram::bucket_count; ++idx)
+            hist.buckets[idx] = request.buckets[idx].load(std::memory_order_relaxed);
+        hist.count = request.count.load(std::memory_order_relaxed);
+        auto total_us = request.total_us.load(std::memory_order_relaxed);
+        hist.total = std::chrono::microseconds(static_cast<std::int64_t>(total_us));
+        out.errors[type_idx] = request.errors.load(std::memory_order_relaxed);
+    }
+    out.in_flight         = _in_flight.load(std::memory_order_relaxed);
+    out.bytes_sent        = _bytes_sent.load(std::memory_order_relaxed);
+    out.bytes_received    = _bytes_received.load(std::memory_order_relaxed);
+    out.watches_set       = _watches_set.load(std::memory_order_relaxed);
+    out.watches_fired     = _watches_fired.load(std::memory_order_relaxed);
+    out.watches_coalesced = _watches_coalesced.load(std::memory_order_relaxed);
+    for (std::size_t idx = 0U; idx < out.state_transitions.size(); ++idx)
+        out.state_transitions[idx] = _state_transitions[idx].load(std::memory_order_relaxed);
+    return out;
+}
+
+}
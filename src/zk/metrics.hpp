@@ -0,0 +1,185 @@
+/// \file
+/// Defines \ref zk::connection_metrics and its \ref zk::metrics_snapshot, which describe what a connection has been
+/// doing.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "forwards.hpp"
+#include "string_view.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// The kind of request being measured. The variants of an operation are counted together: \c get_into and batched
+/// \c get_many count as \ref get, \c get_children_list and \c for_each_child as \ref get_children, and so on. A batch
+/// counts as a single request.
+enum class request_type : int
+{
+    get,
+    get_children,
+    exists,
+    watch,
+    watch_children,
+    watch_exists,
+    create,
+    set,
+    erase,
+    get_acl,
+    set_acl,
+    commit,
+    load_fence,
+};
+
+/// The number of \ref request_type values.
+static constexpr std::size_t request_type_count = 13U;
+
+std::ostream& operator<<(std::ostream&, const request_type&);
+
+std::string to_string(const request_type&);
+
+/// The distribution of the latencies of a kind of request, from its submission until its completion was delivered.
+/// The buckets are exponential: bucket \c i counts latencies which are at most \ref upper_bound of \c i (and above the
+/// bound of the bucket before it). The last bucket has no upper bound.
+struct latency_histogram final
+{
+    static constexpr std::size_t bucket_count = 22U;
+
+    /// The number of requests which fell in each bucket.
+    std::array<std::uint64_t, bucket_count> buckets{};
+
+    /// The total number of requests measured.
+    std::uint64_t count = 0U;
+
+    /// The sum of all measured latencies.
+    std::chrono::microseconds total{ 0 };
+
+    /// The largest latency which falls in bucket \a idx: 16 microseconds for the first and doubling from there, up to
+    /// about 16.8 seconds. The last bucket returns \c microseconds::max.
+    static std::chrono::microseconds upper_bound(std::size_t idx);
+
+    /// The bucket a request which took \a latency falls in.
+    static std::size_t bucket_for(std::chrono::microseconds latency);
+};
+
+/// A copy of the values of a \ref connection_metrics at one point in time.
+struct metrics_snapshot final
+{
+    /// The latencies of the requests of each \ref request_type, indexed by its value.
+    std::array<latency_histogram, request_type_count> latencies{};
+
+    /// The number of requests of each \ref request_type which completed with an error.
+    std::array<std::uint64_t, request_type_count> errors{};
+
+    /// The number of requests which have been submitted but have not completed.
+    std::int64_t in_flight = 0;
+
+    /// The bytes of paths and data sent in requests. This is the payload, not the bytes on the wire; the framing and
+    /// encoding added by the protocol are not counted.
+    std::uint64_t bytes_sent = 0U;
+
+    /// The bytes of entry data received in responses.
+    std::uint64_t bytes_received = 0U;
+
+    /// The number of watches which were successfully registered.
+    std::uint64_t watches_set = 0U;
+
+    /// The number of watches which triggered (including by a session event).
+    std::uint64_t watches_fired = 0U;
+
+    /// The number of watches which were not sent to the server because an identical watch was already set or being
+    /// set by the same connection; they share its registration and its event.
+    std::uint64_t watches_coalesced = 0U;
+
+    /// The number of times the session entered each state, keyed by \ref state_index.
+    std::array<std::uint64_t, 6U> state_transitions{};
+
+    /// The index in \ref state_transitions for \a st.
+    static std::size_t state_index(zk::state st);
+
+    const latency_histogram& latency(request_type type) const { return latencies[static_cast<std::size_t>(type)]; }
+
+    std::uint64_t errors_of(request_type type) const { return errors[static_cast<std::size_t>(type)]; }
+
+    std::uint64_t transitions_to(zk::state st) const { return state_transitions[state_index(st)]; }
+};
+
+/// Write \a snapshot to \a os in the Prometheus text exposition format. Every metric name starts with \a prefix.
+///
+/// \code
+/// zk::write_prometheus(std::cout, client.metrics(), "zkpp");
+/// // zkpp_request_latency_seconds_bucket{type="get",le="1.6e-05"} 0
+/// // ...
+/// \endcode
+void write_prometheus(std::ostream& os, const metrics_snapshot& snapshot, string_view prefix = "zkpp");
+
+std::string to_prometheus(const metrics_snapshot& snapshot, string_view prefix = "zkpp");
+
+/// The live counters of a connection. Every update is a relaxed atomic operation, so recording is cheap and never
+/// takes a lock; \ref snapshot reads each counter on its own, so a snapshot taken while requests are completing is not
+/// perfectly consistent (the sum of the buckets might be a little off from the count).
+class connection_metrics final
+{
+public:
+    connection_metrics() noexcept;
+
+    connection_metrics(const connection_metrics&) = delete;
+    connection_metrics& operator=(const connection_metrics&) = delete;
+
+    ~connection_metrics() noexcept;
+
+    /// A request was submitted, which carries \a payload_size bytes of paths and data.
+    void on_submit(std::size_t payload_size) noexcept;
+
+    /// A request of \a type finished with \a rc after \a latency.
+    void on_complete(request_type type, std::chrono::steady_clock::duration latency, error_code rc) noexcept;
+
+    /// A response carried \a data_size bytes of entry data.
+    void on_receive(std::size_t data_size) noexcept;
+
+    void on_watch_set() noexcept;
+
+    void on_watch_fired() noexcept;
+
+    void on_watch_coalesced() noexcept;
+
+    void on_state_change(zk::state st) noexcept;
+
+    metrics_snapshot snapshot() const;
+
+private:
+    using counter = std::atomic<std::uint64_t>;
+
+    struct request_counters final
+    {
+        std::array<counter, latency_histogram::bucket_count> buckets;
+        counter                                              count;
+        counter                                              total_us;
+        counter                                              errors;
+    };
+
+private:
+    std::array<request_counters, request_type_count> _requests;
+    std::atomic<std::int64_t>                        _in_flight;
+    counter                                          _bytes_sent;
+    counter                                          _bytes_received;
+    counter                                          _watches_set;
+    counter                                          _watches_fired;
+    counter                                          _watches_coalesced;
+    std::array<counter, 6U>                          _state_transitions;
+};
+
+/// \}
+
+}
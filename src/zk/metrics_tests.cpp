@@ -0,0 +1,86 @@
+#include <zk/tests/test.hpp>
+
+#include <chrono>
+#include <string>
+
+#include "error.hpp"
+#include "metrics.hpp"
+#include "types.hpp"
+
+namespace zk
+{
+
+GTEST_TEST(metrics_tests, request_type_stringify)
+{
+    CHECK_EQ("get",          to_string(request_type::get));
+    CHECK_EQ("watch_exists", to_string(request_type::watch_exists));
+    CHECK_EQ("load_fence",   to_string(request_type::load_fence));
+}
+
+GTEST_TEST(metrics_tests, histogram_buckets)
+{
+    using std::chrono::microseconds;
+
+    CHECK_EQ(0U, latency_histogram::bucket_for(microseconds(0)));
+    CHECK_EQ(0U, latency_histogram::bucket_for(microseconds(16)));
+    CHECK_EQ(1U, latency_histogram::bucket_for(microseconds(17)));
+    CHECK_EQ(1U, latency_histogram::bucket_for(microseconds(32)));
+    CHECK_EQ(10U, latency_histogram::bucket_for(microseconds(16 << 10)));
+    CHECK_EQ(latency_histogram::bucket_count - 1U, latency_histogram::bucket_for(std::chrono::hours(1)));
+    CHECK_TRUE(microseconds::max() == latency_histogram::upper_bound(latency_histogram::bucket_count - 1U));
+}
+
+GTEST_TEST(metrics_tests, record_and_snapshot)
+{
+    connection_metrics metrics;
+    metrics.on_submit(10U);
+    metrics.on_submit(5U);
+    CHECK_EQ(2, metrics.snapshot().in_flight);
+
+    metrics.on_receive(100U);
+    metrics.on_complete(request_type::get, std::chrono::microseconds(20), error_code::ok);
+    metrics.on_complete(request_type::set, std::chrono::milliseconds(3), error_code::version_mismatch);
+    metrics.on_watch_set();
+    metrics.on_watch_fired();
+    metrics.on_watch_coalesced();
+    metrics.on_state_change(state::connected);
+    metrics.on_state_change(state::connecting);
+    metrics.on_state_change(state::connected);
+
+    auto snap = metrics.snapshot();
+    CHECK_EQ(0, snap.in_flight);
+    CHECK_EQ(15U, snap.bytes_sent);
+    CHECK_EQ(100U, snap.bytes_received);
+    CHECK_EQ(1U, snap.watches_set);
+    CHECK_EQ(1U, snap.watches_fired);
+    CHECK_EQ(1U, snap.watches_coalesced);
+    CHECK_EQ(2U, snap.transitions_to(state::connected));
+    CHECK_EQ(1U, snap.transitions_to(state::connecting));
+    CHECK_EQ(0U, snap.transitions_to(state::expired_session));
+
+    CHECK_EQ(1U, snap.latency(request_type::get).count);
+    CHECK_EQ(1U, snap.latency(request_type::get).buckets[1]);
+    CHECK_EQ(0U, snap.errors_of(request_type::get));
+    CHECK_EQ(1U, snap.errors_of(request_type::set));
+    CHECK_TRUE(std::chrono::microseconds(3000) == snap.latency(request_type::set).total);
+    CHECK_EQ(0U, snap.latency(request_type::erase).count);
+}
+
+GTEST_TEST(metrics_tests, prometheus_text)
+{
+    connection_metrics metrics;
+    metrics.on_submit(4U);
+    metrics.on_complete(request_type::get, std::chrono::microseconds(20), error_code::ok);
+
+    auto text = to_prometheus(metrics.snapshot(), "test");
+    CHECK_NE(std::string::npos, text.find("# TYPE test_request_latency_seconds histogram\n"));
+    CHECK_NE(std::string::npos, text.find("test_request_latency_seconds_bucket{type=\"get\",le=\"1.6e-05\"} 0\n"));
+    CHECK_NE(std::string::npos, text.find("test_request_latency_seconds_bucket{type=\"get\",le=\"3.2e-05\"} 1\n"));
+    CHECK_NE(std::string::npos, text.find("test_request_latency_seconds_bucket{type=\"get\",le=\"+Inf\"} 1\n"));
+    CHECK_NE(std::string::npos, text.find("test_request_latency_seconds_count{type=\"get\"} 1\n"));
+    CHECK_NE(std::string::npos, text.find("test_requests_in_flight 0\n"));
+    CHECK_NE(std::string::npos, text.find("test_sent_bytes_total 4\n"));
+    CHECK_NE(std::string::npos, text.find("test_state_transitions_total{state=\"connected\"} 0\n"));
+}
+
+}
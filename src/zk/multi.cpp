@@ -1,9 +1,12 @@
 #include "multi.hpp"
 
+#include <memory>
 #include <new>
 #include <ostream>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <utility>
 
 namespace zk
 {
@@ -24,11 +27,13 @@ std::ostream& operator<<(std::ostream& os, const op_type& self)
 {
     switch (self)
     {
-    case op_type::check:  return os << "check";
-    case op_type::create: return os << "create";
-    case op_type::erase:  return os << "erase";
-    case op_type::set:    return os << "set";
-    default:              return os << "op_type(" << static_cast<int>(self) << ')';
+    case op_type::check:        return os << "check";
+    case op_type::create:       return os << "create";
+    case op_type::erase:        return os << "erase";
+    case op_type::set:          return os << "set";
+    case op_type::get:          return os << "get";
+    case op_type::get_children: return os << "get_children";
+    default:                    return os << "op_type(" << static_cast<int>(self) << ')';
     }
 }
 
@@ -94,6 +99,11 @@ op op::check(std::string path, version check_)
     return op(check_data(std::move(path), check_));
 }
 
+op op::check(zk::path path, version check_)
+{
+    return check(std::move(path).str(), check_);
+}
+
 const op::check_data& op::as_check() const
 {
     return as<check_data>("as_check");
@@ -101,7 +111,14 @@ const op::check_data& op::as_check() const
 
 // create
 
-op::create_data::create_data(std::string path, buffer data, acl rules, create_mode mode) :
+/// The rules of a creation which is not given any, shared by all of them.
+static const acl_handle& default_create_rules()
+{
+    static const auto instance = acl_handle::intern(acls::open_unsafe());
+    return instance;
+}
+
+op::create_data::create_data(std::string path, buffer data, acl_handle rules, create_mode mode) :
         path(std::move(path)),
         data(std::move(data)),
         rules(std::move(rules)),
@@ -117,13 +134,33 @@ std::ostream& operator<<(std::ostream& os, const op::create_data& self)
 }
 
 op op::create(std::string path, buffer data, acl rules, create_mode mode)
+{
+    return create(std::move(path), std::move(data), acl_handle(std::move(rules)), mode);
+}
+
+op op::create(std::string path, buffer data, acl_handle rules, create_mode mode)
 {
     return op(create_data(std::move(path), std::move(data), std::move(rules), mode));
 }
 
 op op::create(std::string path, buffer data, create_mode mode)
 {
-    return create(std::move(path), std::move(data), acls::open_unsafe(), mode);
+    return create(std::move(path), std::move(data), default_create_rules(), mode);
+}
+
+op op::create(zk::path path, buffer data, acl rules, create_mode mode)
+{
+    return create(std::move(path).str(), std::move(data), std::move(rules), mode);
+}
+
+op op::create(zk::path path, buffer data, acl_handle rules, create_mode mode)
+{
+    return create(std::move(path).str(), std::move(data), std::move(rules), mode);
+}
+
+op op::create(zk::path path, buffer data, create_mode mode)
+{
+    return create(std::move(path).str(), std::move(data), mode);
 }
 
 const op::create_data& op::as_create() const
@@ -150,6 +187,11 @@ op op::erase(std::string path, version check)
     return op(erase_data(std::move(path), check));
 }
 
+op op::erase(zk::path path, version check)
+{
+    return erase(std::move(path).str(), check);
+}
+
 const op::erase_data& op::as_erase() const
 {
     return as<erase_data>("as_erase");
@@ -175,11 +217,68 @@ op op::set(std::string path, buffer data, version check)
     return op(set_data(std::move(path), std::move(data), check));
 }
 
+op op::set(zk::path path, buffer data, version check)
+{
+    return set(std::move(path).str(), std::move(data), check);
+}
+
 const op::set_data& op::as_set() const
 {
     return as<set_data>("as_set");
 }
 
+// get
+
+op::get_data::get_data(std::string path) :
+        path(std::move(path))
+{ }
+
+std::ostream& operator<<(std::ostream& os, const op::get_data& self)
+{
+    return os << '{' << self.path << '}';
+}
+
+op op::get(std::string path)
+{
+    return op(get_data(std::move(path)));
+}
+
+op op::get(zk::path path)
+{
+    return get(std::move(path).str());
+}
+
+const op::get_data& op::as_get() const
+{
+    return as<get_data>("as_get");
+}
+
+// get_children
+
+op::get_children_data::get_children_data(std::string path) :
+        path(std::move(path))
+{ }
+
+std::ostream& operator<<(std::ostream& os, const op::get_children_data& self)
+{
+    return os << '{' << self.path << '}';
+}
+
+op op::get_children(std::string path)
+{
+    return op(get_children_data(std::move(path)));
+}
+
+op op::get_children(zk::path path)
+{
+    return get_children(std::move(path).str());
+}
+
+const op::get_children_data& op::as_get_children() const
+{
+    return as<get_children_data>("as_get_children");
+}
+
 // generic
 
 std::ostream& operator<<(std::ostream& os, const op& self)
@@ -222,6 +321,229 @@ std::ostream& operator<<(std::ostream& os, const multi_op& self)
     return os << ']';
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// op_view                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+op_view::op_view(op_type               type,
+                 path_view             path,
+                 string_view           data,
+                 ptr<const acl>        rules,
+                 ptr<const acl_handle> handle,
+                 create_mode           mode,
+                 version               check
+                ) noexcept :
+        _type(type),
+        _path(path),
+        _data(data),
+        _rules(rules),
+        _handle(handle),
+        _mode(mode),
+        _check(check)
+{ }
+
+static string_view bytes_of(const buffer& src) noexcept
+{
+    return string_view(src.data(), src.size());
+}
+
+static op_view view_of(const op& src) noexcept
+{
+    switch (src.type())
+    {
+    case op_type::create:
+    {
+        const auto& cdata = src.as_create();
+        return op_view::create(cdata.path, bytes_of(cdata.data), cdata.rules, cdata.mode);
+    }
+    case op_type::erase:
+        return op_view::erase(src.as_erase().path, src.as_erase().check);
+    case op_type::set:
+        return op_view::set(src.as_set().path, bytes_of(src.as_set().data), src.as_set().check);
+    case op_type::get:
+        return op_view::get(src.as_get().path);
+    case op_type::get_children:
+        return op_view::get_children(src.as_get_children().path);
+    default:
+        return op_view::check(src.as_check().path, src.as_check().check);
+    }
+}
+
+op_view::op_view(const op& src) noexcept :
+        op_view(view_of(src))
+{ }
+
+op_view op_view::check(path_view path, version check) noexcept
+{
+    return op_view(op_type::check, path, string_view(), nullptr, nullptr, create_mode::normal, check);
+}
+
+op_view op_view::create(path_view path, string_view data, const acl& rules, create_mode mode) noexcept
+{
+    return op_view(op_type::create, path, data, &rules, nullptr, mode, version::any());
+}
+
+op_view op_view::create(path_view path, string_view data, const acl_handle& rules, create_mode mode) noexcept
+{
+    return op_view(op_type::create, path, data, &rules.rules(), &rules, mode, version::any());
+}
+
+op_view op_view::create(path_view path, string_view data, create_mode mode) noexcept
+{
+    return create(path, data, default_create_rules(), mode);
+}
+
+op_view op_view::erase(path_view path, version check) noexcept
+{
+    return op_view(op_type::erase, path, string_view(), nullptr, nullptr, create_mode::normal, check);
+}
+
+op_view op_view::set(path_view path, string_view data, version check) noexcept
+{
+    return op_view(op_type::set, path, data, nullptr, nullptr, create_mode::normal, check);
+}
+
+op_view op_view::get(path_view path) noexcept
+{
+    return op_view(op_type::get, path, string_view(), nullptr, nullptr, create_mode::normal, version::any());
+}
+
+op_view op_view::get_children(path_view path) noexcept
+{
+    return op_view(op_type::get_children, path, string_view(), nullptr, nullptr, create_mode::normal, version::any());
+}
+
+std::ostream& operator<<(std::ostream& os, const op_view& self)
+{
+    os << self.type() << '{' << self.path().view();
+    if (self.type() == op_type::create)
+        os << ' ' << self.mode() << ' ' << *self.rules();
+    else if (!is_read(self.type()))
+        os << ' ' << self.check();
+    return os << '}';
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// multi_op_view                                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+multi_op_view::multi_op_view(const multi_op& src)
+{
+    _ops.reserve(src.size());
+    for (const auto& x : src)
+        _ops.emplace_back(x);
+}
+
+static buffer buffer_of(string_view src)
+{
+    return buffer(src.data(), src.data() + src.size());
+}
+
+multi_op multi_op_view::to_multi_op() const
+{
+    std::vector<op> out;
+    out.reserve(_ops.size());
+    for (const auto& x : _ops)
+    {
+        auto path = std::string(x.path().view());
+        switch (x.type())
+        {
+        case op_type::check:
+            out.push_back(op::check(std::move(path), x.check()));
+            break;
+        case op_type::create:
+            if (x.handle())
+                out.push_back(op::create(std::move(path), buffer_of(x.data()), *x.handle(), x.mode()));
+            else
+                out.push_back(op::create(std::move(path), buffer_of(x.data()), *x.rules(), x.mode()));
+            break;
+        case op_type::erase:
+            out.push_back(op::erase(std::move(path), x.check()));
+            break;
+        case op_type::set:
+            out.push_back(op::set(std::move(path), buffer_of(x.data()), x.check()));
+            break;
+        case op_type::get:
+            out.push_back(op::get(std::move(path)));
+            break;
+        case op_type::get_children:
+            out.push_back(op::get_children(std::move(path)));
+            break;
+        }
+    }
+    return multi_op(std::move(out));
+}
+
+std::ostream& operator<<(std::ostream& os, const multi_op_view& self)
+{
+    os << '[';
+    bool first = true;
+    for (const auto& x : self)
+    {
+        if (first)
+            first = false;
+        else
+            os << ", ";
+        os << x;
+    }
+    return os << ']';
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// prepared_multi                                                                                                     //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+prepared_multi::encoding::~encoding() noexcept = default;
+
+prepared_multi::prepared_multi(multi_op txn) :
+        _txn(std::make_unique<multi_op>(std::move(txn)))
+{ }
+
+prepared_multi::prepared_multi(multi_op txn, const encoder& encode) :
+        prepared_multi(std::move(txn))
+{
+    _encoding = encode(*_txn);
+}
+
+prepared_multi::prepared_multi(prepared_multi&&) noexcept = default;
+
+prepared_multi& prepared_multi::operator=(prepared_multi&&) noexcept = default;
+
+prepared_multi::~prepared_multi() noexcept = default;
+
+op& prepared_multi::at(size_type idx)
+{
+    return _txn->at(idx);
+}
+
+void prepared_multi::bind_data(size_type idx, buffer data)
+{
+    auto& target = at(idx);
+    if (auto creating = std::get_if<op::create_data>(&target._storage))
+        creating->data = std::move(data);
+    else if (auto setting = std::get_if<op::set_data>(&target._storage))
+        setting->data = std::move(data);
+    else
+        throw std::invalid_argument("Operation " + std::to_string(idx) + " has no data to bind: "
+                                    + to_string(target.type())
+                                   );
+}
+
+void prepared_multi::bind_version(size_type idx, version check)
+{
+    auto& target = at(idx);
+    if (auto checking = std::get_if<op::check_data>(&target._storage))
+        checking->check = check;
+    else if (auto erasing = std::get_if<op::erase_data>(&target._storage))
+        erasing->check = check;
+    else if (auto setting = std::get_if<op::set_data>(&target._storage))
+        setting->check = check;
+    else
+        throw std::invalid_argument("Operation " + std::to_string(idx) + " has no version to bind: "
+                                    + to_string(target.type())
+                                   );
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // multi_result                                                                                                       //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -241,6 +563,16 @@ multi_result::part::part(set_result res) noexcept :
         _storage(std::move(res))
 { }
 
+multi_result::part::part(get_result res) noexcept :
+        _type(op_type::get),
+        _storage(std::move(res))
+{ }
+
+multi_result::part::part(get_children_result res) noexcept :
+        _type(op_type::get_children),
+        _storage(std::move(res))
+{ }
+
 multi_result::part::part(const part& src) = default;
 
 multi_result::part::part(part&& src) noexcept :
@@ -277,6 +609,16 @@ const set_result& multi_result::part::as_set() const
     return as<set_result>("as_set");
 }
 
+const get_result& multi_result::part::as_get() const
+{
+    return as<get_result>("as_get");
+}
+
+const get_children_result& multi_result::part::as_get_children() const
+{
+    return as<get_children_result>("as_get_children");
+}
+
 multi_result::multi_result(std::vector<part> parts) noexcept :
         _parts(std::move(parts))
 { }
@@ -288,9 +630,11 @@ std::ostream& operator<<(std::ostream& os, const multi_result::part& self)
 {
     switch (self.type())
     {
-        case op_type::create: return os << self.as_create();
-        case op_type::set:    return os << self.as_set();
-        default:              return os << self.type() << "_result{}";
+        case op_type::create:       return os << self.as_create();
+        case op_type::set:          return os << self.as_set();
+        case op_type::get:          return os << self.as_get();
+        case op_type::get_children: return os << self.as_get_children();
+        default:                    return os << self.type() << "_result{}";
     }
 }
 
@@ -309,6 +653,37 @@ std::ostream& operator<<(std::ostream& os, const multi_result& self)
     return os << ']';
 }
 
+multi_read_result::multi_read_result(std::vector<value_type> parts) noexcept :
+        _parts(std::move(parts))
+{ }
+
+multi_read_result::~multi_read_result() noexcept
+{ }
+
+std::ostream& operator<<(std::ostream& os, const multi_read_result& self)
+{
+    os << '[';
+    bool first = true;
+    for (const auto& x : self)
+    {
+        if (first)
+            first = false;
+        else
+            os << ", ";
+
+        if (x)
+            os << *x;
+        else
+            os << x.code();
+    }
+    return os << ']';
+}
+
+std::string to_string(const multi_read_result& self)
+{
+    return to_string_generic(self);
+}
+
 std::string to_string(const multi_result::part& self)
 {
     return to_string_generic(self);
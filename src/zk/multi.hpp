@@ -2,8 +2,10 @@
 
 #include <zk/config.hpp>
 
+#include <functional>
 #include <initializer_list>
 #include <iosfwd>
+#include <memory>
 #include <string>
 #include <variant>
 #include <vector>
@@ -11,7 +13,10 @@
 #include "acl.hpp"
 #include "buffer.hpp"
 #include "forwards.hpp"
+#include "outcome.hpp"
+#include "path.hpp"
 #include "results.hpp"
+#include "string_view.hpp"
 #include "types.hpp"
 
 namespace zk
@@ -23,12 +28,20 @@ namespace zk
 /// Describes the type of an \ref op.
 enum class op_type : int
 {
-    check,  //!< \ref op::check
-    create, //!< \ref op::create
-    erase,  //!< \ref op::erase
-    set,    //!< \ref op::set
+    check,        //!< \ref op::check
+    create,       //!< \ref op::create
+    erase,        //!< \ref op::erase
+    set,          //!< \ref op::set
+    get,          //!< \ref op::get
+    get_children, //!< \ref op::get_children
 };
 
+/// Is \a type one of the operations of a \ref client::read_many (as opposed to a \ref client::commit)?
+inline bool is_read(op_type type)
+{
+    return type == op_type::get || type == op_type::get_children;
+}
+
 std::ostream& operator<<(std::ostream&, const op_type&);
 
 std::string to_string(const op_type&);
@@ -48,28 +61,37 @@ public:
         op_type type() const { return op_type::check; }
     };
 
+    /// \{
     /// Check that the given \a path exists with the provided version \a check (which can be \c version::any).
     static op check(std::string path, version check = version::any());
+    static op check(zk::path path, version check = version::any());
+    /// \}
 
-    /// Data for a \ref op::create operation.
+    /// Data for a \ref op::create operation. The \c rules are held as an \ref acl_handle, so copying the operation
+    /// shares them.
     struct create_data
     {
         std::string path;
         buffer      data;
-        acl         rules;
+        acl_handle  rules;
         create_mode mode;
 
-        explicit create_data(std::string path, buffer data, acl rules, create_mode mode);
+        explicit create_data(std::string path, buffer data, acl_handle rules, create_mode mode);
 
         op_type type() const { return op_type::create; }
     };
 
     /// \{
-    /// Create a new entry at the given \a path with the \a data.
+    /// Create a new entry at the given \a path with the \a data. Passing the \a rules as an \ref acl_handle shares
+    /// their encoding instead of making one for this operation.
     ///
     /// \see client::create
     static op create(std::string path, buffer data, acl rules, create_mode mode = create_mode::normal);
+    static op create(std::string path, buffer data, acl_handle rules, create_mode mode = create_mode::normal);
     static op create(std::string path, buffer data, create_mode mode = create_mode::normal);
+    static op create(zk::path path, buffer data, acl rules, create_mode mode = create_mode::normal);
+    static op create(zk::path path, buffer data, acl_handle rules, create_mode mode = create_mode::normal);
+    static op create(zk::path path, buffer data, create_mode mode = create_mode::normal);
     /// \}
 
     /// Data for a \ref op::erase operation.
@@ -83,10 +105,13 @@ public:
         op_type type() const { return op_type::erase; }
     };
 
+    /// \{
     /// Delete the entry at the given \a path if it matches the version \a check.
     ///
     /// \see client::erase
     static op erase(std::string path, version check = version::any());
+    static op erase(zk::path path, version check = version::any());
+    /// \}
 
     /// Data for a \ref op::set operation.
     struct set_data
@@ -100,10 +125,51 @@ public:
         op_type type() const { return op_type::set; }
     };
 
+    /// \{
     /// Set the \a data for the entry at \a path if it matches the version \a check.
     ///
     /// \see client::set
     static op set(std::string path, buffer data, version check = version::any());
+    static op set(zk::path path, buffer data, version check = version::any());
+    /// \}
+
+    /// Data for a \ref op::get operation.
+    struct get_data
+    {
+        std::string path;
+
+        explicit get_data(std::string path);
+
+        op_type type() const { return op_type::get; }
+    };
+
+    /// \{
+    /// Read the data of the entry at \a path. This can only be part of a \ref client::read_many, never of a
+    /// transaction.
+    ///
+    /// \see client::get
+    static op get(std::string path);
+    static op get(zk::path path);
+    /// \}
+
+    /// Data for a \ref op::get_children operation.
+    struct get_children_data
+    {
+        std::string path;
+
+        explicit get_children_data(std::string path);
+
+        op_type type() const { return op_type::get_children; }
+    };
+
+    /// \{
+    /// Read the names of the children of the entry at \a path. Like \ref op::get, this is only for a
+    /// \ref client::read_many.
+    ///
+    /// \see client::get_children
+    static op get_children(std::string path);
+    static op get_children(zk::path path);
+    /// \}
 
 public:
     op(const op&);
@@ -137,8 +203,18 @@ public:
     /// \throws std::logic_error if the \ref type is not \ref op_type::set.
     const set_data& as_set() const;
 
+    /// Get the get-specific data.
+    ///
+    /// \throws std::logic_error if the \ref type is not \ref op_type::get.
+    const get_data& as_get() const;
+
+    /// Get the get_children-specific data.
+    ///
+    /// \throws std::logic_error if the \ref type is not \ref op_type::get_children.
+    const get_children_data& as_get_children() const;
+
 private:
-    using any_data = std::variant<check_data, create_data, erase_data, set_data>;
+    using any_data = std::variant<check_data, create_data, erase_data, set_data, get_data, get_children_data>;
 
     explicit op(any_data&&) noexcept;
 
@@ -146,6 +222,7 @@ private:
     const T& as(ptr<const char> operation) const;
 
     friend std::ostream& operator<<(std::ostream&, const op&);
+    friend class prepared_multi;
 
 private:
     any_data _storage;
@@ -238,6 +315,190 @@ std::ostream& operator<<(std::ostream&, const multi_op&);
 
 std::string to_string(const multi_op&);
 
+/// A reference to one operation of a \ref multi_op_view. Making one copies nothing, so the path, data and ACL it is
+/// made with are owned by the caller and must stay valid until the \ref client::commit it is part of returns.
+class op_view final
+{
+public:
+    /// \{
+    /// The operations of the same names in \ref op.
+    static op_view check(path_view path, version check = version::any()) noexcept;
+    static op_view create(path_view   path,
+                          string_view data,
+                          const acl&  rules,
+                          create_mode mode = create_mode::normal
+                         ) noexcept;
+    static op_view create(path_view         path,
+                          string_view       data,
+                          const acl_handle& rules,
+                          create_mode       mode = create_mode::normal
+                         ) noexcept;
+    static op_view create(path_view path, string_view data, create_mode mode = create_mode::normal) noexcept;
+    static op_view erase(path_view path, version check = version::any()) noexcept;
+    static op_view set(path_view path, string_view data, version check = version::any()) noexcept;
+    static op_view get(path_view path) noexcept;
+    static op_view get_children(path_view path) noexcept;
+    /// \}
+
+    /// View the parts of \a src, which must outlive this.
+    explicit op_view(const op& src) noexcept;
+
+    op_type type() const noexcept { return _type; }
+
+    path_view path() const noexcept { return _path; }
+
+    /// The data of a creation or a set (empty for the others).
+    string_view data() const noexcept { return _data; }
+
+    /// The ACL of a creation (\c nullptr for the others).
+    ptr<const acl> rules() const noexcept { return _rules; }
+
+    /// The handle the ACL of a creation was given as, if it was given as one (\c nullptr otherwise).
+    ptr<const acl_handle> handle() const noexcept { return _handle; }
+
+    /// The mode of a creation (\c create_mode::normal for the others).
+    create_mode mode() const noexcept { return _mode; }
+
+    /// The version a check, erase or set expects (\c version::any() for a creation or a read).
+    version check() const noexcept { return _check; }
+
+private:
+    explicit op_view(op_type               type,
+                     path_view             path,
+                     string_view           data,
+                     ptr<const acl>        rules,
+                     ptr<const acl_handle> handle,
+                     create_mode           mode,
+                     version               check
+                    ) noexcept;
+
+private:
+    op_type               _type;
+    path_view             _path;
+    string_view           _data;
+    ptr<const acl>        _rules;
+    ptr<const acl_handle> _handle;
+    create_mode           _mode;
+    version               _check;
+};
+
+std::ostream& operator<<(std::ostream&, const op_view&);
+
+/// A transaction made of \ref op_view instances, for callers which already keep the paths and data of their
+/// operations: committing one encodes what it refers to straight into the request instead of copying it into a
+/// \ref multi_op first. Clearing and refilling an instance reuses its storage, so a loop submitting transactions of
+/// about the same size stops allocating here.
+///
+/// \see client::commit
+class multi_op_view final
+{
+public:
+    using const_iterator = std::vector<op_view>::const_iterator;
+    using size_type      = std::vector<op_view>::size_type;
+
+public:
+    /// Create an empty transaction.
+    multi_op_view() noexcept
+    { }
+
+    /// Create an instance from the provided \a ops.
+    multi_op_view(std::initializer_list<op_view> ops) :
+            _ops(ops)
+    { }
+
+    /// View every operation of \a src, which must outlive this.
+    explicit multi_op_view(const multi_op& src);
+
+    size_type size() const noexcept { return _ops.size(); }
+
+    bool empty() const noexcept { return _ops.empty(); }
+
+    const op_view& operator[](size_type idx) const { return _ops[idx]; }
+
+    const_iterator begin() const noexcept { return _ops.begin(); }
+    const_iterator end()   const noexcept { return _ops.end(); }
+
+    void reserve(size_type capacity) { _ops.reserve(capacity); }
+
+    void push_back(const op_view& x) { _ops.push_back(x); }
+
+    /// Remove every operation, keeping the storage for the next transaction.
+    void clear() noexcept { _ops.clear(); }
+
+    /// Copy everything this refers to into a \ref multi_op of its own.
+    multi_op to_multi_op() const;
+
+private:
+    std::vector<op_view> _ops;
+};
+
+std::ostream& operator<<(std::ostream&, const multi_op_view&);
+
+/// A \ref multi_op which is committed over and over with only the data and versions changing, like the step of a
+/// compare-and-swap loop. The connection it is made by (see \ref client::prepare) encodes the parts which stay the same
+/// (the paths, ACLs and modes) once, so each \ref client::commit of it only binds the data and versions of an attempt.
+///
+/// An instance is not safe to rebind from one thread while another commits it, but once \ref client::commit returns,
+/// the transaction can be rebound for the next attempt (the one in flight has already taken what it needs).
+class prepared_multi final
+{
+public:
+    using size_type = multi_op::size_type;
+
+    /// The fixed parts of a transaction in the form a connection sends them in. It is made once by the connection
+    /// which prepared the transaction and only ever read after that.
+    class encoding
+    {
+    public:
+        virtual ~encoding() noexcept;
+    };
+
+    /// Makes the \ref encoding of a transaction. The operations it is given stay in place for as long as the
+    /// \ref prepared_multi does, so the encoding may point into their paths and ACLs.
+    using encoder = std::function<std::shared_ptr<const encoding> (const multi_op&)>;
+
+public:
+    /// Prepare \a txn without an encoding. Committing it costs the same as committing a copy of \a txn.
+    explicit prepared_multi(multi_op txn);
+
+    /// Prepare \a txn with the encoding \a encode makes of it.
+    prepared_multi(multi_op txn, const encoder& encode);
+
+    prepared_multi(prepared_multi&&) noexcept;
+    prepared_multi& operator=(prepared_multi&&) noexcept;
+
+    ~prepared_multi() noexcept;
+
+    /// The number of operations in the transaction.
+    size_type size() const { return _txn->size(); }
+
+    /// The operations as they will be committed, with the data and versions last bound.
+    const multi_op& ops() const { return *_txn; }
+
+    /// The encoding the preparing connection made (\c nullptr if it did not make one).
+    const std::shared_ptr<const encoding>& encoded() const { return _encoding; }
+
+    /// Replace the data of the \ref op::create or \ref op::set at \a idx.
+    ///
+    /// \throws std::out_of_range if \a idx is not less than \ref size.
+    /// \throws std::invalid_argument if the operation at \a idx has no data.
+    void bind_data(size_type idx, buffer data);
+
+    /// Replace the version the \ref op::check, \ref op::erase or \ref op::set at \a idx expects.
+    ///
+    /// \throws std::out_of_range if \a idx is not less than \ref size.
+    /// \throws std::invalid_argument if the operation at \a idx does not check a version.
+    void bind_version(size_type idx, version check);
+
+private:
+    op& at(size_type idx);
+
+private:
+    // Behind a pointer so the paths and ACLs the encoding points into do not move with this instance
+    std::unique_ptr<multi_op>       _txn;
+    std::shared_ptr<const encoding> _encoding;
+};
+
 /// The result of a successful \ref client::commit operation.
 class multi_result final
 {
@@ -249,6 +510,8 @@ public:
         explicit part(op_type, std::nullptr_t) noexcept;
         explicit part(create_result) noexcept;
         explicit part(set_result) noexcept;
+        explicit part(get_result) noexcept;
+        explicit part(get_children_result) noexcept;
 
         part(const part&);
         part(part&&) noexcept;
@@ -271,8 +534,18 @@ public:
         /// \throws std::logic_error if the \ref type is not \ref op_type::set.
         const set_result& as_set() const;
 
+        /// Get the result of an \ref op::get.
+        ///
+        /// \throws std::logic_error if the \ref type is not \ref op_type::get.
+        const get_result& as_get() const;
+
+        /// Get the result of an \ref op::get_children.
+        ///
+        /// \throws std::logic_error if the \ref type is not \ref op_type::get_children.
+        const get_children_result& as_get_children() const;
+
     private:
-        using any_result = std::variant<std::monostate, create_result, set_result>;
+        using any_result = std::variant<std::monostate, create_result, set_result, get_result, get_children_result>;
 
         template <typename T>
         const T& as(ptr<const char> operation) const;
@@ -352,6 +625,69 @@ private:
 std::ostream& operator<<(std::ostream&, const multi_result::part&);
 std::ostream& operator<<(std::ostream&, const multi_result&);
 
+/// The result of a successful \ref client::read_many: part \c i is the outcome of operation \c i of the request.
+/// Unlike a transaction, the reads succeed or fail on their own, so one missing entry leaves the others be.
+class multi_read_result final
+{
+public:
+    using value_type     = outcome<multi_result::part>;
+    using iterator       = std::vector<value_type>::iterator;
+    using const_iterator = std::vector<value_type>::const_iterator;
+    using size_type      = std::vector<value_type>::size_type;
+
+public:
+    multi_read_result() noexcept
+    { }
+
+    multi_read_result(std::vector<value_type> parts) noexcept;
+
+    ~multi_read_result() noexcept;
+
+    /// The number of reads in the request.
+    size_type size() const { return _parts.size(); }
+
+    /// \{
+    /// Get the outcome of the read at the given \a idx.
+    value_type&       operator[](size_type idx)       { return _parts[idx]; }
+    const value_type& operator[](size_type idx) const { return _parts[idx]; }
+    /// \}
+
+    /// \{
+    /// Get the outcome of the read at the given \a idx.
+    ///
+    /// \throws std::out_of_range if \a idx is larger than \ref size.
+    const value_type& at(size_type idx) const { return _parts.at(idx); }
+    value_type&       at(size_type idx)       { return _parts.at(idx); }
+    /// \}
+
+    /// \{
+    /// Iterate through the outcomes in the order of the reads of the request.
+    iterator begin()              { return _parts.begin(); }
+    const_iterator begin() const  { return _parts.begin(); }
+    const_iterator cbegin() const { return _parts.begin(); }
+    iterator end()                { return _parts.end(); }
+    const_iterator end() const    { return _parts.end(); }
+    const_iterator cend() const   { return _parts.end(); }
+    /// \}
+
+    /// Increase the reserved memory block so it can store at least \a capacity outcomes without reallocating.
+    void reserve(size_type capacity) { _parts.reserve(capacity); }
+
+    /// Construct an outcome in place at the end of the list using \a args.
+    template <typename... TArgs>
+    void emplace_back(TArgs&&... args)
+    {
+        _parts.emplace_back(std::forward<TArgs>(args)...);
+    }
+
+private:
+    std::vector<value_type> _parts;
+};
+
+std::ostream& operator<<(std::ostream&, const multi_read_result&);
+
+std::string to_string(const multi_read_result&);
+
 std::string to_string(const multi_result::part&);
 std::string to_string(const multi_result&);
 
@@ -4,8 +4,15 @@
 #include <chrono>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "client.hpp"
+#include "detail/native.hpp"
 #include "error.hpp"
 #include "multi.hpp"
 #include "string_view.hpp"
@@ -73,4 +80,223 @@ GTEST_TEST_F(multi_tests, commit_fail_check)
     }
 }
 
+GTEST_TEST_F(multi_tests, commit_prepared_compare_and_swap)
+{
+    client c = get_connected_client();
+
+    auto counter = c.create("/test-", buffer_from("0"), create_mode::sequential).get().name();
+    auto txn     = c.prepare({ op::check("/"), op::set(counter, buffer_from("0"), version(0)) });
+
+    for (int value = 1; value <= 3; ++value)
+    {
+        auto current = c.get(counter).get().stat().data_version;
+        txn.bind_version(1U, current);
+        txn.bind_data(1U, buffer_from(std::to_string(value)));
+        auto res = c.commit(txn).get();
+        CHECK_EQ(++current, res[1].as_set().stat().data_version);
+    }
+    CHECK_TRUE(c.get(counter).get().data() == buffer_from("3"));
+
+    // A stale version fails the whole transaction, as it would without preparing
+    txn.bind_version(1U, version(0));
+    try
+    {
+        c.commit(txn).get();
+        CHECK_FAIL() << "Committing a stale version should have failed";
+    }
+    catch (const transaction_failed& ex)
+    {
+        CHECK_EQ(error_code::version_mismatch, ex.underlying_cause());
+        CHECK_EQ(1U, ex.failed_op_index());
+    }
+}
+
+template <typename T>
+static std::string streamed(const T& src)
+{
+    std::ostringstream os;
+    os << src;
+    return os.str();
+}
+
+GTEST_TEST(prepared_multi_tests, bind)
+{
+    prepared_multi txn({ op::check("/a", version(1)),
+                         op::create("/b", buffer_from("b"), acls::open_unsafe()),
+                         op::erase("/c", version(2)),
+                         op::set("/d", buffer_from("d"), version(3)),
+                       });
+    CHECK_TRUE(txn.encoded() == nullptr);
+
+    txn.bind_version(0U, version(10));
+    txn.bind_data(1U, buffer_from("b2"));
+    txn.bind_version(2U, version(20));
+    txn.bind_data(3U, buffer_from("d2"));
+    txn.bind_version(3U, version(30));
+
+    CHECK_EQ(version(10), txn.ops()[0].as_check().check);
+    CHECK_TRUE(buffer_from("b2") == txn.ops()[1].as_create().data);
+    CHECK_EQ(version(20), txn.ops()[2].as_erase().check);
+    CHECK_TRUE(buffer_from("d2") == txn.ops()[3].as_set().data);
+    CHECK_EQ(version(30), txn.ops()[3].as_set().check);
+
+    CHECK_THROWS(std::invalid_argument) { txn.bind_data(0U, buffer_from("x")); };
+    CHECK_THROWS(std::invalid_argument) { txn.bind_version(1U, version(1)); };
+    CHECK_THROWS(std::out_of_range) { txn.bind_version(4U, version(1)); };
+
+    // The paths stay where they are when the instance moves, since an encoding can point into them
+    auto path_storage = txn.ops()[3].as_set().path.data();
+    auto moved        = std::move(txn);
+    CHECK_EQ(path_storage, moved.ops()[3].as_set().path.data());
+}
+
+GTEST_TEST(prepared_multi_tests, native_encoding_large)
+{
+    // Far more than would have fit the stack when the encoding was made there
+    acl rules;
+    for (int idx = 0; idx < 20; ++idx)
+        rules.emplace_back("digest", "user-" + std::to_string(idx) + ":hash", permission::all);
+
+    std::vector<op> ops;
+    for (std::size_t idx = 0U; idx < 5000U; ++idx)
+    {
+        auto path = "/txn/entry-" + std::to_string(idx);
+        switch (idx % 4U)
+        {
+        case 0U: ops.emplace_back(op::create(path, buffer_from("c"), rules, create_mode::sequential)); break;
+        case 1U: ops.emplace_back(op::set(path, buffer_from("s"), version(1))); break;
+        case 2U: ops.emplace_back(op::check(path, version(2))); break;
+        default: ops.emplace_back(op::erase(path)); break;
+        }
+    }
+
+    prepared_multi txn(multi_op(std::move(ops)),
+                       [] (const multi_op& src) { return std::make_shared<const multi_op_encoding>(src); }
+                      );
+    auto encoding = std::dynamic_pointer_cast<const multi_op_encoding>(txn.encoded());
+    CHECK_TRUE(encoding != nullptr);
+    CHECK_EQ(5000U, encoding->size());
+    CHECK_EQ(op_type::erase, encoding->type(4999U));
+
+    auto buffers = encoding->make_buffers();
+    CHECK_EQ(5000U, buffers.raw_results.size());
+    CHECK_EQ(1250U, buffers.raw_stats.size());
+    CHECK_TRUE(encoding->bind(txn.ops(), buffers) == buffers.raw_ops.data());
+
+    txn.bind_data(1U, buffer(100000U, 'x'));
+    CHECK_TRUE(encoding->bind(txn.ops(), buffers) == buffers.raw_ops.data());
+    CHECK_THROWS(std::logic_error) { encoding->bind(multi_op({ op::check("/") }), buffers); };
+
+    // The plain helpers move to the heap past what they keep on the stack
+    std::string long_path(100000U, 'p');
+    CHECK_EQ(long_path.size(), with_str(string_view(long_path), [] (ptr<const char> p) { return std::strlen(p); }));
+    acl many(std::vector<acl_rule>(1000U, acl_rule("world", "anyone", permission::read)));
+    CHECK_EQ(1000, with_acl(many, [] (ptr<ACL_vector> vec) { return vec->count; }));
+}
+
+GTEST_TEST(multi_op_view_tests, views_and_copies)
+{
+    const std::string text = "/first/second";
+    const buffer      data = buffer_from("payload");
+    const acl         rules = acls::read_unsafe();
+
+    multi_op_view txn;
+    txn.reserve(4U);
+    txn.push_back(op_view::check(string_view(text).substr(0U, 6U), version(1)));
+    txn.push_back(op_view::create(text, string_view(data.data(), data.size()), rules, create_mode::ephemeral));
+    txn.push_back(op_view::erase("/gone"));
+    txn.push_back(op_view::set(text, "new", version(4)));
+    CHECK_EQ(4U, txn.size());
+
+    // Nothing is copied into the view
+    CHECK_EQ(text.data(), txn[0].path().data());
+    CHECK_FALSE(txn[0].path().is_terminated());
+    CHECK_EQ(data.data(), txn[1].data().data());
+    CHECK_EQ(&rules, txn[1].rules());
+    CHECK_TRUE(txn[2].rules() == nullptr);
+
+    auto owned = txn.to_multi_op();
+    CHECK_EQ("/first", owned[0].as_check().path);
+    CHECK_EQ(version(1), owned[0].as_check().check);
+    CHECK_TRUE(data == owned[1].as_create().data);
+    CHECK_EQ(rules, owned[1].as_create().rules);
+    CHECK_EQ(create_mode::ephemeral, owned[1].as_create().mode);
+    CHECK_EQ(version::any(), owned[2].as_erase().check);
+    CHECK_TRUE(buffer_from("new") == owned[3].as_set().data);
+
+    // Viewing the copy gives back the same operations
+    multi_op_view round_trip(owned);
+    CHECK_EQ(streamed(owned), streamed(round_trip));
+    CHECK_EQ(owned[3].as_set().path.data(), round_trip[3].path().data());
+
+    txn.clear();
+    CHECK_TRUE(txn.empty());
+}
+
+GTEST_TEST(multi_op_view_tests, reads)
+{
+    multi_op reads{ op::get("/data"), op::get_children(zk::path("/parent")) };
+    CHECK_TRUE(is_read(reads[0].type()));
+    CHECK_EQ("/parent", reads[1].as_get_children().path);
+    CHECK_THROWS(std::logic_error) { reads[0].as_set(); };
+    CHECK_EQ("[get{/data}, get_children{/parent}]", streamed(reads));
+
+    multi_op_view viewed(reads);
+    CHECK_EQ(op_type::get_children, viewed[1].type());
+    CHECK_EQ(streamed(reads), streamed(viewed));
+    CHECK_EQ(streamed(reads), streamed(viewed.to_multi_op()));
+
+    // The C client has no reads in a multi
+    CHECK_THROWS(std::invalid_argument) { multi_op_encoding encoded(reads); };
+}
+
+GTEST_TEST(multi_op_view_tests, native_encoding_copies_unterminated_paths)
+{
+    const std::string text = "/entry-1/entry-2";
+    multi_op_view txn = { op_view::set(string_view(text).substr(0U, 8U), "data"),
+                          op_view::create(text, "", create_mode::sequential),
+                        };
+
+    multi_op_encoding encoding(txn);
+    auto buffers = encoding.make_buffers();
+    CHECK_EQ(1U, buffers.raw_stats.size());
+    CHECK_EQ(text.size() + 12U, buffers.path_buffers.size());
+    CHECK_TRUE(encoding.bind(txn, buffers) == buffers.raw_ops.data());
+
+    // The shape has to match the transaction it is bound to
+    multi_op_view reordered = { txn[1], txn[0] };
+    CHECK_THROWS(std::logic_error) { encoding.bind(reordered, buffers); };
+}
+
+GTEST_TEST(multi_op_view_tests, acl_handles_are_shared)
+{
+    const auto rules = acl_handle::intern(acls::creator_all());
+
+    // Copying the operation, viewing it and copying the view keep the one encoding
+    auto created = op::create("/with-handle", buffer_from("x"), rules);
+    auto copied  = created;
+    CHECK_EQ(rules.native(), copied.as_create().rules.native());
+
+    op_view view(copied);
+    CHECK_TRUE(view.handle() != nullptr);
+    CHECK_EQ(rules.native(), view.handle()->native());
+    CHECK_EQ(&view.handle()->rules(), view.rules());
+
+    multi_op_view txn = { view, op_view::create("/plain", "", acls::read_unsafe()) };
+    CHECK_TRUE(txn[1].handle() == nullptr);
+    auto owned = txn.to_multi_op();
+    CHECK_EQ(rules.native(), owned[0].as_create().rules.native());
+    CHECK_EQ(acls::read_unsafe(), owned[1].as_create().rules);
+
+    // Entries created without an ACL all share the interned open one
+    auto first  = op::create("/a", buffer());
+    auto second = op::create(zk::path("/b"), buffer());
+    CHECK_EQ(first.as_create().rules.native(), second.as_create().rules.native());
+    CHECK_EQ(acl_handle::intern(acls::open_unsafe()).native(), first.as_create().rules.native());
+
+    multi_op_encoding encoding(txn);
+    auto buffers = encoding.make_buffers();
+    CHECK_TRUE(encoding.bind(txn, buffers) == buffers.raw_ops.data());
+}
+
 }
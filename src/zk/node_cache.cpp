@@ -0,0 +1,263 @@
+#include "node_cache.hpp"
+#include "error.hpp"
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// node_cache::entry                                                                                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// An entry is \c loading from the time the first read of a path is submitted until the server answers; reads which
+/// arrive in the meantime wait in \c waiters. The identity of the entry is what the watch callbacks hold on to, so an
+/// event for an entry which has already been replaced does not drop its replacement.
+struct node_cache::entry final
+{
+    enum class kind
+    {
+        loading,
+        present,
+        absent,
+    };
+
+    kind                              status = kind::loading;
+    optional<get_result>              value;
+    std::vector<callback<get_result>> waiters;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// node_cache::state                                                                                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The state is shared with the outstanding operations. Completions hold it strongly, since they are guaranteed to be
+/// delivered; watch events only hold it weakly, as they might not fire for the life of the connection.
+struct node_cache::state final :
+        std::enable_shared_from_this<node_cache::state>
+{
+    using entry_map = std::map<std::string, std::shared_ptr<entry>, std::less<>>;
+
+    explicit state(client conn) :
+            conn(std::move(conn))
+    { }
+
+    void get(path_view path, callback<get_result> on_complete)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        auto iter = entries.find(path.view());
+        if (iter != entries.end())
+        {
+            auto& found = *iter->second;
+            switch (found.status)
+            {
+            case entry::kind::present:
+            {
+                auto value = *found.value;
+                ax.unlock();
+                on_complete(std::move(value));
+                return;
+            }
+            case entry::kind::absent:
+                ax.unlock();
+                on_complete(error_code::no_entry);
+                return;
+            case entry::kind::loading:
+                found.waiters.emplace_back(std::move(on_complete));
+                return;
+            }
+        }
+
+        auto created = std::make_shared<entry>();
+        created->waiters.emplace_back(std::move(on_complete));
+        auto key = entries.emplace(std::string(path.view()), created).first->first;
+        ax.unlock();
+
+        load(std::move(key), std::move(created));
+    }
+
+    void load(std::string key, std::shared_ptr<entry> target)
+    {
+        auto self = shared_from_this();
+        conn.watch(key,
+                   [self, key, target] (outcome<watch_result> result)
+                   {
+                       self->on_data(key, target, std::move(result));
+                   },
+                   on_event_for(key, target)
+                  );
+    }
+
+    void on_data(const std::string& key, const std::shared_ptr<entry>& target, outcome<watch_result> result)
+    {
+        if (result)
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            target->status = entry::kind::present;
+            target->value.emplace(std::move(*result).initial());
+            // Every reader of the value gets a view of the same data rather than a copy of it
+            target->value->share();
+            auto value   = *target->value;
+            auto waiters = std::exchange(target->waiters, {});
+            ax.unlock();
+
+            for (auto& waiter : waiters)
+                waiter(value);
+        }
+        else if (result.code() == error_code::no_entry)
+        {
+            // A data watch is only left on entries which exist, so watch for the creation instead
+            auto self = shared_from_this();
+            conn.watch_exists(key,
+                              [self, key, target] (outcome<watch_exists_result> result)
+                              {
+                                  self->on_exists(key, target, std::move(result));
+                              },
+                              on_event_for(key, target)
+                             );
+        }
+        else
+        {
+            fail(key, target, result.code());
+        }
+    }
+
+    void on_exists(const std::string& key, const std::shared_ptr<entry>& target, outcome<watch_exists_result> result)
+    {
+        if (!result)
+        {
+            fail(key, target, result.code());
+        }
+        else if (result->initial())
+        {
+            // Created between the two reads; the exists watch will still drop the entry on the next change
+            load(key, target);
+        }
+        else
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            target->status = entry::kind::absent;
+            auto waiters = std::exchange(target->waiters, {});
+            ax.unlock();
+
+            for (auto& waiter : waiters)
+                waiter(error_code::no_entry);
+        }
+    }
+
+    void fail(const std::string& key, const std::shared_ptr<entry>& target, error_code rc)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        erase_if_current(key, target);
+        auto waiters = std::exchange(target->waiters, {});
+        ax.unlock();
+
+        for (auto& waiter : waiters)
+            waiter(rc);
+    }
+
+    event_callback on_event_for(const std::string& key, const std::shared_ptr<entry>& target)
+    {
+        std::weak_ptr<state> weak_self = shared_from_this();
+        std::weak_ptr<entry> weak_target = target;
+        return [weak_self, weak_target, key] (const event&)
+               {
+                   auto self   = weak_self.lock();
+                   auto target = weak_target.lock();
+                   if (self && target)
+                   {
+                       std::unique_lock<std::mutex> ax(self->protect);
+                       self->erase_if_current(key, target);
+                   }
+               };
+    }
+
+    /// \pre \c protect is held.
+    void erase_if_current(const std::string& key, const std::shared_ptr<entry>& target)
+    {
+        auto iter = entries.find(key);
+        if (iter != entries.end() && iter->second == target)
+            entries.erase(iter);
+    }
+
+    client             conn;
+    mutable std::mutex protect;
+    entry_map          entries;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// node_cache                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+node_cache::node_cache(client conn) :
+        _state(std::make_shared<state>(std::move(conn)))
+{ }
+
+node_cache::~node_cache() noexcept = default;
+
+future<get_result> node_cache::get(path_view path)
+{
+    return future_from_callback<get_result>([&] (auto cb) { this->get(path, std::move(cb)); });
+}
+
+void node_cache::get(path_view path, callback<get_result> on_complete)
+{
+    _state->get(path, std::move(on_complete));
+}
+
+future<exists_result> node_cache::exists(path_view path)
+{
+    return future_from_callback<exists_result>([&] (auto cb) { this->exists(path, std::move(cb)); });
+}
+
+void node_cache::exists(path_view path, callback<exists_result> on_complete)
+{
+    _state->get(path,
+                [on_complete = std::move(on_complete)] (outcome<get_result> result)
+                {
+                    if (result)
+                        on_complete(exists_result(result->stat()));
+                    else if (result.code() == error_code::no_entry)
+                        on_complete(exists_result(nullopt));
+                    else
+                        on_complete(outcome<exists_result>(result.code(), result.error()));
+                }
+               );
+}
+
+void node_cache::invalidate(path_view path)
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    auto iter = _state->entries.find(path.view());
+    if (iter != _state->entries.end() && iter->second->status != entry::kind::loading)
+        _state->entries.erase(iter);
+}
+
+void node_cache::clear()
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    for (auto iter = _state->entries.begin(); iter != _state->entries.end(); )
+    {
+        if (iter->second->status == entry::kind::loading)
+            ++iter;
+        else
+            iter = _state->entries.erase(iter);
+    }
+}
+
+std::size_t node_cache::size() const
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    std::size_t count = 0U;
+    for (const auto& pair : _state->entries)
+        if (pair.second->status != entry::kind::loading)
+            ++count;
+    return count;
+}
+
+}
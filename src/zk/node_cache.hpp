@@ -0,0 +1,90 @@
+/// \file
+/// Defines \ref zk::node_cache, a local cache of entries kept up to date by watches.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <cstddef>
+#include <memory>
+
+#include "callback.hpp"
+#include "client.hpp"
+#include "forwards.hpp"
+#include "future.hpp"
+#include "path.hpp"
+#include "results.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// A local cache of entries which are read far more often than they are written, such as configuration. The first read
+/// of a path goes to ZooKeeper and leaves a watch behind; every later read is served from memory until the watch
+/// triggers, at which point the cached value is dropped and the next read fetches it again.
+///
+/// Paths which do not exist are cached as well: reading a missing entry leaves a \ref client::watch_exists watch, so
+/// repeated \ref get calls for it fail with \ref no_entry without going to the server until the entry is created.
+///
+/// \code
+/// zk::node_cache cache(client);
+/// auto primary = cache.get("/app/config/primary").get();  // fetched from the server
+/// auto again   = cache.get("/app/config/primary").get();  // served from memory
+/// \endcode
+///
+/// Cached values are kept shared (see \ref get_result::share), so every read of one gets a view of the same data
+/// instead of a copy. Concurrent reads of a path which is not yet cached share a single fetch. Since the value is only dropped when the
+/// watch event is delivered, a cached read can be behind the server by the time it takes for that event to arrive --
+/// the same guarantee a watch gives. Any event for a path (including session events on a connection loss) drops its
+/// cached value, so nothing stale is kept after a reconnect.
+///
+/// The callback forms of \ref get and \ref exists complete on the calling thread when the value is cached and on the
+/// ZooKeeper completion thread when it is not; see \ref callback for what that implies.
+class node_cache final
+{
+public:
+    /// Create an empty cache which reads through \a conn.
+    explicit node_cache(client conn);
+
+    node_cache(const node_cache&) = delete;
+    node_cache& operator=(const node_cache&) = delete;
+
+    /// Destroying the cache does not cancel reads in progress; they are still completed.
+    ~node_cache() noexcept;
+
+    /// \{
+    /// Get the data and \ref stat of the entry at \a path, from memory if it is cached.
+    ///
+    /// \throws no_entry If no entry exists at the given \a path.
+    future<get_result> get(path_view path);
+    void get(path_view path, callback<get_result> on_complete);
+    /// \}
+
+    /// \{
+    /// Get the \ref stat of the entry at \a path or \c nullopt if it does not exist. A path which is not cached is
+    /// loaded the same way \ref get loads it, so a later \ref get of the same path is served from memory.
+    future<exists_result> exists(path_view path);
+    void exists(path_view path, callback<exists_result> on_complete);
+    /// \}
+
+    /// Drop the cached value of \a path (if there is one). The next read of \a path will go to the server.
+    void invalidate(path_view path);
+
+    /// Drop every cached value.
+    void clear();
+
+    /// The number of paths with a cached value (including cached absences). Reads in progress are not counted.
+    std::size_t size() const;
+
+private:
+    struct entry;
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// \}
+
+}
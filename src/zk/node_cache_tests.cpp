@@ -0,0 +1,93 @@
+#include <zk/server/server_tests.hpp>
+
+#include <chrono>
+#include <thread>
+
+#include "client.hpp"
+#include "error.hpp"
+#include "node_cache.hpp"
+#include "string_view.hpp"
+
+namespace zk
+{
+
+static buffer buffer_from(string_view str)
+{
+    return buffer(str.data(), str.data() + str.size());
+}
+
+/// Watch events are delivered asynchronously, so wait for the cache to notice.
+template <typename FPredicate>
+static bool eventually(FPredicate&& pred)
+{
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        if (pred())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return pred();
+}
+
+class node_cache_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(node_cache_tests, get_then_hit)
+{
+    client     c = get_connected_client();
+    node_cache cache(c);
+    c.create("/cache-hit", buffer_from("first")).get();
+
+    CHECK_EQ(0U, cache.size());
+    CHECK_TRUE(cache.get("/cache-hit").get().data() == buffer_from("first"));
+    CHECK_EQ(1U, cache.size());
+    CHECK_TRUE(cache.get("/cache-hit").get().data() == buffer_from("first"));
+    CHECK_TRUE(cache.exists("/cache-hit").get());
+}
+
+GTEST_TEST_F(node_cache_tests, change_invalidates)
+{
+    client     c = get_connected_client();
+    node_cache cache(c);
+    c.create("/cache-change", buffer_from("first")).get();
+
+    CHECK_TRUE(cache.get("/cache-change").get().data() == buffer_from("first"));
+    c.set("/cache-change", buffer_from("second")).get();
+    CHECK_TRUE(eventually([&] { return cache.size() == 0U; }));
+    CHECK_TRUE(cache.get("/cache-change").get().data() == buffer_from("second"));
+}
+
+GTEST_TEST_F(node_cache_tests, negative_entry)
+{
+    client     c = get_connected_client();
+    node_cache cache(c);
+
+    CHECK_THROWS(no_entry)
+    {
+        cache.get("/cache-missing").get();
+    };
+    CHECK_EQ(1U, cache.size());
+    CHECK_FALSE(cache.exists("/cache-missing").get());
+
+    c.create("/cache-missing", buffer_from("now here")).get();
+    CHECK_TRUE(eventually([&] { return cache.size() == 0U; }));
+    CHECK_TRUE(cache.get("/cache-missing").get().data() == buffer_from("now here"));
+}
+
+GTEST_TEST_F(node_cache_tests, invalidate_and_clear)
+{
+    client     c = get_connected_client();
+    node_cache cache(c);
+    c.create("/cache-a", buffer_from("a")).get();
+
+    cache.get("/cache-a").get();
+    cache.exists("/cache-b").get();
+    CHECK_EQ(2U, cache.size());
+    cache.invalidate("/cache-a");
+    CHECK_EQ(1U, cache.size());
+    cache.clear();
+    CHECK_EQ(0U, cache.size());
+}
+
+}
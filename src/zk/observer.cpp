@@ -0,0 +1,8 @@
+#include "observer.hpp"
+
+namespace zk
+{
+
+connection_observer::~connection_observer() noexcept = default;
+
+}
@@ -0,0 +1,79 @@
+/// \file
+/// Defines \ref zk::connection_observer, the hook for tracing individual requests.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <chrono>
+#include <cstddef>
+
+#include "forwards.hpp"
+#include "metrics.hpp"
+#include "string_view.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// Receives a call when each request made through a \ref connection is submitted and when it completes. Where
+/// \ref connection_metrics aggregates, an observer sees every request on its own, which is what attributing a slow call
+/// to the work that made it requires.
+///
+/// The pointer returned from \ref on_submit is handed back to the matching \ref on_complete, so an observer can carry a
+/// span (or anything else) from one to the other without a lookup table:
+///
+/// \code
+/// class span_observer final : public zk::connection_observer
+/// {
+///     ptr<void> on_submit(zk::request_type type, string_view path, std::size_t) noexcept override
+///     {
+///         return new span(tracer.start_span(to_string(type), { { "zk.path", std::string(path) } }));
+///     }
+///
+///     void on_complete(zk::request_type, string_view, zk::error_code rc, duration, ptr<void> context)
+///         noexcept override
+///     {
+///         std::unique_ptr<span> s(static_cast<ptr<span>>(context));
+///         if (rc != zk::error_code::ok)
+///             s->set_status(to_string(rc));
+///         s->end();
+///     }
+/// };
+///
+/// zk::connection_params params = zk::connection_params::parse("zk://localhost:2181/");
+/// params.observer() = std::make_shared<span_observer>();
+/// \endcode
+///
+/// Both functions are called on whichever thread submits or completes the request -- the thread-safety of the observer
+/// is up to it. They are called inline with the request, so they should be quick, and they must not throw. When no
+/// observer is set, the cost to a request is a single null check.
+class connection_observer
+{
+public:
+    using duration = std::chrono::steady_clock::duration;
+
+public:
+    virtual ~connection_observer() noexcept;
+
+    /// A request of \a type for \a path was submitted, carrying \a payload_size bytes of paths and data. Batches and
+    /// transactions have an empty \a path.
+    ///
+    /// \returns The context to give to the \ref on_complete of this request; \c nullptr is fine.
+    virtual ptr<void> on_submit(request_type type, string_view path, std::size_t payload_size) noexcept = 0;
+
+    /// The request of \a type for \a path which was submitted \a latency ago finished with \a rc. This is called
+    /// exactly once for each call to \ref on_submit, including for requests which are cancelled when the connection is
+    /// closed (with \ref error_code::closed).
+    virtual void on_complete(request_type type,
+                             string_view  path,
+                             error_code   rc,
+                             duration     latency,
+                             ptr<void>    context
+                            ) noexcept = 0;
+};
+
+/// \}
+
+}
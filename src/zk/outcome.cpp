@@ -0,0 +1,24 @@
+#include "outcome.hpp"
+
+#include <ostream>
+
+namespace zk
+{
+
+std::ostream& operator<<(std::ostream& os, const outcome<void>& x)
+{
+    if (x)
+        return os << "ok";
+    else
+        return os << "error{" << x.code() << '}';
+}
+
+std::string to_string(const outcome<void>& x)
+{
+    if (x)
+        return "ok";
+    else
+        return "error{" + to_string(x.code()) + '}';
+}
+
+}
@@ -0,0 +1,196 @@
+/// \file
+/// Defines \ref zk::outcome, the value delivered to completion callbacks.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <exception>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "error.hpp"
+#include "optional.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// The outcome of an asynchronous \ref client operation: either the \c TResult it produced or the \ref error_code which
+/// prevented it from completing. This is what is handed to a \ref callback when the operation finishes; unlike a
+/// \c future, inspecting the failure does not require throwing (and catching) an exception.
+///
+/// \code
+/// client.get("/some/path",
+///            [] (zk::outcome<zk::get_result> res)
+///            {
+///                if (res)
+///                    process(res->data());
+///                else if (res.code() != zk::error_code::no_entry)
+///                    log_failure(res.code());
+///            }
+///           );
+/// \endcode
+template <typename TResult>
+class outcome final
+{
+public:
+    using value_type = TResult;
+
+public:
+    /// Create a successful outcome holding \a value.
+    outcome(value_type value) noexcept(std::is_nothrow_move_constructible<value_type>::value) :
+            _code(error_code::ok),
+            _value(std::move(value))
+    { }
+
+    /// Create a failed outcome from the \a code. If the failure has more information than the code alone (such as the
+    /// index of the failed operation in a \ref transaction_failed), the original exception is provided as \a cause.
+    ///
+    /// \pre \a code is not \ref error_code::ok.
+    outcome(error_code code, std::exception_ptr cause = nullptr) noexcept :
+            _code(code),
+            _cause(std::move(cause))
+    { }
+
+    /// \{
+    /// Did the operation succeed?
+    bool has_value() const noexcept   { return _code == error_code::ok; }
+    explicit operator bool() const    { return has_value(); }
+    bool operator!() const            { return !has_value(); }
+    /// \}
+
+    /// The \ref error_code the operation failed with or \ref error_code::ok if it succeeded.
+    error_code code() const noexcept { return _code; }
+
+    /// Get the failure as an exception pointer suitable for \c std::rethrow_exception or \c promise::set_exception. If
+    /// the operation succeeded, this is \c nullptr.
+    std::exception_ptr error() const
+    {
+        if (has_value())
+            return nullptr;
+        else if (_cause)
+            return _cause;
+        else
+            return get_exception_ptr_of(_code);
+    }
+
+    /// \{
+    /// Get the result of the operation.
+    ///
+    /// \throws error If the operation did not succeed, the \ref error it failed with is thrown (see \ref error for the
+    ///  exact type).
+    const value_type& value() const & { check(); return *_value; }
+    value_type&       value() &       { check(); return *_value; }
+    value_type        value() &&      { check(); return std::move(*_value); }
+    /// \}
+
+    /// \{
+    /// Access the result of the operation without checking that it succeeded.
+    ///
+    /// \pre \c has_value() is \c true.
+    const value_type& operator*() const & { return *_value; }
+    value_type&       operator*() &       { return *_value; }
+    value_type        operator*() &&      { return std::move(*_value); }
+
+    const value_type* operator->() const { return &*_value; }
+    value_type*       operator->()       { return &*_value; }
+    /// \}
+
+private:
+    void check() const
+    {
+        if (_cause)
+            std::rethrow_exception(_cause);
+        else if (!has_value())
+            throw_error(_code);
+    }
+
+private:
+    error_code           _code;
+    std::exception_ptr   _cause;
+    optional<value_type> _value;
+};
+
+/// The outcome of an operation which does not produce a value (for example: \ref client::erase). A default-constructed
+/// instance is successful.
+template <>
+class outcome<void> final
+{
+public:
+    using value_type = void;
+
+public:
+    /// Create a successful outcome.
+    outcome() noexcept :
+            _code(error_code::ok)
+    { }
+
+    /// Create a failed outcome from the \a code with an optional \a cause.
+    ///
+    /// \pre \a code is not \ref error_code::ok.
+    outcome(error_code code, std::exception_ptr cause = nullptr) noexcept :
+            _code(code),
+            _cause(std::move(cause))
+    { }
+
+    bool has_value() const noexcept   { return _code == error_code::ok; }
+    explicit operator bool() const    { return has_value(); }
+    bool operator!() const            { return !has_value(); }
+
+    error_code code() const noexcept { return _code; }
+
+    std::exception_ptr error() const
+    {
+        if (has_value())
+            return nullptr;
+        else if (_cause)
+            return _cause;
+        else
+            return get_exception_ptr_of(_code);
+    }
+
+    /// Throw the \ref error the operation failed with. If it succeeded, this does nothing.
+    void value() const
+    {
+        if (_cause)
+            std::rethrow_exception(_cause);
+        else if (!has_value())
+            throw_error(_code);
+    }
+
+private:
+    error_code         _code;
+    std::exception_ptr _cause;
+};
+
+template <typename TResult>
+std::ostream& operator<<(std::ostream& os, const outcome<TResult>& x)
+{
+    if (x)
+        return os << *x;
+    else
+        return os << "error{" << x.code() << '}';
+}
+
+std::ostream& operator<<(std::ostream&, const outcome<void>&);
+
+template <typename TResult>
+std::string to_string(const outcome<TResult>& x)
+{
+    using std::to_string;
+
+    if (x)
+        return to_string(*x);
+    else
+        return "error{" + to_string(x.code()) + '}';
+}
+
+std::string to_string(const outcome<void>&);
+
+/// \}
+
+}
@@ -0,0 +1,128 @@
+#include <zk/tests/test.hpp>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "callback.hpp"
+#include "error.hpp"
+#include "outcome.hpp"
+
+namespace zk
+{
+
+GTEST_TEST(outcome_tests, value)
+{
+    outcome<int> x = 5;
+    CHECK_TRUE(x);
+    CHECK_EQ(error_code::ok, x.code());
+    CHECK_EQ(5, x.value());
+    CHECK_EQ(5, *x);
+    CHECK_FALSE(x.error());
+    CHECK_EQ("5", to_string(x));
+}
+
+GTEST_TEST(outcome_tests, error)
+{
+    outcome<int> x = error_code::no_entry;
+    CHECK_FALSE(x);
+    CHECK_EQ(error_code::no_entry, x.code());
+    CHECK_THROWS(no_entry)
+    {
+        x.value();
+    };
+    CHECK_THROWS(no_entry)
+    {
+        std::rethrow_exception(x.error());
+    };
+}
+
+GTEST_TEST(outcome_tests, error_with_cause)
+{
+    outcome<int> x(error_code::transaction_failed,
+                   std::make_exception_ptr(transaction_failed(error_code::version_mismatch, 2U))
+                  );
+    CHECK_EQ(error_code::transaction_failed, x.code());
+    try
+    {
+        x.value();
+        CHECK_FAIL() << "Should have thrown";
+    }
+    catch (const transaction_failed& ex)
+    {
+        CHECK_EQ(error_code::version_mismatch, ex.underlying_cause());
+        CHECK_EQ(2U, ex.failed_op_index());
+    }
+}
+
+GTEST_TEST(outcome_tests, move_only)
+{
+    outcome<std::unique_ptr<int>> x = std::make_unique<int>(3);
+    auto p = std::move(x).value();
+    CHECK_EQ(3, *p);
+}
+
+GTEST_TEST(outcome_tests, void_outcome)
+{
+    outcome<void> good;
+    CHECK_TRUE(good);
+    good.value();
+    CHECK_EQ("ok", to_string(good));
+
+    outcome<void> bad = error_code::not_empty;
+    CHECK_FALSE(bad);
+    CHECK_THROWS(not_empty)
+    {
+        bad.value();
+    };
+}
+
+GTEST_TEST(outcome_tests, future_outcome_from_callback)
+{
+    auto ok = future_outcome_from_callback<int>([] (callback<int> cb) { cb(outcome<int>(4)); }).get();
+    CHECK_EQ(4, ok.value());
+
+    auto failed = future_outcome_from_callback<void>([] (callback<void> cb) { cb(error_code::no_entry); }).get();
+    CHECK_EQ(error_code::no_entry, failed.code());
+}
+
+namespace
+{
+
+class queue_executor final :
+        public executor
+{
+public:
+    virtual void execute(task_type task) override
+    {
+        tasks.emplace_back(std::move(task));
+    }
+
+    std::vector<task_type> tasks;
+};
+
+}
+
+GTEST_TEST(outcome_tests, via_executor)
+{
+    auto exec = std::make_shared<queue_executor>();
+    int  seen = 0;
+    callback<int> cb = via(exec, [&] (outcome<int> x) { seen = x.value(); });
+
+    cb(outcome<int>(9));
+    CHECK_EQ(0, seen);
+    CHECK_EQ(1U, exec->tasks.size());
+
+    exec->tasks[0]();
+    CHECK_EQ(9, seen);
+}
+
+GTEST_TEST(outcome_tests, via_inline_executor)
+{
+    bool called = false;
+    callback<void> cb = via(inline_executor(), [&] (outcome<void> x) { called = bool(x); });
+    cb(outcome<void>());
+    CHECK_TRUE(called);
+}
+
+}
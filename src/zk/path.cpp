@@ -0,0 +1,187 @@
+#include "path.hpp"
+
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <unordered_set>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// path                                                                                                               //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+path::path() :
+        _value("/")
+{ }
+
+path::path(std::string value) noexcept :
+        _value(std::move(value))
+{ }
+
+path::path(string_view value) :
+        _value(value)
+{ }
+
+path::path(const char* value) :
+        _value(value)
+{ }
+
+path::~path() noexcept = default;
+
+namespace
+{
+
+struct path_intern_table
+{
+    std::shared_mutex        protect;
+    std::unordered_set<path>  entries;
+};
+
+}
+
+const path& path::intern(string_view value)
+{
+    static path_intern_table table;
+
+    // Note that the set is keyed on the path itself, so lookups have to build one. This is only paid on the intern call,
+    // which is not expected to be on a hot path -- using the returned reference is.
+    path key(value);
+    {
+        std::shared_lock<std::shared_mutex> ax(table.protect);
+        auto iter = table.entries.find(key);
+        if (iter != table.entries.end())
+            return *iter;
+    }
+
+    // Elements of an unordered_set are never moved by rehashing, so references to them are stable.
+    std::unique_lock<std::shared_mutex> ax(table.protect);
+    return *table.entries.insert(std::move(key)).first;
+}
+
+bool path::is_valid(string_view value) noexcept
+{
+    if (value.empty() || value[0] != '/')
+        return false;
+    if (value.size() == 1U)
+        return true;
+    if (value[value.size() - 1] == '/')
+        return false;
+
+    std::size_t component_start = 1U;
+    for (std::size_t idx = 1U; idx <= value.size(); ++idx)
+    {
+        if (idx == value.size() || value[idx] == '/')
+        {
+            auto component = value.substr(component_start, idx - component_start);
+            if (component.empty() || component == "." || component == "..")
+                return false;
+            component_start = idx + 1U;
+        }
+        else if (value[idx] == '\0')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+string_view path::parent_view() const noexcept
+{
+    auto last_slash = _value.rfind('/');
+    if (last_slash == std::string::npos || last_slash == 0U)
+        return string_view(_value.data(), _value.empty() ? 0U : 1U);
+    else
+        return string_view(_value.data(), last_slash);
+}
+
+path path::parent() const
+{
+    return path(parent_view());
+}
+
+string_view path::basename() const noexcept
+{
+    auto last_slash = _value.rfind('/');
+    if (last_slash == std::string::npos)
+        return _value;
+    else
+        return string_view(_value).substr(last_slash + 1U);
+}
+
+path path::child(string_view name) const
+{
+    std::string out;
+    out.reserve(_value.size() + 1U + name.size());
+    out.append(_value);
+    if (out.empty() || out.back() != '/')
+        out.push_back('/');
+    out.append(name.data(), name.size());
+    return path(std::move(out));
+}
+
+path& path::operator/=(string_view name)
+{
+    if (_value.empty() || _value.back() != '/')
+        _value.push_back('/');
+    _value.append(name.data(), name.size());
+    return *this;
+}
+
+void path::truncate(std::size_t length)
+{
+    if (length < _value.size())
+        _value.resize(length);
+}
+
+bool operator==(const path& lhs, const path& rhs) noexcept
+{
+    return lhs.str() == rhs.str();
+}
+
+bool operator!=(const path& lhs, const path& rhs) noexcept
+{
+    return lhs.str() != rhs.str();
+}
+
+bool operator<(const path& lhs, const path& rhs) noexcept
+{
+    return lhs.str() < rhs.str();
+}
+
+bool operator<=(const path& lhs, const path& rhs) noexcept
+{
+    return lhs.str() <= rhs.str();
+}
+
+bool operator>(const path& lhs, const path& rhs) noexcept
+{
+    return lhs.str() > rhs.str();
+}
+
+bool operator>=(const path& lhs, const path& rhs) noexcept
+{
+    return lhs.str() >= rhs.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const path& self)
+{
+    return os << self.str();
+}
+
+std::string to_string(const path& self)
+{
+    return self.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// path_view                                                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const path_view& self)
+{
+    return os << self.view();
+}
+
+}
@@ -0,0 +1,188 @@
+/// \file
+/// Defines \ref zk::path and \ref zk::path_view, the types used to name entries in ZooKeeper.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+
+#include "string_view.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// The name of an entry in ZooKeeper, such as \c "/app/config/primary". A \c path owns its storage, which is always
+/// NUL-terminated, so passing one to a \ref client operation hands the characters directly to the underlying ZooKeeper
+/// client with no copying.
+///
+/// A \c path does not check that its contents are a valid ZooKeeper path (use \ref is_valid for that). The
+/// manipulation functions (\ref parent, \ref child, and \ref basename) assume the contents are of the usual
+/// slash-separated form without a trailing slash.
+class path final
+{
+public:
+    /// Create the root path \c "/".
+    path();
+
+    /// \{
+    /// Create an instance from an existing string.
+    explicit path(std::string value) noexcept;
+    explicit path(string_view value);
+    explicit path(const char* value);
+    /// \}
+
+    path(const path&) = default;
+    path(path&&) noexcept = default;
+
+    path& operator=(const path&) = default;
+    path& operator=(path&&) noexcept = default;
+
+    ~path() noexcept;
+
+    /// Get a process-wide shared instance with the contents of \a value. The returned reference is valid for the life of
+    /// the program, so commonly-used paths can be interned once and then used without any copies or allocations. The
+    /// intern table is never shrunk, so this should not be used for paths generated without bound (like sequential
+    /// entry names).
+    static const path& intern(string_view value);
+
+    /// Is \a value a valid ZooKeeper path? This checks that the path is absolute, has no empty, \c "." or \c ".."
+    /// components, has no trailing slash (unless it is the root) and contains no NUL characters.
+    static bool is_valid(string_view value) noexcept;
+
+    /// \{
+    /// The contents of the path.
+    const std::string& str() const & noexcept { return _value; }
+    std::string        str() &&      noexcept { return std::move(_value); }
+    /// \}
+
+    /// A NUL-terminated pointer to the path contents.
+    const char* c_str() const noexcept { return _value.c_str(); }
+
+    std::size_t size() const noexcept { return _value.size(); }
+
+    bool empty() const noexcept { return _value.empty(); }
+
+    /// Is this the root path \c "/"?
+    bool is_root() const noexcept { return _value.size() == 1U && _value[0] == '/'; }
+
+    operator string_view() const noexcept { return _value; }
+
+    /// \{
+    /// Get the path of the parent entry. The parent of \c "/a/b" is \c "/a" and the parent of \c "/a" is \c "/". The
+    /// root has no parent; \c "/" is returned for it. The \c parent_view form does not allocate, but the result is not
+    /// NUL-terminated.
+    path        parent() const;
+    string_view parent_view() const noexcept;
+    /// \}
+
+    /// Get the last component of the path. The basename of \c "/a/b" is \c "b" and the basename of \c "/" is \c "".
+    string_view basename() const noexcept;
+
+    /// \{
+    /// Get the path of the child entry named \a name. The child \c "c" of \c "/a/b" is \c "/a/b/c". The result is
+    /// created with a single allocation.
+    path child(string_view name) const;
+    path operator/(string_view name) const { return child(name); }
+    /// \}
+
+    /// Append the child \a name to this path in place. When building many sibling paths in a loop, a single \c path
+    /// which is appended to and then \ref truncate d back reuses its storage instead of allocating on every iteration.
+    path& operator/=(string_view name);
+
+    /// Shorten the path to its first \a length characters.
+    void truncate(std::size_t length);
+
+private:
+    std::string _value;
+};
+
+/// \{
+/// Paths compare the same way their contents do.
+bool operator==(const path& lhs, const path& rhs) noexcept;
+bool operator!=(const path& lhs, const path& rhs) noexcept;
+bool operator< (const path& lhs, const path& rhs) noexcept;
+bool operator<=(const path& lhs, const path& rhs) noexcept;
+bool operator> (const path& lhs, const path& rhs) noexcept;
+bool operator>=(const path& lhs, const path& rhs) noexcept;
+/// \}
+
+std::ostream& operator<<(std::ostream&, const path&);
+
+std::string to_string(const path&);
+
+/// A non-owning reference to a path, which is the parameter type of the \ref client operations. It can be implicitly
+/// created from a \ref path, \c std::string, NUL-terminated C string, or \ref string_view. All but the last of those
+/// are known to be NUL-terminated, which lets the operation skip copying the path to terminate it.
+class path_view final
+{
+public:
+    path_view(const path& src) noexcept :
+            _data(src.c_str()),
+            _size(src.size()),
+            _terminated(true)
+    { }
+
+    path_view(const std::string& src) noexcept :
+            _data(src.c_str()),
+            _size(src.size()),
+            _terminated(true)
+    { }
+
+    path_view(const char* src) noexcept :
+            path_view(string_view(src))
+    {
+        _terminated = true;
+    }
+
+    path_view(string_view src) noexcept :
+            _data(src.data()),
+            _size(src.size()),
+            _terminated(false)
+    { }
+
+    const char* data() const noexcept { return _data; }
+
+    std::size_t size() const noexcept { return _size; }
+
+    /// Is \c data()[size()] guaranteed to be a NUL character?
+    bool is_terminated() const noexcept { return _terminated; }
+
+    string_view view() const noexcept { return string_view(_data, _size); }
+
+    operator string_view() const noexcept { return view(); }
+
+private:
+    const char* _data;
+    std::size_t _size;
+    bool        _terminated;
+};
+
+std::ostream& operator<<(std::ostream&, const path_view&);
+
+/// \}
+
+}
+
+namespace std
+{
+
+template <>
+struct hash<zk::path>
+{
+    using argument_type = zk::path;
+    using result_type   = std::size_t;
+
+    result_type operator()(const argument_type& x) const noexcept
+    {
+        return std::hash<std::string>()(x.str());
+    }
+};
+
+}
@@ -0,0 +1,102 @@
+#include <zk/tests/test.hpp>
+
+#include <string>
+
+#include "multi.hpp"
+#include "path.hpp"
+
+namespace zk
+{
+
+GTEST_TEST(path_tests, default_is_root)
+{
+    path x;
+    CHECK_EQ("/", x.str());
+    CHECK_TRUE(x.is_root());
+    CHECK_EQ("", x.basename());
+    CHECK_EQ(path("/"), x.parent());
+}
+
+GTEST_TEST(path_tests, parent_and_basename)
+{
+    path x("/a/b/c");
+    CHECK_EQ(path("/a/b"), x.parent());
+    CHECK_EQ("/a/b", x.parent_view());
+    CHECK_EQ("c", x.basename());
+    CHECK_EQ(path("/"), path("/a").parent());
+    CHECK_EQ("a", path("/a").basename());
+}
+
+GTEST_TEST(path_tests, child)
+{
+    CHECK_EQ(path("/a/b"), path("/a").child("b"));
+    CHECK_EQ(path("/a"), path().child("a"));
+    CHECK_EQ(path("/a/b/c"), path("/a") / "b" / "c");
+}
+
+GTEST_TEST(path_tests, append_and_truncate)
+{
+    path x("/base");
+    auto base_size = x.size();
+
+    x /= "first";
+    CHECK_EQ("/base/first", x.str());
+    x.truncate(base_size);
+    CHECK_EQ("/base", x.str());
+    x /= "second";
+    CHECK_EQ("/base/second", x.str());
+
+    // Truncating past the end does nothing
+    x.truncate(100U);
+    CHECK_EQ("/base/second", x.str());
+}
+
+GTEST_TEST(path_tests, is_valid)
+{
+    CHECK_TRUE(path::is_valid("/"));
+    CHECK_TRUE(path::is_valid("/a"));
+    CHECK_TRUE(path::is_valid("/a/b.c/d..e"));
+    CHECK_FALSE(path::is_valid(""));
+    CHECK_FALSE(path::is_valid("a/b"));
+    CHECK_FALSE(path::is_valid("/a/"));
+    CHECK_FALSE(path::is_valid("/a//b"));
+    CHECK_FALSE(path::is_valid("/a/./b"));
+    CHECK_FALSE(path::is_valid("/a/.."));
+    CHECK_FALSE(path::is_valid(string_view("/a\0b", 4U)));
+}
+
+GTEST_TEST(path_tests, intern_identity)
+{
+    const path& a = path::intern("/interned/thing");
+    const path& b = path::intern(std::string("/interned/") + "thing");
+    const path& c = path::intern("/interned/other");
+    CHECK_EQ(&a, &b);
+    CHECK_NE(&a, &c);
+    CHECK_EQ("/interned/thing", a.str());
+}
+
+GTEST_TEST(path_tests, view_termination)
+{
+    path        p("/a/b");
+    std::string s("/a/b");
+    string_view sv("/a/b/c", 4U);
+
+    CHECK_TRUE(path_view(p).is_terminated());
+    CHECK_EQ(p.c_str(), path_view(p).data());
+    CHECK_TRUE(path_view(s).is_terminated());
+    CHECK_TRUE(path_view("/a/b").is_terminated());
+    CHECK_FALSE(path_view(sv).is_terminated());
+
+    CHECK_EQ("/a/b", path_view(p).view());
+    CHECK_EQ("/a/b", path_view(sv).view());
+}
+
+GTEST_TEST(path_tests, ops_from_path)
+{
+    auto x = op::set(path("/a/b"), buffer(), version(2));
+    CHECK_EQ("/a/b", x.as_set().path);
+    auto y = op::erase(path::intern("/a/c"));
+    CHECK_EQ("/a/c", y.as_erase().path);
+}
+
+}
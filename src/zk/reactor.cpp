@@ -0,0 +1,529 @@
+#include "reactor.hpp"
+#include "admission.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// io_transport                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const io_transport& transport)
+{
+    switch (transport)
+    {
+    case io_transport::epoll:    return os << "epoll";
+    case io_transport::io_uring: return os << "io_uring";
+    default:                     return os << "io_transport(" << static_cast<int>(transport) << ')';
+    }
+}
+
+std::string to_string(const io_transport& transport)
+{
+    std::ostringstream os;
+    os << transport;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// reactor::epoll_loop                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The loop of \ref io_transport::epoll. Streams are read until a short read whenever \c epoll says they are readable,
+/// and written straight away until the socket pushes back, at which point the rest waits for \c EPOLLOUT.
+class reactor::epoll_loop final :
+        public reactor::loop
+{
+public:
+    epoll_loop();
+
+    virtual ~epoll_loop() noexcept;
+
+    virtual void watch(int fd, std::uint32_t events, handler& target) override;
+
+    virtual void attach(int fd, stream_handler& target) override;
+
+    virtual void send(int fd, std::vector<char> bytes) override;
+
+    virtual void forget(int fd) override;
+
+    /// Wait up to \a timeout_ms for the file descriptors to be ready and serve the ones which are. This is one turn of
+    /// \ref run, which \ref reactor::process makes from the outside.
+    ///
+    /// \returns The number of file descriptors served, or \c -1 (with \c errno set) if \c epoll_wait failed.
+    int dispatch(int timeout_ms);
+
+    int epoll_fd() const { return _epoll_fd; }
+
+protected:
+    virtual void run() override;
+
+private:
+    struct stream
+    {
+        int                 fd;
+        ptr<stream_handler> target;
+        std::uint64_t       id;
+        std::vector<char>   pending;
+        std::size_t         offset;
+        bool                wants_write;
+    };
+
+    void control(int op, int fd, std::uint32_t events);
+
+    void on_stream_ready(int fd, std::uint32_t events);
+
+    void receive(int fd, std::uint64_t id);
+
+    void write_pending(stream& strm);
+
+    /// Forget the stream \a fd (if it is still the one with \a id) and tell its handler it failed with \a err.
+    void fail(int fd, std::uint64_t id, int err);
+
+private:
+    int                                   _epoll_fd;
+    std::unordered_map<int, ptr<handler>> _handlers;
+    std::unordered_map<int, stream>       _streams;
+    std::uint64_t                         _next_stream_id;
+};
+
+reactor::epoll_loop::epoll_loop() :
+        _epoll_fd(::epoll_create1(EPOLL_CLOEXEC)),
+        _next_stream_id(1U)
+{
+    if (_epoll_fd == -1)
+        throw std::system_error(errno, std::system_category(), "epoll_create1");
+
+    ::epoll_event ev{};
+    ev.events  = EPOLLIN;
+    ev.data.fd = wake_fd();
+    if (::epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, wake_fd(), &ev) == -1)
+    {
+        auto err = errno;
+        ::close(_epoll_fd);
+        throw std::system_error(err, std::system_category(), "epoll_ctl");
+    }
+}
+
+reactor::epoll_loop::~epoll_loop() noexcept
+{
+    ::close(_epoll_fd);
+}
+
+void reactor::epoll_loop::control(int op, int fd, std::uint32_t events)
+{
+    ::epoll_event ev{};
+    ev.events  = events;
+    ev.data.fd = fd;
+    if (::epoll_ctl(_epoll_fd, op, fd, &ev) == -1)
+        throw std::system_error(errno, std::system_category(), "epoll_ctl");
+}
+
+void reactor::epoll_loop::watch(int fd, std::uint32_t events, handler& target)
+{
+    auto inserted = _handlers.emplace(fd, &target);
+    if (!inserted.second)
+        inserted.first->second = &target;
+
+    try
+    {
+        control(inserted.second ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, events);
+    }
+    catch (...)
+    {
+        if (inserted.second)
+            _handlers.erase(inserted.first);
+        throw;
+    }
+}
+
+void reactor::epoll_loop::attach(int fd, stream_handler& target)
+{
+    control(EPOLL_CTL_ADD, fd, EPOLLIN);
+    _streams[fd] = stream{ fd, &target, _next_stream_id++, {}, 0U, false };
+}
+
+void reactor::epoll_loop::send(int fd, std::vector<char> bytes)
+{
+    auto iter = _streams.find(fd);
+    if (iter == _streams.end() || bytes.empty())
+        return;
+
+    auto& strm = iter->second;
+    if (strm.offset == strm.pending.size())
+    {
+        strm.pending = std::move(bytes);
+        strm.offset  = 0U;
+    }
+    else
+    {
+        strm.pending.insert(strm.pending.end(), bytes.begin(), bytes.end());
+    }
+
+    if (!strm.wants_write)
+        write_pending(strm);
+}
+
+void reactor::epoll_loop::forget(int fd)
+{
+    if (_handlers.erase(fd) != 0U || _streams.erase(fd) != 0U)
+        ::epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void reactor::epoll_loop::write_pending(stream& strm)
+{
+    int fd = strm.fd;
+    while (strm.offset < strm.pending.size())
+    {
+        auto sent = ::send(fd, strm.pending.data() + strm.offset, strm.pending.size() - strm.offset, MSG_NOSIGNAL);
+        if (sent > 0)
+        {
+            strm.offset += std::size_t(sent);
+        }
+        else if (sent == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            if (!strm.wants_write)
+            {
+                strm.wants_write = true;
+                control(EPOLL_CTL_MOD, fd, EPOLLIN | EPOLLOUT);
+            }
+            return;
+        }
+        else
+        {
+            // The handler must not be called back from inside send, so the failure is reported from the loop
+            auto err = errno;
+            post([this, fd, id = strm.id, err] { fail(fd, id, err); });
+            strm.pending.clear();
+            strm.offset = 0U;
+            return;
+        }
+    }
+
+    strm.pending.clear();
+    strm.offset = 0U;
+    if (strm.wants_write)
+    {
+        strm.wants_write = false;
+        control(EPOLL_CTL_MOD, fd, EPOLLIN);
+    }
+}
+
+void reactor::epoll_loop::fail(int fd, std::uint64_t id, int err)
+{
+    auto iter = _streams.find(fd);
+    if (iter == _streams.end() || iter->second.id != id)
+        return;
+
+    auto target = iter->second.target;
+    forget(fd);
+    target->on_stream_error(fd, err);
+}
+
+void reactor::epoll_loop::receive(int fd, std::uint64_t id)
+{
+    while (true)
+    {
+        auto iter = _streams.find(fd);
+        if (iter == _streams.end() || iter->second.id != id)
+            return;
+
+        auto target   = iter->second.target;
+        auto space    = target->receive_space(fd);
+        auto received = ::recv(fd, space.first, space.second, 0);
+        if (received > 0)
+        {
+            target->on_received(fd, std::size_t(received));
+
+            // A short read means the socket is drained; epoll says when there is more
+            if (std::size_t(received) < space.second)
+                return;
+        }
+        else if (received == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return;
+        }
+        else
+        {
+            return fail(fd, id, received == 0 ? 0 : errno);
+        }
+    }
+}
+
+void reactor::epoll_loop::on_stream_ready(int fd, std::uint32_t events)
+{
+    auto id = _streams.at(fd).id;
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+        receive(fd, id);
+
+    auto iter = _streams.find(fd);
+    if (iter != _streams.end() && iter->second.id == id && (events & EPOLLOUT))
+        write_pending(iter->second);
+}
+
+int reactor::epoll_loop::dispatch(int timeout_ms)
+{
+    static constexpr int max_events = 64;
+    ::epoll_event events[max_events];
+    int count = ::epoll_wait(_epoll_fd, events, max_events, timeout_ms);
+    if (count == -1)
+        return -1;
+
+    for (int idx = 0; idx < count; ++idx)
+    {
+        auto fd = events[idx].data.fd;
+        if (fd == wake_fd())
+        {
+            run_tasks();
+        }
+        else if (_streams.count(fd) != 0U)
+        {
+            on_stream_ready(fd, events[idx].events);
+        }
+        else
+        {
+            // An earlier handler of this batch may have forgotten this one
+            auto iter = _handlers.find(fd);
+            if (iter != _handlers.end())
+                iter->second->on_ready(fd, events[idx].events);
+        }
+    }
+    return count;
+}
+
+void reactor::epoll_loop::run()
+{
+    while (!stopping())
+    {
+        if (dispatch(-1) == -1 && errno != EINTR)
+            break;
+    }
+
+    // Whoever posted these is waiting on them
+    run_tasks();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// reactor                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+reactor::reactor(std::size_t thread_count, io_transport transport) :
+        _transport(transport),
+        _next_loop(0U)
+{
+    if (thread_count == 0U)
+        throw std::invalid_argument("A reactor needs at least one thread");
+
+    _loops.reserve(thread_count);
+    try
+    {
+        for (std::size_t idx = 0U; idx < thread_count; ++idx)
+        {
+            if (transport == io_transport::io_uring)
+                _loops.emplace_back(make_uring_loop());
+            else
+                _loops.emplace_back(std::make_shared<epoll_loop>());
+            _loops.back()->start();
+        }
+    }
+    catch (...)
+    {
+        for (auto& loop : _loops)
+            loop->stop();
+        throw;
+    }
+}
+
+reactor::reactor(std::shared_ptr<epoll_loop> driven) :
+        _transport(io_transport::epoll),
+        _next_loop(0U),
+        _driven(std::move(driven))
+{
+    _driven->adopt_current_thread();
+    _loops.emplace_back(_driven);
+}
+
+reactor::~reactor() noexcept
+{
+    for (auto& loop : _loops)
+        loop->stop();
+}
+
+std::shared_ptr<reactor> reactor::shared(io_transport transport)
+{
+    static const std::size_t thread_count = std::clamp(std::thread::hardware_concurrency(), 1U, 4U);
+    static const auto        epoll        = std::make_shared<reactor>(thread_count, io_transport::epoll);
+    if (transport == io_transport::epoll)
+        return epoll;
+
+    static const auto uring = [&] () -> std::shared_ptr<reactor>
+                              {
+                                  try
+                                  {
+                                      return std::make_shared<reactor>(thread_count, io_transport::io_uring);
+                                  }
+                                  catch (const std::system_error&)
+                                  {
+                                      return epoll;
+                                  }
+                              }();
+    return uring;
+}
+
+std::shared_ptr<reactor> reactor::external()
+{
+    // Not through make_shared, which can not reach the constructor
+    return std::shared_ptr<reactor>(new reactor(std::make_shared<epoll_loop>()));
+}
+
+int reactor::poll_fd() const
+{
+    if (!_driven)
+        throw std::logic_error("Only an external reactor has a file descriptor to poll");
+    return _driven->epoll_fd();
+}
+
+std::size_t reactor::process(std::chrono::milliseconds timeout)
+{
+    if (!_driven)
+        throw std::logic_error("Only an external reactor is driven through process");
+    if (!_driven->in_loop_thread())
+        throw std::logic_error("An external reactor must be driven by the thread which created it");
+
+    // Only while it is driving the reactor: the rest of the time, the thread is the application's
+    completion_thread_scope delivering;
+
+    using rep = std::chrono::milliseconds::rep;
+    int timeout_ms = timeout.count() < 0 ? -1 : int(std::min<rep>(timeout.count(), INT_MAX));
+    int count      = _driven->dispatch(timeout_ms);
+    if (count == -1)
+    {
+        if (errno == EINTR)
+            return 0U;
+        throw std::system_error(errno, std::system_category(), "epoll_wait");
+    }
+    return std::size_t(count);
+}
+
+reactor::loop& reactor::next_loop()
+{
+    return *_loops[_next_loop.fetch_add(1U, std::memory_order_relaxed) % _loops.size()];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// reactor::loop                                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+reactor::loop::loop() :
+        _wake_fd(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+        _stopping(false)
+{
+    if (_wake_fd == -1)
+        throw std::system_error(errno, std::system_category(), "eventfd");
+}
+
+reactor::loop::~loop() noexcept
+{
+    ::close(_wake_fd);
+}
+
+void reactor::loop::start()
+{
+    // The thread keeps the loop alive, so a reactor released from one of its own threads does not pull the loop out
+    // from under it
+    _worker = std::thread([self = shared_from_this()]
+                          {
+                              completion_thread_scope::mark_forever();
+                              self->_worker_id.store(std::this_thread::get_id(), std::memory_order_release);
+                              self->run();
+                          }
+                         );
+}
+
+void reactor::loop::adopt_current_thread()
+{
+    _worker_id.store(std::this_thread::get_id(), std::memory_order_release);
+}
+
+void reactor::loop::stop()
+{
+    _stopping.store(true, std::memory_order_release);
+    if (!_worker.joinable())
+    {
+        // An adopted loop has no thread to wait for; whatever is still queued can only be run from its own
+        if (in_loop_thread())
+            run_tasks();
+        return;
+    }
+
+    post([] { });
+
+    if (in_loop_thread())
+        _worker.detach();
+    else
+        _worker.join();
+}
+
+void reactor::loop::post(task_type task)
+{
+    bool first;
+    {
+        std::unique_lock<std::mutex> ax(_tasks_protect);
+        first = _tasks.empty();
+        _tasks.emplace_back(std::move(task));
+    }
+
+    // Only the first task of a batch needs to wake the loop; it runs everything queued by then
+    if (first)
+    {
+        std::uint64_t one = 1U;
+        while (::write(_wake_fd, &one, sizeof one) == -1 && errno == EINTR)
+        { }
+    }
+}
+
+bool reactor::loop::in_loop_thread() const
+{
+    return _worker_id.load(std::memory_order_acquire) == std::this_thread::get_id();
+}
+
+void reactor::loop::run_tasks()
+{
+    std::uint64_t burn;
+    while (::read(_wake_fd, &burn, sizeof burn) == -1 && errno == EINTR)
+    { }
+
+    std::vector<task_type> tasks;
+    {
+        std::unique_lock<std::mutex> ax(_tasks_protect);
+        tasks.swap(_tasks);
+    }
+
+    for (auto& task : tasks)
+        task();
+}
+
+}
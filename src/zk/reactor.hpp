@@ -0,0 +1,237 @@
+/// \file
+/// Defines \ref zk::reactor, the event loops which the sessions of \ref zk::connection_zkn run on.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// How the loops of a \ref reactor wait for and move the bytes of their sockets.
+enum class io_transport : int
+{
+    /// Readiness is reported by \c epoll and each socket is read and written with its own \c recv and \c send calls.
+    /// This works everywhere and is the default.
+    epoll,
+    /// Reads and writes are submitted to an \c io_uring. Every socket of a loop keeps a multishot receive into buffers
+    /// shared with the kernel, and the writes queued by everything the loop ran are submitted with one
+    /// \c io_uring_enter, which also waits for what is next. This needs Linux 5.19 or later; multishot receive is
+    /// used from 6.0 on.
+    io_uring,
+};
+
+std::ostream& operator<<(std::ostream&, const io_transport&);
+
+std::string to_string(const io_transport&);
+
+/// A fixed set of threads, each running a loop that any number of file descriptors are multiplexed over. The sessions
+/// of \ref connection_zkn are spread across the loops of \ref reactor::shared, so a process holding hundreds of
+/// sessions still has only a handful of I/O threads.
+class reactor final
+{
+public:
+    /// Gets told when a file descriptor it watches with \ref loop::watch is ready.
+    class handler
+    {
+    public:
+        /// The file descriptor \a fd is ready for \a events (a mask of \c EPOLLIN, \c EPOLLOUT, \c EPOLLERR and so on).
+        /// This is called on the thread of the loop.
+        virtual void on_ready(int fd, std::uint32_t events) = 0;
+
+    protected:
+        ~handler() noexcept = default;
+    };
+
+    /// Gets the bytes received on a socket it attached with \ref loop::attach. All of these are called on the thread of
+    /// the loop.
+    class stream_handler
+    {
+    public:
+        /// Where the next bytes received on \a fd are to go. The space must be at least one byte and stay valid until
+        /// \ref on_received is called.
+        virtual std::pair<ptr<char>, std::size_t> receive_space(int fd) = 0;
+
+        /// \a count bytes were put at the start of the last \ref receive_space.
+        virtual void on_received(int fd, std::size_t count) = 0;
+
+        /// The stream on \a fd is broken: \a err is the \c errno it failed with, or \c 0 if the peer closed it. The
+        /// loop has already forgotten \a fd, but closing it is still up to the handler.
+        virtual void on_stream_error(int fd, int err) = 0;
+
+    protected:
+        ~stream_handler() noexcept = default;
+    };
+
+    class loop;
+
+public:
+    /// Create a reactor running \a thread_count loops over \a transport.
+    ///
+    /// \throws std::invalid_argument if \a thread_count is \c 0.
+    /// \throws std::system_error if the kernel refuses to create a loop (with \c ENOSYS when it does not support
+    ///  \a transport).
+    explicit reactor(std::size_t thread_count, io_transport transport = io_transport::epoll);
+
+    reactor(const reactor&) = delete;
+    reactor& operator=(const reactor&) = delete;
+
+    /// Stop the loops. Everything which was watched must have been forgotten by now.
+    ~reactor() noexcept;
+
+    /// The reactor for \a transport shared by the whole process. It has one loop for each hardware thread, up to 4, and
+    /// is started the first time it is asked for. If this kernel can not run \ref io_transport::io_uring, asking for it
+    /// gets the \ref io_transport::epoll reactor instead; \ref transport tells which one it is.
+    static std::shared_ptr<reactor> shared(io_transport transport = io_transport::epoll);
+
+    /// Create a reactor with a single \ref io_transport::epoll loop and no thread of its own, for an application which
+    /// runs its own event loop. The calling thread becomes the thread of the loop: it registers \ref poll_fd with its
+    /// own \c epoll (or \c poll or \c select) for reading and calls \ref process whenever that is readable. Everything
+    /// the loop does, completions and watch events of a \ref connection_zkn given this through
+    /// \ref connection_params::io_reactor included, runs inline in \ref process, so nothing is handed across threads.
+    ///
+    /// \warning Waiting on a \ref future from the thread of the loop blocks forever, since the loop is not turned while
+    ///  it waits. Use the callback versions of the operations there, or check whether the future is ready between
+    ///  calls to \ref process.
+    ///
+    /// \throws std::system_error if the kernel refuses to create the loop.
+    static std::shared_ptr<reactor> external();
+
+    io_transport transport() const { return _transport; }
+
+    /// Is this a reactor from \ref external?
+    bool is_external() const { return _driven != nullptr; }
+
+    /// The file descriptor which becomes readable when \ref process has something to do. Its interest is always just
+    /// \c EPOLLIN (\c POLLIN); the timeouts of the sessions are timers behind it, so there is no separate deadline to
+    /// wait for either.
+    ///
+    /// \throws std::logic_error if this reactor is not \ref external.
+    int poll_fd() const;
+
+    /// Serve what is ready on the loop of an \ref external reactor, waiting up to \a timeout for something to be. A
+    /// \a timeout of \c 0 (the default) does not wait at all, which is what a caller woken up for \ref poll_fd wants;
+    /// a negative one waits for as long as it takes.
+    ///
+    /// \returns The number of file descriptors which were served, counting the posted tasks as one.
+    /// \throws std::logic_error if this reactor is not \ref external or the caller is not the thread which created it.
+    /// \throws std::system_error if waiting for the loop fails.
+    std::size_t process(std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+    std::size_t loop_count() const { return _loops.size(); }
+
+    /// Pick the loop for something new to run on. Consecutive calls go around the loops in turn.
+    loop& next_loop();
+
+private:
+    class epoll_loop;
+    class uring_loop;
+
+    static std::shared_ptr<loop> make_uring_loop();
+
+    explicit reactor(std::shared_ptr<epoll_loop> driven);
+
+private:
+    io_transport                       _transport;
+    std::vector<std::shared_ptr<loop>> _loops;
+    std::atomic<std::size_t>           _next_loop;
+    std::shared_ptr<epoll_loop>        _driven;
+};
+
+/// One thread of a \ref reactor. The members which change what is watched or send anything may only be called from the
+/// thread of the loop; \ref post is how other threads get something done there.
+///
+/// A file descriptor is known to a loop in one of two ways at a time. It can be watched, where its \ref handler is told
+/// it is ready and does the I/O itself, or it can be an attached stream, where the loop does the I/O and hands the
+/// \ref stream_handler what was received. Either way, it must be forgotten before it is closed.
+class reactor::loop :
+        public std::enable_shared_from_this<reactor::loop>
+{
+public:
+    using task_type = std::function<void ()>;
+
+public:
+    loop(const loop&) = delete;
+    loop& operator=(const loop&) = delete;
+
+    virtual ~loop() noexcept;
+
+    /// Start watching \a fd for \a events (an \c epoll mask), or change the events if it is already watched. Readiness
+    /// is reported to \a target until \a fd is forgotten.
+    ///
+    /// \throws std::system_error if the kernel refuses to watch \a fd.
+    virtual void watch(int fd, std::uint32_t events, handler& target) = 0;
+
+    /// Start receiving on the connected, non-blocking socket \a fd, which must not be watched. What arrives is given to
+    /// \a target until \a fd is forgotten or fails.
+    ///
+    /// \throws std::system_error if the kernel refuses to receive on \a fd.
+    virtual void attach(int fd, stream_handler& target) = 0;
+
+    /// Send \a bytes on the attached stream \a fd after everything sent on it before. This never blocks and never calls
+    /// back; if the socket fails, its \ref stream_handler hears about it later. Sending on a forgotten \a fd does
+    /// nothing.
+    virtual void send(int fd, std::vector<char> bytes) = 0;
+
+    /// Stop watching or receiving on \a fd. This must happen before \a fd is closed. What was sent on a stream is still
+    /// given a chance to go out, but that it does is not guaranteed.
+    virtual void forget(int fd) = 0;
+
+    /// Run \a task on the thread of this loop, after everything posted before it. This can be called from any thread.
+    void post(task_type task);
+
+    /// Is the caller running on the thread of this loop?
+    bool in_loop_thread() const;
+
+protected:
+    /// \throws std::system_error if the wake-up \c eventfd can not be made.
+    loop();
+
+    /// Serve the file descriptors until \ref stopping, then run the tasks which are left.
+    virtual void run() = 0;
+
+    /// The \c eventfd which becomes readable when tasks are posted. The loop has to wait on it and call \ref run_tasks
+    /// when it is.
+    int wake_fd() const { return _wake_fd; }
+
+    void run_tasks();
+
+    bool stopping() const { return _stopping.load(std::memory_order_acquire); }
+
+private:
+    friend class reactor;
+
+    void start();
+
+    /// Make the calling thread the thread of this loop without starting one, for \ref reactor::external.
+    void adopt_current_thread();
+
+    void stop();
+
+private:
+    int                          _wake_fd;
+    std::mutex                   _tasks_protect;
+    std::vector<task_type>       _tasks;
+    std::atomic<bool>            _stopping;
+    std::thread                  _worker;
+    std::atomic<std::thread::id> _worker_id;
+};
+
+/// \}
+
+}
@@ -0,0 +1,199 @@
+#include <zk/tests/test.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "reactor.hpp"
+
+namespace zk
+{
+
+/// Collects what arrives on a stream until \c expected bytes are there, then says so through \c received.
+class collecting_stream final :
+        public reactor::stream_handler
+{
+public:
+    explicit collecting_stream(std::size_t expected) :
+            _expected(expected),
+            _space(16U)
+    { }
+
+    virtual std::pair<ptr<char>, std::size_t> receive_space(int) override
+    {
+        // Deliberately small, so a message arrives in pieces
+        return { _space.data(), _space.size() };
+    }
+
+    virtual void on_received(int, std::size_t count) override
+    {
+        _bytes.append(_space.data(), count);
+        if (_bytes.size() == _expected)
+            received.set_value(_bytes);
+    }
+
+    virtual void on_stream_error(int, int err) override
+    {
+        failed.set_value(err);
+    }
+
+    std::promise<std::string> received;
+    std::promise<int>         failed;
+
+private:
+    std::size_t       _expected;
+    std::vector<char> _space;
+    std::string       _bytes;
+};
+
+static void check_stream_round_trip(io_transport transport)
+{
+    std::shared_ptr<reactor> react;
+    try
+    {
+        react = std::make_shared<reactor>(1U, transport);
+    }
+    catch (const std::system_error&)
+    {
+        // The kernel of this machine can not run the transport, which is what shared() falls back for
+        return;
+    }
+    CHECK_EQ(transport, react->transport());
+
+    int fds[2];
+    CHECK_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds));
+
+    const std::string  message(1000U, 'x');
+    collecting_stream  stream(message.size());
+    auto&              loop = react->next_loop();
+    auto               received = stream.received.get_future();
+    loop.post([&]
+              {
+                  loop.attach(fds[0], stream);
+                  // Two sends in one turn go out together and in order
+                  loop.send(fds[0], std::vector<char>{ 'p', 'i' });
+                  loop.send(fds[0], std::vector<char>{ 'n', 'g' });
+              }
+             );
+
+    std::string echo;
+    while (echo.size() < 4U)
+    {
+        char buffer[8];
+        auto got = ::recv(fds[1], buffer, sizeof buffer, 0);
+        if (got > 0)
+            echo.append(buffer, std::size_t(got));
+    }
+    CHECK_EQ("ping", echo);
+
+    CHECK_EQ(ssize_t(message.size()), ::send(fds[1], message.data(), message.size(), 0));
+    CHECK_EQ(message, received.get());
+
+    // The peer hanging up is reported as an error of 0
+    auto failed = stream.failed.get_future();
+    ::close(fds[1]);
+    CHECK_EQ(0, failed.get());
+
+    std::promise<void> forgotten;
+    loop.post([&] { loop.forget(fds[0]); forgotten.set_value(); });
+    forgotten.get_future().get();
+    ::close(fds[0]);
+}
+
+GTEST_TEST(reactor_tests, stream_round_trip_epoll)
+{
+    check_stream_round_trip(io_transport::epoll);
+}
+
+GTEST_TEST(reactor_tests, stream_round_trip_io_uring)
+{
+    check_stream_round_trip(io_transport::io_uring);
+}
+
+/// Counts how often it is told a file descriptor is ready, and drains it so it is not told again.
+class counting_handler final :
+        public reactor::handler
+{
+public:
+    virtual void on_ready(int fd, std::uint32_t) override
+    {
+        char buffer[16];
+        while (::recv(fd, buffer, sizeof buffer, 0) > 0)
+        { }
+        ++calls;
+        thread = std::this_thread::get_id();
+    }
+
+    std::size_t     calls = 0U;
+    std::thread::id thread;
+};
+
+GTEST_TEST(reactor_tests, external)
+{
+    auto react = reactor::external();
+    CHECK_TRUE(react->is_external());
+    CHECK_EQ(1U, react->loop_count());
+    CHECK_EQ(0U, react->process());
+
+    int fds[2];
+    CHECK_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds));
+
+    ::pollfd outer{ react->poll_fd(), POLLIN, 0 };
+    CHECK_EQ(0, ::poll(&outer, 1U, 0));
+
+    counting_handler handler;
+    auto&            loop = react->next_loop();
+    CHECK_TRUE(loop.in_loop_thread());
+    loop.watch(fds[0], EPOLLIN, handler);
+    CHECK_EQ(1, ::send(fds[1], "x", 1U, 0));
+
+    // The outer loop is woken by the descriptor of the reactor, and the handler runs inside process on this thread
+    CHECK_EQ(1, ::poll(&outer, 1U, 1000));
+    CHECK_EQ(1U, react->process());
+    CHECK_EQ(1U, handler.calls);
+    CHECK_TRUE(handler.thread == std::this_thread::get_id());
+
+    // Tasks posted from elsewhere wait for the next turn
+    const auto caller = std::this_thread::get_id();
+    bool       ran    = false;
+    std::thread([&] { loop.post([&] { ran = std::this_thread::get_id() == caller; }); }).join();
+    CHECK_FALSE(ran);
+    CHECK_EQ(1U, react->process(std::chrono::milliseconds(1000)));
+    CHECK_TRUE(ran);
+
+    loop.forget(fds[0]);
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    std::thread([&]
+                {
+                    CHECK_THROWS(std::logic_error) { react->process(); };
+                }
+               ).join();
+}
+
+GTEST_TEST(reactor_tests, needs_threads)
+{
+    CHECK_THROWS(std::invalid_argument) { reactor(0U); };
+}
+
+GTEST_TEST(reactor_tests, shared_falls_back)
+{
+    auto react = reactor::shared(io_transport::io_uring);
+    CHECK_TRUE(react->transport() == io_transport::io_uring || react == reactor::shared(io_transport::epoll));
+    CHECK_EQ("io_uring", to_string(io_transport::io_uring));
+}
+
+}
@@ -0,0 +1,717 @@
+#include "reactor.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#if __has_include(<linux/io_uring.h>)
+#   include <linux/io_uring.h>
+#   include <sys/epoll.h>
+#   include <sys/mman.h>
+#   include <sys/socket.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+// Multishot receive is the newest part of the interface the loop is written against (Linux 6.0 headers)
+#if defined(IORING_RECV_MULTISHOT)
+#   define ZKPP_REACTOR_HAS_IO_URING 1
+#else
+#   define ZKPP_REACTOR_HAS_IO_URING 0
+#endif
+
+namespace zk
+{
+
+#if ZKPP_REACTOR_HAS_IO_URING
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Utility Functions                                                                                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// There is no liburing to lean on, so the three system calls are made directly
+
+int uring_setup(unsigned entries, ::io_uring_params& params)
+{
+    return int(::syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return int(::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int uring_register(int ring_fd, unsigned opcode, ptr<const void> arg, unsigned arg_count)
+{
+    return int(::syscall(__NR_io_uring_register, ring_fd, opcode, arg, arg_count));
+}
+
+/// Map \a size bytes of zeroed, private memory (or of the ring \a ring_fd at \a offset, if it is given).
+ptr<char> map_region(std::size_t size, int ring_fd = -1, ::off_t offset = 0)
+{
+    auto addr = ring_fd == -1
+              ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+              : ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+    if (addr == MAP_FAILED)
+        throw std::system_error(errno, std::system_category(), "mmap");
+    return static_cast<ptr<char>>(addr);
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// reactor::uring_loop                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The loop of \ref io_transport::io_uring. Everything the loop does is an operation on its ring: watched file
+/// descriptors are one-shot polls which are armed again after each event, every stream keeps a receive going into the
+/// buffers of a ring registered with the kernel, and what is sent on a stream during one turn of the loop becomes a
+/// single \c IORING_OP_SEND. Operations are only queued as they are made; the \c io_uring_enter which waits for the
+/// next completion submits all of them at once.
+class reactor::uring_loop final :
+        public reactor::loop
+{
+public:
+    uring_loop();
+
+    virtual ~uring_loop() noexcept;
+
+    virtual void watch(int fd, std::uint32_t events, handler& target) override;
+
+    virtual void attach(int fd, stream_handler& target) override;
+
+    virtual void send(int fd, std::vector<char> bytes) override;
+
+    virtual void forget(int fd) override;
+
+protected:
+    virtual void run() override;
+
+private:
+    static constexpr unsigned      submit_entries      = 256U;
+    static constexpr unsigned      complete_entries    = 4096U;
+    static constexpr std::uint16_t receive_buffers     = 128U;
+    static constexpr std::size_t   receive_buffer_size = 8U * 1024U;
+
+    /// The top byte of the \c user_data of an operation says what it was for; the rest is the ID it was made with.
+    enum class op_kind : std::uint64_t
+    {
+        internal = 0, //!< Removing or canceling something, which nobody waits for.
+        wake     = 1,
+        poll     = 2,
+        receive  = 3,
+        send     = 4,
+    };
+
+    static std::uint64_t user_data(op_kind kind, std::uint64_t id)
+    {
+        return (static_cast<std::uint64_t>(kind) << 56) | id;
+    }
+
+    struct watch_state
+    {
+        ptr<handler>  target;
+        std::uint32_t events;
+        std::uint64_t id;
+    };
+
+    struct stream_state
+    {
+        ptr<stream_handler> target;
+        std::uint64_t       id;
+        std::vector<char>   pending;
+        bool                sending;
+        bool                dirty;
+    };
+
+    struct send_op
+    {
+        int               fd;
+        std::uint64_t     stream_id;
+        std::vector<char> bytes;
+        std::size_t       offset;
+    };
+
+private:
+    void release() noexcept;
+
+    ptr<::io_uring_sqe> next_sqe();
+
+    /// Hand the queued operations to the kernel, waiting for \a wait_for of them to complete.
+    void submit(unsigned wait_for);
+
+    void arm_wake();
+
+    void arm_poll(int fd, std::uint32_t events, std::uint64_t id);
+
+    void arm_receive(int fd, std::uint64_t id);
+
+    void start_send(int fd, stream_state& strm);
+
+    void issue_send(std::uint64_t id, const send_op& op);
+
+    void send_dirty();
+
+    void reap();
+
+    void on_poll(std::uint64_t id, std::int32_t res);
+
+    void on_receive(std::uint64_t id, std::int32_t res, std::uint32_t flags);
+
+    void on_send(std::uint64_t id, std::int32_t res);
+
+    /// Give the receive buffer \a bid back to the kernel.
+    void recycle(std::uint16_t bid);
+
+    /// The stream with registration \a id, which is \c nullptr once it is forgotten.
+    ptr<stream_state> find_stream(std::uint64_t id, int& fd);
+
+    /// Forget the stream \a fd (if it is still the one with \a id) and tell its handler it failed with \a err.
+    void fail(int fd, std::uint64_t id, int err);
+
+private:
+    int                                        _ring_fd;
+    ptr<char>                                  _sq_ring;
+    std::size_t                                _sq_ring_size;
+    ptr<char>                                  _cq_ring;
+    std::size_t                                _cq_ring_size;
+    ptr<::io_uring_sqe>                        _sqes;
+    std::size_t                                _sqes_size;
+    ptr<unsigned>                              _sq_head;
+    ptr<unsigned>                              _sq_tail;
+    ptr<unsigned>                              _sq_array;
+    unsigned                                   _sq_mask;
+    unsigned                                   _sq_entries;
+    unsigned                                   _sq_next;
+    ptr<unsigned>                              _cq_head;
+    ptr<unsigned>                              _cq_tail;
+    ptr<::io_uring_cqe>                        _cqes;
+    unsigned                                   _cq_mask;
+    ptr<char>                                  _buffer_ring;
+    ptr<char>                                  _buffers;
+    std::uint16_t                              _buffer_tail;
+    bool                                       _multishot;
+    std::uint64_t                              _next_id;
+    std::unordered_map<std::uint64_t, int>     _fd_of;
+    std::unordered_map<int, watch_state>       _watches;
+    std::unordered_map<int, stream_state>      _streams;
+    std::unordered_map<std::uint64_t, send_op> _sends;
+    std::vector<int>                           _dirty;
+};
+
+reactor::uring_loop::uring_loop() :
+        _ring_fd(-1),
+        _sq_ring(nullptr),
+        _sq_ring_size(0U),
+        _cq_ring(nullptr),
+        _cq_ring_size(0U),
+        _sqes(nullptr),
+        _sqes_size(0U),
+        _buffer_ring(nullptr),
+        _buffers(nullptr),
+        _buffer_tail(0U),
+        _multishot(true),
+        _next_id(1U)
+{
+    try
+    {
+        ::io_uring_params params{};
+        params.flags      = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+        params.cq_entries = complete_entries;
+        _ring_fd = uring_setup(submit_entries, params);
+        if (_ring_fd == -1 && errno == EINVAL)
+        {
+            // Kernels before 5.19 do not know the last two flags
+            params            = ::io_uring_params{};
+            params.flags      = IORING_SETUP_CQSIZE;
+            params.cq_entries = complete_entries;
+            _ring_fd = uring_setup(submit_entries, params);
+        }
+        if (_ring_fd == -1)
+            throw std::system_error(errno, std::system_category(), "io_uring_setup");
+        if (!(params.features & IORING_FEAT_NODROP))
+            throw std::system_error(ENOSYS, std::system_category(), "io_uring without IORING_FEAT_NODROP");
+
+        _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+
+        _sq_ring = map_region(_sq_ring_size, _ring_fd, IORING_OFF_SQ_RING);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            _cq_ring = _sq_ring;
+        else
+            _cq_ring = map_region(_cq_ring_size, _ring_fd, IORING_OFF_CQ_RING);
+        _sqes_size = params.sq_entries * sizeof(::io_uring_sqe);
+        _sqes      = reinterpret_cast<ptr<::io_uring_sqe>>(map_region(_sqes_size, _ring_fd, IORING_OFF_SQES));
+
+        _sq_head    = reinterpret_cast<ptr<unsigned>>(_sq_ring + params.sq_off.head);
+        _sq_tail    = reinterpret_cast<ptr<unsigned>>(_sq_ring + params.sq_off.tail);
+        _sq_array   = reinterpret_cast<ptr<unsigned>>(_sq_ring + params.sq_off.array);
+        _sq_mask    = *reinterpret_cast<ptr<unsigned>>(_sq_ring + params.sq_off.ring_mask);
+        _sq_entries = params.sq_entries;
+        _sq_next    = *_sq_tail;
+        _cq_head    = reinterpret_cast<ptr<unsigned>>(_cq_ring + params.cq_off.head);
+        _cq_tail    = reinterpret_cast<ptr<unsigned>>(_cq_ring + params.cq_off.tail);
+        _cqes       = reinterpret_cast<ptr<::io_uring_cqe>>(_cq_ring + params.cq_off.cqes);
+        _cq_mask    = *reinterpret_cast<ptr<unsigned>>(_cq_ring + params.cq_off.ring_mask);
+
+        // Everything the loop does has to be there; a kernel missing any of it gets the epoll loop instead
+        std::vector<char> probe_storage(sizeof(::io_uring_probe) + 256U * sizeof(::io_uring_probe_op));
+        auto probe = reinterpret_cast<ptr<::io_uring_probe>>(probe_storage.data());
+        if (uring_register(_ring_fd, IORING_REGISTER_PROBE, probe, 256U) == -1)
+            throw std::system_error(errno, std::system_category(), "io_uring_register(IORING_REGISTER_PROBE)");
+        for (auto op : { IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE, IORING_OP_RECV, IORING_OP_SEND,
+                         IORING_OP_ASYNC_CANCEL
+                       }
+            )
+        {
+            if (op >= probe->ops_len || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+                throw std::system_error(ENOSYS, std::system_category(), "io_uring without a needed operation");
+        }
+
+        // The receive buffers are registered with the kernel as a ring it picks from and they are given back to
+        _buffer_ring = map_region(receive_buffers * sizeof(::io_uring_buf));
+        _buffers     = map_region(receive_buffers * receive_buffer_size);
+        ::io_uring_buf_reg reg{};
+        reg.ring_addr    = reinterpret_cast<std::uint64_t>(_buffer_ring);
+        reg.ring_entries = receive_buffers;
+        reg.bgid         = 0U;
+        if (uring_register(_ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1U) == -1)
+            throw std::system_error(errno, std::system_category(), "io_uring_register(IORING_REGISTER_PBUF_RING)");
+        for (std::uint16_t bid = 0U; bid < receive_buffers; ++bid)
+            recycle(bid);
+    }
+    catch (...)
+    {
+        release();
+        throw;
+    }
+}
+
+reactor::uring_loop::~uring_loop() noexcept
+{
+    release();
+}
+
+void reactor::uring_loop::release() noexcept
+{
+    // Closing the ring ends whatever was still going on in it, including its hold on the buffers
+    if (_ring_fd != -1)
+        ::close(_ring_fd);
+    if (_sqes)
+        ::munmap(_sqes, _sqes_size);
+    if (_cq_ring && _cq_ring != _sq_ring)
+        ::munmap(_cq_ring, _cq_ring_size);
+    if (_sq_ring)
+        ::munmap(_sq_ring, _sq_ring_size);
+    if (_buffers)
+        ::munmap(_buffers, receive_buffers * receive_buffer_size);
+    if (_buffer_ring)
+        ::munmap(_buffer_ring, receive_buffers * sizeof(::io_uring_buf));
+
+    _ring_fd     = -1;
+    _sqes        = nullptr;
+    _cq_ring     = nullptr;
+    _sq_ring     = nullptr;
+    _buffers     = nullptr;
+    _buffer_ring = nullptr;
+}
+
+ptr<::io_uring_sqe> reactor::uring_loop::next_sqe()
+{
+    // The submission queue only fills up when a lot was queued in one turn; the kernel takes it all right away
+    while (_sq_next - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) >= _sq_entries)
+        submit(0U);
+
+    auto idx = _sq_next & _sq_mask;
+    auto sqe = &_sqes[idx];
+    std::memset(sqe, 0, sizeof *sqe);
+    _sq_array[idx] = idx;
+    ++_sq_next;
+    return sqe;
+}
+
+void reactor::uring_loop::submit(unsigned wait_for)
+{
+    __atomic_store_n(_sq_tail, _sq_next, __ATOMIC_RELEASE);
+    auto to_submit = _sq_next - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+    if (to_submit == 0U && wait_for == 0U)
+        return;
+
+    if (uring_enter(_ring_fd, to_submit, wait_for, wait_for > 0U ? IORING_ENTER_GETEVENTS : 0U) == -1)
+    {
+        // EINTR and EBUSY (the completion queue overflowed) both go away once the completions are reaped
+        if (errno != EINTR && errno != EBUSY && errno != EAGAIN)
+            throw std::system_error(errno, std::system_category(), "io_uring_enter");
+    }
+}
+
+void reactor::uring_loop::arm_wake()
+{
+    auto sqe = next_sqe();
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = wake_fd();
+    sqe->poll32_events = EPOLLIN;
+    sqe->user_data     = user_data(op_kind::wake, 0U);
+}
+
+void reactor::uring_loop::arm_poll(int fd, std::uint32_t events, std::uint64_t id)
+{
+    auto sqe = next_sqe();
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = fd;
+    sqe->poll32_events = events;
+    sqe->user_data     = user_data(op_kind::poll, id);
+}
+
+void reactor::uring_loop::arm_receive(int fd, std::uint64_t id)
+{
+    auto sqe = next_sqe();
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = fd;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0U;
+    if (_multishot)
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+    else
+        sqe->len = std::uint32_t(receive_buffer_size);
+    sqe->user_data = user_data(op_kind::receive, id);
+}
+
+void reactor::uring_loop::watch(int fd, std::uint32_t events, handler& target)
+{
+    auto iter = _watches.find(fd);
+    if (iter != _watches.end())
+    {
+        auto sqe = next_sqe();
+        sqe->opcode    = IORING_OP_POLL_REMOVE;
+        sqe->addr      = user_data(op_kind::poll, iter->second.id);
+        sqe->user_data = user_data(op_kind::internal, 0U);
+        _fd_of.erase(iter->second.id);
+    }
+
+    auto id = _next_id++;
+    _watches[fd] = watch_state{ &target, events, id };
+    _fd_of[id]   = fd;
+    arm_poll(fd, events, id);
+}
+
+void reactor::uring_loop::attach(int fd, stream_handler& target)
+{
+    auto id = _next_id++;
+    _streams[fd] = stream_state{ &target, id, {}, false, false };
+    _fd_of[id]   = fd;
+    arm_receive(fd, id);
+}
+
+void reactor::uring_loop::send(int fd, std::vector<char> bytes)
+{
+    auto iter = _streams.find(fd);
+    if (iter == _streams.end() || bytes.empty())
+        return;
+
+    auto& strm = iter->second;
+    if (strm.pending.empty())
+        strm.pending = std::move(bytes);
+    else
+        strm.pending.insert(strm.pending.end(), bytes.begin(), bytes.end());
+
+    // Nothing goes out until the turn is over, so everything sent on the stream until then goes in one operation
+    if (!std::exchange(strm.dirty, true))
+        _dirty.push_back(fd);
+}
+
+void reactor::uring_loop::forget(int fd)
+{
+    auto watch_iter = _watches.find(fd);
+    if (watch_iter != _watches.end())
+    {
+        auto sqe = next_sqe();
+        sqe->opcode    = IORING_OP_POLL_REMOVE;
+        sqe->addr      = user_data(op_kind::poll, watch_iter->second.id);
+        sqe->user_data = user_data(op_kind::internal, 0U);
+        _fd_of.erase(watch_iter->second.id);
+        _watches.erase(watch_iter);
+        return;
+    }
+
+    auto stream_iter = _streams.find(fd);
+    if (stream_iter == _streams.end())
+        return;
+
+    // The last of what was sent still gets its try, ahead of the cancellation
+    auto& strm = stream_iter->second;
+    if (!strm.sending && !strm.pending.empty())
+        start_send(fd, strm);
+
+    auto sqe = next_sqe();
+    sqe->opcode       = IORING_OP_ASYNC_CANCEL;
+    sqe->fd           = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data    = user_data(op_kind::internal, 0U);
+    _fd_of.erase(strm.id);
+    _streams.erase(stream_iter);
+
+    // The cancellation goes by the file behind fd, so it has to reach the kernel before fd is closed
+    submit(0U);
+}
+
+void reactor::uring_loop::start_send(int fd, stream_state& strm)
+{
+    auto id = _next_id++;
+    auto& op = _sends.emplace(id, send_op{ fd, strm.id, std::move(strm.pending), 0U }).first->second;
+    strm.pending = std::vector<char>();
+    strm.sending = true;
+    issue_send(id, op);
+}
+
+void reactor::uring_loop::issue_send(std::uint64_t id, const send_op& op)
+{
+    auto sqe = next_sqe();
+    sqe->opcode    = IORING_OP_SEND;
+    sqe->fd        = op.fd;
+    sqe->addr      = reinterpret_cast<std::uint64_t>(op.bytes.data() + op.offset);
+    sqe->len       = std::uint32_t(op.bytes.size() - op.offset);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data(op_kind::send, id);
+}
+
+void reactor::uring_loop::send_dirty()
+{
+    auto dirty = std::move(_dirty);
+    _dirty.clear();
+    for (auto fd : dirty)
+    {
+        auto iter = _streams.find(fd);
+        if (iter == _streams.end())
+            continue;
+
+        auto& strm = iter->second;
+        strm.dirty = false;
+        if (!strm.sending && !strm.pending.empty())
+            start_send(fd, strm);
+    }
+}
+
+ptr<reactor::uring_loop::stream_state> reactor::uring_loop::find_stream(std::uint64_t id, int& fd)
+{
+    auto fd_iter = _fd_of.find(id);
+    if (fd_iter == _fd_of.end())
+        return nullptr;
+
+    auto iter = _streams.find(fd_iter->second);
+    if (iter == _streams.end() || iter->second.id != id)
+        return nullptr;
+
+    fd = fd_iter->second;
+    return &iter->second;
+}
+
+void reactor::uring_loop::recycle(std::uint16_t bid)
+{
+    // The entries are indexed by hand: in C++, the flexible array of io_uring_buf_ring does not start at offset 0
+    auto& slot = reinterpret_cast<ptr<::io_uring_buf>>(_buffer_ring)[_buffer_tail & (receive_buffers - 1U)];
+    slot.addr  = reinterpret_cast<std::uint64_t>(_buffers + bid * receive_buffer_size);
+    slot.len   = std::uint32_t(receive_buffer_size);
+    slot.bid   = bid;
+    ++_buffer_tail;
+
+    // The tail of the ring lives in the reserved field of its first entry
+    auto tail = reinterpret_cast<ptr<std::uint16_t>>(_buffer_ring + offsetof(::io_uring_buf, resv));
+    __atomic_store_n(tail, _buffer_tail, __ATOMIC_RELEASE);
+}
+
+void reactor::uring_loop::fail(int fd, std::uint64_t id, int err)
+{
+    auto iter = _streams.find(fd);
+    if (iter == _streams.end() || iter->second.id != id)
+        return;
+
+    auto target = iter->second.target;
+    forget(fd);
+    target->on_stream_error(fd, err);
+}
+
+void reactor::uring_loop::on_poll(std::uint64_t id, std::int32_t res)
+{
+    auto fd_iter = _fd_of.find(id);
+    if (fd_iter == _fd_of.end())
+        return;
+
+    int  fd   = fd_iter->second;
+    auto iter = _watches.find(fd);
+    if (iter == _watches.end() || iter->second.id != id)
+        return;
+
+    iter->second.target->on_ready(fd, res < 0 ? std::uint32_t(EPOLLERR) : std::uint32_t(res));
+
+    // Armed again for as long as it is watched, which makes it level-triggered like epoll
+    iter = _watches.find(fd);
+    if (iter != _watches.end() && iter->second.id == id)
+        arm_poll(fd, iter->second.events, id);
+}
+
+void reactor::uring_loop::on_receive(std::uint64_t id, std::int32_t res, std::uint32_t flags)
+{
+    bool has_buffer = (flags & IORING_CQE_F_BUFFER) != 0U;
+    auto bid        = std::uint16_t(flags >> IORING_CQE_BUFFER_SHIFT);
+
+    int  fd   = -1;
+    auto strm = find_stream(id, fd);
+    if (!strm)
+    {
+        if (has_buffer)
+            recycle(bid);
+        return;
+    }
+
+    if (res > 0 && has_buffer)
+    {
+        ptr<const char> data = _buffers + bid * receive_buffer_size;
+        auto            left = std::size_t(res);
+        while (left > 0U && (strm = find_stream(id, fd)) != nullptr)
+        {
+            auto target = strm->target;
+            auto space  = target->receive_space(fd);
+            auto count  = std::min(left, space.second);
+            std::memcpy(space.first, data, count);
+            data += count;
+            left -= count;
+            target->on_received(fd, count);
+        }
+        recycle(bid);
+
+        if (!(flags & IORING_CQE_F_MORE) && find_stream(id, fd))
+            arm_receive(fd, id);
+    }
+    else if (res == -ENOBUFS || res == -EINTR || res == -EAGAIN)
+    {
+        // The buffers ran out in a burst; they are back by now
+        if (has_buffer)
+            recycle(bid);
+        arm_receive(fd, id);
+    }
+    else if (res == -EINVAL && _multishot)
+    {
+        // Linux before 6.0 can only receive once per operation
+        _multishot = false;
+        arm_receive(fd, id);
+    }
+    else
+    {
+        if (has_buffer)
+            recycle(bid);
+        fail(fd, id, res < 0 ? -res : 0);
+    }
+}
+
+void reactor::uring_loop::on_send(std::uint64_t id, std::int32_t res)
+{
+    auto op_iter = _sends.find(id);
+    if (op_iter == _sends.end())
+        return;
+
+    auto& op   = op_iter->second;
+    int   fd   = -1;
+    auto  strm = find_stream(op.stream_id, fd);
+    if (res > 0)
+    {
+        op.offset += std::size_t(res);
+        if (strm && op.offset < op.bytes.size())
+            return issue_send(id, op);
+    }
+    else if (strm && (res == -EINTR || res == -EAGAIN))
+    {
+        return issue_send(id, op);
+    }
+
+    bool sent_all = op.offset == op.bytes.size();
+    if (strm && strm->pending.empty())
+    {
+        // The storage is kept for what the stream sends next
+        strm->pending = std::move(op.bytes);
+        strm->pending.clear();
+    }
+    auto stream_id = op.stream_id;
+    _sends.erase(op_iter);
+    if (!strm)
+        return;
+
+    strm->sending = false;
+    if (!sent_all)
+        fail(fd, stream_id, res < 0 ? -res : EPIPE);
+    else if (!strm->pending.empty())
+        start_send(fd, *strm);
+}
+
+void reactor::uring_loop::reap()
+{
+    unsigned head = *_cq_head;
+    while (head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE))
+    {
+        auto& cqe   = _cqes[head & _cq_mask];
+        auto  data  = cqe.user_data;
+        auto  res   = cqe.res;
+        auto  flags = cqe.flags;
+        __atomic_store_n(_cq_head, ++head, __ATOMIC_RELEASE);
+
+        auto id = data & ((std::uint64_t(1) << 56) - 1U);
+        switch (static_cast<op_kind>(data >> 56))
+        {
+        case op_kind::wake:
+            run_tasks();
+            if (!stopping())
+                arm_wake();
+            break;
+        case op_kind::poll:
+            on_poll(id, res);
+            break;
+        case op_kind::receive:
+            on_receive(id, res, flags);
+            break;
+        case op_kind::send:
+            on_send(id, res);
+            break;
+        case op_kind::internal:
+            break;
+        }
+    }
+}
+
+void reactor::uring_loop::run()
+{
+    arm_wake();
+    while (!stopping())
+    {
+        send_dirty();
+        submit(1U);
+        reap();
+    }
+
+    // Whoever posted these is waiting on them
+    run_tasks();
+}
+
+std::shared_ptr<reactor::loop> reactor::make_uring_loop()
+{
+    return std::make_shared<uring_loop>();
+}
+
+#else
+
+std::shared_ptr<reactor::loop> reactor::make_uring_loop()
+{
+    throw std::system_error(ENOSYS, std::system_category(), "io_uring is not available on this platform");
+}
+
+#endif
+
+}
@@ -0,0 +1,506 @@
+#include "large_value.hpp"
+
+#include <zk/error.hpp>
+#include <zk/multi.hpp>
+#include <zk/optional.hpp>
+#include <zk/results.hpp>
+#include <zk/types.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace zk::recipes
+{
+
+/// The first word of every manifest, which also versions the layout.
+static constexpr char manifest_magic[] = "zkpp-large-value/1";
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// large_value::manifest                                                                                              //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const large_value::manifest& self)
+{
+    os << "{token=" << large_value::chunk_name(self.token, 0U).substr(0U, 16U);
+    os << " size=" << self.size;
+    os << " chunks=" << self.chunk_count << 'x' << self.chunk_size;
+    return os << '}';
+}
+
+std::string to_string(const large_value::manifest& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+buffer large_value::encode_manifest(const manifest& src)
+{
+    std::ostringstream os;
+    os << manifest_magic
+       << std::hex << std::setfill('0')
+       << " token=" << std::setw(16) << src.token
+       << std::dec
+       << " size=" << src.size
+       << " chunk_size=" << src.chunk_size
+       << " chunks=" << src.chunk_count
+       << std::hex
+       << " checksum=" << std::setw(16) << src.checksum;
+    auto text = os.str();
+    return buffer(text.data(), text.data() + text.size());
+}
+
+outcome<large_value::manifest> large_value::decode_manifest(const buffer& data)
+{
+    if (data.size() == 0U)
+        return manifest();
+
+    std::istringstream is(std::string(data.data(), data.size()));
+    std::string        magic;
+    manifest           out;
+    auto               field = [&] (const std::string& name, std::uint64_t& target, int base)
+                               {
+                                   std::string part;
+                                   if (!(is >> part) || part.compare(0U, name.size() + 1U, name + "=") != 0)
+                                       return false;
+                                   try
+                                   {
+                                       target = std::stoull(part.substr(name.size() + 1U), nullptr, base);
+                                       return true;
+                                   }
+                                   catch (const std::exception&)
+                                   {
+                                       return false;
+                                   }
+                               };
+
+    bool parsed = (is >> magic)
+               && magic == manifest_magic
+               && field("token", out.token, 16)
+               && field("size", out.size, 10)
+               && field("chunk_size", out.chunk_size, 10)
+               && field("chunks", out.chunk_count, 10)
+               && field("checksum", out.checksum, 16);
+
+    // Anything the parse skipped over (signs, stray spaces, trailing text) shows up as a difference from the canonical
+    // form, and the chunks have to add up to the size
+    if (!parsed || !(encode_manifest(out) == data))
+        return error_code::marshalling_error;
+    if (out.size == 0U ? out.chunk_count != 0U
+                       : out.chunk_size == 0U || out.chunk_count != (out.size + out.chunk_size - 1U) / out.chunk_size
+       )
+        return error_code::marshalling_error;
+    return out;
+}
+
+std::string large_value::chunk_name(std::uint64_t token, std::uint64_t index)
+{
+    std::ostringstream os;
+    os << std::hex << std::setfill('0') << std::setw(16) << token
+       << '-'
+       << std::dec << std::setw(6) << index;
+    return os.str();
+}
+
+std::uint64_t large_value::checksum_of(const char* data, std::size_t size) noexcept
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (std::size_t idx = 0U; idx < size; ++idx)
+    {
+        hash ^= static_cast<unsigned char>(data[idx]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/// Erase every chunk of \a src in one go, ignoring failures (the chunks may be gone already), then call \a then.
+static void erase_chunks(client                       conn,
+                         const zk::path&              location,
+                         const large_value::manifest& src,
+                         std::function<void ()>       then
+                        )
+{
+    if (src.chunk_count == 0U)
+    {
+        then();
+        return;
+    }
+
+    auto remaining = std::make_shared<std::atomic<std::uint64_t>>(src.chunk_count);
+    auto done      = std::make_shared<std::function<void ()>>(std::move(then));
+    for (std::uint64_t idx = 0U; idx < src.chunk_count; ++idx)
+    {
+        conn.erase(location / large_value::chunk_name(src.token, idx),
+                   version::any(),
+                   [remaining, done] (outcome<void>)
+                   {
+                       if (--*remaining == 0U)
+                           (*done)();
+                   }
+                  );
+    }
+}
+
+/// Get what the transaction in \a result failed on: the index of the operation and the reason.
+static std::pair<std::size_t, error_code> failure_of(const outcome<multi_result>& result)
+{
+    if (result.code() == error_code::transaction_failed)
+    {
+        try
+        {
+            std::rethrow_exception(result.error());
+        }
+        catch (const transaction_failed& ex)
+        {
+            return { ex.failed_op_index(), ex.underlying_cause() };
+        }
+        catch (...)
+        { }
+    }
+    return { std::size_t(-1), result.code() };
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// large_value::write_operation                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Writes one value: make sure \c location exists and note the manifest it holds, create every chunk but the last
+/// batch, then commit the last batch with the new manifest. If the manifest changed in the meantime, only the final
+/// transaction is tried again, against the newer manifest.
+struct large_value::write_operation final :
+        std::enable_shared_from_this<large_value::write_operation>
+{
+    explicit write_operation(client conn, zk::path location, options opts, buffer data, callback<void> on_complete) :
+            conn(std::move(conn)),
+            location(std::move(location)),
+            opts(std::move(opts)),
+            data(std::move(data)),
+            on_complete(std::move(on_complete))
+    {
+        std::random_device source;
+        while (next.token == 0U)
+            next.token = (std::uint64_t(source()) << 32U) | std::uint64_t(source());
+
+        next.size     = this->data.size();
+        next.checksum = checksum_of(this->data.data(), this->data.size());
+        if (next.size > 0U)
+        {
+            next.chunk_size  = std::max<std::size_t>(this->opts.chunk_size(), 1U);
+            next.chunk_count = (next.size + next.chunk_size - 1U) / next.chunk_size;
+        }
+
+        // Split the chunks into the transactions they are created in
+        std::uint64_t per_batch = 1U;
+        if (next.chunk_size > 0U)
+            per_batch = std::max<std::uint64_t>(this->opts.max_transaction_bytes() / next.chunk_size, 1U);
+        for (std::uint64_t first = 0U; first < next.chunk_count; first += per_batch)
+            batches.emplace_back(first, std::min(first + per_batch, next.chunk_count));
+    }
+
+    void start()
+    {
+        auto self = shared_from_this();
+        conn.get(location,
+                 [self] (outcome<get_result> result)
+                 {
+                     if (result.code() == error_code::no_entry)
+                         self->create_location();
+                     else if (!self->note_replaced(std::move(result)))
+                         self->finish(self->status);
+                     else
+                         self->create_chunks();
+                 }
+                );
+    }
+
+    void create_location()
+    {
+        auto self = shared_from_this();
+        conn.create(location,
+                    buffer(),
+                    create_mode::normal,
+                    [self] (outcome<create_result> result)
+                    {
+                        if (result || result.code() == error_code::entry_exists)
+                            self->start();
+                        else
+                            self->finish(outcome<void>(result.code(), result.error()));
+                    }
+                   );
+    }
+
+    /// Remember the manifest in \a result as the one to replace.
+    ///
+    /// \returns \c false with the failure set in \c status if the manifest could not be read.
+    bool note_replaced(outcome<get_result> result)
+    {
+        if (!result)
+        {
+            status = outcome<void>(result.code(), result.error());
+            return false;
+        }
+
+        auto decoded = decode_manifest(result->data());
+        if (!decoded)
+        {
+            status = outcome<void>(decoded.code());
+            return false;
+        }
+        replaced         = *decoded;
+        replaced_version = result->stat().data_version;
+        return true;
+    }
+
+    multi_op batch(std::size_t index) const
+    {
+        multi_op txn;
+        for (auto idx = batches[index].first; idx < batches[index].second; ++idx)
+        {
+            auto offset = idx * next.chunk_size;
+            auto end    = std::min(offset + next.chunk_size, next.size);
+            txn.push_back(op::create((location / chunk_name(next.token, idx)).str(),
+                                     buffer(data.data() + offset, data.data() + end)
+                                    )
+                         );
+        }
+        return txn;
+    }
+
+    void create_chunks()
+    {
+        if (batches.size() <= 1U)
+        {
+            flip();
+            return;
+        }
+
+        // Every batch but the last is in flight at once; the server applies them in order, but they are independent
+        in_flight = batches.size() - 1U;
+        auto self = shared_from_this();
+        for (std::size_t idx = 0U; idx + 1U < batches.size(); ++idx)
+        {
+            conn.commit(batch(idx),
+                        [self] (outcome<multi_result> result)
+                        {
+                            std::unique_lock<std::mutex> ax(self->protect);
+                            if (!result && self->status)
+                                self->status = outcome<void>(result.code(), result.error());
+                            if (--self->in_flight > 0U)
+                                return;
+                            bool failed = !self->status;
+                            ax.unlock();
+
+                            if (failed)
+                                self->abandon();
+                            else
+                                self->flip();
+                        }
+                       );
+        }
+    }
+
+    void flip()
+    {
+        auto txn = batches.empty() ? multi_op() : batch(batches.size() - 1U);
+        txn.push_back(op::set(location.str(), encode_manifest(next), replaced_version));
+        auto manifest_index = txn.size() - 1U;
+
+        auto self = shared_from_this();
+        conn.commit(std::move(txn),
+                    [self, manifest_index] (outcome<multi_result> result)
+                    {
+                        if (result)
+                        {
+                            erase_chunks(self->conn, self->location, self->replaced, [self] { self->finish({}); });
+                            return;
+                        }
+
+                        auto failure = failure_of(result);
+                        if (failure.first == manifest_index && failure.second == error_code::version_mismatch)
+                        {
+                            // Another writer flipped first: replace its value instead
+                            self->conn.get(self->location,
+                                           [self] (outcome<get_result> latest)
+                                           {
+                                               if (self->note_replaced(std::move(latest)))
+                                                   self->flip();
+                                               else
+                                                   self->abandon();
+                                           }
+                                          );
+                        }
+                        else
+                        {
+                            self->status = outcome<void>(result.code(), result.error());
+                            self->abandon();
+                        }
+                    }
+                   );
+    }
+
+    /// Erase whatever was created of the new value, then fail with \c status.
+    void abandon()
+    {
+        auto self = shared_from_this();
+        erase_chunks(conn, location, next, [self] { self->finish(self->status); });
+    }
+
+    void finish(outcome<void> result)
+    {
+        on_complete(std::move(result));
+    }
+
+    client         conn;
+    zk::path       location;
+    options        opts;
+    buffer         data;
+    callback<void> on_complete;
+
+    manifest                                              next;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> batches; //!< The [first, last) chunks of each transaction
+    manifest                                              replaced;
+    version                                               replaced_version = version::any();
+
+    std::mutex    protect;
+    std::size_t   in_flight = 0U;
+    outcome<void> status;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// large_value::read_operation                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Reads one value: the manifest, then all of its chunks at once. If a chunk is missing, the value was replaced while
+/// it was being read, so the read starts over with the newer manifest.
+struct large_value::read_operation final :
+        std::enable_shared_from_this<large_value::read_operation>
+{
+    explicit read_operation(client conn, zk::path location, options opts, callback<buffer> on_complete) :
+            conn(std::move(conn)),
+            location(std::move(location)),
+            opts(std::move(opts)),
+            on_complete(std::move(on_complete))
+    { }
+
+    void start()
+    {
+        ++attempts;
+        auto self = shared_from_this();
+        conn.get(location, [self] (outcome<get_result> result) { self->read_chunks(std::move(result)); });
+    }
+
+    void read_chunks(outcome<get_result> result)
+    {
+        if (!result)
+            return on_complete(outcome<buffer>(result.code(), result.error()));
+
+        auto decoded = decode_manifest(result->data());
+        if (!decoded)
+            return on_complete(outcome<buffer>(decoded.code()));
+        current = *decoded;
+        if (current.chunk_count == 0U)
+            return on_complete(buffer());
+
+        names.clear();
+        for (std::uint64_t idx = 0U; idx < current.chunk_count; ++idx)
+            names.push_back((location / chunk_name(current.token, idx)).str());
+
+        auto self = shared_from_this();
+        conn.get_many({ names.begin(), names.end() },
+                      [self] (outcome<std::vector<outcome<get_result>>> chunks)
+                      {
+                          self->assemble(std::move(chunks));
+                      }
+                     );
+    }
+
+    void assemble(outcome<std::vector<outcome<get_result>>> chunks)
+    {
+        if (!chunks)
+            return on_complete(outcome<buffer>(chunks.code(), chunks.error()));
+
+        std::vector<char> out;
+        out.reserve(current.size);
+        for (const auto& chunk : *chunks)
+        {
+            if (chunk.code() == error_code::no_entry && attempts < opts.max_read_attempts())
+                return start();
+            else if (!chunk)
+                return on_complete(outcome<buffer>(chunk.code(), chunk.error()));
+
+            const auto& piece = chunk->data();
+            out.insert(out.end(), piece.data(), piece.data() + piece.size());
+        }
+
+        if (out.size() != current.size || checksum_of(out.data(), out.size()) != current.checksum)
+            return on_complete(outcome<buffer>(error_code::marshalling_error));
+        on_complete(buffer(out.data(), out.data() + out.size()));
+    }
+
+    client           conn;
+    zk::path         location;
+    options          opts;
+    callback<buffer> on_complete;
+
+    std::size_t              attempts = 0U;
+    manifest                 current;
+    std::vector<std::string> names; //!< The chunks being read, kept alive for \c get_many
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// large_value                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+large_value::large_value(client conn, zk::path location) :
+        large_value(std::move(conn), std::move(location), options())
+{ }
+
+large_value::large_value(client conn, zk::path location, options opts) :
+        _conn(std::move(conn)),
+        _location(std::move(location)),
+        _opts(std::move(opts))
+{ }
+
+large_value::~large_value() noexcept = default;
+
+future<buffer> large_value::read() const
+{
+    return future_from_callback<buffer>([&] (auto cb) { this->read(std::move(cb)); });
+}
+
+void large_value::read(callback<buffer> on_complete) const
+{
+    std::make_shared<read_operation>(_conn, _location, _opts, std::move(on_complete))->start();
+}
+
+future<void> large_value::write(buffer data)
+{
+    return future_from_callback<void>([&] (auto cb) { this->write(std::move(data), std::move(cb)); });
+}
+
+void large_value::write(buffer data, callback<void> on_complete)
+{
+    std::make_shared<write_operation>(_conn, _location, _opts, std::move(data), std::move(on_complete))->start();
+}
+
+future<void> large_value::erase()
+{
+    return _conn.erase_recursive(_location);
+}
+
+void large_value::erase(callback<void> on_complete)
+{
+    _conn.erase_recursive(_location, std::move(on_complete));
+}
+
+}
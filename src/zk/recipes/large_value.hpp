@@ -0,0 +1,157 @@
+/// \file
+/// Defines \ref zk::recipes::large_value, which stores values too large for one entry in chunks under a manifest.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/buffer.hpp>
+#include <zk/callback.hpp>
+#include <zk/client.hpp>
+#include <zk/future.hpp>
+#include <zk/outcome.hpp>
+#include <zk/path.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+namespace zk::recipes
+{
+
+/// \addtogroup Recipes
+/// \{
+
+/// Stores a value larger than the server's limit on a request (\c jute.maxbuffer, 1 MiB by default), such as a routing
+/// table of a few dozen megabytes. The \ref location entry holds a \ref manifest naming a set of chunk entries under
+/// it; each set of chunks is named by a random token, so the chunks of a value being written never touch the ones
+/// readers are using.
+///
+/// \code
+/// zk::recipes::large_value table(client, zk::path("/routing/table"));
+/// table.write(serialized).get();
+/// zk::buffer current = table.read().get();
+/// \endcode
+///
+/// A write creates the new chunks in transactions of up to \ref options::max_transaction_bytes, all sent at once, then
+/// commits the last of them together with the new manifest in a transaction conditioned on the version of the manifest
+/// it replaces: the value changes all at once, when the manifest flips, or not at all. The chunks of the replaced value
+/// are erased after the flip. Concurrent writers do not corrupt the value; the last flip wins.
+///
+/// A read gets the manifest, then every chunk it names with \ref client::get_many, so they are all in flight at once
+/// and the read costs two round trips plus the transfer time, however many chunks there are. The value is checked
+/// against the size and checksum in the manifest. A reader which loses the race with the cleanup of a write (a chunk
+/// it was about to read is erased) reads the new manifest and tries again, so it never sees a torn value.
+///
+/// A writer which fails after creating chunks erases them again; one which crashes leaves them behind until the value
+/// is \ref erase "erased".
+class large_value final
+{
+public:
+    /// Controls how values are split.
+    class options final
+    {
+    public:
+        options() = default;
+
+        /// The size of a chunk. The last chunk of a value holds what is left.
+        std::size_t  chunk_size() const { return _chunk_size; }
+        std::size_t& chunk_size()       { return _chunk_size; }
+
+        /// The most chunk data put in one transaction. Keep it under the server's \c jute.maxbuffer, with room for the
+        /// names and the manifest; a transaction always holds at least one chunk.
+        std::size_t  max_transaction_bytes() const { return _max_transaction_bytes; }
+        std::size_t& max_transaction_bytes()       { return _max_transaction_bytes; }
+
+        /// How many times a read starts over when the chunks it was reading were replaced under it.
+        std::size_t  max_read_attempts() const { return _max_read_attempts; }
+        std::size_t& max_read_attempts()       { return _max_read_attempts; }
+
+    private:
+        std::size_t _chunk_size            = 480U * 1024U;
+        std::size_t _max_transaction_bytes = 960U * 1024U;
+        std::size_t _max_read_attempts     = 5U;
+    };
+
+    /// What the \ref location entry holds: which chunks make up the current value and how to check them.
+    struct manifest final
+    {
+        std::uint64_t token       = 0U; //!< Names the chunks of this value (see \ref chunk_name)
+        std::uint64_t size        = 0U; //!< The size of the value
+        std::uint64_t chunk_size  = 0U;
+        std::uint64_t chunk_count = 0U;
+        std::uint64_t checksum    = 0U; //!< The 64-bit FNV-1a hash of the value (see \ref checksum_of)
+    };
+
+public:
+    /// \{
+    /// Keep a value at \a location. Nothing is sent to the server until the first operation; the parent of
+    /// \a location must exist by the first write.
+    explicit large_value(client conn, zk::path location);
+    explicit large_value(client conn, zk::path location, options opts);
+    /// \}
+
+    large_value(const large_value&) = default;
+    large_value(large_value&&) noexcept = default;
+
+    large_value& operator=(const large_value&) = default;
+    large_value& operator=(large_value&&) noexcept = default;
+
+    ~large_value() noexcept;
+
+    /// The entry holding the \ref manifest.
+    const zk::path& location() const noexcept { return _location; }
+
+    /// \{
+    /// Read the current value. A \ref location which exists but is empty holds an empty value.
+    ///
+    /// \throws no_entry If nothing was ever written at \ref location, the future is delivered with \ref no_entry; it is
+    ///  also the error when the chunks kept being replaced for \ref options::max_read_attempts.
+    /// \throws marshalling_error If the manifest is not one, or the chunks do not add up to the value it describes.
+    future<buffer> read() const;
+    void read(callback<buffer> on_complete) const;
+    /// \}
+
+    /// \{
+    /// Replace the value with \a data, creating \ref location if it does not exist yet.
+    future<void> write(buffer data);
+    void write(buffer data, callback<void> on_complete);
+    /// \}
+
+    /// \{
+    /// Erase \ref location with every chunk under it (including ones left behind by crashed writers).
+    future<void> erase();
+    void erase(callback<void> on_complete);
+    /// \}
+
+    /// \{
+    /// The text \ref location holds for \a src and back. Decoding an empty entry gives an empty \ref manifest; anything
+    /// else which is not a manifest fails with \ref error_code::marshalling_error.
+    static buffer encode_manifest(const manifest& src);
+    static outcome<manifest> decode_manifest(const buffer& data);
+    /// \}
+
+    /// The name of chunk \a index of the value with \a token: \a token as 16 hex digits, a \c '-' and \a index as
+    /// (at least) 6 decimal digits, so the chunks of one value sort in order.
+    static std::string chunk_name(std::uint64_t token, std::uint64_t index);
+
+    /// The 64-bit FNV-1a hash of the \a size bytes at \a data.
+    static std::uint64_t checksum_of(const char* data, std::size_t size) noexcept;
+
+private:
+    struct write_operation;
+    struct read_operation;
+
+private:
+    client   _conn;
+    zk::path _location;
+    options  _opts;
+};
+
+std::ostream& operator<<(std::ostream&, const large_value::manifest&);
+
+std::string to_string(const large_value::manifest&);
+
+/// \}
+
+}
@@ -0,0 +1,142 @@
+#include <zk/server/server_tests.hpp>
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/tests/test.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "large_value.hpp"
+
+namespace zk::recipes
+{
+
+static buffer buffer_from(const std::string& text)
+{
+    return buffer(text.data(), text.data() + text.size());
+}
+
+static buffer pattern(std::size_t size, char seed)
+{
+    std::string out(size, '\0');
+    for (std::size_t idx = 0U; idx < size; ++idx)
+        out[idx] = static_cast<char>(seed + static_cast<char>(idx % 31U));
+    return buffer_from(out);
+}
+
+GTEST_TEST(large_value_manifest_tests, encoding)
+{
+    large_value::manifest src;
+    src.token       = 0x00ab'cdefU;
+    src.size        = 2500U;
+    src.chunk_size  = 1000U;
+    src.chunk_count = 3U;
+    src.checksum    = 0x1234U;
+
+    auto encoded = large_value::encode_manifest(src);
+    CHECK_TRUE(buffer_from("zkpp-large-value/1 token=0000000000abcdef size=2500 chunk_size=1000 chunks=3 "
+                           "checksum=0000000000001234"
+                          )
+               == encoded
+              );
+    auto decoded = large_value::decode_manifest(encoded).value();
+    CHECK_EQ(src.token,       decoded.token);
+    CHECK_EQ(src.size,        decoded.size);
+    CHECK_EQ(src.chunk_size,  decoded.chunk_size);
+    CHECK_EQ(src.chunk_count, decoded.chunk_count);
+    CHECK_EQ(src.checksum,    decoded.checksum);
+    CHECK_EQ("{token=0000000000abcdef size=2500 chunks=3x1000}", to_string(decoded));
+
+    CHECK_EQ(0U, large_value::decode_manifest(buffer()).value().chunk_count);
+
+    // The chunks have to add up to the size
+    src.chunk_count = 2U;
+    CHECK_EQ(error_code::marshalling_error, large_value::decode_manifest(large_value::encode_manifest(src)).code());
+    CHECK_EQ(error_code::marshalling_error, large_value::decode_manifest(buffer_from("routing table")).code());
+    CHECK_EQ(error_code::marshalling_error,
+             large_value::decode_manifest(buffer_from("zkpp-large-value/1 token=1 size=0 chunk_size=0 chunks=0 "
+                                                      "checksum=0"
+                                                     )
+                                         ).code()
+            );
+}
+
+GTEST_TEST(large_value_manifest_tests, chunk_names)
+{
+    CHECK_EQ("00000000000000ff-000000", large_value::chunk_name(0xffU, 0U));
+    CHECK_EQ("00000000000000ff-000042", large_value::chunk_name(0xffU, 42U));
+    CHECK_EQ("00000000000000ff-1234567", large_value::chunk_name(0xffU, 1234567U));
+    CHECK_LT(large_value::chunk_name(1U, 9U), large_value::chunk_name(1U, 10U));
+}
+
+GTEST_TEST(large_value_manifest_tests, checksum)
+{
+    // Reference values of 64-bit FNV-1a
+    CHECK_EQ(0xcbf29ce484222325ULL, large_value::checksum_of("", 0U));
+    CHECK_EQ(0xaf63dc4c8601ec8cULL, large_value::checksum_of("a", 1U));
+}
+
+class large_value_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(large_value_tests, write_and_read)
+{
+    client c = get_connected_client();
+
+    large_value::options opts;
+    opts.chunk_size()            = 1000U;
+    opts.max_transaction_bytes() = 3000U;
+    large_value value(c, zk::path("/large"), opts);
+    CHECK_THROWS(no_entry) { value.read().get(); };
+
+    auto first = pattern(10'500U, 'a');
+    value.write(first).get();
+    CHECK_TRUE(first == value.read().get());
+    CHECK_EQ(11U, c.get_children("/large").get().children().size());
+
+    // A new value replaces the chunks of the old one
+    auto second = pattern(2'000U, 'A');
+    value.write(second).get();
+    CHECK_TRUE(second == value.read().get());
+    CHECK_EQ(2U, c.get_children("/large").get().children().size());
+
+    value.write(buffer()).get();
+    CHECK_TRUE(buffer() == value.read().get());
+    CHECK_EQ(0U, c.get_children("/large").get().children().size());
+
+    value.erase().get();
+    CHECK_FALSE(c.exists("/large").get());
+}
+
+GTEST_TEST_F(large_value_tests, readers_never_see_torn_values)
+{
+    client c = get_connected_client();
+
+    large_value::options opts;
+    opts.chunk_size()        = 512U;
+    opts.max_read_attempts() = 100U;
+    large_value writer(c, zk::path("/contended"), opts);
+    large_value reader(get_connected_client(), zk::path("/contended"), opts);
+
+    std::vector<buffer> versions;
+    for (char seed : { 'a', 'k', 'u' })
+        versions.push_back(pattern(5'000U, seed));
+    writer.write(versions[0]).get();
+
+    std::thread writes([&]
+                       {
+                           for (std::size_t idx = 0U; idx < 30U; ++idx)
+                               writer.write(versions[(idx + 1U) % versions.size()]).get();
+                       }
+                      );
+    for (std::size_t idx = 0U; idx < 30U; ++idx)
+    {
+        auto seen = reader.read().get();
+        CHECK_TRUE(seen == versions[0] || seen == versions[1] || seen == versions[2]);
+    }
+    writes.join();
+}
+
+}
@@ -0,0 +1,574 @@
+#include "leader_election.hpp"
+
+#include <zk/cancellation.hpp>
+#include <zk/error.hpp>
+#include <zk/string_view.hpp>
+#include <zk/types.hpp>
+#include <zk/watch_stream.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace zk::recipes
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Candidates                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static constexpr string_view candidate_prefix = "candidate-";
+static constexpr string_view published_name   = "leader";
+
+/// The sequence number of the candidate named \a name or \c -1 if it is not named like one.
+static std::int64_t candidate_sequence(string_view name) noexcept
+{
+    if (name.size() <= candidate_prefix.size() || name.substr(0U, candidate_prefix.size()) != candidate_prefix)
+        return -1;
+
+    std::int64_t out = 0;
+    for (char c : name.substr(candidate_prefix.size()))
+    {
+        if (c < '0' || c > '9')
+            return -1;
+        out = out * 10 + (c - '0');
+    }
+    return out;
+}
+
+/// Finds the candidate ahead of one, and whether that one is the leader, from the visited children of the election.
+struct candidate_scan final
+{
+    explicit candidate_scan(std::string own_name) :
+            own_name(std::move(own_name)),
+            own_sequence(candidate_sequence(this->own_name))
+    { }
+
+    void visit(string_view name)
+    {
+        if (name == own_name)
+        {
+            found_self = true;
+            return;
+        }
+
+        auto sequence = candidate_sequence(name);
+        if (sequence < 0 || sequence >= own_sequence)
+            return;
+
+        ++ahead;
+        if (sequence > predecessor_sequence)
+        {
+            predecessor.assign(name.data(), name.size());
+            predecessor_sequence = sequence;
+        }
+    }
+
+    std::string  own_name;
+    std::int64_t own_sequence;
+    bool         found_self           = false;
+    std::size_t  ahead                = 0U;
+    std::string  predecessor;
+    std::int64_t predecessor_sequence = -1;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// leader_election::state                                                                                             //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The operations hold the state strongly, since they always complete. The watches (on the predecessor and through the
+/// \c watch_stream of the published entry), the session subscription and the timers of publishing retries only hold it
+/// weakly, so a candidate which resigned can go away before they ever trigger.
+struct leader_election::state final :
+        std::enable_shared_from_this<leader_election::state>
+{
+    static constexpr std::chrono::milliseconds first_retry_delay = std::chrono::milliseconds(50);
+    static constexpr std::chrono::milliseconds max_retry_delay   = std::chrono::seconds(5);
+
+    enum class phase
+    {
+        creating,
+        following,
+        leading,
+        resigned,
+        failed,
+    };
+
+    explicit state(client conn, zk::path dir, buffer data, listener on_change) :
+            conn(std::move(conn)),
+            dir(std::move(dir)),
+            published_path(this->dir / published_name),
+            data(std::move(data)),
+            on_change(std::move(on_change))
+    { }
+
+    void start()
+    {
+        std::weak_ptr<state> weak_self = shared_from_this();
+        published_stream.emplace(conn,
+                                 published_path,
+                                 [weak_self] (outcome<watch_update> update)
+                                 {
+                                     if (auto self = weak_self.lock())
+                                         self->on_published_update(std::move(update));
+                                 }
+                                );
+        auto sub = conn.subscribe_state([weak_self] (zk::state changed)
+                                        {
+                                            if (changed != zk::state::connected)
+                                                return;
+                                            if (auto self = weak_self.lock())
+                                                self->retry_publish();
+                                        }
+                                       );
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            session_watch = std::move(sub);
+        }
+
+        auto self = shared_from_this();
+        conn.create(dir / candidate_prefix,
+                    data,
+                    create_mode::ephemeral | create_mode::sequential,
+                    [self] (outcome<create_result> result) { self->on_created(std::move(result)); }
+                   );
+    }
+
+    void on_created(outcome<create_result> result)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (result)
+            entry.emplace(std::move(result).value().name());
+
+        if (current == phase::creating)
+        {
+            if (result)
+                current = phase::following;
+            ax.unlock();
+
+            if (result)
+                scan();
+            else
+                fail(result.code(), result.error());
+        }
+        else
+        {
+            // Resigned before the entry was made
+            auto on_complete = std::move(on_resigned);
+            ax.unlock();
+
+            if (result)
+                erase(*entry, std::move(on_complete));
+            else if (on_complete)
+                on_complete(outcome<void>());
+        }
+    }
+
+    void scan()
+    {
+        auto self  = shared_from_this();
+        auto found = std::make_shared<candidate_scan>(std::string(entry->basename()));
+        conn.for_each_child(dir,
+                            [found] (string_view name) { found->visit(name); },
+                            [self, found] (outcome<zk::stat> result) { self->on_scanned(result, *found); }
+                           );
+    }
+
+    void on_scanned(const outcome<zk::stat>& result, const candidate_scan& found)
+    {
+        if (!result)
+            fail(result.code(), result.error());
+        else if (!found.found_self)
+            fail(error_code::no_entry, nullptr);
+        else if (found.ahead == 0U)
+            elected();
+        else if (is(phase::following))
+        {
+            // If the predecessor is the leader, its deletion is all it takes to lead
+            bool predecessor_leads = found.ahead == 1U;
+            auto self = shared_from_this();
+            conn.watch_exists(dir / found.predecessor,
+                              [self, predecessor_leads] (outcome<watch_exists_result> result)
+                              {
+                                  self->on_watched(std::move(result), predecessor_leads);
+                              },
+                              on_predecessor_event(predecessor_leads)
+                             );
+        }
+    }
+
+    void on_watched(outcome<watch_exists_result> result, bool predecessor_leads)
+    {
+        if (!result)
+            fail(result.code(), result.error());
+        else if (!result->initial() && predecessor_leads)
+            elected();
+        else if (!result->initial() && is(phase::following))
+            scan();
+    }
+
+    event_callback on_predecessor_event(bool predecessor_leads)
+    {
+        std::weak_ptr<state> weak_self = shared_from_this();
+        return [weak_self, predecessor_leads] (const event& ev)
+               {
+                   auto self = weak_self.lock();
+                   if (!self)
+                       return;
+
+                   if (ev.type() == event_type::session && ev.state() == zk::state::expired_session)
+                       self->fail(error_code::session_expired, nullptr);
+                   else if (ev.type() == event_type::session && ev.state() == zk::state::closed)
+                       self->fail(error_code::closed, nullptr);
+                   else if (ev.type() == event_type::erased && predecessor_leads)
+                       self->elected();
+                   else if (self->is(phase::following))
+                       self->scan();
+               };
+    }
+
+    void elected()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (current != phase::following)
+            return;
+        current = phase::leading;
+        ax.unlock();
+
+        on_change(true);
+        publish();
+    }
+
+    void publish()
+    {
+        auto self = shared_from_this();
+        conn.create(published_path,
+                    data,
+                    create_mode::ephemeral,
+                    [self] (outcome<create_result> result)
+                    {
+                        if (!self->is(phase::leading))
+                        {
+                            // Resigned while the creation was in flight, which it missed
+                            if (result)
+                                self->conn.erase(self->published_path, version::any(), [] (outcome<void>) { });
+                        }
+                        else if (result)
+                        {
+                            std::unique_lock<std::mutex> ax(self->protect);
+                            self->retry_delay = first_retry_delay;
+                        }
+                        else if (result.code() == error_code::entry_exists)
+                        {
+                            self->check_published();
+                        }
+                        else
+                        {
+                            self->publish_failed(result.code(), result.error());
+                        }
+                    }
+                   );
+    }
+
+    /// Publishing failed with \a code. A failure the session can recover from is tried again once the session is
+    /// connected again or after a delay (whichever comes first); anything else ends the candidacy, which tells the
+    /// listener and takes the entry of the candidate out of the queue so the next one can lead.
+    void publish_failed(error_code code, std::exception_ptr cause)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (current != phase::leading || retry_pending)
+            return;
+
+        if (!is_transport_error(code) && code != error_code::throttled)
+        {
+            ax.unlock();
+            fail(code, std::move(cause));
+            return erase(*entry, nullptr);
+        }
+
+        retry_pending = true;
+        auto delay    = retry_delay;
+        retry_delay   = std::min<std::chrono::milliseconds>(retry_delay * 2, max_retry_delay);
+        ax.unlock();
+
+        std::weak_ptr<state> weak_self = shared_from_this();
+        auto timer = cancellation_token::after(delay);
+        // The timer keeps itself alive through its own handler until it fires
+        timer.on_cancel([weak_self, timer]
+                        {
+                            if (auto self = weak_self.lock())
+                                self->retry_publish();
+                        }
+                       );
+    }
+
+    /// Publish again if a retry is pending. Whatever the failed attempt did get done is found by \ref check_published.
+    void retry_publish()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (current != phase::leading || !std::exchange(retry_pending, false))
+            return;
+        ax.unlock();
+        publish();
+    }
+
+    /// The published entry is already there: it is either left over from a creation whose reply was lost or belongs to
+    /// a previous leader whose session has not ended yet, which is told apart by the session which owns it.
+    void check_published()
+    {
+        auto self = shared_from_this();
+        conn.exists_many({ published_path, *entry },
+                         [self] (outcome<std::vector<outcome<exists_result>>> results)
+                         {
+                             if (!results)
+                                 return self->publish_failed(results.code(), results.error());
+                             else if (!self->is(phase::leading))
+                                 return;
+
+                             const auto& published = (*results)[0U];
+                             const auto& own       = (*results)[1U];
+                             if (!published)
+                                 self->publish_failed(published.code(), published.error());
+                             else if (!own)
+                                 self->publish_failed(own.code(), own.error());
+                             else if (!own->stat())
+                                 return;
+                             else if (!published->stat())
+                                 self->publish();
+                             else if (published->stat()->ephemeral_owner != own->stat()->ephemeral_owner)
+                                 self->publish_after_previous();
+                         }
+                        );
+    }
+
+    /// Publish again once the entry of a previous leader goes away.
+    void publish_after_previous()
+    {
+        std::weak_ptr<state> weak_self = shared_from_this();
+        conn.watch_exists(published_path,
+                          [weak_self] (outcome<watch_exists_result> result)
+                          {
+                              auto self = weak_self.lock();
+                              if (!self)
+                                  return;
+                              else if (!result)
+                                  self->publish_failed(result.code(), result.error());
+                              else if (!result->initial() && self->is(phase::leading))
+                                  self->publish();
+                          },
+                          [weak_self] (const event& ev)
+                          {
+                              auto self = weak_self.lock();
+                              if (self && ev.type() != event_type::session && self->is(phase::leading))
+                                  self->publish();
+                          }
+                         );
+    }
+
+    void on_published_update(outcome<watch_update> update)
+    {
+        if (update)
+        {
+            auto value = std::move(*update).value();
+            if (value)
+                value->share();
+
+            std::unique_lock<std::mutex> ax(protect);
+            published = std::move(value);
+        }
+        else if (update.code() == error_code::session_expired || update.code() == error_code::closed)
+        {
+            // This is also how a leader, which has no watch of its own, finds out that its session is gone
+            fail(update.code(), update.error());
+        }
+        else
+        {
+            // The read after an event failed (most likely the connection was lost), so follow the entry from scratch
+            std::unique_lock<std::mutex> ax(protect);
+            if (current == phase::resigned || current == phase::failed)
+                return;
+            published = nullopt;
+            ax.unlock();
+
+            std::weak_ptr<state> weak_self = shared_from_this();
+            zk::watch_stream replacement(conn,
+                                         published_path,
+                                         [weak_self] (outcome<watch_update> update)
+                                         {
+                                             if (auto self = weak_self.lock())
+                                                 self->on_published_update(std::move(update));
+                                         }
+                                        );
+            ax.lock();
+            // The stream being replaced is the one delivering this update; its state outlives its handle
+            published_stream = std::move(replacement);
+        }
+    }
+
+    bool is(phase which)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return current == which;
+    }
+
+    void fail(error_code code, std::exception_ptr cause)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        auto previous = current;
+        if (previous == phase::resigned || previous == phase::failed)
+            return;
+        current   = phase::failed;
+        published = nullopt;
+        auto stream = std::move(published_stream);
+        published_stream = nullopt;
+        auto followed = std::move(session_watch);
+        ax.unlock();
+
+        if (stream)
+            stream->cancel();
+        followed.cancel();
+        if (previous == phase::leading)
+            on_change(false);
+        on_change(outcome<bool>(code, std::move(cause)));
+    }
+
+    void resign(callback<void> on_complete)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        auto previous = std::exchange(current, phase::resigned);
+        auto stream   = std::move(published_stream);
+        published_stream = nullopt;
+        published        = nullopt;
+        auto followed    = std::move(session_watch);
+        if (previous == phase::creating)
+            on_resigned = std::move(on_complete);
+        ax.unlock();
+
+        if (stream)
+            stream->cancel();
+        followed.cancel();
+
+        if (previous == phase::creating)
+            return; // the entry is erased (and on_complete called) once it has been created
+        else if (previous == phase::failed || previous == phase::resigned)
+        {
+            if (on_complete)
+                on_complete(outcome<void>());
+            return;
+        }
+
+        if (previous == phase::leading)
+            on_change(false);
+
+        // Erasing the published entry first means the next leader never finds it in its way
+        auto self = shared_from_this();
+        auto erase_entry = [self, on_complete = std::move(on_complete)] (outcome<void> result) mutable
+                           {
+                               if (!result)
+                               {
+                                   if (on_complete)
+                                       on_complete(std::move(result));
+                               }
+                               else
+                               {
+                                   self->erase(*self->entry, std::move(on_complete));
+                               }
+                           };
+        if (previous == phase::leading)
+            erase(published_path, std::move(erase_entry));
+        else
+            erase_entry(outcome<void>());
+    }
+
+    void erase(const zk::path& path, callback<void> on_complete)
+    {
+        conn.erase(path,
+                   version::any(),
+                   [on_complete = std::move(on_complete)] (outcome<void> result)
+                   {
+                       if (!on_complete)
+                           return;
+                       else if (result.code() == error_code::no_entry)
+                           on_complete(outcome<void>());
+                       else
+                           on_complete(std::move(result));
+                   }
+                  );
+    }
+
+    client                     conn;
+    zk::path                   dir;
+    zk::path                   published_path;
+    buffer                     data;
+    listener                   on_change;
+
+    mutable std::mutex         protect;
+    phase                      current = phase::creating;
+    optional<zk::path>         entry;
+    optional<get_result>       published;
+    optional<zk::watch_stream> published_stream;
+    state_subscription         session_watch;
+    bool                       retry_pending = false;
+    std::chrono::milliseconds  retry_delay   = first_retry_delay;
+    callback<void>             on_resigned;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// leader_election                                                                                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+leader_election::leader_election(client conn, zk::path dir, buffer data, listener on_change) :
+        _state(std::make_shared<state>(std::move(conn), std::move(dir), std::move(data), std::move(on_change)))
+{
+    _state->start();
+}
+
+leader_election::~leader_election() noexcept
+{
+    if (_state)
+        _state->resign(nullptr);
+}
+
+const zk::path& leader_election::dir() const noexcept
+{
+    return _state->dir;
+}
+
+const buffer& leader_election::data() const noexcept
+{
+    return _state->data;
+}
+
+bool leader_election::leading() const
+{
+    return _state->is(state::phase::leading);
+}
+
+optional<zk::path> leader_election::entry() const
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    return _state->entry;
+}
+
+optional<get_result> leader_election::leader() const
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    return _state->published;
+}
+
+future<void> leader_election::resign()
+{
+    return future_from_callback<void>([&] (auto cb) { this->resign(std::move(cb)); });
+}
+
+void leader_election::resign(callback<void> on_complete)
+{
+    _state->resign(std::move(on_complete));
+}
+
+}
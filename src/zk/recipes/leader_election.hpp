@@ -0,0 +1,103 @@
+/// \file
+/// Defines \ref zk::recipes::leader_election, an election whose candidates each watch one entry.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/buffer.hpp>
+#include <zk/callback.hpp>
+#include <zk/client.hpp>
+#include <zk/future.hpp>
+#include <zk/optional.hpp>
+#include <zk/path.hpp>
+#include <zk/results.hpp>
+
+#include <memory>
+
+namespace zk::recipes
+{
+
+/// \addtogroup Recipes
+/// \{
+
+/// One candidate in the election of a leader among the children of \ref dir, which must already exist. Candidates queue
+/// up as ephemeral, sequential entries (\c "candidate-<sequence>") and the first one in the queue leads. Every other
+/// candidate watches only the one ahead of it, so the leader going away wakes exactly one candidate, and when that is
+/// its successor (because the leader was the only one ahead of it), the successor takes over as soon as the deletion
+/// event arrives: there is nothing left to read to know it leads. A candidate whose predecessor was not the leader
+/// lists the queue once to find its new predecessor.
+///
+/// The leader publishes the \ref data of its candidate in the ephemeral entry \c "leader" under \ref dir. Every
+/// candidate follows that entry with a \ref watch_stream, so \ref leader is answered from memory. The published entry
+/// trails the change of leadership by the round trip it takes to create it. A creation which fails because the
+/// connection was lost (or the request was throttled) is tried again once the session is connected again, or after a
+/// delay which grows up to 5 seconds; any other failure to publish ends the candidacy, which the listener is told
+/// about, and takes the candidate out of the queue.
+///
+/// \code
+/// zk::recipes::leader_election election(client,
+///                                       zk::path("/shards/42/election"),
+///                                       host_id,
+///                                       [] (zk::outcome<bool> leading)
+///                                       {
+///                                           if (!leading)
+///                                               rejoin_later(leading.code());
+///                                           else if (*leading)
+///                                               start_serving();
+///                                           else
+///                                               stop_serving();
+///                                       }
+///                                      );
+/// \endcode
+///
+/// Nobody polls: a follower costs the ensemble one watch on its predecessor and one on the published entry.
+class leader_election final
+{
+public:
+    /// Called with \c true when this candidate becomes the leader and with \c false when it stops being the leader
+    /// (because it resigned or its session ended). It is called with an error once the candidate leaves the election
+    /// because of one, such as \ref error_code::session_expired; no more calls follow. It runs on the ZooKeeper
+    /// completion or event thread, with the same restrictions as a \ref callback.
+    using listener = callback<bool>;
+
+public:
+    /// Enter the election under \a dir as a candidate with the given \a data, which is what is published when it leads.
+    explicit leader_election(client conn, zk::path dir, buffer data, listener on_change);
+
+    leader_election(leader_election&&) noexcept = default;
+    leader_election& operator=(leader_election&&) noexcept = default;
+
+    /// \ref resign without waiting for the server to confirm it.
+    ~leader_election() noexcept;
+
+    const zk::path& dir() const noexcept;
+
+    /// The data this candidate publishes when it leads.
+    const buffer& data() const noexcept;
+
+    /// Is this candidate the leader?
+    bool leading() const;
+
+    /// The entry of this candidate or \c nullopt if it has not been created yet.
+    optional<zk::path> entry() const;
+
+    /// The data and \ref stat of the published leader or \c nullopt if none is published. This is read from memory; it
+    /// is as up to date as the last watch event on the published entry.
+    optional<get_result> leader() const;
+
+    /// \{
+    /// Leave the election, giving up the leadership if this candidate has it. The published entry is erased before the
+    /// entry of the candidate, so the next leader never finds it in the way. This completes once both are gone.
+    future<void> resign();
+    void resign(callback<void> on_complete);
+    /// \}
+
+private:
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// \}
+
+}
@@ -0,0 +1,187 @@
+#include <zk/server/server_tests.hpp>
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/fake/server.hpp>
+#include <zk/tests/test.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "leader_election.hpp"
+
+namespace zk::recipes
+{
+
+static buffer buffer_from(string_view str)
+{
+    return buffer(str.data(), str.data() + str.size());
+}
+
+/// Collects what an election tells its listener.
+class leadership_log final
+{
+public:
+    leader_election::listener listener()
+    {
+        return [this] (outcome<bool> change)
+               {
+                   std::unique_lock<std::mutex> ax(_protect);
+                   _changes.push_back(std::move(change));
+                   _changed.notify_all();
+               };
+    }
+
+    /// Wait for the next change, failing if none arrives within 10 seconds.
+    outcome<bool> next()
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        if (!_changed.wait_for(ax, std::chrono::seconds(10), [this] { return !_changes.empty(); }))
+            return outcome<bool>(error_code::operation_timeout);
+        auto out = std::move(_changes.front());
+        _changes.pop_front();
+        return out;
+    }
+
+    bool empty()
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        return _changes.empty();
+    }
+
+private:
+    std::mutex                _protect;
+    std::condition_variable   _changed;
+    std::deque<outcome<bool>> _changes;
+};
+
+/// Wait for the published leader of \a election to have the given \a data.
+static bool wait_for_leader(const leader_election& election, const buffer& data)
+{
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        auto published = election.leader();
+        if (published && published->data() == data)
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+}
+
+/// A listener for \a log which makes the next request to \a srv fail with \a code once the candidate leads, so the
+/// failing request is the creation of the published entry.
+static leader_election::listener failing_publish(leadership_log&                      log,
+                                                 const std::shared_ptr<fake::server>& srv,
+                                                 error_code                           code
+                                                )
+{
+    return [srv, code, inner = log.listener()] (outcome<bool> change)
+           {
+               if (change && *change)
+                   srv->fail_next(code);
+               inner(std::move(change));
+           };
+}
+
+GTEST_TEST(leader_election_publish_tests, retries_after_connection_loss)
+{
+    auto   srv = fake::server::create("election-publish-retry");
+    client c(srv->connection_string());
+    c.create("/election-retry", buffer()).get();
+
+    leadership_log  log;
+    leader_election candidate(c,
+                              zk::path("/election-retry"),
+                              buffer_from("only"),
+                              failing_publish(log, srv, error_code::connection_loss)
+                             );
+    CHECK_TRUE(*log.next());
+    CHECK_TRUE(wait_for_leader(candidate, buffer_from("only")));
+    CHECK_TRUE(candidate.leading());
+    CHECK_TRUE(log.empty());
+}
+
+GTEST_TEST(leader_election_publish_tests, other_failures_end_the_candidacy)
+{
+    auto   srv = fake::server::create("election-publish-failure");
+    client c(srv->connection_string());
+    c.create("/election-refused", buffer()).get();
+
+    leadership_log  log;
+    leader_election candidate(c,
+                              zk::path("/election-refused"),
+                              buffer_from("only"),
+                              failing_publish(log, srv, error_code::not_authorized)
+                             );
+    CHECK_TRUE(*log.next());
+    CHECK_FALSE(*log.next());
+    CHECK_TRUE(log.next().code() == error_code::not_authorized);
+    CHECK_FALSE(candidate.leading());
+
+    // The candidate is out of the queue, so it does not hold up the next one
+    CHECK_TRUE(c.get_children("/election-refused").get().children().empty());
+}
+
+class leader_election_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(leader_election_tests, failover)
+{
+    client c = get_connected_client();
+    c.create("/election-failover", buffer()).get();
+
+    leadership_log first_log;
+    leader_election first(c, zk::path("/election-failover"), buffer_from("first"), first_log.listener());
+    CHECK_TRUE(*first_log.next());
+    CHECK_TRUE(first.leading());
+
+    leadership_log second_log;
+    leadership_log third_log;
+    leader_election second(c, zk::path("/election-failover"), buffer_from("second"), second_log.listener());
+    leader_election third(c, zk::path("/election-failover"), buffer_from("third"), third_log.listener());
+    CHECK_TRUE(wait_for_leader(second, buffer_from("first")));
+    CHECK_TRUE(wait_for_leader(third, buffer_from("first")));
+    CHECK_FALSE(second.leading());
+    CHECK_TRUE(second_log.empty());
+
+    first.resign().get();
+    CHECK_FALSE(*first_log.next());
+    CHECK_TRUE(*second_log.next());
+    CHECK_TRUE(second.leading());
+    CHECK_TRUE(wait_for_leader(third, buffer_from("second")));
+    CHECK_TRUE(third_log.empty());
+
+    // A follower leaving from the middle of the queue does not change the leader
+    leadership_log fourth_log;
+    leader_election fourth(c, zk::path("/election-failover"), buffer_from("fourth"), fourth_log.listener());
+    CHECK_TRUE(wait_for_leader(fourth, buffer_from("second")));
+    third.resign().get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    CHECK_TRUE(fourth_log.empty());
+    CHECK_TRUE(second.leading());
+
+    second.resign().get();
+    CHECK_TRUE(*fourth_log.next());
+    CHECK_TRUE(wait_for_leader(fourth, buffer_from("fourth")));
+}
+
+GTEST_TEST_F(leader_election_tests, resign_leaves_nothing_behind)
+{
+    client c = get_connected_client();
+    c.create("/election-resign", buffer()).get();
+
+    leadership_log log;
+    {
+        leader_election candidate(c, zk::path("/election-resign"), buffer_from("only"), log.listener());
+        CHECK_TRUE(*log.next());
+        CHECK_TRUE(wait_for_leader(candidate, buffer_from("only")));
+        CHECK_TRUE(candidate.entry());
+        candidate.resign().get();
+    }
+    CHECK_TRUE(c.get_children("/election-resign").get().children().empty());
+}
+
+}
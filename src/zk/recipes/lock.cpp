@@ -0,0 +1,522 @@
+#include "lock.hpp"
+
+#include <zk/error.hpp>
+#include <zk/results.hpp>
+#include <zk/types.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace zk::recipes
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// lock_mode                                                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const lock_mode& mode)
+{
+    switch (mode)
+    {
+    case lock_mode::exclusive: return os << "exclusive";
+    case lock_mode::shared:    return os << "shared";
+    default:                   return os << "lock_mode(" << static_cast<int>(mode) << ')';
+    }
+}
+
+std::string to_string(const lock_mode& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// lock_scan                                                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The server appends the sequence number as 10 zero-padded digits.
+static constexpr std::size_t sequence_digits = 10U;
+
+lock_scan::lock_scan(lock_mode mode, std::string own_name) :
+        _mode(mode),
+        _own_name(std::move(own_name)),
+        _own_sequence(sequence_of(_own_name)),
+        _found_self(false),
+        _predecessor_sequence(-1)
+{ }
+
+string_view lock_scan::prefix_of(lock_mode mode) noexcept
+{
+    return mode == lock_mode::shared ? string_view("read-") : string_view("write-");
+}
+
+std::int64_t lock_scan::sequence_of(string_view name) noexcept
+{
+    auto has_prefix = [name] (lock_mode mode) { return name.substr(0U, prefix_of(mode).size()) == prefix_of(mode); };
+    if (!(has_prefix(lock_mode::exclusive) || has_prefix(lock_mode::shared)) || name.size() < sequence_digits)
+        return -1;
+
+    std::int64_t out = 0;
+    for (char c : name.substr(name.size() - sequence_digits))
+    {
+        if (c < '0' || c > '9')
+            return -1;
+        out = out * 10 + (c - '0');
+    }
+    return out;
+}
+
+void lock_scan::visit(string_view name)
+{
+    if (name == _own_name)
+    {
+        _found_self = true;
+        return;
+    }
+
+    auto sequence = sequence_of(name);
+    if (sequence < 0 || sequence >= _own_sequence || sequence <= _predecessor_sequence)
+        return;
+
+    // Readers do not block other readers, so a shared contender only waits for an exclusive one
+    auto writer_prefix = prefix_of(lock_mode::exclusive);
+    if (_mode == lock_mode::shared && name.substr(0U, writer_prefix.size()) != writer_prefix)
+        return;
+
+    _predecessor.assign(name.data(), name.size());
+    _predecessor_sequence = sequence;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// lock::attempt                                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// One trip through the queue, from creating the entry of the contender to erasing it. Each step holds the attempt
+/// strongly, since the operations always complete; the watch on the predecessor only holds it weakly, so it does not
+/// keep an abandoned attempt alive. A cancellation handler calls \c finish without forgetting itself, as forgetting a
+/// running handler from within it would wait for itself.
+///
+/// The name of the entry carries a token of its own between the mode and the sequence number, so when the connection
+/// cuts off the creation, the attempt can look for the entry by that token instead of leaving it orphaned in the queue.
+struct lock::attempt final :
+        std::enable_shared_from_this<lock::attempt>
+{
+    enum class phase
+    {
+        creating, //!< The entry is being created
+        waiting,  //!< In the queue, looking for or watching the predecessor
+        held,
+        failed,   //!< The acquisition completed with an error and the entry (if any) is erased or being erased
+        released,
+    };
+
+    static constexpr std::chrono::milliseconds first_retry_delay = std::chrono::milliseconds(50);
+    static constexpr std::chrono::milliseconds max_retry_delay   = std::chrono::seconds(5);
+
+    explicit attempt(client conn, zk::path dir, lock_mode mode, callback<void> on_acquired) :
+            conn(std::move(conn)),
+            dir(std::move(dir)),
+            mode(mode),
+            name_prefix(protected_prefix(mode)),
+            on_acquired(std::move(on_acquired))
+    { }
+
+    /// The mode prefix followed by a random token and a dash, like \c "write-00c0ffee12345678-".
+    static std::string protected_prefix(lock_mode mode)
+    {
+        std::random_device source;
+        auto token = (std::uint64_t(source()) << 32U) | std::uint64_t(source());
+
+        std::ostringstream os;
+        os << lock_scan::prefix_of(mode) << std::hex << std::setfill('0') << std::setw(16) << token << '-';
+        return os.str();
+    }
+
+    void start(const cancellation_token& cancel_token)
+    {
+        cancel = cancel_token;
+        if (cancel.can_cancel())
+        {
+            std::weak_ptr<attempt> weak_self = shared_from_this();
+            auto id = cancel.on_cancel([weak_self]
+                                       {
+                                           if (auto self = weak_self.lock())
+                                               self->finish(error_code::operation_timeout, false);
+                                       }
+                                      );
+            std::unique_lock<std::mutex> ax(protect);
+            registration = id;
+        }
+
+        create();
+    }
+
+    void create()
+    {
+        auto self = shared_from_this();
+        conn.create(dir / name_prefix,
+                    buffer(),
+                    create_mode::ephemeral | create_mode::sequential,
+                    [self] (outcome<create_result> result)
+                    {
+                        if (!result && is_transport_error(result.code()))
+                            self->recover();
+                        else
+                            self->on_created(std::move(result));
+                    }
+                   );
+    }
+
+    /// The connection cut off the creation, so the server may or may not have made the entry. It is looked for by the
+    /// token in its name before making another, which is done whether or not the acquisition is still wanted: an entry
+    /// nobody knows about would block the contenders behind it until the session ends.
+    void recover()
+    {
+        auto self  = shared_from_this();
+        auto found = std::make_shared<optional<std::string>>();
+        conn.for_each_child(dir,
+                            [self, found] (string_view name)
+                            {
+                                if (name.substr(0U, self->name_prefix.size()) == self->name_prefix)
+                                    found->emplace(name);
+                            },
+                            [self, found] (outcome<zk::stat> result) { self->on_recovered(result, std::move(*found)); }
+                           );
+    }
+
+    void on_recovered(const outcome<zk::stat>& result, optional<std::string> name)
+    {
+        if (name)
+            return on_created(create_result((dir / *name).str()));
+        else if (!result && is_transport_error(result.code()))
+            return retry_recover();
+        else if (!result)
+            return on_created(outcome<create_result>(result.code(), result.error()));
+
+        std::unique_lock<std::mutex> ax(protect);
+        bool wanted = current == phase::creating;
+        ax.unlock();
+
+        // The server never made it, so there is nothing to take back out of the queue if it is no longer wanted
+        if (wanted)
+            create();
+        else
+            on_created(outcome<create_result>(error_code::no_entry));
+    }
+
+    /// Look for the entry again a little later, since the connection is probably still being restored.
+    void retry_recover()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        auto delay  = retry_delay;
+        retry_delay = std::min<std::chrono::milliseconds>(retry_delay * 2, max_retry_delay);
+        ax.unlock();
+
+        auto self  = shared_from_this();
+        auto timer = cancellation_token::after(delay);
+        // The timer keeps itself alive through its own handler until it fires
+        timer.on_cancel([self, timer] { self->recover(); });
+    }
+
+    void on_created(outcome<create_result> result)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (result)
+            entry.emplace(std::move(result).value().name());
+
+        if (current == phase::creating)
+        {
+            if (result)
+                current = phase::waiting;
+            ax.unlock();
+
+            if (result)
+                scan();
+            else
+                finish(outcome<void>(result.code(), result.error()), true);
+        }
+        else
+        {
+            // Given up on before the entry was made, so nobody could take it back out of the queue until now
+            auto on_complete = std::move(on_released);
+            ax.unlock();
+
+            if (result)
+                erase_entry(std::move(on_complete));
+            else if (on_complete)
+                on_complete(outcome<void>());
+        }
+    }
+
+    void scan()
+    {
+        auto self  = shared_from_this();
+        auto found = std::make_shared<lock_scan>(mode, std::string(entry->basename()));
+        conn.for_each_child(dir,
+                            [found] (string_view name) { found->visit(name); },
+                            [self, found] (outcome<zk::stat> result) { self->on_scanned(result, *found); }
+                           );
+    }
+
+    void on_scanned(const outcome<zk::stat>& result, const lock_scan& found)
+    {
+        if (!result)
+            finish(outcome<void>(result.code(), result.error()), true);
+        else if (!found.found_self())
+            finish(error_code::no_entry, true);
+        else if (found.predecessor().empty())
+            acquired();
+        else if (waiting())
+        {
+            auto self = shared_from_this();
+            conn.watch_exists(dir / found.predecessor(),
+                              [self] (outcome<watch_exists_result> result) { self->on_watched(std::move(result)); },
+                              on_event()
+                             );
+        }
+    }
+
+    void on_watched(outcome<watch_exists_result> result)
+    {
+        if (!result)
+            finish(outcome<void>(result.code(), result.error()), true);
+        else if (!result->initial() && waiting())
+            // The predecessor went away between the listing and the watch
+            scan();
+    }
+
+    event_callback on_event()
+    {
+        std::weak_ptr<attempt> weak_self = shared_from_this();
+        return [weak_self] (const event& ev)
+               {
+                   auto self = weak_self.lock();
+                   if (!self)
+                       return;
+
+                   if (ev.type() == event_type::session && ev.state() == zk::state::expired_session)
+                       self->finish(error_code::session_expired, true);
+                   else if (ev.type() == event_type::session && ev.state() == zk::state::closed)
+                       self->finish(error_code::closed, true);
+                   else if (self->waiting())
+                       // Whatever happened to the predecessor (or the connection), the watch is spent and the queue has
+                       // to be looked at again: a predecessor which gave up does not mean the lock is free
+                       self->scan();
+               };
+    }
+
+    bool waiting()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return current == phase::waiting;
+    }
+
+    void acquired()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (current != phase::waiting)
+            return;
+        current = phase::held;
+        auto on_complete = std::move(on_acquired);
+        auto id          = std::exchange(registration, 0U);
+        ax.unlock();
+
+        cancel.forget(id);
+        on_complete(outcome<void>());
+    }
+
+    /// Complete a pending acquisition with \a result, which is an error.
+    void finish(outcome<void> result, bool forget_cancel)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (current != phase::creating && current != phase::waiting)
+            return;
+        bool has_entry   = current == phase::waiting;
+        current          = phase::failed;
+        auto on_complete = std::move(on_acquired);
+        auto id          = std::exchange(registration, 0U);
+        ax.unlock();
+
+        if (forget_cancel)
+            cancel.forget(id);
+        if (has_entry)
+            erase_entry(nullptr);
+        on_complete(std::move(result));
+    }
+
+    void release(callback<void> on_complete)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        auto previous  = std::exchange(current, phase::released);
+        bool pending   = previous == phase::creating || previous == phase::waiting;
+        auto abandoned = pending ? std::move(on_acquired) : callback<void>();
+        auto id        = pending ? std::exchange(registration, 0U) : cancellation_token::registration(0U);
+        if (previous == phase::creating)
+            on_released = std::move(on_complete);
+        ax.unlock();
+
+        if (pending)
+        {
+            cancel.forget(id);
+            abandoned(error_code::closed);
+        }
+
+        if (previous == phase::creating)
+            return; // erased (and on_complete called) once the creation completes
+        else if (previous == phase::waiting || previous == phase::held)
+            erase_entry(std::move(on_complete));
+        else if (on_complete)
+            on_complete(outcome<void>());
+    }
+
+    void erase_entry(callback<void> on_complete)
+    {
+        conn.erase(*entry,
+                   version::any(),
+                   [on_complete = std::move(on_complete)] (outcome<void> result)
+                   {
+                       if (!on_complete)
+                           return;
+                       else if (result.code() == error_code::no_entry)
+                           on_complete(outcome<void>());
+                       else
+                           on_complete(std::move(result));
+                   }
+                  );
+    }
+
+    bool is_held()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return current == phase::held;
+    }
+
+    bool is_active()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return current == phase::creating || current == phase::waiting || current == phase::held;
+    }
+
+    optional<zk::path> entry_path()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return entry;
+    }
+
+    client                           conn;
+    zk::path                         dir;
+    lock_mode                        mode;
+    std::string                      name_prefix;
+    cancellation_token               cancel;
+
+    std::mutex                       protect;
+    phase                            current      = phase::creating;
+    callback<void>                   on_acquired;
+    callback<void>                   on_released;
+    cancellation_token::registration registration = 0U;
+    optional<zk::path>               entry;
+    std::chrono::milliseconds        retry_delay  = first_retry_delay;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// lock                                                                                                               //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+lock::lock(client conn, zk::path dir, lock_mode mode) :
+        _conn(std::move(conn)),
+        _dir(std::move(dir)),
+        _mode(mode)
+{ }
+
+lock::lock(lock&&) noexcept = default;
+
+lock& lock::operator=(lock&& src) noexcept
+{
+    if (this != &src)
+    {
+        if (_current)
+            _current->release(nullptr);
+
+        _conn    = std::move(src._conn);
+        _dir     = std::move(src._dir);
+        _mode    = src._mode;
+        _current = std::move(src._current);
+    }
+    return *this;
+}
+
+lock::~lock() noexcept
+{
+    if (_current)
+        _current->release(nullptr);
+}
+
+future<void> lock::acquire(const cancellation_token& cancel)
+{
+    return future_from_callback<void>([&] (auto cb) { this->acquire(std::move(cb), cancel); });
+}
+
+void lock::acquire(callback<void> on_acquired, const cancellation_token& cancel)
+{
+    if (_current && _current->is_active())
+        throw std::logic_error("Lock on " + _dir.str() + " is already being acquired or held");
+
+    _current = std::make_shared<attempt>(_conn, _dir, _mode, std::move(on_acquired));
+    _current->start(cancel);
+}
+
+bool lock::held() const
+{
+    return _current && _current->is_held();
+}
+
+optional<zk::path> lock::entry() const
+{
+    if (_current)
+        return _current->entry_path();
+    else
+        return nullopt;
+}
+
+future<void> lock::release()
+{
+    return future_from_callback<void>([&] (auto cb) { this->release(std::move(cb)); });
+}
+
+void lock::release(callback<void> on_complete)
+{
+    if (auto current = std::exchange(_current, nullptr))
+        current->release(std::move(on_complete));
+    else
+        on_complete(outcome<void>());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// read_write_lock                                                                                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+read_write_lock::read_write_lock(client conn, zk::path dir) :
+        _conn(std::move(conn)),
+        _dir(std::move(dir))
+{ }
+
+lock read_write_lock::read_lock() const
+{
+    return lock(_conn, _dir, lock_mode::shared);
+}
+
+lock read_write_lock::write_lock() const
+{
+    return lock(_conn, _dir, lock_mode::exclusive);
+}
+
+}
@@ -0,0 +1,196 @@
+/// \file
+/// Defines \ref zk::recipes::lock and \ref zk::recipes::read_write_lock, locks whose waiters each watch one entry.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/callback.hpp>
+#include <zk/cancellation.hpp>
+#include <zk/client.hpp>
+#include <zk/coroutine.hpp>
+#include <zk/future.hpp>
+#include <zk/optional.hpp>
+#include <zk/path.hpp>
+#include <zk/string_view.hpp>
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+namespace zk::recipes
+{
+
+/// \defgroup Recipes
+/// Coordination primitives built out of the operations of a \ref zk::client.
+/// \{
+
+/// How a \ref lock shares the entry it guards.
+enum class lock_mode
+{
+    exclusive, //!< Held by one contender at a time (the write side of a \ref read_write_lock).
+    shared,    //!< Held alongside other shared contenders, but never alongside an exclusive one.
+};
+
+std::ostream& operator<<(std::ostream&, const lock_mode&);
+
+std::string to_string(const lock_mode&);
+
+/// Finds the contender a new one has to wait for, from the names of the children of the lock entry. Contenders are
+/// named by their mode (\c "write-" or \c "read-") followed by the sequence number the server gave them, and the
+/// contender with the lowest number goes first. An exclusive contender waits for the closest contender before it and a
+/// shared one for the closest exclusive contender before it. Children which are not named like contenders are ignored.
+///
+/// The names are visited one at a time (as \ref client::for_each_child delivers them), so finding the predecessor does
+/// not keep a list of the children.
+class lock_scan final
+{
+public:
+    /// Look for the predecessor of the contender named \a own_name, which is the name of a child, not a full path.
+    explicit lock_scan(lock_mode mode, std::string own_name);
+
+    /// Consider the child named \a name.
+    void visit(string_view name);
+
+    /// Was the contender itself among the visited names? If it was not, its entry is gone and it holds nothing.
+    bool found_self() const noexcept { return _found_self; }
+
+    /// The name of the closest contender to wait for or an empty string if there is none, so the lock is held.
+    const std::string& predecessor() const noexcept { return _predecessor; }
+
+    /// The prefix of the names of contenders of the given \a mode.
+    static string_view prefix_of(lock_mode mode) noexcept;
+
+    /// The sequence number of the contender named \a name or \c -1 if it is not named like one.
+    static std::int64_t sequence_of(string_view name) noexcept;
+
+private:
+    lock_mode    _mode;
+    std::string  _own_name;
+    std::int64_t _own_sequence;
+    bool         _found_self;
+    std::string  _predecessor;
+    std::int64_t _predecessor_sequence;
+};
+
+/// A distributed lock on the entry \ref dir, which must already exist. Each contender creates an ephemeral, sequential
+/// child of it and waits for the one contender ahead of it with \ref client::watch_exists, so releasing the lock wakes
+/// only the next waiter instead of all of them. Handing the lock over costs that one notification and one listing of
+/// the children by the woken waiter.
+///
+/// \code
+/// zk::recipes::lock job_lock(client, zk::path("/locks/nightly-job"));
+/// job_lock.acquire(zk::cancellation_token::after(std::chrono::seconds(30))).get();
+/// run_nightly_job();
+/// job_lock.release().get();
+/// \endcode
+///
+/// Acquisition is asynchronous: the \c future form, the \ref callback form and (with C++20) \ref acquire_awaitable all
+/// take a \ref cancellation_token, and a contender whose token is cancelled before it gets the lock completes with
+/// \ref error_code::operation_timeout and takes its entry back out of the queue.
+///
+/// An instance is one contender: it can be acquired again once released, but it is not meant to be used from several
+/// threads at once. The entry is ephemeral, so the lock is also released when the session ends. A lock which is held
+/// is not told about this; watch the \ref state of the session to find out.
+///
+/// \note
+/// If the connection is lost while the entry is being created, the server may have made it without the reply making it
+/// back. Each acquisition puts a random token in the name of its entry (\c write-<token>-<sequence>), so the contender
+/// lists \a dir for that token once the connection allows and carries on with the entry it finds, making one only if
+/// there is none. Such an entry is found (and erased) even if the acquisition was given up on in the meantime.
+class lock final
+{
+public:
+    /// Contend for the lock on \a dir with the given \a mode. Nothing is sent to the server until \ref acquire.
+    explicit lock(client conn, zk::path dir, lock_mode mode = lock_mode::exclusive);
+
+    lock(lock&&) noexcept;
+
+    /// \ref release this lock, then take over \a src.
+    lock& operator=(lock&& src) noexcept;
+
+    /// \ref release the lock without waiting for the server to confirm it.
+    ~lock() noexcept;
+
+    /// The entry the contenders for the lock are children of.
+    const zk::path& dir() const noexcept { return _dir; }
+
+    lock_mode mode() const noexcept { return _mode; }
+
+    /// \{
+    /// Queue up for the lock and complete once it is held. If \a cancel is cancelled first, the acquisition completes
+    /// with \ref error_code::operation_timeout.
+    ///
+    /// \throws std::logic_error if this contender is already acquiring or holding the lock.
+    future<void> acquire(const cancellation_token& cancel = cancellation_token());
+    void acquire(callback<void> on_acquired, const cancellation_token& cancel = cancellation_token());
+    /// \}
+
+#if ZKPP_HAS_COROUTINES
+    /// Queue up for the lock from a coroutine: \c co_await produces the \ref outcome of the acquisition. The coroutine
+    /// is resumed through \a resume_on when it is given, like an \ref awaitable_client.
+    auto acquire_awaitable(cancellation_token cancel = cancellation_token(), std::shared_ptr<executor> resume_on = {})
+    {
+        return await_callback<void>([this, cancel = std::move(cancel)] (auto cb)
+                                    {
+                                        this->acquire(std::move(cb), cancel);
+                                    },
+                                    std::move(resume_on)
+                                   );
+    }
+#endif
+
+    /// Has the lock been acquired (and not released since)?
+    bool held() const;
+
+    /// The entry of this contender or \c nullopt if it does not have one yet.
+    optional<zk::path> entry() const;
+
+    /// \{
+    /// Give up the lock, or the place in the queue for it. An acquisition which is still waiting completes with
+    /// \ref error_code::closed. This completes once the entry of the contender is erased; releasing a contender which
+    /// holds nothing completes right away.
+    future<void> release();
+    void release(callback<void> on_complete);
+    /// \}
+
+private:
+    struct attempt;
+
+private:
+    client                   _conn;
+    zk::path                 _dir;
+    lock_mode                _mode;
+    std::shared_ptr<attempt> _current;
+};
+
+/// A lock with a shared side for readers and an exclusive side for writers, both queued under the same \ref dir.
+/// Readers only wait for the writers ahead of them, so any number of them can hold the lock together, and a writer
+/// waits for everyone ahead of it. Waiters are served in the order they queued up, so a steady stream of readers does
+/// not starve a writer.
+///
+/// \code
+/// zk::recipes::read_write_lock schema(client, zk::path("/locks/schema"));
+/// auto reader = schema.read_lock();
+/// reader.acquire().get();
+/// \endcode
+class read_write_lock final
+{
+public:
+    explicit read_write_lock(client conn, zk::path dir);
+
+    const zk::path& dir() const noexcept { return _dir; }
+
+    /// Make a new contender for the shared side.
+    lock read_lock() const;
+
+    /// Make a new contender for the exclusive side.
+    lock write_lock() const;
+
+private:
+    client   _conn;
+    zk::path _dir;
+};
+
+/// \}
+
+}
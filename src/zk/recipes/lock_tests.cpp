@@ -0,0 +1,236 @@
+#include <zk/server/server_tests.hpp>
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/fake/server.hpp>
+#include <zk/tests/test.hpp>
+
+#include <chrono>
+#include <future>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "lock.hpp"
+
+namespace zk::recipes
+{
+
+GTEST_TEST(lock_scan_tests, sequence_numbers)
+{
+    CHECK_EQ(42, lock_scan::sequence_of("write-0000000042"));
+    CHECK_EQ(7, lock_scan::sequence_of("read-0000000007"));
+    CHECK_EQ(-1, lock_scan::sequence_of("write-00000x0042"));
+    CHECK_EQ(-1, lock_scan::sequence_of("other-0000000042"));
+    CHECK_EQ(-1, lock_scan::sequence_of("read-"));
+}
+
+GTEST_TEST(lock_scan_tests, exclusive_waits_for_closest)
+{
+    lock_scan scan(lock_mode::exclusive, "write-0000000005");
+    for (auto name : { "read-0000000001", "write-0000000007", "write-0000000005", "read-0000000004", "unrelated",
+                       "write-0000000002", "read-0000000006",
+                     }
+        )
+        scan.visit(name);
+    CHECK_TRUE(scan.found_self());
+    CHECK_EQ("read-0000000004", scan.predecessor());
+
+    lock_scan first(lock_mode::exclusive, "write-0000000001");
+    first.visit("write-0000000003");
+    first.visit("write-0000000001");
+    CHECK_TRUE(first.found_self());
+    CHECK_TRUE(first.predecessor().empty());
+}
+
+GTEST_TEST(lock_scan_tests, shared_waits_for_writers)
+{
+    lock_scan scan(lock_mode::shared, "read-0000000009");
+    for (auto name : { "read-0000000008", "write-0000000003", "read-0000000001", "write-0000000010",
+                       "read-0000000009",
+                     }
+        )
+        scan.visit(name);
+    CHECK_EQ("write-0000000003", scan.predecessor());
+
+    // With only readers ahead, the lock is held right away
+    lock_scan readers(lock_mode::shared, "read-0000000003");
+    for (auto name : { "read-0000000001", "read-0000000002", "read-0000000003" })
+        readers.visit(name);
+    CHECK_TRUE(readers.predecessor().empty());
+
+    lock_scan missing(lock_mode::shared, "read-0000000003");
+    missing.visit("read-0000000001");
+    CHECK_FALSE(missing.found_self());
+}
+
+GTEST_TEST(lock_scan_tests, protected_names)
+{
+    lock_scan scan(lock_mode::exclusive, "write-00000000deadbeef-0000000002");
+    scan.visit("read-0123456789abcdef-0000000001");
+    scan.visit("write-00000000deadbeef-0000000002");
+    CHECK_TRUE(scan.found_self());
+    CHECK_EQ("read-0123456789abcdef-0000000001", scan.predecessor());
+}
+
+GTEST_TEST(lock_recovery_tests, entry_whose_reply_was_lost_is_found)
+{
+    auto   srv = fake::server::create("lock-lost-reply");
+    client c(srv->connection_string());
+    c.create("/locks", buffer()).get();
+
+    lock contender(c, zk::path("/locks"));
+    srv->lose_next_replies(error_code::connection_loss);
+    contender.acquire().get();
+    CHECK_TRUE(contender.held());
+
+    // The entry the server made is the one in use, not an orphan next to a second one
+    auto entries = c.get_children("/locks").get().children();
+    CHECK_EQ(1U, entries.size());
+    CHECK_EQ(entries.at(0U), contender.entry()->basename());
+
+    contender.release().get();
+    CHECK_TRUE(c.get_children("/locks").get().children().empty());
+}
+
+GTEST_TEST(lock_recovery_tests, entry_which_was_never_made_is_made_again)
+{
+    auto   srv = fake::server::create("lock-failed-create");
+    client c(srv->connection_string());
+    c.create("/locks", buffer()).get();
+
+    // The creation fails, then so does the first look for its entry, which is retried
+    lock contender(c, zk::path("/locks"));
+    srv->fail_next(error_code::connection_loss, 2U);
+    contender.acquire().get();
+    CHECK_TRUE(contender.held());
+    CHECK_EQ(1U, c.get_children("/locks").get().children().size());
+
+    lock next(c, zk::path("/locks"));
+    auto waiting = next.acquire();
+    contender.release().get();
+    waiting.get();
+    CHECK_TRUE(next.held());
+}
+
+GTEST_TEST(lock_mode_tests, stringification)
+{
+    CHECK_EQ("exclusive", to_string(lock_mode::exclusive));
+    CHECK_EQ("shared",    to_string(lock_mode::shared));
+}
+
+class lock_tests :
+        public server::single_server_fixture
+{ };
+
+template <typename T>
+static bool is_ready(const future<T>& fut, std::chrono::milliseconds wait = std::chrono::milliseconds(200))
+{
+    return fut.wait_for(wait) == std::future_status::ready;
+}
+
+GTEST_TEST_F(lock_tests, exclusive_hand_off)
+{
+    client c = get_connected_client();
+    c.create("/lock-exclusive", buffer()).get();
+
+    lock first(c, zk::path("/lock-exclusive"));
+    lock second(c, zk::path("/lock-exclusive"));
+    first.acquire().get();
+    CHECK_TRUE(first.held());
+    CHECK_THROWS(std::logic_error) { first.acquire(); };
+
+    auto waiting = second.acquire();
+    CHECK_FALSE(is_ready(waiting));
+    CHECK_FALSE(second.held());
+
+    first.release().get();
+    CHECK_FALSE(first.held());
+    CHECK_TRUE(is_ready(waiting, std::chrono::seconds(10)));
+    waiting.get();
+    CHECK_TRUE(second.held());
+
+    // A released contender can queue up again
+    auto again = first.acquire();
+    CHECK_FALSE(is_ready(again));
+    second.release().get();
+    again.get();
+    first.release().get();
+    CHECK_TRUE(c.get_children("/lock-exclusive").get().children().empty());
+}
+
+GTEST_TEST_F(lock_tests, waiter_skips_abandoned_predecessor)
+{
+    client c = get_connected_client();
+    c.create("/lock-abandon", buffer()).get();
+
+    lock holder(c, zk::path("/lock-abandon"));
+    lock quitter(c, zk::path("/lock-abandon"));
+    lock last(c, zk::path("/lock-abandon"));
+    holder.acquire().get();
+    auto quitting = quitter.acquire();
+    CHECK_FALSE(is_ready(quitting));
+    auto waiting = last.acquire();
+
+    // The one in the middle giving up does not hand the lock to the one behind it
+    quitter.release().get();
+    CHECK_THROWS(closed) { quitting.get(); };
+    CHECK_FALSE(is_ready(waiting));
+
+    holder.release().get();
+    waiting.get();
+    CHECK_TRUE(last.held());
+}
+
+GTEST_TEST_F(lock_tests, deadline)
+{
+    client c = get_connected_client();
+    c.create("/lock-deadline", buffer()).get();
+
+    lock holder(c, zk::path("/lock-deadline"));
+    holder.acquire().get();
+
+    lock impatient(c, zk::path("/lock-deadline"));
+    CHECK_THROWS(operation_timeout)
+    {
+        impatient.acquire(cancellation_token::after(std::chrono::milliseconds(100))).get();
+    };
+    CHECK_FALSE(impatient.held());
+
+    // Its entry is taken back out of the queue, leaving only the holder
+    for (int attempt = 0; attempt < 50 && c.get_children("/lock-deadline").get().children().size() > 1U; ++attempt)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK_EQ(1U, c.get_children("/lock-deadline").get().children().size());
+}
+
+GTEST_TEST_F(lock_tests, readers_share_writers_wait)
+{
+    client c = get_connected_client();
+    c.create("/lock-rw", buffer()).get();
+    read_write_lock rw(c, zk::path("/lock-rw"));
+
+    auto reader_1 = rw.read_lock();
+    auto reader_2 = rw.read_lock();
+    reader_1.acquire().get();
+    reader_2.acquire().get();
+    CHECK_EQ(lock_mode::shared, reader_2.mode());
+
+    auto writer = rw.write_lock();
+    auto writing = writer.acquire();
+    CHECK_FALSE(is_ready(writing));
+
+    // A reader which queues up behind the writer waits for it
+    auto reader_3 = rw.read_lock();
+    auto reading = reader_3.acquire();
+    reader_1.release().get();
+    CHECK_FALSE(is_ready(writing));
+    reader_2.release().get();
+    writing.get();
+    CHECK_FALSE(is_ready(reading));
+
+    writer.release().get();
+    reading.get();
+    CHECK_TRUE(reader_3.held());
+}
+
+}
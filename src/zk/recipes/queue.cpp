@@ -0,0 +1,539 @@
+#include "queue.hpp"
+
+#include <zk/error.hpp>
+#include <zk/multi.hpp>
+#include <zk/results.hpp>
+#include <zk/string_view.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+namespace zk::recipes
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// queue_item                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+queue_item::queue_item(std::string name, buffer data) noexcept :
+        _name(std::move(name)),
+        _data(std::move(data))
+{ }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// queue::state                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The listing of the queue is \c available, minus the names in \c claiming, which are being read or erased by one of
+/// our dequeues. A fresh listing can still name items which a claim has erased since; claiming one of those again
+/// finds it missing and drops it.
+///
+/// A dequeue is a \c waiter until it is handed some names, at which point it leaves \c waiting and its cancellation no
+/// longer applies. A waiter whose claim comes up empty (all of its names were taken by someone else) goes back to the
+/// front of the line.
+struct queue::state final :
+        std::enable_shared_from_this<queue::state>
+{
+    struct waiter
+    {
+        std::size_t                       max_items;
+        callback<std::vector<queue_item>> on_complete;
+        cancellation_token                cancel;
+        cancellation_token::registration  registration = 0U;
+        bool                              delivered    = false; //!< Set by \c deliver, so a late registration is forgotten
+    };
+
+    /// An item which has been read and is being erased.
+    struct candidate
+    {
+        std::string name;
+        get_result  read;
+    };
+
+    explicit state(client conn, zk::path dir) :
+            conn(std::move(conn)),
+            dir(std::move(dir))
+    { }
+
+    void enqueue(std::vector<buffer> items, callback<std::vector<std::string>> on_complete)
+    {
+        multi_op txn;
+        txn.reserve(items.size());
+        for (auto& data : items)
+            txn.push_back(op::create(dir / item_prefix, std::move(data), create_mode::sequential));
+
+        conn.commit(std::move(txn),
+                    [on_complete = std::move(on_complete)] (outcome<multi_result> result)
+                    {
+                        if (!result)
+                        {
+                            on_complete(outcome<std::vector<std::string>>(result.code(), result.error()));
+                            return;
+                        }
+
+                        std::vector<std::string> names;
+                        names.reserve(result->size());
+                        for (const auto& part : *result)
+                            names.emplace_back(part.as_create().name());
+                        on_complete(std::move(names));
+                    }
+                   );
+    }
+
+    void dequeue(std::size_t max_items, callback<std::vector<queue_item>> on_complete, const cancellation_token& cancel)
+    {
+        auto pending = std::make_shared<waiter>(waiter{ max_items, std::move(on_complete), cancel });
+
+        std::unique_lock<std::mutex> ax(protect);
+        if (closed)
+        {
+            ax.unlock();
+            pending->on_complete(error_code::closed);
+            return;
+        }
+        waiting.push_back(pending);
+        bool start = !watching;
+        watching   = true;
+        ax.unlock();
+
+        if (cancel.can_cancel())
+        {
+            std::weak_ptr<state> weak_self = shared_from_this();
+            std::weak_ptr<waiter> weak_pending = pending;
+            auto id = cancel.on_cancel([weak_self, weak_pending]
+                                       {
+                                           auto self      = weak_self.lock();
+                                           auto abandoned = weak_pending.lock();
+                                           if (self && abandoned && self->withdraw(abandoned))
+                                               abandoned->on_complete(error_code::operation_timeout);
+                                       }
+                                      );
+            // The waiter is already in line, so a pump on another thread may have delivered it in the meantime and
+            // forgotten the registration before it was stored
+            ax.lock();
+            bool delivered = pending->delivered;
+            if (!delivered)
+                pending->registration = id;
+            ax.unlock();
+
+            if (delivered)
+                cancel.forget(id);
+        }
+
+        if (start)
+            watch();
+        else
+            pump();
+    }
+
+    /// Take \a pending out of the line if it is still waiting.
+    bool withdraw(const std::shared_ptr<waiter>& pending)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        auto iter = std::find(waiting.begin(), waiting.end(), pending);
+        if (iter == waiting.end())
+            return false;
+        waiting.erase(iter);
+        return true;
+    }
+
+    void watch()
+    {
+        auto self = shared_from_this();
+        conn.watch_children(dir,
+                            [self] (outcome<watch_children_result> result) { self->on_listed(std::move(result)); },
+                            on_event()
+                           );
+    }
+
+    event_callback on_event()
+    {
+        std::weak_ptr<state> weak_self = shared_from_this();
+        return [weak_self] (const event& ev)
+               {
+                   auto self = weak_self.lock();
+                   if (!self)
+                       return;
+
+                   if (ev.type() == event_type::session && ev.state() == zk::state::expired_session)
+                       self->stop_watching(error_code::session_expired);
+                   else if (ev.type() == event_type::session && ev.state() == zk::state::closed)
+                       self->stop_watching(error_code::closed);
+                   else if (self->is_watching())
+                       // The watch is spent whatever the event was, so list the queue again to renew it
+                       self->watch();
+               };
+    }
+
+    void on_listed(outcome<watch_children_result> result)
+    {
+        if (!result)
+        {
+            stop_watching(outcome<void>(result.code(), result.error()));
+            return;
+        }
+
+        std::unique_lock<std::mutex> ax(protect);
+        available.clear();
+        for (auto& name : result->initial().children())
+        {
+            if (string_view(name).substr(0U, string_view(item_prefix).size()) == item_prefix
+                && claiming.count(name) == 0U
+               )
+                available.insert(std::move(name));
+        }
+        ax.unlock();
+
+        pump();
+    }
+
+    bool is_watching()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return watching && !closed;
+    }
+
+    /// Fail every waiter with \a reason. The next dequeue lists the queue again.
+    void stop_watching(outcome<void> reason)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        watching       = false;
+        auto abandoned = std::exchange(waiting, {});
+        ax.unlock();
+
+        for (auto& pending : abandoned)
+            deliver(*pending, outcome<std::vector<queue_item>>(reason.code(), reason.error()));
+    }
+
+    /// Hand the names at the front of the listing to the waiters at the front of the line.
+    void pump()
+    {
+        std::vector<std::pair<std::shared_ptr<waiter>, std::vector<std::string>>> claims;
+
+        std::unique_lock<std::mutex> ax(protect);
+        while (!waiting.empty() && !available.empty())
+        {
+            auto pending = std::move(waiting.front());
+            waiting.pop_front();
+
+            std::vector<std::string> names;
+            while (names.size() < pending->max_items && !available.empty())
+            {
+                auto name = std::move(available.extract(available.begin()).value());
+                claiming.insert(name);
+                names.emplace_back(std::move(name));
+            }
+            claims.emplace_back(std::move(pending), std::move(names));
+        }
+        ax.unlock();
+
+        for (auto& [pending, names] : claims)
+            claim(std::move(pending), std::move(names));
+    }
+
+    void claim(std::shared_ptr<waiter> pending, std::vector<std::string> names)
+    {
+        std::vector<zk::path> paths;
+        paths.reserve(names.size());
+        for (const auto& name : names)
+            paths.emplace_back(dir / name);
+
+        auto self = shared_from_this();
+        conn.get_many(std::vector<path_view>(paths.begin(), paths.end()),
+                      [self, pending = std::move(pending), names = std::move(names)]
+                      (outcome<std::vector<outcome<get_result>>> result) mutable
+                      {
+                          self->on_read(std::move(pending), std::move(names), std::move(result));
+                      }
+                     );
+    }
+
+    void on_read(std::shared_ptr<waiter>                    pending,
+                 std::vector<std::string>                   names,
+                 outcome<std::vector<outcome<get_result>>>  result
+                )
+    {
+        if (!result)
+        {
+            release(names, true);
+            deliver(*pending, outcome<std::vector<queue_item>>(result.code(), result.error()));
+            return;
+        }
+
+        std::vector<candidate>   candidates;
+        std::vector<std::string> missing;
+        std::vector<std::string> unreadable;
+        outcome<void>            read_error;
+        for (std::size_t idx = 0U; idx < names.size(); ++idx)
+        {
+            auto& read = (*result)[idx];
+            if (read)
+            {
+                candidates.push_back(candidate{ std::move(names[idx]), std::move(read).value() });
+            }
+            else if (read.code() == error_code::no_entry)
+            {
+                missing.emplace_back(std::move(names[idx]));
+            }
+            else
+            {
+                // Leave the item for a later dequeue
+                unreadable.emplace_back(std::move(names[idx]));
+                read_error = outcome<void>(read.code(), read.error());
+            }
+        }
+        release(missing, false);
+        release(unreadable, true);
+
+        // Going back in line would only find the same items, so report why they could not be read
+        if (candidates.empty() && !read_error)
+        {
+            deliver(*pending, outcome<std::vector<queue_item>>(read_error.code(), read_error.error()));
+            return;
+        }
+
+        commit(std::move(pending), std::move(candidates));
+    }
+
+    void commit(std::shared_ptr<waiter> pending, std::vector<candidate> candidates)
+    {
+        if (candidates.empty())
+        {
+            requeue(std::move(pending));
+            return;
+        }
+
+        multi_op txn;
+        txn.reserve(candidates.size());
+        for (const auto& item : candidates)
+            txn.push_back(op::erase(dir / item.name, item.read.stat().data_version));
+
+        auto self = shared_from_this();
+        conn.commit(std::move(txn),
+                    [self, pending = std::move(pending), candidates = std::move(candidates)]
+                    (outcome<multi_result> result) mutable
+                    {
+                        self->on_commit(std::move(pending), std::move(candidates), std::move(result));
+                    }
+                   );
+    }
+
+    void on_commit(std::shared_ptr<waiter> pending, std::vector<candidate> candidates, outcome<multi_result> result)
+    {
+        if (result)
+        {
+            std::vector<std::string> names;
+            std::vector<queue_item>  items;
+            names.reserve(candidates.size());
+            items.reserve(candidates.size());
+            for (auto& item : candidates)
+            {
+                names.push_back(item.name);
+                items.emplace_back(std::move(item.name), std::move(item.read).data());
+            }
+            release(names, false);
+            deliver(*pending, std::move(items));
+            return;
+        }
+
+        std::size_t failed_idx = candidates.size();
+        error_code  cause      = result.code();
+        if (result.code() == error_code::transaction_failed)
+        {
+            try
+            {
+                std::rethrow_exception(result.error());
+            }
+            catch (const transaction_failed& ex)
+            {
+                failed_idx = ex.failed_op_index();
+                cause      = ex.underlying_cause();
+            }
+            catch (...)
+            { }
+        }
+
+        // Someone else took (or changed) the item first: it is not ours, but the rest of the batch still is
+        if (failed_idx < candidates.size()
+            && (cause == error_code::no_entry || cause == error_code::version_mismatch)
+           )
+        {
+            release(std::vector<std::string>{ std::move(candidates[failed_idx].name) }, false);
+            candidates.erase(candidates.begin() + static_cast<std::ptrdiff_t>(failed_idx));
+            commit(std::move(pending), std::move(candidates));
+            return;
+        }
+
+        std::vector<std::string> names;
+        names.reserve(candidates.size());
+        for (auto& item : candidates)
+            names.emplace_back(std::move(item.name));
+        release(names, true);
+        deliver(*pending, outcome<std::vector<queue_item>>(result.code(), result.error()));
+    }
+
+    /// Stop claiming \a names, putting them back in the listing when they might still be in the queue.
+    void release(const std::vector<std::string>& names, bool restore)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        for (const auto& name : names)
+        {
+            claiming.erase(name);
+            if (restore)
+                available.insert(name);
+        }
+    }
+
+    /// Put a waiter whose claim came up empty back at the front of the line.
+    void requeue(std::shared_ptr<waiter> pending)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (closed)
+        {
+            ax.unlock();
+            deliver(*pending, error_code::closed);
+            return;
+        }
+        waiting.push_front(std::move(pending));
+        ax.unlock();
+
+        pump();
+    }
+
+    void deliver(waiter& pending, outcome<std::vector<queue_item>> result)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        auto id           = std::exchange(pending.registration, 0U);
+        pending.delivered = true;
+        ax.unlock();
+
+        pending.cancel.forget(id);
+        pending.on_complete(std::move(result));
+    }
+
+    void close()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        closed         = true;
+        auto abandoned = std::exchange(waiting, {});
+        ax.unlock();
+
+        for (auto& pending : abandoned)
+            deliver(*pending, error_code::closed);
+    }
+
+    std::size_t cached_size()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return available.size();
+    }
+
+    client                              conn;
+    zk::path                            dir;
+
+    std::mutex                          protect;
+    bool                                watching = false;
+    bool                                closed   = false;
+    std::set<std::string>               available;
+    std::set<std::string>               claiming;
+    std::deque<std::shared_ptr<waiter>> waiting;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// queue                                                                                                              //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+queue::queue(client conn, zk::path dir) :
+        _state(std::make_shared<state>(std::move(conn), std::move(dir)))
+{ }
+
+queue::queue(queue&&) noexcept = default;
+
+queue& queue::operator=(queue&& src) noexcept
+{
+    if (this != &src)
+    {
+        if (_state)
+            _state->close();
+        _state = std::move(src._state);
+    }
+    return *this;
+}
+
+queue::~queue() noexcept
+{
+    if (_state)
+        _state->close();
+}
+
+const zk::path& queue::dir() const noexcept
+{
+    return _state->dir;
+}
+
+future<std::string> queue::enqueue(buffer data)
+{
+    return future_from_callback<std::string>([&] (auto cb) { this->enqueue(std::move(data), std::move(cb)); });
+}
+
+void queue::enqueue(buffer data, callback<std::string> on_complete)
+{
+    std::vector<buffer> items;
+    items.emplace_back(std::move(data));
+    _state->enqueue(std::move(items),
+                    [on_complete = std::move(on_complete)] (outcome<std::vector<std::string>> result)
+                    {
+                        if (result)
+                            on_complete(std::move(result->front()));
+                        else
+                            on_complete(outcome<std::string>(result.code(), result.error()));
+                    }
+                   );
+}
+
+future<std::vector<std::string>> queue::enqueue_many(std::vector<buffer> items)
+{
+    return future_from_callback<std::vector<std::string>>([&] (auto cb)
+                                                          {
+                                                              this->enqueue_many(std::move(items), std::move(cb));
+                                                          }
+                                                         );
+}
+
+void queue::enqueue_many(std::vector<buffer> items, callback<std::vector<std::string>> on_complete)
+{
+    if (items.empty())
+        on_complete(std::vector<std::string>());
+    else
+        _state->enqueue(std::move(items), std::move(on_complete));
+}
+
+future<std::vector<queue_item>> queue::dequeue(std::size_t max_items, const cancellation_token& cancel)
+{
+    return future_from_callback<std::vector<queue_item>>([&] (auto cb)
+                                                         {
+                                                             this->dequeue(max_items, std::move(cb), cancel);
+                                                         }
+                                                        );
+}
+
+void queue::dequeue(std::size_t max_items, callback<std::vector<queue_item>> on_complete,
+                    const cancellation_token& cancel
+                   )
+{
+    if (max_items == 0U)
+        throw std::invalid_argument("Can not dequeue 0 items from " + _state->dir.str());
+
+    _state->dequeue(max_items, std::move(on_complete), cancel);
+}
+
+std::size_t queue::cached_size() const
+{
+    return _state->cached_size();
+}
+
+}
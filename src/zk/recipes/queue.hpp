@@ -0,0 +1,125 @@
+/// \file
+/// Defines \ref zk::recipes::queue, a first-in, first-out queue of entries which moves items in batches.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/buffer.hpp>
+#include <zk/callback.hpp>
+#include <zk/cancellation.hpp>
+#include <zk/client.hpp>
+#include <zk/future.hpp>
+#include <zk/path.hpp>
+#include <zk/types.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zk::recipes
+{
+
+/// \addtogroup Recipes
+/// \{
+
+/// An item taken out of a \ref queue.
+class queue_item final
+{
+public:
+    explicit queue_item(std::string name, buffer data) noexcept;
+
+    /// The name of the entry the item was kept in (a child of \ref queue::dir).
+    const std::string& name() const noexcept { return _name; }
+
+    /// \{
+    /// The data the item was enqueued with.
+    const buffer& data() const & noexcept { return _data; }
+    buffer        data() &&               { return std::move(_data); }
+    /// \}
+
+private:
+    std::string _name;
+    buffer      _data;
+};
+
+/// A queue whose items are the persistent, sequential children (\c "item-<sequence>") of \ref dir, which must already
+/// exist. Items are taken out in the order they were created in, by any number of producers and consumers.
+///
+/// Both sides work in batches. \ref enqueue_many creates all of its items with one \ref client::commit. A consumer
+/// keeps a sorted listing of the children, which is refreshed by \ref client::watch_children when the queue changes
+/// instead of for every item, and \ref dequeue claims up to the requested number of items from the front of it with
+/// one \ref client::get_many to read them and one transaction to erase them. The erasures check the version of what was
+/// read; an item which another consumer took in the meantime is dropped from the batch and the rest is committed again,
+/// so consumers racing for the same items do not lose any.
+///
+/// \code
+/// zk::recipes::queue jobs(client, zk::path("/jobs"));
+/// jobs.enqueue_many({ first_job, second_job }).get();
+/// for (const auto& job : jobs.dequeue(32).get())
+///     run(job.data());
+/// \endcode
+///
+/// An item belongs to the consumer whose transaction erased it, which also means an item is lost when the connection
+/// fails after the erasure was applied but before the reply arrived (the dequeue completes with
+/// \ref error_code::connection_loss). Keep batches small enough for the server's \c jute.maxbuffer.
+class queue final
+{
+public:
+    /// Use the queue kept under \a dir. Nothing is sent to the server until the first operation.
+    explicit queue(client conn, zk::path dir);
+
+    queue(queue&&) noexcept;
+
+    /// Close this queue (like the destructor does), then take over \a src.
+    queue& operator=(queue&& src) noexcept;
+
+    /// Stop following the queue. Dequeues which are waiting for items complete with \ref error_code::closed.
+    ~queue() noexcept;
+
+    const zk::path& dir() const noexcept;
+
+    /// \{
+    /// Add one item to the back of the queue. This completes with the name of its entry.
+    future<std::string> enqueue(buffer data);
+    void enqueue(buffer data, callback<std::string> on_complete);
+    /// \}
+
+    /// \{
+    /// Add every one of \a items to the back of the queue, in order, with a single transaction: either all of them are
+    /// enqueued or none is. This completes with the names of their entries.
+    future<std::vector<std::string>> enqueue_many(std::vector<buffer> items);
+    void enqueue_many(std::vector<buffer> items, callback<std::vector<std::string>> on_complete);
+    /// \}
+
+    /// \{
+    /// Take up to \a max_items items from the front of the queue, waiting for the queue to have some if it is empty.
+    /// This completes with at least one item, in queue order, or with \ref error_code::operation_timeout if \a cancel
+    /// is cancelled while it waits. A dequeue which is already claiming items when it is cancelled completes with them.
+    ///
+    /// \throws std::invalid_argument if \a max_items is \c 0.
+    future<std::vector<queue_item>> dequeue(std::size_t               max_items = 1U,
+                                            const cancellation_token& cancel    = cancellation_token()
+                                           );
+    void dequeue(std::size_t                       max_items,
+                 callback<std::vector<queue_item>> on_complete,
+                 const cancellation_token&         cancel = cancellation_token()
+                );
+    /// \}
+
+    /// The number of items in the listing kept by this queue which nobody here has claimed. It is only as current as
+    /// the last change to the queue it was told about, so other consumers may have taken some of them already.
+    std::size_t cached_size() const;
+
+    /// The prefix of the names of the entries of the items.
+    static constexpr ptr<const char> item_prefix = "item-";
+
+private:
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// \}
+
+}
@@ -0,0 +1,112 @@
+#include <zk/server/server_tests.hpp>
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/tests/test.hpp>
+
+#include <chrono>
+#include <future>
+#include <initializer_list>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "queue.hpp"
+
+namespace zk::recipes
+{
+
+static buffer buffer_from(const std::string& text)
+{
+    return buffer(text.data(), text.data() + text.size());
+}
+
+static std::string string_from(const buffer& data)
+{
+    return std::string(data.data(), data.data() + data.size());
+}
+
+class queue_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(queue_tests, batches_in_order)
+{
+    client c = get_connected_client();
+    c.create("/queue-order", buffer()).get();
+    queue jobs(c, zk::path("/queue-order"));
+
+    auto names = jobs.enqueue_many({ buffer_from("a"), buffer_from("b"), buffer_from("c") }).get();
+    CHECK_EQ(3U, names.size());
+    jobs.enqueue(buffer_from("d")).get();
+    CHECK_TRUE(jobs.enqueue_many({}).get().empty());
+
+    auto first = jobs.dequeue(2U).get();
+    CHECK_EQ(2U, first.size());
+    CHECK_EQ("a", string_from(first[0].data()));
+    CHECK_EQ("b", string_from(first[1].data()));
+    CHECK_EQ(zk::path(names[0]).basename(), first[0].name());
+
+    auto rest = jobs.dequeue(10U).get();
+    CHECK_EQ(2U, rest.size());
+    CHECK_EQ("c", string_from(rest[0].data()));
+    CHECK_EQ("d", string_from(rest[1].data()));
+    CHECK_TRUE(c.get_children("/queue-order").get().children().empty());
+
+    CHECK_THROWS(std::invalid_argument) { jobs.dequeue(0U); };
+}
+
+GTEST_TEST_F(queue_tests, waits_for_items)
+{
+    client c = get_connected_client();
+    c.create("/queue-wait", buffer()).get();
+    queue consumer(c, zk::path("/queue-wait"));
+    queue producer(c, zk::path("/queue-wait"));
+
+    auto waiting = consumer.dequeue(5U);
+    CHECK_TRUE(waiting.wait_for(std::chrono::milliseconds(200)) == std::future_status::timeout);
+    producer.enqueue(buffer_from("late")).get();
+    auto items = waiting.get();
+    CHECK_EQ(1U, items.size());
+    CHECK_EQ("late", string_from(items[0].data()));
+
+    CHECK_THROWS(operation_timeout)
+    {
+        consumer.dequeue(1U, cancellation_token::after(std::chrono::milliseconds(100))).get();
+    };
+}
+
+GTEST_TEST_F(queue_tests, consumers_share_without_duplicates)
+{
+    client c = get_connected_client();
+    c.create("/queue-race", buffer()).get();
+
+    std::vector<buffer> items;
+    for (int idx = 0; idx < 100; ++idx)
+        items.push_back(buffer_from(std::to_string(idx)));
+    queue(c, zk::path("/queue-race")).enqueue_many(std::move(items)).get();
+
+    queue first(c, zk::path("/queue-race"));
+    queue second(c, zk::path("/queue-race"));
+    std::set<std::string> seen;
+    for (int round = 0; round < 100 && seen.size() < 100U; ++round)
+    {
+        // Once the queue runs dry, one of the two is left waiting until its deadline
+        auto from_first  = first.dequeue(7U, cancellation_token::after(std::chrono::milliseconds(500)));
+        auto from_second = second.dequeue(7U, cancellation_token::after(std::chrono::milliseconds(500)));
+        for (auto* taking : { &from_first, &from_second })
+        {
+            try
+            {
+                for (const auto& item : taking->get())
+                    CHECK_TRUE(seen.insert(string_from(item.data())).second);
+            }
+            catch (const operation_timeout&)
+            { }
+        }
+    }
+    CHECK_EQ(100U, seen.size());
+    CHECK_TRUE(c.get_children("/queue-race").get().children().empty());
+}
+
+}
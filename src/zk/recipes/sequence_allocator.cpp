@@ -0,0 +1,463 @@
+#include "sequence_allocator.hpp"
+
+#include <zk/error.hpp>
+#include <zk/results.hpp>
+#include <zk/types.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace zk::recipes
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// sequence_allocator::state                                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// IDs are taken from the current range without the lock: \c next is bumped with \c fetch_add and the ID is good if it
+/// is under \c limit. Putting a new range to use (always under the lock) stores both of them, so \c generation is made
+/// odd while it does and bumped back to even after; a taker which sees the generation change around its reads took its
+/// ID from a mix of the two ranges and tries again. An ID burnt that way is simply never handed out.
+///
+/// Reservations hold the state strongly until they complete. Once the state is closed, whatever they reserve is
+/// dropped.
+struct sequence_allocator::state final :
+        std::enable_shared_from_this<sequence_allocator::state>
+{
+    struct range
+    {
+        std::uint64_t first;
+        std::uint64_t size;
+    };
+
+    struct taken
+    {
+        optional<std::uint64_t> id;
+        bool                    prefetch = false; //!< The range reached the point where the next one is reserved
+    };
+
+    explicit state(client conn, zk::path counter, options opts) :
+            conn(std::move(conn)),
+            counter(std::move(counter)),
+            opts(std::move(opts)),
+            planned(std::clamp(this->opts.initial_range(), this->opts.min_range(), this->opts.max_range()))
+    { }
+
+    taken take() noexcept
+    {
+        while (true)
+        {
+            auto gen = generation.load();
+            if (gen % 2U != 0U)
+            {
+                // Someone is putting a range to use, which is only a few stores
+                std::this_thread::yield();
+                continue;
+            }
+
+            auto id  = next.fetch_add(1U);
+            auto end = limit.load();
+            auto low = low_water.load();
+            if (generation.load() != gen)
+                continue;
+            else if (id >= end)
+                return {};
+            else
+                return { id, id == low };
+        }
+    }
+
+    /// Called with the lock held.
+    void install(const range& src) noexcept
+    {
+        auto remaining = static_cast<std::uint64_t>(static_cast<double>(src.size) * opts.prefetch_fraction());
+        remaining      = std::min(remaining, src.size);
+
+        generation.fetch_add(1U);
+        next.store(src.first);
+        limit.store(src.first + src.size);
+        low_water.store(src.first + src.size - remaining);
+        generation.fetch_add(1U);
+
+        installed.emplace(src);
+        installed_at = std::chrono::steady_clock::now();
+    }
+
+    /// Take an ID, putting the spare range to use if the current one has run out. Called with the lock held.
+    taken take_locked() noexcept
+    {
+        auto out = take();
+        while (!out.id && spare)
+        {
+            install(*spare);
+            spare.reset();
+            out = take();
+        }
+        return out;
+    }
+
+    /// Mark a reservation as started and get its size. Called with the lock held.
+    std::uint64_t begin_reservation() noexcept
+    {
+        reserving = true;
+        if (installed)
+        {
+            auto consumed = std::min(next.load(), limit.load()) - installed->first;
+            auto elapsed  = std::chrono::steady_clock::now() - installed_at;
+            planned       = next_range_size(opts, installed->size, consumed, elapsed);
+        }
+        return planned;
+    }
+
+    void allocate(callback<std::uint64_t> on_complete)
+    {
+        auto out = take();
+        if (!out.id)
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            if (closed)
+            {
+                ax.unlock();
+                on_complete(error_code::closed);
+                return;
+            }
+
+            out = take_locked();
+            if (!out.id)
+            {
+                waiting.emplace_back(std::move(on_complete));
+                bool start = !reserving;
+                auto size  = start ? begin_reservation() : 0U;
+                ax.unlock();
+
+                if (start)
+                    reserve(size);
+                return;
+            }
+        }
+
+        if (out.prefetch)
+            prefetch();
+        on_complete(*out.id);
+    }
+
+    optional<std::uint64_t> try_allocate()
+    {
+        auto out = take();
+        if (!out.id)
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            out = take_locked();
+            if (!out.id)
+            {
+                bool start = !closed && !reserving;
+                auto size  = start ? begin_reservation() : 0U;
+                ax.unlock();
+
+                if (start)
+                    reserve(size);
+                return nullopt;
+            }
+        }
+
+        if (out.prefetch)
+            prefetch();
+        return out.id;
+    }
+
+    void prefetch()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (closed || reserving || spare)
+            return;
+        auto size = begin_reservation();
+        ax.unlock();
+
+        reserve(size);
+    }
+
+    void reserve(std::uint64_t size)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        auto last = known;
+        ax.unlock();
+
+        // Our own last write is usually still the latest, so try it before reading the entry again
+        if (last)
+            write(last->first, last->second, size);
+        else
+            read(size);
+    }
+
+    void read(std::uint64_t size)
+    {
+        auto self = shared_from_this();
+        conn.get(counter, [self, size] (outcome<get_result> result) { self->on_read(std::move(result), size); });
+    }
+
+    void on_read(outcome<get_result> result, std::uint64_t size)
+    {
+        if (result.code() == error_code::no_entry)
+        {
+            auto self = shared_from_this();
+            conn.create(counter,
+                        encode_counter(size),
+                        create_mode::normal,
+                        [self, size] (outcome<create_result> created)
+                        {
+                            if (created)
+                                self->reserved(range{ 0U, size }, version(0));
+                            else if (created.code() == error_code::entry_exists)
+                                self->read(size);
+                            else
+                                self->failed(outcome<void>(created.code(), created.error()));
+                        }
+                       );
+        }
+        else if (!result)
+        {
+            failed(outcome<void>(result.code(), result.error()));
+        }
+        else if (auto value = decode_counter(result->data()); !value)
+        {
+            failed(outcome<void>(value.code(), value.error()));
+        }
+        else
+        {
+            write(*value, result->stat().data_version, size);
+        }
+    }
+
+    void write(std::uint64_t first, version check, std::uint64_t size)
+    {
+        if (first > std::numeric_limits<std::uint64_t>::max() - size)
+        {
+            failed(outcome<void>(error_code::invalid_arguments,
+                                 std::make_exception_ptr(invalid_arguments(error_code::invalid_arguments,
+                                                                           "No IDs left to reserve in " + counter.str()
+                                                                          )
+                                                        )
+                                ));
+            return;
+        }
+
+        auto self = shared_from_this();
+        conn.set(counter,
+                 encode_counter(first + size),
+                 check,
+                 [self, first, size] (outcome<set_result> result)
+                 {
+                     if (result)
+                         self->reserved(range{ first, size }, result->stat().data_version);
+                     else if (result.code() == error_code::version_mismatch)
+                         self->read(size);
+                     else
+                         self->failed(outcome<void>(result.code(), result.error()));
+                 }
+                );
+    }
+
+    void reserved(const range& src, version written)
+    {
+        std::vector<std::pair<callback<std::uint64_t>, std::uint64_t>> served;
+        bool          again = false;
+        std::uint64_t size  = 0U;
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            reserving = false;
+            known.emplace(src.first + src.size, written);
+            if (closed)
+                return;
+
+            if (waiting.empty() && next.load() < limit.load())
+            {
+                spare.emplace(src);
+                return;
+            }
+
+            install(src);
+            bool due = false;
+            while (!waiting.empty())
+            {
+                auto out = take();
+                if (!out.id)
+                    break;
+                due = due || out.prefetch;
+                served.emplace_back(std::move(waiting.front()), *out.id);
+                waiting.pop_front();
+            }
+
+            again = due || !waiting.empty();
+            if (again)
+                size = begin_reservation();
+        }
+
+        for (auto& [on_complete, id] : served)
+            on_complete(id);
+        if (again)
+            reserve(size);
+    }
+
+    void failed(outcome<void> reason)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        reserving      = false;
+        known.reset();
+        auto abandoned = std::exchange(waiting, {});
+        ax.unlock();
+
+        for (auto& on_complete : abandoned)
+            on_complete(outcome<std::uint64_t>(reason.code(), reason.error()));
+    }
+
+    void close()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        closed         = true;
+        auto abandoned = std::exchange(waiting, {});
+        ax.unlock();
+
+        for (auto& on_complete : abandoned)
+            on_complete(error_code::closed);
+    }
+
+    client                                                  conn;
+    zk::path                                                counter;
+    options                                                 opts;
+
+    std::atomic<std::uint32_t>                              generation { 0U };
+    std::atomic<std::uint64_t>                              next       { 0U };
+    std::atomic<std::uint64_t>                              limit      { 0U };
+    std::atomic<std::uint64_t>                              low_water  { 0U };
+
+    mutable std::mutex                                      protect;
+    std::uint64_t                                           planned;
+    optional<range>                                         installed;
+    std::chrono::steady_clock::time_point                   installed_at;
+    optional<range>                                         spare;
+    bool                                                    reserving  = false;
+    bool                                                    closed     = false;
+    optional<std::pair<std::uint64_t, version>>             known;     //!< The value and version we last wrote
+    std::deque<callback<std::uint64_t>>                     waiting;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// sequence_allocator                                                                                                 //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+sequence_allocator::sequence_allocator(client conn, zk::path counter) :
+        sequence_allocator(std::move(conn), std::move(counter), options())
+{ }
+
+sequence_allocator::sequence_allocator(client conn, zk::path counter, options opts) :
+        _state(std::make_shared<state>(std::move(conn), std::move(counter), std::move(opts)))
+{ }
+
+sequence_allocator::sequence_allocator(sequence_allocator&&) noexcept = default;
+
+sequence_allocator& sequence_allocator::operator=(sequence_allocator&& src) noexcept
+{
+    if (this != &src)
+    {
+        if (_state)
+            _state->close();
+        _state = std::move(src._state);
+    }
+    return *this;
+}
+
+sequence_allocator::~sequence_allocator() noexcept
+{
+    if (_state)
+        _state->close();
+}
+
+const zk::path& sequence_allocator::counter() const noexcept
+{
+    return _state->counter;
+}
+
+future<std::uint64_t> sequence_allocator::allocate()
+{
+    return future_from_callback<std::uint64_t>([&] (auto cb) { this->allocate(std::move(cb)); });
+}
+
+void sequence_allocator::allocate(callback<std::uint64_t> on_complete)
+{
+    _state->allocate(std::move(on_complete));
+}
+
+optional<std::uint64_t> sequence_allocator::try_allocate()
+{
+    return _state->try_allocate();
+}
+
+std::uint64_t sequence_allocator::range_size() const
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    return _state->planned;
+}
+
+std::uint64_t sequence_allocator::next_range_size(const options&           opts,
+                                                  std::uint64_t            previous,
+                                                  std::uint64_t            consumed,
+                                                  std::chrono::nanoseconds elapsed
+                                                 ) noexcept
+{
+    auto lowest  = std::max<std::uint64_t>(previous / 2U, 1U);
+    auto highest = previous > std::numeric_limits<std::uint64_t>::max() / 2U
+                 ? std::numeric_limits<std::uint64_t>::max()
+                 : previous * 2U;
+
+    std::uint64_t wanted = highest;
+    if (elapsed.count() > 0)
+    {
+        auto per_interval = static_cast<double>(consumed)
+                          * std::chrono::duration<double>(opts.target_interval()).count()
+                          / std::chrono::duration<double>(elapsed).count();
+        if (per_interval < static_cast<double>(highest))
+            wanted = static_cast<std::uint64_t>(per_interval);
+    }
+
+    wanted = std::clamp(wanted, lowest, highest);
+    return std::clamp(wanted, opts.min_range(), std::max(opts.min_range(), opts.max_range()));
+}
+
+buffer sequence_allocator::encode_counter(std::uint64_t value)
+{
+    auto text = std::to_string(value);
+    return buffer(text.data(), text.data() + text.size());
+}
+
+outcome<std::uint64_t> sequence_allocator::decode_counter(const buffer& data)
+{
+    auto fail = [&]
+                {
+                    auto description = "Counter holds " + std::string(data.data(), data.data() + data.size())
+                                     + ", which is not a decimal number";
+                    auto cause = std::make_exception_ptr(invalid_arguments(error_code::invalid_arguments, description));
+                    return outcome<std::uint64_t>(error_code::invalid_arguments, cause);
+                };
+
+    std::uint64_t out = 0U;
+    for (char c : string_view(data.data(), data.size()))
+    {
+        if (c < '0' || c > '9')
+            return fail();
+
+        auto digit = static_cast<std::uint64_t>(c - '0');
+        if (out > (std::numeric_limits<std::uint64_t>::max() - digit) / 10U)
+            return fail();
+        out = out * 10U + digit;
+    }
+    return out;
+}
+
+}
@@ -0,0 +1,141 @@
+/// \file
+/// Defines \ref zk::recipes::sequence_allocator, which hands out unique IDs from ranges reserved in one entry.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/buffer.hpp>
+#include <zk/callback.hpp>
+#include <zk/client.hpp>
+#include <zk/future.hpp>
+#include <zk/optional.hpp>
+#include <zk/path.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace zk::recipes
+{
+
+/// \addtogroup Recipes
+/// \{
+
+/// Allocates IDs which are unique among every allocator sharing the \ref counter entry. The entry holds the first ID
+/// nobody has reserved yet, written as decimal text. Instead of updating it for every ID, an allocator reserves a whole
+/// range of them with one versioned \ref client::set and then hands them out from memory, so a million IDs cost as many
+/// writes as there are ranges in them. Allocators racing for the entry see \ref error_code::version_mismatch and read
+/// it again.
+///
+/// \code
+/// zk::recipes::sequence_allocator ids(client, zk::path("/ids/orders"));
+/// std::uint64_t order_id = ids.allocate().get();
+/// \endcode
+///
+/// Taking an ID out of the current range is a few atomic operations and never blocks. When a range is partly used up
+/// (see \ref options::prefetch_fraction), the next one is reserved in the background, so a steady stream of allocations
+/// does not wait for the server. The size of a reservation follows the rate at which IDs are handed out, aiming for one
+/// reservation per \ref options::target_interval.
+///
+/// IDs are unique but not contiguous: IDs which were reserved and never handed out (because the allocator was
+/// destroyed first) are never used by anyone. Across allocators they are not ordered either, since each one works
+/// through its own range. If the entry does not exist, the first reservation creates it (its parent must exist); an
+/// existing entry which is empty counts as \c 0.
+class sequence_allocator final
+{
+public:
+    /// Controls how many IDs are reserved at once and when.
+    class options final
+    {
+    public:
+        options() = default;
+
+        /// How many IDs the first reservation asks for, before anything is known about the allocation rate.
+        std::uint64_t  initial_range() const { return _initial_range; }
+        std::uint64_t& initial_range()       { return _initial_range; }
+
+        /// \{
+        /// The bounds on the size of a reservation. Keeping \ref max_range modest bounds how many IDs a crashing
+        /// process takes with it.
+        std::uint64_t  min_range() const { return _min_range; }
+        std::uint64_t& min_range()       { return _min_range; }
+        std::uint64_t  max_range() const { return _max_range; }
+        std::uint64_t& max_range()       { return _max_range; }
+        /// \}
+
+        /// How long a range should last at the observed allocation rate. Reservations are resized (by at most a factor
+        /// of two each time) to match it.
+        std::chrono::milliseconds  target_interval() const { return _target_interval; }
+        std::chrono::milliseconds& target_interval()       { return _target_interval; }
+
+        /// The part of the current range which is still left when the next range is reserved, between \c 0 (wait for
+        /// the range to run out) and \c 1 (reserve the next range as soon as a range is put to use).
+        double  prefetch_fraction() const { return _prefetch_fraction; }
+        double& prefetch_fraction()       { return _prefetch_fraction; }
+
+    private:
+        std::uint64_t             _initial_range     = 10'000U;
+        std::uint64_t             _min_range         = 100U;
+        std::uint64_t             _max_range         = 1'000'000U;
+        std::chrono::milliseconds _target_interval   = std::chrono::seconds(1);
+        double                    _prefetch_fraction = 0.25;
+    };
+
+public:
+    /// \{
+    /// Allocate IDs from the entry \a counter. Nothing is sent to the server until the first allocation.
+    explicit sequence_allocator(client conn, zk::path counter);
+    explicit sequence_allocator(client conn, zk::path counter, options opts);
+    /// \}
+
+    sequence_allocator(sequence_allocator&&) noexcept;
+
+    /// Close this allocator (like the destructor does), then take over \a src.
+    sequence_allocator& operator=(sequence_allocator&& src) noexcept;
+
+    /// Stop reserving ranges. Allocations which are waiting for a range complete with \ref error_code::closed.
+    ~sequence_allocator() noexcept;
+
+    /// The entry holding the next unreserved ID.
+    const zk::path& counter() const noexcept;
+
+    /// \{
+    /// Get an ID which has never been handed out before. This completes right away unless the reserved ranges have run
+    /// out, in which case it completes once the next one is reserved (or with the error which kept it from being
+    /// reserved).
+    future<std::uint64_t> allocate();
+    void allocate(callback<std::uint64_t> on_complete);
+    /// \}
+
+    /// Get an ID from the ranges which are already reserved or \c nullopt if they have run out. This never waits for
+    /// the server, but it starts the reservation of the next range when it is due.
+    optional<std::uint64_t> try_allocate();
+
+    /// The number of IDs the latest reservation asked for or, before the first one, the number it will ask for.
+    std::uint64_t range_size() const;
+
+    /// The size a reservation should have when \a consumed IDs out of the \a previous reservation were handed out in
+    /// \a elapsed: enough to last for \ref options::target_interval at that rate, but no more than double or less than
+    /// half the \a previous size, and within \ref options::min_range and \ref options::max_range.
+    static std::uint64_t next_range_size(const options&           opts,
+                                         std::uint64_t            previous,
+                                         std::uint64_t            consumed,
+                                         std::chrono::nanoseconds elapsed
+                                        ) noexcept;
+
+    /// \{
+    /// The text the \ref counter entry holds for the next unreserved ID \a value and back. Decoding fails with
+    /// \ref error_code::invalid_arguments if the \a data is not a decimal number.
+    static buffer encode_counter(std::uint64_t value);
+    static outcome<std::uint64_t> decode_counter(const buffer& data);
+    /// \}
+
+private:
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// \}
+
+}
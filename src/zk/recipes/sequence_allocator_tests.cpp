@@ -0,0 +1,116 @@
+#include <zk/server/server_tests.hpp>
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/tests/test.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "sequence_allocator.hpp"
+
+namespace zk::recipes
+{
+
+static buffer buffer_from(const std::string& text)
+{
+    return buffer(text.data(), text.data() + text.size());
+}
+
+GTEST_TEST(sequence_counter_tests, encoding)
+{
+    CHECK_TRUE(buffer_from("0") == sequence_allocator::encode_counter(0U));
+    CHECK_TRUE(buffer_from("18446744073709551615")
+               == sequence_allocator::encode_counter(std::numeric_limits<std::uint64_t>::max())
+              );
+
+    CHECK_EQ(1234U, sequence_allocator::decode_counter(buffer_from("1234")).value());
+    CHECK_EQ(std::numeric_limits<std::uint64_t>::max(),
+             sequence_allocator::decode_counter(buffer_from("18446744073709551615")).value()
+            );
+    CHECK_EQ(0U, sequence_allocator::decode_counter(buffer()).value());
+
+    CHECK_EQ(error_code::invalid_arguments, sequence_allocator::decode_counter(buffer_from("12a")).code());
+    CHECK_EQ(error_code::invalid_arguments, sequence_allocator::decode_counter(buffer_from("-1")).code());
+    CHECK_EQ(error_code::invalid_arguments,
+             sequence_allocator::decode_counter(buffer_from("18446744073709551616")).code()
+            );
+}
+
+GTEST_TEST(sequence_allocator_sizing_tests, follows_rate)
+{
+    sequence_allocator::options opts;
+    opts.min_range()       = 10U;
+    opts.max_range()       = 100'000U;
+    opts.target_interval() = std::chrono::seconds(1);
+
+    // 1000 IDs in half a second calls for 2000 per second
+    CHECK_EQ(2'000U, sequence_allocator::next_range_size(opts, 1'000U, 1'000U, std::chrono::milliseconds(500)));
+    // 750 IDs in a second: the range is about right
+    CHECK_EQ(750U, sequence_allocator::next_range_size(opts, 1'000U, 750U, std::chrono::seconds(1)));
+}
+
+GTEST_TEST(sequence_allocator_sizing_tests, bounded_steps)
+{
+    sequence_allocator::options opts;
+    opts.min_range() = 10U;
+    opts.max_range() = 100'000U;
+
+    // Never more than double or less than half, however fast or slow
+    CHECK_EQ(2'000U, sequence_allocator::next_range_size(opts, 1'000U, 1'000U, std::chrono::microseconds(1)));
+    CHECK_EQ(2'000U, sequence_allocator::next_range_size(opts, 1'000U, 1'000U, std::chrono::nanoseconds(0)));
+    CHECK_EQ(500U, sequence_allocator::next_range_size(opts, 1'000U, 1U, std::chrono::hours(1)));
+
+    // ...and always within the configured bounds
+    CHECK_EQ(100'000U, sequence_allocator::next_range_size(opts, 80'000U, 80'000U, std::chrono::milliseconds(1)));
+    CHECK_EQ(10U, sequence_allocator::next_range_size(opts, 12U, 1U, std::chrono::hours(1)));
+}
+
+class sequence_allocator_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(sequence_allocator_tests, unique_across_allocators)
+{
+    client c = get_connected_client();
+    c.create("/sequence-unique", buffer()).get();
+
+    sequence_allocator::options opts;
+    opts.initial_range() = 100U;
+    opts.min_range()     = 10U;
+    sequence_allocator first(c, zk::path("/sequence-unique/counter"), opts);
+    sequence_allocator second(c, zk::path("/sequence-unique/counter"), opts);
+
+    std::set<std::uint64_t> seen;
+    for (int idx = 0; idx < 1'000; ++idx)
+    {
+        CHECK_TRUE(seen.insert(first.allocate().get()).second);
+        CHECK_TRUE(seen.insert(second.allocate().get()).second);
+    }
+
+    // Far fewer writes than IDs: the counter moved in whole ranges
+    auto counter = c.get("/sequence-unique/counter").get();
+    auto value   = sequence_allocator::decode_counter(counter.data()).value();
+    CHECK_LE(2'000U, value);
+    CHECK_GT(100, counter.stat().data_version.value);
+}
+
+GTEST_TEST_F(sequence_allocator_tests, continues_existing_counter)
+{
+    client c = get_connected_client();
+    c.create("/sequence-existing", sequence_allocator::encode_counter(5'000U)).get();
+
+    sequence_allocator ids(c, zk::path("/sequence-existing"));
+    CHECK_FALSE(ids.try_allocate());
+    auto id = ids.allocate().get();
+    CHECK_LE(5'000U, id);
+
+    c.set("/sequence-existing", buffer_from("not a number")).get();
+    sequence_allocator broken(c, zk::path("/sequence-existing"));
+    CHECK_THROWS(invalid_arguments) { broken.allocate().get(); };
+}
+
+}
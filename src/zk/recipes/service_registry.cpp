@@ -0,0 +1,782 @@
+#include "service_registry.hpp"
+
+#include <zk/error.hpp>
+#include <zk/multi.hpp>
+#include <zk/optional.hpp>
+#include <zk/results.hpp>
+#include <zk/types.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+namespace zk::recipes
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_endpoint                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void check_name(const std::string& name, const char* what)
+{
+    if (name.empty() || name.find('/') != std::string::npos)
+        throw std::invalid_argument(std::string("Invalid ") + what + " name \"" + name + '"');
+}
+
+service_endpoint::service_endpoint(std::string service, std::string name, buffer data) :
+        _service(std::move(service)),
+        _name(std::move(name)),
+        _data(std::move(data))
+{
+    check_name(_service, "service");
+    check_name(_name, "endpoint");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_registry::state                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// An announced endpoint. Every announcement of it bumps \c revision; \c written is the revision the session holds, so
+/// a transaction which wrote an older announcement does not mark a newer one as registered.
+struct service_registry::entry final
+{
+    std::string   service;
+    std::string   name;
+    buffer        data;
+    std::uint64_t revision   = 0U;
+    std::uint64_t written    = 0U;
+    bool          registered = false; //!< The entry exists and belongs to the current session
+    bool          replace    = false; //!< The entry belongs to someone else, so erase it before creating it
+};
+
+namespace
+{
+
+/// What one operation of a registration transaction is for.
+struct registration_step final
+{
+    enum class kind
+    {
+        erase_withdrawn,
+        erase_stale,
+        create,
+        set,
+    };
+
+    kind          what;
+    std::string   entry_path;
+    std::uint64_t revision;
+};
+
+}
+
+/// Everything goes through one transaction at a time: what changes in the meantime waits in \c entries and \c erasing
+/// for the next one, along with the callbacks in \c waiting. A new session (from \ref rebind) bumps \c generation, so
+/// the completions and state changes of the one before it are recognized and left alone.
+struct service_registry::state final :
+        std::enable_shared_from_this<service_registry::state>
+{
+    using step      = registration_step;
+    using entry_map = std::map<std::string, entry, std::less<>>;
+
+    explicit state(client conn, zk::path root, listener on_change, session_factory reconnect) :
+            root(std::move(root)),
+            on_change(std::move(on_change)),
+            conn(std::move(conn)),
+            reconnect(std::move(reconnect))
+    { }
+
+    /// Subscribe to the state changes of the current session. Call with \c protect held.
+    void follow()
+    {
+        std::weak_ptr<state> weak_self = shared_from_this();
+        auto                 gen       = generation;
+        subscription = conn.subscribe_state([weak_self, gen] (zk::state changed)
+                                            {
+                                                if (auto self = weak_self.lock())
+                                                    self->on_state(gen, changed);
+                                            }
+                                           );
+    }
+
+    void on_state(std::uint64_t gen, zk::state changed)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (gen != generation || closed)
+            return;
+
+        if (changed == zk::state::connected)
+        {
+            connected = true;
+            ax.unlock();
+            pump();
+        }
+        else if (changed == zk::state::expired_session)
+        {
+            connected = false;
+            forget_session();
+            auto factory = reconnect;
+            ax.unlock();
+
+            notify(outcome<void>(error_code::session_expired));
+            if (factory)
+                rebind(factory(), nullptr);
+        }
+        else
+        {
+            // Nothing can be created while connecting or through a read-only server
+            connected = false;
+        }
+    }
+
+    /// Nothing is registered any more. Call with \c protect held.
+    void forget_session()
+    {
+        for (auto& [path, item] : entries)
+        {
+            item.registered = false;
+            item.replace    = false;
+            item.written    = 0U;
+        }
+        erasing.clear();
+    }
+
+    void announce(std::vector<service_endpoint> endpoints, callback<void> on_complete)
+    {
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            for (auto& src : endpoints)
+            {
+                auto  entry_path = (root / src.service() / src.name()).str();
+                auto& item       = entries[entry_path];
+                item.service = src.service();
+                item.name    = src.name();
+                item.data    = src.data();
+                item.revision += 1U;
+            }
+            waiting.emplace_back(std::move(on_complete));
+        }
+        pump();
+    }
+
+    void withdraw(string_view service, string_view name, callback<void> on_complete)
+    {
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            auto iter = entries.find((root / service / name).str());
+            if (iter == entries.end())
+            {
+                ax.unlock();
+                on_complete(outcome<void>());
+                return;
+            }
+
+            if (iter->second.registered)
+                erasing.insert(iter->first);
+            entries.erase(iter);
+            waiting.emplace_back(std::move(on_complete));
+        }
+        pump();
+    }
+
+    void rebind(client replacement, callback<void> on_complete)
+    {
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            if (closed)
+            {
+                ax.unlock();
+                if (on_complete)
+                    on_complete(outcome<void>(error_code::closed));
+                return;
+            }
+
+            // This can be the state callback of the session being replaced, which must not be the one to let it go
+            generation += 1U;
+            retired   = std::move(conn);
+            conn      = std::move(replacement);
+            connected = true;
+            in_flight = false;
+            forget_session();
+            if (on_complete)
+                waiting.emplace_back(std::move(on_complete));
+            follow();
+        }
+        pump();
+    }
+
+    /// Send whatever is waiting to be registered or erased, unless a transaction is already in flight.
+    void pump()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (closed || in_flight || !connected)
+            return;
+
+        multi_op          txn;
+        std::vector<step> steps;
+        for (const auto& entry_path : erasing)
+        {
+            txn.push_back(op::erase(entry_path));
+            steps.push_back(step{ step::kind::erase_withdrawn, entry_path, 0U });
+        }
+        for (const auto& [entry_path, item] : entries)
+        {
+            if (!item.registered)
+            {
+                if (item.replace)
+                {
+                    txn.push_back(op::erase(entry_path));
+                    steps.push_back(step{ step::kind::erase_stale, entry_path, item.revision });
+                }
+                txn.push_back(op::create(entry_path, item.data, create_mode::ephemeral));
+                steps.push_back(step{ step::kind::create, entry_path, item.revision });
+            }
+            else if (item.written != item.revision)
+            {
+                txn.push_back(op::set(entry_path, item.data));
+                steps.push_back(step{ step::kind::set, entry_path, item.revision });
+            }
+        }
+
+        auto batch = std::exchange(waiting, {});
+        if (steps.empty())
+        {
+            ax.unlock();
+            complete(batch, outcome<void>());
+            return;
+        }
+
+        in_flight = true;
+        auto gen  = generation;
+        auto self = shared_from_this();
+        auto link = conn;
+        ax.unlock();
+
+        auto shared = std::make_shared<std::pair<std::vector<step>, std::vector<callback<void>>>>(std::move(steps),
+                                                                                                   std::move(batch)
+                                                                                                  );
+        try
+        {
+            link.commit(std::move(txn),
+                        [self, gen, shared] (outcome<multi_result> result)
+                        {
+                            self->on_commit(gen, std::move(shared->first), std::move(shared->second), result);
+                        }
+                       );
+        }
+        catch (...)
+        {
+            on_commit(gen,
+                      std::move(shared->first),
+                      std::move(shared->second),
+                      outcome<multi_result>(error_code::marshalling_error, std::current_exception())
+                     );
+        }
+    }
+
+    void on_commit(std::uint64_t                 gen,
+                   std::vector<step>             steps,
+                   std::vector<callback<void>>   batch,
+                   const outcome<multi_result>&  result
+                  )
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (gen != generation && !closed)
+        {
+            // Meant for a session which has been replaced; whoever was waiting on it waits for the new one instead
+            std::move(batch.begin(), batch.end(), std::back_inserter(waiting));
+            ax.unlock();
+            pump();
+            return;
+        }
+        in_flight = false;
+
+        if (result)
+        {
+            for (const auto& done : steps)
+                applied(done);
+            ax.unlock();
+
+            complete(batch, outcome<void>());
+            notify(outcome<void>());
+            pump();
+            return;
+        }
+
+        std::size_t failed_idx = steps.size();
+        error_code  cause      = result.code();
+        if (cause == error_code::transaction_failed)
+        {
+            try
+            {
+                std::rethrow_exception(result.error());
+            }
+            catch (const transaction_failed& ex)
+            {
+                failed_idx = ex.failed_op_index();
+                cause      = ex.underlying_cause();
+            }
+            catch (...)
+            { }
+        }
+
+        if (!closed && failed_idx < steps.size())
+        {
+            const auto& failed = steps[failed_idx];
+            auto        iter   = entries.find(failed.entry_path);
+            bool        retry  = true;
+            if (failed.what == step::kind::erase_withdrawn && cause == error_code::no_entry)
+                erasing.erase(failed.entry_path);
+            else if (failed.what == step::kind::erase_stale && cause == error_code::no_entry && iter != entries.end())
+                iter->second.replace = false;
+            else if (failed.what == step::kind::set && cause == error_code::no_entry && iter != entries.end())
+                iter->second.registered = false;
+            else if (failed.what == step::kind::create && (cause == error_code::entry_exists
+                                                           || cause == error_code::no_entry))
+                retry = false;
+            else
+                failed_idx = steps.size();
+
+            if (failed_idx < steps.size())
+            {
+                // Everyone waits for the transaction which follows the repair
+                in_flight = true;
+                ax.unlock();
+                if (retry)
+                    resume(gen, std::move(batch));
+                else if (cause == error_code::entry_exists)
+                    claim(gen, steps, std::move(batch));
+                else
+                    create_services(gen, steps, std::move(batch));
+                return;
+            }
+        }
+        ax.unlock();
+
+        auto failure = outcome<void>(cause, result.error());
+        complete(batch, failure);
+        notify(failure);
+    }
+
+    /// Record that \a done is what the session holds now. Call with \c protect held.
+    void applied(const step& done)
+    {
+        auto iter = entries.find(done.entry_path);
+        switch (done.what)
+        {
+        case step::kind::erase_withdrawn:
+            erasing.erase(done.entry_path);
+            break;
+        case step::kind::erase_stale:
+            break;
+        case step::kind::create:
+            if (iter == entries.end())
+            {
+                // Withdrawn while it was being created
+                erasing.insert(done.entry_path);
+                break;
+            }
+            iter->second.registered = true;
+            iter->second.replace    = false;
+            iter->second.written    = done.revision;
+            break;
+        case step::kind::set:
+            if (iter != entries.end())
+                iter->second.written = done.revision;
+            break;
+        }
+    }
+
+    /// Put \a batch back and send the next transaction, if the session is still \a gen.
+    void resume(std::uint64_t gen, std::vector<callback<void>> batch)
+    {
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            std::move(batch.begin(), batch.end(), std::back_inserter(waiting));
+            if (gen == generation)
+                in_flight = false;
+        }
+        pump();
+    }
+
+    /// Some of the entries to create already exist. Those the session owns (created by a transaction whose reply was
+    /// lost) only need their data written; those of another session are erased and created again.
+    void claim(std::uint64_t gen, const std::vector<step>& steps, std::vector<callback<void>> batch)
+    {
+        auto paths = std::make_shared<std::vector<std::string>>();
+        for (const auto& item : steps)
+            if (item.what == step::kind::create)
+                paths->push_back(item.entry_path);
+        std::vector<path_view> views(paths->begin(), paths->end());
+
+        auto self  = shared_from_this();
+        auto link  = current();
+        auto owner = link.current_session();
+        auto held  = std::make_shared<std::vector<callback<void>>>(std::move(batch));
+        link.exists_many(views,
+                         [self, gen, paths, held, owner] (outcome<std::vector<outcome<exists_result>>> result)
+                         {
+                             if (!result)
+                             {
+                                 self->give_up(gen, std::move(*held), outcome<void>(result.code(), result.error()));
+                                 return;
+                             }
+
+                             std::unique_lock<std::mutex> ax(self->protect);
+                             for (std::size_t idx = 0U; idx < paths->size(); ++idx)
+                             {
+                                 const auto& found = (*result)[idx];
+                                 auto        iter  = self->entries.find((*paths)[idx]);
+                                 if (!found || !*found || iter == self->entries.end())
+                                     continue;
+
+                                 auto& item = iter->second;
+                                 if (owner && found->stat()->ephemeral_owner == std::uint64_t(owner->id))
+                                     item.registered = true;
+                                 else
+                                     item.replace = true;
+                             }
+                             ax.unlock();
+                             self->resume(gen, std::move(*held));
+                         }
+                        );
+    }
+
+    /// The entries of some services do not exist yet, so create them.
+    void create_services(std::uint64_t gen, const std::vector<step>& steps, std::vector<callback<void>> batch)
+    {
+        // Withdrawn entries have to count too, or a transaction which only created those would never be repaired
+        std::set<std::string> services;
+        for (const auto& item : steps)
+            if (item.what == step::kind::create)
+                services.insert(zk::path(item.entry_path).parent().str());
+        if (services.empty())
+        {
+            resume(gen, std::move(batch));
+            return;
+        }
+
+        struct countdown final
+        {
+            std::mutex                  protect;
+            std::size_t                 remaining;
+            outcome<void>               status;
+            std::vector<callback<void>> batch;
+        };
+        auto progress = std::make_shared<countdown>();
+        progress->remaining = services.size();
+        progress->batch     = std::move(batch);
+
+        auto self = shared_from_this();
+        auto link = current();
+        for (const auto& service_path : services)
+        {
+            link.create(service_path,
+                        buffer(),
+                        create_mode::normal,
+                        [self, gen, progress] (outcome<create_result> result)
+                        {
+                            std::unique_lock<std::mutex> ax(progress->protect);
+                            if (!result && result.code() != error_code::entry_exists && progress->status)
+                                progress->status = outcome<void>(result.code(), result.error());
+                            if (--progress->remaining > 0U)
+                                return;
+                            ax.unlock();
+
+                            if (progress->status)
+                                self->resume(gen, std::move(progress->batch));
+                            else
+                                self->give_up(gen, std::move(progress->batch), progress->status);
+                        }
+                       );
+        }
+    }
+
+    /// A repair failed, so the transaction it was for does too.
+    void give_up(std::uint64_t gen, std::vector<callback<void>> batch, const outcome<void>& failure)
+    {
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            if (gen == generation)
+                in_flight = false;
+        }
+        complete(batch, failure);
+        notify(failure);
+    }
+
+    void close() noexcept
+    {
+        std::vector<std::string>    registered_paths;
+        std::vector<callback<void>> batch;
+        state_subscription          followed;
+        {
+            std::unique_lock<std::mutex> ax(protect);
+            closed   = true;
+            followed = std::move(subscription);
+            batch    = std::exchange(waiting, {});
+            for (const auto& [entry_path, item] : entries)
+                if (item.registered)
+                    registered_paths.push_back(entry_path);
+            registered_paths.insert(registered_paths.end(), erasing.begin(), erasing.end());
+        }
+        followed.cancel();
+
+        try
+        {
+            // One at a time rather than in a transaction, so one which is already gone does not keep the rest; nothing
+            // replaces the client once the registry is closed
+            for (const auto& entry_path : registered_paths)
+                conn.erase(entry_path, version::any(), [] (outcome<void>) { });
+            complete(batch, outcome<void>(error_code::closed));
+        }
+        catch (...)
+        { }
+    }
+
+    /// The client of the current session, which \ref rebind can replace at any time.
+    client current() const
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return conn;
+    }
+
+    static void complete(std::vector<callback<void>>& batch, const outcome<void>& result)
+    {
+        for (auto& on_complete : batch)
+            if (on_complete)
+                on_complete(result);
+        batch.clear();
+    }
+
+    void notify(const outcome<void>& result)
+    {
+        if (on_change)
+            on_change(result);
+    }
+
+    const zk::path  root;
+    const listener  on_change;
+
+    mutable std::mutex          protect;
+    client                      conn;
+    optional<client>            retired;    //!< The client \c conn replaced, kept until the next one is replaced
+    session_factory             reconnect;
+    state_subscription          subscription;
+    entry_map                   entries;
+    std::set<std::string>       erasing;    //!< Withdrawn entries which the session still holds
+    std::vector<callback<void>> waiting;
+    std::uint64_t               generation = 0U;
+    bool                        connected  = true; //!< Until told otherwise, so a connected client is used right away
+    bool                        in_flight  = false;
+    bool                        closed     = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_registry                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+service_registry::service_registry(client conn, zk::path root, listener on_change, session_factory reconnect) :
+        _state(std::make_shared<state>(std::move(conn), std::move(root), std::move(on_change), std::move(reconnect)))
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    _state->follow();
+}
+
+service_registry::~service_registry() noexcept
+{
+    if (_state)
+        _state->close();
+}
+
+const zk::path& service_registry::root() const noexcept
+{
+    return _state->root;
+}
+
+future<void> service_registry::announce(std::vector<service_endpoint> endpoints)
+{
+    return future_from_callback<void>([&] (auto cb) { this->announce(std::move(endpoints), std::move(cb)); });
+}
+
+void service_registry::announce(std::vector<service_endpoint> endpoints, callback<void> on_complete)
+{
+    _state->announce(std::move(endpoints), std::move(on_complete));
+}
+
+future<void> service_registry::withdraw(string_view service, string_view name)
+{
+    return future_from_callback<void>([&] (auto cb) { this->withdraw(service, name, std::move(cb)); });
+}
+
+void service_registry::withdraw(string_view service, string_view name, callback<void> on_complete)
+{
+    _state->withdraw(service, name, std::move(on_complete));
+}
+
+future<void> service_registry::rebind(client conn)
+{
+    return future_from_callback<void>([&] (auto cb) { this->rebind(std::move(conn), std::move(cb)); });
+}
+
+void service_registry::rebind(client conn, callback<void> on_complete)
+{
+    _state->rebind(std::move(conn), std::move(on_complete));
+}
+
+std::vector<service_endpoint> service_registry::endpoints() const
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    std::vector<service_endpoint> out;
+    out.reserve(_state->entries.size());
+    for (const auto& [entry_path, item] : _state->entries)
+        out.emplace_back(item.service, item.name, item.data);
+    return out;
+}
+
+bool service_registry::registered() const
+{
+    std::unique_lock<std::mutex> ax(_state->protect);
+    if (!_state->erasing.empty())
+        return false;
+    for (const auto& [entry_path, item] : _state->entries)
+        if (!item.registered || item.written != item.revision)
+            return false;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_discovery::state                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Changes to the tree rebuild the endpoints of the service they are in from the cache, one rebuild at a time, so the
+/// order the events arrive in does not matter: the last rebuild always sees the latest state of the cache. The map of
+/// services is published by swapping a pointer, which is the only thing \c publish_protect guards.
+struct service_discovery::state final :
+        std::enable_shared_from_this<service_discovery::state>
+{
+    explicit state(client conn, zk::path root, listener on_change) :
+            root(root),
+            prefix(root.str() == "/" ? root.str() : root.str() + '/'),
+            cache(std::move(conn), std::move(root)),
+            on_change(std::move(on_change)),
+            published(std::make_shared<const service_map>())
+    { }
+
+    void on_tree_change(const std::string& changed)
+    {
+        if (changed.size() <= prefix.size() || changed.compare(0U, prefix.size(), prefix) != 0)
+            return;
+
+        // Only services and their endpoints matter, not whatever else an endpoint entry might have under it
+        auto relative = string_view(changed).substr(prefix.size());
+        auto slash    = relative.find('/');
+        if (slash != string_view::npos && relative.find('/', slash + 1U) != string_view::npos)
+            return;
+
+        rebuild(std::string(relative.substr(0U, slash)));
+    }
+
+    void rebuild(const std::string& service)
+    {
+        std::unique_lock<std::mutex> wx(rebuild_protect);
+
+        auto service_path = root / service;
+        auto endpoints    = std::make_shared<endpoint_map>();
+        if (auto service_node = cache.get(service_path))
+        {
+            for (const auto& name : service_node->children())
+                if (auto endpoint_node = cache.get(service_path / name))
+                    endpoints->emplace_hint(endpoints->end(), name, std::move(endpoint_node));
+        }
+
+        auto current = services();
+        auto next    = std::make_shared<service_map>(*current);
+        if (endpoints->empty())
+        {
+            if (next->erase(service) == 0U)
+                return;
+        }
+        else
+        {
+            (*next)[service] = endpoints;
+        }
+
+        {
+            std::unique_lock<std::mutex> px(publish_protect);
+            published = std::move(next);
+        }
+
+        if (on_change)
+            on_change(service, endpoints);
+    }
+
+    std::shared_ptr<const service_map> services() const
+    {
+        std::unique_lock<std::mutex> px(publish_protect);
+        return published;
+    }
+
+    const zk::path    root;
+    const std::string prefix;
+    tree_cache        cache;
+    const listener    on_change;
+    std::size_t       listener_id = 0U;
+
+    std::mutex                         rebuild_protect;
+    mutable std::mutex                 publish_protect;
+    std::shared_ptr<const service_map> published;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// service_discovery                                                                                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+service_discovery::service_discovery(client conn, zk::path root, listener on_change) :
+        _state(std::make_shared<state>(std::move(conn), std::move(root), std::move(on_change)))
+{ }
+
+service_discovery::~service_discovery() noexcept
+{
+    _state->cache.remove_listener(_state->listener_id);
+}
+
+const zk::path& service_discovery::root() const noexcept
+{
+    return _state->root;
+}
+
+future<void> service_discovery::start()
+{
+    std::weak_ptr<state> weak_state = _state;
+    _state->listener_id = _state->cache.add_listener([weak_state] (tree_change_type,
+                                                                   const std::string&                        changed,
+                                                                   const std::shared_ptr<const tree_cache::node>&
+                                                                  )
+                                                     {
+                                                         if (auto target = weak_state.lock())
+                                                             target->on_tree_change(changed);
+                                                     }
+                                                    );
+    return _state->cache.start();
+}
+
+std::shared_ptr<const service_discovery::endpoint_map> service_discovery::endpoints(string_view service) const
+{
+    static const auto nothing = std::make_shared<const endpoint_map>();
+
+    auto current = _state->services();
+    auto iter    = current->find(service);
+    return iter == current->end() ? nothing : iter->second;
+}
+
+std::shared_ptr<const service_discovery::service_map> service_discovery::services() const
+{
+    return _state->services();
+}
+
+}
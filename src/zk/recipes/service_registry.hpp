@@ -0,0 +1,197 @@
+/// \file
+/// Defines \ref zk::recipes::service_registry, which publishes the endpoints of a session in bulk, and
+/// \ref zk::recipes::service_discovery, which follows every published endpoint from memory.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/buffer.hpp>
+#include <zk/callback.hpp>
+#include <zk/client.hpp>
+#include <zk/future.hpp>
+#include <zk/path.hpp>
+#include <zk/string_view.hpp>
+#include <zk/tree_cache.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zk::recipes
+{
+
+/// \addtogroup Recipes
+/// \{
+
+/// An endpoint of a service: the ephemeral entry \c "<root>/<service>/<name>" holding \ref data, which is whatever
+/// tells a client how to reach it (an address, a port, a description in JSON).
+class service_endpoint final
+{
+public:
+    /// \throws std::invalid_argument if \a service or \a name is empty or has a \c '/' in it.
+    explicit service_endpoint(std::string service, std::string name, buffer data);
+
+    const std::string& service() const noexcept { return _service; }
+
+    const std::string& name() const noexcept { return _name; }
+
+    const buffer& data() const noexcept { return _data; }
+
+private:
+    std::string _service;
+    std::string _name;
+    buffer      _data;
+};
+
+/// Publishes the endpoints one session provides under \ref root, which must already exist. The entry of each service is
+/// created (as a persistent entry) the first time an endpoint of it is registered.
+///
+/// Everything which changes while a registration is in flight, and every endpoint when a session has to register them
+/// again, goes out in one \ref client::commit, so a host with fifty endpoints costs the ensemble one transaction after
+/// a blip instead of fifty creates. Registration follows the session with \ref client::subscribe_state: endpoints
+/// announced while the session is disconnected are registered as soon as it is connected again. An endpoint left
+/// behind by another session (a previous run of the process which has not timed out yet, say) is replaced, so the
+/// names of a registry are its own.
+///
+/// \code
+/// zk::recipes::service_registry registry(client, zk::path("/services"));
+/// registry.announce({ zk::recipes::service_endpoint("api", host_name, api_address),
+///                     zk::recipes::service_endpoint("metrics", host_name, metrics_address),
+///                   }).get();
+/// \endcode
+///
+/// \par Session Expiry
+/// The endpoints vanish with the session. A registry with a \ref session_factory calls it once the session has expired
+/// and registers every endpoint through the new session, in a single transaction, once it is connected; without one,
+/// hand the registry a new client with \ref rebind.
+class service_registry final
+{
+public:
+    /// Told of the outcome of every transaction which registers endpoints: success, or the error which prevented it
+    /// (including \ref error_code::session_expired when the session ends). It runs on the ZooKeeper completion or
+    /// event thread, with the same restrictions as a \ref callback.
+    using listener = callback<void>;
+
+    /// Makes the client to use once the session has expired, such as <tt>zk::client(params)</tt>. It is called on
+    /// the ZooKeeper event thread, so it must not wait for the new client to connect.
+    using session_factory = std::function<client ()>;
+
+public:
+    explicit service_registry(client          conn,
+                              zk::path        root,
+                              listener        on_change = nullptr,
+                              session_factory reconnect = nullptr
+                             );
+
+    service_registry(service_registry&&) noexcept = default;
+    service_registry& operator=(service_registry&&) noexcept = default;
+
+    /// Stop following the session and erase every registered endpoint, without waiting for the server to confirm it.
+    ~service_registry() noexcept;
+
+    const zk::path& root() const noexcept;
+
+    /// \{
+    /// Register the \a endpoints, replacing the data of those already announced with the same service and name. They
+    /// are all created with one transaction (with anything else which is waiting to be registered), and registered
+    /// again after every change of session until they are withdrawn.
+    ///
+    /// \returns A future which is filled once the transaction which registers them completes, with its failure if it
+    ///  fails. The endpoints are kept either way, and registered again the next time the session is connected.
+    future<void> announce(std::vector<service_endpoint> endpoints);
+    void announce(std::vector<service_endpoint> endpoints, callback<void> on_complete);
+    /// \}
+
+    /// \{
+    /// Stop providing the endpoint \a name of \a service and erase its entry. Withdrawing something which was never
+    /// announced does nothing.
+    future<void> withdraw(string_view service, string_view name);
+    void withdraw(string_view service, string_view name, callback<void> on_complete);
+    /// \}
+
+    /// \{
+    /// Move every endpoint to the session of \a conn and register them with one transaction. The old session is not
+    /// followed any more; endpoints it still holds remain until it ends.
+    future<void> rebind(client conn);
+    void rebind(client conn, callback<void> on_complete);
+    /// \}
+
+    /// The endpoints which have been announced and not withdrawn, registered or not.
+    std::vector<service_endpoint> endpoints() const;
+
+    /// Are all of the announced endpoints registered through the current session?
+    bool registered() const;
+
+private:
+    struct entry;
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// Follows the endpoints of every service under \ref root, as published by \ref service_registry instances, with a
+/// \ref tree_cache. Lookups never go to the server.
+///
+/// The endpoints of each service are kept in an immutable map, which is replaced as a whole when one of them changes,
+/// so the map \ref endpoints returns can be used for as long as it is wanted without any locking; it is a consistent
+/// view of the service as of some point in time. Looking one up costs copying a pointer. Maps of services which did
+/// not change are shared between the versions of the set of services.
+///
+/// \code
+/// zk::recipes::service_discovery discovery(client, zk::path("/services"));
+/// discovery.start().get();
+/// for (const auto& [name, contents] : *discovery.endpoints("api"))
+///     connect(name, contents->data());
+/// \endcode
+///
+/// As with the \ref tree_cache, a session which has expired leaves the endpoints as they were last seen; create a new
+/// instance with a new session.
+class service_discovery final
+{
+public:
+    /// The endpoints of one service, by name, with the contents of their entries.
+    using endpoint_map = std::map<std::string, std::shared_ptr<const tree_cache::node>, std::less<>>;
+
+    /// Every service with the endpoints it has.
+    using service_map = std::map<std::string, std::shared_ptr<const endpoint_map>, std::less<>>;
+
+    /// Called with the name of a service and its new endpoints after they change. It runs on the ZooKeeper event
+    /// thread, with the same restrictions as a \ref callback.
+    using listener = std::function<void (const std::string& service, const std::shared_ptr<const endpoint_map>&)>;
+
+public:
+    /// Create a discovery of the services under \a root. Nothing is fetched until \ref start is called.
+    explicit service_discovery(client conn, zk::path root, listener on_change = nullptr);
+
+    service_discovery(const service_discovery&) = delete;
+    service_discovery& operator=(const service_discovery&) = delete;
+
+    ~service_discovery() noexcept;
+
+    const zk::path& root() const noexcept;
+
+    /// Start following the services.
+    ///
+    /// \returns A future which is filled once every endpoint which was published when it started has been loaded.
+    /// \throws std::logic_error If it has already been started.
+    future<void> start();
+
+    /// The endpoints of \a service, which is an empty map for a service nobody provides.
+    std::shared_ptr<const endpoint_map> endpoints(string_view service) const;
+
+    /// Every service with at least one endpoint known so far.
+    std::shared_ptr<const service_map> services() const;
+
+private:
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// \}
+
+}
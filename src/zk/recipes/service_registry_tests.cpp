@@ -0,0 +1,146 @@
+#include <zk/server/server_tests.hpp>
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/tests/test.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+#include "service_registry.hpp"
+
+namespace zk::recipes
+{
+
+static buffer buffer_from(string_view str)
+{
+    return buffer(str.data(), str.data() + str.size());
+}
+
+/// Wait up to 10 seconds for \a condition to hold.
+static bool eventually(const std::function<bool ()>& condition)
+{
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+}
+
+/// The session which holds the entry at \a path.
+static std::uint64_t owner_of(const client& c, path_view path)
+{
+    return c.exists(path).get().stat()->ephemeral_owner;
+}
+
+GTEST_TEST(service_endpoint_tests, names)
+{
+    service_endpoint endpoint("api", "host-1", buffer_from("10.0.0.1:80"));
+    CHECK_EQ("api", endpoint.service());
+    CHECK_EQ("host-1", endpoint.name());
+    CHECK_TRUE(endpoint.data() == buffer_from("10.0.0.1:80"));
+
+    CHECK_THROWS(std::invalid_argument) { service_endpoint("", "host-1", buffer()); };
+    CHECK_THROWS(std::invalid_argument) { service_endpoint("api", "", buffer()); };
+    CHECK_THROWS(std::invalid_argument) { service_endpoint("api", "host/1", buffer()); };
+    CHECK_THROWS(std::invalid_argument) { service_endpoint("a/pi", "host-1", buffer()); };
+}
+
+class service_registry_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(service_registry_tests, announce_and_discover)
+{
+    client c = get_connected_client();
+    c.create("/services-basic", buffer()).get();
+
+    service_discovery discovery(c, zk::path("/services-basic"));
+    discovery.start().get();
+    CHECK_THROWS(std::logic_error) { discovery.start(); };
+    CHECK_TRUE(discovery.endpoints("api")->empty());
+
+    {
+        service_registry registry(c, zk::path("/services-basic"));
+        registry.announce({ service_endpoint("api", "host-1", buffer_from("a1")),
+                            service_endpoint("api", "host-2", buffer_from("a2")),
+                            service_endpoint("metrics", "host-1", buffer_from("m1")),
+                          }).get();
+        CHECK_TRUE(registry.registered());
+        CHECK_EQ(3U, registry.endpoints().size());
+        CHECK_EQ(2U, c.get_children("/services-basic/api").get().children().size());
+
+        CHECK_TRUE(eventually([&] { return discovery.endpoints("api")->size() == 2U; }));
+        CHECK_TRUE(eventually([&] { return discovery.services()->size() == 2U; }));
+        auto api = discovery.endpoints("api");
+        CHECK_TRUE(api->at("host-1")->data() == buffer_from("a1"));
+        CHECK_TRUE(api->at("host-2")->data() == buffer_from("a2"));
+
+        // Announcing an endpoint again only replaces its data
+        registry.announce({ service_endpoint("api", "host-1", buffer_from("a1'")) }).get();
+        CHECK_TRUE(buffer_from("a1'") == c.get("/services-basic/api/host-1").get().data());
+        CHECK_TRUE(eventually([&] { return discovery.endpoints("api")->at("host-1")->data() == buffer_from("a1'"); }));
+
+        // A snapshot is not changed by what happens after it was taken
+        registry.withdraw("api", "host-2").get();
+        CHECK_FALSE(c.exists("/services-basic/api/host-2").get());
+        CHECK_TRUE(eventually([&] { return discovery.endpoints("api")->size() == 1U; }));
+        CHECK_EQ(2U, api->size());
+
+        registry.withdraw("api", "never-announced").get();
+        CHECK_EQ(2U, registry.endpoints().size());
+    }
+
+    // Closing the registry takes its endpoints down with it
+    CHECK_TRUE(eventually([&] { return discovery.services()->empty(); }));
+    CHECK_TRUE(discovery.endpoints("metrics")->empty());
+}
+
+GTEST_TEST_F(service_registry_tests, replaces_stale_endpoints)
+{
+    client previous = get_connected_client();
+    client c        = get_connected_client();
+    c.create("/services-stale", buffer()).get();
+    c.create("/services-stale/api", buffer()).get();
+
+    // What a previous run of the process left behind, through a session which has not timed out yet
+    previous.create("/services-stale/api/host-1", buffer_from("old"), create_mode::ephemeral).get();
+
+    service_registry registry(c, zk::path("/services-stale"));
+    registry.announce({ service_endpoint("api", "host-1", buffer_from("new")),
+                        service_endpoint("api", "host-2", buffer_from("new")),
+                      }).get();
+    CHECK_TRUE(registry.registered());
+    CHECK_TRUE(buffer_from("new") == c.get("/services-stale/api/host-1").get().data());
+    CHECK_EQ(std::uint64_t(c.current_session()->id), owner_of(c, "/services-stale/api/host-1"));
+    CHECK_EQ(std::uint64_t(c.current_session()->id), owner_of(c, "/services-stale/api/host-2"));
+}
+
+GTEST_TEST_F(service_registry_tests, rebind_moves_endpoints)
+{
+    client first  = get_connected_client();
+    client second = get_connected_client();
+    first.create("/services-rebind", buffer()).get();
+
+    service_registry registry(first, zk::path("/services-rebind"));
+    registry.announce({ service_endpoint("api", "host-1", buffer_from("a")),
+                        service_endpoint("db", "host-1", buffer_from("d")),
+                      }).get();
+    CHECK_EQ(std::uint64_t(first.current_session()->id), owner_of(first, "/services-rebind/api/host-1"));
+
+    // The first session still holds both entries, so the new one has to take them over
+    registry.rebind(second).get();
+    CHECK_TRUE(registry.registered());
+    CHECK_EQ(std::uint64_t(second.current_session()->id), owner_of(second, "/services-rebind/api/host-1"));
+    CHECK_EQ(std::uint64_t(second.current_session()->id), owner_of(second, "/services-rebind/db/host-1"));
+
+    // The endpoints belong to the second session now, so the first one ending does not take them down
+    first.close();
+    CHECK_TRUE(second.exists("/services-rebind/api/host-1").get());
+}
+
+}
@@ -1,4 +1,5 @@
 #include "results.hpp"
+#include "buffer_pool.hpp"
 
 #include <ostream>
 #include <sstream>
@@ -57,9 +58,89 @@ get_result::get_result(buffer data, const zk::stat& stat) noexcept :
         _stat(stat)
 { }
 
-get_result::~get_result() noexcept
+get_result::get_result(buffer data, const zk::stat& stat, std::shared_ptr<buffer_pool> pool) noexcept :
+        _data(std::move(data)),
+        _stat(stat),
+        _pool(std::move(pool))
 { }
 
+get_result::get_result(shared_buffer data, const zk::stat& stat) :
+        _stat(stat)
+{
+    _shared = data.whole();
+    if (!_shared)
+        _shared = std::make_shared<const buffer>(data.begin(), data.end());
+}
+
+get_result& get_result::operator=(get_result&& src) noexcept
+{
+    if (this != &src)
+    {
+        release();
+        _data   = std::move(src._data);
+        _shared = std::move(src._shared);
+        _stat   = src._stat;
+        _pool   = std::move(src._pool);
+    }
+    return *this;
+}
+
+get_result::~get_result() noexcept
+{
+    release();
+}
+
+buffer& get_result::data() &
+{
+    unshare();
+    return _data;
+}
+
+buffer get_result::data() &&
+{
+    unshare();
+    return std::move(_data);
+}
+
+shared_buffer get_result::shared_data() const &
+{
+    if (_shared)
+        return shared_buffer(_shared);
+    else
+        return shared_buffer(_data.data(), _data.data() + _data.size());
+}
+
+shared_buffer get_result::shared_data() &&
+{
+    share();
+    return shared_buffer(std::move(_shared));
+}
+
+void get_result::share()
+{
+    if (_shared)
+        return;
+
+    // The storage is no longer ours to give back to the pool
+    _shared = std::make_shared<const buffer>(std::move(_data));
+    _pool.reset();
+}
+
+void get_result::unshare()
+{
+    if (!_shared)
+        return;
+
+    auto shared = std::move(_shared);
+    _data = buffer(shared->data(), shared->data() + shared->size());
+}
+
+void get_result::release() noexcept
+{
+    if (_pool)
+        std::exchange(_pool, nullptr)->release(std::move(_data));
+}
+
 std::ostream& operator<<(std::ostream& os, const get_result& self)
 {
     os << "get_result{";
@@ -98,6 +179,30 @@ std::string to_string(const get_children_result& self)
     return to_string_generic(self);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// get_children_list_result                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+get_children_list_result::get_children_list_result(children_list children, const stat& parent_stat) noexcept :
+        _children(std::move(children)),
+        _parent_stat(parent_stat)
+{ }
+
+get_children_list_result::~get_children_list_result() noexcept
+{ }
+
+std::ostream& operator<<(std::ostream& os, const get_children_list_result& self)
+{
+    os << "get_children_list_result{" << self.children();
+    os << " parent=" << self.parent_stat();
+    return os << '}';
+}
+
+std::string to_string(const get_children_list_result& self)
+{
+    return to_string_generic(self);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // exists_result                                                                                                      //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -192,14 +297,18 @@ std::string to_string(const get_acl_result& self)
 // event                                                                                                              //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-event::event(event_type type, zk::state state) noexcept :
+event::event(event_type type, zk::state state, std::string path) noexcept :
         _type(type),
-        _state(state)
+        _state(state),
+        _path(std::move(path))
 { }
 
 std::ostream& operator<<(std::ostream& os, const event& self)
 {
-    return os << "event{" << self.type() << " | " << self.state() << '}';
+    os << "event{" << self.type() << " | " << self.state();
+    if (!self.path().empty())
+        os << " | " << self.path();
+    return os << '}';
 }
 
 std::string to_string(const event& self)
@@ -251,6 +360,30 @@ std::string to_string(const watch_children_result& self)
     return to_string_generic(self);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// watch_children_list_result                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+watch_children_list_result::watch_children_list_result(get_children_list_result initial,
+                                                       future<event>            next
+                                                      ) noexcept :
+        _initial(std::move(initial)),
+        _next(std::move(next))
+{ }
+
+watch_children_list_result::~watch_children_list_result() noexcept
+{ }
+
+std::ostream& operator<<(std::ostream& os, const watch_children_list_result& self)
+{
+    return os << "watch_children_list_result{initial=" << self.initial() << '}';
+}
+
+std::string to_string(const watch_children_list_result& self)
+{
+    return to_string_generic(self);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // watch_exists_result                                                                                                //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -5,13 +5,17 @@
 #include <zk/config.hpp>
 
 #include <iosfwd>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "acl.hpp"
 #include "buffer.hpp"
+#include "children_list.hpp"
+#include "forwards.hpp"
 #include "future.hpp"
 #include "optional.hpp"
+#include "shared_buffer.hpp"
 #include "types.hpp"
 
 namespace zk
@@ -21,20 +25,54 @@ namespace zk
 /// \{
 
 /// The result type of \c client::get.
+///
+/// The data is either owned by the result (which is how results arrive from the server) or, once \ref share has been
+/// called, held in the storage of a \ref shared_buffer. Copies of a shared result view the same storage, which is how a
+/// cache hands one value to any number of readers without copying it for each. Getting mutable access to the data of
+/// a shared result gives this copy its own again.
 class get_result final
 {
 public:
     explicit get_result(buffer data, const zk::stat& stat) noexcept;
 
+    /// Create an instance whose \a data came from \a pool. The storage is given back to \a pool when this instance is
+    /// destroyed (unless the data has been moved out first).
+    explicit get_result(buffer data, const zk::stat& stat, std::shared_ptr<buffer_pool> pool) noexcept;
+
+    /// Create a shared instance viewing \a data. If \a data is only a slice of its storage, the slice is copied once
+    /// into storage of its own, so that \ref data can still be a whole \ref buffer.
+    explicit get_result(shared_buffer data, const zk::stat& stat);
+
+    get_result(const get_result&) = default;
+    get_result(get_result&&) noexcept = default;
+
+    get_result& operator=(const get_result&) = default;
+    get_result& operator=(get_result&&) noexcept;
+
     ~get_result() noexcept;
 
     /// \{
-    /// The data read from the entry.
-    const buffer& data() const & { return _data; }
-    buffer&       data() &       { return _data; }
-    buffer        data() &&      { return std::move(_data); }
+    /// The data read from the entry. The mutable forms stop a shared result from sharing (copying the data unless this
+    /// is its only view).
+    const buffer& data() const & { return _shared ? *_shared : _data; }
+    buffer&       data() &;
+    buffer        data() &&;
+    /// \}
+
+    /// \{
+    /// The data read from the entry as a \ref shared_buffer. For a shared result, this is another view of its storage;
+    /// otherwise the data is copied (or, for an rvalue, moved without a copy).
+    shared_buffer shared_data() const &;
+    shared_buffer shared_data() &&;
     /// \}
 
+    /// Move the data into shared storage, so copies of this result (and of what \ref shared_data gives) stop costing a
+    /// copy of it. This does not copy the data and does nothing if the result is already shared.
+    void share();
+
+    /// Is the data held in shared storage (see \ref share)?
+    bool is_shared() const noexcept { return bool(_shared); }
+
     /// \{
     /// The \ref zk::stat of the entry at the time it was read. The most useful value of the returned value is
     /// \ref stat::data_version.
@@ -43,8 +81,16 @@ public:
     /// \}
 
 private:
-    buffer   _data;
-    zk::stat _stat;
+    void release() noexcept;
+
+    /// Give this instance its own data again.
+    void unshare();
+
+private:
+    buffer                        _data;
+    std::shared_ptr<const buffer> _shared;
+    zk::stat                      _stat;
+    std::shared_ptr<buffer_pool>  _pool;
 };
 
 std::ostream& operator<<(std::ostream&, const get_result&);
@@ -84,6 +130,37 @@ std::ostream& operator<<(std::ostream&, const get_children_result&);
 
 std::string to_string(const get_children_result&);
 
+/// The result type of \c client::get_children_list. This holds the same information as \ref get_children_result, but
+/// the names of the children are kept in a \ref children_list instead of one \c std::string each.
+class get_children_list_result final
+{
+public:
+    explicit get_children_list_result(children_list children, const stat& parent_stat) noexcept;
+
+    ~get_children_list_result() noexcept;
+
+    /// \{
+    /// The children of the originally-queried node, in no particular order (see \ref children_list::sort).
+    const children_list& children() const & { return _children; }
+    children_list&       children() &       { return _children; }
+    children_list        children() &&      { return std::move(_children); }
+    /// \}
+
+    /// \{
+    /// The \ref zk::stat of the entry queried (the parent of the \ref children).
+    const stat& parent_stat() const { return _parent_stat; }
+    stat&       parent_stat()       { return _parent_stat; }
+    /// \}
+
+private:
+    children_list _children;
+    stat          _parent_stat;
+};
+
+std::ostream& operator<<(std::ostream&, const get_children_list_result&);
+
+std::string to_string(const get_children_list_result&);
+
 /// The result type of \ref client::exists.
 class exists_result final
 {
@@ -193,16 +270,14 @@ std::string to_string(const get_acl_result&);
 /// Data delivered when a watched event triggers.
 ///
 /// \note
-/// If you are familiar with the ZooKeeper C API, the limited information delivered might seem very simplistic. Since
-/// this API only supports non-global watches, the extra parameters are not helpful and generally unsafe. As an example,
-/// the \c path parameter is not included. It is not helpful to include, since you already know the path you specified
-/// when you set the watch in the first place. Furthermore, it is unsafe, as the contents addressed by the pointer are
-/// only safe in the callback thread. While we could copy the path into an \c std::string, this would require an
-/// allocation on every delivery, which is very intrusive.
+/// If you are familiar with the ZooKeeper C API, the information delivered might seem limited. The C API also hands
+/// its watcher a pointer to the path, which is only valid in the callback thread; here the \ref path is copied out
+/// instead. Most callbacks already know the path they set the watch on, but one callback shared by many watches (see
+/// \ref watch_dispatcher) has to be told.
 class event final
 {
 public:
-    explicit event(event_type type, zk::state state) noexcept;
+    explicit event(event_type type, zk::state state, std::string path = std::string()) noexcept;
 
     /// The type of event that occurred.
     const event_type& type() const { return _type; }
@@ -211,9 +286,14 @@ public:
     /// delivered.
     const zk::state& state() const { return _state; }
 
+    /// The path of the entry the event is about, relative to the chroot of the connection. This is empty for events
+    /// which are about the session rather than an entry (\ref event_type::session).
+    const std::string& path() const { return _path; }
+
 private:
-    event_type _type;
-    zk::state  _state;
+    event_type  _type;
+    zk::state   _state;
+    std::string _path;
 };
 
 std::ostream& operator<<(std::ostream&, const event&);
@@ -286,6 +366,39 @@ std::ostream& operator<<(std::ostream&, const watch_children_result&);
 
 std::string to_string(const watch_children_result&);
 
+/// The result type of \c client::watch_children_list.
+class watch_children_list_result final
+{
+public:
+    explicit watch_children_list_result(get_children_list_result initial, future<event> next) noexcept;
+
+    watch_children_list_result(watch_children_list_result&&) = default;
+
+    ~watch_children_list_result() noexcept;
+
+    /// \{
+    /// The initial result of the fetch.
+    const get_children_list_result& initial() const & { return _initial; }
+    get_children_list_result&       initial() &       { return _initial; }
+    get_children_list_result        initial() &&      { return std::move(_initial); }
+    /// \}
+
+    /// \{
+    /// Future to be delivered when the watch is triggered.
+    const future<event>& next() const & { return _next; }
+    future<event>&       next() &       { return _next; }
+    future<event>        next() &&      { return std::move(_next); }
+    /// \}
+
+private:
+    get_children_list_result _initial;
+    future<event>            _next;
+};
+
+std::ostream& operator<<(std::ostream&, const watch_children_list_result&);
+
+std::string to_string(const watch_children_list_result&);
+
 /// The result type of \ref client::watch_exists.
 class watch_exists_result final
 {
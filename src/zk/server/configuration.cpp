@@ -162,6 +162,10 @@ configuration configuration::from_lines(std::vector<std::string> lines)
             {
                 out._leader_serves = { (data == "yes"), line_no };
             }
+            else if (name == "reconfigEnabled")
+            {
+                out._reconfig_enabled = { (data == "true"), line_no };
+            }
             else if (name == "4lw.commands.whitelist")
             {
                 out._four_letter_word_whitelist = { parse_whitelist(data), line_no };
@@ -322,6 +326,17 @@ configuration& configuration::leader_serves(optional<bool> serve)
     return *this;
 }
 
+bool configuration::reconfig_enabled() const
+{
+    return _reconfig_enabled.value.value_or(false);
+}
+
+configuration& configuration::reconfig_enabled(optional<bool> enabled)
+{
+    set(_reconfig_enabled, enabled, "reconfigEnabled", [] (bool x) { return x ? "true" : "false"; });
+    return *this;
+}
+
 const std::set<std::string>& configuration::four_letter_word_whitelist() const
 {
     if (_four_letter_word_whitelist.value)
@@ -445,6 +460,7 @@ bool operator==(const configuration& lhs, const configuration& rhs)
         && lhs.init_limit()                 == rhs.init_limit()
         && lhs.sync_limit()                 == rhs.sync_limit()
         && lhs.leader_serves()              == rhs.leader_serves()
+        && lhs.reconfig_enabled()           == rhs.reconfig_enabled()
         && lhs.four_letter_word_whitelist() == rhs.four_letter_word_whitelist()
         && lhs._server_paths.size()         == rhs._server_paths.size()
         && lhs._server_paths.end()          == std::mismatch(lhs._server_paths.begin(), lhs._server_paths.end(),
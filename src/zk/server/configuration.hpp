@@ -169,6 +169,14 @@ public:
     configuration& leader_serves(optional<bool> serve);
     /// \}
 
+    /// \{
+    /// May the members of the ensemble be changed while it runs (with \ref client::reconfigure)? This defaults to
+    /// \c false, in which case such requests fail with \ref reconfiguration_disabled. Only ZooKeeper 3.5.3 and newer
+    /// know this setting; older servers always allow reconfiguration.
+    bool           reconfig_enabled() const;
+    configuration& reconfig_enabled(optional<bool> enabled);
+    /// \}
+
     /// \{
     /// A list of comma separated four letter words commands that user wants to use. A valid four letter words command
     /// must be put in this list or the ZooKeeper server will not enable the command. If unspecified, the whitelist only
@@ -267,6 +275,7 @@ private:
     setting<std::size_t>                        _init_limit;
     setting<std::size_t>                        _sync_limit;
     setting<bool>                               _leader_serves;
+    setting<bool>                               _reconfig_enabled;
     setting<std::set<std::string>>              _four_letter_word_whitelist;
     std::map<server_id, setting<std::string>>   _server_paths;
     std::map<std::string, setting<std::string>> _unknown_settings;
@@ -99,4 +99,35 @@ GTEST_TEST(configuration_tests, four_letter_words)
     CHECK_TRUE(expected == parsed.four_letter_word_whitelist());
 }
 
+GTEST_TEST(configuration_tests, reconfig_enabled)
+{
+    auto minimal = configuration::make_minimal("/some/path");
+    CHECK_FALSE(minimal.reconfig_enabled());
+
+    minimal.reconfig_enabled(true);
+    CHECK_TRUE(minimal.reconfig_enabled());
+
+    auto reparsed = configuration::from_string(configuration_source_file_example);
+    CHECK_FALSE(reparsed.reconfig_enabled());
+    reparsed.add_setting("reconfigEnabled", "true");
+    CHECK_TRUE(reparsed.reconfig_enabled());
+}
+
+// What client::get_config delivers: the dynamic part of the configuration of each member and its version
+static string_view dynamic_configuration_example =
+R"(server.1=zookeeper1:2888:3888:participant;0.0.0.0:2181
+server.2=zookeeper2:2888:3888:participant;0.0.0.0:2181
+server.3=zookeeper3:2888:3888:observer;0.0.0.0:2181
+version=100000000)";
+
+GTEST_TEST(configuration_tests, from_dynamic_configuration)
+{
+    auto parsed = configuration::from_string(dynamic_configuration_example);
+
+    auto servers = parsed.servers();
+    CHECK_EQ(3U, servers.size());
+    CHECK_EQ("zookeeper3:2888:3888:observer;0.0.0.0:2181", servers.at(server_id(3)));
+    CHECK_EQ("100000000", parsed.unknown_settings().at("version"));
+}
+
 }
@@ -0,0 +1,159 @@
+#include "four_letter_word.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../configuration.hpp"
+
+namespace zk::server::detail
+{
+
+using clock_type = std::chrono::steady_clock;
+
+/** Wait until \a fd is ready for \a events or \a deadline passes.
+ *
+ *  \returns \c true if the descriptor is ready.
+**/
+static bool wait_for(int fd, short events, clock_type::time_point deadline)
+{
+    while (true)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock_type::now());
+        if (remaining.count() <= 0)
+            return false;
+
+        ::pollfd entry{ fd, events, 0 };
+        auto     wait = std::min<std::chrono::milliseconds::rep>(remaining.count(), 1000);
+        int      rc   = ::poll(&entry, 1U, static_cast<int>(wait));
+        if (rc > 0)
+            return true;
+        else if (rc < 0 && errno != EINTR)
+            throw std::system_error(errno, std::system_category(), "poll");
+    }
+}
+
+/** Connect to \a address, send \a word and collect the reply, giving up at \a deadline. **/
+static optional<std::string> exchange(const ::sockaddr*      address,
+                                      ::socklen_t            address_size,
+                                      const std::string&     word,
+                                      clock_type::time_point deadline
+                                     )
+{
+    int fd = ::socket(address->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "socket");
+
+    struct closer
+    {
+        int fd;
+
+        ~closer() noexcept
+        {
+            ::close(fd);
+        }
+    } guard{ fd };
+
+    if (::connect(fd, address, address_size) != 0)
+    {
+        if (errno != EINPROGRESS || !wait_for(fd, POLLOUT, deadline))
+            return nullopt;
+
+        int       error = 0;
+        socklen_t size  = sizeof error;
+        if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) != 0 || error != 0)
+            return nullopt;
+    }
+
+    if (word.empty())
+        return std::string();
+    if (::send(fd, word.data(), word.size(), MSG_NOSIGNAL) != static_cast<::ssize_t>(word.size()))
+        return nullopt;
+
+    std::string reply;
+    char        chunk[512];
+    while (wait_for(fd, POLLIN, deadline))
+    {
+        auto got = ::recv(fd, chunk, sizeof chunk, 0);
+        if (got == 0)
+            return reply;
+        else if (got > 0)
+            reply.append(chunk, static_cast<std::size_t>(got));
+        else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return nullopt;
+    }
+    return nullopt;
+}
+
+optional<std::string> send_four_letter_word(std::uint16_t             port,
+                                            const std::string&        word,
+                                            std::chrono::milliseconds timeout
+                                           )
+{
+    ::sockaddr_in address{};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return exchange(reinterpret_cast<const ::sockaddr*>(&address), sizeof address, word, clock_type::now() + timeout);
+}
+
+optional<std::string> send_four_letter_word(const std::string&        host,
+                                            std::uint16_t             port,
+                                            const std::string&        word,
+                                            std::chrono::milliseconds timeout
+                                           )
+{
+    auto deadline = clock_type::now() + timeout;
+
+    ::addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_NUMERICSERV;
+
+    ::addrinfo* found     = nullptr;
+    auto        port_name = std::to_string(port);
+    if (::getaddrinfo(host.c_str(), port_name.c_str(), &hints, &found) != 0)
+        return nullopt;
+
+    optional<std::string> reply;
+    for (auto entry = found; entry && !reply && clock_type::now() < deadline; entry = entry->ai_next)
+        reply = exchange(entry->ai_addr, entry->ai_addrlen, word, deadline);
+    ::freeaddrinfo(found);
+    return reply;
+}
+
+std::string readiness_word(const configuration& settings)
+{
+    const auto& allowed = settings.four_letter_word_whitelist();
+    if (allowed.count("*") || allowed.count("srvr"))
+        return "srvr";
+    else if (allowed.count("ruok"))
+        return "ruok";
+    else
+        return "";
+}
+
+bool is_ready_reply(const std::string& word, const std::string& reply)
+{
+    if (word == "srvr")
+        return reply.find("\nMode: ") != std::string::npos;
+    else if (word == "ruok")
+        return reply == "imok";
+    else
+        return true;
+}
+
+bool probe_ready(std::uint16_t port, const std::string& word, std::chrono::milliseconds timeout)
+{
+    auto reply = send_four_letter_word(port, word, timeout);
+    return reply && is_ready_reply(word, *reply);
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/optional.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace zk::server
+{
+
+class configuration;
+
+}
+
+namespace zk::server::detail
+{
+
+/** Send the four letter \a word to the ZooKeeper server listening on \a port of the loopback interface and collect the
+ *  reply (the server closes the connection once it has written it). With an empty \a word, nothing is sent and the
+ *  reply is empty as soon as the connection is accepted.
+ *
+ *  \returns The reply or \c nullopt if nothing is listening on \a port, the server dropped the connection or it did
+ *   not answer within \a timeout.
+**/
+optional<std::string> send_four_letter_word(std::uint16_t             port,
+                                            const std::string&        word,
+                                            std::chrono::milliseconds timeout
+                                           );
+
+/** Send the four letter \a word to the ZooKeeper server listening on \a port of \a host, which is a name or a numeric
+ *  address of either family. Each address \a host resolves to is tried in turn until one answers (or \a timeout
+ *  passes).
+**/
+optional<std::string> send_four_letter_word(const std::string&        host,
+                                            std::uint16_t             port,
+                                            const std::string&        word,
+                                            std::chrono::milliseconds timeout
+                                           );
+
+/** Choose the four letter word to probe a server run with \a settings with: \c "srvr" if its whitelist allows it,
+ *  \c "ruok" if only that is allowed, or an empty string if neither is (in which case accepting a connection on the
+ *  client port is all there is to go by).
+**/
+std::string readiness_word(const configuration& settings);
+
+/** Does \a reply to \a word mean that the server is serving clients? A server which is running but not part of a
+ *  quorum answers \c "ruok" with \c "imok" but \c "srvr" with a note that it is not serving, so only \c "srvr" tells
+ *  the two apart.
+**/
+bool is_ready_reply(const std::string& word, const std::string& reply);
+
+/** Probe the server on \a port with \a word (see \ref readiness_word). **/
+bool probe_ready(std::uint16_t port, const std::string& word, std::chrono::milliseconds timeout);
+
+}
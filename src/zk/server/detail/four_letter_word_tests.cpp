@@ -0,0 +1,107 @@
+#include <zk/tests/test.hpp>
+
+#include "four_letter_word.hpp"
+#include "../configuration.hpp"
+
+#include <string>
+#include <thread>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace zk::server::detail
+{
+
+/** Listens on an ephemeral loopback port and answers one connection with a canned reply, like a server would. **/
+class fake_server final
+{
+public:
+    explicit fake_server(std::string reply) :
+            _fd(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0))
+    {
+        ::sockaddr_in address{};
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(_fd, reinterpret_cast<const ::sockaddr*>(&address), sizeof address);
+        ::listen(_fd, 1);
+
+        socklen_t size = sizeof address;
+        ::getsockname(_fd, reinterpret_cast<::sockaddr*>(&address), &size);
+        _port = ntohs(address.sin_port);
+
+        _worker = std::thread([this, reply = std::move(reply)]
+                              {
+                                  int conn = ::accept(_fd, nullptr, nullptr);
+                                  char word[4];
+                                  auto got = ::recv(conn, word, sizeof word, MSG_WAITALL);
+                                  _word.assign(word, got > 0 ? static_cast<std::size_t>(got) : 0U);
+                                  ::send(conn, reply.data(), reply.size(), MSG_NOSIGNAL);
+                                  ::close(conn);
+                              }
+                             );
+    }
+
+    ~fake_server() noexcept
+    {
+        _worker.join();
+        ::close(_fd);
+    }
+
+    std::uint16_t port() const { return _port; }
+
+    /// The word which was received (only valid once the reply was received).
+    const std::string& word() const { return _word; }
+
+private:
+    int           _fd;
+    std::uint16_t _port = 0U;
+    std::string   _word;
+    std::thread   _worker;
+};
+
+GTEST_TEST(four_letter_word_tests, replies)
+{
+    CHECK_TRUE(is_ready_reply("srvr", "Zookeeper version: 3.5.4\nLatency min/avg/max: 0/0/0\nMode: follower\n"));
+    CHECK_FALSE(is_ready_reply("srvr", "This ZooKeeper instance is not currently serving requests\n"));
+    CHECK_TRUE(is_ready_reply("ruok", "imok"));
+    CHECK_FALSE(is_ready_reply("ruok", ""));
+}
+
+GTEST_TEST(four_letter_word_tests, choose_word)
+{
+    auto settings = configuration::make_minimal("zk-data");
+    CHECK_EQ("srvr", readiness_word(settings));
+    settings.four_letter_word_whitelist(std::set<std::string>{ "ruok", "stat" });
+    CHECK_EQ("ruok", readiness_word(settings));
+    settings.four_letter_word_whitelist(configuration::all_four_letter_word_whitelist);
+    CHECK_EQ("srvr", readiness_word(settings));
+    settings.four_letter_word_whitelist(std::set<std::string>{});
+    CHECK_EQ("", readiness_word(settings));
+}
+
+GTEST_TEST(four_letter_word_tests, probe)
+{
+    std::string reply = "Zookeeper version: 3.5.4\nMode: standalone\nNode count: 4\n";
+    {
+        fake_server srv(reply);
+        CHECK_EQ(reply, send_four_letter_word(srv.port(), "srvr", std::chrono::seconds(5)).value());
+        CHECK_EQ("srvr", srv.word());
+    }
+
+    {
+        fake_server srv("This ZooKeeper instance is not currently serving requests\n");
+        CHECK_FALSE(probe_ready(srv.port(), "srvr", std::chrono::seconds(5)));
+    }
+
+    // Nothing listens there any more
+    std::uint16_t closed_port = 0U;
+    {
+        fake_server srv("imok");
+        closed_port = srv.port();
+        CHECK_TRUE(probe_ready(srv.port(), "ruok", std::chrono::seconds(5)));
+    }
+    CHECK_FALSE(send_four_letter_word(closed_port, "ruok", std::chrono::milliseconds(200)));
+}
+
+}
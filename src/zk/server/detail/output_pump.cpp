@@ -0,0 +1,189 @@
+#include "output_pump.hpp"
+
+#include <array>
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "close.hpp"
+
+namespace zk::server::detail
+{
+
+/// The most read from a source in one go.
+static constexpr std::size_t chunk_size = 64U * 1024U;
+
+output_pump::output_pump() :
+        _epoll_fd(::epoll_create1(EPOLL_CLOEXEC)),
+        _running(true)
+{
+    if (_epoll_fd < 0)
+        throw std::system_error(errno, std::system_category(), "epoll_create1");
+
+    ::epoll_event wake{};
+    wake.events  = EPOLLIN;
+    wake.data.fd = _wakeup.native_handle();
+    if (::epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup.native_handle(), &wake) != 0)
+    {
+        auto err = errno;
+        detail::close(_epoll_fd);
+        throw std::system_error(err, std::system_category(), "epoll_ctl");
+    }
+
+    _worker = std::thread([this] { run(); });
+}
+
+output_pump::~output_pump() noexcept
+{
+    _running.store(false, std::memory_order_release);
+    _wakeup.notify_one();
+    if (_worker.joinable())
+        _worker.join();
+    ::close(_epoll_fd);
+}
+
+std::shared_ptr<output_pump> output_pump::shared()
+{
+    static std::mutex                 instance_protect;
+    static std::weak_ptr<output_pump> instance;
+
+    std::unique_lock<std::mutex> ax(instance_protect);
+    auto out = instance.lock();
+    if (!out)
+    {
+        out      = std::make_shared<output_pump>();
+        instance = out;
+    }
+    return out;
+}
+
+void output_pump::add(handle fd, sink on_data, handle spill_fd)
+{
+    source src;
+    src.on_data  = std::move(on_data);
+    src.spill_fd = spill_fd;
+    if (spill_fd != -1)
+        src.spill = std::make_unique<pipe>();
+
+    std::unique_lock<std::mutex> ax(_protect);
+    ::epoll_event entry{};
+    entry.events  = EPOLLIN;
+    entry.data.fd = fd;
+    if (::epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &entry) != 0)
+        throw std::system_error(errno, std::system_category(), "epoll_ctl");
+    _sources[fd] = std::move(src);
+}
+
+void output_pump::remove(handle fd)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    auto iter = _sources.find(fd);
+    if (iter == _sources.end())
+        return;
+
+    drain(fd, iter->second);
+    ::epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    _sources.erase(iter);
+}
+
+std::size_t output_pump::size() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return _sources.size();
+}
+
+/// Move \a count bytes from the pipe \a from to the file \a to.
+///
+/// \returns \c false if the file would not take them.
+static bool splice_all(int from, int to, std::size_t count)
+{
+    while (count > 0U)
+    {
+        auto moved = ::splice(from, nullptr, to, nullptr, count, SPLICE_F_MOVE);
+        if (moved > 0)
+            count -= static_cast<std::size_t>(moved);
+        else if (moved < 0 && errno == EINTR)
+            continue;
+        else
+            return false;
+    }
+    return true;
+}
+
+bool output_pump::drain(handle fd, source& src)
+{
+    std::array<char, chunk_size> chunk;
+    while (true)
+    {
+        std::size_t want = chunk.size();
+        if (src.spill)
+        {
+            // Duplicate what is waiting without consuming it, then read exactly that much, so the file and the sink
+            // see the same bytes
+            auto teed = ::tee(fd, src.spill->native_write_handle(), want, SPLICE_F_NONBLOCK);
+            if (teed > 0)
+            {
+                want = static_cast<std::size_t>(teed);
+                if (!splice_all(src.spill->native_read_handle(), src.spill_fd, want))
+                    src.spill.reset();
+            }
+            else if (teed < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                src.spill.reset();
+            }
+        }
+
+        auto got = ::read(fd, chunk.data(), want);
+        if (got > 0)
+            src.on_data(chunk.data(), static_cast<std::size_t>(got));
+        else if (got == 0)
+            return false;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return true;
+        else if (errno != EINTR)
+            return false;
+    }
+}
+
+void output_pump::run()
+{
+    std::array<::epoll_event, 16> events;
+    while (_running.load(std::memory_order_acquire))
+    {
+        int count = ::epoll_wait(_epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            else
+                return;
+        }
+
+        for (int idx = 0; idx < count; ++idx)
+        {
+            auto fd = events[static_cast<std::size_t>(idx)].data.fd;
+            if (fd == _wakeup.native_handle())
+            {
+                _wakeup.try_wait();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> ax(_protect);
+            auto iter = _sources.find(fd);
+            if (iter == _sources.end())
+                continue;
+
+            if (!drain(fd, iter->second))
+            {
+                ::epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+                _sources.erase(iter);
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "event_handle.hpp"
+#include "pipe.hpp"
+
+namespace zk::server::detail
+{
+
+/** Reads the output of any number of processes with one thread, which waits on all of their pipes with \c epoll.
+ *  Every \ref server shares the same pump (see \ref shared), so an ensemble of five servers is read by one thread
+ *  rather than five.
+**/
+class output_pump final
+{
+public:
+    using handle = int;
+
+    /** Called on the pump's thread with each chunk of data read from a source. **/
+    using sink = std::function<void (const char* data, std::size_t size)>;
+
+public:
+    output_pump();
+
+    output_pump(const output_pump&) = delete;
+    output_pump& operator=(const output_pump&) = delete;
+
+    /** Stop the thread. Sources which are still registered are no longer read. **/
+    ~output_pump() noexcept;
+
+    /** Get the pump shared by everything in this process, creating it if nobody holds it right now. **/
+    static std::shared_ptr<output_pump> shared();
+
+    /** Start reading the (non-blocking) read end \a fd, passing what is read to \a on_data. When \a fd reaches its end,
+     *  it is removed.
+     *
+     *  \param spill_fd If not \c -1, everything read from \a fd is also written to this file. The data is duplicated
+     *   with \c tee into a pipe of the pump's and moved from there to the file with \c splice, so it never has to be
+     *   copied to the pump's memory and back.
+    **/
+    void add(handle fd, sink on_data, handle spill_fd = -1);
+
+    /** Read what is left in \a fd and stop reading it. Once this returns, the sink of \a fd is never called again.
+     *  Removing a source which is not (or no longer) registered does nothing.
+    **/
+    void remove(handle fd);
+
+    /** The number of sources being read. **/
+    std::size_t size() const;
+
+private:
+    struct source
+    {
+        sink                  on_data;
+        handle                spill_fd = -1;
+        std::unique_ptr<pipe> spill;         //!< The pipe \c tee duplicates into, if spilling
+    };
+
+private:
+    void run();
+
+    /** Read everything \a fd has to offer right now.
+     *
+     *  \returns \c false if \a fd has reached its end.
+    **/
+    bool drain(handle fd, source& src);
+
+private:
+    handle                   _epoll_fd;
+    event_handle             _wakeup;
+    std::atomic<bool>        _running;
+    mutable std::mutex       _protect;  //!< Held while a source is read, so \ref remove can wait out a read in flight
+    std::map<handle, source> _sources;
+    std::thread              _worker;
+};
+
+}
@@ -0,0 +1,130 @@
+#include <zk/tests/test.hpp>
+
+#include "output_pump.hpp"
+#include "pipe.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+namespace zk::server::detail
+{
+
+/** Collects what a sink is given, from whatever thread. **/
+class collector final
+{
+public:
+    output_pump::sink sink()
+    {
+        return [this] (const char* data, std::size_t size)
+               {
+                   std::unique_lock<std::mutex> ax(_protect);
+                   _data.append(data, size);
+               };
+    }
+
+    std::string data() const
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        return _data;
+    }
+
+private:
+    mutable std::mutex _protect;
+    std::string        _data;
+};
+
+GTEST_TEST(output_pump_tests, remove_drains)
+{
+    output_pump pump;
+    collector   got;
+    pipe        p;
+
+    pump.add(p.native_read_handle(), got.sink());
+    CHECK_EQ(1U, pump.size());
+
+    std::string buff(20000, 'z');
+    p.write(buff);
+    pump.remove(p.native_read_handle());
+    CHECK_EQ(0U, pump.size());
+    CHECK_EQ(buff, got.data());
+
+    // Removed sources are not read any more and removing twice is harmless
+    p.write("more");
+    pump.remove(p.native_read_handle());
+    CHECK_EQ(buff, got.data());
+}
+
+GTEST_TEST(output_pump_tests, end_of_file_removes)
+{
+    output_pump pump;
+    collector   got;
+    pipe        p;
+
+    pump.add(p.native_read_handle(), got.sink());
+    p.write("last words");
+    p.close_write();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (pump.size() > 0U && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    CHECK_EQ(0U, pump.size());
+    CHECK_EQ("last words", got.data());
+}
+
+GTEST_TEST(output_pump_tests, many_sources)
+{
+    output_pump pump;
+    collector   got_a;
+    collector   got_b;
+    pipe        a;
+    pipe        b;
+
+    pump.add(a.native_read_handle(), got_a.sink());
+    pump.add(b.native_read_handle(), got_b.sink());
+    CHECK_EQ(2U, pump.size());
+
+    a.write("from a");
+    b.write("from b");
+    pump.remove(a.native_read_handle());
+    pump.remove(b.native_read_handle());
+    CHECK_EQ("from a", got_a.data());
+    CHECK_EQ("from b", got_b.data());
+}
+
+GTEST_TEST(output_pump_tests, spill)
+{
+    char name[] = "/tmp/output_pump_tests.XXXXXX";
+    int  spill  = ::mkstemp(name);
+    CHECK_LE(0, spill);
+
+    {
+        output_pump pump;
+        collector   got;
+        pipe        p;
+
+        pump.add(p.native_read_handle(), got.sink(), spill);
+        std::string buff;
+        for (int idx = 0; idx < 5000; ++idx)
+            buff += std::to_string(idx) + "\n";
+        p.write(buff);
+        pump.remove(p.native_read_handle());
+        CHECK_EQ(buff, got.data());
+
+        std::ifstream     file(name);
+        const std::string spilled((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        CHECK_EQ(buff, spilled);
+    }
+
+    ::close(spill);
+    ::unlink(name);
+}
+
+}
@@ -0,0 +1,86 @@
+#include "log_capture.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace zk::server
+{
+
+log_capture::log_capture(std::size_t capacity) :
+        _ring(capacity)
+{
+    if (capacity == 0U)
+        throw std::invalid_argument("A log_capture needs room for at least one byte");
+}
+
+log_capture::~log_capture() noexcept = default;
+
+void log_capture::append(const char* data, std::size_t size)
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    _total += size;
+
+    auto cap = _ring.size();
+    if (size >= cap)
+    {
+        // Only the end of it fits
+        std::copy(data + (size - cap), data + size, _ring.begin());
+        _start = 0U;
+        _size  = cap;
+        return;
+    }
+
+    auto end   = (_start + _size) % cap;
+    auto first = std::min(size, cap - end);
+    std::copy(data, data + first, _ring.begin() + static_cast<std::ptrdiff_t>(end));
+    std::copy(data + first, data + size, _ring.begin());
+
+    if (_size + size > cap)
+    {
+        _start = (_start + _size + size - cap) % cap;
+        _size  = cap;
+    }
+    else
+    {
+        _size += size;
+    }
+}
+
+std::string log_capture::copy_last(std::size_t count) const
+{
+    auto cap   = _ring.size();
+    auto from  = (_start + (_size - count)) % cap;
+    auto first = std::min(count, cap - from);
+
+    std::string out;
+    out.reserve(count);
+    out.append(_ring.data() + from, first);
+    out.append(_ring.data(), count - first);
+    return out;
+}
+
+std::string log_capture::contents() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return copy_last(_size);
+}
+
+std::string log_capture::tail(std::size_t max_bytes) const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return copy_last(std::min(max_bytes, _size));
+}
+
+std::uint64_t log_capture::total_bytes() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return _total;
+}
+
+std::uint64_t log_capture::dropped_bytes() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return _total - _size;
+}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/optional.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace zk::server
+{
+
+/// \addtogroup Server
+/// \{
+
+/// Controls what happens to the output (\c stdout and \c stderr) of a \ref server process.
+class capture_options final
+{
+public:
+    /// The default value for \ref capacity.
+    static constexpr std::size_t default_capacity = 1024U * 1024U;
+
+public:
+    capture_options() = default;
+
+    /// How much of the most recent output is kept in memory (see \ref log_capture).
+    std::size_t  capacity() const { return _capacity; }
+    std::size_t& capacity()       { return _capacity; }
+
+    /// If set, all of the output is also written to this file, which is truncated when the server starts. The data is
+    /// moved from the process's pipes to the file by the kernel (with \c tee and \c splice), so spilling a chatty
+    /// server costs next to nothing. A \ref server_group appends the ID of each server to the name.
+    const optional<std::string>& spill_file() const { return _spill_file; }
+    optional<std::string>&       spill_file()       { return _spill_file; }
+
+    /// Should the output also be copied to \c std::cout and \c std::cerr, as it comes? This is off by default, as the
+    /// output of several servers interleaves unreadably with that of the tests.
+    bool  echo() const { return _echo; }
+    bool& echo()       { return _echo; }
+
+private:
+    std::size_t           _capacity = default_capacity;
+    optional<std::string> _spill_file;
+    bool                  _echo     = false;
+};
+
+/// A bounded ring buffer of the most recent output of a process. Once it is full, new output overwrites the oldest, so
+/// memory use stays at \ref capacity however long the process runs. It is safe to read from while output is appended.
+class log_capture final
+{
+public:
+    explicit log_capture(std::size_t capacity = capture_options::default_capacity);
+
+    log_capture(const log_capture&) = delete;
+    log_capture& operator=(const log_capture&) = delete;
+
+    ~log_capture() noexcept;
+
+    /// Add the \a size bytes at \a data, dropping the oldest output if there is not enough room.
+    void append(const char* data, std::size_t size);
+
+    /// Get everything which is still held, oldest first.
+    std::string contents() const;
+
+    /// Get (up to) the last \a max_bytes of output.
+    std::string tail(std::size_t max_bytes) const;
+
+    /// The most output held at once.
+    std::size_t capacity() const noexcept { return _ring.size(); }
+
+    /// \{
+    /// The amount of output ever appended and the part of it which has been overwritten since.
+    std::uint64_t total_bytes() const;
+    std::uint64_t dropped_bytes() const;
+    /// \}
+
+private:
+    /// Called with the lock held.
+    std::string copy_last(std::size_t count) const;
+
+private:
+    mutable std::mutex _protect;
+    std::vector<char>  _ring;
+    std::size_t        _start = 0U; //!< The position of the oldest byte held
+    std::size_t        _size  = 0U; //!< The number of bytes held
+    std::uint64_t      _total = 0U;
+};
+
+/// \}
+
+}
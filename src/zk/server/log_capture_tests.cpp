@@ -0,0 +1,55 @@
+#include <zk/tests/test.hpp>
+
+#include "log_capture.hpp"
+
+#include <stdexcept>
+#include <string>
+
+namespace zk::server
+{
+
+GTEST_TEST(log_capture_tests, empty)
+{
+    log_capture capture(16U);
+    CHECK_EQ(16U, capture.capacity());
+    CHECK_EQ("", capture.contents());
+    CHECK_EQ("", capture.tail(4U));
+    CHECK_EQ(0U, capture.total_bytes());
+    CHECK_EQ(0U, capture.dropped_bytes());
+
+    CHECK_THROWS(std::invalid_argument) { log_capture(0U); };
+}
+
+GTEST_TEST(log_capture_tests, wraparound)
+{
+    log_capture capture(8U);
+    capture.append("abcde", 5U);
+    CHECK_EQ("abcde", capture.contents());
+
+    capture.append("fghij", 5U);
+    CHECK_EQ("cdefghij", capture.contents());
+    CHECK_EQ(10U, capture.total_bytes());
+    CHECK_EQ(2U, capture.dropped_bytes());
+
+    capture.append("kl", 2U);
+    CHECK_EQ("efghijkl", capture.contents());
+    CHECK_EQ("jkl", capture.tail(3U));
+    CHECK_EQ("efghijkl", capture.tail(100U));
+}
+
+GTEST_TEST(log_capture_tests, oversize_append)
+{
+    log_capture capture(4U);
+    capture.append("xy", 2U);
+
+    std::string big = "0123456789";
+    capture.append(big.data(), big.size());
+    CHECK_EQ("6789", capture.contents());
+    CHECK_EQ(12U, capture.total_bytes());
+    CHECK_EQ(8U, capture.dropped_bytes());
+
+    capture.append("z", 1U);
+    CHECK_EQ("789z", capture.contents());
+}
+
+}
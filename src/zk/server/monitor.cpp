@@ -0,0 +1,335 @@
+#include "monitor.hpp"
+
+#include <zk/connection.hpp>
+#include <zk/string_view.hpp>
+
+#include <cstdlib>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "server_group.hpp"
+#include "detail/four_letter_word.hpp"
+
+namespace zk::server
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// endpoint                                                                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+endpoint endpoint::parse(const std::string& src)
+{
+    auto colon = src.rfind(':');
+    if (colon == std::string::npos || colon + 1U == src.size())
+        throw std::invalid_argument("Endpoint \"" + src + "\" has no port");
+
+    auto port_name = src.substr(colon + 1U);
+    if (port_name.find_first_not_of("0123456789") != std::string::npos || port_name.size() > 5U)
+        throw std::invalid_argument("Endpoint \"" + src + "\" has an invalid port");
+    auto port = std::stoul(port_name);
+    if (port == 0U || port > 65535U)
+        throw std::invalid_argument("Endpoint \"" + src + "\" has an invalid port");
+
+    endpoint out;
+    out.host = src.substr(0U, colon);
+    if (out.host.size() >= 2U && out.host.front() == '[' && out.host.back() == ']')
+        out.host = out.host.substr(1U, out.host.size() - 2U);
+    out.port = static_cast<std::uint16_t>(port);
+    return out;
+}
+
+std::vector<endpoint> endpoint::all_of(const connection_params& params)
+{
+    std::vector<endpoint> out;
+    out.reserve(params.hosts().size());
+    for (const auto& host : params.hosts())
+        out.emplace_back(parse(host));
+    return out;
+}
+
+bool operator==(const endpoint& a, const endpoint& b)
+{
+    return a.host == b.host && a.port == b.port;
+}
+
+bool operator!=(const endpoint& a, const endpoint& b)
+{
+    return !(a == b);
+}
+
+std::ostream& operator<<(std::ostream& os, const endpoint& self)
+{
+    if (self.host.find(':') != std::string::npos)
+        return os << '[' << self.host << "]:" << self.port;
+    else
+        return os << self.host << ':' << self.port;
+}
+
+std::string to_string(const endpoint& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Replies                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Parse the leading integer of \a src, which is \c 0 if there is none.
+static std::int64_t to_integer(const std::string& src, int base = 10)
+{
+    return static_cast<std::int64_t>(std::strtoll(src.c_str(), nullptr, base));
+}
+
+optional<server_stats> server_stats::parse(const std::string& reply)
+{
+    constexpr string_view prefix = "zk_";
+
+    server_stats out;
+    std::istringstream lines(reply);
+    std::string        line;
+    while (std::getline(lines, line))
+    {
+        auto tab = line.find('\t');
+        if (tab == std::string::npos || line.compare(0U, prefix.size(), prefix.data(), prefix.size()) != 0)
+            continue;
+
+        auto value = line.substr(tab + 1U);
+        if (!value.empty() && value.back() == '\r')
+            value.pop_back();
+        out.values[line.substr(prefix.size(), tab - prefix.size())] = std::move(value);
+    }
+
+    if (out.values.empty())
+        return nullopt;
+
+    auto text_of = [&] (const char* key) -> std::string
+                   {
+                       auto iter = out.values.find(key);
+                       return iter == out.values.end() ? std::string() : iter->second;
+                   };
+    auto integer_of = [&] (const char* key) { return to_integer(text_of(key)); };
+
+    out.version                      = text_of("version");
+    out.server_state                 = text_of("server_state");
+    out.avg_latency                  = std::strtod(text_of("avg_latency").c_str(), nullptr);
+    out.min_latency                  = integer_of("min_latency");
+    out.max_latency                  = integer_of("max_latency");
+    out.packets_received             = integer_of("packets_received");
+    out.packets_sent                 = integer_of("packets_sent");
+    out.num_alive_connections        = integer_of("num_alive_connections");
+    out.outstanding_requests         = integer_of("outstanding_requests");
+    out.znode_count                  = integer_of("znode_count");
+    out.watch_count                  = integer_of("watch_count");
+    out.ephemerals_count             = integer_of("ephemerals_count");
+    out.approximate_data_size        = integer_of("approximate_data_size");
+    out.open_file_descriptor_count   = integer_of("open_file_descriptor_count");
+    out.fsync_threshold_exceed_count = integer_of("fsync_threshold_exceed_count");
+    return out;
+}
+
+optional<watch_summary> watch_summary::parse(const std::string& reply)
+{
+    // 2 connections watching 5 paths
+    // Total watches:7
+    watch_summary out;
+    std::istringstream is(reply);
+    std::string        connections_word, watching_word, paths_word;
+    if (!(is >> out.connections >> connections_word >> watching_word >> out.paths >> paths_word)
+        || connections_word != "connections"
+        || watching_word != "watching"
+       )
+        return nullopt;
+
+    auto total = reply.find("Total watches:");
+    if (total == std::string::npos)
+        return nullopt;
+    out.watches = to_integer(reply.substr(total + string_view("Total watches:").size()));
+    return out;
+}
+
+std::vector<connection_stats> connection_stats::parse_all(const std::string& reply)
+{
+    // " /127.0.0.1:56854[1](queued=0,recved=9,sent=9,sid=0x1000a4e1c2b0000,lop=PING,...,maxlat=1)"
+    std::vector<connection_stats> out;
+    std::istringstream            lines(reply);
+    std::string                   line;
+    while (std::getline(lines, line))
+    {
+        auto start = line.find('/');
+        auto open  = line.find('[', start);
+        auto paren = line.find('(', open);
+        auto close = line.rfind(')');
+        if (start == std::string::npos || open == std::string::npos || paren == std::string::npos
+            || close == std::string::npos || close < paren
+           )
+            continue;
+
+        connection_stats conn;
+        conn.address = line.substr(start + 1U, open - start - 1U);
+
+        std::istringstream fields(line.substr(paren + 1U, close - paren - 1U));
+        std::string        field;
+        while (std::getline(fields, field, ','))
+        {
+            auto eq = field.find('=');
+            if (eq == std::string::npos)
+                continue;
+
+            auto key   = field.substr(0U, eq);
+            auto value = field.substr(eq + 1U);
+            if (key == "queued")
+                conn.queued = to_integer(value);
+            else if (key == "recved")
+                conn.received = to_integer(value);
+            else if (key == "sent")
+                conn.sent = to_integer(value);
+            else if (key == "sid")
+                conn.session_id = static_cast<std::int64_t>(std::strtoull(value.c_str(), nullptr, 16));
+            else if (key == "minlat")
+                conn.min_latency = to_integer(value);
+            else if (key == "avglat")
+                conn.avg_latency = to_integer(value);
+            else if (key == "maxlat")
+                conn.max_latency = to_integer(value);
+        }
+        out.emplace_back(std::move(conn));
+    }
+    return out;
+}
+
+optional<server_stats_delta> server_stats_delta::between(const server_sample& before, const server_sample& after)
+{
+    if (!before.stats || !after.stats)
+        return nullopt;
+
+    const auto&        a = *before.stats;
+    const auto&        b = *after.stats;
+    server_stats_delta out;
+    out.source                       = after.source;
+    out.elapsed                      = after.taken - before.taken;
+    out.packets_received             = b.packets_received - a.packets_received;
+    out.packets_sent                 = b.packets_sent - a.packets_sent;
+    out.num_alive_connections        = b.num_alive_connections - a.num_alive_connections;
+    out.outstanding_requests         = b.outstanding_requests - a.outstanding_requests;
+    out.znode_count                  = b.znode_count - a.znode_count;
+    out.watch_count                  = b.watch_count - a.watch_count;
+    out.ephemerals_count             = b.ephemerals_count - a.ephemerals_count;
+    out.approximate_data_size        = b.approximate_data_size - a.approximate_data_size;
+    out.fsync_threshold_exceed_count = b.fsync_threshold_exceed_count - a.fsync_threshold_exceed_count;
+    return out;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// monitor                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+monitor::monitor(std::vector<endpoint> targets, monitor_options options) :
+        _targets(std::move(targets)),
+        _options(std::move(options))
+{ }
+
+monitor::monitor(const server_group& servers, monitor_options options) :
+        monitor(endpoint::all_of(connection_params::parse(servers.get_connection_string())), std::move(options))
+{ }
+
+monitor::~monitor() noexcept
+{
+    stop();
+}
+
+std::vector<server_sample> monitor::scrape() const
+{
+    std::vector<server_sample> out;
+    out.reserve(_targets.size());
+    for (const auto& target : _targets)
+    {
+        auto ask = [&] (const char* word) -> std::string
+                   {
+                       return detail::send_four_letter_word(target.host, target.port, word, _options.timeout())
+                              .value_or(std::string());
+                   };
+
+        server_sample sample;
+        sample.source = target;
+        sample.taken  = std::chrono::steady_clock::now();
+        sample.stats  = server_stats::parse(ask("mntr"));
+        if (_options.scrape_watches())
+            sample.watches = watch_summary::parse(ask("wchs"));
+        if (_options.scrape_connections())
+            sample.connections = connection_stats::parse_all(ask("cons"));
+        out.emplace_back(std::move(sample));
+    }
+    return out;
+}
+
+void monitor::sample()
+{
+    auto samples = scrape();
+
+    std::unique_lock<std::mutex> ax(_protect);
+    _previous = std::exchange(_latest, std::move(samples));
+}
+
+void monitor::start()
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    if (_running)
+        return;
+
+    _running = true;
+    _worker  = std::thread([this] { run(); });
+}
+
+void monitor::stop()
+{
+    std::thread worker;
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        _running = false;
+        worker   = std::move(_worker);
+    }
+    _wakeup.notify_all();
+
+    if (worker.joinable())
+        worker.join();
+}
+
+void monitor::run()
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    while (_running)
+    {
+        ax.unlock();
+        sample();
+        ax.lock();
+
+        _wakeup.wait_for(ax, _options.interval(), [this] { return !_running; });
+    }
+}
+
+std::vector<server_sample> monitor::latest() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return _latest;
+}
+
+std::vector<optional<server_stats_delta>> monitor::deltas() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    std::vector<optional<server_stats_delta>> out;
+    out.reserve(_latest.size());
+    for (std::size_t idx = 0U; idx < _latest.size(); ++idx)
+    {
+        if (idx < _previous.size())
+            out.emplace_back(server_stats_delta::between(_previous[idx], _latest[idx]));
+        else
+            out.emplace_back(nullopt);
+    }
+    return out;
+}
+
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/optional.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace zk
+{
+
+class connection_params;
+
+}
+
+namespace zk::server
+{
+
+/// \addtogroup Server
+/// \{
+
+class server_group;
+
+/// The client address of a server to scrape.
+struct endpoint final
+{
+    std::string   host;
+    std::uint16_t port = 0U;
+
+    /// Parse \c "host:port" (or \c "[address]:port" for an IPv6 address), as found in a connection string.
+    ///
+    /// \throws std::invalid_argument if \a src has no port or the port is not a number in 1-65535.
+    static endpoint parse(const std::string& src);
+
+    /// Get the endpoints of every host in \a params.
+    static std::vector<endpoint> all_of(const connection_params& params);
+};
+
+bool operator==(const endpoint& a, const endpoint& b);
+bool operator!=(const endpoint& a, const endpoint& b);
+
+std::ostream& operator<<(std::ostream&, const endpoint&);
+
+std::string to_string(const endpoint&);
+
+/// The numbers a server reports in reply to \c "mntr". The latencies are in milliseconds, as the server reports them.
+/// A key which the server did not report leaves its field at \c 0; every key is in \ref values either way, so the ones
+/// without a field of their own (which vary from release to release) are not lost.
+struct server_stats final
+{
+    std::string   version;
+    std::string   server_state;                     //!< \c "standalone", \c "leader", \c "follower" or \c "observer"
+    double        avg_latency                  = 0.0;
+    std::int64_t  min_latency                  = 0;
+    std::int64_t  max_latency                  = 0;
+    std::int64_t  packets_received             = 0;
+    std::int64_t  packets_sent                 = 0;
+    std::int64_t  num_alive_connections        = 0;
+    std::int64_t  outstanding_requests         = 0;
+    std::int64_t  znode_count                  = 0;
+    std::int64_t  watch_count                  = 0;
+    std::int64_t  ephemerals_count             = 0;
+    std::int64_t  approximate_data_size        = 0;
+    std::int64_t  open_file_descriptor_count   = 0;
+    std::int64_t  fsync_threshold_exceed_count = 0; //!< The number of slow \c fsync calls warned about in the log
+
+    /// Every \c "zk_" key of the reply (without the prefix) and its value.
+    std::map<std::string, std::string> values;
+
+    /// Parse the \a reply to \c "mntr": one tab-separated key and value to a line.
+    ///
+    /// \returns \c nullopt if \a reply has no \c "zk_" lines at all, as when the word is not in the server's whitelist.
+    static optional<server_stats> parse(const std::string& reply);
+};
+
+/// The summary a server replies to \c "wchs" with.
+struct watch_summary final
+{
+    std::int64_t connections = 0; //!< The number of sessions with watches
+    std::int64_t paths       = 0; //!< The number of paths being watched
+    std::int64_t watches     = 0;
+
+    /// \returns \c nullopt if \a reply is not a summary.
+    static optional<watch_summary> parse(const std::string& reply);
+};
+
+/// One of the connections listed in reply to \c "cons".
+struct connection_stats final
+{
+    std::string            address;           //!< The client's address, as the server sees it
+    std::int64_t           queued      = 0;
+    std::int64_t           received    = 0;
+    std::int64_t           sent        = 0;
+    optional<std::int64_t> session_id;        //!< Not set for a connection which has not established a session yet
+    std::int64_t           min_latency = 0;
+    std::int64_t           avg_latency = 0;
+    std::int64_t           max_latency = 0;
+
+    /// Parse every connection in \a reply. Lines which do not describe a connection are skipped.
+    static std::vector<connection_stats> parse_all(const std::string& reply);
+};
+
+/// What one server said at one point in time. A word the server did not answer (because it is down or the word is not
+/// whitelisted) leaves its part empty.
+struct server_sample final
+{
+    endpoint                              source;
+    std::chrono::steady_clock::time_point taken;
+    optional<server_stats>                stats;
+    optional<watch_summary>               watches;
+    std::vector<connection_stats>         connections;
+};
+
+/// How the numbers of a server changed from one \ref server_sample to a later one. Counters (like the packets) and
+/// gauges (like the znode count) are both reported as the later value minus the earlier one.
+struct server_stats_delta final
+{
+    endpoint                            source;
+    std::chrono::steady_clock::duration elapsed{};
+    std::int64_t                        packets_received             = 0;
+    std::int64_t                        packets_sent                 = 0;
+    std::int64_t                        num_alive_connections        = 0;
+    std::int64_t                        outstanding_requests         = 0;
+    std::int64_t                        znode_count                  = 0;
+    std::int64_t                        watch_count                  = 0;
+    std::int64_t                        ephemerals_count             = 0;
+    std::int64_t                        approximate_data_size        = 0;
+    std::int64_t                        fsync_threshold_exceed_count = 0;
+
+    /// \returns \c nullopt unless both samples have \ref server_sample::stats.
+    static optional<server_stats_delta> between(const server_sample& before, const server_sample& after);
+};
+
+/// Options for a \ref monitor.
+class monitor_options final
+{
+public:
+    monitor_options() = default;
+
+    /// How often the servers are scraped once \ref monitor::start is called.
+    std::chrono::milliseconds  interval() const { return _interval; }
+    std::chrono::milliseconds& interval()       { return _interval; }
+
+    /// How long a server has to answer each word.
+    std::chrono::milliseconds  timeout() const { return _timeout; }
+    std::chrono::milliseconds& timeout()       { return _timeout; }
+
+    /// \{
+    /// Which words to send besides \c "mntr". Listing the watches or connections of a busy server is not free for it,
+    /// so these can be turned off.
+    bool  scrape_watches() const { return _scrape_watches; }
+    bool& scrape_watches()       { return _scrape_watches; }
+
+    bool  scrape_connections() const { return _scrape_connections; }
+    bool& scrape_connections()       { return _scrape_connections; }
+    /// \}
+
+private:
+    std::chrono::milliseconds _interval           = std::chrono::seconds(1);
+    std::chrono::milliseconds _timeout            = std::chrono::seconds(2);
+    bool                      _scrape_watches     = true;
+    bool                      _scrape_connections = true;
+};
+
+/// Scrapes the server-side numbers of a set of servers with the \c "mntr", \c "wchs" and \c "cons" four letter words,
+/// either when asked to (\ref sample) or on a timer of its own (\ref start). The two most recent samples of each
+/// server are kept, so what the servers did in the meantime (\ref deltas) can be reported next to the
+/// \ref connection_metrics of the clients.
+///
+/// \code
+/// zk::server::monitor mon(servers);
+/// mon.sample();
+/// run_the_load();
+/// mon.sample();
+/// for (const auto& delta : mon.deltas())
+///     if (delta)
+///         std::cout << delta->source << ": " << delta->packets_received << " packets received\n";
+/// \endcode
+///
+/// The servers must have the words in their \c 4lw.commands.whitelist, which releases from 3.5.3 on only have
+/// \c "srvr" in by default (see \ref configuration::four_letter_word_whitelist).
+class monitor final
+{
+public:
+    explicit monitor(std::vector<endpoint> targets, monitor_options options = monitor_options());
+
+    /// Monitor every member of \a servers.
+    explicit monitor(const server_group& servers, monitor_options options = monitor_options());
+
+    monitor(const monitor&) = delete;
+    monitor& operator=(const monitor&) = delete;
+
+    /// Calls \ref stop.
+    ~monitor() noexcept;
+
+    const std::vector<endpoint>& targets() const { return _targets; }
+
+    /// Scrape every target once, without keeping the result.
+    std::vector<server_sample> scrape() const;
+
+    /// Scrape every target once and keep the result as the latest sample.
+    void sample();
+
+    /// \{
+    /// Start or stop \ref sample being called every \ref monitor_options::interval on a thread of the monitor.
+    void start();
+    void stop();
+    /// \}
+
+    /// The latest sample of each target, in the order of \ref targets (empty before the first \ref sample).
+    std::vector<server_sample> latest() const;
+
+    /// The change of each target between the two latest samples, in the order of \ref targets. A target which did not
+    /// answer \c "mntr" both times has no delta.
+    std::vector<optional<server_stats_delta>> deltas() const;
+
+private:
+    void run();
+
+private:
+    std::vector<endpoint>      _targets;
+    monitor_options            _options;
+    mutable std::mutex         _protect;
+    std::condition_variable    _wakeup;
+    std::vector<server_sample> _previous;
+    std::vector<server_sample> _latest;
+    bool                       _running = false;
+    std::thread                _worker;
+};
+
+/// \}
+
+}
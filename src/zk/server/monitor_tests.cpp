@@ -0,0 +1,139 @@
+#include <zk/connection.hpp>
+#include <zk/tests/test.hpp>
+
+#include <stdexcept>
+#include <string>
+
+#include "monitor.hpp"
+
+namespace zk::server
+{
+
+static const std::string sample_mntr =
+        "zk_version\t3.5.4-beta-7f51e5b68cf2f80176ff944a9ebd2abbc65e7327, built on 05/11/2018 16:27 GMT\n"
+        "zk_avg_latency\t2\n"
+        "zk_max_latency\t31\n"
+        "zk_min_latency\t0\n"
+        "zk_packets_received\t1200\n"
+        "zk_packets_sent\t1199\n"
+        "zk_num_alive_connections\t3\n"
+        "zk_outstanding_requests\t1\n"
+        "zk_server_state\tleader\n"
+        "zk_znode_count\t42\n"
+        "zk_watch_count\t7\n"
+        "zk_ephemerals_count\t2\n"
+        "zk_approximate_data_size\t4096\n"
+        "zk_open_file_descriptor_count\t61\n"
+        "zk_max_file_descriptor_count\t1048576\n"
+        "zk_fsync_threshold_exceed_count\t1\n";
+
+GTEST_TEST(monitor_tests, parse_mntr)
+{
+    auto stats = server_stats::parse(sample_mntr).value();
+    CHECK_EQ("leader", stats.server_state);
+    CHECK_EQ(0U, stats.version.find("3.5.4-beta"));
+    CHECK_EQ(2.0, stats.avg_latency);
+    CHECK_EQ(31, stats.max_latency);
+    CHECK_EQ(1200, stats.packets_received);
+    CHECK_EQ(1199, stats.packets_sent);
+    CHECK_EQ(3, stats.num_alive_connections);
+    CHECK_EQ(1, stats.outstanding_requests);
+    CHECK_EQ(42, stats.znode_count);
+    CHECK_EQ(7, stats.watch_count);
+    CHECK_EQ(2, stats.ephemerals_count);
+    CHECK_EQ(4096, stats.approximate_data_size);
+    CHECK_EQ(61, stats.open_file_descriptor_count);
+    CHECK_EQ(1, stats.fsync_threshold_exceed_count);
+    CHECK_EQ("1048576", stats.values.at("max_file_descriptor_count"));
+
+    CHECK_FALSE(server_stats::parse("mntr is not executed because it is not in the whitelist.\n"));
+    CHECK_FALSE(server_stats::parse(""));
+}
+
+GTEST_TEST(monitor_tests, parse_wchs)
+{
+    auto summary = watch_summary::parse("2 connections watching 5 paths\nTotal watches:7\n").value();
+    CHECK_EQ(2, summary.connections);
+    CHECK_EQ(5, summary.paths);
+    CHECK_EQ(7, summary.watches);
+
+    CHECK_FALSE(watch_summary::parse("wchs is not executed because it is not in the whitelist.\n"));
+}
+
+GTEST_TEST(monitor_tests, parse_cons)
+{
+    auto conns = connection_stats::parse_all(
+            " /127.0.0.1:56854[1](queued=0,recved=9,sent=8,sid=0x1000a4e1c2b0000,lop=PING,est=1535998460346,to=30000,"
+                "lcxid=0x2,lzxid=0x5,lresp=1535998470351,llat=0,minlat=1,avglat=2,maxlat=3)\n"
+            " /127.0.0.1:56900[0](queued=0,recved=1,sent=0)\n"
+            "\n"
+        );
+    CHECK_EQ(2U, conns.size());
+    CHECK_EQ("127.0.0.1:56854", conns[0].address);
+    CHECK_EQ(9, conns[0].received);
+    CHECK_EQ(8, conns[0].sent);
+    CHECK_EQ(0x1000a4e1c2b0000, conns[0].session_id.value());
+    CHECK_EQ(1, conns[0].min_latency);
+    CHECK_EQ(2, conns[0].avg_latency);
+    CHECK_EQ(3, conns[0].max_latency);
+    CHECK_EQ("127.0.0.1:56900", conns[1].address);
+    CHECK_FALSE(conns[1].session_id);
+}
+
+GTEST_TEST(monitor_tests, endpoints)
+{
+    CHECK_EQ((endpoint{ "zk1.local", 2181U }), endpoint::parse("zk1.local:2181"));
+    CHECK_EQ((endpoint{ "::1", 2182U }), endpoint::parse("[::1]:2182"));
+    CHECK_EQ("[::1]:2182", to_string(endpoint::parse("[::1]:2182")));
+    CHECK_THROWS(std::invalid_argument) { endpoint::parse("zk1.local"); };
+    CHECK_THROWS(std::invalid_argument) { endpoint::parse("zk1.local:"); };
+    CHECK_THROWS(std::invalid_argument) { endpoint::parse("zk1.local:70000"); };
+
+    auto all = endpoint::all_of(connection_params::parse("zk://10.0.0.1:2181,10.0.0.2:2182/"));
+    CHECK_EQ(2U, all.size());
+    CHECK_EQ((endpoint{ "10.0.0.2", 2182U }), all[1]);
+}
+
+GTEST_TEST(monitor_tests, deltas)
+{
+    server_sample before;
+    before.stats = server_stats::parse(sample_mntr);
+
+    server_sample after = before;
+    after.taken         = before.taken + std::chrono::seconds(2);
+    after.stats->packets_received += 300;
+    after.stats->znode_count      -= 2;
+
+    auto delta = server_stats_delta::between(before, after).value();
+    CHECK_EQ(300, delta.packets_received);
+    CHECK_EQ(-2, delta.znode_count);
+    CHECK_EQ(0, delta.watch_count);
+    CHECK_TRUE(delta.elapsed == std::chrono::seconds(2));
+
+    after.stats = nullopt;
+    CHECK_FALSE(server_stats_delta::between(before, after));
+}
+
+GTEST_TEST(monitor_tests, unreachable)
+{
+    monitor_options options;
+    options.timeout() = std::chrono::milliseconds(200);
+
+    // Nothing listens on port 1 of the loopback interface
+    monitor mon({ endpoint{ "127.0.0.1", 1U } }, options);
+    CHECK_TRUE(mon.latest().empty());
+
+    mon.sample();
+    mon.sample();
+    auto latest = mon.latest();
+    CHECK_EQ(1U, latest.size());
+    CHECK_FALSE(latest[0].stats);
+    CHECK_FALSE(latest[0].watches);
+    CHECK_TRUE(latest[0].connections.empty());
+    CHECK_FALSE(mon.deltas().at(0));
+
+    mon.start();
+    mon.stop();
+}
+
+}
@@ -2,17 +2,21 @@
 
 #include <zk/future.hpp>
 
+#include <algorithm>
 #include <cerrno>
+#include <chrono>
 #include <exception>
 #include <iostream>
 #include <system_error>
 
+#include <fcntl.h>
 #include <signal.h>
-#include <sys/select.h>
+#include <unistd.h>
 
 #include "classpath.hpp"
 #include "configuration.hpp"
-#include "detail/event_handle.hpp"
+#include "detail/four_letter_word.hpp"
+#include "detail/output_pump.hpp"
 #include "detail/subprocess.hpp"
 
 namespace zk::server
@@ -30,16 +34,15 @@ static void validate_settings(const configuration& settings)
     }
 }
 
-server::server(classpath packages, configuration settings) :
+server::server(classpath packages, configuration settings, capture_options output) :
         _running(true),
-        _shutdown_event(std::make_unique<detail::event_handle>())
+        _client_port(settings.client_port()),
+        _readiness_word(detail::readiness_word(settings)),
+        _output(std::make_shared<log_capture>(output.capacity())),
+        _spill_fd(-1)
 {
     validate_settings(settings);
-    _worker = std::thread([this, packages = std::move(packages), settings = std::move(settings)] ()
-                          {
-                              this->run_process(packages, settings);
-                          }
-                         );
+    start_process(packages, settings, output);
 }
 
 server::server(configuration settings) :
@@ -53,34 +56,33 @@ server::~server() noexcept
 
 void server::shutdown(bool wait_for_stop)
 {
-    _running.store(false, std::memory_order_release);
-    _shutdown_event->notify_one();
+    std::unique_lock<std::mutex> ax(_stop_protect);
+    if (_running.exchange(false, std::memory_order_acq_rel))
+        _stopper = std::thread([this] { stop_process(); });
 
-    if (wait_for_stop && _worker.joinable())
-        _worker.join();
+    if (wait_for_stop && _stopper.joinable())
+        _stopper.join();
 }
 
-static void wait_for_event(int fd1, int fd2, int fd3)
+bool server::wait_until_ready(std::chrono::milliseconds timeout) const
 {
-    // This could be implemented with epoll instead of select, but since N=3, it doesn't really matter
-    ::fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(fd1, &read_fds);
-    FD_SET(fd2, &read_fds);
-    FD_SET(fd3, &read_fds);
-
-    int nfds = std::max(std::max(fd1, fd2), fd3) + 1;
-    int rc   = ::select(nfds, &read_fds, nullptr, nullptr, nullptr);
-    if (rc < 0)
+    constexpr auto probe_interval = std::chrono::milliseconds(50);
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (_running.load(std::memory_order_acquire))
     {
-        if (errno == EINTR)
-            return;
-        else
-            throw std::system_error(errno, std::system_category(), "select");
+        auto now       = std::chrono::steady_clock::now();
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+        if (remaining.count() <= 0)
+            return false;
+        if (detail::probe_ready(_client_port, _readiness_word, std::min(remaining, std::chrono::milliseconds(1000))))
+            return true;
+        std::this_thread::sleep_for(std::min(remaining, probe_interval));
     }
+    return false;
 }
 
-void server::run_process(const classpath& packages, const configuration& settings)
+void server::start_process(const classpath& packages, const configuration& settings, const capture_options& output)
 {
     detail::subprocess::argument_list args = { "-cp", packages.command_line(),
                                                "org.apache.zookeeper.server.quorum.QuorumPeerMain",
@@ -95,42 +97,55 @@ void server::run_process(const classpath& packages, const configuration& setting
         args.emplace_back(settings.source_file().value());
     }
 
-    detail::subprocess proc("java", std::move(args));
-
-    auto drain_pipes = [&] ()
-                       {
-                           bool read_anything = true;
-                           while (read_anything)
-                           {
-                               read_anything = false;
-
-                               auto out = proc.stdout().read();
-                               if (!out.empty())
-                               {
-                                   read_anything = true;
-                                   std::cout << out;
-                               }
-
-                               auto err = proc.stderr().read();
-                               if (!err.empty())
-                               {
-                                   read_anything = true;
-                                   std::cerr << out;
-                               }
-                           }
-                       };
+    if (output.spill_file())
+    {
+        _spill_fd = ::open(output.spill_file()->c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (_spill_fd < 0)
+            throw std::system_error(errno, std::system_category(), "open(" + *output.spill_file() + ")");
+    }
 
-    while (_running.load(std::memory_order_acquire))
+    try
+    {
+        _pump    = detail::output_pump::shared();
+        _process = std::make_unique<detail::subprocess>("java", std::move(args));
+
+        auto make_sink = [capture = _output, echo = output.echo()] (std::ostream& os) -> detail::output_pump::sink
+                         {
+                             return [capture, echo, &os] (const char* data, std::size_t size)
+                                    {
+                                        capture->append(data, size);
+                                        if (echo)
+                                            os.write(data, static_cast<std::streamsize>(size));
+                                    };
+                         };
+        _pump->add(_process->stdout().native_read_handle(), make_sink(std::cout), _spill_fd);
+        _pump->add(_process->stderr().native_read_handle(), make_sink(std::cerr), _spill_fd);
+    }
+    catch (...)
     {
-        wait_for_event(proc.stdout().native_read_handle(),
-                       proc.stderr().native_read_handle(),
-                       _shutdown_event->native_handle()
-                      );
+        _running.store(false, std::memory_order_release);
+        stop_process();
+        throw;
+    }
+}
 
-        drain_pipes();
+void server::stop_process() noexcept
+{
+    if (_process)
+    {
+        _process->terminate();
+        if (_pump)
+        {
+            _pump->remove(_process->stdout().native_read_handle());
+            _pump->remove(_process->stderr().native_read_handle());
+        }
+    }
+
+    if (_spill_fd != -1)
+    {
+        ::close(_spill_fd);
+        _spill_fd = -1;
     }
-    proc.terminate();
-    drain_pipes();
 }
 
 }
@@ -3,18 +3,24 @@
 #include <zk/config.hpp>
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <exception>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 
+#include "log_capture.hpp"
+
 namespace zk::server
 {
 
 namespace detail
 {
 
-class event_handle;
+class output_pump;
+class subprocess;
 
 }
 
@@ -26,6 +32,11 @@ class classpath;
 class configuration;
 
 /// Controls a ZooKeeper server process on this local machine.
+///
+/// The output of the process is captured into a bounded \ref log_capture (see \ref output) instead of being copied to
+/// the standard streams of this process, so a failing test can show what the server said without every passing test
+/// drowning in it. The pipes of every server are read by the one thread of a shared pump (with \c epoll), however many
+/// servers are running.
 class server final
 {
 public:
@@ -33,9 +44,12 @@ public:
     ///
     /// \param packages The classpath to use to find ZooKeeper's \c QuorumPeerMain class.
     /// \param settings The server settings to run with.
+    /// \param output What to do with the output of the process.
     /// \throws std::invalid_argument If `settings.is_minimal()` is \c false and `settings.source_file()` is \c nullopt.
     ///  This is because non-minimal configurations require ZooKeeper to be launched with a file.
-    explicit server(classpath packages, configuration settings);
+    /// \throws std::system_error If the process could not be started or \ref capture_options::spill_file could not be
+    ///  opened.
+    explicit server(classpath packages, configuration settings, capture_options output = capture_options());
 
     /// Create a running server with the specified \a settings using the system-provided default packages for ZooKeeper
     /// (see \ref classpath::system_default).
@@ -56,16 +70,38 @@ public:
     ///  termination.
     void shutdown(bool wait_for_stop = false);
 
+    /// Wait for the server to serve clients, probing its client port with the \c "srvr" four letter word (or \c "ruok"
+    /// if only that is in the \ref configuration::four_letter_word_whitelist) until it answers that it is. This returns
+    /// as soon as the server is ready, which is usually well before a fixed sleep would have.
+    ///
+    /// \returns \c true if the server is serving; \c false if the \a timeout passed first or the server was shut down.
+    bool wait_until_ready(std::chrono::milliseconds timeout) const;
+
+    /// The port the server listens for clients on.
+    std::uint16_t client_port() const noexcept { return _client_port; }
+
+    /// The most recent output of the process (both \c stdout and \c stderr, in the order it was read). Everything the
+    /// process wrote before \ref shutdown returned (with \c wait_for_stop) is in it.
+    const log_capture& output() const noexcept { return *_output; }
+
 private:
-    void run_process(const classpath&, const configuration&);
+    void start_process(const classpath&, const configuration&, const capture_options&);
+
+    void stop_process() noexcept;
 
 private:
-    std::atomic<bool>                     _running;
-    std::unique_ptr<detail::event_handle> _shutdown_event;
-    std::thread                           _worker;
+    std::atomic<bool>                    _running;
+    std::uint16_t                        _client_port;
+    std::string                          _readiness_word; //!< The four letter word to probe readiness with
+    std::shared_ptr<log_capture>         _output;
+    std::shared_ptr<detail::output_pump> _pump;
+    std::unique_ptr<detail::subprocess>  _process;
+    int                                  _spill_fd;
+    std::mutex                           _stop_protect;
+    std::thread                          _stopper;        //!< Terminates the process once \ref shutdown is called
 
     // NOTE: The configuration is NOT stored in the server object. This is because configuration can be changed by the
-    // ZK process in cases like ensemble reconfiguration. It is the job of run_process to deal with this.
+    // ZK process in cases like ensemble reconfiguration. It is the job of start_process to deal with this.
 };
 
 /// \}
@@ -6,6 +6,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <system_error>
+#include <thread>
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -13,6 +14,7 @@
 #include "classpath.hpp"
 #include "configuration.hpp"
 #include "server.hpp"
+#include "detail/four_letter_word.hpp"
 
 namespace zk::server
 {
@@ -116,21 +118,79 @@ server_group server_group::make_ensemble(std::size_t size, const configuration&
     return out;
 }
 
-const std::string& server_group::get_connection_string()
+const std::string& server_group::get_connection_string() const
 {
     return _conn_string;
 }
 
-void server_group::start_all_servers(const classpath& packages)
+void server_group::start_all_servers(const classpath& packages, const capture_options& output)
 {
     for (auto& [name, srvr] : _servers)
     {
-        static_cast<void>(name);
-
         if (!srvr->instance)
         {
-            srvr->instance = std::make_shared<server>(packages, srvr->settings);
+            auto server_output = output;
+            if (output.spill_file())
+                server_output.spill_file() = *output.spill_file() + "." + std::to_string(name.value);
+
+            srvr->instance = std::make_shared<server>(packages, srvr->settings, std::move(server_output));
+        }
+    }
+}
+
+std::map<server_id, std::string> server_group::recent_output() const
+{
+    std::map<server_id, std::string> out;
+    for (const auto& [name, srvr] : _servers)
+    {
+        if (srvr->instance)
+            out.emplace(name, srvr->instance->output().contents());
+    }
+    return out;
+}
+
+bool server_group::wait_until_ready(std::chrono::milliseconds timeout) const
+{
+    constexpr auto probe_interval = std::chrono::milliseconds(50);
+
+    auto                     deadline = std::chrono::steady_clock::now() + timeout;
+    std::size_t              quorum   = _servers.size() / 2U + 1U;
+    std::vector<const info*> waiting;
+    for (const auto& entry : _servers)
+        if (entry.second->instance)
+            waiting.push_back(entry.second.get());
+    if (waiting.size() < quorum)
+        return false;
+
+    std::size_t ready = 0U;
+    while (true)
+    {
+        // Servers which answered once are not asked again; the others are probed in turn
+        for (auto iter = waiting.begin(); iter != waiting.end();)
+        {
+            auto now       = std::chrono::steady_clock::now();
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+            if (remaining.count() <= 0)
+                return false;
+
+            const auto& settings = (*iter)->settings;
+            if (detail::probe_ready(settings.client_port(),
+                                    detail::readiness_word(settings),
+                                    std::min(remaining, std::chrono::milliseconds(1000))
+                                   )
+               )
+            {
+                iter = waiting.erase(iter);
+                if (++ready >= quorum)
+                    return true;
+            }
+            else
+            {
+                ++iter;
+            }
         }
+
+        std::this_thread::sleep_for(probe_interval);
     }
 }
 
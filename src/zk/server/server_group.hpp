@@ -2,6 +2,7 @@
 
 #include <zk/config.hpp>
 
+#include <chrono>
 #include <cstdint>
 #include <map>
 #include <memory>
@@ -9,6 +10,7 @@
 #include <vector>
 
 #include "configuration.hpp"
+#include "log_capture.hpp"
 
 namespace zk::server
 {
@@ -27,7 +29,8 @@ class server;
 /// auto servers = zk::server::server_group::make_ensemble(3U,
 ///                                                        zk::server::configuration::make_minimal("test-data")
 ///                                                       );
-/// servers.start_all_servers();
+/// servers.start_all_servers(packages);
+/// servers.wait_until_ready(std::chrono::seconds(30));
 /// auto client = zk::client::connect(servers.get_connection_string()).get();
 /// // do things with client...
 /// \endcode
@@ -50,11 +53,26 @@ public:
     static server_group make_ensemble(std::size_t size, const configuration& base_settings);
 
     /// Get a connection string which can connect to any the servers in the group.
-    const std::string& get_connection_string();
+    const std::string& get_connection_string() const;
 
-    /// Start all servers in the group. Note that this does not wait for the servers to be up-and-running. Use a
-    /// \ref client instance to check for connectability.
-    void start_all_servers(const classpath& packages);
+    /// Start all servers in the group. The processes are only launched here, so the JVMs start up side by side and this
+    /// returns right away, without waiting for any of them to be up-and-running (see
+    /// \ref wait_until_ready).
+    ///
+    /// \param output What to do with the output of each server. The output of every server is read by the same thread,
+    ///  however large the group. If \ref capture_options::spill_file is set, each server spills to a file of its own,
+    ///  named by appending \c "." and the server's ID.
+    void start_all_servers(const classpath& packages, const capture_options& output = capture_options());
+
+    /// Wait for a quorum (a majority of the servers in the group) to be serving clients. Every started server is probed
+    /// with a four letter word on its client port (see \ref server::wait_until_ready) until enough of them answer that
+    /// they are in the ensemble.
+    ///
+    /// \returns \c true as soon as a quorum is serving; \c false if the \a timeout passed first.
+    bool wait_until_ready(std::chrono::milliseconds timeout) const;
+
+    /// Get the most recent output (see \ref server::output) of every started server.
+    std::map<server_id, std::string> recent_output() const;
 
     /// How many servers are in this group?
     std::size_t size() const { return _servers.size(); }
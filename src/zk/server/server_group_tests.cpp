@@ -19,6 +19,7 @@ GTEST_TEST(server_group_tests, ensemble)
     delete_directory("ensemble");
     auto group = server_group::make_ensemble(5U, configuration::make_minimal("ensemble"));
     group.start_all_servers(test_package_registry::instance().find_newest_classpath().value());
+    CHECK_TRUE(group.wait_until_ready(std::chrono::seconds(60)));
 
     // connect and get data from the ensemble
     auto c = client::connect(group.get_connection_string()).get();
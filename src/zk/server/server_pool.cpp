@@ -0,0 +1,258 @@
+#include "server_pool.hpp"
+
+#include <zk/client.hpp>
+#include <zk/optional.hpp>
+#include <zk/results.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "configuration.hpp"
+#include "server.hpp"
+#include "server_group.hpp"
+
+namespace zk::server
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// server_pool                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct server_pool::entry
+{
+    std::size_t                   size;
+    std::shared_ptr<server>       single;      //!< The server, if this is a standalone one
+    std::unique_ptr<server_group> group;       //!< The servers, if this is an ensemble
+    std::string                   conn_string;
+    optional<client>              admin;       //!< Empties the tree between leases
+    bool                          reusable = true;
+
+    explicit entry(std::size_t size) :
+            size(size)
+    { }
+};
+
+/// The most output of a server which failed to start shown in the exception.
+static constexpr std::size_t failure_output_size = 2048U;
+
+static void remove_tree(const std::string& path)
+{
+    auto unlink_cb = [] (const char* fpath, const struct ::stat*, int, struct ::FTW*) -> int
+                     {
+                         return std::remove(fpath);
+                     };
+
+    if (::nftw(path.c_str(), unlink_cb, 64, FTW_DEPTH | FTW_PHYS) != 0 && errno != ENOENT)
+        throw std::system_error(errno, std::system_category(), "Could not clear " + path);
+}
+
+server_pool::server_pool(classpath packages, server_pool_options options) :
+        _packages(std::move(packages)),
+        _options(std::move(options)),
+        _next_index(0U),
+        _next_port(_options.base_port())
+{
+    remove_tree(_options.data_directory());
+    if (::mkdir(_options.data_directory().c_str(), 0755) != 0)
+        throw std::system_error(errno, std::system_category(), "Could not create " + _options.data_directory());
+}
+
+server_pool::~server_pool() noexcept
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    _idle.clear();
+}
+
+server_lease server_pool::acquire_server()
+{
+    return acquire_ensemble(1U);
+}
+
+server_lease server_pool::acquire_ensemble(std::size_t size)
+{
+    if (size == 0U)
+        throw std::invalid_argument("An ensemble needs at least one server");
+
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        auto iter = _idle.find(size);
+        if (iter != _idle.end())
+        {
+            auto item = std::move(iter->second);
+            _idle.erase(iter);
+            return server_lease(*this, std::move(item));
+        }
+    }
+
+    return server_lease(*this, start_entry(size));
+}
+
+std::size_t server_pool::idle_count() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return _idle.size();
+}
+
+std::unique_ptr<server_pool::entry> server_pool::start_entry(std::size_t size)
+{
+    std::string   directory;
+    std::uint16_t port;
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        directory  = _options.data_directory() + "/" + std::to_string(_next_index++);
+        port       = _next_port;
+        _next_port = static_cast<std::uint16_t>(_next_port + (size == 1U ? 1U : 3U * size));
+    }
+
+    auto item = std::make_unique<entry>(size);
+    bool ready;
+    if (size == 1U)
+    {
+        item->single      = std::make_shared<server>(_packages,
+                                                     configuration::make_minimal(directory, port),
+                                                     _options.output()
+                                                    );
+        item->conn_string = "zk://127.0.0.1:" + std::to_string(port) + "/";
+        ready             = item->single->wait_until_ready(_options.ready_timeout());
+    }
+    else
+    {
+        item->group = std::make_unique<server_group>(
+                server_group::make_ensemble(size, configuration::make_minimal(directory, port))
+            );
+        item->group->start_all_servers(_packages, _options.output());
+        item->conn_string = item->group->get_connection_string();
+        ready             = item->group->wait_until_ready(_options.ready_timeout());
+    }
+
+    if (!ready)
+    {
+        std::string message = "Pooled server at " + directory + " did not become ready";
+        if (item->single)
+            message += ":\n" + item->single->output().tail(failure_output_size);
+        throw std::runtime_error(message);
+    }
+
+    item->admin.emplace(client::connect(item->conn_string).get());
+    return item;
+}
+
+/// Erase everything ZooKeeper did not create itself. Every top-level entry is erased at once and each erasure
+/// pipelines its own listings and erasures, so even a large tree is gone after a few round trips.
+static void reset_tree(client& admin)
+{
+    auto top = admin.get_children("/").get();
+
+    std::vector<std::string>  paths;
+    std::vector<future<void>> erasures;
+    paths.reserve(top.children().size());
+    erasures.reserve(top.children().size());
+    for (const auto& name : top.children())
+    {
+        if (name == "zookeeper")
+            continue;
+
+        paths.emplace_back("/" + name);
+        erasures.emplace_back(admin.erase_recursive(paths.back()));
+    }
+
+    for (auto& erasure : erasures)
+        erasure.get();
+}
+
+void server_pool::give_back(std::unique_ptr<entry> item) noexcept
+{
+    if (!item->reusable)
+        return;
+
+    try
+    {
+        reset_tree(*item->admin);
+    }
+    catch (...)
+    {
+        // A server which can not be cleaned is not worth keeping
+        return;
+    }
+
+    std::unique_lock<std::mutex> ax(_protect);
+    auto size = item->size;
+    _idle.emplace(size, std::move(item));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// server_lease                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+server_lease::server_lease() noexcept :
+        _owner(nullptr)
+{ }
+
+server_lease::server_lease(server_pool& owner, std::unique_ptr<server_pool::entry> item) noexcept :
+        _owner(&owner),
+        _entry(std::move(item))
+{ }
+
+server_lease::server_lease(server_lease&& src) noexcept :
+        _owner(std::exchange(src._owner, nullptr)),
+        _entry(std::move(src._entry))
+{ }
+
+server_lease& server_lease::operator=(server_lease&& src) noexcept
+{
+    if (this != &src)
+    {
+        release();
+        _owner = std::exchange(src._owner, nullptr);
+        _entry = std::move(src._entry);
+    }
+    return *this;
+}
+
+server_lease::~server_lease() noexcept
+{
+    release();
+}
+
+std::size_t server_lease::size() const noexcept
+{
+    return _entry ? _entry->size : 0U;
+}
+
+const std::string& server_lease::connection_string() const
+{
+    if (!_entry)
+        throw std::logic_error("This lease holds no servers");
+    return _entry->conn_string;
+}
+
+void server_lease::shutdown(bool wait_for_stop)
+{
+    if (!_entry)
+        return;
+
+    _entry->reusable = false;
+    if (_entry->admin)
+        _entry->admin->close();
+    if (_entry->single)
+        _entry->single->shutdown(wait_for_stop);
+    else
+        _entry->group.reset();
+}
+
+void server_lease::release() noexcept
+{
+    if (_entry)
+        _owner->give_back(std::move(_entry));
+    _owner = nullptr;
+}
+
+}
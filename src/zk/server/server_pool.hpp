@@ -0,0 +1,156 @@
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "classpath.hpp"
+#include "log_capture.hpp"
+
+namespace zk::server
+{
+
+/// \addtogroup Server
+/// \{
+
+class server_lease;
+
+/// Options for a \ref server_pool.
+class server_pool_options final
+{
+public:
+    server_pool_options() = default;
+
+    /// The directory the pooled servers keep their data under. It belongs to the pool: anything in it is erased when
+    /// the pool is created.
+    const std::string& data_directory() const { return _data_directory; }
+    std::string&       data_directory()       { return _data_directory; }
+
+    /// The first port handed to a pooled server. Every server takes the next free port as its client port; the servers
+    /// of an ensemble take two more each, for their peer and leader ports.
+    std::uint16_t  base_port() const { return _base_port; }
+    std::uint16_t& base_port()       { return _base_port; }
+
+    /// How long a newly started server (or ensemble) has to become ready before \ref server_pool::acquire_server (or
+    /// \ref server_pool::acquire_ensemble) gives up on it.
+    std::chrono::milliseconds  ready_timeout() const { return _ready_timeout; }
+    std::chrono::milliseconds& ready_timeout()       { return _ready_timeout; }
+
+    /// What to do with the output of the pooled servers.
+    const capture_options& output() const { return _output; }
+    capture_options&       output()       { return _output; }
+
+private:
+    std::string               _data_directory = "zk-pool";
+    std::uint16_t             _base_port      = 19000U;
+    std::chrono::milliseconds _ready_timeout  = std::chrono::seconds(60);
+    capture_options           _output;
+};
+
+/// Keeps servers and ensembles warm so they can be used again and again. Starting a JVM and electing a leader takes
+/// seconds, while all most tests need is an empty tree. A pool hands out its servers through a \ref server_lease; when
+/// a lease is released, the tree is emptied (everything but \c /zookeeper is erased with \ref client::erase_recursive,
+/// which pipelines the listings and erasures) and the server waits in the pool for the next lease.
+///
+/// \code
+/// static server_pool pool(packages);
+/// auto lease  = pool.acquire_server();
+/// auto client = zk::client::connect(lease.connection_string()).get();
+/// // do things with client...
+/// \endcode
+///
+/// A pool is safe to lease from on multiple threads. It must outlive its leases.
+class server_pool final
+{
+public:
+    explicit server_pool(classpath packages, server_pool_options options = server_pool_options());
+
+    server_pool(const server_pool&) = delete;
+    server_pool& operator=(const server_pool&) = delete;
+
+    /// Shut down every idle server.
+    ~server_pool() noexcept;
+
+    /// Lease a standalone server, starting one if none is idle.
+    ///
+    /// \throws std::runtime_error If a new server did not become ready within \ref server_pool_options::ready_timeout.
+    server_lease acquire_server();
+
+    /// Lease an ensemble of \a size servers, starting one if none of that size is idle. An ensemble of \c 1 is the same
+    /// as a standalone server.
+    ///
+    /// \throws std::invalid_argument If \a size is \c 0.
+    /// \throws std::runtime_error If a new ensemble did not get a quorum within
+    ///  \ref server_pool_options::ready_timeout.
+    server_lease acquire_ensemble(std::size_t size);
+
+    /// The number of servers and ensembles waiting for a lease.
+    std::size_t idle_count() const;
+
+private:
+    struct entry;
+
+    friend class server_lease;
+
+private:
+    std::unique_ptr<entry> start_entry(std::size_t size);
+
+    void give_back(std::unique_ptr<entry> item) noexcept;
+
+private:
+    classpath                                          _packages;
+    server_pool_options                                _options;
+    mutable std::mutex                                 _protect;
+    std::multimap<std::size_t, std::unique_ptr<entry>> _idle;       //!< Idle entries by their number of servers
+    std::size_t                                        _next_index; //!< Names the data directory of the next entry
+    std::uint16_t                                      _next_port;
+};
+
+/// Exclusive use of a server or ensemble of a \ref server_pool. The servers go back to the pool when the lease is
+/// destroyed (or \ref release is called), unless they were shut down with \ref shutdown.
+class server_lease final
+{
+public:
+    /// Create a lease of nothing.
+    server_lease() noexcept;
+
+    server_lease(server_lease&&) noexcept;
+    server_lease& operator=(server_lease&&) noexcept;
+
+    ~server_lease() noexcept;
+
+    /// Does this lease hold servers?
+    explicit operator bool() const noexcept { return bool(_entry); }
+
+    /// The number of servers in the lease (\c 0 if it holds none).
+    std::size_t size() const noexcept;
+
+    /// A connection string for the leased servers.
+    const std::string& connection_string() const;
+
+    /// Shut the leased servers down for good, for tests of how clients cope with losing them. They are not given back
+    /// to the pool. A standalone server honours \a wait_for_stop; the servers of an ensemble are always waited for.
+    void shutdown(bool wait_for_stop = true);
+
+    /// Give the servers back to the pool now. Afterwards, this lease holds nothing.
+    void release() noexcept;
+
+private:
+    friend class server_pool;
+
+    explicit server_lease(server_pool& owner, std::unique_ptr<server_pool::entry> item) noexcept;
+
+private:
+    server_pool*                        _owner;
+    std::unique_ptr<server_pool::entry> _entry;
+};
+
+/// \}
+
+}
@@ -0,0 +1,65 @@
+#include <zk/client.hpp>
+#include <zk/results.hpp>
+#include <zk/tests/test.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "server_pool.hpp"
+#include "server_tests.hpp"
+
+namespace zk::server
+{
+
+GTEST_TEST(server_pool_tests, reuse_after_reset)
+{
+    auto& pool = test_server_pool();
+
+    std::string conn_string;
+    {
+        auto lease = pool.acquire_server();
+        CHECK_EQ(1U, lease.size());
+        conn_string = lease.connection_string();
+
+        auto c = client::connect(conn_string).get();
+        c.create("/pool-test", buffer()).get();
+        c.create("/pool-test/child", buffer()).get();
+        c.create("/pool-other", buffer()).get();
+    }
+
+    auto idle = pool.idle_count();
+    CHECK_LE(1U, idle);
+
+    auto lease = pool.acquire_server();
+    CHECK_EQ(idle - 1U, pool.idle_count());
+
+    auto c        = client::connect(lease.connection_string()).get();
+    auto children = c.get_children("/").get().children();
+    CHECK_EQ(std::vector<std::string>{ "zookeeper" }, children);
+}
+
+GTEST_TEST(server_pool_tests, shutdown_is_not_reused)
+{
+    auto& pool = test_server_pool();
+
+    auto lease = pool.acquire_server();
+    auto idle  = pool.idle_count();
+    lease.shutdown();
+    lease.release();
+    CHECK_FALSE(lease);
+    CHECK_EQ(idle, pool.idle_count());
+}
+
+GTEST_TEST(server_pool_tests, empty_lease)
+{
+    server_lease lease;
+    CHECK_FALSE(lease);
+    CHECK_EQ(0U, lease.size());
+    CHECK_THROWS(std::logic_error) { lease.connection_string(); };
+    lease.release();
+
+    CHECK_THROWS(std::invalid_argument) { test_server_pool().acquire_ensemble(0U); };
+}
+
+}
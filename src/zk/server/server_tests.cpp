@@ -36,23 +36,29 @@ void delete_directory(std::string path)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// test_server_pool                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+server_pool& test_server_pool()
+{
+    static server_pool instance(test_package_registry::instance().find_newest_classpath().value());
+    return instance;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // server_fixture                                                                                                     //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void server_fixture::SetUp()
 {
-    delete_directory("zk-data");
-    _server = std::make_shared<server>(test_package_registry::instance().find_newest_classpath().value(),
-                                       configuration::make_minimal("zk-data")
-                                      );
-    _conn_string = "zk://127.0.0.1:2181";
+    _lease       = test_server_pool().acquire_server();
+    _conn_string = _lease.connection_string();
 }
 
 void server_fixture::TearDown()
 {
-    _server->shutdown();
-    _server.reset();
+    _lease.release();
     _conn_string.clear();
 }
 
@@ -68,29 +74,25 @@ client server_fixture::get_connected_client() const
 
 void server_fixture::stop_server(bool wait_for_stop)
 {
-    _server->shutdown(wait_for_stop);
+    _lease.shutdown(wait_for_stop);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // single_server_fixture                                                                                              //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static std::shared_ptr<server> single_server_server;
-static std::string             single_server_conn_string;
+static server_lease single_server_lease;
+static std::string  single_server_conn_string;
 
 void single_server_fixture::SetUpTestCase()
 {
-    delete_directory("zk-data");
-    single_server_server = std::make_shared<server>(test_package_registry::instance().find_newest_classpath().value(),
-                                                    configuration::make_minimal("zk-data")
-                                                   );
-    single_server_conn_string = "zk://127.0.0.1:2181";
+    single_server_lease       = test_server_pool().acquire_server();
+    single_server_conn_string = single_server_lease.connection_string();
 }
 
 void single_server_fixture::TearDownTestCase()
 {
-    single_server_server->shutdown();
-    single_server_server.reset();
+    single_server_lease.release();
     single_server_conn_string.clear();
 }
 
@@ -113,8 +115,9 @@ GTEST_TEST(server_tests, start_stop)
     server svr(test_package_registry::instance().find_newest_classpath().value(),
                configuration::make_minimal("zk-data")
               );
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    CHECK_TRUE(svr.wait_until_ready(std::chrono::seconds(30)));
     svr.shutdown();
+    CHECK_FALSE(svr.wait_until_ready(std::chrono::seconds(1)));
 }
 
 GTEST_TEST(server_tests, shutdown_and_wait)
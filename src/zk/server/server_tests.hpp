@@ -6,10 +6,14 @@
 
 #include <memory>
 
+#include "server_pool.hpp"
+
 namespace zk::server
 {
 
-class server;
+/// The pool the fixtures lease their servers from. It is created with the newest registered classpath the first time
+/// it is asked for and lives as long as the test program, so its servers are started once rather than once per test.
+server_pool& test_server_pool();
 
 class server_fixture :
         public test::test_fixture
@@ -27,12 +31,12 @@ protected:
     void stop_server(bool wait_for_stop = true);
 
 private:
-    std::shared_ptr<server> _server;
-    std::string             _conn_string;
+    server_lease _lease;
+    std::string  _conn_string;
 };
 
-/// Similar to \ref server_fixture, but do not start up and tear down the server with each test. Instead, setup is run
-/// once at the start of a suite and torn down at the end of it.
+/// Similar to \ref server_fixture, but do not lease a server for each test. Instead, one is leased at the start of a
+/// suite and given back at the end of it, so the tests of a suite see each other's entries.
 class single_server_fixture :
         public test::test_fixture
 {
@@ -0,0 +1,353 @@
+#include "sharded_client.hpp"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// read_routing                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const read_routing& self)
+{
+    switch (self)
+    {
+    case read_routing::by_path:     return os << "by_path";
+    case read_routing::round_robin: return os << "round_robin";
+    default:                        return os << "read_routing(" << static_cast<int>(self) << ')';
+    }
+}
+
+std::string to_string(const read_routing& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// read_consistency                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const read_consistency& self)
+{
+    switch (self)
+    {
+    case read_consistency::any:    return os << "any";
+    case read_consistency::fenced: return os << "fenced";
+    default:                       return os << "read_consistency(" << static_cast<int>(self) << ')';
+    }
+}
+
+std::string to_string(const read_consistency& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// sharded_client                                                                                                     //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct sharded_client::state final
+{
+    explicit state(std::vector<client> sessions, read_routing routing, bool dedicated_writer) :
+            sessions(std::move(sessions)),
+            routing(routing),
+            first_reader(dedicated_writer ? 1U : 0U),
+            next_reader(0U)
+    { }
+
+    std::size_t reader_count() const
+    {
+        return sessions.size() - first_reader;
+    }
+
+    const client& by_path(path_view path) const
+    {
+        return sessions[first_reader + std::hash<string_view>()(path.view()) % reader_count()];
+    }
+
+    std::vector<client>              sessions;
+    read_routing                     routing;
+    std::size_t                      first_reader; //!< 1 when the writer is kept out of the reads
+    mutable std::atomic<std::size_t> next_reader;
+};
+
+/// The future of a connection which can not be made, holding a \c std::invalid_argument saying why (\a message).
+static future<sharded_client> invalid_connect(const char* message)
+{
+    promise<sharded_client> p;
+    p.set_exception(std::make_exception_ptr(std::invalid_argument(message)));
+    return p.get_future();
+}
+
+future<sharded_client> sharded_client::connect(connection_params params)
+{
+    return connect(std::move(params), options());
+}
+
+future<sharded_client> sharded_client::connect(connection_params params, options opts)
+{
+    if (opts.session_count() == 0U)
+        return invalid_connect("sharded_client needs at least one session");
+
+    bool with_observers = !opts.observer_hosts().empty();
+    if (with_observers && opts.session_count() < 2U)
+        return invalid_connect("sharded_client needs a writer and at least one reader to use observers");
+
+    std::vector<future<client>> pending;
+    pending.reserve(opts.session_count());
+    for (std::size_t idx = 0U; idx < opts.session_count(); ++idx)
+    {
+        // With observers, the writer (session 0) is the only session on the voting members and is never pinned
+        bool is_reader      = with_observers && idx > 0U;
+        auto session_params = params;
+        if (is_reader)
+            session_params.hosts() = opts.observer_hosts();
+
+        const auto& hosts    = session_params.hosts();
+        auto        host_idx = is_reader ? idx - 1U : idx;
+        if (opts.pin_hosts() && !hosts.empty() && (is_reader || !with_observers))
+        {
+            auto pinned = hosts[host_idx % hosts.size()];
+            session_params.hosts() = { std::move(pinned) };
+        }
+        pending.emplace_back(client::connect(std::move(session_params)));
+    }
+
+    auto gather = [routing = opts.read_routing(), with_observers] (std::vector<future<client>> connecting)
+                  {
+                      std::vector<client> sessions;
+                      std::exception_ptr  failure;
+                      for (auto& session : connecting)
+                      {
+                          try
+                          {
+                              sessions.emplace_back(session.get());
+                          }
+                          catch (...)
+                          {
+                              if (!failure)
+                                  failure = std::current_exception();
+                          }
+                      }
+
+                      if (failure)
+                      {
+                          for (auto& session : sessions)
+                              session.close();
+                          std::rethrow_exception(failure);
+                      }
+
+                      return sharded_client(std::move(sessions), routing, with_observers);
+                  };
+
+#if ZKPP_FUTURE_USE_ZK
+    return when_all(std::move(pending)).then([gather] (future<std::vector<future<client>>> ready)
+                                             {
+                                                 return gather(ready.get());
+                                             }
+                                            );
+#else
+    // Like client::connect, there is no continuation on the future to rely on, so wait on a separate thread
+    return std::async(std::launch::async, [gather, pending = std::move(pending)] () mutable
+                                          {
+                                              return gather(std::move(pending));
+                                          }
+                     );
+#endif
+}
+
+sharded_client::sharded_client(std::vector<client> sessions, read_routing routing, bool dedicated_writer)
+{
+    if (sessions.empty())
+        throw std::invalid_argument("sharded_client needs at least one session");
+    if (dedicated_writer && sessions.size() < 2U)
+        throw std::invalid_argument("sharded_client needs a reader besides its dedicated writer");
+
+    _state = std::make_shared<state>(std::move(sessions), routing, dedicated_writer);
+}
+
+sharded_client::~sharded_client() noexcept = default;
+
+void sharded_client::close()
+{
+    for (auto& session : _state->sessions)
+        session.close();
+}
+
+std::size_t sharded_client::session_count() const
+{
+    return _state->sessions.size();
+}
+
+client sharded_client::session(std::size_t idx) const
+{
+    return _state->sessions.at(idx);
+}
+
+client sharded_client::writer() const
+{
+    return _state->sessions.front();
+}
+
+client sharded_client::reader_for(path_view path) const
+{
+    if (_state->routing == read_routing::round_robin)
+    {
+        auto idx = _state->next_reader.fetch_add(1U, std::memory_order_relaxed);
+        return _state->sessions[_state->first_reader + idx % _state->reader_count()];
+    }
+    else
+    {
+        return _state->by_path(path);
+    }
+}
+
+client sharded_client::watcher_for(path_view path) const
+{
+    return _state->by_path(path);
+}
+
+future<get_result> sharded_client::get(path_view path) const
+{
+    return reader_for(path).get(path);
+}
+
+void sharded_client::get(path_view path, callback<get_result> on_complete) const
+{
+    reader_for(path).get(path, std::move(on_complete));
+}
+
+future<get_result> sharded_client::get(path_view path, read_consistency consistency) const
+{
+    auto reader = reader_for(path);
+    return consistency == read_consistency::fenced ? reader.get_linearizable(path) : reader.get(path);
+}
+
+void sharded_client::get(path_view path, read_consistency consistency, callback<get_result> on_complete) const
+{
+    // A fenced read is sent right behind its fence, so the fence does not have to be waited for; it fails if the fence
+    // does, rather than answering from a server which might be behind
+    auto reader = reader_for(path);
+    if (consistency == read_consistency::fenced)
+        reader.get_linearizable(path, std::move(on_complete));
+    else
+        reader.get(path, std::move(on_complete));
+}
+
+future<get_children_result> sharded_client::get_children(path_view path) const
+{
+    return reader_for(path).get_children(path);
+}
+
+void sharded_client::get_children(path_view path, callback<get_children_result> on_complete) const
+{
+    reader_for(path).get_children(path, std::move(on_complete));
+}
+
+future<get_children_result> sharded_client::get_children(path_view path, read_consistency consistency) const
+{
+    auto reader = reader_for(path);
+    return consistency == read_consistency::fenced ? reader.get_children_linearizable(path)
+                                                   : reader.get_children(path);
+}
+
+void sharded_client::get_children(path_view                     path,
+                                  read_consistency              consistency,
+                                  callback<get_children_result> on_complete
+                                 ) const
+{
+    auto reader = reader_for(path);
+    if (consistency == read_consistency::fenced)
+        reader.get_children_linearizable(path, std::move(on_complete));
+    else
+        reader.get_children(path, std::move(on_complete));
+}
+
+future<exists_result> sharded_client::exists(path_view path) const
+{
+    return reader_for(path).exists(path);
+}
+
+void sharded_client::exists(path_view path, callback<exists_result> on_complete) const
+{
+    reader_for(path).exists(path, std::move(on_complete));
+}
+
+future<exists_result> sharded_client::exists(path_view path, read_consistency consistency) const
+{
+    auto reader = reader_for(path);
+    return consistency == read_consistency::fenced ? reader.exists_linearizable(path) : reader.exists(path);
+}
+
+void sharded_client::exists(path_view path, read_consistency consistency, callback<exists_result> on_complete) const
+{
+    auto reader = reader_for(path);
+    if (consistency == read_consistency::fenced)
+        reader.exists_linearizable(path, std::move(on_complete));
+    else
+        reader.exists(path, std::move(on_complete));
+}
+
+future<watch_result> sharded_client::watch(path_view path) const
+{
+    return watcher_for(path).watch(path);
+}
+
+void sharded_client::watch(path_view path, callback<watch_result> on_complete) const
+{
+    watcher_for(path).watch(path, std::move(on_complete));
+}
+
+void sharded_client::watch(path_view path, callback<watch_result> on_complete, event_callback on_event) const
+{
+    watcher_for(path).watch(path, std::move(on_complete), std::move(on_event));
+}
+
+future<watch_children_result> sharded_client::watch_children(path_view path) const
+{
+    return watcher_for(path).watch_children(path);
+}
+
+void sharded_client::watch_children(path_view path, callback<watch_children_result> on_complete) const
+{
+    watcher_for(path).watch_children(path, std::move(on_complete));
+}
+
+void sharded_client::watch_children(path_view                       path,
+                                    callback<watch_children_result> on_complete,
+                                    event_callback                  on_event
+                                   ) const
+{
+    watcher_for(path).watch_children(path, std::move(on_complete), std::move(on_event));
+}
+
+future<watch_exists_result> sharded_client::watch_exists(path_view path) const
+{
+    return watcher_for(path).watch_exists(path);
+}
+
+void sharded_client::watch_exists(path_view path, callback<watch_exists_result> on_complete) const
+{
+    watcher_for(path).watch_exists(path, std::move(on_complete));
+}
+
+void sharded_client::watch_exists(path_view                     path,
+                                  callback<watch_exists_result> on_complete,
+                                  event_callback                on_event
+                                 ) const
+{
+    watcher_for(path).watch_exists(path, std::move(on_complete), std::move(on_event));
+}
+
+}
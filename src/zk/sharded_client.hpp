@@ -0,0 +1,220 @@
+/// \file
+/// Defines \ref zk::sharded_client, which spreads reads over several sessions.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "callback.hpp"
+#include "client.hpp"
+#include "connection.hpp"
+#include "forwards.hpp"
+#include "future.hpp"
+#include "path.hpp"
+#include "results.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// How a \ref sharded_client picks the session for a read.
+enum class read_routing : int
+{
+    /// Reads of a path always go to the same session, chosen by the hash of the path. Since a single session sees a
+    /// single, ordered view of the ensemble, successive reads of one path never go back in time.
+    by_path,
+    /// Reads go to each session in turn, which spreads load most evenly when a few paths are very hot. Two successive
+    /// reads of the same path can be served by different servers, so the second can return an older value.
+    round_robin,
+};
+
+std::ostream& operator<<(std::ostream&, const read_routing&);
+
+std::string to_string(const read_routing&);
+
+/// What a read through a \ref sharded_client is guaranteed to see.
+enum class read_consistency : int
+{
+    /// Whatever the server of the reading session has applied so far, which can be behind the latest writes.
+    any,
+    /// Everything written (through any session) before the read was made: the reading session is sent a
+    /// \ref client::load_fence just ahead of the read (see \ref client::get_linearizable), and the read fails with the
+    /// fence if the fence fails. This costs a round trip to the leader, so save it for the reads which must see a
+    /// preceding write.
+    fenced,
+};
+
+std::ostream& operator<<(std::ostream&, const read_consistency&);
+
+std::string to_string(const read_consistency&);
+
+/// A group of \ref client sessions to the same ensemble. A single session is a single socket to a single server,
+/// serviced by one I/O thread and one completion thread, which limits how many reads a process can get through. A
+/// \c sharded_client opens several sessions and spreads reads over them.
+///
+/// \par Ordering
+/// ZooKeeper only orders operations within a session, so a \c sharded_client makes the following guarantees:
+/// - All writes go through one session, the \ref writer, so they are applied in the order they were sent.
+/// - Watches on a path are always left through the same session (the one \ref reader_for the path picks with
+///   \ref read_routing::by_path), so the events for one path are never reordered between sessions.
+/// - A read through any session other than the \ref writer may not yet see a write which was just acknowledged. When
+///   a read must see the result of a preceding write, read with \ref read_consistency::fenced (or read through the
+///   \ref writer).
+///
+/// \par Observers
+/// Observers serve reads without voting, so they add read capacity without slowing writes down. With
+/// \ref options::observer_hosts, the \ref writer connects to the voting members (\ref connection_params::hosts) and
+/// every other session connects to the observers; reads and watches only go through those.
+///
+/// \code
+/// auto shards = zk::sharded_client::connect(zk::connection_params::parse("zk://a:2181,b:2181,c:2181/")).get();
+/// auto config = shards.get("/app/config").get();      // served by one of the sessions
+/// shards.writer().set("/app/config", new_value).get(); // always through the same session
+/// \endcode
+class sharded_client final
+{
+public:
+    /// Controls how many sessions are opened and how they are used.
+    class options final
+    {
+    public:
+        options() = default;
+
+        /// The number of sessions to open. The default is 4.
+        std::size_t  session_count() const { return _session_count; }
+        std::size_t& session_count()       { return _session_count; }
+
+        /// How reads are spread over the sessions. The default is \ref read_routing::by_path.
+        zk::read_routing  read_routing() const { return _read_routing; }
+        zk::read_routing& read_routing()       { return _read_routing; }
+
+        /// Should each session connect to a single host? If \c false (the default), every session is given all of
+        /// \ref connection_params::hosts, so the sessions land on servers at random and fail over like any other
+        /// client. If \c true, session \c i only knows about host <tt>i % hosts().size()</tt>, which spreads the
+        /// sessions over the servers exactly, but a session can not fail over if its server goes down.
+        bool  pin_hosts() const { return _pin_hosts; }
+        bool& pin_hosts()       { return _pin_hosts; }
+
+        /// The observers of the ensemble, in the same \c host:port form as \ref connection_params::hosts. When this
+        /// is not empty (the default is empty), the \ref writer only takes writes and every other session connects to
+        /// the observers, so at least two sessions are needed. \ref pin_hosts spreads the readers over these instead.
+        const connection_params::host_list& observer_hosts() const { return _observer_hosts; }
+        connection_params::host_list&       observer_hosts()       { return _observer_hosts; }
+
+    private:
+        std::size_t                  _session_count = 4U;
+        zk::read_routing             _read_routing  = zk::read_routing::by_path;
+        bool                         _pin_hosts     = false;
+        connection_params::host_list _observer_hosts;
+    };
+
+public:
+    /// \{
+    /// Connect all of the sessions described by \a params and \a opts.
+    ///
+    /// \returns A future which is filled when every session has connected. If any of them fails, the future is
+    ///  delivered with that failure (and the other sessions are closed). If \a opts asks for no sessions, or for
+    ///  observers with fewer than two sessions, the future already holds a \c std::invalid_argument.
+    static future<sharded_client> connect(connection_params params);
+    static future<sharded_client> connect(connection_params params, options opts);
+    /// \}
+
+    /// Create an instance from existing \a sessions. The first of them is the \ref writer. If \a dedicated_writer, it
+    /// only takes writes and the reads and watches go through the other sessions (connected to observers, say).
+    ///
+    /// \throws std::invalid_argument if \a sessions is empty, or has a single session and \a dedicated_writer is set.
+    explicit sharded_client(std::vector<client> sessions,
+                            zk::read_routing    routing          = zk::read_routing::by_path,
+                            bool                dedicated_writer = false
+                           );
+
+    sharded_client(const sharded_client&) noexcept = default;
+    sharded_client(sharded_client&&) noexcept = default;
+
+    sharded_client& operator=(const sharded_client&) noexcept = default;
+    sharded_client& operator=(sharded_client&&) noexcept = default;
+
+    ~sharded_client() noexcept;
+
+    /// Close every session.
+    void close();
+
+    /// The number of sessions.
+    std::size_t session_count() const;
+
+    /// Get the session with the given \a idx.
+    client session(std::size_t idx) const;
+
+    /// The session all writes should go through.
+    client writer() const;
+
+    /// The session that a read of \a path is sent through, according to the configured \ref read_routing. This is
+    /// never the \ref writer when it is dedicated to writes.
+    client reader_for(path_view path) const;
+
+    /// The session that watches of \a path are left through. This is the same no matter the \ref read_routing.
+    client watcher_for(path_view path) const;
+
+    /// \{
+    /// \ref client::get through \ref reader_for. The forms without a \ref read_consistency read with
+    /// \ref read_consistency::any.
+    future<get_result> get(path_view path) const;
+    future<get_result> get(path_view path, read_consistency consistency) const;
+    void get(path_view path, callback<get_result> on_complete) const;
+    void get(path_view path, read_consistency consistency, callback<get_result> on_complete) const;
+    /// \}
+
+    /// \{
+    /// \ref client::get_children through \ref reader_for.
+    future<get_children_result> get_children(path_view path) const;
+    future<get_children_result> get_children(path_view path, read_consistency consistency) const;
+    void get_children(path_view path, callback<get_children_result> on_complete) const;
+    void get_children(path_view path, read_consistency consistency, callback<get_children_result> on_complete) const;
+    /// \}
+
+    /// \{
+    /// \ref client::exists through \ref reader_for.
+    future<exists_result> exists(path_view path) const;
+    future<exists_result> exists(path_view path, read_consistency consistency) const;
+    void exists(path_view path, callback<exists_result> on_complete) const;
+    void exists(path_view path, read_consistency consistency, callback<exists_result> on_complete) const;
+    /// \}
+
+    /// \{
+    /// \ref client::watch through \ref watcher_for.
+    future<watch_result> watch(path_view path) const;
+    void watch(path_view path, callback<watch_result> on_complete) const;
+    void watch(path_view path, callback<watch_result> on_complete, event_callback on_event) const;
+    /// \}
+
+    /// \{
+    /// \ref client::watch_children through \ref watcher_for.
+    future<watch_children_result> watch_children(path_view path) const;
+    void watch_children(path_view path, callback<watch_children_result> on_complete) const;
+    void watch_children(path_view path, callback<watch_children_result> on_complete, event_callback on_event) const;
+    /// \}
+
+    /// \{
+    /// \ref client::watch_exists through \ref watcher_for.
+    future<watch_exists_result> watch_exists(path_view path) const;
+    void watch_exists(path_view path, callback<watch_exists_result> on_complete) const;
+    void watch_exists(path_view path, callback<watch_exists_result> on_complete, event_callback on_event) const;
+    /// \}
+
+private:
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// \}
+
+}
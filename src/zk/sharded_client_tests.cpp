@@ -0,0 +1,148 @@
+#include <zk/fake/server.hpp>
+#include <zk/server/server_tests.hpp>
+
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include "error.hpp"
+#include "sharded_client.hpp"
+#include "string_view.hpp"
+
+namespace zk
+{
+
+static buffer buffer_from(string_view str)
+{
+    return buffer(str.data(), str.data() + str.size());
+}
+
+GTEST_TEST(read_routing_tests, stringify)
+{
+    CHECK_EQ("by_path",     to_string(read_routing::by_path));
+    CHECK_EQ("round_robin", to_string(read_routing::round_robin));
+}
+
+GTEST_TEST(read_consistency_tests, stringify)
+{
+    CHECK_EQ("any",    to_string(read_consistency::any));
+    CHECK_EQ("fenced", to_string(read_consistency::fenced));
+}
+
+GTEST_TEST(sharded_client_argument_tests, no_sessions)
+{
+    CHECK_THROWS(std::invalid_argument)
+    {
+        sharded_client(std::vector<client>());
+    };
+}
+
+GTEST_TEST(sharded_client_argument_tests, observers_need_a_reader)
+{
+    CHECK_THROWS(std::invalid_argument)
+    {
+        sharded_client({ client(std::shared_ptr<connection>()) }, read_routing::by_path, true);
+    };
+
+    sharded_client::options opts;
+    opts.session_count()  = 1U;
+    opts.observer_hosts() = { "observer:2181" };
+    auto connecting = sharded_client::connect(connection_params::parse("zk://voter:2181/"), opts);
+    CHECK_THROWS(std::invalid_argument) { connecting.get(); };
+
+    opts.session_count() = 0U;
+    auto none = sharded_client::connect(connection_params::parse("zk://voter:2181/"), opts);
+    CHECK_THROWS(std::invalid_argument) { none.get(); };
+}
+
+GTEST_TEST(sharded_client_fence_tests, failed_fence_fails_read)
+{
+    auto           srv = fake::server::create("sharded-fence");
+    sharded_client shards({ client(srv->connection_string()), client(srv->connection_string()) });
+    shards.writer().create("/fenced", buffer_from("value")).get();
+
+    // The fence goes out first, so it is the one to fail; the read behind it succeeds, but can not be vouched for
+    srv->fail_next(error_code::connection_loss);
+    CHECK_THROWS(connection_loss) { shards.get("/fenced", read_consistency::fenced).get(); };
+    srv->fail_next(error_code::connection_loss);
+    CHECK_THROWS(connection_loss) { shards.get_children("/fenced", read_consistency::fenced).get(); };
+    srv->fail_next(error_code::connection_loss);
+    CHECK_THROWS(connection_loss) { shards.exists("/fenced", read_consistency::fenced).get(); };
+
+    CHECK_TRUE(shards.get("/fenced", read_consistency::fenced).get().data() == buffer_from("value"));
+    CHECK_TRUE(shards.exists("/fenced", read_consistency::fenced).get());
+    shards.close();
+}
+
+class sharded_client_tests :
+        public server::single_server_fixture
+{
+protected:
+    sharded_client get_sharded_client(std::size_t session_count, read_routing routing)
+    {
+        sharded_client::options opts;
+        opts.session_count() = session_count;
+        opts.read_routing()  = routing;
+        return sharded_client::connect(connection_params::parse(get_connection_string()), opts).get();
+    }
+};
+
+GTEST_TEST_F(sharded_client_tests, write_then_read)
+{
+    auto shards = get_sharded_client(3U, read_routing::by_path);
+    CHECK_EQ(3U, shards.session_count());
+
+    shards.writer().create("/sharded-write", buffer_from("value")).get();
+    shards.reader_for("/sharded-write").load_fence().get();
+    CHECK_TRUE(shards.get("/sharded-write").get().data() == buffer_from("value"));
+    CHECK_TRUE(shards.exists("/sharded-write").get());
+    CHECK_TRUE(shards.get_children("/sharded-write").get().children().empty());
+
+    // A fenced read sees the write without waiting on a fence first
+    shards.writer().set("/sharded-write", buffer_from("changed")).get();
+    CHECK_TRUE(shards.get("/sharded-write", read_consistency::fenced).get().data() == buffer_from("changed"));
+    CHECK_TRUE(shards.exists("/sharded-write", read_consistency::fenced).get());
+    shards.close();
+}
+
+GTEST_TEST_F(sharded_client_tests, watch_sees_write)
+{
+    auto shards = get_sharded_client(3U, read_routing::round_robin);
+
+    shards.writer().create("/sharded-watch", buffer_from("first")).get();
+    shards.watcher_for("/sharded-watch").load_fence().get();
+    auto watch = shards.watch("/sharded-watch").get();
+    CHECK_TRUE(watch.initial().data() == buffer_from("first"));
+
+    shards.writer().set("/sharded-watch", buffer_from("second")).get();
+    CHECK_EQ(event_type::changed, watch.next().get().type());
+    shards.close();
+}
+
+/// The session which created an ephemeral entry is its owner, which tells the sessions apart.
+static std::uint64_t session_of(client session, const std::string& path)
+{
+    session.create(path, buffer(), create_mode::ephemeral).get();
+    return session.get(path).get().stat().ephemeral_owner;
+}
+
+GTEST_TEST_F(sharded_client_tests, routing)
+{
+    auto shards = get_sharded_client(4U, read_routing::round_robin);
+
+    std::set<std::uint64_t> watching;
+    std::set<std::uint64_t> reading;
+    for (std::size_t idx = 0U; idx < shards.session_count(); ++idx)
+    {
+        watching.insert(session_of(shards.watcher_for("/sharded-routing"), "/watch-" + std::to_string(idx)));
+        reading.insert(session_of(shards.reader_for("/sharded-routing"), "/read-" + std::to_string(idx)));
+    }
+
+    // watches of a path stick to one session, while round robin reads visit every one of them
+    CHECK_EQ(1U, watching.size());
+    CHECK_EQ(shards.session_count(), reading.size());
+    shards.close();
+}
+
+}
@@ -0,0 +1,91 @@
+#include "shared_buffer.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// shared_buffer                                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr shared_buffer::size_type shared_buffer::npos;
+
+shared_buffer::shared_buffer() noexcept :
+        _data(nullptr),
+        _size(0U)
+{ }
+
+shared_buffer::shared_buffer(ptr<const char> first, ptr<const char> last) :
+        shared_buffer(std::make_shared<const buffer>(first, last))
+{ }
+
+shared_buffer::shared_buffer(buffer&& data) :
+        shared_buffer(std::make_shared<const buffer>(std::move(data)))
+{ }
+
+shared_buffer::shared_buffer(std::shared_ptr<const buffer> storage) noexcept :
+        _storage(std::move(storage)),
+        _data(_storage ? _storage->data() : nullptr),
+        _size(_storage ? _storage->size() : 0U)
+{ }
+
+shared_buffer::shared_buffer(shared_buffer&& src) noexcept :
+        _storage(std::move(src._storage)),
+        _data(std::exchange(src._data, nullptr)),
+        _size(std::exchange(src._size, 0U))
+{ }
+
+shared_buffer& shared_buffer::operator=(shared_buffer&& src) noexcept
+{
+    if (this != &src)
+    {
+        _storage = std::move(src._storage);
+        _data    = std::exchange(src._data, nullptr);
+        _size    = std::exchange(src._size, 0U);
+    }
+    return *this;
+}
+
+shared_buffer::~shared_buffer() noexcept = default;
+
+shared_buffer shared_buffer::slice(size_type offset, size_type count) const
+{
+    if (offset > _size)
+        throw std::out_of_range("Slice offset " + std::to_string(offset) + " is past the end of "
+                                + std::to_string(_size) + " bytes"
+                               );
+
+    shared_buffer out(*this);
+    out._data += offset;
+    out._size  = std::min(count, _size - offset);
+    return out;
+}
+
+std::shared_ptr<const buffer> shared_buffer::whole() const noexcept
+{
+    if (_storage && _data == _storage->data() && _size == _storage->size())
+        return _storage;
+    else
+        return nullptr;
+}
+
+buffer shared_buffer::to_buffer() const
+{
+    return buffer(_data, _data + _size);
+}
+
+bool operator==(const shared_buffer& a, const shared_buffer& b) noexcept
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+bool operator!=(const shared_buffer& a, const shared_buffer& b) noexcept
+{
+    return !(a == b);
+}
+
+}
@@ -0,0 +1,99 @@
+/// \file
+/// Defines \ref zk::shared_buffer, an immutable view of reference-counted data.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <cstddef>
+#include <memory>
+
+#include "buffer.hpp"
+#include "string_view.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// A read-only view of some or all of the bytes of a \ref buffer shared by everything which views it. Copying one (or
+/// taking a \ref slice of it) costs an atomic increment instead of a copy of the data, so when the data of one entry is
+/// handed to hundreds of readers, the memory used is that of the data once. The storage is released when the last view
+/// of it goes away.
+///
+/// The bytes are never modified, which is what makes it safe to share them between threads without further locking.
+/// To change the data, copy it out with \ref to_buffer.
+///
+/// \see get_result::share
+class shared_buffer final
+{
+public:
+    using value_type     = char;
+    using size_type      = std::size_t;
+    using const_iterator = ptr<const char>;
+    using iterator       = const_iterator;
+
+    /// \ref slice to the end of the data.
+    static constexpr size_type npos = size_type(-1);
+
+public:
+    /// Create an empty instance, which does not allocate.
+    shared_buffer() noexcept;
+
+    /// Create an instance with a copy of the range [\a first, \a last).
+    shared_buffer(ptr<const char> first, ptr<const char> last);
+
+    /// Take over the contents of \a data without copying them.
+    explicit shared_buffer(buffer&& data);
+
+    /// View all of the already-shared \a storage.
+    explicit shared_buffer(std::shared_ptr<const buffer> storage) noexcept;
+
+    shared_buffer(const shared_buffer&) noexcept = default;
+    shared_buffer(shared_buffer&&) noexcept;
+
+    shared_buffer& operator=(const shared_buffer&) noexcept = default;
+    shared_buffer& operator=(shared_buffer&&) noexcept;
+
+    ~shared_buffer() noexcept;
+
+    ptr<const char> data()  const noexcept { return _data; }
+    size_type       size()  const noexcept { return _size; }
+    bool            empty() const noexcept { return _size == 0U; }
+
+    const_iterator begin() const noexcept { return _data; }
+    const_iterator end()   const noexcept { return _data + _size; }
+
+    char operator[](size_type idx) const noexcept { return _data[idx]; }
+
+    /// The bytes as a \ref string_view, which is valid as long as any view of the storage is.
+    string_view view() const noexcept { return string_view(_data, _size); }
+
+    /// A view of \a count bytes from \a offset (or all of them after it if fewer are left), which shares the storage of
+    /// this one.
+    ///
+    /// \throws std::out_of_range if \a offset is past the end of the data.
+    shared_buffer slice(size_type offset, size_type count = npos) const;
+
+    /// The number of views of the storage, including this one (\c 0 for an empty instance which never had any).
+    long use_count() const noexcept { return _storage.use_count(); }
+
+    /// The storage this views, if this views all of it (and \c nullptr otherwise).
+    std::shared_ptr<const buffer> whole() const noexcept;
+
+    /// Copy the viewed bytes into a \ref buffer of their own.
+    buffer to_buffer() const;
+
+private:
+    std::shared_ptr<const buffer> _storage;
+    ptr<const char>               _data;
+    size_type                     _size;
+};
+
+/// Compares the contents, not whether the storage is the same.
+bool operator==(const shared_buffer& a, const shared_buffer& b) noexcept;
+bool operator!=(const shared_buffer& a, const shared_buffer& b) noexcept;
+
+/// \}
+
+}
@@ -0,0 +1,146 @@
+#include <zk/tests/test.hpp>
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "results.hpp"
+#include "shared_buffer.hpp"
+#include "tree_cache.hpp"
+
+namespace zk
+{
+
+static buffer buffer_from(string_view str)
+{
+    return buffer(str.data(), str.data() + str.size());
+}
+
+GTEST_TEST(shared_buffer_tests, copies_share_storage)
+{
+    shared_buffer original(buffer_from("framed records"));
+    CHECK_EQ(1, original.use_count());
+
+    auto copy = original;
+    CHECK_EQ(2, original.use_count());
+    CHECK_EQ(original.data(), copy.data());
+    CHECK_TRUE(original == copy);
+
+    auto moved = std::move(copy);
+    CHECK_EQ(2, original.use_count());
+    CHECK_TRUE(copy.empty());
+    CHECK_EQ("framed records", moved.view());
+
+    shared_buffer empty;
+    CHECK_EQ(0, empty.use_count());
+    CHECK_TRUE(empty.empty());
+    CHECK_TRUE(empty == shared_buffer(buffer()));
+}
+
+GTEST_TEST(shared_buffer_tests, slices)
+{
+    const std::string text = "header|body|trailer";
+    shared_buffer whole(text.data(), text.data() + text.size());
+    CHECK_TRUE(whole.whole() != nullptr);
+
+    auto body = whole.slice(7U, 4U);
+    CHECK_EQ("body", body.view());
+    CHECK_EQ(whole.data() + 7, body.data());
+    CHECK_EQ(2, whole.use_count());
+    CHECK_TRUE(body.whole() == nullptr);
+
+    // Slices of slices are relative, and running over the end stops at the end
+    CHECK_EQ("dy", body.slice(2U).view());
+    CHECK_EQ("trailer", whole.slice(12U, 100U).view());
+    CHECK_TRUE(whole.slice(text.size()).empty());
+    CHECK_THROWS(std::out_of_range) { whole.slice(text.size() + 1U); };
+
+    CHECK_EQ(buffer_from("body"), body.to_buffer());
+    CHECK_TRUE(body != whole);
+
+    // The storage lives as long as its last view does
+    whole = shared_buffer();
+    CHECK_EQ(1, body.use_count());
+    CHECK_EQ("body", body.view());
+}
+
+GTEST_TEST(shared_buffer_tests, get_result_sharing)
+{
+    // Longer than a small_buffer holds inline (ZKPP_BUFFER_USE_SMALL), so the data has storage whose address can be
+    // followed whichever buffer type is used
+    const std::string leader = "leader-3:" + std::string(96U, '.');
+
+    get_result result(buffer_from(leader), stat());
+    CHECK_FALSE(result.is_shared());
+    auto storage = result.data().data();
+
+    // Sharing moves the data rather than copying it
+    result.share();
+    CHECK_TRUE(result.is_shared());
+    const auto& shared = result;
+    CHECK_EQ(storage, shared.data().data());
+
+    std::vector<get_result> readers(200U, result);
+    for (const auto& reader : readers)
+        CHECK_EQ(storage, reader.data().data());
+    CHECK_EQ(202, result.shared_data().use_count());
+
+    // Mutable access gives that copy its own data, leaving the rest shared
+    readers.front().data().push_back('!');
+    CHECK_FALSE(readers.front().is_shared());
+    CHECK_EQ(buffer_from(leader + "!"), readers.front().data());
+    CHECK_EQ(buffer_from(leader), shared.data());
+
+    auto taken = std::move(readers.back()).data();
+    CHECK_EQ(buffer_from(leader), taken);
+    readers.clear();
+    CHECK_EQ(2, result.shared_data().use_count());
+
+    // A slice is copied once to become the data of a result
+    shared_buffer framed(buffer_from("len:hello"));
+    get_result from_slice(framed.slice(4U), stat());
+    CHECK_EQ(buffer_from("hello"), static_cast<const get_result&>(from_slice).data());
+    get_result from_whole(framed, stat());
+    CHECK_EQ(framed.data(), static_cast<const get_result&>(from_whole).data().data());
+
+    // An unshared result hands out its data without a copy when it is done with
+    get_result owned(buffer_from("owned:" + leader), stat());
+    auto owned_storage = owned.data().data();
+    auto view = std::move(owned).shared_data();
+    CHECK_EQ(owned_storage, view.data());
+}
+
+GTEST_TEST(shared_buffer_tests, tree_cache_node_shares)
+{
+    tree_cache::node first(buffer_from("data"), stat(), { "a" });
+    tree_cache::node second(first.shared_data(), stat(), { "a", "b" });
+    CHECK_EQ(first.data().data(), second.data().data());
+    CHECK_EQ(3, first.shared_data().use_count());
+}
+
+GTEST_TEST(shared_buffer_tests, concurrent_views)
+{
+    shared_buffer source(buffer(4096U, 'c'));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([source]
+                             {
+                                 for (std::size_t idx = 0U; idx < 10000U; ++idx)
+                                 {
+                                     auto piece = source.slice(idx % source.size(), 16U);
+                                     if (piece.empty() || piece[0] != 'c')
+                                         std::terminate();
+                                 }
+                             }
+                            );
+    }
+    for (auto& thread : threads)
+        thread.join();
+    CHECK_EQ(1, source.use_count());
+}
+
+}
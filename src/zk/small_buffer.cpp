@@ -0,0 +1,152 @@
+#include "small_buffer.hpp"
+
+#include <cstring>
+#include <utility>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// small_buffer                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr small_buffer::size_type small_buffer::inline_capacity;
+
+void small_buffer::grow(size_type min_capacity)
+{
+    // Doubling keeps a run of push_back calls linear, like it does for std::vector
+    auto new_capacity = std::max(min_capacity, 2U * _capacity);
+    auto new_data     = new char[new_capacity];
+    if (_size > 0U)
+        std::memcpy(new_data, _data, _size);
+
+    release();
+    _data     = new_data;
+    _capacity = new_capacity;
+}
+
+void small_buffer::shrink_to_fit()
+{
+    if (is_inline() || _size == _capacity)
+        return;
+
+    if (_size <= inline_capacity)
+    {
+        auto heap = _data;
+        if (_size > 0U)
+            std::memcpy(_inline, heap, _size);
+        _data     = _inline;
+        _capacity = inline_capacity;
+        delete[] heap;
+    }
+    else
+    {
+        auto new_data = new char[_size];
+        std::memcpy(new_data, _data, _size);
+        delete[] _data;
+        _data     = new_data;
+        _capacity = _size;
+    }
+}
+
+void small_buffer::assign(const_pointer first, const_pointer last)
+{
+    auto count = size_type(last - first);
+    if (count > _capacity)
+    {
+        // Nothing is worth keeping, so there is no point in the copy grow would make
+        clear();
+        grow(count);
+    }
+    if (count > 0U)
+        std::memmove(_data, first, count);
+    _size = count;
+}
+
+void small_buffer::open_gap(size_type offset, size_type count)
+{
+    if (_size + count > _capacity)
+        grow(_size + count);
+    if (offset < _size)
+        std::memmove(_data + offset + count, _data + offset, _size - offset);
+    _size += count;
+}
+
+small_buffer::iterator small_buffer::insert_range(const_iterator pos, const_pointer first, const_pointer last)
+{
+    auto offset = size_type(pos - _data);
+    auto count  = size_type(last - first);
+    if (count == 0U)
+        return _data + offset;
+
+    if (first >= _data && first < _data + _size)
+    {
+        // Copying out of ourselves: the gap would move (or free) the source
+        small_buffer copy(first, last);
+        return insert_range(pos, copy.data(), copy.data() + count);
+    }
+
+    open_gap(offset, count);
+    std::memcpy(_data + offset, first, count);
+    return _data + offset;
+}
+
+small_buffer::iterator small_buffer::insert(const_iterator pos, size_type count, char value)
+{
+    auto offset = size_type(pos - _data);
+    open_gap(offset, count);
+    std::memset(_data + offset, value, count);
+    return _data + offset;
+}
+
+small_buffer::iterator small_buffer::erase(const_iterator first, const_iterator last) noexcept
+{
+    auto offset = size_type(first - _data);
+    auto count  = size_type(last - first);
+    if (count > 0U)
+    {
+        std::memmove(_data + offset, _data + offset + count, _size - offset - count);
+        _size -= count;
+    }
+    return _data + offset;
+}
+
+void small_buffer::swap(small_buffer& other) noexcept
+{
+    if (this == &other)
+        return;
+
+    small_buffer temp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(temp);
+}
+
+void small_buffer::steal(small_buffer& src) noexcept
+{
+    if (src.is_inline())
+    {
+        std::memcpy(_inline, src._inline, src._size);
+        _data     = _inline;
+        _capacity = inline_capacity;
+    }
+    else
+    {
+        _data     = src._data;
+        _capacity = src._capacity;
+    }
+    _size = src._size;
+
+    src._data     = src._inline;
+    src._size     = 0U;
+    src._capacity = inline_capacity;
+}
+
+void small_buffer::release() noexcept
+{
+    if (!is_inline())
+        delete[] _data;
+    _data     = _inline;
+    _capacity = inline_capacity;
+}
+
+}
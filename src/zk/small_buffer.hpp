@@ -0,0 +1,283 @@
+/// \file
+/// Defines \ref zk::small_buffer, a byte buffer which keeps short contents inline.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// A contiguous buffer of bytes which holds up to \ref inline_capacity of them inside itself and only goes to the heap
+/// for anything longer. The data of most entries is tiny (a flag, the ID of a leader, a version marker), and with
+/// \c std::vector every one of them still costs an allocation to read and to send; with this, none of them do.
+///
+/// This behaves like the \c std::vector<char> subset which the library and most programs use: construction from a range
+/// or a count, \c data, \c size, iteration, \c assign, \c insert, \c resize, \c reserve and the comparisons. Unlike
+/// \c std::vector, moving a buffer with inline contents copies them, so pointers into the moved-from buffer do not
+/// carry over to the moved-to one.
+///
+/// Select this as the \ref buffer type with the CMake setting \c ZKPP_BUILD_SETTING_BUFFER=SMALL (which defines
+/// \ref ZKPP_BUFFER_USE_SMALL).
+class small_buffer final
+{
+public:
+    using value_type      = char;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference       = char&;
+    using const_reference = const char&;
+    using pointer         = ptr<char>;
+    using const_pointer   = ptr<const char>;
+    using iterator        = ptr<char>;
+    using const_iterator  = ptr<const char>;
+
+    /// Contents up to this size are stored without an allocation.
+    static constexpr size_type inline_capacity = 64U;
+
+public:
+    small_buffer() noexcept :
+            _data(_inline),
+            _size(0U),
+            _capacity(inline_capacity)
+    { }
+
+    /// Create a buffer of \a count copies of \a value.
+    explicit small_buffer(size_type count, char value = '\0') :
+            small_buffer()
+    {
+        resize(count, value);
+    }
+
+    small_buffer(const_pointer first, const_pointer last) :
+            small_buffer()
+    {
+        assign(first, last);
+    }
+
+    template <typename TIterator, typename = std::enable_if_t<!std::is_integral<TIterator>::value>>
+    small_buffer(TIterator first, TIterator last) :
+            small_buffer()
+    {
+        insert(end(), first, last);
+    }
+
+    small_buffer(std::initializer_list<char> values) :
+            small_buffer(values.begin(), values.end())
+    { }
+
+    small_buffer(const small_buffer& src) :
+            small_buffer(src.begin(), src.end())
+    { }
+
+    small_buffer(small_buffer&& src) noexcept :
+            small_buffer()
+    {
+        steal(src);
+    }
+
+    small_buffer& operator=(const small_buffer& src)
+    {
+        if (this != &src)
+            assign(src.begin(), src.end());
+        return *this;
+    }
+
+    small_buffer& operator=(small_buffer&& src) noexcept
+    {
+        if (this != &src)
+        {
+            release();
+            steal(src);
+        }
+        return *this;
+    }
+
+    small_buffer& operator=(std::initializer_list<char> values)
+    {
+        assign(values.begin(), values.end());
+        return *this;
+    }
+
+    ~small_buffer() noexcept
+    {
+        release();
+    }
+
+    pointer       data()       noexcept { return _data; }
+    const_pointer data() const noexcept { return _data; }
+
+    size_type size()     const noexcept { return _size; }
+    size_type capacity() const noexcept { return _capacity; }
+    bool      empty()    const noexcept { return _size == 0U; }
+
+    /// Are the contents held in the buffer itself (as opposed to on the heap)?
+    bool is_inline() const noexcept { return _data == _inline; }
+
+    iterator       begin()        noexcept { return _data; }
+    const_iterator begin()  const noexcept { return _data; }
+    const_iterator cbegin() const noexcept { return _data; }
+    iterator       end()          noexcept { return _data + _size; }
+    const_iterator end()    const noexcept { return _data + _size; }
+    const_iterator cend()   const noexcept { return _data + _size; }
+
+    reference       operator[](size_type idx)       noexcept { return _data[idx]; }
+    const_reference operator[](size_type idx) const noexcept { return _data[idx]; }
+
+    reference       front()       noexcept { return _data[0]; }
+    const_reference front() const noexcept { return _data[0]; }
+    reference       back()        noexcept { return _data[_size - 1U]; }
+    const_reference back()  const noexcept { return _data[_size - 1U]; }
+
+    /// Make room for at least \a new_capacity bytes without another allocation.
+    void reserve(size_type new_capacity)
+    {
+        if (new_capacity > _capacity)
+            grow(new_capacity);
+    }
+
+    /// Drop the heap storage if the contents fit in less of it (or inline).
+    void shrink_to_fit();
+
+    void resize(size_type new_size, char value = '\0')
+    {
+        if (new_size > _size)
+        {
+            reserve(new_size);
+            std::fill(_data + _size, _data + new_size, value);
+        }
+        _size = new_size;
+    }
+
+    /// Remove the contents, keeping the storage.
+    void clear() noexcept
+    {
+        _size = 0U;
+    }
+
+    void push_back(char value)
+    {
+        if (_size == _capacity)
+            grow(_size + 1U);
+        _data[_size++] = value;
+    }
+
+    void pop_back() noexcept
+    {
+        --_size;
+    }
+
+    /// Replace the contents with the range [\a first, \a last), which must not overlap this buffer.
+    void assign(const_pointer first, const_pointer last);
+
+    void assign(size_type count, char value)
+    {
+        clear();
+        resize(count, value);
+    }
+
+    /// Insert the range [\a first, \a last) before \a pos. Any range of iterators to \c char works (the range may be
+    /// part of this buffer).
+    ///
+    /// \returns an iterator to the first inserted byte.
+    template <typename TIterator, typename = std::enable_if_t<!std::is_integral<TIterator>::value>>
+    iterator insert(const_iterator pos, TIterator first, TIterator last)
+    {
+        using category = typename std::iterator_traits<TIterator>::iterator_category;
+        if constexpr (std::is_convertible<TIterator, const_pointer>::value)
+        {
+            return insert_range(pos, const_pointer(first), const_pointer(last));
+        }
+        else if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+        {
+            auto offset = size_type(pos - _data);
+            auto count  = size_type(std::distance(first, last));
+            open_gap(offset, count);
+            std::copy(first, last, _data + offset);
+            return _data + offset;
+        }
+        else
+        {
+            // Single-pass input has to be collected before its size is known
+            small_buffer collected;
+            for (; first != last; ++first)
+                collected.push_back(*first);
+            return insert_range(pos, collected.begin(), collected.end());
+        }
+    }
+
+    iterator insert(const_iterator pos, char value)
+    {
+        return insert_range(pos, &value, &value + 1);
+    }
+
+    iterator insert(const_iterator pos, size_type count, char value);
+
+    /// Remove the bytes in [\a first, \a last).
+    ///
+    /// \returns an iterator to the byte after the removed ones.
+    iterator erase(const_iterator first, const_iterator last) noexcept;
+
+    iterator erase(const_iterator pos) noexcept
+    {
+        return erase(pos, pos + 1);
+    }
+
+    void swap(small_buffer& other) noexcept;
+
+    friend bool operator==(const small_buffer& a, const small_buffer& b) noexcept
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+    }
+
+    friend bool operator!=(const small_buffer& a, const small_buffer& b) noexcept
+    {
+        return !(a == b);
+    }
+
+    friend bool operator<(const small_buffer& a, const small_buffer& b) noexcept
+    {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+    }
+
+    friend bool operator<=(const small_buffer& a, const small_buffer& b) noexcept { return !(b < a); }
+    friend bool operator> (const small_buffer& a, const small_buffer& b) noexcept { return b < a; }
+    friend bool operator>=(const small_buffer& a, const small_buffer& b) noexcept { return !(a < b); }
+
+private:
+    /// Move the contents to storage for at least \a min_capacity bytes.
+    void grow(size_type min_capacity);
+
+    /// Make room for \a count bytes at \a offset, moving what is after it back.
+    void open_gap(size_type offset, size_type count);
+
+    iterator insert_range(const_iterator pos, const_pointer first, const_pointer last);
+
+    /// Take the contents of \a src, which is left empty. This must not hold heap storage.
+    void steal(small_buffer& src) noexcept;
+
+    void release() noexcept;
+
+private:
+    pointer   _data;
+    size_type _size;
+    size_type _capacity;
+    char      _inline[inline_capacity];
+};
+
+inline void swap(small_buffer& a, small_buffer& b) noexcept
+{
+    a.swap(b);
+}
+
+/// \}
+
+}
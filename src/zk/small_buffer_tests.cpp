@@ -0,0 +1,139 @@
+#include <zk/tests/test.hpp>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "small_buffer.hpp"
+
+namespace zk
+{
+
+// The same requirements buffer.hpp checks, so the type stays selectable as zk::buffer whatever the build uses
+static_assert(sizeof(small_buffer::value_type) == 1, "small_buffer::value_type must be single-byte elements");
+static_assert(std::is_same<std::size_t, small_buffer::size_type>::value, "small_buffer::size_type must be std::size_t");
+static_assert(std::is_constructible<small_buffer, ptr<const char>, ptr<const char>>::value,
+              "small_buffer must be constructible with two pointers"
+             );
+static_assert(std::is_nothrow_move_constructible<small_buffer>::value, "small_buffer must be move-constructible");
+
+static small_buffer small_buffer_from(const std::string& src)
+{
+    return small_buffer(src.data(), src.data() + src.size());
+}
+
+static std::string string_of(const small_buffer& src)
+{
+    return std::string(src.begin(), src.end());
+}
+
+GTEST_TEST(small_buffer_tests, inline_until_full)
+{
+    small_buffer buf;
+    CHECK_TRUE(buf.empty());
+    CHECK_TRUE(buf.is_inline());
+    CHECK_EQ(small_buffer::inline_capacity, buf.capacity());
+
+    for (std::size_t idx = 0U; idx < small_buffer::inline_capacity; ++idx)
+        buf.push_back(char('a' + idx % 26U));
+    CHECK_TRUE(buf.is_inline());
+
+    buf.push_back('!');
+    CHECK_FALSE(buf.is_inline());
+    CHECK_EQ(small_buffer::inline_capacity + 1U, buf.size());
+    CHECK_EQ('a', buf.front());
+    CHECK_EQ('!', buf.back());
+
+    buf.resize(3U);
+    buf.shrink_to_fit();
+    CHECK_TRUE(buf.is_inline());
+    CHECK_EQ("abc", string_of(buf));
+}
+
+GTEST_TEST(small_buffer_tests, copy_and_move)
+{
+    const std::string short_text = "leader-7";
+    const std::string long_text(200U, 'L');
+
+    for (const auto& text : { short_text, long_text })
+    {
+        auto original = small_buffer_from(text);
+        CHECK_EQ(text.size() <= small_buffer::inline_capacity, original.is_inline());
+
+        small_buffer copied(original);
+        CHECK_TRUE(copied == original);
+        CHECK_NE(copied.data(), original.data());
+
+        auto heap_data = original.data();
+        small_buffer moved(std::move(original));
+        CHECK_EQ(text, string_of(moved));
+        CHECK_TRUE(original.empty());
+        CHECK_TRUE(original.is_inline());
+        // Heap storage is handed over; inline contents have to be copied
+        CHECK_EQ(!moved.is_inline(), moved.data() == heap_data);
+
+        small_buffer assigned = small_buffer_from("x");
+        assigned = std::move(moved);
+        CHECK_EQ(text, string_of(assigned));
+        assigned = copied;
+        CHECK_EQ(text, string_of(assigned));
+        assigned = assigned;
+        CHECK_EQ(text, string_of(assigned));
+    }
+
+    auto a = small_buffer_from(short_text);
+    auto b = small_buffer_from(long_text);
+    swap(a, b);
+    CHECK_EQ(long_text, string_of(a));
+    CHECK_EQ(short_text, string_of(b));
+}
+
+GTEST_TEST(small_buffer_tests, vector_like_edits)
+{
+    small_buffer buf(3U, 'z');
+    CHECK_EQ("zzz", string_of(buf));
+
+    buf.assign(5U, 'q');
+    CHECK_EQ("qqqqq", string_of(buf));
+
+    const std::string middle = "-middle-";
+    buf.insert(buf.begin() + 2, middle.begin(), middle.end());
+    CHECK_EQ("qq-middle-qqq", string_of(buf));
+
+    buf.erase(buf.begin(), buf.begin() + 3);
+    CHECK_EQ("middle-qqq", string_of(buf));
+
+    // Inserting a piece of the buffer into itself, across the move to the heap
+    buf.insert(buf.end(), buf.begin(), buf.end());
+    buf.insert(buf.end(), buf.begin(), buf.end());
+    buf.insert(buf.end(), buf.begin(), buf.end());
+    CHECK_EQ(80U, buf.size());
+    CHECK_FALSE(buf.is_inline());
+    CHECK_EQ("middle-qqqmiddle-qqq", string_of(buf).substr(0U, 20U));
+
+    buf.insert(buf.begin(), 2U, '>');
+    buf.insert(buf.begin() + 2, ' ');
+    CHECK_EQ(">> middle", string_of(buf).substr(0U, 9U));
+
+    // Single-pass input
+    std::istringstream stream("from a stream");
+    small_buffer streamed((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    CHECK_EQ("from a stream", string_of(streamed));
+
+    small_buffer listed = { 'a', 'b' };
+    CHECK_TRUE(listed < small_buffer_from("b"));
+    CHECK_TRUE(small_buffer_from("ab") == listed);
+    CHECK_TRUE(small_buffer_from("abc") > listed);
+
+    listed.clear();
+    CHECK_TRUE(listed.empty());
+    listed.reserve(1000U);
+    CHECK_GE(listed.capacity(), 1000U);
+    listed.assign(ptr<const char>(middle.data()), middle.data() + middle.size());
+    CHECK_EQ(middle, string_of(listed));
+}
+
+}
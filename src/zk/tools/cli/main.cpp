@@ -0,0 +1,134 @@
+#include <zk/client.hpp>
+#include <zk/tools/tree_archive.hpp>
+#include <zk/tools/tree_sync.hpp>
+
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "options.hpp"
+
+namespace zk::tools::cli
+{
+
+static int run_export(const options& settings)
+{
+    auto          conn = client::connect(settings.source).get();
+    std::ofstream file(settings.file, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Could not open " + settings.file + " for writing");
+
+    tree_writer    out(file);
+    export_options opts;
+    opts.max_in_flight() = settings.max_in_flight;
+    auto written = export_tree(conn, zk::path(settings.root), out, opts).get();
+
+    file.close();
+    if (!file)
+        throw std::runtime_error("Failed to finish writing " + settings.file);
+    std::cerr << "Exported " << written << " entries from " << settings.root << " to " << settings.file << std::endl;
+    return 0;
+}
+
+static int run_import(const options& settings)
+{
+    auto        conn = client::connect(settings.source).get();
+    tree_reader in(settings.file);
+
+    import_options opts;
+    opts.max_batch_size() = settings.max_batch_size;
+    auto created = import_tree(conn, zk::path(settings.root), in, opts).get();
+    std::cerr << "Imported " << created << " entries from " << settings.file << " to " << settings.root << std::endl;
+    return 0;
+}
+
+static int run_sync(const options& settings)
+{
+    auto source = client::connect(settings.source).get();
+    auto target = settings.target == settings.source ? source : client::connect(settings.target).get();
+
+    tree_baseline baseline;
+    if (!settings.baseline_file.empty())
+    {
+        tree_reader in(settings.baseline_file);
+        baseline = tree_baseline::from_archive(in);
+    }
+
+    diff_options diff_opts;
+    diff_opts.max_in_flight() = settings.max_in_flight;
+    import_options apply_opts;
+    apply_opts.max_batch_size() = settings.max_batch_size;
+
+    while (true)
+    {
+        auto started = std::chrono::steady_clock::now();
+        auto diff    = settings.action == command::diff
+                     ? diff_trees(source, zk::path(settings.root), target, zk::path(settings.target_root), baseline,
+                                  diff_opts
+                                 ).get()
+                     : sync_tree(source, zk::path(settings.root), target, zk::path(settings.target_root), baseline,
+                                 diff_opts, apply_opts
+                                ).get();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+
+        for (const auto& edit : diff.edits())
+            std::cout << edit << '\n';
+        std::cout.flush();
+        std::cerr << (settings.action == command::diff ? "Found " : "Applied ") << diff.edits().size() << " edits over "
+                  << diff.baseline().size() << " entries in " << elapsed.count() << "s" << std::endl;
+
+        if (settings.interval.count() == 0)
+            return 0;
+        baseline = std::move(diff).baseline();
+        std::this_thread::sleep_for(settings.interval);
+    }
+}
+
+static int run(const options& settings)
+{
+    switch (settings.action)
+    {
+    case command::export_tree: return run_export(settings);
+    case command::import_tree: return run_import(settings);
+    default:                   return run_sync(settings);
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        if (std::string(argv[idx]) == "--help" || std::string(argv[idx]) == "-h")
+        {
+            std::cout << zk::tools::cli::usage(argv[0]);
+            return 0;
+        }
+    }
+
+    zk::tools::cli::options settings;
+    try
+    {
+        settings = zk::tools::cli::parse_options(argc, argv);
+    }
+    catch (const std::invalid_argument& ex)
+    {
+        std::cerr << ex.what() << "\n\n" << zk::tools::cli::usage(argv[0]);
+        return 2;
+    }
+
+    try
+    {
+        return zk::tools::cli::run(settings);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << zk::tools::cli::to_string(settings.action) << " failed: " << ex.what() << std::endl;
+        return 1;
+    }
+}
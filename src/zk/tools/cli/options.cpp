@@ -0,0 +1,153 @@
+#include "options.hpp"
+
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace zk::tools::cli
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// command                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const command& self)
+{
+    switch (self)
+    {
+    case command::export_tree: return os << "export";
+    case command::import_tree: return os << "import";
+    case command::diff:        return os << "diff";
+    case command::sync:        return os << "sync";
+    default:                   return os << "command(" << static_cast<int>(self) << ')';
+    }
+}
+
+std::string to_string(const command& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// options                                                                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static std::size_t parse_count(const std::string& name, const std::string& value, std::size_t minimum)
+{
+    std::size_t        used = 0U;
+    unsigned long long out  = 0U;
+    try
+    {
+        out = std::stoull(value, &used);
+    }
+    catch (const std::exception&)
+    {
+        used = 0U;
+    }
+
+    if (used == 0U || used != value.size() || value[0] == '-')
+        throw std::invalid_argument("--" + name + " must be a number (got \"" + value + "\")");
+    if (out < minimum)
+        throw std::invalid_argument("--" + name + " must be at least " + std::to_string(minimum));
+    return std::size_t(out);
+}
+
+static void check_absolute(const std::string& name, const std::string& value)
+{
+    if (value.empty() || value[0] != '/')
+        throw std::invalid_argument("--" + name + " must be an absolute path (got \"" + value + "\")");
+}
+
+options parse_options(int argc, char** argv)
+{
+    if (argc < 2)
+        throw std::invalid_argument("Missing the command");
+
+    options     out;
+    std::string action = argv[1];
+    if (action == "export")
+        out.action = command::export_tree;
+    else if (action == "import")
+        out.action = command::import_tree;
+    else if (action == "diff")
+        out.action = command::diff;
+    else if (action == "sync")
+        out.action = command::sync;
+    else
+        throw std::invalid_argument("Unknown command \"" + action + "\"");
+
+    for (int idx = 2; idx < argc; ++idx)
+    {
+        std::string arg = argv[idx];
+        auto        eq  = arg.find('=');
+        if (arg.compare(0, 2U, "--") != 0 || eq == std::string::npos)
+            throw std::invalid_argument("Options look like --name=value (got \"" + arg + "\")");
+
+        auto name  = arg.substr(2U, eq - 2U);
+        auto value = arg.substr(eq + 1U);
+        if (name == "source" || name == "connect")
+            out.source = value;
+        else if (name == "target")
+            out.target = value;
+        else if (name == "root")
+            out.root = value;
+        else if (name == "target-root")
+            out.target_root = value;
+        else if (name == "file")
+            out.file = value;
+        else if (name == "baseline")
+            out.baseline_file = value;
+        else if (name == "interval")
+            out.interval = std::chrono::seconds(parse_count(name, value, 0U));
+        else if (name == "in-flight")
+            out.max_in_flight = parse_count(name, value, 1U);
+        else if (name == "batch-size")
+            out.max_batch_size = parse_count(name, value, 1U);
+        else
+            throw std::invalid_argument("Unknown option --" + name);
+    }
+
+    check_absolute("root", out.root);
+    if (out.target_root.empty())
+        out.target_root = out.root;
+    check_absolute("target-root", out.target_root);
+    if (out.target.empty())
+        out.target = out.source;
+
+    bool uses_file = out.action == command::export_tree || out.action == command::import_tree;
+    if (uses_file && out.file.empty())
+        throw std::invalid_argument(to_string(out.action) + " needs an archive --file");
+    if (!uses_file && out.target == out.source && out.target_root == out.root)
+        throw std::invalid_argument(to_string(out.action) + " of a tree onto itself needs a --target or --target-root");
+    if (out.interval.count() > 0 && out.action != command::sync)
+        throw std::invalid_argument("--interval only applies to sync");
+    return out;
+}
+
+std::string usage(const std::string& program_name)
+{
+    std::ostringstream os;
+    os << "Usage: " << program_name << " export|import|diff|sync [--name=value]...\n"
+       << "\n"
+       << "Copies ZooKeeper subtrees between ensembles and archive files.\n"
+       << "\n"
+       << "  export               Write the tree under --root on --source to the archive --file\n"
+       << "  import               Create the entries of the archive --file under --root on --source\n"
+       << "  diff                 Print the edits which would make --target-root on --target match --root on --source\n"
+       << "  sync                 Apply those edits, once or every --interval seconds\n"
+       << "\n"
+       << "  --source=STRING      Connection string of the ensemble to read from (default zk://127.0.0.1:2181)\n"
+       << "  --target=STRING      Connection string of the ensemble to write to (default: --source)\n"
+       << "  --root=PATH          Root of the tree on the source (default /)\n"
+       << "  --target-root=PATH   Root of the copy on the target (default: --root)\n"
+       << "  --file=PATH          Archive to export to or import from\n"
+       << "  --baseline=PATH      Archive of an earlier export of the source to prune the first diff with\n"
+       << "  --interval=SECONDS   Keep syncing, this long after each sync finishes (default 0: sync once)\n"
+       << "  --in-flight=N        Entries read at once (default 256)\n"
+       << "  --batch-size=N       Entries or edits per transaction (default 256)\n";
+    return os.str();
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+namespace zk::tools::cli
+{
+
+/// What the program was asked to do.
+enum class command : int
+{
+    export_tree, //!< Write a subtree to an archive file.
+    import_tree, //!< Create the entries of an archive file under a path.
+    diff,        //!< Print what a sync would change, without changing it.
+    sync,        //!< Bring a copy of a subtree up to date with its source.
+};
+
+std::ostream& operator<<(std::ostream&, const command&);
+
+std::string to_string(const command&);
+
+/// Everything that describes a run. Only the settings of the chosen \ref command are used.
+struct options final
+{
+    command action = command::sync;
+
+    /// The ensemble the tree is read from (when exporting, diffing or syncing) or written to (when importing).
+    std::string source = "zk://127.0.0.1:2181";
+
+    /// The ensemble a diff or sync writes to. When empty, it is the \ref source, which is how a subtree is copied
+    /// within an ensemble.
+    std::string target;
+
+    /// The root of the tree on the \ref source.
+    std::string root = "/";
+
+    /// The root of the copy on the \ref target. When empty, it is the same as \ref root.
+    std::string target_root;
+
+    /// The archive written by an export or read by an import.
+    std::string file;
+
+    /// An archive of the source tree (from an earlier export of it) to take the baseline of the first diff from. When
+    /// empty, the first diff compares every entry.
+    std::string baseline_file;
+
+    /// When not zero, a sync runs again this long after the last one finished, until the program is stopped. Every
+    /// sync after the first reuses the baseline of the one before it, so it only reads what changed.
+    std::chrono::milliseconds interval = std::chrono::milliseconds(0);
+
+    /// The most entries being read at once.
+    std::size_t max_in_flight = 256U;
+
+    /// The most entries or edits in one transaction.
+    std::size_t max_batch_size = 256U;
+};
+
+/// Parse the command line: the \ref command, then options of the form \c --name=value; see \ref usage.
+///
+/// \throws std::invalid_argument if the command or an option is unknown or a value does not make sense.
+options parse_options(int argc, char** argv);
+
+/// The help text listing the commands and options.
+std::string usage(const std::string& program_name);
+
+}
@@ -0,0 +1,515 @@
+#include "tree_archive.hpp"
+
+#include <zk/error.hpp>
+#include <zk/jute.hpp>
+#include <zk/multi.hpp>
+#include <zk/results.hpp>
+
+#include <cerrno>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zk::tools
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// tree_writer                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The size of the archive header: the magic and the version.
+static constexpr std::size_t header_size = tree_archive_magic.size() + 4U;
+
+tree_writer::tree_writer(std::ostream& out) :
+        _out(out),
+        _entries(0U)
+{
+    jute_writer header;
+    header.write_int(tree_archive_version);
+    auto version = std::move(header).finish();
+
+    _out.write(tree_archive_magic.data(), std::streamsize(tree_archive_magic.size()));
+    _out.write(version.data() + jute_length_size, std::streamsize(version.size() - jute_length_size));
+    if (!_out)
+        throw std::ios_base::failure("Failed to write the header of a tree archive");
+}
+
+void tree_writer::write(string_view relative_path, const buffer& data, const acl& rules, const zk::stat& stat)
+{
+    jute_writer record(relative_path.size() + data.size() + 128U);
+    record.write_string(relative_path);
+    record.write_buffer(data);
+    record.write_acl(rules);
+    record.write_stat(stat);
+    auto bytes = std::move(record).finish();
+
+    _out.write(bytes.data(), std::streamsize(bytes.size()));
+    if (!_out)
+        throw std::ios_base::failure("Failed to write the entry \"" + std::string(relative_path)
+                                     + "\" to a tree archive"
+                                    );
+    ++_entries;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// tree_reader                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+tree_reader::tree_reader(const std::string& filename) :
+        _first(nullptr),
+        _last(nullptr),
+        _iter(nullptr),
+        _mapping(nullptr),
+        _mapping_size(0U)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "open " + filename);
+
+    struct ::stat info;
+    if (::fstat(fd, &info) != 0)
+    {
+        auto err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::system_category(), "fstat " + filename);
+    }
+
+    // An empty file can not be mapped, but it is no archive either, which the header check reports
+    if (info.st_size > 0)
+    {
+        _mapping_size = std::size_t(info.st_size);
+        _mapping      = ::mmap(nullptr, _mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (_mapping == MAP_FAILED)
+        {
+            auto err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::system_category(), "mmap " + filename);
+        }
+        // The archive is read front to back, once
+        ::madvise(_mapping, _mapping_size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+
+    _first = static_cast<const char*>(_mapping);
+    _last  = _first + _mapping_size;
+    try
+    {
+        check_header();
+    }
+    catch (...)
+    {
+        if (_mapping)
+            ::munmap(_mapping, _mapping_size);
+        throw;
+    }
+}
+
+tree_reader::tree_reader(const char* first, const char* last) :
+        _first(first),
+        _last(last),
+        _iter(nullptr),
+        _mapping(nullptr),
+        _mapping_size(0U)
+{
+    check_header();
+}
+
+tree_reader::~tree_reader() noexcept
+{
+    if (_mapping)
+        ::munmap(_mapping, _mapping_size);
+}
+
+void tree_reader::check_header()
+{
+    bool long_enough = std::size_t(_last - _first) >= header_size;
+    if (!long_enough || string_view(_first, tree_archive_magic.size()) != tree_archive_magic)
+        throw_error(error_code::marshalling_error);
+
+    jute_reader header(_first + tree_archive_magic.size(), _first + header_size);
+    if (header.read_int() != tree_archive_version)
+        throw_error(error_code::marshalling_error);
+
+    rewind();
+}
+
+void tree_reader::rewind() noexcept
+{
+    _iter = _first + header_size;
+}
+
+bool tree_reader::next(tree_entry& out)
+{
+    if (_iter == _last)
+        return false;
+
+    jute_reader framing(_iter, _last);
+    auto length = framing.read_int();
+    if (length < 0 || std::size_t(length) > framing.remaining())
+        throw_error(error_code::marshalling_error);
+
+    auto first = _iter + jute_length_size;
+    jute_reader record(first, first + length);
+    auto path  = record.read_string();
+    auto data  = record.read_buffer();
+    auto rules = record.read_acl();
+    auto stat  = record.read_stat();
+
+    out._path  = path;
+    out._data  = data;
+    out._rules = std::move(rules);
+    out._stat  = stat;
+    _iter      = first + length;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// export_tree                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/// The state of an \ref export_tree. An entry is read with three pipelined requests; whichever of their completions
+/// comes last writes the entry and queues its children, so a child is never read (let alone written) before its
+/// parent is written. Reads are started by whichever thread gets to \c pump first, up to \c max_in_flight at a time.
+struct tree_exporter final :
+        std::enable_shared_from_this<tree_exporter>
+{
+    struct reading
+    {
+        std::string                  relative;
+        zk::path                     full;
+        int                          remaining = 3;
+        outcome<get_result>          contents  = error_code::closed;
+        outcome<get_acl_result>      rules     = error_code::closed;
+        outcome<get_children_result> children  = error_code::closed;
+    };
+
+    explicit tree_exporter(client conn, zk::path root, tree_writer& out, export_options opts,
+                           callback<std::size_t> on_complete
+                          ) :
+            conn(std::move(conn)),
+            root(std::move(root)),
+            out(out),
+            opts(std::move(opts)),
+            on_complete(std::move(on_complete))
+    {
+        pending.emplace_back();
+    }
+
+    void pump()
+    {
+        std::vector<std::shared_ptr<reading>> started;
+
+        std::unique_lock<std::mutex> ax(protect);
+        if (pumping)
+            return;
+
+        pumping = true;
+        while (status && in_flight < opts.max_in_flight() && !pending.empty())
+        {
+            auto entry      = std::make_shared<reading>();
+            entry->relative = std::move(pending.front());
+            entry->full     = entry->relative.empty() ? root : root / entry->relative;
+            pending.pop_front();
+            ++in_flight;
+            ax.unlock();
+
+            read(entry);
+            ax.lock();
+        }
+        pumping = false;
+
+        if (reported || in_flight > 0U || (status && !pending.empty()))
+            return;
+        reported    = true;
+        auto result = status ? outcome<std::size_t>(written) : outcome<std::size_t>(status.code(), status.error());
+        ax.unlock();
+
+        on_complete(std::move(result));
+    }
+
+    void read(const std::shared_ptr<reading>& entry)
+    {
+        auto self = shared_from_this();
+        conn.get(entry->full,
+                 [self, entry] (outcome<get_result> result)
+                 {
+                     entry->contents = std::move(result);
+                     self->part_done(entry);
+                 }
+                );
+        conn.get_acl(entry->full,
+                     [self, entry] (outcome<get_acl_result> result)
+                     {
+                         entry->rules = std::move(result);
+                         self->part_done(entry);
+                     }
+                    );
+        conn.get_children(entry->full,
+                          [self, entry] (outcome<get_children_result> result)
+                          {
+                              entry->children = std::move(result);
+                              self->part_done(entry);
+                          }
+                         );
+    }
+
+    void part_done(const std::shared_ptr<reading>& entry)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (--entry->remaining > 0)
+            return;
+
+        --in_flight;
+        if (status)
+            store(*entry);
+        ax.unlock();
+
+        pump();
+    }
+
+    /// Write the entry which was just read. Called with the lock held, which also keeps the writes in order.
+    void store(reading& entry)
+    {
+        bool vanished = entry.contents.code() == error_code::no_entry
+                     || entry.rules.code() == error_code::no_entry
+                     || entry.children.code() == error_code::no_entry;
+        if (vanished && !entry.relative.empty())
+            return; // erased since its parent was listed
+        else if (!entry.contents)
+            status = outcome<void>(entry.contents.code(), entry.contents.error());
+        else if (!entry.rules)
+            status = outcome<void>(entry.rules.code(), entry.rules.error());
+        else if (!entry.children)
+            status = outcome<void>(entry.children.code(), entry.children.error());
+        if (!status)
+            return;
+
+        try
+        {
+            out.write(entry.relative, entry.contents->data(), entry.rules->acl(), entry.contents->stat());
+            ++written;
+        }
+        catch (...)
+        {
+            status = outcome<void>(error_code::marshalling_error, std::current_exception());
+            return;
+        }
+
+        for (const auto& name : entry.children->children())
+        {
+            if (entry.relative.empty() && root.is_root() && name == "zookeeper")
+                continue;
+            pending.push_back(entry.relative.empty() ? name : entry.relative + '/' + name);
+        }
+    }
+
+    client                  conn;
+    zk::path                root;
+    tree_writer&            out;
+    export_options          opts;
+    callback<std::size_t>   on_complete;
+
+    std::mutex              protect;
+    std::deque<std::string> pending;       //!< Relative paths of the entries which are yet to be read
+    std::size_t             in_flight = 0U;
+    std::size_t             written   = 0U;
+    bool                    pumping   = false;
+    bool                    reported  = false;
+    outcome<void>           status;        //!< Fails with the first error, which stops the export
+};
+
+}
+
+future<std::size_t> export_tree(client conn, zk::path root, tree_writer& out, export_options opts)
+{
+    return future_from_callback<std::size_t>([&] (auto cb)
+                                             {
+                                                 export_tree(std::move(conn), std::move(root), out, std::move(cb),
+                                                             std::move(opts)
+                                                            );
+                                             }
+                                            );
+}
+
+void export_tree(client conn, zk::path root, tree_writer& out, callback<std::size_t> on_complete, export_options opts)
+{
+    std::make_shared<tree_exporter>(std::move(conn), std::move(root), out, std::move(opts), std::move(on_complete))
+        ->pump();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// import_tree                                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/// The state of an \ref import_tree. Transactions are built from the archive by whichever thread gets to \c pump first,
+/// so the archive is read (and the transactions sent) in order, and no more than \c max_in_flight are outstanding.
+struct tree_importer final :
+        std::enable_shared_from_this<tree_importer>
+{
+    /// A rough count of what an entry adds to a transaction besides its path and data: the header of the operation,
+    /// its ACL and the reply.
+    static constexpr std::size_t entry_overhead = 64U;
+
+    explicit tree_importer(client conn, zk::path target, tree_reader& in, import_options opts,
+                           callback<std::size_t> on_complete
+                          ) :
+            conn(std::move(conn)),
+            target(std::move(target)),
+            in(in),
+            opts(std::move(opts)),
+            on_complete(std::move(on_complete))
+    { }
+
+    void start()
+    {
+        auto self = shared_from_this();
+        conn.exists(target,
+                    [self] (outcome<exists_result> result)
+                    {
+                        std::unique_lock<std::mutex> ax(self->protect);
+                        if (result)
+                            self->skip_root = bool(*result);
+                        else
+                            self->status = outcome<void>(result.code(), result.error());
+                        ax.unlock();
+
+                        self->pump();
+                    }
+                   );
+    }
+
+    void pump()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (pumping)
+            return;
+
+        pumping = true;
+        while (status && !exhausted && in_flight < opts.max_in_flight())
+        {
+            multi_op txn;
+            try
+            {
+                fill(txn);
+            }
+            catch (...)
+            {
+                status = outcome<void>(error_code::marshalling_error, std::current_exception());
+                break;
+            }
+
+            if (txn.size() == 0U)
+                break;
+            ++in_flight;
+            ax.unlock();
+
+            send(std::move(txn));
+            ax.lock();
+        }
+        pumping = false;
+
+        if (reported || in_flight > 0U || (status && !exhausted))
+            return;
+        reported    = true;
+        auto result = status ? outcome<std::size_t>(imported) : outcome<std::size_t>(status.code(), status.error());
+        ax.unlock();
+
+        on_complete(std::move(result));
+    }
+
+    /// Move the next entries of the archive into \a txn. Called with the lock held, as it reads the archive.
+    void fill(multi_op& txn)
+    {
+        std::size_t bytes = 0U;
+        tree_entry  entry;
+        while (txn.size() < opts.max_batch_size() && bytes < opts.max_batch_bytes())
+        {
+            if (!in.next(entry))
+            {
+                exhausted = true;
+                return;
+            }
+
+            if (entry.stat().ephemeral_owner != 0U || (entry.path().empty() && skip_root))
+                continue;
+
+            auto full = entry.path().empty() ? target : target / entry.path();
+            bytes += full.size() + entry.data().size() + entry_overhead;
+            txn.push_back(op::create(std::move(full),
+                                     buffer(entry.data().data(), entry.data().data() + entry.data().size()),
+                                     entry.rules()
+                                    ));
+        }
+    }
+
+    void send(multi_op txn)
+    {
+        auto self  = shared_from_this();
+        auto count = txn.size();
+        conn.commit(std::move(txn),
+                    [self, count] (outcome<multi_result> result)
+                    {
+                        std::unique_lock<std::mutex> ax(self->protect);
+                        --self->in_flight;
+                        if (result)
+                            self->imported += count;
+                        else if (self->status)
+                            self->status = outcome<void>(result.code(), result.error());
+                        ax.unlock();
+
+                        self->pump();
+                    }
+                   );
+    }
+
+    client                conn;
+    zk::path              target;
+    tree_reader&          in;
+    import_options        opts;
+    callback<std::size_t> on_complete;
+
+    std::mutex            protect;
+    bool                  skip_root = false; //!< The target exists already, so the root entry is not created
+    std::size_t           in_flight = 0U;
+    std::size_t           imported  = 0U;
+    bool                  exhausted = false;
+    bool                  pumping   = false;
+    bool                  reported  = false;
+    outcome<void>         status;            //!< Fails with the first error, which stops the import
+};
+
+}
+
+future<std::size_t> import_tree(client conn, zk::path target, tree_reader& in, import_options opts)
+{
+    return future_from_callback<std::size_t>([&] (auto cb)
+                                             {
+                                                 import_tree(std::move(conn), std::move(target), in, std::move(cb),
+                                                             std::move(opts)
+                                                            );
+                                             }
+                                            );
+}
+
+void import_tree(client conn, zk::path target, tree_reader& in, callback<std::size_t> on_complete, import_options opts)
+{
+    std::make_shared<tree_importer>(std::move(conn), std::move(target), in, std::move(opts), std::move(on_complete))
+        ->start();
+}
+
+}
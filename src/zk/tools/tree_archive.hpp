@@ -0,0 +1,213 @@
+/// \file
+/// Defines \ref zk::tools::export_tree and \ref zk::tools::import_tree, which copy a subtree to and from an archive.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/acl.hpp>
+#include <zk/buffer.hpp>
+#include <zk/callback.hpp>
+#include <zk/client.hpp>
+#include <zk/future.hpp>
+#include <zk/path.hpp>
+#include <zk/string_view.hpp>
+#include <zk/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace zk::tools
+{
+
+/// \defgroup Tools
+/// Programs built on a \ref zk::client for moving data in and out of an ensemble.
+/// \{
+
+/// A tree archive starts with these 8 bytes, followed by the 4 byte \ref tree_archive_version.
+constexpr string_view tree_archive_magic = "zkpptree";
+
+/// The version of the archive layout written by \ref tree_writer.
+constexpr std::int32_t tree_archive_version = 1;
+
+/// One entry read from a tree archive. Its \ref path and \ref data point into the archive, so they are only valid as
+/// long as the \ref tree_reader is.
+class tree_entry final
+{
+public:
+    tree_entry() = default;
+
+    /// The path of the entry relative to the root of the archived tree: \c "" for the root itself and, for example,
+    /// \c "a/b" for the entry \c "b" under the child \c "a" of the root.
+    string_view path() const noexcept { return _path; }
+
+    string_view data() const noexcept { return _data; }
+
+    const acl& rules() const noexcept { return _rules; }
+
+    /// The \ref stat the entry had when it was exported. Importing an entry gives it a \ref stat of its own; this one
+    /// is only kept for reference.
+    const zk::stat& stat() const noexcept { return _stat; }
+
+private:
+    friend class tree_reader;
+
+    string_view _path;
+    string_view _data;
+    acl         _rules;
+    zk::stat    _stat;
+};
+
+/// Writes a tree archive to a stream. Every entry is one length-prefixed record in the jute encoding of the ZooKeeper
+/// protocol, holding its relative path (a string), its data (a buffer), its ACL and its \ref stat. The archive holds
+/// parents before their children, so it can be imported in a single pass.
+class tree_writer final
+{
+public:
+    /// Write the header of an archive to \a out, which has to stay alive as long as the writer.
+    explicit tree_writer(std::ostream& out);
+
+    tree_writer(const tree_writer&) = delete;
+    tree_writer& operator=(const tree_writer&) = delete;
+
+    /// Append an entry. The parent of \a relative_path must have been written already.
+    ///
+    /// \throws std::ios_base::failure if the stream fails.
+    void write(string_view relative_path, const buffer& data, const acl& rules, const zk::stat& stat);
+
+    /// The number of entries written so far.
+    std::size_t entries() const noexcept { return _entries; }
+
+private:
+    std::ostream& _out;
+    std::size_t   _entries;
+};
+
+/// Reads the entries of a tree archive in place. An archive on disk is mapped into memory rather than read, so its
+/// entries are paged in as they are reached and the reader holds no more than the entry it is on, however large the
+/// archive is.
+class tree_reader final
+{
+public:
+    /// Map the archive in the file named \a filename.
+    ///
+    /// \throws std::system_error if the file can not be opened or mapped.
+    /// \throws marshalling_error if the file does not start with an archive header of a known version.
+    explicit tree_reader(const std::string& filename);
+
+    /// Read an archive held in memory from \a first to \a last, which has to stay there as long as the reader.
+    ///
+    /// \throws marshalling_error if the memory does not start with an archive header of a known version.
+    explicit tree_reader(const char* first, const char* last);
+
+    tree_reader(const tree_reader&) = delete;
+    tree_reader& operator=(const tree_reader&) = delete;
+
+    ~tree_reader() noexcept;
+
+    /// Read the next entry into \a out.
+    ///
+    /// \returns \c false once every entry has been read, leaving \a out as it was.
+    /// \throws marshalling_error if the archive ends in the middle of an entry.
+    bool next(tree_entry& out);
+
+    /// Go back to the first entry.
+    void rewind() noexcept;
+
+private:
+    void check_header();
+
+private:
+    const char* _first;
+    const char* _last;
+    const char* _iter;
+    void*       _mapping;
+    std::size_t _mapping_size;
+};
+
+/// Controls how many entries \ref export_tree reads at once.
+class export_options final
+{
+public:
+    export_options() = default;
+
+    /// The most entries being read at once. Each one costs three pipelined requests (for its data, ACL and children),
+    /// and there is no other limit on how many requests are sent without waiting for replies.
+    std::size_t  max_in_flight() const { return _max_in_flight; }
+    std::size_t& max_in_flight()       { return _max_in_flight; }
+
+private:
+    std::size_t _max_in_flight = 256U;
+};
+
+/// \{
+/// Write the subtree under \a root (the entry itself included) to \a out. Entries are read breadth-first, with up to
+/// \ref export_options::max_in_flight of them being read at once, and each one is written once its data, ACL and
+/// children are in. This completes with the number of entries written; \a out must stay alive until it does.
+///
+/// The export is not a snapshot: entries which change while it runs are written as they were when they were read, and
+/// entries which are erased before they are reached are left out. The \c "/zookeeper" subtree belongs to the server
+/// and is never exported.
+///
+/// \throws no_entry if \a root does not exist.
+/// \throws marshalling_error if \a out fails, with the \c std::ios_base::failure as the cause.
+future<std::size_t> export_tree(client conn, zk::path root, tree_writer& out, export_options opts = export_options());
+void export_tree(client                conn,
+                 zk::path              root,
+                 tree_writer&          out,
+                 callback<std::size_t> on_complete,
+                 export_options        opts = export_options()
+                );
+/// \}
+
+/// Controls how \ref import_tree groups entries into transactions.
+class import_options final
+{
+public:
+    import_options() = default;
+
+    /// The most entries created by one transaction.
+    std::size_t  max_batch_size() const { return _max_batch_size; }
+    std::size_t& max_batch_size()       { return _max_batch_size; }
+
+    /// The size (of paths and data) past which no more entries are added to a transaction. This keeps transactions well
+    /// under the server's default \c jute.maxbuffer of 1 MiB; an entry larger than this still gets a transaction of its
+    /// own.
+    std::size_t  max_batch_bytes() const { return _max_batch_bytes; }
+    std::size_t& max_batch_bytes()       { return _max_batch_bytes; }
+
+    /// The most transactions sent without waiting for their replies. Together with the limits on a transaction, this
+    /// bounds the memory an import uses.
+    std::size_t  max_in_flight() const { return _max_in_flight; }
+    std::size_t& max_in_flight()       { return _max_in_flight; }
+
+private:
+    std::size_t _max_batch_size  = 256U;
+    std::size_t _max_batch_bytes = 512U * 1024U;
+    std::size_t _max_in_flight   = 4U;
+};
+
+/// \{
+/// Create every entry of the archive read by \a in under \a target, which takes the place of the root of the archived
+/// tree. Entries are created with \ref multi_op transactions in archive order, so parents are created before their
+/// children; the transactions are pipelined, as the server applies them in the order they were sent. This completes
+/// with the number of entries created; \a in must stay alive until it does.
+///
+/// If \a target already exists, it is left as it is and only what is under it is imported. Entries which were
+/// ephemeral when they were exported are skipped, since their sessions are not around to own them.
+///
+/// The import is not atomic: if a transaction fails (with a \ref transaction_failed, for example because one of its
+/// entries is already there), the transactions before it stay applied, no more are sent and this completes with the
+/// error.
+future<std::size_t> import_tree(client conn, zk::path target, tree_reader& in, import_options opts = import_options());
+void import_tree(client                conn,
+                 zk::path              target,
+                 tree_reader&          in,
+                 callback<std::size_t> on_complete,
+                 import_options        opts = import_options()
+                );
+/// \}
+
+/// \}
+
+}
@@ -0,0 +1,166 @@
+#include <zk/server/server_tests.hpp>
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/tests/test.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+#include "tree_archive.hpp"
+
+namespace zk::tools
+{
+
+static buffer buffer_from(const std::string& text)
+{
+    return buffer(text.data(), text.data() + text.size());
+}
+
+static stat stat_with_owner(std::uint64_t ephemeral_owner)
+{
+    stat out{};
+    out.data_version    = version(2);
+    out.ephemeral_owner = ephemeral_owner;
+    return out;
+}
+
+static void write_sample(std::ostream& os)
+{
+    tree_writer out(os);
+    out.write("", buffer_from("root"), acls::open_unsafe(), stat_with_owner(0U));
+    out.write("a", buffer(), acls::read_unsafe(), stat_with_owner(0U));
+    out.write("a/b", buffer_from("leaf"), acls::open_unsafe(), stat_with_owner(7U));
+    CHECK_EQ(3U, out.entries());
+}
+
+static std::string sample_archive()
+{
+    std::ostringstream os;
+    write_sample(os);
+    return os.str();
+}
+
+GTEST_TEST(tree_archive_tests, round_trip)
+{
+    auto archive = sample_archive();
+    CHECK_EQ(tree_archive_magic, string_view(archive.data(), tree_archive_magic.size()));
+
+    tree_reader in(archive.data(), archive.data() + archive.size());
+    tree_entry  entry;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        CHECK_TRUE(in.next(entry));
+        CHECK_EQ("", entry.path());
+        CHECK_EQ("root", entry.data());
+        CHECK_TRUE(acls::open_unsafe() == entry.rules());
+
+        CHECK_TRUE(in.next(entry));
+        CHECK_EQ("a", entry.path());
+        CHECK_TRUE(entry.data().empty());
+        CHECK_TRUE(acls::read_unsafe() == entry.rules());
+
+        CHECK_TRUE(in.next(entry));
+        CHECK_EQ("a/b", entry.path());
+        CHECK_EQ("leaf", entry.data());
+        CHECK_EQ(7U, entry.stat().ephemeral_owner);
+        CHECK_EQ(version(2), entry.stat().data_version);
+
+        CHECK_FALSE(in.next(entry));
+        CHECK_EQ("a/b", entry.path());
+        in.rewind();
+    }
+}
+
+GTEST_TEST(tree_archive_tests, rejects_bad_input)
+{
+    auto archive = sample_archive();
+
+    std::string unknown_version = archive;
+    unknown_version[tree_archive_magic.size() + 3U] = '\x09';
+    std::string wrong_magic = "zkppjunk" + archive.substr(tree_archive_magic.size());
+    for (const auto& bad : { std::string(), wrong_magic, unknown_version, archive.substr(0U, 10U) })
+    {
+        CHECK_THROWS(marshalling_error) { tree_reader(bad.data(), bad.data() + bad.size()); };
+    }
+
+    auto       truncated = archive.substr(0U, archive.size() - 5U);
+    tree_reader in(truncated.data(), truncated.data() + truncated.size());
+    tree_entry  entry;
+    CHECK_TRUE(in.next(entry));
+    CHECK_TRUE(in.next(entry));
+    CHECK_THROWS(marshalling_error) { in.next(entry); };
+}
+
+GTEST_TEST(tree_archive_tests, maps_files)
+{
+    char filename[] = "/tmp/zkpp-tree-archive-XXXXXX";
+    int  fd         = ::mkstemp(filename);
+    CHECK_LE(0, fd);
+    ::close(fd);
+
+    {
+        std::ofstream file(filename, std::ios::binary);
+        file << sample_archive();
+    }
+
+    {
+        tree_reader in(filename);
+        tree_entry  entry;
+        std::size_t count = 0U;
+        while (in.next(entry))
+            ++count;
+        CHECK_EQ(3U, count);
+        CHECK_EQ("a/b", entry.path());
+    }
+
+    std::remove(filename);
+    CHECK_THROWS(std::system_error) { tree_reader(std::string(filename)); };
+}
+
+class tree_archive_server_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(tree_archive_server_tests, export_then_import)
+{
+    client c = get_connected_client();
+    c.create("/export-src", buffer_from("top")).get();
+    c.create("/export-src/a", buffer_from("first")).get();
+    c.create("/export-src/a/deep", buffer()).get();
+    c.create("/export-src/b", buffer_from("second"), acls::read_unsafe()).get();
+    c.create("/export-src/gone", buffer(), create_mode::ephemeral).get();
+
+    std::ostringstream os;
+    tree_writer        out(os);
+    CHECK_EQ(5U, export_tree(c, zk::path("/export-src"), out).get());
+    CHECK_THROWS(no_entry) { export_tree(c, zk::path("/export-missing"), out).get(); };
+
+    auto archive = os.str();
+    tree_reader in(archive.data(), archive.data() + archive.size());
+    import_options opts;
+    opts.max_batch_size() = 2U;
+    CHECK_EQ(4U, import_tree(c, zk::path("/export-dst"), in, opts).get());
+
+    CHECK_TRUE(buffer_from("top") == c.get("/export-dst").get().data());
+    CHECK_TRUE(buffer_from("first") == c.get("/export-dst/a").get().data());
+    CHECK_TRUE(acls::read_unsafe() == c.get_acl("/export-dst/b").get().acl());
+    CHECK_TRUE(c.exists("/export-dst/a/deep").get());
+    CHECK_TRUE(buffer_from("second") == c.get("/export-dst/b").get().data());
+    CHECK_FALSE(c.exists("/export-dst/gone").get());
+
+    // Into an existing target, only what is under the root is created; doing it again collides with the first copy
+    c.create("/export-into", buffer_from("kept")).get();
+    in.rewind();
+    CHECK_EQ(3U, import_tree(c, zk::path("/export-into"), in).get());
+    CHECK_TRUE(buffer_from("kept") == c.get("/export-into").get().data());
+    in.rewind();
+    CHECK_THROWS(transaction_failed) { import_tree(c, zk::path("/export-into"), in).get(); };
+}
+
+}
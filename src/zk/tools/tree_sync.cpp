@@ -0,0 +1,701 @@
+#include "tree_sync.hpp"
+
+#include <zk/error.hpp>
+#include <zk/multi.hpp>
+#include <zk/results.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <utility>
+
+namespace zk::tools
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// tree_baseline                                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+tree_baseline::tree_baseline(entry_map entries) noexcept :
+        _entries(std::move(entries))
+{ }
+
+tree_baseline tree_baseline::from_archive(tree_reader& in)
+{
+    entry_map  entries;
+    tree_entry record;
+    in.rewind();
+    while (in.next(record))
+    {
+        auto relative = std::string(record.path());
+        if (!relative.empty())
+        {
+            // Parents come first in an archive, so this only misses children whose parent is not in it at all
+            auto slash  = relative.rfind('/');
+            auto name   = slash == std::string::npos ? relative : relative.substr(slash + 1U);
+            auto parent = slash == std::string::npos ? string_view() : string_view(relative).substr(0, slash);
+            auto iter   = entries.find(parent);
+            if (iter != entries.end())
+                iter->second.children.push_back(std::move(name));
+        }
+        entries[std::move(relative)].stat = record.stat();
+    }
+    return tree_baseline(std::move(entries));
+}
+
+auto tree_baseline::find(string_view relative_path) const -> const entry*
+{
+    auto iter = _entries.find(relative_path);
+    return iter == _entries.end() ? nullptr : &iter->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// tree_edit                                                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const tree_edit_type& self)
+{
+    switch (self)
+    {
+    case tree_edit_type::create: return os << "create";
+    case tree_edit_type::set:    return os << "set";
+    case tree_edit_type::erase:  return os << "erase";
+    default:                     return os << "tree_edit_type(" << static_cast<int>(self) << ')';
+    }
+}
+
+std::string to_string(const tree_edit_type& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+tree_edit::tree_edit(tree_edit_type type, std::string relative_path, buffer data, acl rules) :
+        _type(type),
+        _path(std::move(relative_path)),
+        _data(std::move(data)),
+        _rules(std::move(rules))
+{ }
+
+std::ostream& operator<<(std::ostream& os, const tree_edit& self)
+{
+    os << '{' << self.type() << " \"" << self.path() << '"';
+    if (self.type() != tree_edit_type::erase)
+        os << " data_size=" << self.data().size();
+    return os << '}';
+}
+
+std::string to_string(const tree_edit& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// tree_diff                                                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+tree_diff::tree_diff(std::vector<tree_edit> edits, tree_baseline baseline) noexcept :
+        _edits(std::move(edits)),
+        _baseline(std::move(baseline))
+{ }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// diff_trees                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+std::string child_of(const std::string& relative, const std::string& name)
+{
+    return relative.empty() ? name : relative + '/' + name;
+}
+
+std::size_t depth_of(const std::string& relative)
+{
+    return relative.empty() ? 0U : 1U + std::size_t(std::count(relative.begin(), relative.end(), '/'));
+}
+
+/// The state of a \ref diff_trees. Each entry goes through one of three visits:
+///
+/// - \c compare is for an entry in the source which should be in the target. It starts with an \c exists on the
+///   source, whose \ref stat decides (against the baseline) whether the data and the children are read from both sides.
+///   If the target turns out not to have the entry, the visit is turned into a \c copy.
+/// - \c copy is for an entry which is only in the source. Its data, ACL and children are read from the source.
+/// - \c remove is for an entry which is only in the target. Its children are listed from the target.
+///
+/// Visits are started by whichever thread gets to \c pump first, up to \c max_in_flight at a time, and the children of
+/// an entry are queued once it is done.
+struct tree_differ final :
+        std::enable_shared_from_this<tree_differ>
+{
+    enum class visit_kind
+    {
+        compare,
+        copy,
+        remove,
+    };
+
+    struct visit
+    {
+        visit_kind                   kind;
+        std::string                  relative;
+        zk::path                     source_path;
+        zk::path                     target_path;
+        int                          remaining       = 0;
+        zk::stat                     source_stat     = zk::stat();
+        const tree_baseline::entry*  base            = nullptr;
+        bool                         same_data       = false;
+        bool                         same_children   = false;
+        outcome<get_result>          source_data     = error_code::closed;
+        outcome<get_result>          target_data     = error_code::closed;
+        outcome<get_acl_result>      source_rules    = error_code::closed;
+        outcome<get_children_result> source_children = error_code::closed;
+        outcome<get_children_result> target_children = error_code::closed;
+    };
+
+    using visit_ptr = std::shared_ptr<visit>;
+
+    explicit tree_differ(client               source,
+                         zk::path             source_root,
+                         client               target,
+                         zk::path             target_root,
+                         const tree_baseline& since,
+                         diff_options         opts,
+                         callback<tree_diff>  on_complete
+                        ) :
+            source(std::move(source)),
+            source_root(std::move(source_root)),
+            target(std::move(target)),
+            target_root(std::move(target_root)),
+            since(since),
+            opts(std::move(opts)),
+            on_complete(std::move(on_complete))
+    {
+        pending.emplace_back(visit_kind::compare, std::string());
+    }
+
+    void pump()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (pumping)
+            return;
+
+        pumping = true;
+        while (status && in_flight < opts.max_in_flight() && !pending.empty())
+        {
+            auto next           = std::make_shared<visit>();
+            next->kind          = pending.front().first;
+            next->relative      = std::move(pending.front().second);
+            next->source_path   = next->relative.empty() ? source_root : source_root / next->relative;
+            next->target_path   = next->relative.empty() ? target_root : target_root / next->relative;
+            pending.pop_front();
+            ++in_flight;
+            ax.unlock();
+
+            start(next);
+            ax.lock();
+        }
+        pumping = false;
+
+        if (reported || in_flight > 0U || (status && !pending.empty()))
+            return;
+        reported = true;
+        if (!status)
+        {
+            auto failure = outcome<tree_diff>(status.code(), status.error());
+            ax.unlock();
+            on_complete(std::move(failure));
+            return;
+        }
+
+        // Erasures go first and children before their parents, then data changes, then creations with parents first
+        auto rank = [] (const tree_edit& edit)
+                    {
+                        switch (edit.type())
+                        {
+                        case tree_edit_type::erase: return std::make_pair(0, -std::ptrdiff_t(depth_of(edit.path())));
+                        case tree_edit_type::set:   return std::make_pair(1, std::ptrdiff_t(0));
+                        default:                    return std::make_pair(2, std::ptrdiff_t(depth_of(edit.path())));
+                        }
+                    };
+        std::stable_sort(edits.begin(), edits.end(),
+                         [&] (const tree_edit& lhs, const tree_edit& rhs) { return rank(lhs) < rank(rhs); }
+                        );
+        auto result = tree_diff(std::move(edits), tree_baseline(std::move(seen)));
+        ax.unlock();
+
+        on_complete(std::move(result));
+    }
+
+    void start(const visit_ptr& v)
+    {
+        auto self = shared_from_this();
+        switch (v->kind)
+        {
+        case visit_kind::compare:
+            source.exists(v->source_path,
+                          [self, v] (outcome<exists_result> result) { self->compare_stat(v, std::move(result)); }
+                         );
+            break;
+        case visit_kind::copy:
+            v->remaining = 3;
+            source.get(v->source_path, part(v, &visit::source_data));
+            source.get_acl(v->source_path, part(v, &visit::source_rules));
+            source.get_children(v->source_path, part(v, &visit::source_children));
+            break;
+        case visit_kind::remove:
+            v->remaining = 1;
+            target.get_children(v->target_path, part(v, &visit::target_children));
+            break;
+        }
+    }
+
+    /// A callback which stores the result in \a field of \a v and finishes the visit once it was the last one.
+    template <typename TResult>
+    callback<TResult> part(const visit_ptr& v, outcome<TResult> visit::* field)
+    {
+        auto self = shared_from_this();
+        return [self, v, field] (outcome<TResult> result)
+               {
+                   std::unique_lock<std::mutex> ax(self->protect);
+                   (*v).*field = std::move(result);
+                   if (--v->remaining > 0)
+                       return;
+
+                   if (self->status)
+                       self->finish(*v);
+                   --self->in_flight;
+                   ax.unlock();
+
+                   self->pump();
+               };
+    }
+
+    /// The first step of a \c compare: decide what has to be read.
+    void compare_stat(const visit_ptr& v, outcome<exists_result> result)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (!result)
+            fail(result.code(), result.error());
+        else if (!*result || result->stat()->ephemeral_owner != 0U)
+            vanished(*v);
+        else
+        {
+            v->source_stat = *result->stat();
+            v->base        = since.find(v->relative);
+            if (v->base)
+            {
+                v->same_data     = v->base->stat.modified_transaction == v->source_stat.modified_transaction;
+                v->same_children = v->base->stat.child_modified_transaction
+                                       == v->source_stat.child_modified_transaction;
+            }
+            v->remaining = (v->same_data ? 0 : 2) + (v->same_children ? 0 : 2);
+            if (v->remaining == 0)
+                finish(*v);
+        }
+
+        if (!status || v->remaining == 0)
+        {
+            --in_flight;
+            ax.unlock();
+            pump();
+            return;
+        }
+        ax.unlock();
+
+        if (!v->same_data)
+        {
+            source.get(v->source_path, part(v, &visit::source_data));
+            target.get(v->target_path, part(v, &visit::target_data));
+        }
+        if (!v->same_children)
+        {
+            source.get_children(v->source_path, part(v, &visit::source_children));
+            target.get_children(v->target_path, part(v, &visit::target_children));
+        }
+    }
+
+    /// Finish a visit whose reads are all in. Called with the lock held.
+    void finish(visit& v)
+    {
+        switch (v.kind)
+        {
+        case visit_kind::compare: return finish_compare(v);
+        case visit_kind::copy:    return finish_copy(v);
+        case visit_kind::remove:  return finish_remove(v);
+        }
+    }
+
+    void finish_compare(visit& v)
+    {
+        bool source_gone = v.source_data.code() == error_code::no_entry
+                        || v.source_children.code() == error_code::no_entry;
+        bool target_gone = v.target_data.code() == error_code::no_entry
+                        || v.target_children.code() == error_code::no_entry;
+        if (source_gone)
+            return vanished(v);
+        else if (target_gone)
+            return queue(visit_kind::copy, v.relative);
+        else if (!v.same_data && (!check(v.source_data) || !check(v.target_data)))
+            return;
+        else if (!v.same_children && (!check(v.source_children) || !check(v.target_children)))
+            return;
+
+        if (!v.same_data && v.source_data->data() != v.target_data->data())
+            edits.emplace_back(tree_edit_type::set, v.relative, v.source_data->data());
+
+        auto& remembered = seen[v.relative];
+        remembered.stat  = v.source_stat;
+        if (v.same_children)
+        {
+            remembered.children = v.base->children;
+            for (const auto& name : remembered.children)
+                queue(visit_kind::compare, child_of(v.relative, name));
+            return;
+        }
+
+        auto in_source = listed(*v.source_children, v.relative, source_root);
+        auto in_target = listed(*v.target_children, v.relative, target_root);
+        std::set_difference(in_target.begin(), in_target.end(), in_source.begin(), in_source.end(),
+                            make_queuer(visit_kind::remove, v.relative)
+                           );
+        std::set_difference(in_source.begin(), in_source.end(), in_target.begin(), in_target.end(),
+                            make_queuer(visit_kind::copy, v.relative)
+                           );
+        std::set_intersection(in_source.begin(), in_source.end(), in_target.begin(), in_target.end(),
+                              make_queuer(visit_kind::compare, v.relative)
+                             );
+        remembered.children = std::move(in_source);
+    }
+
+    void finish_copy(visit& v)
+    {
+        for (error_code code : { v.source_data.code(), v.source_rules.code(), v.source_children.code() })
+            if (code == error_code::no_entry)
+                return vanished(v);
+        if (!check(v.source_data) || !check(v.source_rules) || !check(v.source_children))
+            return;
+        if (v.source_data->stat().ephemeral_owner != 0U)
+            return;
+
+        edits.emplace_back(tree_edit_type::create, v.relative, v.source_data->data(), v.source_rules->acl());
+
+        auto& remembered    = seen[v.relative];
+        remembered.stat     = v.source_data->stat();
+        remembered.children = listed(*v.source_children, v.relative, source_root);
+        for (const auto& name : remembered.children)
+            queue(visit_kind::copy, child_of(v.relative, name));
+    }
+
+    void finish_remove(visit& v)
+    {
+        if (v.target_children.code() == error_code::no_entry)
+            return;
+        else if (!check(v.target_children))
+            return;
+
+        edits.emplace_back(tree_edit_type::erase, v.relative);
+        for (const auto& name : listed(*v.target_children, v.relative, target_root))
+            queue(visit_kind::remove, child_of(v.relative, name));
+    }
+
+    /// The children of the entry at \a relative under \a root which are part of the diff, in sorted order.
+    static std::vector<std::string> listed(const get_children_result& result,
+                                           const std::string&         relative,
+                                           const zk::path&            root
+                                          )
+    {
+        std::vector<std::string> out;
+        out.reserve(result.children().size());
+        for (const auto& name : result.children())
+            if (!(relative.empty() && root.is_root() && name == "zookeeper"))
+                out.emplace_back(name);
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    /// Check a result, failing the diff if it is an error. Called with the lock held.
+    template <typename T>
+    bool check(const outcome<T>& result)
+    {
+        if (!result)
+            fail(result.code(), result.error());
+        return status.has_value();
+    }
+
+    /// The entry was erased from the source (or is ephemeral) since its parent was listed, so it is left out. The root
+    /// is another matter. Called with the lock held.
+    void vanished(const visit& v)
+    {
+        if (v.relative.empty())
+            fail(error_code::no_entry, nullptr);
+    }
+
+    void fail(error_code code, std::exception_ptr cause)
+    {
+        if (status)
+            status = outcome<void>(code, std::move(cause));
+    }
+
+    void queue(visit_kind kind, std::string relative)
+    {
+        pending.emplace_back(kind, std::move(relative));
+    }
+
+    /// An output iterator for the \c std::set_ algorithms which queues a visit of each name under \a relative.
+    struct queuer
+    {
+        using iterator_category = std::output_iterator_tag;
+        using value_type        = void;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = void;
+
+        tree_differ*       owner;
+        visit_kind         kind;
+        const std::string* relative;
+
+        queuer& operator*()     { return *this; }
+        queuer& operator++()    { return *this; }
+        queuer  operator++(int) { return *this; }
+
+        queuer& operator=(const std::string& name)
+        {
+            owner->queue(kind, child_of(*relative, name));
+            return *this;
+        }
+    };
+
+    queuer make_queuer(visit_kind kind, const std::string& relative)
+    {
+        return queuer{ this, kind, &relative };
+    }
+
+    client               source;
+    zk::path             source_root;
+    client               target;
+    zk::path             target_root;
+    const tree_baseline& since;
+    diff_options         opts;
+    callback<tree_diff>  on_complete;
+
+    std::mutex                                     protect;
+    std::deque<std::pair<visit_kind, std::string>> pending;
+    std::size_t                                    in_flight = 0U;
+    bool                                           pumping   = false;
+    bool                                           reported  = false;
+    std::vector<tree_edit>                         edits;
+    tree_baseline::entry_map                       seen;    //!< The baseline for the next diff
+    outcome<void>                                  status;  //!< Fails with the first error, which stops the diff
+};
+
+}
+
+future<tree_diff> diff_trees(client               source,
+                             zk::path             source_root,
+                             client               target,
+                             zk::path             target_root,
+                             const tree_baseline& since,
+                             diff_options         opts
+                            )
+{
+    return future_from_callback<tree_diff>([&] (auto cb)
+                                           {
+                                               diff_trees(std::move(source), std::move(source_root),
+                                                          std::move(target), std::move(target_root),
+                                                          since, std::move(cb), std::move(opts)
+                                                         );
+                                           }
+                                          );
+}
+
+void diff_trees(client               source,
+                zk::path             source_root,
+                client               target,
+                zk::path             target_root,
+                const tree_baseline& since,
+                callback<tree_diff>  on_complete,
+                diff_options         opts
+               )
+{
+    std::make_shared<tree_differ>(std::move(source), std::move(source_root), std::move(target), std::move(target_root),
+                                  since, std::move(opts), std::move(on_complete)
+                                 )
+        ->pump();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// apply_diff                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/// The state of an \ref apply_diff. It batches the edits the way \c tree_importer batches the entries of an archive.
+struct tree_diff_applier final :
+        std::enable_shared_from_this<tree_diff_applier>
+{
+    /// Like \c tree_importer::entry_overhead, a rough count of what an edit adds to a transaction besides its path and
+    /// data.
+    static constexpr std::size_t edit_overhead = 64U;
+
+    explicit tree_diff_applier(client                        target,
+                               zk::path                      target_root,
+                               const std::vector<tree_edit>& edits,
+                               import_options                opts,
+                               callback<std::size_t>         on_complete
+                              ) :
+            target(std::move(target)),
+            target_root(std::move(target_root)),
+            edits(edits),
+            opts(std::move(opts)),
+            on_complete(std::move(on_complete))
+    { }
+
+    void pump()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (pumping)
+            return;
+
+        pumping = true;
+        while (status && next < edits.size() && in_flight < opts.max_in_flight())
+        {
+            multi_op    txn;
+            std::size_t bytes = 0U;
+            while (next < edits.size() && txn.size() < opts.max_batch_size() && bytes < opts.max_batch_bytes())
+            {
+                const auto& edit = edits[next++];
+                auto        full = edit.path().empty() ? target_root : target_root / edit.path();
+                bytes += full.size() + edit.data().size() + edit_overhead;
+                if (edit.type() == tree_edit_type::create)
+                    txn.push_back(op::create(std::move(full), edit.data(), edit.rules()));
+                else if (edit.type() == tree_edit_type::set)
+                    txn.push_back(op::set(std::move(full), edit.data()));
+                else
+                    txn.push_back(op::erase(std::move(full)));
+            }
+            ++in_flight;
+            ax.unlock();
+
+            send(std::move(txn));
+            ax.lock();
+        }
+        pumping = false;
+
+        if (reported || in_flight > 0U || (status && next < edits.size()))
+            return;
+        reported    = true;
+        auto result = status ? outcome<std::size_t>(applied) : outcome<std::size_t>(status.code(), status.error());
+        ax.unlock();
+
+        on_complete(std::move(result));
+    }
+
+    void send(multi_op txn)
+    {
+        auto self  = shared_from_this();
+        auto count = txn.size();
+        target.commit(std::move(txn),
+                      [self, count] (outcome<multi_result> result)
+                      {
+                          std::unique_lock<std::mutex> ax(self->protect);
+                          --self->in_flight;
+                          if (result)
+                              self->applied += count;
+                          else if (self->status)
+                              self->status = outcome<void>(result.code(), result.error());
+                          ax.unlock();
+
+                          self->pump();
+                      }
+                     );
+    }
+
+    client                        target;
+    zk::path                      target_root;
+    const std::vector<tree_edit>& edits;
+    import_options                opts;
+    callback<std::size_t>         on_complete;
+
+    std::mutex                    protect;
+    std::size_t                   next      = 0U;
+    std::size_t                   in_flight = 0U;
+    std::size_t                   applied   = 0U;
+    bool                          pumping   = false;
+    bool                          reported  = false;
+    outcome<void>                 status;
+};
+
+}
+
+future<std::size_t> apply_diff(client target, zk::path target_root, const tree_diff& diff, import_options opts)
+{
+    return future_from_callback<std::size_t>([&] (auto cb)
+                                             {
+                                                 apply_diff(std::move(target), std::move(target_root), diff,
+                                                            std::move(cb), std::move(opts)
+                                                           );
+                                             }
+                                            );
+}
+
+void apply_diff(client                target,
+                zk::path              target_root,
+                const tree_diff&      diff,
+                callback<std::size_t> on_complete,
+                import_options        opts
+               )
+{
+    std::make_shared<tree_diff_applier>(std::move(target), std::move(target_root), diff.edits(), std::move(opts),
+                                        std::move(on_complete)
+                                       )
+        ->pump();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// sync_tree                                                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+future<tree_diff> sync_tree(client               source,
+                            zk::path             source_root,
+                            client               target,
+                            zk::path             target_root,
+                            const tree_baseline& since,
+                            diff_options         diff_opts,
+                            import_options       apply_opts
+                           )
+{
+    return future_from_callback<tree_diff>([&] (callback<tree_diff> on_complete)
+    {
+        diff_trees(std::move(source), std::move(source_root), target, target_root, since,
+                   [target, target_root, apply_opts, on_complete] (outcome<tree_diff> diffed) mutable
+                   {
+                       if (!diffed)
+                           return on_complete(std::move(diffed));
+
+                       auto diff = std::make_shared<tree_diff>(std::move(*diffed));
+                       apply_diff(std::move(target), std::move(target_root), *diff,
+                                  [diff, on_complete] (outcome<std::size_t> applied)
+                                  {
+                                      if (applied)
+                                          on_complete(std::move(*diff));
+                                      else
+                                          on_complete(outcome<tree_diff>(applied.code(), applied.error()));
+                                  },
+                                  std::move(apply_opts)
+                                 );
+                   },
+                   std::move(diff_opts)
+                  );
+    });
+}
+
+}
@@ -0,0 +1,237 @@
+/// \file
+/// Defines \ref zk::tools::diff_trees and \ref zk::tools::sync_tree, which bring a copy of a subtree up to date with
+/// its source by applying only what changed.
+#pragma once
+
+#include <zk/config.hpp>
+#include <zk/acl.hpp>
+#include <zk/buffer.hpp>
+#include <zk/callback.hpp>
+#include <zk/client.hpp>
+#include <zk/future.hpp>
+#include <zk/path.hpp>
+#include <zk/string_view.hpp>
+#include <zk/types.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "tree_archive.hpp"
+
+namespace zk::tools
+{
+
+/// \addtogroup Tools
+/// \{
+
+/// What a sync remembers about a source tree: the \ref stat and children of every entry as they were last copied. A
+/// later \ref diff_trees uses it to skip reading what has not changed since.
+///
+/// The transaction IDs in a \ref stat only mean something on the ensemble they came from, so a baseline must only be
+/// used with the source it was taken from.
+class tree_baseline final
+{
+public:
+    /// What is remembered of one entry.
+    struct entry
+    {
+        zk::stat                 stat;
+        std::vector<std::string> children;
+    };
+
+    /// Entries by their path relative to the root of the tree (\c "" for the root itself).
+    using entry_map = std::map<std::string, entry, std::less<>>;
+
+public:
+    /// An empty baseline, which makes \ref diff_trees compare everything.
+    tree_baseline() = default;
+
+    explicit tree_baseline(entry_map entries) noexcept;
+
+    /// Take the \ref stat of every entry in an archive written by \ref export_tree of the source tree. The reader is
+    /// rewound first and left at its end.
+    static tree_baseline from_archive(tree_reader& in);
+
+    /// Find the entry at \a relative_path or \c nullptr if it is not known.
+    const entry* find(string_view relative_path) const;
+
+    const entry_map& entries() const noexcept { return _entries; }
+
+    std::size_t size() const noexcept { return _entries.size(); }
+
+    bool empty() const noexcept { return _entries.empty(); }
+
+private:
+    entry_map _entries;
+};
+
+/// Describes what a \ref tree_edit does to the target tree.
+enum class tree_edit_type : int
+{
+    create, //!< Create the entry with the data and ACL of the source.
+    set,    //!< Replace the data of the entry with that of the source.
+    erase,  //!< Erase the entry, which is no longer in the source.
+};
+
+std::ostream& operator<<(std::ostream&, const tree_edit_type&);
+
+std::string to_string(const tree_edit_type&);
+
+/// One change needed to make the target tree match the source.
+class tree_edit final
+{
+public:
+    explicit tree_edit(tree_edit_type type, std::string relative_path, buffer data = buffer(), acl rules = acl());
+
+    tree_edit_type type() const noexcept { return _type; }
+
+    /// The path of the entry relative to the roots of the trees.
+    const std::string& path() const noexcept { return _path; }
+
+    /// The data of the entry in the source. This is empty for an \ref tree_edit_type::erase.
+    const buffer& data() const noexcept { return _data; }
+
+    /// The ACL of the entry in the source. This is only filled for a \ref tree_edit_type::create; the ACL of entries
+    /// which already exist in the target is left alone.
+    const acl& rules() const noexcept { return _rules; }
+
+private:
+    tree_edit_type _type;
+    std::string    _path;
+    buffer         _data;
+    acl            _rules;
+};
+
+std::ostream& operator<<(std::ostream&, const tree_edit&);
+
+std::string to_string(const tree_edit&);
+
+/// The result of \ref diff_trees: the edits which make the target match the source and the baseline to pass to the
+/// next diff once they have been applied.
+class tree_diff final
+{
+public:
+    explicit tree_diff(std::vector<tree_edit> edits, tree_baseline baseline) noexcept;
+
+    /// The edits in the order \ref apply_diff sends them: erasures (deepest first), then data changes, then creations
+    /// (parents first).
+    const std::vector<tree_edit>& edits() const noexcept { return _edits; }
+
+    /// The source tree as this diff saw it.
+    const tree_baseline& baseline() const & noexcept { return _baseline; }
+    tree_baseline        baseline() &&               { return std::move(_baseline); }
+
+    /// Are the trees the same already?
+    bool empty() const noexcept { return _edits.empty(); }
+
+private:
+    std::vector<tree_edit> _edits;
+    tree_baseline          _baseline;
+};
+
+/// Controls how many entries \ref diff_trees compares at once.
+class diff_options final
+{
+public:
+    diff_options() = default;
+
+    /// The most entries being compared at once. An entry costs up to five pipelined requests, split between the two
+    /// ensembles.
+    std::size_t  max_in_flight() const { return _max_in_flight; }
+    std::size_t& max_in_flight()       { return _max_in_flight; }
+
+private:
+    std::size_t _max_in_flight = 256U;
+};
+
+/// \{
+/// Find what it takes to make the subtree under \a target_root on \a target match the one under \a source_root on
+/// \a source. Entries are compared breadth-first, with up to \ref diff_options::max_in_flight at once, and every one
+/// starts with an \ref client::exists on the source:
+///
+/// - If its \ref stat::modified_transaction is the one in \a since, its data has not changed since that sync, so its
+///   data is not read from either side.
+/// - If its \ref stat::child_modified_transaction is the one in \a since, no child was created or erased since, so the
+///   children are not listed on either side and the ones in \a since are compared instead.
+///
+/// With an empty \a since, every entry is read on both sides. Subtrees which are only in the source are read from it
+/// for creation without looking at the target, and subtrees which are only in the target are listed for erasure
+/// without reading any data. Entries which are ephemeral in the source are not copied, and the \c "/zookeeper" subtree
+/// of an ensemble is not compared.
+///
+/// Pruning trusts that the target has not been written to other than by applying diffs, and that the diff \a since
+/// came from was applied in full. Neither tree is locked while they are compared, so a diff of trees which are being
+/// written to is only as current as the moment its entries were read; the next diff picks up the rest.
+///
+/// This completes with the diff; \a since must stay alive until it does.
+///
+/// \throws no_entry if \a source_root does not exist. If \a target_root does not exist, the whole tree is created.
+future<tree_diff> diff_trees(client               source,
+                             zk::path             source_root,
+                             client               target,
+                             zk::path             target_root,
+                             const tree_baseline& since = tree_baseline(),
+                             diff_options         opts  = diff_options()
+                            );
+void diff_trees(client               source,
+                zk::path             source_root,
+                client               target,
+                zk::path             target_root,
+                const tree_baseline& since,
+                callback<tree_diff>  on_complete,
+                diff_options         opts = diff_options()
+               );
+/// \}
+
+/// \{
+/// Apply the \ref tree_diff::edits of \a diff to the tree under \a target_root on \a target, in batched
+/// \ref multi_op transactions which are limited and pipelined like the ones of \ref import_tree. This completes with
+/// the number of edits applied; \a diff must stay alive until it does.
+///
+/// Data changes are unconditional and erasures do not look at versions, so writes to the target made since the diff
+/// was taken are overwritten. A transaction which fails stops the sync (the ones before it stay applied) and this
+/// completes with its \ref transaction_failed.
+future<std::size_t> apply_diff(client           target,
+                               zk::path         target_root,
+                               const tree_diff& diff,
+                               import_options   opts = import_options()
+                              );
+void apply_diff(client                target,
+                zk::path              target_root,
+                const tree_diff&      diff,
+                callback<std::size_t> on_complete,
+                import_options        opts = import_options()
+               );
+/// \}
+
+/// \{
+/// Bring the subtree under \a target_root on \a target up to date with the one under \a source_root on \a source: a
+/// \ref diff_trees followed by an \ref apply_diff of its edits. This completes with the diff once it has been applied,
+/// whose \ref tree_diff::baseline is the one to pass to the next sync; \a since must stay alive until it completes.
+///
+/// To keep a target in sync continuously, sync again whenever something under the source changes, for example from
+/// a \ref zk::tree_cache listener on the source or a \ref client::watch_children on its root. With the baseline of
+/// the last sync, the next one reads no more than the \ref stat of the entries which did not change.
+///
+/// \code
+/// auto diff = zk::tools::sync_tree(source, zk::path("/app"), target, zk::path("/app")).get();
+/// // later...
+/// diff = zk::tools::sync_tree(source, zk::path("/app"), target, zk::path("/app"), diff.baseline()).get();
+/// \endcode
+future<tree_diff> sync_tree(client               source,
+                            zk::path             source_root,
+                            client               target,
+                            zk::path             target_root,
+                            const tree_baseline& since = tree_baseline(),
+                            diff_options         diff_opts  = diff_options(),
+                            import_options       apply_opts = import_options()
+                           );
+/// \}
+
+/// \}
+
+}
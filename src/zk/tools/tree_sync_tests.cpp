@@ -0,0 +1,119 @@
+#include <zk/server/server_tests.hpp>
+#include <zk/client.hpp>
+#include <zk/error.hpp>
+#include <zk/tests/test.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tree_sync.hpp"
+
+namespace zk::tools
+{
+
+static buffer buffer_from(const std::string& text)
+{
+    return buffer(text.data(), text.data() + text.size());
+}
+
+static stat stat_at(std::uint64_t modified)
+{
+    stat out{};
+    out.modified_transaction       = transaction_id(modified);
+    out.child_modified_transaction = transaction_id(modified + 1U);
+    return out;
+}
+
+GTEST_TEST(tree_baseline_tests, from_archive)
+{
+    std::ostringstream os;
+    {
+        tree_writer out(os);
+        out.write("", buffer(), acls::open_unsafe(), stat_at(10U));
+        out.write("a", buffer(), acls::open_unsafe(), stat_at(20U));
+        out.write("b", buffer(), acls::open_unsafe(), stat_at(30U));
+        out.write("a/c", buffer(), acls::open_unsafe(), stat_at(40U));
+    }
+    auto archive = os.str();
+
+    tree_reader in(archive.data(), archive.data() + archive.size());
+    auto        baseline = tree_baseline::from_archive(in);
+    CHECK_EQ(4U, baseline.size());
+    CHECK_TRUE(baseline.find("x") == nullptr);
+
+    CHECK_EQ((std::vector<std::string>{ "a", "b" }), baseline.find("")->children);
+    CHECK_EQ(std::vector<std::string>{ "c" }, baseline.find("a")->children);
+    CHECK_TRUE(baseline.find("a/c")->children.empty());
+    CHECK_EQ(transaction_id(40U), baseline.find("a/c")->stat.modified_transaction);
+    CHECK_EQ(transaction_id(31U), baseline.find("b")->stat.child_modified_transaction);
+
+    // Reading it again starts over
+    CHECK_EQ(4U, tree_baseline::from_archive(in).size());
+}
+
+GTEST_TEST(tree_edit_tests, to_string)
+{
+    CHECK_EQ("{create \"a/b\" data_size=3}", to_string(tree_edit(tree_edit_type::create, "a/b", buffer_from("abc"))));
+    CHECK_EQ("{erase \"a\"}", to_string(tree_edit(tree_edit_type::erase, "a")));
+    CHECK_EQ("set", to_string(tree_edit_type::set));
+}
+
+class tree_sync_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(tree_sync_tests, sync_follows_changes)
+{
+    client c = get_connected_client();
+    c.create("/sync-src", buffer_from("top")).get();
+    c.create("/sync-src/a", buffer_from("first")).get();
+    c.create("/sync-src/a/deep", buffer_from("deep")).get();
+    c.create("/sync-src/b", buffer_from("second")).get();
+    c.create("/sync-src/session", buffer(), create_mode::ephemeral).get();
+
+    // The target does not exist yet, so everything is created
+    auto first = sync_tree(c, zk::path("/sync-src"), c, zk::path("/sync-dst")).get();
+    CHECK_EQ(4U, first.edits().size());
+    CHECK_EQ(4U, first.baseline().size());
+    CHECK_TRUE(buffer_from("deep") == c.get("/sync-dst/a/deep").get().data());
+    CHECK_FALSE(c.exists("/sync-dst/session").get());
+
+    // Nothing changed, so nothing is read past the stats
+    auto unchanged = diff_trees(c, zk::path("/sync-src"), c, zk::path("/sync-dst"), first.baseline()).get();
+    CHECK_TRUE(unchanged.empty());
+
+    c.set("/sync-src/a/deep", buffer_from("changed")).get();
+    c.erase_recursive("/sync-src/b").get();
+    c.create("/sync-src/c", buffer_from("third")).get();
+    c.create("/sync-src/c/d", buffer()).get();
+    c.create("/sync-dst/a/stray", buffer()).get();
+
+    // A full comparison also finds what was written to the target behind the baseline's back
+    auto full = diff_trees(c, zk::path("/sync-src"), c, zk::path("/sync-dst")).get();
+    CHECK_EQ(5U, full.edits().size());
+    CHECK_EQ(tree_edit_type::erase, full.edits().front().type());
+
+    auto second = sync_tree(c, zk::path("/sync-src"), c, zk::path("/sync-dst"), first.baseline()).get();
+    std::vector<std::string> described;
+    for (const auto& edit : second.edits())
+        described.push_back(to_string(edit));
+    CHECK_EQ((std::vector<std::string>{ "{erase \"b\"}",
+                                        "{set \"a/deep\" data_size=7}",
+                                        "{create \"c\" data_size=5}",
+                                        "{create \"c/d\" data_size=0}",
+                                      }
+             ),
+             described
+            );
+
+    CHECK_TRUE(buffer_from("changed") == c.get("/sync-dst/a/deep").get().data());
+    CHECK_FALSE(c.exists("/sync-dst/b").get());
+    CHECK_TRUE(c.exists("/sync-dst/c/d").get());
+    CHECK_TRUE(c.exists("/sync-dst/a/stray").get());
+
+    CHECK_TRUE(diff_trees(c, zk::path("/sync-src"), c, zk::path("/sync-dst"), second.baseline()).get().empty());
+    CHECK_THROWS(no_entry) { diff_trees(c, zk::path("/sync-missing"), c, zk::path("/sync-dst")).get(); };
+}
+
+}
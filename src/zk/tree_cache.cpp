@@ -0,0 +1,481 @@
+#include "tree_cache.hpp"
+#include "error.hpp"
+#include "results.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// tree_change_type                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const tree_change_type& self)
+{
+    switch (self)
+    {
+    case tree_change_type::added:   return os << "added";
+    case tree_change_type::updated: return os << "updated";
+    case tree_change_type::removed: return os << "removed";
+    default:                        return os << "tree_change_type(" << static_cast<int>(self) << ')';
+    }
+}
+
+std::string to_string(const tree_change_type& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// tree_cache::state                                                                                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// What is known about a path. Like \c node_cache, the callbacks for a path hold on to its record so a callback
+/// for an entry which has since been erased (and maybe created again) can tell that it is no longer current.
+struct tree_cache::record final
+{
+    std::shared_ptr<const node> value;
+    std::vector<std::string>    children;
+};
+
+static std::string child_path(const std::string& parent, const std::string& name)
+{
+    std::string out;
+    out.reserve(parent.size() + 1U + name.size());
+    out.append(parent);
+    if (out.back() != '/')
+        out.push_back('/');
+    out.append(name);
+    return out;
+}
+
+namespace
+{
+
+using tree_change = std::tuple<tree_change_type, std::string, std::shared_ptr<const tree_cache::node>>;
+
+}
+
+struct tree_cache::state final :
+        std::enable_shared_from_this<tree_cache::state>
+{
+    using record_map = std::map<std::string, std::shared_ptr<record>, std::less<>>;
+
+    explicit state(client conn, zk::path root) :
+            conn(std::move(conn)),
+            root(std::move(root).str())
+    { }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Fetching                                                                                                       //
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    /// Count two more requests against the bootstrap if it is still running.
+    ///
+    /// \pre \c protect is held.
+    bool reserve_bootstrap()
+    {
+        if (ready)
+            return false;
+
+        pending += 2U;
+        return true;
+    }
+
+    void load(const std::string& path, const std::shared_ptr<record>& target, bool counted)
+    {
+        fetch_data(path, target, counted);
+        fetch_children(path, target, counted);
+    }
+
+    void fetch_data(const std::string& path, const std::shared_ptr<record>& target, bool counted)
+    {
+        auto self = shared_from_this();
+        conn.watch(path,
+                   [self, path, target, counted] (outcome<watch_result> result)
+                   {
+                       self->on_data(path, target, counted, std::move(result));
+                   },
+                   on_event_for(path, target, &state::fetch_data)
+                  );
+    }
+
+    void fetch_children(const std::string& path, const std::shared_ptr<record>& target, bool counted)
+    {
+        auto self = shared_from_this();
+        conn.watch_children(path,
+                            [self, path, target, counted] (outcome<watch_children_result> result)
+                            {
+                                self->on_children(path, target, counted, std::move(result));
+                            },
+                            on_event_for(path, target, &state::fetch_children)
+                           );
+    }
+
+    void fetch_root_exists(const std::shared_ptr<record>& target)
+    {
+        auto self = shared_from_this();
+        conn.watch_exists(root,
+                          [self, target] (outcome<watch_exists_result> result)
+                          {
+                              // Created between the read and setting the watch
+                              if (result && result->initial())
+                                  self->reload_root(target);
+                          },
+                          [weak_self = std::weak_ptr<state>(self), target] (const event&)
+                          {
+                              if (auto self = weak_self.lock())
+                                  self->reload_root(target);
+                          }
+                         );
+    }
+
+    /// Make a watch event for \a path call \a refetch to leave the watch again (and pick up whatever changed).
+    event_callback on_event_for(const std::string&                                                path,
+                                const std::shared_ptr<record>&                                    target,
+                                void (state::*refetch)(const std::string&, const std::shared_ptr<record>&, bool)
+                               )
+    {
+        std::weak_ptr<state>  weak_self   = shared_from_this();
+        std::weak_ptr<record> weak_target = target;
+        return [weak_self, weak_target, path, refetch] (const event&)
+               {
+                   auto self   = weak_self.lock();
+                   auto target = weak_target.lock();
+                   if (self && target && self->is_current(path, target))
+                       (self.get()->*refetch)(path, target, false);
+               };
+    }
+
+    void reload_root(const std::shared_ptr<record>& target)
+    {
+        if (is_current(root, target))
+            load(root, target, false);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Completions                                                                                                    //
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void on_data(const std::string&             path,
+                 const std::shared_ptr<record>& target,
+                 bool                           counted,
+                 outcome<watch_result>          result
+                )
+    {
+        std::vector<tree_change> changes;
+        bool                     watch_root = false;
+
+        std::unique_lock<std::shared_mutex> ax(protect);
+        if (!stopped && current_locked(path, target))
+        {
+            if (result)
+            {
+                auto& initial = result->initial();
+                auto  value   = std::make_shared<const node>(std::move(initial.data()),
+                                                             initial.stat(),
+                                                             target->children
+                                                            );
+                changes.emplace_back(target->value ? tree_change_type::updated : tree_change_type::added, path, value);
+                target->value = std::move(value);
+                snap.reset();
+            }
+            else if (result.code() == error_code::no_entry)
+            {
+                watch_root = remove_locked(path, changes);
+            }
+            else if (counted && bootstrap_error == error_code::ok)
+            {
+                bootstrap_error = result.code();
+            }
+        }
+        finish(std::move(ax), counted, changes, watch_root);
+    }
+
+    void on_children(const std::string&             path,
+                     const std::shared_ptr<record>& target,
+                     bool                           counted,
+                     outcome<watch_children_result> result
+                    )
+    {
+        std::vector<tree_change>                                     changes;
+        std::vector<std::pair<std::string, std::shared_ptr<record>>> added;
+        bool                                                         watch_root    = false;
+        bool                                                         added_counted = false;
+
+        std::unique_lock<std::shared_mutex> ax(protect);
+        if (!stopped && current_locked(path, target))
+        {
+            if (result)
+            {
+                auto names = std::move(*result).initial().children();
+                std::sort(names.begin(), names.end());
+
+                std::vector<std::string> gone;
+                std::set_difference(target->children.begin(), target->children.end(),
+                                    names.begin(),            names.end(),
+                                    std::back_inserter(gone)
+                                   );
+                for (const auto& name : gone)
+                    remove_locked(child_path(path, name), changes);
+
+                std::vector<std::string> fresh;
+                std::set_difference(names.begin(),            names.end(),
+                                    target->children.begin(), target->children.end(),
+                                    std::back_inserter(fresh)
+                                   );
+                for (const auto& name : fresh)
+                {
+                    auto child = std::make_shared<record>();
+                    auto key   = child_path(path, name);
+                    records[key] = child;
+                    added.emplace_back(std::move(key), std::move(child));
+                }
+                // Every child is either counted against the bootstrap or none are, since ready can not change while
+                // this request is still pending
+                for (std::size_t idx = 0U; idx < added.size(); ++idx)
+                    added_counted = reserve_bootstrap();
+
+                target->children = std::move(names);
+                if (target->value)
+                {
+                    auto value = std::make_shared<const node>(target->value->shared_data(),
+                                                              target->value->stat(),
+                                                              target->children
+                                                             );
+                    changes.emplace_back(tree_change_type::updated, path, value);
+                    target->value = std::move(value);
+                }
+                snap.reset();
+            }
+            else if (result.code() == error_code::no_entry)
+            {
+                watch_root = remove_locked(path, changes);
+            }
+            else if (counted && bootstrap_error == error_code::ok)
+            {
+                bootstrap_error = result.code();
+            }
+        }
+        finish(std::move(ax), counted, changes, watch_root);
+
+        for (const auto& [key, child] : added)
+            load(key, child, added_counted);
+    }
+
+    /// Release the lock, then tell the listeners about \a changes and complete the bootstrap if \a counted was the last
+    /// request it was waiting on.
+    void finish(std::unique_lock<std::shared_mutex> ax,
+                bool                                counted,
+                const std::vector<tree_change>&     changes,
+                bool                                watch_root
+               )
+    {
+        bool       now_ready = false;
+        error_code rc        = error_code::ok;
+        if (counted && --pending == 0U)
+        {
+            ready     = true;
+            now_ready = true;
+            rc        = bootstrap_error;
+        }
+        std::shared_ptr<record> root_target;
+        if (watch_root)
+            root_target = records.at(root);
+        ax.unlock();
+
+        if (watch_root)
+            fetch_root_exists(root_target);
+
+        if (!changes.empty())
+        {
+            std::unique_lock<std::mutex> lx(listeners_protect);
+            auto targets = listeners;
+            lx.unlock();
+
+            for (const auto& change : changes)
+                for (const auto& [id, on_change] : targets)
+                    on_change(std::get<0>(change), std::get<1>(change), std::get<2>(change));
+        }
+
+        if (now_ready)
+        {
+            if (rc == error_code::ok)
+                ready_promise.set_value();
+            else
+                ready_promise.set_exception(get_exception_ptr_of(rc));
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Records                                                                                                        //
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool is_current(const std::string& path, const std::shared_ptr<record>& target) const
+    {
+        std::shared_lock<std::shared_mutex> ax(protect);
+        return !stopped && current_locked(path, target);
+    }
+
+    /// \pre \c protect is held.
+    bool current_locked(const std::string& path, const std::shared_ptr<record>& target) const
+    {
+        auto iter = records.find(path);
+        return iter != records.end() && iter->second == target;
+    }
+
+    /// Remove \a path and everything under it. The root itself is never removed, but replaced with an empty record.
+    ///
+    /// \pre \c protect is held.
+    /// \returns \c true if \a path is the root, in which case the caller must watch for it to be created again.
+    bool remove_locked(const std::string& path, std::vector<tree_change>& changes)
+    {
+        auto prefix = path == "/" ? path : path + '/';
+        for (auto iter = records.lower_bound(prefix); iter != records.end(); )
+        {
+            if (iter->first.compare(0U, prefix.size(), prefix) != 0)
+                break;
+            else if (iter->first == path)
+                ++iter;
+            else
+                iter = erase_record(iter, changes);
+        }
+
+        snap.reset();
+        if (path == root)
+        {
+            auto iter = records.find(path);
+            if (iter->second->value)
+                changes.emplace_back(tree_change_type::removed, path, iter->second->value);
+            iter->second = std::make_shared<record>();
+            return true;
+        }
+        else
+        {
+            auto iter = records.find(path);
+            if (iter != records.end())
+                erase_record(iter, changes);
+            return false;
+        }
+    }
+
+    record_map::iterator erase_record(record_map::iterator iter, std::vector<tree_change>& changes)
+    {
+        if (iter->second->value)
+            changes.emplace_back(tree_change_type::removed, iter->first, iter->second->value);
+        return records.erase(iter);
+    }
+
+    client                    conn;
+    std::string               root;
+
+    mutable std::shared_mutex protect;
+    record_map                records;
+    bool                      started         = false;
+    bool                      stopped         = false;
+    bool                      ready           = false;
+    std::size_t               pending         = 0U;
+    error_code                bootstrap_error = error_code::ok;
+    promise<void>             ready_promise;
+
+    mutable std::mutex                           snap_protect;
+    mutable std::shared_ptr<const snapshot_type> snap;
+
+    std::mutex                      listeners_protect;
+    std::map<std::size_t, listener> listeners;
+    std::size_t                     next_listener_id = 0U;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// tree_cache                                                                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+tree_cache::tree_cache(client conn, zk::path root) :
+        _state(std::make_shared<state>(std::move(conn), std::move(root)))
+{ }
+
+tree_cache::~tree_cache() noexcept
+{
+    std::unique_lock<std::shared_mutex> ax(_state->protect);
+    _state->stopped = true;
+}
+
+future<void> tree_cache::start()
+{
+    std::unique_lock<std::shared_mutex> ax(_state->protect);
+    if (_state->started)
+        throw std::logic_error("tree_cache::start called more than once");
+    _state->started = true;
+
+    auto target  = std::make_shared<record>();
+    _state->records.emplace(_state->root, target);
+    auto counted = _state->reserve_bootstrap();
+    auto fut     = _state->ready_promise.get_future();
+    ax.unlock();
+
+    _state->load(_state->root, target, counted);
+    return fut;
+}
+
+std::shared_ptr<const tree_cache::node> tree_cache::get(path_view path) const
+{
+    std::shared_lock<std::shared_mutex> ax(_state->protect);
+    auto iter = _state->records.find(path.view());
+    if (iter != _state->records.end())
+        return iter->second->value;
+    else
+        return nullptr;
+}
+
+std::shared_ptr<const tree_cache::snapshot_type> tree_cache::snapshot() const
+{
+    // The snapshot is reset with protect held exclusively, so holding it shared keeps snap from changing under us (but
+    // two readers could race to build it, which is what snap_protect is for)
+    std::shared_lock<std::shared_mutex> ax(_state->protect);
+    std::unique_lock<std::mutex>        sx(_state->snap_protect);
+    if (!_state->snap)
+    {
+        auto out = std::make_shared<snapshot_type>();
+        for (const auto& [key, target] : _state->records)
+            if (target->value)
+                out->emplace_hint(out->end(), key, target->value);
+        _state->snap = std::move(out);
+    }
+    return _state->snap;
+}
+
+std::size_t tree_cache::size() const
+{
+    std::shared_lock<std::shared_mutex> ax(_state->protect);
+    auto count = std::count_if(_state->records.begin(), _state->records.end(),
+                               [] (const auto& pair) { return bool(pair.second->value); }
+                              );
+    return static_cast<std::size_t>(count);
+}
+
+std::size_t tree_cache::add_listener(listener on_change)
+{
+    std::unique_lock<std::mutex> ax(_state->listeners_protect);
+    auto id = _state->next_listener_id++;
+    _state->listeners.emplace(id, std::move(on_change));
+    return id;
+}
+
+void tree_cache::remove_listener(std::size_t id)
+{
+    std::unique_lock<std::mutex> ax(_state->listeners_protect);
+    _state->listeners.erase(id);
+}
+
+}
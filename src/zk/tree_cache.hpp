@@ -0,0 +1,165 @@
+/// \file
+/// Defines \ref zk::tree_cache, an in-memory mirror of a subtree kept up to date by watches.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "buffer.hpp"
+#include "client.hpp"
+#include "forwards.hpp"
+#include "future.hpp"
+#include "path.hpp"
+#include "shared_buffer.hpp"
+#include "types.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// Describes how an entry of a \ref tree_cache changed.
+enum class tree_change_type : int
+{
+    added,   //!< The entry was seen for the first time.
+    updated, //!< The data, \ref stat, or children of the entry changed.
+    removed, //!< The entry was erased (or one of its parents was).
+};
+
+std::ostream& operator<<(std::ostream&, const tree_change_type&);
+
+std::string to_string(const tree_change_type&);
+
+/// Keeps an in-memory copy of every entry under a root path by leaving a \ref client::watch and
+/// \ref client::watch_children on each of them. Once \ref start has completed, reads of the subtree never go to the
+/// server.
+///
+/// \code
+/// zk::tree_cache services(client, zk::path("/services"));
+/// services.start().get();
+/// for (const auto& [name, entry] : *services.snapshot())
+///     std::cout << name << " -> " << entry->data().size() << " bytes" << std::endl;
+/// \endcode
+///
+/// \par Bootstrap
+/// Nothing waits for one level of the tree before fetching the next: as soon as the children of an entry are known,
+/// the requests for all of them are sent. The number of requests in flight is only bounded by the size of the tree,
+/// so the cold start of a large tree is a matter of bandwidth rather than of round trips per level.
+///
+/// \par Reading
+/// Entries are immutable and shared; \ref get only holds the lock long enough to copy a pointer. A \ref snapshot is a
+/// consistent, sorted view of the whole tree which can be iterated without any locking at all. Snapshots are built on
+/// demand, so the first \ref snapshot after a change costs a copy of the map (not of the data).
+///
+/// \par Changes
+/// Listeners registered with \ref add_listener are told of every change after it has been applied to the cache. They
+/// are called on the ZooKeeper event thread, with the same restrictions as a \ref callback. If the root does not exist,
+/// the cache is empty and an exists watch is left on the root to fill it when it is created.
+///
+/// A watch which fails to be set again after it triggers (for example, because the session was lost) leaves that part
+/// of the tree as it was last seen. After a session expires, create a new cache.
+class tree_cache final
+{
+public:
+    /// A cached entry.
+    class node final
+    {
+    public:
+        explicit node(buffer data, const zk::stat& stat, std::vector<std::string> children) :
+                _data(std::make_shared<const buffer>(std::move(data))),
+                _stat(stat),
+                _children(std::move(children))
+        { }
+
+        /// Create a node viewing the same data as \a data, so the nodes made for changes which leave the data alone
+        /// (a child added or removed) do not copy it. A partial slice is copied once.
+        explicit node(const shared_buffer& data, const zk::stat& stat, std::vector<std::string> children) :
+                _data(data.whole()),
+                _stat(stat),
+                _children(std::move(children))
+        {
+            if (!_data)
+                _data = std::make_shared<const buffer>(data.begin(), data.end());
+        }
+
+        /// The data of the entry.
+        const buffer& data() const { return *_data; }
+
+        /// The data of the entry, as a view which keeps it alive without keeping the node.
+        shared_buffer shared_data() const { return shared_buffer(_data); }
+
+        /// The \ref zk::stat of the entry when its data was read.
+        const zk::stat& stat() const { return _stat; }
+
+        /// The names of the children of the entry, in sorted order.
+        const std::vector<std::string>& children() const { return _children; }
+
+    private:
+        std::shared_ptr<const buffer> _data;
+        zk::stat                      _stat;
+        std::vector<std::string>      _children;
+    };
+
+    /// The full path of each cached entry to its contents, in path order.
+    using snapshot_type = std::map<std::string, std::shared_ptr<const node>, std::less<>>;
+
+    /// Called with the type of change, the full path of the entry, and its contents. For a
+    /// \ref tree_change_type::removed change, the contents are the last ones which were seen.
+    using listener = std::function<void (tree_change_type, const std::string&, const std::shared_ptr<const node>&)>;
+
+public:
+    /// Create a cache of the subtree at \a root. Nothing is fetched until \ref start is called.
+    explicit tree_cache(client conn, zk::path root);
+
+    tree_cache(const tree_cache&) = delete;
+    tree_cache& operator=(const tree_cache&) = delete;
+
+    /// Stop following changes. Operations in flight are still completed, but their results are discarded.
+    ~tree_cache() noexcept;
+
+    /// Start mirroring the tree.
+    ///
+    /// \returns A future which is filled once every entry which existed when the watches were set has been loaded.
+    ///  If any of the reads fails with something other than \ref no_entry, it is delivered with that error (the cache
+    ///  keeps the parts it managed to load and still follows changes to them).
+    /// \throws std::logic_error If the cache has already been started.
+    future<void> start();
+
+    /// Get the cached contents of the entry at \a path or \c nullptr if it is not in the cache.
+    std::shared_ptr<const node> get(path_view path) const;
+
+    /// Get a consistent view of every cached entry.
+    std::shared_ptr<const snapshot_type> snapshot() const;
+
+    /// The number of cached entries.
+    std::size_t size() const;
+
+    /// Register \a on_change to be told of changes.
+    ///
+    /// \returns An identifier to pass to \ref remove_listener.
+    std::size_t add_listener(listener on_change);
+
+    /// Unregister the listener with the \a id returned by \ref add_listener. It might still be called if a change is
+    /// being delivered concurrently.
+    void remove_listener(std::size_t id);
+
+private:
+    struct record;
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// \}
+
+}
@@ -0,0 +1,115 @@
+#include <zk/server/server_tests.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "client.hpp"
+#include "error.hpp"
+#include "string_view.hpp"
+#include "tree_cache.hpp"
+
+namespace zk
+{
+
+static buffer buffer_from(string_view str)
+{
+    return buffer(str.data(), str.data() + str.size());
+}
+
+template <typename FPredicate>
+static bool eventually(FPredicate&& pred)
+{
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        if (pred())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return pred();
+}
+
+GTEST_TEST(tree_change_type_tests, to_string)
+{
+    CHECK_EQ("added",   to_string(tree_change_type::added));
+    CHECK_EQ("updated", to_string(tree_change_type::updated));
+    CHECK_EQ("removed", to_string(tree_change_type::removed));
+}
+
+class tree_cache_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(tree_cache_tests, bootstrap)
+{
+    client c = get_connected_client();
+    c.create("/tree-boot", buffer_from("root")).get();
+    for (int svc = 0; svc < 5; ++svc)
+    {
+        auto svc_path = "/tree-boot/svc-" + std::to_string(svc);
+        c.create(svc_path, buffer_from("svc")).get();
+        for (int inst = 0; inst < 10; ++inst)
+            c.create(svc_path + "/inst-" + std::to_string(inst), buffer_from("inst")).get();
+    }
+
+    tree_cache cache(c, path("/tree-boot"));
+    cache.start().get();
+    CHECK_EQ(1U + 5U + 50U, cache.size());
+    CHECK_EQ(5U, cache.get("/tree-boot")->children().size());
+    CHECK_TRUE(cache.get("/tree-boot/svc-3/inst-7")->data() == buffer_from("inst"));
+    CHECK_EQ(56U, cache.snapshot()->size());
+
+    CHECK_THROWS(std::logic_error)
+    {
+        cache.start();
+    };
+}
+
+GTEST_TEST_F(tree_cache_tests, follows_changes)
+{
+    client c = get_connected_client();
+    c.create("/tree-follow", buffer_from("root")).get();
+
+    tree_cache cache(c, path("/tree-follow"));
+    std::atomic<int> added(0), updated(0), removed(0);
+    cache.add_listener([&] (tree_change_type type, const std::string&, const std::shared_ptr<const tree_cache::node>&)
+                       {
+                           switch (type)
+                           {
+                           case tree_change_type::added:   ++added;   break;
+                           case tree_change_type::updated: ++updated; break;
+                           case tree_change_type::removed: ++removed; break;
+                           }
+                       }
+                      );
+    cache.start().get();
+    CHECK_EQ(1, added.load());
+
+    auto before = cache.snapshot();
+    c.create("/tree-follow/a", buffer_from("a")).get();
+    CHECK_TRUE(eventually([&] { return cache.get("/tree-follow/a") != nullptr; }));
+
+    c.set("/tree-follow/a", buffer_from("b")).get();
+    CHECK_TRUE(eventually([&] { return cache.get("/tree-follow/a")->data() == buffer_from("b"); }));
+
+    c.erase("/tree-follow/a").get();
+    CHECK_TRUE(eventually([&] { return cache.get("/tree-follow/a") == nullptr; }));
+    CHECK_TRUE(eventually([&] { return removed.load() == 1; }));
+
+    // Old snapshots are not affected by later changes
+    CHECK_EQ(1U, before->size());
+}
+
+GTEST_TEST_F(tree_cache_tests, missing_root)
+{
+    client     c = get_connected_client();
+    tree_cache cache(c, path("/tree-missing"));
+    cache.start().get();
+    CHECK_EQ(0U, cache.size());
+
+    c.create("/tree-missing", buffer_from("here")).get();
+    CHECK_TRUE(eventually([&] { return cache.size() == 1U; }));
+}
+
+}
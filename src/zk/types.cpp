@@ -2,6 +2,7 @@
 
 #include <ostream>
 #include <sstream>
+#include <stdexcept>
 #include <utility>
 
 namespace zk
@@ -190,4 +191,107 @@ std::string to_string(const create_mode& self)
     return os.str();
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// session_credentials                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static constexpr char hex_digits[] = "0123456789abcdef";
+
+static int hex_value(char c)
+{
+    if ('0' <= c && c <= '9')
+        return c - '0';
+    else if ('a' <= c && c <= 'f')
+        return c - 'a' + 10;
+    else if ('A' <= c && c <= 'F')
+        return c - 'A' + 10;
+    else
+        return -1;
+}
+
+std::string session_credentials::encode() const
+{
+    std::string out;
+    out.reserve(17U + 2U * password.size());
+    auto raw_id = static_cast<std::uint64_t>(id);
+    for (int shift = 60; shift >= 0; shift -= 4)
+        out += hex_digits[(raw_id >> shift) & 0xfU];
+
+    out += ':';
+    for (char c : password)
+    {
+        auto byte = static_cast<unsigned char>(c);
+        out += hex_digits[byte >> 4U];
+        out += hex_digits[byte & 0xfU];
+    }
+    return out;
+}
+
+session_credentials session_credentials::decode(string_view src)
+{
+    auto invalid = [&] (const char* what)
+                   {
+                       return std::invalid_argument(std::string("Invalid session credentials \"") + std::string(src)
+                                                    + "\" -- " + what
+                                                   );
+                   };
+
+    auto colon = src.find(':');
+    if (colon == string_view::npos)
+        throw invalid("expected \"<ID>:<password>\"");
+
+    auto id_part       = src.substr(0U, colon);
+    auto password_part = src.substr(colon + 1U);
+    if (id_part.empty() || id_part.size() > 16U)
+        throw invalid("the ID must be 1 to 16 hexadecimal digits");
+    if (password_part.size() != 2U * password_size)
+        throw invalid("the password must be 32 hexadecimal digits");
+
+    std::uint64_t raw_id = 0U;
+    for (char c : id_part)
+    {
+        auto digit = hex_value(c);
+        if (digit < 0)
+            throw invalid("the ID is not hexadecimal");
+        raw_id = (raw_id << 4U) | static_cast<std::uint64_t>(digit);
+    }
+
+    session_credentials out;
+    out.id = static_cast<std::int64_t>(raw_id);
+    out.password.reserve(password_size);
+    for (std::size_t idx = 0U; idx < password_part.size(); idx += 2U)
+    {
+        auto high = hex_value(password_part[idx]);
+        auto low  = hex_value(password_part[idx + 1U]);
+        if (high < 0 || low < 0)
+            throw invalid("the password is not hexadecimal");
+        out.password += static_cast<char>((high << 4) | low);
+    }
+    return out;
+}
+
+bool operator==(const session_credentials& lhs, const session_credentials& rhs)
+{
+    return lhs.id       == rhs.id
+        && lhs.password == rhs.password;
+}
+
+bool operator!=(const session_credentials& lhs, const session_credentials& rhs)
+{
+    return !(lhs == rhs);
+}
+
+std::ostream& operator<<(std::ostream& os, const session_credentials& self)
+{
+    // The password stays out of logs
+    return os << "session_credentials(0x" << std::hex << static_cast<std::uint64_t>(self.id) << std::dec << ')';
+}
+
+std::string to_string(const session_credentials& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
 }
@@ -3,9 +3,13 @@
 #include <zk/config.hpp>
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <iosfwd>
 #include <string>
 
+#include "string_view.hpp"
+
 namespace zk
 {
 
@@ -405,6 +409,42 @@ std::ostream& operator<<(std::ostream&, const state&);
 /// Get the string representation of the provided \a state.
 std::string to_string(const state& state);
 
+/// What a server needs to let a new connection carry on with an existing session: its ID and password. A process which
+/// saves them (from \ref client::current_session) and passes them to \ref connection_params::resume_session when it
+/// starts again keeps its ephemeral entries and its place in the ensemble, as long as it is back within the session
+/// timeout. If it is not, the new connection goes to \ref state::expired_session.
+///
+/// \warning
+/// Anyone holding the password can act as the session. \c operator<< and \ref to_string only show the ID; \ref encode
+/// writes both, and whatever it is written to should only be readable by the process.
+struct session_credentials final
+{
+    /// The length of the passwords servers hand out.
+    static constexpr std::size_t password_size = 16U;
+
+    /// The session ID, as in \ref stat::ephemeral_owner. It is \c 0 for no session.
+    std::int64_t id = 0;
+
+    /// The password of the session (\ref password_size bytes of binary data).
+    std::string password;
+
+    /// Get the credentials in the form `"<ID>:<password>"`, both in hexadecimal, which can be kept in a file or an
+    /// environment variable and read back with \ref decode.
+    std::string encode() const;
+
+    /// Read credentials written by \ref encode.
+    ///
+    /// \throws std::invalid_argument if \a src is not in that form.
+    static session_credentials decode(string_view src);
+};
+
+bool operator==(const session_credentials& lhs, const session_credentials& rhs);
+bool operator!=(const session_credentials& lhs, const session_credentials& rhs);
+
+std::ostream& operator<<(std::ostream&, const session_credentials&);
+
+std::string to_string(const session_credentials&);
+
 /// \}
 
 }
@@ -2,6 +2,9 @@
 
 #include "types.hpp"
 
+#include <stdexcept>
+#include <string>
+
 namespace zk
 {
 
@@ -36,4 +39,41 @@ GTEST_TEST(state_tests, stringification)
     CHECK_EQ("state(605983)",         to_string(static_cast<state>(605983)));
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// session_credentials                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GTEST_TEST(session_credentials_tests, encode_decode)
+{
+    session_credentials creds;
+    creds.id       = 0x1650ab2f8bc00003;
+    creds.password = std::string("\x00\x01\x7f\x80\xff secret!\x10\x20\x30", 16U);
+
+    auto encoded = creds.encode();
+    CHECK_EQ("1650ab2f8bc00003:00017f80ff2073656372657421102030", encoded);
+    CHECK_EQ(creds, session_credentials::decode(encoded));
+
+    // The ID does not have to be padded and negative IDs survive the trip
+    CHECK_EQ(0x3, session_credentials::decode("3:" + std::string(32U, '0')).id);
+    creds.id = -2;
+    CHECK_EQ(creds, session_credentials::decode(creds.encode()));
+}
+
+GTEST_TEST(session_credentials_tests, decode_invalid)
+{
+    CHECK_THROWS(std::invalid_argument) { session_credentials::decode("1650ab2f8bc00003"); };
+    CHECK_THROWS(std::invalid_argument) { session_credentials::decode(":" + std::string(32U, '0')); };
+    CHECK_THROWS(std::invalid_argument) { session_credentials::decode("12:0011"); };
+    CHECK_THROWS(std::invalid_argument) { session_credentials::decode("xyz:" + std::string(32U, '0')); };
+    CHECK_THROWS(std::invalid_argument) { session_credentials::decode("12:" + std::string(32U, 'g')); };
+}
+
+GTEST_TEST(session_credentials_tests, stringification_hides_password)
+{
+    session_credentials creds;
+    creds.id       = 0x1f;
+    creds.password = std::string(16U, 'p');
+    CHECK_EQ("session_credentials(0x1f)", to_string(creds));
+}
+
 }
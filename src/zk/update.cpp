@@ -0,0 +1,261 @@
+#include "update.hpp"
+#include "cancellation.hpp"
+#include "connection.hpp"
+#include "error.hpp"
+#include "node_cache.hpp"
+#include "results.hpp"
+#include "tree_cache.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// update_table::round                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct update_table::job final
+{
+    update_function      fn;
+    update_policy        policy;
+    callback<set_result> on_complete;
+    std::size_t          attempts = 0U;
+};
+
+/// The updates of one entry which go out in the same write. A round is \c shared when it is in \c _rounds, where later
+/// updates of the entry queue up for its next write; an update which does not \ref update_policy::merge gets a round of
+/// its own. The \c jobs only belong to the attempt in flight, so they are not locked; \c queued is under \c _protect.
+struct update_table::round final
+{
+    explicit round(std::shared_ptr<connection> conn, std::string path, bool shared) :
+            conn(std::move(conn)),
+            path(std::move(path)),
+            shared(shared)
+    { }
+
+    std::shared_ptr<connection> conn;
+    std::string                 path;
+    bool                        shared;
+    std::vector<job>            jobs;
+    std::vector<job>            queued;
+    std::size_t                 failures = 0U; //!< Writes in a row which lost to someone else's
+};
+
+/// Pick the wait before the next attempt, after \a failures lost writes in a row.
+static std::chrono::microseconds backoff_for(const update_policy& policy, std::size_t failures)
+{
+    using std::chrono::microseconds;
+
+    auto bound = microseconds(policy.initial_backoff());
+    auto limit = microseconds(policy.max_backoff());
+    for (std::size_t idx = 1U; idx < failures && bound < limit; ++idx)
+        bound *= 2;
+    bound = std::min(bound, limit);
+    if (bound <= microseconds::zero())
+        return microseconds::zero();
+
+    thread_local std::mt19937 rng(std::random_device{}());
+    return microseconds(std::uniform_int_distribution<microseconds::rep>(0, bound.count())(rng));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// update_table                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+update_table::update_table() = default;
+
+update_table::~update_table() noexcept = default;
+
+void update_table::complete_all(std::vector<job>& jobs, const outcome<set_result>& result)
+{
+    for (auto& item : std::exchange(jobs, {}))
+        item.on_complete(result);
+}
+
+std::size_t update_table::size() const
+{
+    std::unique_lock<std::mutex> ax(_protect);
+    return _rounds.size();
+}
+
+void update_table::submit(std::shared_ptr<connection> conn,
+                          path_view                   path,
+                          update_function             fn,
+                          const update_policy&        policy,
+                          callback<set_result>        on_complete
+                         )
+{
+    job item{ std::move(fn), policy, std::move(on_complete) };
+
+    std::shared_ptr<round> target;
+    if (policy.merge())
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        auto iter = _rounds.find(path.view());
+        if (iter != _rounds.end())
+        {
+            iter->second->queued.emplace_back(std::move(item));
+            return;
+        }
+
+        target = std::make_shared<round>(std::move(conn), std::string(path.view()), true);
+        _rounds.emplace(target->path, target);
+    }
+    else
+    {
+        target = std::make_shared<round>(std::move(conn), std::string(path.view()), false);
+    }
+
+    target->jobs.emplace_back(std::move(item));
+    attempt(target);
+}
+
+void update_table::attempt(const std::shared_ptr<round>& target)
+{
+    // A cache can only be trusted until it has been shown to be behind; after a lost write, only the server will do
+    const auto& policy    = target->jobs.front().policy;
+    bool        use_cache = target->failures == 0U;
+    if (use_cache && policy.tree_cache())
+    {
+        if (auto cached = policy.tree_cache()->get(target->path))
+        {
+            write(target, cached->data(), cached->stat().data_version);
+            return;
+        }
+    }
+
+    auto on_read = [this, target] (outcome<get_result> result)
+                   {
+                       if (result)
+                       {
+                           auto check = result->stat().data_version;
+                           write(target, std::move(*result).data(), check);
+                       }
+                       else
+                       {
+                           complete_all(target->jobs, outcome<set_result>(result.code(), result.error()));
+                           next(target, nullptr, version::any());
+                       }
+                   };
+    if (use_cache && policy.node_cache())
+        policy.node_cache()->get(target->path, std::move(on_read));
+    else
+        target->conn->get(target->path, std::move(on_read));
+}
+
+void update_table::write(const std::shared_ptr<round>& target, buffer current, version check)
+{
+    // Each update is applied to what the ones before it made; one which throws is left out of the write
+    std::vector<job> kept;
+    kept.reserve(target->jobs.size());
+    for (auto& item : target->jobs)
+    {
+        try
+        {
+            current = item.fn(current);
+            kept.emplace_back(std::move(item));
+        }
+        catch (const error& ex)
+        {
+            item.on_complete(outcome<set_result>(ex.code(), std::current_exception()));
+        }
+        catch (...)
+        {
+            item.on_complete(outcome<set_result>(error_code::invalid_arguments, std::current_exception()));
+        }
+    }
+    target->jobs = std::move(kept);
+
+    // The version is still good, so whoever queued up in the meantime can use it
+    auto written = std::make_shared<buffer>(std::move(current));
+    if (target->jobs.empty())
+    {
+        next(target, std::move(written), check);
+        return;
+    }
+
+    target->conn->set(target->path,
+                      *written,
+                      check,
+                      [this, target, written] (outcome<set_result> result)
+                      {
+                          on_written(target, written, std::move(result));
+                      }
+                     );
+}
+
+void update_table::on_written(const std::shared_ptr<round>& target,
+                              std::shared_ptr<buffer>       written,
+                              outcome<set_result>           result
+                             )
+{
+    if (result)
+    {
+        target->failures = 0U;
+        auto check = result->stat().data_version;
+        complete_all(target->jobs, result);
+        next(target, std::move(written), check);
+        return;
+    }
+    else if (result.code() != error_code::version_mismatch)
+    {
+        target->failures = 0U;
+        complete_all(target->jobs, result);
+        next(target, nullptr, version::any());
+        return;
+    }
+
+    // Lost to another writer: whatever the first attempt came from is stale, so the cache should not keep it either
+    auto policy = target->jobs.front().policy;
+    if (target->failures == 0U && policy.node_cache())
+        policy.node_cache()->invalidate(target->path);
+    target->failures += 1U;
+
+    std::vector<job> kept;
+    for (auto& item : target->jobs)
+    {
+        if (++item.attempts < item.policy.max_attempts())
+            kept.emplace_back(std::move(item));
+        else
+            item.on_complete(result);
+    }
+    target->jobs = std::move(kept);
+    if (target->jobs.empty())
+    {
+        next(target, nullptr, version::any());
+        return;
+    }
+
+    // The timer keeps itself alive through its own handler until it fires
+    auto delay = cancellation_token::after(backoff_for(policy, target->failures));
+    delay.on_cancel([this, target, delay] { next(target, nullptr, version::any()); });
+}
+
+void update_table::next(const std::shared_ptr<round>& target, std::shared_ptr<buffer> written, version check)
+{
+    {
+        std::unique_lock<std::mutex> ax(_protect);
+        std::move(target->queued.begin(), target->queued.end(), std::back_inserter(target->jobs));
+        target->queued.clear();
+
+        if (target->jobs.empty())
+        {
+            if (target->shared)
+                _rounds.erase(target->path);
+            return;
+        }
+    }
+
+    if (written)
+        write(target, std::move(*written), check);
+    else
+        attempt(target);
+}
+
+}
@@ -0,0 +1,123 @@
+/// \file
+/// Defines \ref zk::update_policy and \ref zk::update_table, which control and carry out \ref client::update.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "buffer.hpp"
+#include "callback.hpp"
+#include "forwards.hpp"
+#include "path.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// Makes the new data of an entry out of its \a current data for \ref client::update. It is called once for every
+/// attempt, so it should not do anything which can not be repeated. Throwing ends the update with what was thrown.
+using update_function = std::function<buffer (const buffer& current)>;
+
+/// How \ref client::update goes about an update: where it takes the first version from, how it backs off when it loses
+/// a race for the entry and whether it shares a write with concurrent updates of the same entry.
+class update_policy final
+{
+public:
+    update_policy() = default;
+
+    /// How many writes are attempted before the update gives up with \ref version_mismatch. The default is 16.
+    std::size_t  max_attempts() const { return _max_attempts; }
+    std::size_t& max_attempts()       { return _max_attempts; }
+
+    /// \{
+    /// The bounds on the wait before another attempt. After the \c n th failed write, the update waits for a random
+    /// time between zero and <tt>min(max_backoff, initial_backoff * 2^(n - 1))</tt>, so updaters which collided once
+    /// do not all come back at the same moment. Defaults are 2 ms and 250 ms.
+    std::chrono::milliseconds  initial_backoff() const { return _initial_backoff; }
+    std::chrono::milliseconds& initial_backoff()       { return _initial_backoff; }
+    std::chrono::milliseconds  max_backoff() const     { return _max_backoff; }
+    std::chrono::milliseconds& max_backoff()           { return _max_backoff; }
+    /// \}
+
+    /// \{
+    /// Caches to take the data and version of the first attempt from, skipping the read. A \ref tree_cache which holds
+    /// the entry is used first, then a \ref node_cache (which reads the entry itself if it is not cached). A cached
+    /// value can be behind the server, which costs one failed write; every later attempt reads from the server. Neither
+    /// is set by default, and a cache which is set must outlive the update.
+    ptr<zk::node_cache>        node_cache() const { return _node_cache; }
+    ptr<zk::node_cache>&       node_cache()       { return _node_cache; }
+    ptr<const zk::tree_cache>  tree_cache() const { return _tree_cache; }
+    ptr<const zk::tree_cache>& tree_cache()       { return _tree_cache; }
+    /// \}
+
+    /// Should the update share a write with the other updates of the same entry through the same connection? If
+    /// \c true (the default), updates which arrive while a write of the entry is in flight are applied one after the
+    /// other to its result and written together, with one versioned \ref client::set.
+    bool  merge() const { return _merge; }
+    bool& merge()       { return _merge; }
+
+private:
+    std::size_t               _max_attempts    = 16U;
+    std::chrono::milliseconds _initial_backoff = std::chrono::milliseconds(2);
+    std::chrono::milliseconds _max_backoff     = std::chrono::milliseconds(250);
+    ptr<zk::node_cache>       _node_cache      = nullptr;
+    ptr<const zk::tree_cache> _tree_cache      = nullptr;
+    bool                      _merge           = true;
+};
+
+/// The \ref client::update operations in progress on one \ref connection, by path. Every connection has one (see
+/// \ref connection::updates), which is what lets the updates of an entry through any copy of a \ref client find each
+/// other and share a write.
+class update_table final
+{
+public:
+    update_table();
+
+    update_table(const update_table&) = delete;
+    update_table& operator=(const update_table&) = delete;
+
+    ~update_table() noexcept;
+
+    /// Update the entry at \a path through \a conn (see \ref client::update).
+    void submit(std::shared_ptr<connection> conn,
+                path_view                   path,
+                update_function             fn,
+                const update_policy&        policy,
+                callback<set_result>        on_complete
+               );
+
+    /// The number of entries with an update in progress which others can join.
+    std::size_t size() const;
+
+private:
+    struct job;
+    struct round;
+
+    static void complete_all(std::vector<job>& jobs, const outcome<set_result>& result);
+
+    void attempt(const std::shared_ptr<round>& target);
+
+    void write(const std::shared_ptr<round>& target, buffer current, version check);
+
+    void on_written(const std::shared_ptr<round>& target, std::shared_ptr<buffer> written, outcome<set_result> result);
+
+    void next(const std::shared_ptr<round>& target, std::shared_ptr<buffer> written, version check);
+
+private:
+    mutable std::mutex                                         _protect;
+    std::map<std::string, std::shared_ptr<round>, std::less<>> _rounds;
+};
+
+/// \}
+
+}
@@ -0,0 +1,131 @@
+#include <zk/server/server_tests.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "client.hpp"
+#include "error.hpp"
+#include "node_cache.hpp"
+#include "string_view.hpp"
+#include "update.hpp"
+
+namespace zk
+{
+
+static buffer buffer_from(string_view str)
+{
+    return buffer(str.data(), str.data() + str.size());
+}
+
+static std::string string_from(const buffer& buf)
+{
+    return std::string(buf.data(), buf.size());
+}
+
+/// Append \a mark to the data of the entry.
+static update_function append(char mark)
+{
+    return [mark] (const buffer& current)
+           {
+               auto out = current;
+               out.push_back(mark);
+               return out;
+           };
+}
+
+class update_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(update_tests, read_modify_write)
+{
+    client c = get_connected_client();
+    c.create("/update-rmw", buffer_from("a")).get();
+
+    auto written = c.update("/update-rmw", append('b')).get();
+    CHECK_EQ(1, written.stat().data_version.value);
+    CHECK_EQ("ab", string_from(c.get("/update-rmw").get().data()));
+
+    CHECK_THROWS(no_entry) { c.update("/update-missing", append('b')).get(); };
+    CHECK_THROWS(std::runtime_error)
+    {
+        c.update("/update-rmw", [] (const buffer&) -> buffer { throw std::runtime_error("refused"); }).get();
+    };
+    CHECK_EQ("ab", string_from(c.get("/update-rmw").get().data()));
+}
+
+GTEST_TEST_F(update_tests, retries_stale_cache)
+{
+    client     c = get_connected_client();
+    node_cache cache(c);
+    c.create("/update-cached", buffer_from("1")).get();
+    CHECK_EQ("1", string_from(cache.get("/update-cached").get().data()));
+
+    // Whether or not the cache has heard of this yet, the update has to land on the new data
+    c.set("/update-cached", buffer_from("2")).get();
+
+    update_policy policy;
+    policy.node_cache() = &cache;
+    c.update("/update-cached", append('+'), policy).get();
+    CHECK_EQ("2+", string_from(c.get("/update-cached").get().data()));
+}
+
+GTEST_TEST_F(update_tests, concurrent_updates_merge)
+{
+    client c = get_connected_client();
+    c.create("/update-merge", buffer_from("0")).get();
+
+    update_function increment = [] (const buffer& current)
+                                {
+                                    return buffer_from(std::to_string(std::stoi(string_from(current)) + 1));
+                                };
+
+    // The rest are submitted while the first is being applied, so its write is surely still to come
+    static constexpr int count = 50;
+    std::vector<future<set_result>> pending;
+    auto first = c.update("/update-merge",
+                          [&] (const buffer& current)
+                          {
+                              if (pending.empty())
+                              {
+                                  for (int idx = 1; idx < count; ++idx)
+                                      pending.emplace_back(c.update("/update-merge", increment));
+                              }
+                              return increment(current);
+                          }
+                         );
+
+    // One write for the first and one for everything which queued up behind it
+    CHECK_EQ(1, first.get().stat().data_version.value);
+    for (auto& fut : pending)
+        CHECK_EQ(2, fut.get().stat().data_version.value);
+    CHECK_EQ(std::to_string(count), string_from(c.get("/update-merge").get().data()));
+}
+
+GTEST_TEST_F(update_tests, competing_clients)
+{
+    client first  = get_connected_client();
+    client second = get_connected_client();
+    first.create("/update-compete", buffer()).get();
+
+    // Two connections do not merge, so they race each other for the entry and neither loses a change
+    static constexpr std::size_t count = 20U;
+    update_policy policy;
+    policy.max_attempts() = 1000U;
+    std::vector<future<set_result>> pending;
+    for (std::size_t idx = 0U; idx < count; ++idx)
+    {
+        pending.emplace_back(first.update("/update-compete", append('f'), policy));
+        pending.emplace_back(second.update("/update-compete", append('s'), policy));
+    }
+    for (auto& fut : pending)
+        fut.get();
+
+    auto data = string_from(first.get("/update-compete").get().data());
+    CHECK_EQ(count * 2U, data.size());
+    CHECK_EQ(count, std::size_t(std::count(data.begin(), data.end(), 'f')));
+}
+
+}
@@ -0,0 +1,210 @@
+#include "watch_dispatcher.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// watch_dispatcher::node                                                                                             //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// One segment of the paths in the trie. The root node stands for \c "/".
+struct watch_dispatcher::node final
+{
+    std::map<std::string, std::unique_ptr<node>, std::less<>> children;
+    std::vector<handler_id>                                  exact;  //!< Handlers of this very path
+    std::vector<handler_id>                                  prefix; //!< Handlers of this path and everything under it
+
+    bool empty() const noexcept
+    {
+        return children.empty() && exact.empty() && prefix.empty();
+    }
+};
+
+/// Call \a visit with each segment of \a path, skipping the empty ones (so \c "/" has none).
+template <typename FVisit>
+static void for_each_segment(string_view path, FVisit&& visit)
+{
+    std::size_t start = 0U;
+    while (start < path.size())
+    {
+        auto end = path.find('/', start);
+        if (end == string_view::npos)
+            end = path.size();
+        if (end > start)
+        {
+            if (!visit(path.substr(start, end - start)))
+                return;
+        }
+        start = end + 1U;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// watch_dispatcher                                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+watch_dispatcher::watch_dispatcher() :
+        _root(std::make_unique<node>()),
+        _next_id(1U)
+{ }
+
+watch_dispatcher::~watch_dispatcher() noexcept = default;
+
+watch_dispatcher::handler_id watch_dispatcher::on_path(path_view path, event_callback on_event)
+{
+    return add({ std::string(path.view()) }, false, std::move(on_event));
+}
+
+watch_dispatcher::handler_id watch_dispatcher::on_paths(const std::vector<path_view>& paths, event_callback on_event)
+{
+    std::vector<std::string> copied;
+    copied.reserve(paths.size());
+    for (const auto& path : paths)
+        copied.emplace_back(path.view());
+    return add(std::move(copied), false, std::move(on_event));
+}
+
+watch_dispatcher::handler_id watch_dispatcher::on_prefix(path_view prefix, event_callback on_event)
+{
+    return add({ std::string(prefix.view()) }, true, std::move(on_event));
+}
+
+watch_dispatcher::handler_id watch_dispatcher::add(std::vector<std::string> paths, bool prefix, event_callback on_event)
+{
+    auto call = std::make_shared<const event_callback>(std::move(on_event));
+
+    std::unique_lock<std::shared_mutex> ax(_protect);
+    auto id = _next_id++;
+    for (const auto& path : paths)
+    {
+        auto* current = _root.get();
+        for_each_segment(path,
+                         [&] (string_view segment)
+                         {
+                             auto iter = current->children.find(segment);
+                             if (iter == current->children.end())
+                                 iter = current->children.emplace(std::string(segment), std::make_unique<node>()).first;
+                             current = iter->second.get();
+                             return true;
+                         }
+                        );
+        auto& ids = prefix ? current->prefix : current->exact;
+        if (std::find(ids.begin(), ids.end(), id) == ids.end())
+            ids.push_back(id);
+    }
+    _handlers.emplace(id, handler{ std::move(call), std::move(paths), prefix });
+    return id;
+}
+
+void watch_dispatcher::remove(handler_id id)
+{
+    std::unique_lock<std::shared_mutex> ax(_protect);
+    auto iter = _handlers.find(id);
+    if (iter == _handlers.end())
+        return;
+
+    for (const auto& path : iter->second.paths)
+    {
+        // Walk down, then prune the nodes which are left with nothing on the way back up
+        std::vector<std::pair<node*, string_view>> trail;
+        auto*                                      current = _root.get();
+        for_each_segment(path,
+                         [&] (string_view segment)
+                         {
+                             auto child = current->children.find(segment);
+                             if (child == current->children.end())
+                                 return false;
+                             trail.emplace_back(current, child->first);
+                             current = child->second.get();
+                             return true;
+                         }
+                        );
+
+        auto& ids = iter->second.prefix ? current->prefix : current->exact;
+        ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+        for (auto step = trail.rbegin(); step != trail.rend(); ++step)
+        {
+            auto child = step->first->children.find(step->second);
+            if (!child->second->empty())
+                break;
+            step->first->children.erase(child);
+        }
+    }
+    _handlers.erase(iter);
+}
+
+std::size_t watch_dispatcher::dispatch(const event& ev)
+{
+    std::vector<std::shared_ptr<const event_callback>> calls;
+    if (ev.path().empty())
+    {
+        std::unique_lock<std::shared_mutex> ax(_protect);
+        if (std::find(_session_states.begin(), _session_states.end(), ev.state()) != _session_states.end())
+            return 0U;
+        _session_states.push_back(ev.state());
+
+        calls.reserve(_handlers.size());
+        for (const auto& entry : _handlers)
+            calls.push_back(entry.second.call);
+    }
+    else
+    {
+        std::shared_lock<std::shared_mutex> ax(_protect);
+
+        // The prefixes are gathered from the root down and called the other way around; a handler covering several
+        // of them is only called once
+        std::vector<handler_id> ids;
+        auto gather = [&] (const std::vector<handler_id>& from)
+                      {
+                          for (auto id : from)
+                              if (std::find(ids.begin(), ids.end(), id) == ids.end())
+                                  ids.push_back(id);
+                      };
+
+        const auto* current = _root.get();
+        gather(current->prefix);
+        bool found = true;
+        for_each_segment(ev.path(),
+                         [&] (string_view segment)
+                         {
+                             auto child = current->children.find(segment);
+                             if (child == current->children.end())
+                                 return found = false;
+                             current = child->second.get();
+                             gather(current->prefix);
+                             return true;
+                         }
+                        );
+        std::reverse(ids.begin(), ids.end());
+        if (found)
+        {
+            std::vector<handler_id> on_path;
+            for (auto id : current->exact)
+                if (std::find(ids.begin(), ids.end(), id) == ids.end())
+                    on_path.push_back(id);
+            ids.insert(ids.begin(), on_path.begin(), on_path.end());
+        }
+
+        calls.reserve(ids.size());
+        for (auto id : ids)
+            calls.push_back(_handlers.at(id).call);
+    }
+
+    for (const auto& call : calls)
+        (*call)(ev);
+    return calls.size();
+}
+
+std::size_t watch_dispatcher::size() const
+{
+    std::shared_lock<std::shared_mutex> ax(_protect);
+    return _handlers.size();
+}
+
+}
@@ -0,0 +1,115 @@
+/// \file
+/// Defines \ref zk::watch_dispatcher, which routes watch events to callbacks by the path they are about.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "callback.hpp"
+#include "forwards.hpp"
+#include "path.hpp"
+#include "results.hpp"
+#include "types.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// Routes \ref event instances to the handlers registered for their \ref event::path. A handler can be registered for
+/// one path, for a set of paths or for a prefix (an entry and everything under it), and it is only stored once however
+/// many paths it covers. The paths are kept in a trie of their segments, so routing an event costs one lookup per
+/// segment of its path, however many handlers and paths there are.
+///
+/// Every connection has one, which \ref client::dispatcher returns: the events of the watches set with
+/// \ref client::watch_routed, \ref client::watch_children_routed and \ref client::watch_exists_routed go to it instead
+/// of to a callback of their own. That is the way to follow tens of thousands of entries without a callback (and, with
+/// the \c "zk" schema, a watcher object) for each watch.
+///
+/// \code
+/// auto id = client.dispatcher().on_prefix("/services",
+///                                         [&] (const zk::event& ev) { refresh(ev.path()); }
+///                                        );
+/// client.watch_children_routed("/services/a");
+/// client.watch_children_routed("/services/b");
+/// \endcode
+///
+/// An event about the session rather than an entry (which has an empty path, like the one delivered when the session
+/// expires) goes to every handler, once for each state: a connection may report the same end of its session for each
+/// of its watches, but a handler only needs to hear of it once.
+///
+/// Handlers are called on whichever thread delivers the event (see \ref connection_params::completion_executor), with
+/// no lock held, so they are free to register and remove handlers and to set watches. A handler which is removed while
+/// an event is being delivered may still be called with that event.
+class watch_dispatcher final
+{
+public:
+    using handler_id = std::size_t;
+
+public:
+    watch_dispatcher();
+
+    watch_dispatcher(const watch_dispatcher&) = delete;
+    watch_dispatcher& operator=(const watch_dispatcher&) = delete;
+
+    ~watch_dispatcher() noexcept;
+
+    /// Call \a on_event with the events about the entry at \a path.
+    ///
+    /// \returns An identifier to pass to \ref remove.
+    handler_id on_path(path_view path, event_callback on_event);
+
+    /// Call \a on_event with the events about any of the entries at \a paths.
+    ///
+    /// \returns An identifier to pass to \ref remove.
+    handler_id on_paths(const std::vector<path_view>& paths, event_callback on_event);
+
+    /// Call \a on_event with the events about the entry at \a prefix and every entry under it. The root (\c "/") covers
+    /// every entry.
+    ///
+    /// \returns An identifier to pass to \ref remove.
+    handler_id on_prefix(path_view prefix, event_callback on_event);
+
+    /// Unregister the handler with the \a id returned when it was registered. Removing an unknown \a id does nothing.
+    void remove(handler_id id);
+
+    /// Deliver \a ev to the handlers it is routed to: the ones on its path, then the ones on the prefixes of its path
+    /// from the longest to the shortest.
+    ///
+    /// \returns The number of handlers called.
+    std::size_t dispatch(const event& ev);
+
+    /// The number of registered handlers.
+    std::size_t size() const;
+
+private:
+    struct node;
+
+    struct handler
+    {
+        std::shared_ptr<const event_callback> call;
+        std::vector<std::string>              paths;
+        bool                                  prefix;
+    };
+
+private:
+    handler_id add(std::vector<std::string> paths, bool prefix, event_callback on_event);
+
+private:
+    mutable std::shared_mutex               _protect;
+    std::unique_ptr<node>                   _root;
+    std::unordered_map<handler_id, handler> _handlers;
+    handler_id                              _next_id;
+    std::vector<zk::state>                  _session_states; //!< The states whose session event was delivered
+};
+
+/// \}
+
+}
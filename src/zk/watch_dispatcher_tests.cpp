@@ -0,0 +1,101 @@
+#include <zk/tests/test.hpp>
+
+#include <string>
+#include <vector>
+
+#include "watch_dispatcher.hpp"
+
+namespace zk
+{
+
+static event changed(std::string path)
+{
+    return event(event_type::changed, state::connected, std::move(path));
+}
+
+GTEST_TEST(watch_dispatcher_tests, event_path)
+{
+    CHECK_EQ("event{changed | connected | /a/b}", to_string(changed("/a/b")));
+    CHECK_EQ("event{session | expired_session}", to_string(event(event_type::session, state::expired_session)));
+}
+
+GTEST_TEST(watch_dispatcher_tests, routes_by_path)
+{
+    watch_dispatcher         dispatcher;
+    std::vector<std::string> seen;
+    auto                     record = [&] (std::string tag)
+                                      {
+                                          return [&seen, tag] (const event& ev) { seen.push_back(tag + ev.path()); };
+                                      };
+
+    dispatcher.on_path("/a/b", record("path:"));
+    dispatcher.on_paths({ "/a", "/c/d" }, record("paths:"));
+    dispatcher.on_prefix("/a", record("prefix:"));
+    dispatcher.on_prefix("/", record("root:"));
+    CHECK_EQ(4U, dispatcher.size());
+
+    CHECK_EQ(3U, dispatcher.dispatch(changed("/a/b")));
+    CHECK_EQ(2U, dispatcher.dispatch(changed("/c/d")));
+    CHECK_EQ(3U, dispatcher.dispatch(changed("/a")));
+    CHECK_EQ(2U, dispatcher.dispatch(changed("/a/b/c")));
+    CHECK_EQ(1U, dispatcher.dispatch(changed("/ab")));
+
+    std::vector<std::string> expected =
+        {
+            "path:/a/b", "prefix:/a/b", "root:/a/b",
+            "paths:/c/d", "root:/c/d",
+            "paths:/a", "prefix:/a", "root:/a",
+            "prefix:/a/b/c", "root:/a/b/c",
+            "root:/ab",
+        };
+    CHECK_TRUE(expected == seen);
+}
+
+GTEST_TEST(watch_dispatcher_tests, calls_each_handler_once)
+{
+    watch_dispatcher dispatcher;
+    int              calls = 0;
+    dispatcher.on_paths({ "/x", "/x", "/x/y" }, [&] (const event&) { ++calls; });
+
+    CHECK_EQ(1U, dispatcher.dispatch(changed("/x")));
+    CHECK_EQ(1, calls);
+    CHECK_EQ(0U, dispatcher.dispatch(changed("/x/y/z")));
+}
+
+GTEST_TEST(watch_dispatcher_tests, session_events_once_per_state)
+{
+    watch_dispatcher dispatcher;
+    int              calls = 0;
+    dispatcher.on_path("/a", [&] (const event&) { ++calls; });
+    dispatcher.on_prefix("/b", [&] (const event&) { ++calls; });
+
+    CHECK_EQ(2U, dispatcher.dispatch(event(event_type::session, state::expired_session)));
+    CHECK_EQ(0U, dispatcher.dispatch(event(event_type::session, state::expired_session)));
+    CHECK_EQ(2U, dispatcher.dispatch(event(event_type::session, state::closed)));
+    CHECK_EQ(4, calls);
+}
+
+GTEST_TEST(watch_dispatcher_tests, remove)
+{
+    watch_dispatcher dispatcher;
+    int              calls = 0;
+    auto             deep  = dispatcher.on_paths({ "/a/b/c", "/a/d" }, [&] (const event&) { ++calls; });
+    auto             top   = dispatcher.on_prefix("/a", [&] (const event&) { ++calls; });
+
+    dispatcher.remove(deep);
+    dispatcher.remove(deep);
+    CHECK_EQ(1U, dispatcher.size());
+    CHECK_EQ(1U, dispatcher.dispatch(changed("/a/b/c")));
+
+    dispatcher.remove(top);
+    CHECK_EQ(0U, dispatcher.size());
+    CHECK_EQ(0U, dispatcher.dispatch(changed("/a/b/c")));
+    CHECK_EQ(1, calls);
+
+    // The pruned paths can be registered again
+    dispatcher.on_path("/a/b/c", [&] (const event&) { ++calls; });
+    CHECK_EQ(1U, dispatcher.dispatch(changed("/a/b/c")));
+    CHECK_EQ(2, calls);
+}
+
+}
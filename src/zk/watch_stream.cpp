@@ -0,0 +1,309 @@
+#include "watch_stream.hpp"
+#include "error.hpp"
+
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// watch_update                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const watch_update& self)
+{
+    os << "watch_update{trigger=";
+    if (self.trigger())
+        os << *self.trigger();
+    else
+        os << "nullopt";
+    os << ", value=";
+    if (self.value())
+        os << *self.value();
+    else
+        os << "nullopt";
+    return os << '}';
+}
+
+std::string to_string(const watch_update& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// watch_stream::state                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Only one watch is outstanding at a time: its event sets the next one. The read results hold the state strongly,
+/// since they always complete; the events only hold it weakly, so dropping the stream lets the state go even though
+/// the last watch never triggers.
+struct watch_stream::state final :
+        std::enable_shared_from_this<watch_stream::state>
+{
+    explicit state(client conn, zk::path path, listener on_update) :
+            conn(std::move(conn)),
+            path(std::move(path)),
+            on_update(std::move(on_update))
+    { }
+
+    void arm()
+    {
+        auto self = shared_from_this();
+        conn.watch(path,
+                   [self] (outcome<watch_result> result) { self->on_data(std::move(result)); },
+                   on_event()
+                  );
+    }
+
+    void on_data(outcome<watch_result> result)
+    {
+        if (stopped())
+            return;
+        else if (result)
+        {
+            consider(std::move(*result).initial());
+        }
+        else if (result.code() == error_code::no_entry)
+        {
+            // A data watch is only left on an entry which exists, so wait for it to be created instead
+            auto self = shared_from_this();
+            conn.watch_exists(path,
+                              [self] (outcome<watch_exists_result> result) { self->on_exists(std::move(result)); },
+                              on_event()
+                             );
+        }
+        else
+        {
+            finish(outcome<watch_update>(result.code(), result.error()));
+        }
+    }
+
+    void on_exists(outcome<watch_exists_result> result)
+    {
+        if (!result)
+            finish(outcome<watch_update>(result.code(), result.error()));
+        else if (result->initial())
+            // Created between the two reads, so the exists watch is already set on the new entry and only its data
+            // is missing; setting a data watch as well would double the watches from here on
+            fetch();
+        else
+            consider(nullopt);
+    }
+
+    void fetch()
+    {
+        auto self = shared_from_this();
+        conn.get(path,
+                 [self] (outcome<get_result> result)
+                 {
+                     if (result)
+                         self->consider(std::move(*result));
+                     else if (result.code() == error_code::no_entry)
+                         self->consider(nullopt);
+                     else
+                         self->finish(outcome<watch_update>(result.code(), result.error()));
+                 }
+                );
+    }
+
+    event_callback on_event()
+    {
+        std::weak_ptr<state> weak_self = shared_from_this();
+        return [weak_self] (const event& ev)
+               {
+                   auto self = weak_self.lock();
+                   if (!self)
+                       return;
+
+                   if (ev.type() == event_type::session && ev.state() == zk::state::expired_session)
+                       self->finish(error_code::session_expired);
+                   else if (ev.type() == event_type::session && ev.state() == zk::state::closed)
+                       self->finish(error_code::closed);
+                   else
+                       self->rearm(ev);
+               };
+    }
+
+    bool stopped()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        return cancelled;
+    }
+
+    void rearm(const event& ev)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (cancelled)
+            return;
+        trigger = ev;
+        ax.unlock();
+
+        arm();
+    }
+
+    /// Deliver \a value unless it is the same version of the entry as the last update.
+    void consider(optional<get_result> value)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (cancelled)
+            return;
+
+        if (delivered_any && !is_newer(value))
+            return;
+
+        delivered_any = true;
+        if (value)
+            last_seen.emplace(value->stat());
+        else
+            last_seen = nullopt;
+
+        auto update = watch_update(std::exchange(trigger, nullopt), std::move(value));
+        deliver(std::move(ax), std::move(update));
+    }
+
+    /// \pre \c protect is held.
+    bool is_newer(const optional<get_result>& value) const
+    {
+        if (bool(value) != bool(last_seen))
+            return true;
+        else if (!value)
+            return false;
+        else if (value->stat().create_transaction != last_seen->create_transaction)
+            return true; // erased and created again, so the version starts over
+        else
+            return last_seen->data_version < value->stat().data_version;
+    }
+
+    void finish(outcome<watch_update> result)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (cancelled)
+            return;
+        cancelled = true;
+        deliver(std::move(ax), std::move(result));
+    }
+
+    void deliver(std::unique_lock<std::mutex> ax, outcome<watch_update> result)
+    {
+        if (on_update)
+        {
+            // The callbacks all come from the one event thread, so the updates stay in order even without the lock
+            ax.unlock();
+            on_update(std::move(result));
+        }
+        else if (!waiting.empty())
+        {
+            auto waiter = std::move(waiting.front());
+            waiting.pop_front();
+            ax.unlock();
+
+            if (result)
+                waiter.set_value(std::move(*result));
+            else
+                waiter.set_exception(result.error());
+        }
+        else
+        {
+            ready.emplace_back(std::move(result));
+        }
+    }
+
+    future<watch_update> next()
+    {
+        if (on_update)
+            throw std::logic_error("watch_stream was created with a listener; there is nothing to pull");
+
+        std::unique_lock<std::mutex> ax(protect);
+        promise<watch_update> waiter;
+        auto out = waiter.get_future();
+        if (!ready.empty())
+        {
+            auto result = std::move(ready.front());
+            ready.pop_front();
+            ax.unlock();
+
+            if (result)
+                waiter.set_value(std::move(*result));
+            else
+                waiter.set_exception(result.error());
+        }
+        else if (cancelled)
+        {
+            ax.unlock();
+            waiter.set_exception(get_exception_ptr_of(error_code::closed));
+        }
+        else
+        {
+            waiting.emplace_back(std::move(waiter));
+        }
+        return out;
+    }
+
+    void cancel()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (cancelled)
+            return;
+        cancelled = true;
+        auto waiters = std::exchange(waiting, {});
+        ax.unlock();
+
+        for (auto& waiter : waiters)
+            waiter.set_exception(get_exception_ptr_of(error_code::closed));
+    }
+
+    client                            conn;
+    zk::path                          path;
+    listener                          on_update;
+
+    std::mutex                        protect;
+    bool                              cancelled     = false;
+    bool                              delivered_any = false;
+    optional<zk::stat>                last_seen;
+    optional<event>                   trigger;
+    std::deque<outcome<watch_update>> ready;
+    std::deque<promise<watch_update>> waiting;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// watch_stream                                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+watch_stream::watch_stream(client conn, zk::path path) :
+        watch_stream(std::move(conn), std::move(path), nullptr)
+{ }
+
+watch_stream::watch_stream(client conn, zk::path path, listener on_update) :
+        _state(std::make_shared<state>(std::move(conn), std::move(path), std::move(on_update)))
+{
+    _state->arm();
+}
+
+watch_stream::~watch_stream() noexcept
+{
+    if (_state)
+        _state->cancel();
+}
+
+const zk::path& watch_stream::path() const
+{
+    return _state->path;
+}
+
+future<watch_update> watch_stream::next()
+{
+    return _state->next();
+}
+
+void watch_stream::cancel()
+{
+    _state->cancel();
+}
+
+}
@@ -0,0 +1,126 @@
+/// \file
+/// Defines \ref zk::watch_stream, which keeps following the data of one entry.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "callback.hpp"
+#include "client.hpp"
+#include "forwards.hpp"
+#include "future.hpp"
+#include "optional.hpp"
+#include "path.hpp"
+#include "results.hpp"
+#include "types.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// One observation of the entry followed by a \ref watch_stream.
+class watch_update final
+{
+public:
+    explicit watch_update(optional<event> trigger, optional<get_result> value) :
+            _trigger(std::move(trigger)),
+            _value(std::move(value))
+    { }
+
+    /// The event which led to this update. This is \c nullopt for the first update of a stream, which describes the
+    /// entry as it was when the stream started.
+    const optional<event>& trigger() const { return _trigger; }
+
+    /// Does the entry exist?
+    bool exists() const { return bool(_value); }
+
+    /// The data and \ref stat of the entry or \c nullopt if it does not \ref exists.
+    const optional<get_result>& value() const & { return _value; }
+    optional<get_result>        value() &&      { return std::move(_value); }
+
+private:
+    optional<event>      _trigger;
+    optional<get_result> _value;
+};
+
+std::ostream& operator<<(std::ostream&, const watch_update&);
+
+std::string to_string(const watch_update&);
+
+/// Follows the data of a single entry until it is cancelled. Each time the watch on the entry triggers, it is set again
+/// and the entry is read in the same request, so a stream is never without a watch for longer than one round trip.
+/// Changes which happen in that window are not lost: the read which sets the new watch returns the latest data.
+///
+/// Updates are delivered in order and are filtered so that consumers never see the same version of the entry twice (a
+/// reconnect, for example, sets the watch again without anything having changed). Consecutive changes which happen
+/// faster than the stream can set its watch again are folded into the latest one, so not every intermediate
+/// \ref stat::data_version is necessarily seen.
+///
+/// Updates can be pushed to a \ref listener or pulled with \ref next:
+///
+/// \code
+/// auto stream = client.watch_stream(zk::path("/app/config"));
+/// while (true)
+/// {
+///     auto update = stream.next().get();
+///     if (update.exists())
+///         apply_config(update.value()->data());
+/// }
+/// \endcode
+///
+/// The stream ends when its session is expired or closed, or when one of its reads fails (which, short of a lack of
+/// permission, means the connection was lost while the read was in flight). In pull mode, the \ref next after the
+/// last update is delivered with the error; a \ref listener gets an \ref outcome with it.
+///
+/// \note
+/// ZooKeeper 3.6 added persistent watches (\c addWatch), which would make the reads between events unnecessary. The C
+/// client this library is built on does not expose them, so every re-arm costs a read.
+class watch_stream final
+{
+public:
+    /// Called with each update. It is called on the ZooKeeper event thread, with the same restrictions as a
+    /// \ref callback.
+    using listener = callback<watch_update>;
+
+public:
+    /// \{
+    /// Start following the entry at \a path. With an \a on_update, every update goes to it; otherwise, updates are
+    /// queued for \ref next.
+    explicit watch_stream(client conn, zk::path path);
+    explicit watch_stream(client conn, zk::path path, listener on_update);
+    /// \}
+
+    watch_stream(watch_stream&&) noexcept = default;
+    watch_stream& operator=(watch_stream&&) noexcept = default;
+
+    /// \ref cancel the stream.
+    ~watch_stream() noexcept;
+
+    /// The path of the followed entry.
+    const zk::path& path() const;
+
+    /// Get the next update. Updates which were delivered before anyone asked for them are queued, so none are lost.
+    ///
+    /// \throws std::logic_error if the stream was created with a \ref listener.
+    future<watch_update> next();
+
+    /// Stop delivering updates. The watch which is currently set stays on the server until it triggers, but it is
+    /// ignored. Anyone waiting in \ref next is delivered \ref closed.
+    void cancel();
+
+private:
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// \}
+
+}
@@ -0,0 +1,122 @@
+#include <zk/server/server_tests.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "client.hpp"
+#include "error.hpp"
+#include "string_view.hpp"
+#include "watch_stream.hpp"
+
+namespace zk
+{
+
+static buffer buffer_from(string_view str)
+{
+    return buffer(str.data(), str.data() + str.size());
+}
+
+GTEST_TEST(watch_update_tests, stringify_missing)
+{
+    CHECK_EQ("watch_update{trigger=nullopt, value=nullopt}", to_string(watch_update(nullopt, nullopt)));
+}
+
+class watch_stream_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(watch_stream_tests, follows_changes)
+{
+    client c = get_connected_client();
+    c.create("/stream-follow", buffer_from("first")).get();
+
+    auto stream = c.watch_stream(zk::path("/stream-follow"));
+    auto update = stream.next().get();
+    CHECK_FALSE(update.trigger());
+    CHECK_TRUE(update.value()->data() == buffer_from("first"));
+
+    c.set("/stream-follow", buffer_from("second")).get();
+    update = stream.next().get();
+    CHECK_EQ(event_type::changed, update.trigger()->type());
+    CHECK_TRUE(update.value()->data() == buffer_from("second"));
+
+    c.set("/stream-follow", buffer_from("third")).get();
+    CHECK_TRUE(stream.next().get().value()->data() == buffer_from("third"));
+}
+
+GTEST_TEST_F(watch_stream_tests, erase_and_create)
+{
+    client c = get_connected_client();
+
+    auto stream = c.watch_stream(zk::path("/stream-lifecycle"));
+    CHECK_FALSE(stream.next().get().exists());
+
+    c.create("/stream-lifecycle", buffer_from("born")).get();
+    auto update = stream.next().get();
+    CHECK_TRUE(update.exists());
+    CHECK_TRUE(update.value()->data() == buffer_from("born"));
+
+    c.erase("/stream-lifecycle").get();
+    update = stream.next().get();
+    CHECK_EQ(event_type::erased, update.trigger()->type());
+    CHECK_FALSE(update.exists());
+
+    // the version starts over on creation, but it is still a new entry
+    c.create("/stream-lifecycle", buffer_from("again")).get();
+    CHECK_TRUE(stream.next().get().value()->data() == buffer_from("again"));
+}
+
+GTEST_TEST_F(watch_stream_tests, listener)
+{
+    client c = get_connected_client();
+    c.create("/stream-listen", buffer_from("0")).get();
+
+    std::mutex          protect;
+    std::vector<buffer> seen;
+    auto stream = c.watch_stream(zk::path("/stream-listen"),
+                                 [&] (outcome<watch_update> update)
+                                 {
+                                     std::unique_lock<std::mutex> ax(protect);
+                                     if (update && update->exists())
+                                         seen.emplace_back(update->value()->data());
+                                 }
+                                );
+    CHECK_THROWS(std::logic_error)
+    {
+        stream.next();
+    };
+
+    c.set("/stream-listen", buffer_from("1")).get();
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (!seen.empty() && seen.back() == buffer_from("1"))
+            break;
+        ax.unlock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::unique_lock<std::mutex> ax(protect);
+    CHECK_FALSE(seen.empty());
+    CHECK_TRUE(seen.back() == buffer_from("1"));
+    CHECK_TRUE(seen.size() <= 2U);
+}
+
+GTEST_TEST_F(watch_stream_tests, cancel)
+{
+    client c = get_connected_client();
+
+    auto stream  = c.watch_stream(zk::path("/stream-cancel"));
+    stream.next().get();
+    auto waiting = stream.next();
+    stream.cancel();
+    CHECK_THROWS(closed)
+    {
+        waiting.get();
+    };
+}
+
+}
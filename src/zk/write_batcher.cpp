@@ -0,0 +1,333 @@
+#include "write_batcher.hpp"
+#include "error.hpp"
+#include "results.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace zk
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// write_batch_fallback                                                                                               //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const write_batch_fallback& self)
+{
+    switch (self)
+    {
+    case write_batch_fallback::retry_remaining: return os << "retry_remaining";
+    case write_batch_fallback::individually:    return os << "individually";
+    case write_batch_fallback::fail_all:        return os << "fail_all";
+    default:                                    return os << "write_batch_fallback(" << static_cast<int>(self) << ')';
+    }
+}
+
+std::string to_string(const write_batch_fallback& self)
+{
+    std::ostringstream os;
+    os << self;
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// write_batcher::state                                                                                               //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct write_batcher::pending final
+{
+    op                           operation;
+    callback<multi_result::part> on_complete;
+};
+
+struct write_batcher::state final :
+        std::enable_shared_from_this<write_batcher::state>
+{
+    using clock      = std::chrono::steady_clock;
+    using batch_type = std::vector<pending>;
+
+    explicit state(client conn, options opts) :
+            conn(std::move(conn)),
+            opts(std::move(opts))
+    {
+        if (this->opts.max_batch_size() == 0U)
+            this->opts.max_batch_size() = 1U;
+    }
+
+    void add(pending item)
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        if (current.empty())
+        {
+            current.reserve(opts.max_batch_size());
+            deadline = clock::now() + opts.max_delay();
+            wake.notify_one();
+        }
+        current.emplace_back(std::move(item));
+
+        if (current.size() >= opts.max_batch_size())
+        {
+            auto batch = std::exchange(current, {});
+            ax.unlock();
+            send(std::move(batch));
+        }
+    }
+
+    void flush()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        auto batch = std::exchange(current, {});
+        ax.unlock();
+
+        if (!batch.empty())
+            send(std::move(batch));
+    }
+
+    /// The body of the flushing thread: wait for the oldest operation's deadline, then send whatever has gathered.
+    void run()
+    {
+        std::unique_lock<std::mutex> ax(protect);
+        while (!stopping)
+        {
+            if (current.empty())
+            {
+                wake.wait(ax);
+            }
+            else if (clock::now() < deadline)
+            {
+                wake.wait_until(ax, deadline);
+            }
+            else
+            {
+                auto batch = std::exchange(current, {});
+                ax.unlock();
+                send(std::move(batch));
+                ax.lock();
+            }
+        }
+    }
+
+    void send(batch_type batch)
+    {
+        multi_op txn;
+        txn.reserve(batch.size());
+        for (const auto& item : batch)
+            txn.push_back(item.operation);
+
+        auto self   = shared_from_this();
+        auto shared = std::make_shared<batch_type>(std::move(batch));
+        try
+        {
+            conn.commit(std::move(txn),
+                        [self, shared] (outcome<multi_result> result)
+                        {
+                            self->on_commit(std::move(*shared), std::move(result));
+                        }
+                       );
+        }
+        catch (...)
+        {
+            // The transaction could not even be encoded; this is on whichever thread sent the batch, which is not
+            // necessarily any of the callers, so the exception goes to every operation instead
+            auto ex = std::current_exception();
+            for (auto& item : *shared)
+                item.on_complete(outcome<multi_result::part>(error_code::marshalling_error, ex));
+        }
+    }
+
+    void on_commit(batch_type batch, outcome<multi_result> result)
+    {
+        if (result)
+        {
+            for (std::size_t idx = 0U; idx < batch.size(); ++idx)
+                batch[idx].on_complete(multi_result::part((*result)[idx]));
+            return;
+        }
+
+        std::size_t failed_idx = batch.size();
+        error_code  cause      = result.code();
+        if (result.code() == error_code::transaction_failed)
+        {
+            try
+            {
+                std::rethrow_exception(result.error());
+            }
+            catch (const transaction_failed& ex)
+            {
+                failed_idx = ex.failed_op_index();
+                cause      = ex.underlying_cause();
+            }
+            catch (...)
+            { }
+        }
+
+        // Without knowing which operation was at fault (a connection loss, for example), there is nothing to retry
+        if (failed_idx >= batch.size() || opts.fallback() == write_batch_fallback::fail_all)
+        {
+            for (auto& item : batch)
+                item.on_complete(outcome<multi_result::part>(result.code(), result.error()));
+            return;
+        }
+
+        batch[failed_idx].on_complete(cause);
+
+        batch_type remaining;
+        remaining.reserve(batch.size() - 1U);
+        for (std::size_t idx = 0U; idx < batch.size(); ++idx)
+            if (idx != failed_idx)
+                remaining.emplace_back(std::move(batch[idx]));
+
+        if (remaining.empty())
+            return;
+        else if (opts.fallback() == write_batch_fallback::retry_remaining)
+            send(std::move(remaining));
+        else
+            for (auto& item : remaining)
+                send_one(std::move(item));
+    }
+
+    void send_one(pending item)
+    {
+        batch_type single;
+        single.emplace_back(std::move(item));
+        send(std::move(single));
+    }
+
+    client                  conn;
+    options                 opts;
+
+    std::mutex              protect;
+    std::condition_variable wake;
+    batch_type              current;
+    clock::time_point       deadline;
+    bool                    stopping = false;
+    std::thread             flusher;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// write_batcher                                                                                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+write_batcher::write_batcher(client conn) :
+        write_batcher(std::move(conn), options())
+{ }
+
+write_batcher::write_batcher(client conn, options opts) :
+        _state(std::make_shared<state>(std::move(conn), std::move(opts)))
+{
+    _state->flusher = std::thread([state = _state.get()] { state->run(); });
+}
+
+write_batcher::~write_batcher() noexcept
+{
+    {
+        std::unique_lock<std::mutex> ax(_state->protect);
+        _state->stopping = true;
+        _state->wake.notify_one();
+    }
+    _state->flusher.join();
+    _state->flush();
+}
+
+future<multi_result::part> write_batcher::submit(op operation)
+{
+    return future_from_callback<multi_result::part>([&] (auto cb)
+                                                    {
+                                                        this->submit(std::move(operation), std::move(cb));
+                                                    }
+                                                   );
+}
+
+void write_batcher::submit(op operation, callback<multi_result::part> on_complete)
+{
+    _state->add(pending{ std::move(operation), std::move(on_complete) });
+}
+
+future<create_result> write_batcher::create(std::string path, buffer data, acl rules, create_mode mode)
+{
+    return future_from_callback<create_result>([&] (auto cb)
+                                               {
+                                                   this->create(std::move(path),
+                                                                std::move(data),
+                                                                std::move(rules),
+                                                                mode,
+                                                                std::move(cb)
+                                                               );
+                                               }
+                                              );
+}
+
+future<create_result> write_batcher::create(std::string path, buffer data, create_mode mode)
+{
+    return create(std::move(path), std::move(data), acls::open_unsafe(), mode);
+}
+
+void write_batcher::create(std::string             path,
+                           buffer                  data,
+                           acl                     rules,
+                           create_mode             mode,
+                           callback<create_result> on_complete
+                          )
+{
+    submit(op::create(std::move(path), std::move(data), std::move(rules), mode),
+           [on_complete = std::move(on_complete)] (outcome<multi_result::part> result)
+           {
+               if (result)
+                   on_complete(result->as_create());
+               else
+                   on_complete(outcome<create_result>(result.code(), result.error()));
+           }
+          );
+}
+
+future<set_result> write_batcher::set(std::string path, buffer data, version check)
+{
+    return future_from_callback<set_result>([&] (auto cb)
+                                            {
+                                                this->set(std::move(path), std::move(data), check, std::move(cb));
+                                            }
+                                           );
+}
+
+void write_batcher::set(std::string path, buffer data, version check, callback<set_result> on_complete)
+{
+    submit(op::set(std::move(path), std::move(data), check),
+           [on_complete = std::move(on_complete)] (outcome<multi_result::part> result)
+           {
+               if (result)
+                   on_complete(result->as_set());
+               else
+                   on_complete(outcome<set_result>(result.code(), result.error()));
+           }
+          );
+}
+
+future<void> write_batcher::erase(std::string path, version check)
+{
+    return future_from_callback<void>([&] (auto cb) { this->erase(std::move(path), check, std::move(cb)); });
+}
+
+void write_batcher::erase(std::string path, version check, callback<void> on_complete)
+{
+    submit(op::erase(std::move(path), check),
+           [on_complete = std::move(on_complete)] (outcome<multi_result::part> result)
+           {
+               if (result)
+                   on_complete(outcome<void>());
+               else
+                   on_complete(outcome<void>(result.code(), result.error()));
+           }
+          );
+}
+
+void write_batcher::flush()
+{
+    _state->flush();
+}
+
+}
@@ -0,0 +1,146 @@
+/// \file
+/// Defines \ref zk::write_batcher, which folds independent writes into \ref multi_op transactions.
+#pragma once
+
+#include <zk/config.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+#include "acl.hpp"
+#include "buffer.hpp"
+#include "callback.hpp"
+#include "client.hpp"
+#include "forwards.hpp"
+#include "future.hpp"
+#include "multi.hpp"
+#include "types.hpp"
+
+namespace zk
+{
+
+/// \addtogroup Client
+/// \{
+
+/// What a \ref write_batcher does when one of the operations in a batch makes the whole transaction fail.
+enum class write_batch_fallback : int
+{
+    /// Fail the operation which caused the transaction to fail and commit the rest of the batch again. Since ZooKeeper
+    /// reports the first operation which failed, every retry removes at least one operation, so this converges.
+    retry_remaining,
+    /// Fail the operation which caused the transaction to fail and send every other operation of the batch on its own.
+    individually,
+    /// Fail every operation in the batch with \ref transaction_failed, as \ref client::commit would.
+    fail_all,
+};
+
+std::ostream& operator<<(std::ostream&, const write_batch_fallback&);
+
+std::string to_string(const write_batch_fallback&);
+
+/// Gathers independent writes (creates, sets, erases, and checks) and sends them to the server as \ref multi_op
+/// transactions. Every write of a transaction is applied in a single proposal round of the ensemble, so producers which
+/// issue many small writes get far more throughput than they would calling \ref client::set one at a time. Each write
+/// still gets its own \c future (or \ref callback) with its own result.
+///
+/// A batch is sent when it reaches \ref options::max_batch_size operations or when its oldest operation has waited
+/// \ref options::max_delay, whichever comes first.
+///
+/// \code
+/// zk::write_batcher batcher(client);
+/// std::vector<zk::future<zk::set_result>> results;
+/// for (const auto& [name, value] : updates)
+///     results.emplace_back(batcher.set(name, value));
+/// \endcode
+///
+/// \warning
+/// Only use this for writes which are independent of each other. Since operations from different callers end up in
+/// the same transaction, a failure of one of them aborts the others; what happens next is chosen by
+/// \ref options::fallback. Writes are committed in the order they were submitted, but the retries made by the fallback
+/// mean a write can land after writes which were submitted later.
+class write_batcher final
+{
+public:
+    /// Controls when batches are sent and what happens when one fails.
+    class options final
+    {
+    public:
+        options() = default;
+
+        /// The most operations to put in a single transaction. The default of 64 keeps transactions well under the
+        /// server's default \c jute.maxbuffer for small payloads.
+        std::size_t  max_batch_size() const { return _max_batch_size; }
+        std::size_t& max_batch_size()       { return _max_batch_size; }
+
+        /// The longest an operation waits for its batch to fill before it is sent anyway.
+        std::chrono::microseconds  max_delay() const { return _max_delay; }
+        std::chrono::microseconds& max_delay()       { return _max_delay; }
+
+        /// What to do when a batch fails because of one of its operations.
+        write_batch_fallback  fallback() const { return _fallback; }
+        write_batch_fallback& fallback()       { return _fallback; }
+
+    private:
+        std::size_t               _max_batch_size = 64U;
+        std::chrono::microseconds _max_delay      = std::chrono::milliseconds(1);
+        write_batch_fallback      _fallback       = write_batch_fallback::retry_remaining;
+    };
+
+public:
+    /// \{
+    /// Create a batcher sending its transactions through \a conn. This starts a thread which sends batches when they
+    /// have waited for \ref options::max_delay.
+    explicit write_batcher(client conn);
+    explicit write_batcher(client conn, options opts);
+    /// \}
+
+    write_batcher(const write_batcher&) = delete;
+    write_batcher& operator=(const write_batcher&) = delete;
+
+    /// Send whatever is still waiting and stop the flushing thread. Transactions in flight are still completed.
+    ~write_batcher() noexcept;
+
+    /// \{
+    /// Add \a operation to the current batch. Its \ref multi_result::part is delivered when the batch it ended up in
+    /// is committed. If the operation itself could not be applied, its outcome is the \ref error_code of the reason
+    /// (like \ref version_mismatch), exactly as the non-batched operation would report.
+    future<multi_result::part> submit(op operation);
+    void submit(op operation, callback<multi_result::part> on_complete);
+    /// \}
+
+    /// \{
+    /// Batched forms of \ref client::create.
+    future<create_result> create(std::string path, buffer data, acl rules, create_mode mode = create_mode::normal);
+    future<create_result> create(std::string path, buffer data, create_mode mode = create_mode::normal);
+    void create(std::string path, buffer data, acl rules, create_mode mode, callback<create_result> on_complete);
+    /// \}
+
+    /// \{
+    /// Batched forms of \ref client::set.
+    future<set_result> set(std::string path, buffer data, version check = version::any());
+    void set(std::string path, buffer data, version check, callback<set_result> on_complete);
+    /// \}
+
+    /// \{
+    /// Batched forms of \ref client::erase.
+    future<void> erase(std::string path, version check = version::any());
+    void erase(std::string path, version check, callback<void> on_complete);
+    /// \}
+
+    /// Send the current batch now, without waiting for it to fill.
+    void flush();
+
+private:
+    struct pending;
+    struct state;
+
+private:
+    std::shared_ptr<state> _state;
+};
+
+/// \}
+
+}
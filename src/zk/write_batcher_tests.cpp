@@ -0,0 +1,92 @@
+#include <zk/server/server_tests.hpp>
+
+#include <string>
+#include <vector>
+
+#include "client.hpp"
+#include "error.hpp"
+#include "string_view.hpp"
+#include "write_batcher.hpp"
+
+namespace zk
+{
+
+static buffer buffer_from(string_view str)
+{
+    return buffer(str.data(), str.data() + str.size());
+}
+
+GTEST_TEST(write_batch_fallback_tests, to_string)
+{
+    CHECK_EQ("retry_remaining", to_string(write_batch_fallback::retry_remaining));
+    CHECK_EQ("fail_all",        to_string(write_batch_fallback::fail_all));
+}
+
+class write_batcher_tests :
+        public server::single_server_fixture
+{ };
+
+GTEST_TEST_F(write_batcher_tests, fan_out_results)
+{
+    client c = get_connected_client();
+    c.create("/batched", buffer()).get();
+
+    write_batcher::options opts;
+    opts.max_batch_size() = 8U;
+    write_batcher batcher(c, opts);
+
+    std::vector<future<create_result>> creates;
+    for (int idx = 0; idx < 20; ++idx)
+        creates.emplace_back(batcher.create("/batched/" + std::to_string(idx), buffer_from("x")));
+    batcher.flush();
+
+    for (int idx = 0; idx < 20; ++idx)
+        CHECK_EQ("/batched/" + std::to_string(idx), creates[std::size_t(idx)].get().name());
+
+    auto set = batcher.set("/batched/3", buffer_from("y"));
+    CHECK_EQ(1, set.get().stat().data_version.value);
+    CHECK_TRUE(c.get("/batched/3").get().data() == buffer_from("y"));
+}
+
+GTEST_TEST_F(write_batcher_tests, failure_only_fails_offender)
+{
+    client c = get_connected_client();
+    c.create("/batch-fail", buffer()).get();
+
+    write_batcher batcher(c);
+    auto ok_before = batcher.create("/batch-fail/a", buffer());
+    auto bad       = batcher.set("/batch-fail/missing", buffer());
+    auto ok_after  = batcher.create("/batch-fail/b", buffer());
+    batcher.flush();
+
+    CHECK_EQ("/batch-fail/a", ok_before.get().name());
+    CHECK_THROWS(no_entry)
+    {
+        bad.get();
+    };
+    CHECK_EQ("/batch-fail/b", ok_after.get().name());
+}
+
+GTEST_TEST_F(write_batcher_tests, fail_all)
+{
+    client c = get_connected_client();
+
+    write_batcher::options opts;
+    opts.fallback() = write_batch_fallback::fail_all;
+    write_batcher batcher(c, opts);
+    auto innocent = batcher.create("/batch-fail-all", buffer());
+    auto bad      = batcher.erase("/batch-fail-all-missing");
+    batcher.flush();
+
+    CHECK_THROWS(transaction_failed)
+    {
+        innocent.get();
+    };
+    CHECK_THROWS(transaction_failed)
+    {
+        bad.get();
+    };
+    CHECK_FALSE(c.exists("/batch-fail-all").get());
+}
+
+}